@@ -47,7 +47,9 @@
 #include "gegl/gimp-gegl.h"
 
 #include "core/gimp.h"
+#include "core/gimp-parallel.h"
 #include "core/gimp-user-install.h"
+#include "core/gimpundotiles.h"
 
 #include "file/file-open.h"
 
@@ -209,6 +211,8 @@ app_run (const gchar         *full_prog_name,
 
   /*  initialize lowlevel stuff  */
   gimp_gegl_init (gimp);
+  gimp_parallel_init (gimp);
+  gimp_undo_tiles_init (gimp);
 
 #ifndef GIMP_CONSOLE_COMPILATION
   if (! no_interface)
@@ -256,6 +260,9 @@ app_run (const gchar         *full_prog_name,
 
   g_main_loop_unref (loop);
 
+  gimp_undo_tiles_exit (gimp);
+  gimp_parallel_exit (gimp);
+
   g_object_unref (gimp);
 
   gimp_debug_instances ();
@@ -103,6 +103,10 @@ enum
   PROP_COLOR_PROFILE_POLICY,
   PROP_SAVE_DOCUMENT_HISTORY,
   PROP_QUICK_MASK_COLOR,
+  PROP_XCF_COMPRESSION,
+  PROP_XCF_LAZY_LOADING,
+  PROP_XCF_SAVE_LEVELS,
+  PROP_BRUSH_CACHE_SIZE,
 
   /* ignored, only for backward compatibility: */
   PROP_INSTALL_COLORMAP,
@@ -448,6 +452,26 @@ gimp_core_config_class_init (GimpCoreConfigClass *klass)
                                 "quick-mask-color", QUICK_MASK_COLOR_BLURB,
                                 TRUE, &red,
                                 GIMP_PARAM_STATIC_STRINGS);
+  GIMP_CONFIG_INSTALL_PROP_ENUM (object_class, PROP_XCF_COMPRESSION,
+                                 "xcf-compression", XCF_COMPRESSION_BLURB,
+                                 GIMP_TYPE_XCF_COMPRESSION,
+                                 GIMP_XCF_COMPRESSION_RLE,
+                                 GIMP_PARAM_STATIC_STRINGS);
+  GIMP_CONFIG_INSTALL_PROP_BOOLEAN (object_class, PROP_XCF_LAZY_LOADING,
+                                    "xcf-lazy-loading",
+                                    XCF_LAZY_LOADING_BLURB,
+                                    FALSE,
+                                    GIMP_PARAM_STATIC_STRINGS);
+  GIMP_CONFIG_INSTALL_PROP_BOOLEAN (object_class, PROP_XCF_SAVE_LEVELS,
+                                    "xcf-save-levels",
+                                    XCF_SAVE_LEVELS_BLURB,
+                                    FALSE,
+                                    GIMP_PARAM_STATIC_STRINGS);
+  GIMP_CONFIG_INSTALL_PROP_MEMSIZE (object_class, PROP_BRUSH_CACHE_SIZE,
+                                    "brush-cache-size",
+                                    BRUSH_CACHE_SIZE_BLURB,
+                                    0, GIMP_MAX_MEMSIZE, 1 << 24,
+                                    GIMP_PARAM_STATIC_STRINGS);
 
   /*  only for backward compatibility:  */
   GIMP_CONFIG_INSTALL_PROP_BOOLEAN (object_class, PROP_INSTALL_COLORMAP,
@@ -721,6 +745,18 @@ gimp_core_config_set_property (GObject      *object,
     case PROP_QUICK_MASK_COLOR:
       gimp_value_get_rgb (value, &core_config->quick_mask_color);
       break;
+    case PROP_XCF_COMPRESSION:
+      core_config->xcf_compression = g_value_get_enum (value);
+      break;
+    case PROP_XCF_LAZY_LOADING:
+      core_config->xcf_lazy_loading = g_value_get_boolean (value);
+      break;
+    case PROP_XCF_SAVE_LEVELS:
+      core_config->xcf_save_levels = g_value_get_boolean (value);
+      break;
+    case PROP_BRUSH_CACHE_SIZE:
+      core_config->brush_cache_size = g_value_get_uint64 (value);
+      break;
 
     case PROP_INSTALL_COLORMAP:
     case PROP_MIN_COLORS:
@@ -890,6 +926,18 @@ gimp_core_config_get_property (GObject    *object,
     case PROP_QUICK_MASK_COLOR:
       gimp_value_set_rgb (value, &core_config->quick_mask_color);
       break;
+    case PROP_XCF_COMPRESSION:
+      g_value_set_enum (value, core_config->xcf_compression);
+      break;
+    case PROP_XCF_LAZY_LOADING:
+      g_value_set_boolean (value, core_config->xcf_lazy_loading);
+      break;
+    case PROP_XCF_SAVE_LEVELS:
+      g_value_set_boolean (value, core_config->xcf_save_levels);
+      break;
+    case PROP_BRUSH_CACHE_SIZE:
+      g_value_set_uint64 (value, core_config->brush_cache_size);
+      break;
 
     case PROP_INSTALL_COLORMAP:
     case PROP_MIN_COLORS:
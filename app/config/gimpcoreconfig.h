@@ -88,6 +88,10 @@ struct _GimpCoreConfig
   GimpColorProfilePolicy  color_profile_policy;
   gboolean                save_document_history;
   GimpRGB                 quick_mask_color;
+  GimpXcfCompression      xcf_compression;
+  gboolean                xcf_lazy_loading;
+  gboolean                xcf_save_levels;
+  guint64                 brush_cache_size;
 };
 
 struct _GimpCoreConfigClass
@@ -283,6 +283,26 @@ N_("Sets the preview size used for layers and channel previews in newly " \
 #define QUICK_MASK_COLOR_BLURB \
 N_("Sets the default quick mask color.")
 
+#define XCF_COMPRESSION_BLURB \
+N_("Sets how the pixel data of XCF files is compressed.  zlib makes much " \
+   "smaller files than RLE but they can't be opened by older versions of " \
+   "GIMP, zlib-fast trades some of the size for speed.")
+
+#define XCF_LAZY_LOADING_BLURB \
+N_("When enabled, the pixels of XCF files are only read when they are " \
+   "first needed, which makes opening large files much faster.  The file " \
+   "must not be changed by other programs while the image is open.")
+
+#define XCF_SAVE_LEVELS_BLURB \
+N_("When enabled, XCF files also store downsampled copies of the pixels, " \
+   "so thumbnails and previews of large files can be created quickly.  " \
+   "This makes saving slower and files about a third larger.")
+
+#define BRUSH_CACHE_SIZE_BLURB \
+N_("Sets the memory that is used per brush to keep transformed versions " \
+   "of it, so painting with varying size or angle doesn't have to " \
+   "transform the brush again for every dab.")
+
 #define RESIZE_WINDOWS_ON_RESIZE_BLURB \
 N_("When enabled, the image window will automatically resize itself " \
    "whenever the physical image size changes.")
@@ -201,10 +201,12 @@ typedef struct _GimpArea            GimpArea;
 typedef struct _GimpBoundSeg        GimpBoundSeg;
 typedef struct _GimpCoords          GimpCoords;
 typedef struct _GimpGradientSegment GimpGradientSegment;
+typedef struct _GimpMaskTiles       GimpMaskTiles;
 typedef struct _GimpPaletteEntry    GimpPaletteEntry;
 typedef struct _GimpSamplePoint     GimpSamplePoint;
 typedef struct _GimpScanConvert     GimpScanConvert;
 typedef struct _GimpTempBuf         GimpTempBuf;
+typedef struct _GimpUndoTiles       GimpUndoTiles;
 typedef         guint32             GimpTattoo;
 
 /* The following hack is made so that we can reuse the definition
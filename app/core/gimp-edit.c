@@ -45,6 +45,7 @@
 #include "gimppickable.h"
 #include "gimpselection.h"
 #include "gimptempbuf.h"
+#include "gimpundotiles.h"
 
 #include "gimp-intl.h"
 
@@ -573,8 +574,8 @@ gimp_edit_fade (GimpImage   *image,
 
       gimp_drawable_apply_buffer (drawable, buffer,
                                   GEGL_RECTANGLE (0, 0,
-                                                  gegl_buffer_get_width (undo->buffer),
-                                                  gegl_buffer_get_height (undo->buffer)),
+                                                  gimp_undo_tiles_get_width (undo->tiles),
+                                                  gimp_undo_tiles_get_height (undo->tiles)),
                                   TRUE,
                                   gimp_object_get_name (undo),
                                   gimp_context_get_opacity (context),
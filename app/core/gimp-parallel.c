@@ -0,0 +1,368 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimp-parallel.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <gegl.h>
+
+#include "core-types.h"
+
+#include "config/gimpgeglconfig.h"
+
+#include "gimp.h"
+#include "gimp-parallel.h"
+
+
+/*  GEGL's own threading is not enabled (see gimp_gegl_init()), so
+ *  work that can be split into independent pieces is distributed over
+ *  a pool of "num-processors" - 1 threads here, the calling thread
+ *  always processes the first piece itself.
+ *
+ *  The calling thread blocks until all pieces are done, so the core's
+ *  data structures can't change under the workers' feet.  Calls made
+ *  from within a worker are run serially.
+ *
+ *  Since GEGL is single-threaded, workers must not touch any GeglBuffer
+ *  or GeglNode: the calling thread reads the pixels into linear memory,
+ *  the workers only process that memory, and the calling thread writes
+ *  the result back.
+ */
+
+#define GIMP_PARALLEL_MAX_THREADS 64
+
+
+typedef struct _GimpParallelTask GimpParallelTask;
+typedef struct _GimpParallelItem GimpParallelItem;
+
+struct _GimpParallelTask
+{
+  GimpParallelDistributeFunc  func;
+  gpointer                    user_data;
+  gint                        n;
+
+  GMutex                      mutex;
+  GCond                       cond;
+  gint                        remaining;
+};
+
+struct _GimpParallelItem
+{
+  GimpParallelTask *task;
+  gint              i;
+};
+
+typedef struct
+{
+  GimpParallelDistributeRangeFunc func;
+  gpointer                        user_data;
+  gsize                           size;
+} GimpParallelRangeData;
+
+typedef struct
+{
+  GimpParallelDistributeAreaFunc  func;
+  gpointer                        user_data;
+  const GeglRectangle            *area;
+  gboolean                        vertical;
+} GimpParallelAreaData;
+
+
+/*  local function prototypes  */
+
+static void   gimp_parallel_notify_num_processors (GimpGeglConfig *config);
+static void   gimp_parallel_set_n_threads         (gint            n_threads);
+static void   gimp_parallel_worker_func           (gpointer        data,
+                                                   gpointer        user_data);
+static void   gimp_parallel_range_func            (gint            i,
+                                                   gint            n,
+                                                   gpointer        user_data);
+static void   gimp_parallel_area_func             (gint            i,
+                                                   gint            n,
+                                                   gpointer        user_data);
+
+
+/*  local variables  */
+
+static GThreadPool *gimp_parallel_pool      = NULL;
+static gint         gimp_parallel_n_threads = 1;
+static GPrivate     gimp_parallel_in_worker = G_PRIVATE_INIT (NULL);
+
+
+/*  public functions  */
+
+void
+gimp_parallel_init (Gimp *gimp)
+{
+  GimpGeglConfig *config;
+
+  g_return_if_fail (GIMP_IS_GIMP (gimp));
+
+  config = GIMP_GEGL_CONFIG (gimp->config);
+
+  gimp_parallel_set_n_threads (config->num_processors);
+
+  g_signal_connect (config, "notify::num-processors",
+                    G_CALLBACK (gimp_parallel_notify_num_processors),
+                    NULL);
+}
+
+void
+gimp_parallel_exit (Gimp *gimp)
+{
+  g_return_if_fail (GIMP_IS_GIMP (gimp));
+
+  g_signal_handlers_disconnect_by_func (gimp->config,
+                                        gimp_parallel_notify_num_processors,
+                                        NULL);
+
+  if (gimp_parallel_pool)
+    {
+      g_thread_pool_free (gimp_parallel_pool, FALSE, TRUE);
+      gimp_parallel_pool = NULL;
+    }
+
+  gimp_parallel_n_threads = 1;
+}
+
+gint
+gimp_parallel_get_n_threads (void)
+{
+  return gimp_parallel_n_threads;
+}
+
+void
+gimp_parallel_distribute (gint                       max_n,
+                          GimpParallelDistributeFunc func,
+                          gpointer                   user_data)
+{
+  GimpParallelTask task;
+  GimpParallelItem items[GIMP_PARALLEL_MAX_THREADS];
+  gint             i;
+
+  g_return_if_fail (func != NULL);
+
+  if (max_n == 0)
+    return;
+
+  if (max_n < 0)
+    max_n = gimp_parallel_n_threads;
+  else
+    max_n = MIN (max_n, gimp_parallel_n_threads);
+
+  if (max_n == 1 || ! gimp_parallel_pool ||
+      g_private_get (&gimp_parallel_in_worker))
+    {
+      func (0, 1, user_data);
+
+      return;
+    }
+
+  task.func      = func;
+  task.user_data = user_data;
+  task.n         = max_n;
+  task.remaining = max_n - 1;
+
+  g_mutex_init (&task.mutex);
+  g_cond_init (&task.cond);
+
+  for (i = 1; i < max_n; i++)
+    {
+      items[i].task = &task;
+      items[i].i    = i;
+
+      g_thread_pool_push (gimp_parallel_pool, &items[i], NULL);
+    }
+
+  func (0, max_n, user_data);
+
+  g_mutex_lock (&task.mutex);
+
+  while (task.remaining > 0)
+    g_cond_wait (&task.cond, &task.mutex);
+
+  g_mutex_unlock (&task.mutex);
+
+  g_cond_clear (&task.cond);
+  g_mutex_clear (&task.mutex);
+}
+
+void
+gimp_parallel_distribute_range (gsize                           size,
+                                gsize                           min_sub_size,
+                                GimpParallelDistributeRangeFunc func,
+                                gpointer                        user_data)
+{
+  GimpParallelRangeData data;
+  gsize                 n;
+
+  g_return_if_fail (func != NULL);
+
+  if (size == 0)
+    return;
+
+  n = size;
+
+  if (min_sub_size > 1)
+    n /= min_sub_size;
+
+  n = CLAMP (n, 1, gimp_parallel_n_threads);
+
+  if (n == 1)
+    {
+      func (0, size, user_data);
+
+      return;
+    }
+
+  data.func      = func;
+  data.user_data = user_data;
+  data.size      = size;
+
+  gimp_parallel_distribute (n, gimp_parallel_range_func, &data);
+}
+
+void
+gimp_parallel_distribute_area (const GeglRectangle            *area,
+                               gsize                           min_sub_area,
+                               GimpParallelDistributeAreaFunc  func,
+                               gpointer                        user_data)
+{
+  GimpParallelAreaData data;
+  gsize                n;
+
+  g_return_if_fail (area != NULL);
+  g_return_if_fail (func != NULL);
+
+  if (area->width <= 0 || area->height <= 0)
+    return;
+
+  n = (gsize) area->width * (gsize) area->height;
+
+  if (min_sub_area > 1)
+    n /= min_sub_area;
+
+  n = CLAMP (n, 1, gimp_parallel_n_threads);
+
+  if (n == 1)
+    {
+      func (area, user_data);
+
+      return;
+    }
+
+  data.func      = func;
+  data.user_data = user_data;
+  data.area      = area;
+  data.vertical  = area->height >= area->width;
+
+  gimp_parallel_distribute (n, gimp_parallel_area_func, &data);
+}
+
+
+/*  private functions  */
+
+static void
+gimp_parallel_notify_num_processors (GimpGeglConfig *config)
+{
+  gimp_parallel_set_n_threads (config->num_processors);
+}
+
+static void
+gimp_parallel_set_n_threads (gint n_threads)
+{
+  n_threads = CLAMP (n_threads, 1, GIMP_PARALLEL_MAX_THREADS);
+
+  if (n_threads > 1)
+    {
+      if (! gimp_parallel_pool)
+        {
+          gimp_parallel_pool = g_thread_pool_new (gimp_parallel_worker_func,
+                                                  NULL,
+                                                  n_threads - 1, TRUE,
+                                                  NULL);
+        }
+      else
+        {
+          g_thread_pool_set_max_threads (gimp_parallel_pool,
+                                         n_threads - 1, NULL);
+        }
+    }
+
+  gimp_parallel_n_threads = n_threads;
+}
+
+static void
+gimp_parallel_worker_func (gpointer data,
+                           gpointer user_data)
+{
+  GimpParallelItem *item = data;
+  GimpParallelTask *task = item->task;
+
+  g_private_set (&gimp_parallel_in_worker, GINT_TO_POINTER (TRUE));
+
+  task->func (item->i, task->n, task->user_data);
+
+  g_mutex_lock (&task->mutex);
+
+  if (--task->remaining == 0)
+    g_cond_signal (&task->cond);
+
+  g_mutex_unlock (&task->mutex);
+}
+
+static void
+gimp_parallel_range_func (gint     i,
+                          gint     n,
+                          gpointer user_data)
+{
+  GimpParallelRangeData *data = user_data;
+  gsize                  offset;
+  gsize                  end;
+
+  offset = data->size * i       / n;
+  end    = data->size * (i + 1) / n;
+
+  if (end > offset)
+    data->func (offset, end - offset, data->user_data);
+}
+
+static void
+gimp_parallel_area_func (gint     i,
+                         gint     n,
+                         gpointer user_data)
+{
+  GimpParallelAreaData *data = user_data;
+  GeglRectangle         sub_area = *data->area;
+
+  if (data->vertical)
+    {
+      sub_area.y      = data->area->y + data->area->height * i       / n;
+      sub_area.height = data->area->y + data->area->height * (i + 1) / n -
+                        sub_area.y;
+    }
+  else
+    {
+      sub_area.x      = data->area->x + data->area->width * i       / n;
+      sub_area.width  = data->area->x + data->area->width * (i + 1) / n -
+                        sub_area.x;
+    }
+
+  if (sub_area.width > 0 && sub_area.height > 0)
+    data->func (&sub_area, data->user_data);
+}
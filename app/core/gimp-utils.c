@@ -57,6 +57,8 @@
 
 #include "core-types.h"
 
+#include "gegl/gimp-gegl-cow.h"
+
 #include "gimp.h"
 #include "gimp-utils.h"
 #include "gimpcontainer.h"
@@ -291,6 +293,15 @@ gimp_gegl_buffer_get_memsize (GeglBuffer *buffer)
   if (buffer)
     {
       const Babl *format = gegl_buffer_get_format (buffer);
+      gint64      unique_size;
+      gint64      shared_size;
+
+      /*  tiles shared copy-on-write with other buffers are counted
+       *  only partially, so their sum matches the memory really used
+       */
+      if (gimp_gegl_buffer_get_cow_size (buffer, &unique_size, &shared_size))
+        return (unique_size + shared_size +
+                gimp_g_object_get_memsize (G_OBJECT (buffer)));
 
       return (babl_format_get_bytes_per_pixel (format) *
               gegl_buffer_get_width (buffer) *
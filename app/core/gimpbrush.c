@@ -79,6 +79,8 @@ static gchar       * gimp_brush_get_description       (GimpViewable         *vie
 
 static void          gimp_brush_dirty                 (GimpData             *data);
 static const gchar * gimp_brush_get_extension         (GimpData             *data);
+static gboolean      gimp_brush_load_contents         (GimpData             *data,
+                                                       GError              **error);
 
 static void          gimp_brush_real_begin_use        (GimpBrush            *brush);
 static void          gimp_brush_real_end_use          (GimpBrush            *brush);
@@ -91,6 +93,13 @@ static gboolean      gimp_brush_real_want_null_motion (GimpBrush            *bru
 
 static gchar       * gimp_brush_get_checksum          (GimpTagged           *tagged);
 
+static gsize         gimp_brush_temp_buf_get_memsize  (gconstpointer         temp_buf);
+static gsize         gimp_brush_boundary_get_memsize  (gconstpointer         boundary);
+
+static GimpTempBuf * gimp_brush_get_stub_preview      (GimpBrush            *brush,
+                                                       gint                  width,
+                                                       gint                  height);
+
 
 G_DEFINE_TYPE_WITH_CODE (GimpBrush, gimp_brush, GIMP_TYPE_DATA,
                          G_IMPLEMENT_INTERFACE (GIMP_TYPE_TAGGED,
@@ -131,6 +140,7 @@ gimp_brush_class_init (GimpBrushClass *klass)
 
   data_class->dirty                = gimp_brush_dirty;
   data_class->get_extension        = gimp_brush_get_extension;
+  data_class->load_contents        = gimp_brush_load_contents;
 
   klass->begin_use                 = gimp_brush_real_begin_use;
   klass->end_use                   = gimp_brush_real_end_use;
@@ -238,7 +248,7 @@ gimp_brush_get_property (GObject    *object,
   switch (property_id)
     {
     case PROP_SPACING:
-      g_value_set_double (value, brush->spacing);
+      g_value_set_double (value, gimp_brush_get_spacing (brush));
       break;
 
     default:
@@ -268,6 +278,9 @@ gimp_brush_get_size (GimpViewable *viewable,
 {
   GimpBrush *brush = GIMP_BRUSH (viewable);
 
+  if (gimp_data_get_stub_size (GIMP_DATA (brush), width, height))
+    return TRUE;
+
   *width  = gimp_temp_buf_get_width  (brush->mask);
   *height = gimp_temp_buf_get_height (brush->mask);
 
@@ -291,6 +304,16 @@ gimp_brush_get_new_preview (GimpViewable *viewable,
   gint               x, y;
   gboolean           scaled = FALSE;
 
+  if (gimp_data_is_stub (GIMP_DATA (brush)))
+    {
+      return_buf = gimp_brush_get_stub_preview (brush, width, height);
+
+      if (return_buf)
+        return return_buf;
+
+      gimp_data_ensure_loaded (GIMP_DATA (brush));
+    }
+
   mask_buf   = brush->mask;
   pixmap_buf = brush->pixmap;
 
@@ -382,11 +405,14 @@ gimp_brush_get_description (GimpViewable  *viewable,
                             gchar        **tooltip)
 {
   GimpBrush *brush = GIMP_BRUSH (viewable);
+  gint       width;
+  gint       height;
+
+  gimp_brush_get_size (viewable, &width, &height);
 
   return g_strdup_printf ("%s (%d × %d)",
                           gimp_object_get_name (brush),
-                          gimp_temp_buf_get_width  (brush->mask),
-                          gimp_temp_buf_get_height (brush->mask));
+                          width, height);
 }
 
 static void
@@ -412,17 +438,58 @@ gimp_brush_get_extension (GimpData *data)
   return GIMP_BRUSH_FILE_EXTENSION;
 }
 
+static gboolean
+gimp_brush_load_contents (GimpData  *data,
+                          GError   **error)
+{
+  GimpBrush *brush = GIMP_BRUSH (data);
+  GimpBrush *loaded;
+  GList     *list;
+
+  list = gimp_brush_load (NULL, gimp_data_get_filename (data), error);
+
+  if (! list)
+    {
+      /*  keep the brush usable, with an empty mask  */
+      brush->mask = gimp_temp_buf_new (1, 1, babl_format ("Y u8"));
+      gimp_temp_buf_data_clear (brush->mask);
+
+      return FALSE;
+    }
+
+  loaded = list->data;
+
+  brush->mask    = loaded->mask;
+  brush->pixmap  = loaded->pixmap;
+  loaded->mask   = NULL;
+  loaded->pixmap = NULL;
+
+  brush->spacing = loaded->spacing;
+  brush->x_axis  = loaded->x_axis;
+  brush->y_axis  = loaded->y_axis;
+
+  g_list_free_full (list, (GDestroyNotify) g_object_unref);
+
+  return TRUE;
+}
+
 static void
 gimp_brush_real_begin_use (GimpBrush *brush)
 {
   brush->mask_cache =
-    gimp_brush_cache_new ((GDestroyNotify) gimp_temp_buf_unref, 'M', 'm');
+    gimp_brush_cache_new ((GDestroyNotify) gimp_temp_buf_unref,
+                          gimp_brush_temp_buf_get_memsize,
+                          'M', 'm');
 
   brush->pixmap_cache =
-    gimp_brush_cache_new ((GDestroyNotify) gimp_temp_buf_unref, 'P', 'p');
+    gimp_brush_cache_new ((GDestroyNotify) gimp_temp_buf_unref,
+                          gimp_brush_temp_buf_get_memsize,
+                          'P', 'p');
 
   brush->boundary_cache =
-    gimp_brush_cache_new ((GDestroyNotify) gimp_bezier_desc_free, 'B', 'b');
+    gimp_brush_cache_new ((GDestroyNotify) gimp_bezier_desc_free,
+                          gimp_brush_boundary_get_memsize,
+                          'B', 'b');
 }
 
 static void
@@ -460,6 +527,9 @@ gimp_brush_get_checksum (GimpTagged *tagged)
   GimpBrush *brush           = GIMP_BRUSH (tagged);
   gchar     *checksum_string = NULL;
 
+  if (gimp_data_is_stub (GIMP_DATA (brush)))
+    return g_strdup (gimp_data_get_stub_checksum (GIMP_DATA (brush)));
+
   if (brush->mask)
     {
       GChecksum *checksum = g_checksum_new (G_CHECKSUM_MD5);
@@ -481,6 +551,66 @@ gimp_brush_get_checksum (GimpTagged *tagged)
   return checksum_string;
 }
 
+static gsize
+gimp_brush_temp_buf_get_memsize (gconstpointer temp_buf)
+{
+  return gimp_temp_buf_get_memsize (temp_buf);
+}
+
+static gsize
+gimp_brush_boundary_get_memsize (gconstpointer boundary)
+{
+  const GimpBezierDesc *desc = boundary;
+
+  return sizeof (GimpBezierDesc) + desc->num_data * sizeof (cairo_path_data_t);
+}
+
+/*  a preview from the one in the data factory's index, as long as
+ *  that is at least as large as the one asked for, or NULL
+ */
+static GimpTempBuf *
+gimp_brush_get_stub_preview (GimpBrush *brush,
+                             gint       width,
+                             gint       height)
+{
+  GimpTempBuf *preview = gimp_data_get_stub_preview (GIMP_DATA (brush));
+  gint         mask_width;
+  gint         mask_height;
+  gint         preview_width;
+  gint         preview_height;
+
+  if (! preview)
+    return NULL;
+
+  gimp_data_get_stub_size (GIMP_DATA (brush), &mask_width, &mask_height);
+
+  preview_width  = gimp_temp_buf_get_width  (preview);
+  preview_height = gimp_temp_buf_get_height (preview);
+
+  if (mask_width > width || mask_height > height)
+    {
+      gdouble ratio_x = (gdouble) width  / (gdouble) mask_width;
+      gdouble ratio_y = (gdouble) height / (gdouble) mask_height;
+      gdouble scale   = MIN (ratio_x, ratio_y);
+
+      width  = MAX (1, ROUND (mask_width  * scale));
+      height = MAX (1, ROUND (mask_height * scale));
+    }
+  else
+    {
+      width  = mask_width;
+      height = mask_height;
+    }
+
+  if (width > preview_width || height > preview_height)
+    return NULL;
+
+  if (width == preview_width && height == preview_height)
+    return gimp_temp_buf_copy (preview);
+
+  return gimp_temp_buf_scale (preview, width, height);
+}
+
 /*  public functions  */
 
 GimpData *
@@ -518,6 +648,8 @@ gimp_brush_begin_use (GimpBrush *brush)
 {
   g_return_if_fail (GIMP_IS_BRUSH (brush));
 
+  gimp_data_ensure_loaded (GIMP_DATA (brush));
+
   brush->use_count++;
 
   if (brush->use_count == 1)
@@ -577,6 +709,8 @@ gimp_brush_transform_size (GimpBrush     *brush,
   g_return_if_fail (width != NULL);
   g_return_if_fail (height != NULL);
 
+  gimp_data_ensure_loaded (GIMP_DATA (brush));
+
   if (scale        == 1.0 &&
       aspect_ratio == 0.0 &&
       ((angle == 0.0) || (angle == 0.5) || (angle == 1.0)))
@@ -747,6 +881,8 @@ gimp_brush_get_mask (const GimpBrush *brush)
   g_return_val_if_fail (brush != NULL, NULL);
   g_return_val_if_fail (GIMP_IS_BRUSH (brush), NULL);
 
+  gimp_data_ensure_loaded (GIMP_DATA (brush));
+
   return brush->mask;
 }
 
@@ -756,6 +892,8 @@ gimp_brush_get_pixmap (const GimpBrush *brush)
   g_return_val_if_fail (brush != NULL, NULL);
   g_return_val_if_fail (GIMP_IS_BRUSH (brush), NULL);
 
+  gimp_data_ensure_loaded (GIMP_DATA (brush));
+
   return brush->pixmap;
 }
 
@@ -764,6 +902,8 @@ gimp_brush_get_spacing (const GimpBrush *brush)
 {
   g_return_val_if_fail (GIMP_IS_BRUSH (brush), 0);
 
+  gimp_data_ensure_loaded (GIMP_DATA (brush));
+
   return brush->spacing;
 }
 
@@ -773,6 +913,8 @@ gimp_brush_set_spacing (GimpBrush *brush,
 {
   g_return_if_fail (GIMP_IS_BRUSH (brush));
 
+  gimp_data_ensure_loaded (GIMP_DATA (brush));
+
   if (brush->spacing != spacing)
     {
       brush->spacing = spacing;
@@ -22,6 +22,8 @@
 
 #include <gegl.h>
 
+#include "libgimpmath/gimpmath.h"
+
 #include "core-types.h"
 
 #include "gimpbrushcache.h"
@@ -30,23 +32,72 @@
 #include "gimp-intl.h"
 
 
+/*  the transform parameters are quantized, so transforms that only
+ *  differ by a tiny bit, like those of jittering paint dynamics, share
+ *  the same cached data
+ */
+#define SCALE_STEPS        500.0  /* logarithmic, steps of 0.2%      */
+#define ASPECT_RATIO_STEPS 100.0  /* per unit                        */
+#define ANGLE_STEPS        1440   /* per full turn, i.e. 0.25°       */
+#define HARDNESS_STEPS     1000.0 /* per unit                        */
+
+
 enum
 {
   PROP_0,
-  PROP_DATA_DESTROY
+  PROP_DATA_DESTROY,
+  PROP_DATA_MEMSIZE
 };
 
 
-static void   gimp_brush_cache_constructed  (GObject      *object);
-static void   gimp_brush_cache_finalize     (GObject      *object);
-static void   gimp_brush_cache_set_property (GObject      *object,
-                                             guint         property_id,
-                                             const GValue *value,
-                                             GParamSpec   *pspec);
-static void   gimp_brush_cache_get_property (GObject      *object,
-                                             guint         property_id,
-                                             GValue       *value,
-                                             GParamSpec   *pspec);
+typedef struct _GimpBrushCacheKey   GimpBrushCacheKey;
+typedef struct _GimpBrushCacheEntry GimpBrushCacheEntry;
+
+struct _GimpBrushCacheKey
+{
+  gint width;
+  gint height;
+  gint scale;
+  gint aspect_ratio;
+  gint angle;
+  gint hardness;
+};
+
+struct _GimpBrushCacheEntry
+{
+  GimpBrushCacheKey key;
+  gpointer          data;
+  gsize             size;
+};
+
+
+static void     gimp_brush_cache_constructed  (GObject             *object);
+static void     gimp_brush_cache_finalize     (GObject             *object);
+static void     gimp_brush_cache_set_property (GObject             *object,
+                                               guint                property_id,
+                                               const GValue        *value,
+                                               GParamSpec          *pspec);
+static void     gimp_brush_cache_get_property (GObject             *object,
+                                               guint                property_id,
+                                               GValue              *value,
+                                               GParamSpec          *pspec);
+
+static gint64   gimp_brush_cache_get_memsize  (GimpObject          *object,
+                                               gint64              *gui_size);
+
+static void     gimp_brush_cache_make_key     (GimpBrushCacheKey   *key,
+                                               gint                 width,
+                                               gint                 height,
+                                               gdouble              scale,
+                                               gdouble              aspect_ratio,
+                                               gdouble              angle,
+                                               gdouble              hardness);
+static guint    gimp_brush_cache_key_hash     (gconstpointer        key);
+static gboolean gimp_brush_cache_key_equal    (gconstpointer        key1,
+                                               gconstpointer        key2);
+static void     gimp_brush_cache_remove_entry (GimpBrushCache      *cache,
+                                               GList               *link);
+static void     gimp_brush_cache_log_stats    (GimpBrushCache      *cache);
 
 
 G_DEFINE_TYPE (GimpBrushCache, gimp_brush_cache, GIMP_TYPE_OBJECT)
@@ -54,26 +105,42 @@ G_DEFINE_TYPE (GimpBrushCache, gimp_brush_cache, GIMP_TYPE_OBJECT)
 #define parent_class gimp_brush_cache_parent_class
 
 
+static gsize gimp_brush_cache_max_size = 1 << 24;
+
+
 static void
 gimp_brush_cache_class_init (GimpBrushCacheClass *klass)
 {
-  GObjectClass  *object_class = G_OBJECT_CLASS (klass);
+  GObjectClass    *object_class      = G_OBJECT_CLASS (klass);
+  GimpObjectClass *gimp_object_class = GIMP_OBJECT_CLASS (klass);
 
-  object_class->constructed  = gimp_brush_cache_constructed;
-  object_class->finalize     = gimp_brush_cache_finalize;
-  object_class->set_property = gimp_brush_cache_set_property;
-  object_class->get_property = gimp_brush_cache_get_property;
+  object_class->constructed     = gimp_brush_cache_constructed;
+  object_class->finalize        = gimp_brush_cache_finalize;
+  object_class->set_property    = gimp_brush_cache_set_property;
+  object_class->get_property    = gimp_brush_cache_get_property;
+
+  gimp_object_class->get_memsize = gimp_brush_cache_get_memsize;
 
   g_object_class_install_property (object_class, PROP_DATA_DESTROY,
                                    g_param_spec_pointer ("data-destroy",
                                                          NULL, NULL,
                                                          GIMP_PARAM_READWRITE |
                                                          G_PARAM_CONSTRUCT_ONLY));
+
+  g_object_class_install_property (object_class, PROP_DATA_MEMSIZE,
+                                   g_param_spec_pointer ("data-memsize",
+                                                         NULL, NULL,
+                                                         GIMP_PARAM_READWRITE |
+                                                         G_PARAM_CONSTRUCT_ONLY));
 }
 
 static void
-gimp_brush_cache_init (GimpBrushCache *brush)
+gimp_brush_cache_init (GimpBrushCache *cache)
 {
+  cache->entries = g_hash_table_new (gimp_brush_cache_key_hash,
+                                     gimp_brush_cache_key_equal);
+
+  g_queue_init (&cache->lru);
 }
 
 static void
@@ -84,6 +151,7 @@ gimp_brush_cache_constructed (GObject *object)
   G_OBJECT_CLASS (parent_class)->constructed (object);
 
   g_assert (cache->data_destroy != NULL);
+  g_assert (cache->data_memsize != NULL);
 }
 
 static void
@@ -91,10 +159,12 @@ gimp_brush_cache_finalize (GObject *object)
 {
   GimpBrushCache *cache = GIMP_BRUSH_CACHE (object);
 
-  if (cache->last_data)
+  gimp_brush_cache_clear (cache);
+
+  if (cache->entries)
     {
-      cache->data_destroy (cache->last_data);
-      cache->last_data = NULL;
+      g_hash_table_unref (cache->entries);
+      cache->entries = NULL;
     }
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
@@ -114,6 +184,10 @@ gimp_brush_cache_set_property (GObject      *object,
       cache->data_destroy = g_value_get_pointer (value);
       break;
 
+    case PROP_DATA_MEMSIZE:
+      cache->data_memsize = g_value_get_pointer (value);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -134,26 +208,48 @@ gimp_brush_cache_get_property (GObject    *object,
       g_value_set_pointer (value, cache->data_destroy);
       break;
 
+    case PROP_DATA_MEMSIZE:
+      g_value_set_pointer (value, cache->data_memsize);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
     }
 }
 
+static gint64
+gimp_brush_cache_get_memsize (GimpObject *object,
+                              gint64     *gui_size)
+{
+  GimpBrushCache *cache   = GIMP_BRUSH_CACHE (object);
+  gint64          memsize = 0;
+
+  memsize += cache->size;
+  memsize += cache->lru.length * (sizeof (GimpBrushCacheEntry) +
+                                  sizeof (GList));
+
+  return memsize + GIMP_OBJECT_CLASS (parent_class)->get_memsize (object,
+                                                                  gui_size);
+}
+
 
 /*  public functions  */
 
 GimpBrushCache *
-gimp_brush_cache_new (GDestroyNotify  data_destroy,
-                      gchar           debug_hit,
-                      gchar           debug_miss)
+gimp_brush_cache_new (GDestroyNotify            data_destroy,
+                      GimpBrushCacheMemsizeFunc data_memsize,
+                      gchar                     debug_hit,
+                      gchar                     debug_miss)
 {
   GimpBrushCache *cache;
 
   g_return_val_if_fail (data_destroy != NULL, NULL);
+  g_return_val_if_fail (data_memsize != NULL, NULL);
 
   cache =  g_object_new (GIMP_TYPE_BRUSH_CACHE,
                          "data-destroy", data_destroy,
+                         "data-memsize", data_memsize,
                          NULL);
 
   cache->debug_hit  = debug_hit;
@@ -167,11 +263,10 @@ gimp_brush_cache_clear (GimpBrushCache *cache)
 {
   g_return_if_fail (GIMP_IS_BRUSH_CACHE (cache));
 
-  if (cache->last_data)
-    {
-      cache->data_destroy (cache->last_data);
-      cache->last_data = NULL;
-    }
+  gimp_brush_cache_log_stats (cache);
+
+  while (cache->lru.head)
+    gimp_brush_cache_remove_entry (cache, cache->lru.head);
 }
 
 gconstpointer
@@ -183,22 +278,37 @@ gimp_brush_cache_get (GimpBrushCache *cache,
                       gdouble         angle,
                       gdouble         hardness)
 {
+  GimpBrushCacheKey  key;
+  GList             *link;
+
   g_return_val_if_fail (GIMP_IS_BRUSH_CACHE (cache), NULL);
 
-  if (cache->last_data                         &&
-      cache->last_width        == width        &&
-      cache->last_height       == height       &&
-      cache->last_scale        == scale        &&
-      cache->last_aspect_ratio == aspect_ratio &&
-      cache->last_angle        == angle        &&
-      cache->last_hardness     == hardness)
+  gimp_brush_cache_make_key (&key,
+                             width, height,
+                             scale, aspect_ratio, angle, hardness);
+
+  link = g_hash_table_lookup (cache->entries, &key);
+
+  if (link)
     {
+      GimpBrushCacheEntry *entry = link->data;
+
+      cache->n_hits++;
+
       if (gimp_log_flags & GIMP_LOG_BRUSH_CACHE)
         g_printerr ("%c", cache->debug_hit);
 
-      return (gconstpointer) cache->last_data;
+      if (link != cache->lru.head)
+        {
+          g_queue_unlink (&cache->lru, link);
+          g_queue_push_head_link (&cache->lru, link);
+        }
+
+      return (gconstpointer) entry->data;
     }
 
+  cache->n_misses++;
+
   if (gimp_log_flags & GIMP_LOG_BRUSH_CACHE)
     g_printerr ("%c", cache->debug_miss);
 
@@ -215,20 +325,138 @@ gimp_brush_cache_add (GimpBrushCache *cache,
                       gdouble         angle,
                       gdouble         hardness)
 {
+  GimpBrushCacheEntry *entry;
+  GimpBrushCacheKey    key;
+  GList               *link;
+
   g_return_if_fail (GIMP_IS_BRUSH_CACHE (cache));
   g_return_if_fail (data != NULL);
 
-  if (data == cache->last_data)
-    return;
+  gimp_brush_cache_make_key (&key,
+                             width, height,
+                             scale, aspect_ratio, angle, hardness);
+
+  link = g_hash_table_lookup (cache->entries, &key);
 
-  if (cache->last_data)
-    cache->data_destroy (cache->last_data);
+  if (link)
+    {
+      entry = link->data;
+
+      if (data == entry->data)
+        return;
+
+      gimp_brush_cache_remove_entry (cache, link);
+    }
+
+  entry = g_slice_new (GimpBrushCacheEntry);
+
+  entry->key  = key;
+  entry->data = data;
+  entry->size = cache->data_memsize (data);
+
+  g_queue_push_head (&cache->lru, entry);
+  g_hash_table_insert (cache->entries, &entry->key, cache->lru.head);
+
+  cache->size += entry->size;
+
+  /*  evict the least recently used entries, but always keep the new one  */
+  while (cache->size > gimp_brush_cache_max_size &&
+         cache->lru.length > 1)
+    {
+      gimp_brush_cache_remove_entry (cache, cache->lru.tail);
+    }
+}
+
+void
+gimp_brush_cache_set_max_size (gsize max_size)
+{
+  gimp_brush_cache_max_size = max_size;
+}
+
+
+/*  private functions  */
+
+static void
+gimp_brush_cache_make_key (GimpBrushCacheKey *key,
+                           gint               width,
+                           gint               height,
+                           gdouble            scale,
+                           gdouble            aspect_ratio,
+                           gdouble            angle,
+                           gdouble            hardness)
+{
+  key->width        = width;
+  key->height       = height;
+  key->scale        = RINT (log (scale) * SCALE_STEPS);
+  key->aspect_ratio = RINT (aspect_ratio * ASPECT_RATIO_STEPS);
+  key->angle        = (gint) RINT (angle * ANGLE_STEPS) % ANGLE_STEPS;
+  key->hardness     = RINT (hardness * HARDNESS_STEPS);
+
+  if (key->angle < 0)
+    key->angle += ANGLE_STEPS;
+}
+
+static guint
+gimp_brush_cache_key_hash (gconstpointer key)
+{
+  const GimpBrushCacheKey *k = key;
+  guint                    hash;
+
+  hash = k->width;
+  hash = hash * 31 + k->height;
+  hash = hash * 31 + k->scale;
+  hash = hash * 31 + k->aspect_ratio;
+  hash = hash * 31 + k->angle;
+  hash = hash * 31 + k->hardness;
+
+  return hash;
+}
 
-  cache->last_data         = data;
-  cache->last_width        = width;
-  cache->last_height       = height;
-  cache->last_scale        = scale;
-  cache->last_aspect_ratio = aspect_ratio;
-  cache->last_angle        = angle;
-  cache->last_hardness     = hardness;
+static gboolean
+gimp_brush_cache_key_equal (gconstpointer key1,
+                            gconstpointer key2)
+{
+  const GimpBrushCacheKey *k1 = key1;
+  const GimpBrushCacheKey *k2 = key2;
+
+  return (k1->width        == k2->width        &&
+          k1->height       == k2->height       &&
+          k1->scale        == k2->scale        &&
+          k1->aspect_ratio == k2->aspect_ratio &&
+          k1->angle        == k2->angle        &&
+          k1->hardness     == k2->hardness);
+}
+
+static void
+gimp_brush_cache_remove_entry (GimpBrushCache *cache,
+                               GList          *link)
+{
+  GimpBrushCacheEntry *entry = link->data;
+
+  g_hash_table_remove (cache->entries, &entry->key);
+  g_queue_delete_link (&cache->lru, link);
+
+  cache->size -= entry->size;
+
+  cache->data_destroy (entry->data);
+
+  g_slice_free (GimpBrushCacheEntry, entry);
+}
+
+static void
+gimp_brush_cache_log_stats (GimpBrushCache *cache)
+{
+  if (cache->n_hits || cache->n_misses)
+    {
+      GIMP_LOG (BRUSH_CACHE,
+                "'%c' cache: %" G_GUINT64_FORMAT " hits, "
+                "%" G_GUINT64_FORMAT " misses, %u entries, %" G_GSIZE_FORMAT
+                " bytes",
+                cache->debug_hit,
+                cache->n_hits, cache->n_misses,
+                cache->lru.length, cache->size);
+
+      cache->n_hits   = 0;
+      cache->n_misses = 0;
+    }
 }
@@ -35,22 +35,24 @@
 
 typedef struct _GimpBrushCacheClass GimpBrushCacheClass;
 
+typedef gsize (* GimpBrushCacheMemsizeFunc) (gconstpointer data);
+
 struct _GimpBrushCache
 {
-  GimpObject      parent_instance;
+  GimpObject                 parent_instance;
+
+  GDestroyNotify             data_destroy;
+  GimpBrushCacheMemsizeFunc  data_memsize;
 
-  GDestroyNotify  data_destroy;
+  GHashTable                *entries;  /* key -> link in lru           */
+  GQueue                     lru;      /* most recently used first     */
+  gsize                      size;     /* memsize of all cached data   */
 
-  gpointer        last_data;
-  gint            last_width;
-  gint            last_height;
-  gdouble         last_scale;
-  gdouble         last_aspect_ratio;
-  gdouble         last_angle;
-  gdouble         last_hardness;
+  guint64                    n_hits;
+  guint64                    n_misses;
 
-  gchar           debug_hit;
-  gchar           debug_miss;
+  gchar                      debug_hit;
+  gchar                      debug_miss;
 };
 
 struct _GimpBrushCacheClass
@@ -59,29 +61,32 @@ struct _GimpBrushCacheClass
 };
 
 
-GType            gimp_brush_cache_get_type (void) G_GNUC_CONST;
-
-GimpBrushCache * gimp_brush_cache_new      (GDestroyNotify  data_destory,
-                                            gchar           debug_hit,
-                                            gchar           debug_miss);
-
-void             gimp_brush_cache_clear    (GimpBrushCache *cache);
-
-gconstpointer    gimp_brush_cache_get      (GimpBrushCache *cache,
-                                            gint            width,
-                                            gint            height,
-                                            gdouble         scale,
-                                            gdouble         aspect_ratio,
-                                            gdouble         angle,
-                                            gdouble         hardness);
-void             gimp_brush_cache_add      (GimpBrushCache *cache,
-                                            gpointer        data,
-                                            gint            width,
-                                            gint            height,
-                                            gdouble         scale,
-                                            gdouble         aspect_ratio,
-                                            gdouble         angle,
-                                            gdouble         hardness);
+GType            gimp_brush_cache_get_type      (void) G_GNUC_CONST;
+
+GimpBrushCache * gimp_brush_cache_new           (GDestroyNotify             data_destroy,
+                                                 GimpBrushCacheMemsizeFunc  data_memsize,
+                                                 gchar                      debug_hit,
+                                                 gchar                      debug_miss);
+
+void             gimp_brush_cache_clear         (GimpBrushCache            *cache);
+
+gconstpointer    gimp_brush_cache_get           (GimpBrushCache            *cache,
+                                                 gint                       width,
+                                                 gint                       height,
+                                                 gdouble                    scale,
+                                                 gdouble                    aspect_ratio,
+                                                 gdouble                    angle,
+                                                 gdouble                    hardness);
+void             gimp_brush_cache_add           (GimpBrushCache            *cache,
+                                                 gpointer                   data,
+                                                 gint                       width,
+                                                 gint                       height,
+                                                 gdouble                    scale,
+                                                 gdouble                    aspect_ratio,
+                                                 gdouble                    angle,
+                                                 gdouble                    hardness);
+
+void             gimp_brush_cache_set_max_size  (gsize                      max_size);
 
 
 #endif  /*  __GIMP_BRUSH_CACHE_H__  */
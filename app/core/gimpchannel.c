@@ -31,7 +31,6 @@
 #include "paint/gimppaintoptions.h"
 
 #include "gegl/gimp-gegl-apply-operation.h"
-#include "gegl/gimp-gegl-mask.h"
 #include "gegl/gimp-gegl-utils.h"
 
 #include "gimp.h"
@@ -48,6 +47,7 @@
 #include "gimpcontext.h"
 #include "gimpdrawable-stroke.h"
 #include "gimpmarshal.h"
+#include "gimpmasktiles.h"
 #include "gimppaintinfo.h"
 #include "gimppickable.h"
 #include "gimpstrokeoptions.h"
@@ -364,6 +364,12 @@ gimp_channel_finalize (GObject *object)
       channel->segs_out = NULL;
     }
 
+  if (channel->tiles)
+    {
+      gimp_mask_tiles_free (channel->tiles);
+      channel->tiles = NULL;
+    }
+
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
@@ -376,6 +382,9 @@ gimp_channel_get_memsize (GimpObject *object,
   *gui_size += channel->num_segs_in  * sizeof (GimpBoundSeg);
   *gui_size += channel->num_segs_out * sizeof (GimpBoundSeg);
 
+  if (channel->tiles)
+    *gui_size += gimp_mask_tiles_get_memsize (channel->tiles);
+
   return GIMP_OBJECT_CLASS (parent_class)->get_memsize (object, gui_size);
 }
 
@@ -1038,36 +1047,18 @@ gimp_channel_real_boundary (GimpChannel         *channel,
 
       if (gimp_channel_bounds (channel, &x3, &y3, &x4, &y4))
         {
-          GeglBuffer *buffer;
-          GeglRectangle  rect = { x3, y3, x4 - x3, y4 - y3 };
-
-          buffer = gimp_drawable_get_buffer (GIMP_DRAWABLE (channel));
-
-          channel->segs_out = gimp_boundary_find (buffer, &rect,
-                                                  babl_format ("Y float"),
-                                                  GIMP_BOUNDARY_IGNORE_BOUNDS,
-                                                  x1, y1, x2, y2,
-                                                  GIMP_BOUNDARY_HALF_WAY,
-                                                  &channel->num_segs_out);
-          x1 = MAX (x1, x3);
-          y1 = MAX (y1, y3);
-          x2 = MIN (x2, x4);
-          y2 = MIN (y2, y4);
-
-          if (x2 > x1 && y2 > y1)
-            {
-              channel->segs_in = gimp_boundary_find (buffer, NULL,
-                                                     babl_format ("Y float"),
-                                                     GIMP_BOUNDARY_WITHIN_BOUNDS,
-                                                     x1, y1, x2, y2,
-                                                     GIMP_BOUNDARY_HALF_WAY,
-                                                     &channel->num_segs_in);
-            }
-          else
-            {
-              channel->segs_in     = NULL;
-              channel->num_segs_in = 0;
-            }
+          GeglBuffer *buffer = gimp_drawable_get_buffer (GIMP_DRAWABLE (channel));
+
+          if (! channel->tiles)
+            channel->tiles = gimp_mask_tiles_new ();
+
+          /*  only the tiles changed since the last call are scanned  */
+          gimp_mask_tiles_boundary (channel->tiles, buffer,
+                                    x1, y1, x2, y2,
+                                    &channel->segs_in,
+                                    &channel->num_segs_in,
+                                    &channel->segs_out,
+                                    &channel->num_segs_out);
         }
       else
         {
@@ -1110,7 +1101,11 @@ gimp_channel_real_bounds (GimpChannel *channel,
 
   buffer = gimp_drawable_get_buffer (GIMP_DRAWABLE (channel));
 
-  channel->empty = ! gimp_gegl_mask_bounds (buffer, x1, y1, x2, y2);
+  if (! channel->tiles)
+    channel->tiles = gimp_mask_tiles_new ();
+
+  channel->empty = ! gimp_mask_tiles_bounds (channel->tiles, buffer,
+                                             x1, y1, x2, y2);
 
   channel->x1 = *x1;
   channel->y1 = *y1;
@@ -1125,14 +1120,15 @@ gimp_channel_real_bounds (GimpChannel *channel,
 static gboolean
 gimp_channel_real_is_empty (GimpChannel *channel)
 {
-  GeglBuffer *buffer;
+  gint x1, y1, x2, y2;
 
   if (channel->bounds_known)
     return channel->empty;
 
-  buffer = gimp_drawable_get_buffer (GIMP_DRAWABLE (channel));
-
-  if (! gimp_gegl_mask_is_empty (buffer))
+  /*  the bounds are cached per tile, so this is cheaper than
+   *  scanning the whole mask for a non-empty pixel
+   */
+  if (gimp_channel_real_bounds (channel, &x1, &y1, &x2, &y2))
     return FALSE;
 
   /*  The mask is empty, meaning we can set the bounds as known  */
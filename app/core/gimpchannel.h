@@ -53,6 +53,7 @@ struct _GimpChannel
   gboolean      bounds_known;      /*  recalculate the bounds?        */
   gint          x1, y1;            /*  coordinates for bounding box   */
   gint          x2, y2;            /*  lower right hand coordinate    */
+  GimpMaskTiles *tiles;            /*  per tile bounds and boundary   */
 };
 
 struct _GimpChannelClass
@@ -2616,6 +2616,9 @@ gimp_context_real_set_brush (GimpContext *context,
     {
       g_object_ref (brush);
 
+      /*  a lazily loaded brush is used from now on  */
+      gimp_data_ensure_loaded (GIMP_DATA (brush));
+
       g_signal_connect_object (brush, "name-changed",
                                G_CALLBACK (gimp_context_brush_dirty),
                                context,
@@ -2854,6 +2857,9 @@ gimp_context_real_set_pattern (GimpContext *context,
     {
       g_object_ref (pattern);
 
+      /*  a lazily loaded pattern is used from now on  */
+      gimp_data_ensure_loaded (GIMP_DATA (pattern));
+
       g_signal_connect_object (pattern, "name-changed",
                                G_CALLBACK (gimp_context_pattern_dirty),
                                context,
@@ -43,6 +43,7 @@
 #include "gimpmarshal.h"
 #include "gimptag.h"
 #include "gimptagged.h"
+#include "gimptempbuf.h"
 
 #include "gimp-intl.h"
 
@@ -63,8 +64,20 @@ enum
 };
 
 
+typedef struct _GimpDataStub    GimpDataStub;
 typedef struct _GimpDataPrivate GimpDataPrivate;
 
+/*  what a data factory's index knows about a data object whose
+ *  contents are not loaded yet
+ */
+struct _GimpDataStub
+{
+  gint         width;
+  gint         height;
+  gchar       *checksum;
+  GimpTempBuf *preview;
+};
+
 struct _GimpDataPrivate
 {
   gchar  *filename;
@@ -82,6 +95,8 @@ struct _GimpDataPrivate
   gchar  *identifier;
 
   GList  *tags;
+
+  GimpDataStub *stub;
 };
 
 #define GIMP_DATA_GET_PRIVATE(data) \
@@ -119,6 +134,8 @@ static GList *   gimp_data_get_tags          (GimpTagged          *tagged);
 static gchar *   gimp_data_get_identifier    (GimpTagged          *tagged);
 static gchar *   gimp_data_get_checksum      (GimpTagged          *tagged);
 
+static void      gimp_data_stub_free         (GimpDataStub        *stub);
+
 
 static guint data_signals[LAST_SIGNAL] = { 0 };
 
@@ -191,6 +208,7 @@ gimp_data_class_init (GimpDataClass *klass)
   klass->save                     = NULL;
   klass->get_extension            = NULL;
   klass->duplicate                = NULL;
+  klass->load_contents            = NULL;
 
   g_object_class_install_property (object_class, PROP_FILENAME,
                                    g_param_spec_string ("filename", NULL, NULL,
@@ -277,6 +295,12 @@ gimp_data_finalize (GObject *object)
       private->identifier = NULL;
     }
 
+  if (private->stub)
+    {
+      gimp_data_stub_free (private->stub);
+      private->stub = NULL;
+    }
+
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
@@ -371,6 +395,11 @@ gimp_data_get_memsize (GimpObject *object,
 
   memsize += gimp_string_get_memsize (private->filename);
 
+  if (private->stub)
+    memsize += (sizeof (GimpDataStub) +
+                gimp_string_get_memsize (private->stub->checksum) +
+                gimp_temp_buf_get_memsize (private->stub->preview));
+
   return memsize + GIMP_OBJECT_CLASS (parent_class)->get_memsize (object,
                                                                   gui_size);
 }
@@ -490,6 +519,17 @@ gimp_data_get_checksum (GimpTagged *tagged)
   return NULL;
 }
 
+static void
+gimp_data_stub_free (GimpDataStub *stub)
+{
+  g_free (stub->checksum);
+
+  if (stub->preview)
+    gimp_temp_buf_unref (stub->preview);
+
+  g_slice_free (GimpDataStub, stub);
+}
+
 /**
  * gimp_data_save:
  * @data:  object whose contents are to be saved.
@@ -1019,6 +1059,8 @@ gimp_data_duplicate (GimpData *data)
 {
   g_return_val_if_fail (GIMP_IS_DATA (data), NULL);
 
+  gimp_data_ensure_loaded (data);
+
   if (GIMP_DATA_GET_CLASS (data)->duplicate)
     {
       GimpData        *new     = GIMP_DATA_GET_CLASS (data)->duplicate (data);
@@ -1121,6 +1163,152 @@ gimp_data_compare (GimpData *data1,
                                    (GimpObject *) data2);
 }
 
+/**
+ * gimp_data_set_stub:
+ * @data:     a #GimpData object whose class implements load_contents().
+ * @width:    the width of @data's contents.
+ * @height:   the height of @data's contents.
+ * @checksum: the checksum of @data's contents, or %NULL.
+ * @preview:  a preview of @data's contents, or %NULL.
+ *
+ * Turns @data into a stub, which only knows what its data factory's
+ * index knows about it.  Its contents are loaded from its file by
+ * gimp_data_ensure_loaded() the first time they are needed.
+ **/
+void
+gimp_data_set_stub (GimpData    *data,
+                    gint         width,
+                    gint         height,
+                    const gchar *checksum,
+                    GimpTempBuf *preview)
+{
+  GimpDataPrivate *private;
+
+  g_return_if_fail (GIMP_IS_DATA (data));
+  g_return_if_fail (GIMP_DATA_GET_CLASS (data)->load_contents != NULL);
+  g_return_if_fail (width > 0 && height > 0);
+
+  private = GIMP_DATA_GET_PRIVATE (data);
+
+  if (private->stub)
+    gimp_data_stub_free (private->stub);
+
+  private->stub = g_slice_new0 (GimpDataStub);
+
+  private->stub->width    = width;
+  private->stub->height   = height;
+  private->stub->checksum = g_strdup (checksum);
+
+  if (preview)
+    private->stub->preview = gimp_temp_buf_ref (preview);
+}
+
+gboolean
+gimp_data_is_stub (GimpData *data)
+{
+  GimpDataPrivate *private;
+
+  g_return_val_if_fail (GIMP_IS_DATA (data), FALSE);
+
+  private = GIMP_DATA_GET_PRIVATE (data);
+
+  return private->stub != NULL;
+}
+
+/**
+ * gimp_data_ensure_loaded:
+ * @data: a #GimpData object.
+ *
+ * If @data is a stub, loads its contents from its file.  If that
+ * fails, a message is shown, and @data keeps the placeholder contents
+ * its class' load_contents() left in place, so it can still be used.
+ *
+ * Returns: %FALSE if loading the contents failed.
+ **/
+gboolean
+gimp_data_ensure_loaded (GimpData *data)
+{
+  GimpDataPrivate *private;
+  GimpDataStub    *stub;
+  GError          *error   = NULL;
+  gboolean         success;
+
+  g_return_val_if_fail (GIMP_IS_DATA (data), FALSE);
+
+  private = GIMP_DATA_GET_PRIVATE (data);
+
+  if (! private->stub)
+    return TRUE;
+
+  /*  unset the stub first, load_contents() must see a regular object  */
+  stub = private->stub;
+  private->stub = NULL;
+
+  success = GIMP_DATA_GET_CLASS (data)->load_contents (data, &error);
+
+  if (! success)
+    {
+      g_message (_("Failed to load data:\n\n%s"), error->message);
+      g_clear_error (&error);
+    }
+
+  gimp_data_stub_free (stub);
+
+  return success;
+}
+
+/**
+ * gimp_data_get_stub_size:
+ * @data:   a #GimpData object.
+ * @width:  return location for the width of @data's contents.
+ * @height: return location for the height of @data's contents.
+ *
+ * Returns: %TRUE if @data is a stub and @width and @height were set.
+ **/
+gboolean
+gimp_data_get_stub_size (GimpData *data,
+                         gint     *width,
+                         gint     *height)
+{
+  GimpDataPrivate *private;
+
+  g_return_val_if_fail (GIMP_IS_DATA (data), FALSE);
+
+  private = GIMP_DATA_GET_PRIVATE (data);
+
+  if (! private->stub)
+    return FALSE;
+
+  if (width)  *width  = private->stub->width;
+  if (height) *height = private->stub->height;
+
+  return TRUE;
+}
+
+const gchar *
+gimp_data_get_stub_checksum (GimpData *data)
+{
+  GimpDataPrivate *private;
+
+  g_return_val_if_fail (GIMP_IS_DATA (data), NULL);
+
+  private = GIMP_DATA_GET_PRIVATE (data);
+
+  return private->stub ? private->stub->checksum : NULL;
+}
+
+GimpTempBuf *
+gimp_data_get_stub_preview (GimpData *data)
+{
+  GimpDataPrivate *private;
+
+  g_return_val_if_fail (GIMP_IS_DATA (data), NULL);
+
+  private = GIMP_DATA_GET_PRIVATE (data);
+
+  return private->stub ? private->stub->preview : NULL;
+}
+
 /**
  * gimp_data_error_quark:
  *
@@ -62,6 +62,8 @@ struct _GimpDataClass
                                    GError   **error);
   const gchar * (* get_extension) (GimpData  *data);
   GimpData    * (* duplicate)     (GimpData  *data);
+  gboolean      (* load_contents) (GimpData  *data,
+                                   GError   **error);
 };
 
 
@@ -112,6 +114,20 @@ gboolean      gimp_data_is_internal      (GimpData     *data);
 gint          gimp_data_compare          (GimpData     *data1,
                                           GimpData     *data2);
 
+void          gimp_data_set_stub         (GimpData     *data,
+                                          gint          width,
+                                          gint          height,
+                                          const gchar  *checksum,
+                                          GimpTempBuf  *preview);
+gboolean      gimp_data_is_stub          (GimpData     *data);
+gboolean      gimp_data_ensure_loaded    (GimpData     *data);
+
+gboolean      gimp_data_get_stub_size    (GimpData     *data,
+                                          gint         *width,
+                                          gint         *height);
+const gchar * gimp_data_get_stub_checksum (GimpData    *data);
+GimpTempBuf * gimp_data_get_stub_preview (GimpData     *data);
+
 #define GIMP_DATA_ERROR (gimp_data_error_quark ())
 
 GQuark        gimp_data_error_quark      (void) G_GNUC_CONST;
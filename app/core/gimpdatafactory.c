@@ -36,6 +36,8 @@
 #include "gimpdata.h"
 #include "gimpdatafactory.h"
 #include "gimplist.h"
+#include "gimptagged.h"
+#include "gimptempbuf.h"
 
 #include "gimp-intl.h"
 
@@ -47,11 +49,47 @@
  */
 #define GIMP_OBSOLETE_DATA_DIR_NAME "gimp-obsolete-files"
 
+/* The index lets the data of lazy loaders be created as stubs, which
+ * load their contents from their file when they are first used
+ */
+#define INDEX_FILE_VERSION 1
+#define INDEX_PREVIEW_SIZE GIMP_VIEW_SIZE_MEDIUM
+
 
 typedef void (* GimpDataForeachFunc) (GimpDataFactory *factory,
                                       GimpData        *data,
                                       gpointer         user_data);
 
+typedef struct _GimpDataIndexEntry GimpDataIndexEntry;
+
+struct _GimpDataIndexEntry
+{
+  gint64       mtime;
+  gchar       *name;
+  gint         width;
+  gint         height;
+  gchar       *checksum;
+  GimpTempBuf *preview;
+  gboolean     used;      /* the file was seen by the current load */
+};
+
+typedef struct
+{
+  GimpDataFactory *factory;
+  GimpContext     *context;
+  GHashTable      *cache;
+  GHashTable      *index;
+  gboolean         index_dirty;
+  const gchar     *top_directory;
+} GimpDataLoadContext;
+
+enum
+{
+  INDEX_FILE_VERSION_SYMBOL = 1,
+  INDEX_DATA_SYMBOL,
+  INDEX_PREVIEW_SYMBOL
+};
+
 
 struct _GimpDataFactoryPriv
 {
@@ -89,6 +127,21 @@ static void    gimp_data_factory_load_data  (const GimpDatafileData *file_data,
 static void    gimp_data_factory_load_data_recursive (const GimpDatafileData *file_data,
                                                       gpointer                data);
 
+static gchar      * gimp_data_factory_index_file       (GimpDataFactory        *factory);
+static GHashTable * gimp_data_factory_index_load       (GimpDataFactory        *factory);
+static gboolean     gimp_data_factory_index_parse_int64
+                                                       (GScanner               *scanner,
+                                                        gint64                 *dest);
+static GTokenType   gimp_data_factory_index_deserialize_entry
+                                                       (GScanner               *scanner,
+                                                        GHashTable             *index);
+static void         gimp_data_factory_index_save       (GimpDataFactory        *factory,
+                                                        GHashTable             *index);
+static void         gimp_data_factory_index_add        (GimpDataLoadContext    *context,
+                                                        const GimpDatafileData *file_data,
+                                                        GimpData               *data);
+static void         gimp_data_index_entry_free         (GimpDataIndexEntry     *entry);
+
 G_DEFINE_TYPE (GimpDataFactory, gimp_data_factory, GIMP_TYPE_OBJECT)
 
 #define parent_class gimp_data_factory_parent_class
@@ -304,14 +357,6 @@ gimp_data_factory_data_foreach (GimpDataFactory     *factory,
     }
 }
 
-typedef struct
-{
-  GimpDataFactory *factory;
-  GimpContext     *context;
-  GHashTable      *cache;
-  const gchar     *top_directory;
-} GimpDataLoadContext;
-
 static void
 gimp_data_factory_data_load (GimpDataFactory *factory,
                              GimpContext     *context,
@@ -334,6 +379,7 @@ gimp_data_factory_data_load (GimpDataFactory *factory,
       load_context.factory = factory;
       load_context.context = context;
       load_context.cache   = cache;
+      load_context.index   = gimp_data_factory_index_load (factory);
 
       tmp = gimp_config_path_expand (path, TRUE, NULL);
       g_free (path);
@@ -359,6 +405,29 @@ gimp_data_factory_data_load (GimpDataFactory *factory,
                                        gimp_data_factory_load_data_recursive,
                                        &load_context);
 
+      if (load_context.index)
+        {
+          GHashTableIter      iter;
+          GimpDataIndexEntry *entry;
+
+          /*  forget the files that are gone  */
+          g_hash_table_iter_init (&iter, load_context.index);
+
+          while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &entry))
+            {
+              if (! entry->used)
+                {
+                  g_hash_table_iter_remove (&iter);
+                  load_context.index_dirty = TRUE;
+                }
+            }
+
+          if (load_context.index_dirty)
+            gimp_data_factory_index_save (factory, load_context.index);
+
+          g_hash_table_destroy (load_context.index);
+        }
+
       if (writable_path)
         {
           gimp_path_free (writable_list);
@@ -843,6 +912,7 @@ gimp_data_factory_load_data (const GimpDatafileData *file_data,
   GimpDataFactory                  *factory = context->factory;
   GHashTable                       *cache   = context->cache;
   const GimpDataFactoryLoaderEntry *loader  = NULL;
+  GimpDataIndexEntry               *entry   = NULL;
   GError                           *error   = NULL;
   GList                            *data_list;
   gint                              i;
@@ -864,6 +934,16 @@ gimp_data_factory_load_data (const GimpDatafileData *file_data,
   return;
 
  insert:
+  if (loader->lazy && context->index)
+    {
+      entry = g_hash_table_lookup (context->index, file_data->filename);
+
+      if (entry && entry->mtime == file_data->mtime)
+        entry->used = TRUE;
+      else
+        entry = NULL;
+    }
+
   if (cache)
     {
       GList *cached_data;
@@ -879,11 +959,40 @@ gimp_data_factory_load_data (const GimpDatafileData *file_data,
           for (list = cached_data; list; list = g_list_next (list))
             gimp_container_add (factory->priv->container, list->data);
 
+          if (loader->lazy && context->index && ! entry && ! cached_data->next)
+            {
+              gimp_data_factory_index_add (context, file_data,
+                                           cached_data->data);
+            }
+
           return;
         }
     }
 
-  data_list = loader->load_func (context->context, file_data->filename, &error);
+  if (entry)
+    {
+      GType type = gimp_container_get_children_type (factory->priv->container);
+
+      data_list = g_list_prepend (NULL, g_object_new (type,
+                                                      "name", entry->name,
+                                                      NULL));
+
+      gimp_data_set_stub (data_list->data,
+                          entry->width, entry->height,
+                          entry->checksum, entry->preview);
+    }
+  else
+    {
+      data_list = loader->load_func (context->context, file_data->filename,
+                                     &error);
+
+      /*  only files holding a single object can be indexed  */
+      if (loader->lazy && context->index && data_list && ! data_list->next)
+        {
+          gimp_data_factory_index_add (context, file_data,
+                                       data_list->data);
+        }
+    }
 
   if (G_LIKELY (data_list))
     {
@@ -946,3 +1055,378 @@ gimp_data_factory_load_data (const GimpDatafileData *file_data,
       g_clear_error (&error);
     }
 }
+
+
+/*  the data index  */
+
+static gchar *
+gimp_data_factory_index_file (GimpDataFactory *factory)
+{
+  const gchar *property = factory->priv->path_property_name;
+  gchar       *basename;
+  gchar       *filename;
+  gint         i;
+
+  for (i = 0; i < factory->priv->n_loader_entries; i++)
+    {
+      if (factory->priv->loader_entries[i].lazy)
+        break;
+    }
+
+  if (i == factory->priv->n_loader_entries)
+    return NULL;
+
+  /*  "brush-path" -> "brush-index"  */
+  if (g_str_has_suffix (property, "-path"))
+    basename = g_strdup_printf ("%.*s-index",
+                                (gint) (strlen (property) - strlen ("-path")),
+                                property);
+  else
+    basename = g_strconcat (property, "-index", NULL);
+
+  filename = gimp_personal_rc_file (basename);
+
+  g_free (basename);
+
+  return filename;
+}
+
+/*  returns NULL if the factory has no lazy loaders, and an empty
+ *  index if there is no usable index file
+ */
+static GHashTable *
+gimp_data_factory_index_load (GimpDataFactory *factory)
+{
+  GHashTable *index;
+  GScanner   *scanner;
+  gchar      *filename;
+  gint        version = 0;
+  GTokenType  token;
+
+  filename = gimp_data_factory_index_file (factory);
+
+  if (! filename)
+    return NULL;
+
+  index = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                 (GDestroyNotify) g_free,
+                                 (GDestroyNotify) gimp_data_index_entry_free);
+
+  scanner = gimp_scanner_new_file (filename, NULL);
+
+  if (! scanner)
+    {
+      g_free (filename);
+      return index;
+    }
+
+  if (factory->priv->gimp->be_verbose)
+    g_print ("Parsing '%s'\n", gimp_filename_to_utf8 (filename));
+
+  g_free (filename);
+
+  g_scanner_scope_add_symbol (scanner, 0, "file-version",
+                              GINT_TO_POINTER (INDEX_FILE_VERSION_SYMBOL));
+  g_scanner_scope_add_symbol (scanner, 0, "data",
+                              GINT_TO_POINTER (INDEX_DATA_SYMBOL));
+  g_scanner_scope_add_symbol (scanner, 0, "preview",
+                              GINT_TO_POINTER (INDEX_PREVIEW_SYMBOL));
+
+  token = G_TOKEN_LEFT_PAREN;
+
+  while (g_scanner_peek_next_token (scanner) == token)
+    {
+      token = g_scanner_get_next_token (scanner);
+
+      switch (token)
+        {
+        case G_TOKEN_LEFT_PAREN:
+          token = G_TOKEN_SYMBOL;
+          break;
+
+        case G_TOKEN_SYMBOL:
+          switch (GPOINTER_TO_INT (scanner->value.v_symbol))
+            {
+            case INDEX_FILE_VERSION_SYMBOL:
+              token = G_TOKEN_INT;
+              if (gimp_scanner_parse_int (scanner, &version) &&
+                  version == INDEX_FILE_VERSION)
+                token = G_TOKEN_RIGHT_PAREN;
+              break;
+
+            case INDEX_DATA_SYMBOL:
+              /*  entries of an older version are useless  */
+              if (version == INDEX_FILE_VERSION)
+                token = gimp_data_factory_index_deserialize_entry (scanner,
+                                                                   index);
+              break;
+
+            default:
+              break;
+            }
+          break;
+
+        case G_TOKEN_RIGHT_PAREN:
+          token = G_TOKEN_LEFT_PAREN;
+          break;
+
+        default: /* do nothing */
+          break;
+        }
+    }
+
+  /*  the index is only a cache, if it is broken, start over  */
+  if (token != G_TOKEN_LEFT_PAREN)
+    g_hash_table_remove_all (index);
+
+  gimp_scanner_destroy (scanner);
+
+  return index;
+}
+
+static gboolean
+gimp_data_factory_index_parse_int64 (GScanner *scanner,
+                                     gint64   *dest)
+{
+  if (g_scanner_peek_next_token (scanner) != G_TOKEN_INT)
+    return FALSE;
+
+  g_scanner_get_next_token (scanner);
+
+  *dest = scanner->value.v_int64;
+
+  return TRUE;
+}
+
+/*  (data "filename" mtime "name" width height "checksum"
+ *        (preview width height "format" "pixels"))
+ */
+static GTokenType
+gimp_data_factory_index_deserialize_entry (GScanner   *scanner,
+                                           GHashTable *index)
+{
+  GimpDataIndexEntry *entry;
+  gchar              *utf8     = NULL;
+  gchar              *filename = NULL;
+
+  entry = g_slice_new0 (GimpDataIndexEntry);
+
+  if (! gimp_scanner_parse_string (scanner, &utf8))
+    goto error;
+
+  if (! gimp_data_factory_index_parse_int64 (scanner, &entry->mtime))
+    goto error;
+
+  if (! gimp_scanner_parse_string (scanner, &entry->name) || ! entry->name)
+    goto error;
+
+  if (! gimp_scanner_parse_int (scanner, &entry->width)  ||
+      ! gimp_scanner_parse_int (scanner, &entry->height) ||
+      entry->width < 1 || entry->height < 1)
+    goto error;
+
+  if (! gimp_scanner_parse_string (scanner, &entry->checksum))
+    goto error;
+
+  if (entry->checksum && ! *entry->checksum)
+    {
+      g_free (entry->checksum);
+      entry->checksum = NULL;
+    }
+
+  if (g_scanner_peek_next_token (scanner) == G_TOKEN_LEFT_PAREN)
+    {
+      gchar  *format_name = NULL;
+      guint8 *pixels      = NULL;
+      gint    width;
+      gint    height;
+
+      g_scanner_get_next_token (scanner);
+
+      if (! gimp_scanner_parse_token (scanner, G_TOKEN_SYMBOL) ||
+          GPOINTER_TO_INT (scanner->value.v_symbol) != INDEX_PREVIEW_SYMBOL)
+        goto error;
+
+      if (! gimp_scanner_parse_int (scanner, &width)  ||
+          ! gimp_scanner_parse_int (scanner, &height) ||
+          width  < 1 || width  > INDEX_PREVIEW_SIZE   ||
+          height < 1 || height > INDEX_PREVIEW_SIZE)
+        goto error;
+
+      if (! gimp_scanner_parse_string (scanner, &format_name) ||
+          ! format_name || ! babl_format_exists (format_name))
+        {
+          g_free (format_name);
+          goto error;
+        }
+
+      entry->preview = gimp_temp_buf_new (width, height,
+                                          babl_format (format_name));
+      g_free (format_name);
+
+      if (! gimp_scanner_parse_data (scanner,
+                                     gimp_temp_buf_get_data_size (entry->preview),
+                                     &pixels) || ! pixels)
+        goto error;
+
+      memcpy (gimp_temp_buf_get_data (entry->preview), pixels,
+              gimp_temp_buf_get_data_size (entry->preview));
+      g_free (pixels);
+
+      if (! gimp_scanner_parse_token (scanner, G_TOKEN_RIGHT_PAREN))
+        goto error;
+    }
+
+  filename = g_filename_from_utf8 (utf8, -1, NULL, NULL, NULL);
+  g_free (utf8);
+
+  if (filename)
+    g_hash_table_insert (index, filename, entry);
+  else
+    gimp_data_index_entry_free (entry);
+
+  return G_TOKEN_RIGHT_PAREN;
+
+ error:
+  g_free (utf8);
+  gimp_data_index_entry_free (entry);
+
+  return G_TOKEN_STRING;
+}
+
+static void
+gimp_data_factory_index_save (GimpDataFactory *factory,
+                              GHashTable      *index)
+{
+  GimpConfigWriter   *writer;
+  GHashTableIter      iter;
+  const gchar        *filename;
+  GimpDataIndexEntry *entry;
+  gchar              *index_file;
+  GError             *error = NULL;
+
+  index_file = gimp_data_factory_index_file (factory);
+
+  if (factory->priv->gimp->be_verbose)
+    g_print ("Writing '%s'\n", gimp_filename_to_utf8 (index_file));
+
+  writer = gimp_config_writer_new_file (index_file,
+                                        TRUE,
+                                        "GIMP data index\n\n"
+                                        "This file can safely be removed and "
+                                        "will be automatically regenerated "
+                                        "when the data is loaded.",
+                                        &error);
+
+  g_free (index_file);
+
+  if (! writer)
+    {
+      gimp_message_literal (factory->priv->gimp, NULL, GIMP_MESSAGE_WARNING,
+                            error->message);
+      g_clear_error (&error);
+
+      return;
+    }
+
+  gimp_config_writer_open (writer, "file-version");
+  gimp_config_writer_printf (writer, "%d", INDEX_FILE_VERSION);
+  gimp_config_writer_close (writer);
+
+  gimp_config_writer_linefeed (writer);
+
+  g_hash_table_iter_init (&iter, index);
+
+  while (g_hash_table_iter_next (&iter,
+                                 (gpointer *) &filename, (gpointer *) &entry))
+    {
+      gchar *utf8 = g_filename_to_utf8 (filename, -1, NULL, NULL, NULL);
+
+      if (! utf8)
+        continue;
+
+      gimp_config_writer_open (writer, "data");
+      gimp_config_writer_string (writer, utf8);
+      gimp_config_writer_printf (writer, "%" G_GINT64_FORMAT, entry->mtime);
+      gimp_config_writer_string (writer, entry->name);
+      gimp_config_writer_printf (writer, "%d %d", entry->width, entry->height);
+      gimp_config_writer_string (writer, entry->checksum);
+
+      if (entry->preview)
+        {
+          const Babl *format = gimp_temp_buf_get_format (entry->preview);
+
+          gimp_config_writer_open (writer, "preview");
+          gimp_config_writer_printf (writer, "%d %d",
+                                     gimp_temp_buf_get_width  (entry->preview),
+                                     gimp_temp_buf_get_height (entry->preview));
+          gimp_config_writer_string (writer, babl_get_name (format));
+          gimp_config_writer_data (writer,
+                                   gimp_temp_buf_get_data_size (entry->preview),
+                                   gimp_temp_buf_get_data (entry->preview));
+          gimp_config_writer_close (writer);
+        }
+
+      gimp_config_writer_close (writer);
+
+      g_free (utf8);
+    }
+
+  if (! gimp_config_writer_finish (writer, "end of data index", &error))
+    {
+      gimp_message_literal (factory->priv->gimp, NULL, GIMP_MESSAGE_WARNING,
+                            error->message);
+      g_clear_error (&error);
+    }
+}
+
+static void
+gimp_data_factory_index_add (GimpDataLoadContext    *context,
+                             const GimpDatafileData *file_data,
+                             GimpData               *data)
+{
+  GimpDataIndexEntry *entry;
+  GimpTempBuf        *preview;
+
+  entry = g_slice_new0 (GimpDataIndexEntry);
+
+  entry->mtime    = file_data->mtime;
+  entry->name     = g_strdup (gimp_object_get_name (data));
+  entry->checksum = gimp_tagged_get_checksum (GIMP_TAGGED (data));
+  entry->used     = TRUE;
+
+  gimp_viewable_get_size (GIMP_VIEWABLE (data),
+                          &entry->width, &entry->height);
+
+  preview = gimp_viewable_get_new_preview (GIMP_VIEWABLE (data),
+                                           context->context,
+                                           INDEX_PREVIEW_SIZE,
+                                           INDEX_PREVIEW_SIZE);
+
+  if (preview &&
+      (gimp_temp_buf_get_width  (preview) > INDEX_PREVIEW_SIZE ||
+       gimp_temp_buf_get_height (preview) > INDEX_PREVIEW_SIZE))
+    {
+      gimp_temp_buf_unref (preview);
+      preview = NULL;
+    }
+
+  entry->preview = preview;
+
+  g_hash_table_insert (context->index,
+                       g_strdup (file_data->filename), entry);
+
+  context->index_dirty = TRUE;
+}
+
+static void
+gimp_data_index_entry_free (GimpDataIndexEntry *entry)
+{
+  g_free (entry->name);
+  g_free (entry->checksum);
+
+  if (entry->preview)
+    gimp_temp_buf_unref (entry->preview);
+
+  g_slice_free (GimpDataIndexEntry, entry);
+}
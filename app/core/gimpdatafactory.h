@@ -40,6 +40,7 @@ struct _GimpDataFactoryLoaderEntry
   GimpDataLoadFunc  load_func;
   const gchar      *extension;
   gboolean          writable;
+  gboolean          lazy;      /* files are indexed, loaded on first use */
 };
 
 
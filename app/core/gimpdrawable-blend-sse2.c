@@ -0,0 +1,243 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimpdrawable-blend-sse2.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <gegl.h>
+
+#include "core-types.h"
+
+#include "gimpdrawable-blend-sse2.h"
+
+
+#ifdef USE_SSE2
+
+#include <emmintrin.h>
+
+
+/*  SSE2 variants of the row loops of gimpdrawable-blend.c.
+ *
+ *  The factors are calculated two pixels at a time, in double
+ *  precision and with the same operations as the generic
+ *  gradient_calc_*_factor() functions, so both give the same result
+ *  and supersampling, which uses the generic functions, matches the
+ *  plain blend.  The LUT lookup interpolates the four channels of a
+ *  pixel in one vector.
+ */
+
+#if defined (__GNUC__)
+#define ALWAYS_INLINE inline __attribute__ ((always_inline))
+#else
+#define ALWAYS_INLINE inline
+#endif
+
+
+static ALWAYS_INLINE __m128d
+select_pd (__m128d mask,
+           __m128d a,
+           __m128d b)
+{
+  return _mm_or_pd (_mm_and_pd (mask, a), _mm_andnot_pd (mask, b));
+}
+
+static ALWAYS_INLINE __m128d
+abs_pd (__m128d v)
+{
+  return _mm_andnot_pd (_mm_set1_pd (-0.0), v);
+}
+
+/*  the generic code takes abs() of the integer part  */
+static ALWAYS_INLINE __m128d
+abs_trunc_pd (__m128d v)
+{
+  return abs_pd (_mm_cvtepi32_pd (_mm_cvttpd_epi32 (v)));
+}
+
+/*  factors of the pixels at x and x + 1  */
+static ALWAYS_INLINE __m128d
+row_factors (GimpGradientType gradient_type,
+             __m128d          dist,
+             __m128d          vec0,
+             __m128d          vec1,
+             __m128d          offset,
+             __m128d          x,
+             __m128d          y)
+{
+  const __m128d zero  = _mm_setzero_pd ();
+  const __m128d range = _mm_sub_pd (_mm_set1_pd (1.0), offset);
+  __m128d       rat;
+  __m128d       result;
+
+  switch (gradient_type)
+    {
+    case GIMP_GRADIENT_LINEAR:
+      rat = _mm_div_pd (_mm_add_pd (_mm_mul_pd (vec0, x),
+                                    _mm_mul_pd (vec1, y)),
+                        dist);
+
+      result = select_pd (_mm_cmplt_pd (rat, zero),
+                          rat, _mm_sub_pd (rat, offset));
+      result = _mm_div_pd (result, range);
+
+      return _mm_andnot_pd (_mm_and_pd (_mm_cmpge_pd (rat, zero),
+                                        _mm_cmplt_pd (rat, offset)),
+                            result);
+
+    case GIMP_GRADIENT_BILINEAR:
+      rat = abs_pd (_mm_div_pd (_mm_add_pd (_mm_mul_pd (vec0, x),
+                                            _mm_mul_pd (vec1, y)),
+                                dist));
+      break;
+
+    case GIMP_GRADIENT_RADIAL:
+      rat = _mm_div_pd (_mm_sqrt_pd (_mm_add_pd (_mm_mul_pd (x, x),
+                                                 _mm_mul_pd (y, y))),
+                        dist);
+      break;
+
+    case GIMP_GRADIENT_SQUARE:
+      rat = _mm_div_pd (_mm_max_pd (abs_trunc_pd (x), abs_trunc_pd (y)),
+                        dist);
+      break;
+
+    default:
+      g_return_val_if_reached (zero);
+    }
+
+  result = _mm_div_pd (_mm_sub_pd (rat, offset), range);
+
+  return _mm_andnot_pd (_mm_cmplt_pd (rat, offset), result);
+}
+
+gboolean
+gimp_drawable_blend_row_factors_sse2 (GimpGradientType  gradient_type,
+                                      gdouble           dist,
+                                      const gdouble    *vec,
+                                      gdouble           offset,
+                                      gdouble           x,
+                                      gdouble           y,
+                                      gint              width,
+                                      gdouble          *factors)
+{
+  __m128d dist_v;
+  __m128d vec0_v;
+  __m128d vec1_v;
+  __m128d offset_v;
+  __m128d x_v;
+  __m128d y_v;
+  __m128d two;
+  gint    i;
+
+  switch (gradient_type)
+    {
+    case GIMP_GRADIENT_LINEAR:
+    case GIMP_GRADIENT_BILINEAR:
+    case GIMP_GRADIENT_RADIAL:
+    case GIMP_GRADIENT_SQUARE:
+      break;
+
+    default:
+      return FALSE;
+    }
+
+  offset = offset / 100.0;
+
+  /*  leave the special cases to the generic code  */
+  if (dist == 0.0 || offset == 1.0)
+    return FALSE;
+
+  dist_v   = _mm_set1_pd (dist);
+  vec0_v   = _mm_set1_pd (vec[0]);
+  vec1_v   = _mm_set1_pd (vec[1]);
+  offset_v = _mm_set1_pd (offset);
+  x_v      = _mm_add_pd (_mm_set1_pd (x), _mm_set_pd (1.0, 0.0));
+  y_v      = _mm_set1_pd (y);
+  two      = _mm_set1_pd (2.0);
+
+  for (i = 0; i + 2 <= width; i += 2)
+    {
+      _mm_storeu_pd (factors + i,
+                     row_factors (gradient_type,
+                                  dist_v, vec0_v, vec1_v, offset_v,
+                                  x_v, y_v));
+
+      x_v = _mm_add_pd (x_v, two);
+    }
+
+  if (i < width)
+    {
+      _mm_store_sd (factors + i,
+                    row_factors (gradient_type,
+                                 dist_v, vec0_v, vec1_v, offset_v,
+                                 x_v, y_v));
+    }
+
+  return TRUE;
+}
+
+gboolean
+gimp_drawable_blend_row_lookup_sse2 (const gfloat  *lut,
+                                     gint           lut_size,
+                                     const gdouble *factors,
+                                     gint           width,
+                                     gfloat        *dest)
+{
+  gint x;
+
+  for (x = 0; x < width; x++, dest += 4)
+    {
+      gdouble pos = factors[x] * lut_size;
+      gint    i   = CLAMP ((gint) pos, 0, lut_size - 1);
+      __m128  t   = _mm_set1_ps (pos - i);
+      __m128  c0  = _mm_loadu_ps (lut + 4 * i);
+      __m128  c1  = _mm_loadu_ps (lut + 4 * i + 4);
+
+      _mm_storeu_ps (dest,
+                     _mm_add_ps (c0, _mm_mul_ps (_mm_sub_ps (c1, c0), t)));
+    }
+
+  return TRUE;
+}
+
+#else /* ! USE_SSE2 */
+
+gboolean
+gimp_drawable_blend_row_factors_sse2 (GimpGradientType  gradient_type,
+                                      gdouble           dist,
+                                      const gdouble    *vec,
+                                      gdouble           offset,
+                                      gdouble           x,
+                                      gdouble           y,
+                                      gint              width,
+                                      gdouble          *factors)
+{
+  return FALSE;
+}
+
+gboolean
+gimp_drawable_blend_row_lookup_sse2 (const gfloat  *lut,
+                                     gint           lut_size,
+                                     const gdouble *factors,
+                                     gint           width,
+                                     gfloat        *dest)
+{
+  return FALSE;
+}
+
+#endif /* USE_SSE2 */
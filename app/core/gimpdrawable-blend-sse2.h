@@ -0,0 +1,44 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimpdrawable-blend-sse2.h
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GIMP_DRAWABLE_BLEND_SSE2_H__
+#define __GIMP_DRAWABLE_BLEND_SSE2_H__
+
+
+/*  both return FALSE if they can't handle the case, the caller then
+ *  uses the generic code
+ */
+
+gboolean   gimp_drawable_blend_row_factors_sse2 (GimpGradientType  gradient_type,
+                                                 gdouble           dist,
+                                                 const gdouble    *vec,
+                                                 gdouble           offset,
+                                                 gdouble           x,
+                                                 gdouble           y,
+                                                 gint              width,
+                                                 gdouble          *factors);
+
+gboolean   gimp_drawable_blend_row_lookup_sse2  (const gfloat     *lut,
+                                                 gint              lut_size,
+                                                 const gdouble    *factors,
+                                                 gint              width,
+                                                 gfloat           *dest);
+
+
+#endif /* __GIMP_DRAWABLE_BLEND_SSE2_H__ */
@@ -34,10 +34,12 @@
 #include "gegl/gimp-gegl-utils.h"
 
 #include "gimp.h"
+#include "gimp-parallel.h"
 #include "gimp-utils.h"
 #include "gimpchannel.h"
 #include "gimpcontext.h"
 #include "gimpdrawable-blend.h"
+#include "gimpdrawable-blend-sse2.h"
 #include "gimpgradient.h"
 #include "gimpimage.h"
 #include "gimpprogress.h"
@@ -45,38 +47,62 @@
 #include "gimp-intl.h"
 
 
-//#define USE_GRADIENT_CACHE 1
+/*  the gradient is baked into a LUT with about one entry per pixel
+ *  of the blend's length, looked up with linear interpolation between
+ *  neighbouring entries
+ */
+#define GRADIENT_LUT_MIN_SIZE 256
+#define GRADIENT_LUT_MAX_SIZE (1 << 18)
+
+/*  rows rendered between two progress updates / buffer writes  */
+#define STRIP_HEIGHT      64
+#define MIN_PARALLEL_ROWS 4
 
 
 typedef struct
 {
-  GimpGradient     *gradient;
+  gfloat           *lut;          /* R'G'B'A float colors */
+  gint              lut_size;     /* number of intervals  */
+  guchar           *lut_edges;    /* intervals containing a hard edge
+                                   * of the gradient, or NULL
+                                   */
+  GimpGradient     *gradient;     /* evaluated at hard edges */
   GimpContext      *context;
   gboolean          reverse;
-#ifdef USE_GRADIENT_CACHE
-  GimpRGB          *gradient_cache;
-  gint              gradient_cache_size;
-#endif
+  gboolean          sse2;
   gdouble           offset;
   gdouble           sx, sy;
-  GimpBlendMode     blend_mode;
   GimpGradientType  gradient_type;
-  GimpRGB           fg, bg;
   gdouble           dist;
   gdouble           vec[2];
   GimpRepeatMode    repeat;
-  GRand            *seed;
-  GeglBuffer       *dist_buffer;
+  gfloat           *dist_data;    /* normalized shapeburst distance map */
+  gint              dist_width;
+  gint              dist_height;
 } RenderBlendData;
 
 typedef struct
 {
-  GeglBuffer    *buffer;
-  gfloat        *row_data;
+  gfloat        *data;
   gint           width;
-  GRand         *dither_rand;
+  gint           y;
+  gboolean       dither;
+  guint32        seed;
 } PutPixelData;
 
+typedef struct
+{
+  RenderBlendData *rbd;
+  gfloat          *data;          /* the strip's pixels                 */
+  gint             width;
+  gint             y;             /* first row of the strip             */
+  gboolean         dither;
+  guint32          seed;          /* dither seed, combined with the
+                                   * pixel position                     */
+  gint             max_depth;
+  gdouble          threshold;
+} RenderStripData;
+
 
 /*  local function prototypes  */
 
@@ -115,22 +141,48 @@ static gdouble  gradient_calc_spiral_factor       (gdouble   dist,
                                                    gdouble   y,
                                                    gboolean  clockwise);
 
-static gdouble  gradient_calc_shapeburst_angular_factor   (GeglBuffer *dist_buffer,
-                                                           gdouble     x,
-                                                           gdouble     y);
-static gdouble  gradient_calc_shapeburst_spherical_factor (GeglBuffer *dist_buffer,
-                                                           gdouble     x,
-                                                           gdouble     y);
-static gdouble  gradient_calc_shapeburst_dimpled_factor   (GeglBuffer *dist_buffer,
-                                                           gdouble     x,
-                                                           gdouble     y);
-
-static GeglBuffer * gradient_precalc_shapeburst (GimpImage           *image,
-                                                 GimpDrawable        *drawable,
-                                                 const GeglRectangle *region,
-                                                 gdouble              dist,
-                                                 GimpProgress        *progress);
+static gdouble  gradient_calc_shapeburst_angular_factor   (gfloat      value);
+static gdouble  gradient_calc_shapeburst_spherical_factor (gfloat      value);
+static gdouble  gradient_calc_shapeburst_dimpled_factor   (gfloat      value);
 
+static gfloat * gradient_precalc_shapeburst (GimpImage           *image,
+                                             GimpDrawable        *drawable,
+                                             const GeglRectangle *region,
+                                             gdouble              dist,
+                                             GimpProgress        *progress);
+
+static gint     gradient_calc_lut_size      (GimpGradientType     gradient_type,
+                                             gdouble              dist,
+                                             gdouble              offset,
+                                             gdouble              sx,
+                                             gdouble              sy,
+                                             gint                 width,
+                                             gint                 height);
+static void     gradient_precalc_lut        (RenderBlendData     *rbd,
+                                             GimpBlendMode        blend_mode);
+
+static inline gfloat  gradient_get_shapeburst_value
+                                            (RenderBlendData     *rbd,
+                                             gdouble              x,
+                                             gdouble              y);
+static inline gdouble gradient_calc_factor  (RenderBlendData     *rbd,
+                                             gdouble              x,
+                                             gdouble              y);
+static inline gdouble gradient_repeat       (GimpRepeatMode       repeat,
+                                             gdouble              factor);
+static inline void    gradient_lookup       (RenderBlendData     *rbd,
+                                             gdouble              factor,
+                                             gfloat              *color);
+static void           gradient_lookup_edge  (RenderBlendData     *rbd,
+                                             gdouble              factor,
+                                             gfloat              *color);
+
+static void     gradient_render_row         (RenderBlendData     *rbd,
+                                             gint                 y,
+                                             gint                 width,
+                                             gdouble             *factors,
+                                             gfloat              *dest,
+                                             GRand               *dither_rand);
 static void     gradient_render_pixel       (gdouble              x,
                                              gdouble              y,
                                              GimpRGB             *color,
@@ -140,6 +192,13 @@ static void     gradient_put_pixel          (gint                 x,
                                              GimpRGB             *color,
                                              gpointer             put_pixel_data);
 
+static void     gradient_render_rows_func      (gsize             offset,
+                                                gsize             size,
+                                                gpointer          user_data);
+static void     gradient_supersample_rows_func (gsize             offset,
+                                                gsize             size,
+                                                gpointer          user_data);
+
 static void     gradient_fill_region        (GimpImage           *image,
                                              GimpDrawable        *drawable,
                                              GimpContext         *context,
@@ -474,62 +533,26 @@ gradient_calc_spiral_factor (gdouble   dist,
 }
 
 static gdouble
-gradient_calc_shapeburst_angular_factor (GeglBuffer *dist_buffer,
-                                         gdouble     x,
-                                         gdouble     y)
+gradient_calc_shapeburst_angular_factor (gfloat value)
 {
-  gint   ix = CLAMP (x, 0.0, gegl_buffer_get_width  (dist_buffer) - 0.7);
-  gint   iy = CLAMP (y, 0.0, gegl_buffer_get_height (dist_buffer) - 0.7);
-  gfloat value;
-
-  gegl_buffer_get (dist_buffer, GEGL_RECTANGLE (ix, iy, 1, 1), 1.0,
-                   NULL, &value,
-                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
-
-  value = 1.0 - value;
-
-  return value;
+  return 1.0 - value;
 }
 
 
 static gdouble
-gradient_calc_shapeburst_spherical_factor (GeglBuffer *dist_buffer,
-                                           gdouble     x,
-                                           gdouble     y)
+gradient_calc_shapeburst_spherical_factor (gfloat value)
 {
-  gint   ix = CLAMP (x, 0.0, gegl_buffer_get_width  (dist_buffer) - 0.7);
-  gint   iy = CLAMP (y, 0.0, gegl_buffer_get_height (dist_buffer) - 0.7);
-  gfloat value;
-
-  gegl_buffer_get (dist_buffer, GEGL_RECTANGLE (ix, iy, 1, 1), 1.0,
-                   NULL, &value,
-                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
-
-  value = 1.0 - sin (0.5 * G_PI * value);
-
-  return value;
+  return 1.0 - sin (0.5 * G_PI * value);
 }
 
 
 static gdouble
-gradient_calc_shapeburst_dimpled_factor (GeglBuffer *dist_buffer,
-                                         gdouble     x,
-                                         gdouble     y)
+gradient_calc_shapeburst_dimpled_factor (gfloat value)
 {
-  gint   ix = CLAMP (x, 0.0, gegl_buffer_get_width  (dist_buffer) - 0.7);
-  gint   iy = CLAMP (y, 0.0, gegl_buffer_get_height (dist_buffer) - 0.7);
-  gfloat value;
-
-  gegl_buffer_get (dist_buffer, GEGL_RECTANGLE (ix, iy, 1, 1), 1.0,
-                   NULL, &value,
-                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
-
-  value = cos (0.5 * G_PI * value);
-
-  return value;
+  return cos (0.5 * G_PI * value);
 }
 
-static GeglBuffer *
+static gfloat *
 gradient_precalc_shapeburst (GimpImage           *image,
                              GimpDrawable        *drawable,
                              const GeglRectangle *region,
@@ -540,6 +563,7 @@ gradient_precalc_shapeburst (GimpImage           *image,
   GeglBuffer  *dist_buffer;
   GeglBuffer  *temp_buffer;
   GeglNode    *shapeburst;
+  gfloat      *dist_data;
   gdouble      max;
   gfloat       max_iteration;
 
@@ -621,107 +645,277 @@ gradient_precalc_shapeburst (GimpImage           *image,
 
   g_object_unref (temp_buffer);
 
+  /*  the map is read for every pixel, keep it in linear memory  */
+  dist_data = g_new (gfloat, (gsize) region->width * region->height);
+
+  gegl_buffer_get (dist_buffer,
+                   GEGL_RECTANGLE (0, 0, region->width, region->height), 1.0,
+                   NULL, dist_data,
+                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+  g_object_unref (dist_buffer);
+
   /*  normalize the shapeburst with the max iteration  */
   if (max_iteration > 0)
     {
-      GeglBufferIterator *iter;
+      gsize n_pixels = (gsize) region->width * region->height;
+      gsize i;
+
+      for (i = 0; i < n_pixels; i++)
+        dist_data[i] /= max_iteration;
+    }
+
+  return dist_data;
+}
+
+/*  the length in pixels over which the factor goes from 0.0 to 1.0,
+ *  or the longest such length for the angular gradients
+ */
+static gint
+gradient_calc_lut_size (GimpGradientType gradient_type,
+                        gdouble          dist,
+                        gdouble          offset,
+                        gdouble          sx,
+                        gdouble          sy,
+                        gint             width,
+                        gint             height)
+{
+  gdouble length;
+  gdouble radius;
 
-      iter = gegl_buffer_iterator_new (dist_buffer, NULL, 0, NULL,
-                                       GEGL_BUFFER_READWRITE, GEGL_ABYSS_NONE);
+  /*  distance from the start point to the farthest corner  */
+  radius = sqrt (SQR (MAX (fabs (sx), fabs (width  - sx))) +
+                 SQR (MAX (fabs (sy), fabs (height - sy))));
 
-      while (gegl_buffer_iterator_next (iter))
+  switch (gradient_type)
+    {
+    case GIMP_GRADIENT_CONICAL_SYMMETRIC:
+      length = G_PI * radius;
+      break;
+
+    case GIMP_GRADIENT_CONICAL_ASYMMETRIC:
+      length = 2.0 * G_PI * radius;
+      break;
+
+    case GIMP_GRADIENT_SPIRAL_CLOCKWISE:
+    case GIMP_GRADIENT_SPIRAL_ANTICLOCKWISE:
+      length = MAX (2.0 * G_PI * radius, dist);
+      break;
+
+    case GIMP_GRADIENT_SHAPEBURST_ANGULAR:
+    case GIMP_GRADIENT_SHAPEBURST_SPHERICAL:
+    case GIMP_GRADIENT_SHAPEBURST_DIMPLED:
+      length = MAX (width, height);
+      break;
+
+    default:
+      /*  the offset squeezes the whole gradient into the rest  */
+      length = dist / MAX (1.0 - offset / 100.0, 1.0 / GRADIENT_LUT_MAX_SIZE);
+      break;
+    }
+
+  return CLAMP (ceil (length), GRADIENT_LUT_MIN_SIZE, GRADIENT_LUT_MAX_SIZE);
+}
+
+static void
+gradient_precalc_lut (RenderBlendData *rbd,
+                      GimpBlendMode    blend_mode)
+{
+  GimpGradientSegment *seg = NULL;
+  gint                 n   = rbd->lut_size;
+  GimpRGB              fg, bg;
+  gint                 i;
+
+  gimp_context_get_foreground (rbd->context, &fg);
+  gimp_context_get_background (rbd->context, &bg);
+
+  switch (blend_mode)
+    {
+    case GIMP_FG_BG_RGB_MODE:
+      break;
+
+    case GIMP_FG_BG_HSV_MODE:
+      /* Convert to HSV */
+      {
+        GimpHSV fg_hsv;
+        GimpHSV bg_hsv;
+
+        gimp_rgb_to_hsv (&fg, &fg_hsv);
+        gimp_rgb_to_hsv (&bg, &bg_hsv);
+
+        memcpy (&fg, &fg_hsv, sizeof (GimpRGB));
+        memcpy (&bg, &bg_hsv, sizeof (GimpRGB));
+      }
+      break;
+
+    case GIMP_FG_TRANSPARENT_MODE:
+      /* Color does not change, just the opacity */
+
+      bg   = fg;
+      bg.a = GIMP_OPACITY_TRANSPARENT;
+      break;
+
+    case GIMP_CUSTOM_MODE:
+      break;
+
+    default:
+      g_assert_not_reached ();
+      break;
+    }
+
+  rbd->lut = g_new (gfloat, 4 * (n + 1));
+
+  for (i = 0; i <= n; i++)
+    {
+      gdouble factor = (gdouble) i / (gdouble) n;
+      GimpRGB color;
+
+      if (blend_mode == GIMP_CUSTOM_MODE)
         {
-          gfloat *data = iter->data[0];
+          seg = gimp_gradient_get_color_at (rbd->gradient, rbd->context, seg,
+                                            factor, rbd->reverse, &color);
+        }
+      else
+        {
+          /* Blend values */
+
+          if (rbd->reverse)
+            factor = 1.0 - factor;
 
-          while (iter->length--)
-            *data++ /= max_iteration;
+          color.r = fg.r + (bg.r - fg.r) * factor;
+          color.g = fg.g + (bg.g - fg.g) * factor;
+          color.b = fg.b + (bg.b - fg.b) * factor;
+          color.a = fg.a + (bg.a - fg.a) * factor;
+
+          if (blend_mode == GIMP_FG_BG_HSV_MODE)
+            {
+              GimpHSV hsv;
+
+              memcpy (&hsv, &color, sizeof (GimpHSV));
+              gimp_hsv_to_rgb (&hsv, &color);
+            }
         }
+
+      rbd->lut[4 * i + 0] = color.r;
+      rbd->lut[4 * i + 1] = color.g;
+      rbd->lut[4 * i + 2] = color.b;
+      rbd->lut[4 * i + 3] = color.a;
     }
 
-  return dist_buffer;
-}
+  if (blend_mode != GIMP_CUSTOM_MODE)
+    return;
+
+  /*  interpolating across a hard edge between two segments would
+   *  smear it, the intervals around them are evaluated exactly
+   */
+  for (seg = rbd->gradient->segments; seg && seg->next; seg = seg->next)
+    {
+      GimpRGB right;
+      GimpRGB left;
+      gdouble pos;
 
+      gimp_gradient_segment_get_right_color (rbd->gradient, seg, &right);
+      gimp_gradient_segment_get_left_color (rbd->gradient, seg->next, &left);
 
-static void
-gradient_render_pixel (gdouble   x,
-                       gdouble   y,
-                       GimpRGB  *color,
-                       gpointer  render_data)
+      if (gimp_rgba_distance (&right, &left) < 1e-6)
+        continue;
+
+      if (! rbd->lut_edges)
+        rbd->lut_edges = g_new0 (guchar, n);
+
+      pos = (rbd->reverse ? 1.0 - seg->right : seg->right) * n;
+      i   = CLAMP ((gint) pos, 0, n - 1);
+
+      rbd->lut_edges[i] = TRUE;
+
+      /*  an edge on an entry is in the interval before it too  */
+      if (i > 0 && pos == i)
+        rbd->lut_edges[i - 1] = TRUE;
+    }
+}
+
+static inline gfloat
+gradient_get_shapeburst_value (RenderBlendData *rbd,
+                               gdouble          x,
+                               gdouble          y)
 {
-  RenderBlendData *rbd = render_data;
-  gdouble          factor;
+  gint ix = CLAMP (x, 0.0, rbd->dist_width  - 0.7);
+  gint iy = CLAMP (y, 0.0, rbd->dist_height - 0.7);
 
-  /* Calculate blending factor */
+  return rbd->dist_data[(gsize) iy * rbd->dist_width + ix];
+}
 
+static inline gdouble
+gradient_calc_factor (RenderBlendData *rbd,
+                      gdouble          x,
+                      gdouble          y)
+{
   switch (rbd->gradient_type)
     {
     case GIMP_GRADIENT_LINEAR:
-      factor = gradient_calc_linear_factor (rbd->dist,
-                                            rbd->vec, rbd->offset,
-                                            x - rbd->sx, y - rbd->sy);
-      break;
+      return gradient_calc_linear_factor (rbd->dist,
+                                          rbd->vec, rbd->offset,
+                                          x - rbd->sx, y - rbd->sy);
 
     case GIMP_GRADIENT_BILINEAR:
-      factor = gradient_calc_bilinear_factor (rbd->dist,
-                                              rbd->vec, rbd->offset,
-                                              x - rbd->sx, y - rbd->sy);
-      break;
+      return gradient_calc_bilinear_factor (rbd->dist,
+                                            rbd->vec, rbd->offset,
+                                            x - rbd->sx, y - rbd->sy);
 
     case GIMP_GRADIENT_RADIAL:
-      factor = gradient_calc_radial_factor (rbd->dist,
-                                            rbd->offset,
-                                            x - rbd->sx, y - rbd->sy);
-      break;
+      return gradient_calc_radial_factor (rbd->dist,
+                                          rbd->offset,
+                                          x - rbd->sx, y - rbd->sy);
 
     case GIMP_GRADIENT_SQUARE:
-      factor = gradient_calc_square_factor (rbd->dist, rbd->offset,
-                                            x - rbd->sx, y - rbd->sy);
-      break;
+      return gradient_calc_square_factor (rbd->dist, rbd->offset,
+                                          x - rbd->sx, y - rbd->sy);
 
     case GIMP_GRADIENT_CONICAL_SYMMETRIC:
-      factor = gradient_calc_conical_sym_factor (rbd->dist,
-                                                 rbd->vec, rbd->offset,
-                                                 x - rbd->sx, y - rbd->sy);
-      break;
+      return gradient_calc_conical_sym_factor (rbd->dist,
+                                               rbd->vec, rbd->offset,
+                                               x - rbd->sx, y - rbd->sy);
 
     case GIMP_GRADIENT_CONICAL_ASYMMETRIC:
-      factor = gradient_calc_conical_asym_factor (rbd->dist,
-                                                  rbd->vec, rbd->offset,
-                                                  x - rbd->sx, y - rbd->sy);
-      break;
+      return gradient_calc_conical_asym_factor (rbd->dist,
+                                                rbd->vec, rbd->offset,
+                                                x - rbd->sx, y - rbd->sy);
 
     case GIMP_GRADIENT_SHAPEBURST_ANGULAR:
-      factor = gradient_calc_shapeburst_angular_factor (rbd->dist_buffer, x, y);
-      break;
+      return gradient_calc_shapeburst_angular_factor (
+        gradient_get_shapeburst_value (rbd, x, y));
 
     case GIMP_GRADIENT_SHAPEBURST_SPHERICAL:
-      factor = gradient_calc_shapeburst_spherical_factor (rbd->dist_buffer, x, y);
-      break;
+      return gradient_calc_shapeburst_spherical_factor (
+        gradient_get_shapeburst_value (rbd, x, y));
 
     case GIMP_GRADIENT_SHAPEBURST_DIMPLED:
-      factor = gradient_calc_shapeburst_dimpled_factor (rbd->dist_buffer, x, y);
-      break;
+      return gradient_calc_shapeburst_dimpled_factor (
+        gradient_get_shapeburst_value (rbd, x, y));
 
     case GIMP_GRADIENT_SPIRAL_CLOCKWISE:
-      factor = gradient_calc_spiral_factor (rbd->dist,
-                                            rbd->vec, rbd->offset,
-                                            x - rbd->sx, y - rbd->sy, TRUE);
-      break;
+      return gradient_calc_spiral_factor (rbd->dist,
+                                          rbd->vec, rbd->offset,
+                                          x - rbd->sx, y - rbd->sy, TRUE);
 
     case GIMP_GRADIENT_SPIRAL_ANTICLOCKWISE:
-      factor = gradient_calc_spiral_factor (rbd->dist,
-                                            rbd->vec, rbd->offset,
-                                            x - rbd->sx, y - rbd->sy, FALSE);
-      break;
+      return gradient_calc_spiral_factor (rbd->dist,
+                                          rbd->vec, rbd->offset,
+                                          x - rbd->sx, y - rbd->sy, FALSE);
 
     default:
       g_assert_not_reached ();
-      return;
+      break;
     }
 
-  /* Adjust for repeat */
+  return 0.0;
+}
 
-  switch (rbd->repeat)
+static inline gdouble
+gradient_repeat (GimpRepeatMode repeat,
+                 gdouble        factor)
+{
+  switch (repeat)
     {
     case GIMP_REPEAT_NONE:
       factor = CLAMP (factor, 0.0, 1.0);
@@ -747,38 +941,211 @@ gradient_render_pixel (gdouble   x,
       break;
     }
 
-  /* Blend the colors */
+  return factor;
+}
+
+static inline void
+gradient_lookup (RenderBlendData *rbd,
+                 gdouble          factor,
+                 gfloat          *color)
+{
+  gdouble       pos = factor * rbd->lut_size;
+  gint          i   = CLAMP ((gint) pos, 0, rbd->lut_size - 1);
+  gfloat        t   = pos - i;
+  const gfloat *c0  = rbd->lut + 4 * i;
+  const gfloat *c1  = c0 + 4;
 
-  if (rbd->blend_mode == GIMP_CUSTOM_MODE)
+  if (rbd->lut_edges && rbd->lut_edges[i])
     {
-#ifdef USE_GRADIENT_CACHE
-      *color = rbd->gradient_cache[(gint) (factor * (rbd->gradient_cache_size - 1))];
-#else
-      gimp_gradient_get_color_at (rbd->gradient, rbd->context, NULL,
-                                  factor, rbd->reverse, color);
-#endif
+      gradient_lookup_edge (rbd, factor, color);
+      return;
     }
-  else
+
+  color[0] = c0[0] + (c1[0] - c0[0]) * t;
+  color[1] = c0[1] + (c1[1] - c0[1]) * t;
+  color[2] = c0[2] + (c1[2] - c0[2]) * t;
+  color[3] = c0[3] + (c1[3] - c0[3]) * t;
+}
+
+static void
+gradient_lookup_edge (RenderBlendData *rbd,
+                      gdouble          factor,
+                      gfloat          *color)
+{
+  GimpRGB rgb;
+
+  gimp_gradient_get_color_at (rbd->gradient, rbd->context, NULL,
+                              CLAMP (factor, 0.0, 1.0), rbd->reverse, &rgb);
+
+  color[0] = rgb.r;
+  color[1] = rgb.g;
+  color[2] = rgb.b;
+  color[3] = rgb.a;
+}
+
+/*  renders one row of the region: the factors of the whole row are
+ *  calculated first, with SSE2 where available and otherwise in loops
+ *  that contain no per-pixel dispatch on the gradient type or repeat
+ *  mode; then the colors are looked up in the LUT
+ */
+static void
+gradient_render_row (RenderBlendData *rbd,
+                     gint             y,
+                     gint             width,
+                     gdouble         *factors,
+                     gfloat          *dest,
+                     GRand           *dither_rand)
+{
+  gdouble dy = y - rbd->sy;
+  gint    x;
+
+  if (! rbd->sse2 ||
+      ! gimp_drawable_blend_row_factors_sse2 (rbd->gradient_type,
+                                              rbd->dist, rbd->vec,
+                                              rbd->offset,
+                                              -rbd->sx, dy, width, factors))
     {
-      /* Blend values */
+      switch (rbd->gradient_type)
+        {
+        case GIMP_GRADIENT_LINEAR:
+          for (x = 0; x < width; x++)
+            factors[x] = gradient_calc_linear_factor (rbd->dist,
+                                                      rbd->vec, rbd->offset,
+                                                      x - rbd->sx, dy);
+          break;
+
+        case GIMP_GRADIENT_BILINEAR:
+          for (x = 0; x < width; x++)
+            factors[x] = gradient_calc_bilinear_factor (rbd->dist,
+                                                        rbd->vec, rbd->offset,
+                                                        x - rbd->sx, dy);
+          break;
+
+        case GIMP_GRADIENT_RADIAL:
+          for (x = 0; x < width; x++)
+            factors[x] = gradient_calc_radial_factor (rbd->dist, rbd->offset,
+                                                      x - rbd->sx, dy);
+          break;
+
+        case GIMP_GRADIENT_SQUARE:
+          for (x = 0; x < width; x++)
+            factors[x] = gradient_calc_square_factor (rbd->dist, rbd->offset,
+                                                      x - rbd->sx, dy);
+          break;
+
+        case GIMP_GRADIENT_SHAPEBURST_ANGULAR:
+        case GIMP_GRADIENT_SHAPEBURST_SPHERICAL:
+        case GIMP_GRADIENT_SHAPEBURST_DIMPLED:
+          {
+            const gfloat *dist_row;
+
+            dist_row = (rbd->dist_data +
+                        (gsize) CLAMP (y, 0, rbd->dist_height - 1) *
+                        rbd->dist_width);
+
+            if (rbd->gradient_type == GIMP_GRADIENT_SHAPEBURST_ANGULAR)
+              {
+                for (x = 0; x < width; x++)
+                  factors[x] = gradient_calc_shapeburst_angular_factor (dist_row[x]);
+              }
+            else if (rbd->gradient_type == GIMP_GRADIENT_SHAPEBURST_SPHERICAL)
+              {
+                for (x = 0; x < width; x++)
+                  factors[x] = gradient_calc_shapeburst_spherical_factor (dist_row[x]);
+              }
+            else
+              {
+                for (x = 0; x < width; x++)
+                  factors[x] = gradient_calc_shapeburst_dimpled_factor (dist_row[x]);
+              }
+          }
+          break;
+
+        default:
+          for (x = 0; x < width; x++)
+            factors[x] = gradient_calc_factor (rbd, x, y);
+          break;
+        }
+    }
+
+  /* Adjust for repeat */
+
+  switch (rbd->repeat)
+    {
+    case GIMP_REPEAT_NONE:
+      for (x = 0; x < width; x++)
+        factors[x] = gradient_repeat (GIMP_REPEAT_NONE, factors[x]);
+      break;
 
-      if (rbd->reverse)
-        factor = 1.0 - factor;
+    case GIMP_REPEAT_SAWTOOTH:
+      for (x = 0; x < width; x++)
+        factors[x] = gradient_repeat (GIMP_REPEAT_SAWTOOTH, factors[x]);
+      break;
 
-      color->r = rbd->fg.r + (rbd->bg.r - rbd->fg.r) * factor;
-      color->g = rbd->fg.g + (rbd->bg.g - rbd->fg.g) * factor;
-      color->b = rbd->fg.b + (rbd->bg.b - rbd->fg.b) * factor;
-      color->a = rbd->fg.a + (rbd->bg.a - rbd->fg.a) * factor;
+    case GIMP_REPEAT_TRIANGULAR:
+      for (x = 0; x < width; x++)
+        factors[x] = gradient_repeat (GIMP_REPEAT_TRIANGULAR, factors[x]);
+      break;
+    }
+
+  /* Blend the colors */
 
-      if (rbd->blend_mode == GIMP_FG_BG_HSV_MODE)
+  if (rbd->sse2 &&
+      gimp_drawable_blend_row_lookup_sse2 (rbd->lut, rbd->lut_size,
+                                           factors, width, dest))
+    {
+      if (rbd->lut_edges)
         {
-          GimpHSV hsv = *((GimpHSV *) color);
+          for (x = 0; x < width; x++)
+            {
+              gdouble pos = factors[x] * rbd->lut_size;
+              gint    i   = CLAMP ((gint) pos, 0, rbd->lut_size - 1);
 
-          gimp_hsv_to_rgb (&hsv, color);
+              if (rbd->lut_edges[i])
+                gradient_lookup_edge (rbd, factors[x], dest + 4 * x);
+            }
+        }
+    }
+  else
+    {
+      for (x = 0; x < width; x++)
+        gradient_lookup (rbd, factors[x], dest + 4 * x);
+    }
+
+  if (dither_rand)
+    {
+      for (x = 0; x < width; x++)
+        {
+          gint i = g_rand_int (dither_rand);
+
+          *dest++ += (gdouble) (i & 0xff) / 256.0 / 256.0; i >>= 8;
+          *dest++ += (gdouble) (i & 0xff) / 256.0 / 256.0; i >>= 8;
+          *dest++ += (gdouble) (i & 0xff) / 256.0 / 256.0; i >>= 8;
+          *dest++ += (gdouble) (i & 0xff) / 256.0 / 256.0;
         }
     }
 }
 
+static void
+gradient_render_pixel (gdouble   x,
+                       gdouble   y,
+                       GimpRGB  *color,
+                       gpointer  render_data)
+{
+  RenderBlendData *rbd = render_data;
+  gdouble          factor;
+  gfloat           c[4];
+
+  factor = gradient_repeat (rbd->repeat, gradient_calc_factor (rbd, x, y));
+
+  gradient_lookup (rbd, factor, c);
+
+  color->r = c[0];
+  color->g = c[1];
+  color->b = c[2];
+  color->a = c[3];
+}
+
 static void
 gradient_put_pixel (gint      x,
                     gint      y,
@@ -786,11 +1153,21 @@ gradient_put_pixel (gint      x,
                     gpointer  put_pixel_data)
 {
   PutPixelData *ppd  = put_pixel_data;
-  gfloat       *dest = ppd->row_data + 4 * x;
+  gfloat       *dest = ppd->data + ((gsize) (y - ppd->y) * ppd->width + x) * 4;
 
-  if (ppd->dither_rand)
+  if (ppd->dither)
     {
-      gint i = g_rand_int (ppd->dither_rand);
+      /*  the samples aren't put in a fixed order, so the noise is a
+       *  hash of the pixel's position instead of a random sequence
+       */
+      guint32 i = ppd->seed ^ ((guint32) x * 0x9e3779b1u)
+                            ^ ((guint32) y * 0x85ebca77u);
+
+      i ^= i >> 16;
+      i *= 0x7feb352du;
+      i ^= i >> 15;
+      i *= 0x846ca68bu;
+      i ^= i >> 16;
 
       *dest++ = color->r + (gdouble) (i & 0xff) / 256.0 / 256.0; i >>= 8;
       *dest++ = color->g + (gdouble) (i & 0xff) / 256.0 / 256.0; i >>= 8;
@@ -804,13 +1181,63 @@ gradient_put_pixel (gint      x,
       *dest++ = color->b;
       *dest++ = color->a;
     }
+}
+
+static void
+gradient_render_rows_func (gsize    offset,
+                           gsize    size,
+                           gpointer user_data)
+{
+  RenderStripData *strip   = user_data;
+  gdouble         *factors = g_new (gdouble, strip->width);
+  gsize            row;
+
+  for (row = offset; row < offset + size; row++)
+    {
+      gint   y           = strip->y + row;
+      GRand *dither_rand = NULL;
+
+      /*  seed per row, so the result doesn't depend on the threads  */
+      if (strip->dither)
+        dither_rand = g_rand_new_with_seed (strip->seed + y);
+
+      gradient_render_row (strip->rbd, y, strip->width, factors,
+                           strip->data + row * strip->width * 4,
+                           dither_rand);
+
+      if (dither_rand)
+        g_rand_free (dither_rand);
+    }
 
-  /* Paint whole row if we are on the rightmost pixel */
+  g_free (factors);
+}
 
-  if (x == (ppd->width - 1))
-    gegl_buffer_set (ppd->buffer, GEGL_RECTANGLE (0, y, ppd->width, 1),
-                     0, babl_format ("R'G'B'A float"), ppd->row_data,
-                     GEGL_AUTO_ROWSTRIDE);
+/*  supersamples a band of rows of the strip.  The samples and their
+ *  dither noise are a function of their position only, so rendering
+ *  the bands independently gives the same result as one pass over the
+ *  region
+ */
+static void
+gradient_supersample_rows_func (gsize    offset,
+                                gsize    size,
+                                gpointer user_data)
+{
+  RenderStripData *strip = user_data;
+  PutPixelData     ppd;
+
+  ppd.data   = strip->data;
+  ppd.width  = strip->width;
+  ppd.y      = strip->y;
+  ppd.dither = strip->dither;
+  ppd.seed   = strip->seed;
+
+  gimp_adaptive_supersample_area (0, strip->y + offset,
+                                  strip->width - 1,
+                                  strip->y + offset + size - 1,
+                                  strip->max_depth, strip->threshold,
+                                  gradient_render_pixel, strip->rbd,
+                                  gradient_put_pixel, &ppd,
+                                  NULL, NULL);
 }
 
 static void
@@ -834,73 +1261,21 @@ gradient_fill_region (GimpImage           *image,
                       gdouble              ey,
                       GimpProgress        *progress)
 {
-  RenderBlendData rbd = { 0, };
+  RenderBlendData  rbd    = { 0, };
+  RenderStripData  strip;
+  GimpGradient    *gradient;
+  gint             width  = buffer_region->width;
+  gint             height = buffer_region->height;
+  gint             y;
 
   GIMP_TIMER_START();
 
-  rbd.gradient = gimp_context_get_gradient (context);
-  rbd.context  = context;
-  rbd.reverse  = reverse;
-
-#ifdef USE_GRADIENT_CACHE
-  {
-    gint i;
-
-    rbd.gradient_cache_size = ceil (sqrt (SQR (sx - ex) + SQR (sy - ey)));
-    rbd.gradient_cache      = g_new0 (GimpRGB, rbd.gradient_cache_size);
-
-    for (i = 0; i < rbd.gradient_cache_size; i++)
-      {
-        gdouble factor = (gdouble) i / (gdouble) (rbd.gradient_cache_size - 1);
-
-        gimp_gradient_get_color_at (rbd.gradient, rbd.context, NULL,
-                                    factor, rbd.reverse,
-                                    rbd.gradient_cache + i);
-      }
-  }
-#endif
+  gradient = gimp_context_get_gradient (context);
 
-  if (gimp_gradient_has_fg_bg_segments (rbd.gradient))
-    rbd.gradient = gimp_gradient_flatten (rbd.gradient, context);
+  if (gimp_gradient_has_fg_bg_segments (gradient))
+    gradient = gimp_gradient_flatten (gradient, context);
   else
-    rbd.gradient = g_object_ref (rbd.gradient);
-
-  gimp_context_get_foreground (context, &rbd.fg);
-  gimp_context_get_background (context, &rbd.bg);
-
-  switch (blend_mode)
-    {
-    case GIMP_FG_BG_RGB_MODE:
-      break;
-
-    case GIMP_FG_BG_HSV_MODE:
-      /* Convert to HSV */
-      {
-        GimpHSV fg_hsv;
-        GimpHSV bg_hsv;
-
-        gimp_rgb_to_hsv (&rbd.fg, &fg_hsv);
-        gimp_rgb_to_hsv (&rbd.bg, &bg_hsv);
-
-        memcpy (&rbd.fg, &fg_hsv, sizeof (GimpRGB));
-        memcpy (&rbd.bg, &bg_hsv, sizeof (GimpRGB));
-      }
-      break;
-
-    case GIMP_FG_TRANSPARENT_MODE:
-      /* Color does not change, just the opacity */
-
-      rbd.bg   = rbd.fg;
-      rbd.bg.a = GIMP_OPACITY_TRANSPARENT;
-      break;
-
-    case GIMP_CUSTOM_MODE:
-      break;
-
-    default:
-      g_assert_not_reached ();
-      break;
-    }
+    gradient = g_object_ref (gradient);
 
   /* Calculate type-specific parameters */
 
@@ -933,10 +1308,12 @@ gradient_fill_region (GimpImage           *image,
     case GIMP_GRADIENT_SHAPEBURST_ANGULAR:
     case GIMP_GRADIENT_SHAPEBURST_SPHERICAL:
     case GIMP_GRADIENT_SHAPEBURST_DIMPLED:
-      rbd.dist = sqrt (SQR (ex - sx) + SQR (ey - sy));
-      rbd.dist_buffer = gradient_precalc_shapeburst (image, drawable,
+      rbd.dist        = sqrt (SQR (ex - sx) + SQR (ey - sy));
+      rbd.dist_data   = gradient_precalc_shapeburst (image, drawable,
                                                      buffer_region,
                                                      rbd.dist, progress);
+      rbd.dist_width  = width;
+      rbd.dist_height = height;
       gimp_progress_set_text (progress, _("Blending"));
       break;
 
@@ -947,114 +1324,70 @@ gradient_fill_region (GimpImage           *image,
 
   /* Initialize render data */
 
+  rbd.lut_size      = gradient_calc_lut_size (gradient_type, rbd.dist,
+                                              offset, sx, sy,
+                                              width, height);
+  rbd.gradient      = gradient;
+  rbd.context       = context;
+  rbd.reverse       = reverse;
+  rbd.sse2          = (gimp_cpu_accel_get_support () &
+                       GIMP_CPU_ACCEL_X86_SSE2) != 0;
   rbd.offset        = offset;
   rbd.sx            = sx;
   rbd.sy            = sy;
-  rbd.blend_mode    = blend_mode;
   rbd.gradient_type = gradient_type;
   rbd.repeat        = repeat;
 
-  /* Render the gradient! */
+  gradient_precalc_lut (&rbd, blend_mode);
 
-  if (supersample)
-    {
-      PutPixelData  ppd;
-
-      ppd.buffer      = buffer;
-      ppd.row_data    = g_malloc (sizeof (float) * 4 * buffer_region->width);
-      ppd.width       = buffer_region->width;
-      ppd.dither_rand = g_rand_new ();
-
-      gimp_adaptive_supersample_area (0, 0,
-                                      (buffer_region->width  - 1),
-                                      (buffer_region->height - 1),
-                                      max_depth, threshold,
-                                      gradient_render_pixel, &rbd,
-                                      gradient_put_pixel, &ppd,
-                                      progress ?
-                                      gimp_progress_update_and_flush : NULL,
-                                      progress);
-
-      g_rand_free (ppd.dither_rand);
-      g_free (ppd.row_data);
-    }
-  else
-    {
-      GeglBufferIterator *iter;
-      GeglRectangle      *roi;
-      gint                total = buffer_region->width * buffer_region->height;
-      gint                done  = 0;
+  strip.rbd       = &rbd;
+  strip.data      = g_new (gfloat, (gsize) width * STRIP_HEIGHT * 4);
+  strip.width     = width;
+  strip.dither    = dither;
+  strip.seed      = dither ? g_random_int () : 0;
+  strip.max_depth = max_depth;
+  strip.threshold = threshold;
 
-      iter = gegl_buffer_iterator_new (buffer, buffer_region, 0,
-                                       babl_format ("R'G'B'A float"),
-                                       GEGL_BUFFER_WRITE, GEGL_ABYSS_NONE);
-      roi = &iter->roi[0];
-
-      if (dither)
-        rbd.seed = g_rand_new ();
+  /* Render the gradient! */
 
-      while (gegl_buffer_iterator_next (iter))
+  for (y = 0; y < height; y += STRIP_HEIGHT)
+    {
+      gint strip_height = MIN (STRIP_HEIGHT, height - y);
+
+      strip.y = y;
+
+      /*  the rows of a strip are rendered in parallel into linear
+       *  memory, only the calling thread touches the buffer
+       */
+      gimp_parallel_distribute_range (strip_height, MIN_PARALLEL_ROWS,
+                                      supersample ?
+                                      gradient_supersample_rows_func :
+                                      gradient_render_rows_func,
+                                      &strip);
+
+      gegl_buffer_set (buffer,
+                       GEGL_RECTANGLE (buffer_region->x, buffer_region->y + y,
+                                       width, strip_height),
+                       0, babl_format ("R'G'B'A float"), strip.data,
+                       GEGL_AUTO_ROWSTRIDE);
+
+      if (progress)
         {
-          gfloat *dest = iter->data[0];
-          gint    endx  = roi->x + roi->width;
-          gint    endy  = roi->y + roi->height;
-          gint    x, y;
-
-          if (rbd.seed)
-            {
-              GRand *dither_rand = g_rand_new_with_seed (g_rand_int (rbd.seed));
-
-              for (y = roi->y; y < endy; y++)
-                for (x = roi->x; x < endx; x++)
-                  {
-                    GimpRGB  color;
-                    gint     i = g_rand_int (dither_rand);
-
-                    gradient_render_pixel (x, y, &color, &rbd);
-
-                    *dest++ = color.r + (gdouble) (i & 0xff) / 256.0 / 256.0; i >>= 8;
-                    *dest++ = color.g + (gdouble) (i & 0xff) / 256.0 / 256.0; i >>= 8;
-                    *dest++ = color.b + (gdouble) (i & 0xff) / 256.0 / 256.0; i >>= 8;
-                    *dest++ = color.a + (gdouble) (i & 0xff) / 256.0 / 256.0;
-                  }
-
-              g_rand_free (dither_rand);
-            }
+          if (supersample)
+            gimp_progress_update_and_flush (0, height, y + strip_height,
+                                            progress);
           else
-            {
-              for (y = roi->y; y < endy; y++)
-                for (x = roi->x; x < endx; x++)
-                  {
-                    GimpRGB  color;
-
-                    gradient_render_pixel (x, y, &color, &rbd);
-
-                    *dest++ = color.r;
-                    *dest++ = color.g;
-                    *dest++ = color.b;
-                    *dest++ = color.a;
-                  }
-            }
-
-          done += roi->width * roi->height;
-
-          if (progress)
             gimp_progress_set_value (progress,
-                                     (gdouble) done / (gdouble) total);
+                                     (gdouble) (y + strip_height) /
+                                     (gdouble) height);
         }
-
-      if (dither)
-        g_rand_free (rbd.seed);
     }
 
-#ifdef USE_GRADIENT_CACHE
-  g_free (rbd.gradient_cache);
-#endif
-
+  g_free (strip.data);
+  g_free (rbd.lut);
+  g_free (rbd.lut_edges);
+  g_free (rbd.dist_data);
   g_object_unref (rbd.gradient);
 
-  if (rbd.dist_buffer)
-    g_object_unref (rbd.dist_buffer);
-
   GIMP_TIMER_END("gradient_fill_region");
 }
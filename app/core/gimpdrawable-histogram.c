@@ -31,6 +31,14 @@
 #include "gimpimage.h"
 
 
+static void   gimp_drawable_calculate_histogram_internal
+                                              (GimpDrawable        *drawable,
+                                               GimpHistogram       *histogram,
+                                               gboolean             incremental,
+                                               const GeglRectangle *dirty_rects,
+                                               gint                 n_dirty_rects);
+
+
 void
 gimp_drawable_calculate_histogram (GimpDrawable  *drawable,
                                    GimpHistogram *histogram)
@@ -98,25 +106,77 @@ gimp_drawable_calculate_histogram (GimpDrawable  *drawable,
     }
   else
     {
-      if (! gimp_channel_is_empty (mask))
-        {
-          gint off_x, off_y;
+      gimp_drawable_calculate_histogram_internal (drawable, histogram,
+                                                  FALSE, NULL, -1);
+    }
+}
 
-          gimp_item_get_offset (GIMP_ITEM (drawable), &off_x, &off_y);
+/*  like gimp_drawable_calculate_histogram(), but only counts the
+ *  parts touched by @dirty_rects again if @histogram was last
+ *  calculated by this function for the same pixels, see
+ *  gimp_histogram_calculate_incremental()
+ */
+void
+gimp_drawable_calculate_histogram_incremental (GimpDrawable        *drawable,
+                                               GimpHistogram       *histogram,
+                                               const GeglRectangle *dirty_rects,
+                                               gint                 n_dirty_rects)
+{
+  g_return_if_fail (GIMP_IS_DRAWABLE (drawable));
+  g_return_if_fail (gimp_item_is_attached (GIMP_ITEM (drawable)));
+  g_return_if_fail (histogram != NULL);
 
-          gimp_histogram_calculate (histogram,
-                                    gimp_drawable_get_buffer (drawable),
-                                    GEGL_RECTANGLE (x, y, width, height),
-                                    gimp_drawable_get_buffer (GIMP_DRAWABLE (mask)),
-                                    GEGL_RECTANGLE (x + off_x, y + off_y,
-                                                    width, height));
-        }
-      else
-        {
-          gimp_histogram_calculate (histogram,
-                                    gimp_drawable_get_buffer (drawable),
-                                    GEGL_RECTANGLE (x, y, width, height),
-                                    NULL, NULL);
-        }
+  gimp_drawable_calculate_histogram_internal (drawable, histogram,
+                                              TRUE,
+                                              dirty_rects, n_dirty_rects);
+}
+
+
+/*  private functions  */
+
+static void
+gimp_drawable_calculate_histogram_internal (GimpDrawable        *drawable,
+                                            GimpHistogram       *histogram,
+                                            gboolean             incremental,
+                                            const GeglRectangle *dirty_rects,
+                                            gint                 n_dirty_rects)
+{
+  GimpImage     *image;
+  GimpChannel   *mask;
+  GeglBuffer    *mask_buffer = NULL;
+  GeglRectangle  rect;
+  GeglRectangle  mask_rect;
+
+  if (! gimp_item_mask_intersect (GIMP_ITEM (drawable),
+                                  &rect.x, &rect.y,
+                                  &rect.width, &rect.height))
+    return;
+
+  image = gimp_item_get_image (GIMP_ITEM (drawable));
+  mask  = gimp_image_get_mask (image);
+
+  if (! gimp_channel_is_empty (mask))
+    {
+      gint off_x, off_y;
+
+      gimp_item_get_offset (GIMP_ITEM (drawable), &off_x, &off_y);
+
+      mask_buffer = gimp_drawable_get_buffer (GIMP_DRAWABLE (mask));
+
+      mask_rect    = rect;
+      mask_rect.x += off_x;
+      mask_rect.y += off_y;
     }
+
+  if (incremental)
+    gimp_histogram_calculate_incremental (histogram,
+                                          gimp_drawable_get_buffer (drawable),
+                                          &rect,
+                                          mask_buffer, &mask_rect,
+                                          dirty_rects, n_dirty_rects);
+  else
+    gimp_histogram_calculate (histogram,
+                              gimp_drawable_get_buffer (drawable),
+                              &rect,
+                              mask_buffer, &mask_rect);
 }
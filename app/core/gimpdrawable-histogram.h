@@ -21,8 +21,13 @@
 #define __GIMP_DRAWABLE_HISTOGRAM_H__
 
 
-void   gimp_drawable_calculate_histogram (GimpDrawable  *drawable,
-                                          GimpHistogram *histogram);
+void   gimp_drawable_calculate_histogram (GimpDrawable        *drawable,
+                                          GimpHistogram       *histogram);
+void   gimp_drawable_calculate_histogram_incremental
+                                         (GimpDrawable        *drawable,
+                                          GimpHistogram       *histogram,
+                                          const GeglRectangle *dirty_rects,
+                                          gint                 n_dirty_rects);
 
 
 #endif /* __GIMP_HISTOGRAM_H__ */
@@ -30,6 +30,7 @@
 #include "gegl/gimpapplicator.h"
 #include "gegl/gimp-babl.h"
 #include "gegl/gimp-gegl-apply-operation.h"
+#include "gegl/gimp-gegl-cow.h"
 #include "gegl/gimp-gegl-utils.h"
 
 #include "gimp-utils.h"
@@ -167,7 +168,9 @@ static void       gimp_drawable_real_push_undo     (GimpDrawable      *drawable,
                                                     gint               x,
                                                     gint               y,
                                                     gint               width,
-                                                    gint               height);
+                                                    gint               height,
+                                                    const GeglRectangle *rects,
+                                                    gint               n_rects);
 static void       gimp_drawable_real_swap_pixels   (GimpDrawable      *drawable,
                                                     GeglBuffer        *buffer,
                                                     gint               x,
@@ -489,7 +492,7 @@ gimp_drawable_duplicate (GimpItem *item,
         g_object_unref (new_drawable->private->buffer);
 
       new_drawable->private->buffer =
-        gegl_buffer_dup (gimp_drawable_get_buffer (drawable));
+        gimp_gegl_buffer_dup (gimp_drawable_get_buffer (drawable));
     }
 
   return new_item;
@@ -843,23 +846,22 @@ gimp_drawable_real_set_buffer (GimpDrawable *drawable,
 }
 
 static void
-gimp_drawable_real_push_undo (GimpDrawable *drawable,
-                              const gchar  *undo_desc,
-                              GeglBuffer   *buffer,
-                              gint          x,
-                              gint          y,
-                              gint          width,
-                              gint          height)
+gimp_drawable_real_push_undo (GimpDrawable        *drawable,
+                              const gchar         *undo_desc,
+                              GeglBuffer          *buffer,
+                              gint                 x,
+                              gint                 y,
+                              gint                 width,
+                              gint                 height,
+                              const GeglRectangle *rects,
+                              gint                 n_rects)
 {
+  /*  the undo reads the pixels right away, no need to copy them first  */
   if (! buffer)
     {
-      buffer = gegl_buffer_new (GEGL_RECTANGLE (0, 0, width, height),
-                                gimp_drawable_get_format (drawable));
-
-      gegl_buffer_copy (gimp_drawable_get_buffer (drawable),
-                        GEGL_RECTANGLE (x, y, width, height),
-                        buffer,
-                        GEGL_RECTANGLE (0, 0, 0, 0));
+      buffer = gegl_buffer_create_sub_buffer (gimp_drawable_get_buffer (drawable),
+                                              GEGL_RECTANGLE (x, y,
+                                                              width, height));
     }
   else
     {
@@ -868,7 +870,8 @@ gimp_drawable_real_push_undo (GimpDrawable *drawable,
 
   gimp_image_undo_push_drawable (gimp_item_get_image (GIMP_ITEM (drawable)),
                                  undo_desc, drawable,
-                                 buffer, x, y);
+                                 buffer, x, y,
+                                 rects, n_rects);
 
   g_object_unref (buffer);
 }
@@ -1453,11 +1456,33 @@ gimp_drawable_push_undo (GimpDrawable *drawable,
                          gint          y,
                          gint          width,
                          gint          height)
+{
+  gimp_drawable_push_undo_rects (drawable, undo_desc, buffer,
+                                 x, y, width, height,
+                                 NULL, 0);
+}
+
+/*  like gimp_drawable_push_undo(), but only the pixels of @buffer
+ *  within @rects, given in drawable coordinates, are stored.  The
+ *  pixels outside of them must not have been changed by the operation
+ *  and are taken from the drawable when the undo is popped
+ */
+void
+gimp_drawable_push_undo_rects (GimpDrawable        *drawable,
+                               const gchar         *undo_desc,
+                               GeglBuffer          *buffer,
+                               gint                 x,
+                               gint                 y,
+                               gint                 width,
+                               gint                 height,
+                               const GeglRectangle *rects,
+                               gint                 n_rects)
 {
   GimpItem *item;
 
   g_return_if_fail (GIMP_IS_DRAWABLE (drawable));
   g_return_if_fail (buffer == NULL || GEGL_IS_BUFFER (buffer));
+  g_return_if_fail (rects != NULL || n_rects == 0);
 
   item = GIMP_ITEM (drawable);
 
@@ -1477,7 +1502,8 @@ gimp_drawable_push_undo (GimpDrawable *drawable,
 
   GIMP_DRAWABLE_GET_CLASS (drawable)->push_undo (drawable, undo_desc,
                                                  buffer,
-                                                 x, y, width, height);
+                                                 x, y, width, height,
+                                                 rects, n_rects);
 }
 
 void
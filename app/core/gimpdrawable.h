@@ -101,7 +101,9 @@ struct _GimpDrawableClass
                                            gint                  x,
                                            gint                  y,
                                            gint                  width,
-                                           gint                  height);
+                                           gint                  height,
+                                           const GeglRectangle  *rects,
+                                           gint                  n_rects);
   void          (* swap_pixels)           (GimpDrawable         *drawable,
                                            GeglBuffer           *buffer,
                                            gint                  x,
@@ -192,6 +194,15 @@ void            gimp_drawable_push_undo          (GimpDrawable       *drawable,
                                                   gint                y,
                                                   gint                width,
                                                   gint                height);
+void            gimp_drawable_push_undo_rects    (GimpDrawable       *drawable,
+                                                  const gchar        *undo_desc,
+                                                  GeglBuffer         *buffer,
+                                                  gint                x,
+                                                  gint                y,
+                                                  gint                width,
+                                                  gint                height,
+                                                  const GeglRectangle *rects,
+                                                  gint                n_rects);
 
 void            gimp_drawable_fill               (GimpDrawable       *drawable,
                                                   const GimpRGB      *color,
@@ -23,16 +23,21 @@
 
 #include "core-types.h"
 
-#include "gimp-utils.h"
+#include "gimp.h"
 #include "gimpimage.h"
 #include "gimpdrawable.h"
 #include "gimpdrawableundo.h"
+#include "gimpundotiles.h"
+
+#include "gimp-intl.h"
 
 
 enum
 {
   PROP_0,
   PROP_BUFFER,
+  PROP_RECTS,
+  PROP_N_RECTS,
   PROP_X,
   PROP_Y
 };
@@ -82,9 +87,20 @@ gimp_drawable_undo_class_init (GimpDrawableUndoClass *klass)
   g_object_class_install_property (object_class, PROP_BUFFER,
                                    g_param_spec_object ("buffer", NULL, NULL,
                                                         GEGL_TYPE_BUFFER,
-                                                        GIMP_PARAM_READWRITE |
+                                                        GIMP_PARAM_WRITABLE |
                                                         G_PARAM_CONSTRUCT_ONLY));
 
+  g_object_class_install_property (object_class, PROP_RECTS,
+                                   g_param_spec_pointer ("rects", NULL, NULL,
+                                                         GIMP_PARAM_WRITABLE |
+                                                         G_PARAM_CONSTRUCT_ONLY));
+
+  g_object_class_install_property (object_class, PROP_N_RECTS,
+                                   g_param_spec_int ("n-rects", NULL, NULL,
+                                                     0, G_MAXINT, 0,
+                                                     GIMP_PARAM_WRITABLE |
+                                                     G_PARAM_CONSTRUCT_ONLY));
+
   g_object_class_install_property (object_class, PROP_X,
                                    g_param_spec_int ("x", NULL, NULL,
                                                      0, GIMP_MAX_IMAGE_SIZE, 0,
@@ -107,11 +123,36 @@ static void
 gimp_drawable_undo_constructed (GObject *object)
 {
   GimpDrawableUndo *drawable_undo = GIMP_DRAWABLE_UNDO (object);
+  GeglRectangle    *local         = NULL;
+  gint              i;
 
   G_OBJECT_CLASS (parent_class)->constructed (object);
 
   g_assert (GIMP_IS_DRAWABLE (GIMP_ITEM_UNDO (object)->item));
-  g_assert (drawable_undo->buffer != NULL);
+  g_assert (GEGL_IS_BUFFER (drawable_undo->buffer));
+
+  /*  "rects" are in drawable coordinates, the tiles start at x, y  */
+  if (drawable_undo->rects)
+    {
+      local = g_new (GeglRectangle, MAX (drawable_undo->n_rects, 1));
+
+      for (i = 0; i < drawable_undo->n_rects; i++)
+        {
+          local[i]    = drawable_undo->rects[i];
+          local[i].x -= drawable_undo->x;
+          local[i].y -= drawable_undo->y;
+        }
+    }
+
+  drawable_undo->tiles = gimp_undo_tiles_new (drawable_undo->buffer,
+                                              local,
+                                              drawable_undo->n_rects);
+
+  g_free (local);
+
+  g_clear_object (&drawable_undo->buffer);
+  drawable_undo->rects   = NULL;
+  drawable_undo->n_rects = 0;
 }
 
 static void
@@ -127,6 +168,12 @@ gimp_drawable_undo_set_property (GObject      *object,
     case PROP_BUFFER:
       drawable_undo->buffer = g_value_dup_object (value);
       break;
+    case PROP_RECTS:
+      drawable_undo->rects = g_value_get_pointer (value);
+      break;
+    case PROP_N_RECTS:
+      drawable_undo->n_rects = g_value_get_int (value);
+      break;
     case PROP_X:
       drawable_undo->x = g_value_get_int (value);
       break;
@@ -150,9 +197,6 @@ gimp_drawable_undo_get_property (GObject    *object,
 
   switch (property_id)
     {
-    case PROP_BUFFER:
-      g_value_set_object (value, drawable_undo->buffer);
-      break;
     case PROP_X:
       g_value_set_int (value, drawable_undo->x);
       break;
@@ -173,7 +217,7 @@ gimp_drawable_undo_get_memsize (GimpObject *object,
   GimpDrawableUndo *drawable_undo = GIMP_DRAWABLE_UNDO (object);
   gint64            memsize       = 0;
 
-  memsize += gimp_gegl_buffer_get_memsize (drawable_undo->buffer);
+  memsize += gimp_undo_tiles_get_memsize (drawable_undo->tiles);
 
   return memsize + GIMP_OBJECT_CLASS (parent_class)->get_memsize (object,
                                                                   gui_size);
@@ -185,13 +229,44 @@ gimp_drawable_undo_pop (GimpUndo            *undo,
                         GimpUndoAccumulator *accum)
 {
   GimpDrawableUndo *drawable_undo = GIMP_DRAWABLE_UNDO (undo);
+  GimpDrawable     *drawable      = GIMP_DRAWABLE (GIMP_ITEM_UNDO (undo)->item);
+  GeglBuffer       *buffer;
+  GError           *error         = NULL;
 
   GIMP_UNDO_CLASS (parent_class)->pop (undo, undo_mode, accum);
 
-  gimp_drawable_swap_pixels (GIMP_DRAWABLE (GIMP_ITEM_UNDO (undo)->item),
-                             drawable_undo->buffer,
+  /*  once the stored pixels are lost, the step leaves the drawable
+   *  alone in both directions
+   */
+  if (drawable_undo->failed)
+    return;
+
+  buffer = gimp_undo_tiles_get_buffer (drawable_undo->tiles,
+                                       gimp_drawable_get_buffer (drawable),
+                                       drawable_undo->x,
+                                       drawable_undo->y,
+                                       &error);
+
+  if (! buffer)
+    {
+      gimp_message (undo->image->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    _("Could not restore the pixels of '%s', the "
+                      "drawable was left unchanged: %s"),
+                    gimp_object_get_name (drawable), error->message);
+      g_clear_error (&error);
+
+      drawable_undo->failed = TRUE;
+
+      return;
+    }
+
+  gimp_drawable_swap_pixels (drawable, buffer,
                              drawable_undo->x,
                              drawable_undo->y);
+
+  gimp_undo_tiles_set_buffer (drawable_undo->tiles, buffer);
+
+  g_object_unref (buffer);
 }
 
 static void
@@ -200,10 +275,10 @@ gimp_drawable_undo_free (GimpUndo     *undo,
 {
   GimpDrawableUndo *drawable_undo = GIMP_DRAWABLE_UNDO (undo);
 
-  if (drawable_undo->buffer)
+  if (drawable_undo->tiles)
     {
-      g_object_unref (drawable_undo->buffer);
-      drawable_undo->buffer = NULL;
+      gimp_undo_tiles_unref (drawable_undo->tiles);
+      drawable_undo->tiles = NULL;
     }
 
   if (drawable_undo->applied_buffer)
@@ -214,3 +289,16 @@ gimp_drawable_undo_free (GimpUndo     *undo,
 
   GIMP_UNDO_CLASS (parent_class)->free (undo, undo_mode);
 }
+
+
+/*  public functions  */
+
+gboolean
+gimp_drawable_undo_swap_out (GimpDrawableUndo  *undo,
+                             GError           **error)
+{
+  g_return_val_if_fail (GIMP_IS_DRAWABLE_UNDO (undo), FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  return gimp_undo_tiles_swap_out (undo->tiles, error);
+}
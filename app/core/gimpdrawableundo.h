@@ -34,11 +34,17 @@ typedef struct _GimpDrawableUndoClass GimpDrawableUndoClass;
 
 struct _GimpDrawableUndo
 {
-  GimpItemUndo  parent_instance;
+  GimpItemUndo         parent_instance;
 
-  GeglBuffer   *buffer;
-  gint          x;
-  gint          y;
+  GimpUndoTiles       *tiles;
+  gint                 x;
+  gint                 y;
+  gboolean             failed;  /* the pixels couldn't be restored */
+
+  /* only set during construction */
+  GeglBuffer          *buffer;
+  const GeglRectangle *rects;
+  gint                 n_rects;
 
   /* stuff for "Fade" */
   GeglBuffer           *applied_buffer;
@@ -52,7 +58,10 @@ struct _GimpDrawableUndoClass
 };
 
 
-GType   gimp_drawable_undo_get_type (void) G_GNUC_CONST;
+GType      gimp_drawable_undo_get_type  (void) G_GNUC_CONST;
+
+gboolean   gimp_drawable_undo_swap_out  (GimpDrawableUndo  *undo,
+                                         GError           **error);
 
 
 #endif /* __GIMP_DRAWABLE_UNDO_H__ */
@@ -29,9 +29,24 @@
 
 #include "gegl/gimp-babl.h"
 
+#include "gimp-parallel.h"
 #include "gimphistogram.h"
 
 
+/*  buffers are read in strips of rows, the rows of a strip are counted
+ *  into one partial histogram per thread, which are added up at the end
+ */
+#define STRIP_HEIGHT        32
+#define MIN_PARALLEL_PIXELS 4096
+
+/*  gimp_histogram_calculate_incremental() keeps a partial histogram
+ *  for each cell of at least CELL_SIZE x CELL_SIZE pixels, and at most
+ *  MAX_CELLS of them
+ */
+#define CELL_SIZE           256
+#define MAX_CELLS           256
+
+
 enum
 {
   PROP_0,
@@ -42,12 +57,34 @@ enum
 
 struct _GimpHistogramPrivate
 {
-  gboolean gamma_correct;
-  gint     n_channels;
-  gint     n_bins;
-  gdouble *values;
+  gboolean       gamma_correct;
+  gint           n_channels;
+  gint           n_bins;
+  gdouble       *values;
+
+  /*  what gimp_histogram_calculate_incremental() last counted  */
+  GeglBuffer    *source;
+  GeglRectangle  source_rect;
+  const Babl    *source_format;
+  GeglBuffer    *mask;
+  GeglRectangle  mask_rect;
+  gint           cell_size;
+  gint           n_cell_cols;
+  gint           n_cell_rows;
+  gdouble       *cells;      /* the partial histograms of the cells */
 };
 
+typedef struct
+{
+  const gfloat  *data;
+  const gfloat  *mask;
+  gint           n_components;
+  gint           n_bins;
+  gint           width;
+  gint           height;
+  gdouble      **partials;
+} GimpHistogramStrip;
+
 
 /*  local function prototypes  */
 
@@ -68,6 +105,30 @@ static void     gimp_histogram_alloc_values (GimpHistogram *histogram,
                                              gint           n_components,
                                              gint           n_bins);
 
+static const Babl * gimp_histogram_get_format     (GimpHistogram       *histogram,
+                                                   GeglBuffer          *buffer,
+                                                   gint                *n_bins);
+static gboolean     gimp_histogram_calculate_internal
+                                                  (GimpHistogram       *histogram,
+                                                   GeglBuffer          *buffer,
+                                                   const GeglRectangle *buffer_rect,
+                                                   GeglBuffer          *mask,
+                                                   const GeglRectangle *mask_rect);
+static void         gimp_histogram_accumulate     (GimpHistogram       *histogram,
+                                                   GeglBuffer          *buffer,
+                                                   const GeglRectangle *buffer_rect,
+                                                   const Babl          *format,
+                                                   GeglBuffer          *mask,
+                                                   const GeglRectangle *mask_rect,
+                                                   gdouble             *values);
+static void         gimp_histogram_count_cell     (GimpHistogram       *histogram,
+                                                   GeglBuffer          *buffer,
+                                                   gint                 cell);
+static void         gimp_histogram_accumulate_func (gint                i,
+                                                   gint                 n,
+                                                   gpointer             user_data);
+static void         gimp_histogram_clear_source   (GimpHistogram       *histogram);
+
 
 G_DEFINE_TYPE (GimpHistogram, gimp_histogram, GIMP_TYPE_OBJECT)
 
@@ -179,6 +240,12 @@ gimp_histogram_get_memsize (GimpObject *object,
     memsize += (histogram->priv->n_channels *
                 histogram->priv->n_bins * sizeof (gdouble));
 
+  if (histogram->priv->cells)
+    memsize += ((gint64) histogram->priv->n_cell_cols *
+                histogram->priv->n_cell_rows *
+                histogram->priv->n_channels *
+                histogram->priv->n_bins * sizeof (gdouble));
+
   return memsize + GIMP_OBJECT_CLASS (parent_class)->get_memsize (object,
                                                                   gui_size);
 }
@@ -229,251 +296,182 @@ gimp_histogram_calculate (GimpHistogram       *histogram,
                           const GeglRectangle *buffer_rect,
                           GeglBuffer          *mask,
                           const GeglRectangle *mask_rect)
+{
+  g_return_if_fail (GIMP_IS_HISTOGRAM (histogram));
+  g_return_if_fail (GEGL_IS_BUFFER (buffer));
+  g_return_if_fail (buffer_rect != NULL);
+
+  gimp_histogram_clear_source (histogram);
+
+  gimp_histogram_calculate_internal (histogram,
+                                     buffer, buffer_rect,
+                                     mask, mask_rect);
+}
+
+/**
+ * gimp_histogram_calculate_incremental:
+ * @histogram:     a %GimpHistogram
+ * @buffer:        the buffer to count
+ * @buffer_rect:   the area of @buffer to count
+ * @mask:          an optional mask weighting the pixels
+ * @mask_rect:     the area of @mask corresponding to @buffer_rect
+ * @dirty_rects:   the parts of @buffer changed since the last call
+ * @n_dirty_rects: the number of @dirty_rects, or -1 if all of @buffer
+ *                 may have changed
+ *
+ * Like gimp_histogram_calculate(), but keeps a partial histogram for
+ * each cell of a grid over @buffer_rect.  If the previous call counted
+ * the same @buffer, rectangles and @mask, only the cells touching
+ * @dirty_rects are counted again from @buffer, and the histogram is
+ * the sum of all cells again, so no rounding errors pile up.  The
+ * contents of @mask must not have changed since.
+ **/
+void
+gimp_histogram_calculate_incremental (GimpHistogram       *histogram,
+                                      GeglBuffer          *buffer,
+                                      const GeglRectangle *buffer_rect,
+                                      GeglBuffer          *mask,
+                                      const GeglRectangle *mask_rect,
+                                      const GeglRectangle *dirty_rects,
+                                      gint                 n_dirty_rects)
 {
   GimpHistogramPrivate *priv;
-  GeglBufferIterator   *iter;
   const Babl           *format;
-  gint                  n_components;
   gint                  n_bins;
+  gint                  n_cells;
+  gint                  n_values;
+  gboolean             *dirty;
+  gboolean              any_dirty = FALSE;
+  gint                  i, j;
 
   g_return_if_fail (GIMP_IS_HISTOGRAM (histogram));
   g_return_if_fail (GEGL_IS_BUFFER (buffer));
   g_return_if_fail (buffer_rect != NULL);
+  g_return_if_fail (n_dirty_rects <= 0 || dirty_rects != NULL);
 
   priv = histogram->priv;
 
-  format = gegl_buffer_get_format (buffer);
+  format = gimp_histogram_get_format (histogram, buffer, &n_bins);
 
-  if (babl_format_get_type (format, 0) == babl_type ("u8"))
-    n_bins = 256;
-  else
-    n_bins = 1024;
-
-  if (babl_format_is_palette (format))
-    {
-      if (babl_format_has_alpha (format))
-        format = babl_format ("R'G'B'A float");
-      else
-        format = babl_format ("R'G'B' float");
-    }
-  else
-    {
-      const Babl *model = babl_format_get_model (format);
-
-      if (model == babl_model ("Y"))
-        {
-          if (priv->gamma_correct)
-            format = babl_format ("Y' float");
-          else
-            format = babl_format ("Y float");
-        }
-      else if (model == babl_model ("Y'"))
-        {
-          format = babl_format ("Y' float");
-        }
-      else if (model == babl_model ("YA"))
-        {
-          if (priv->gamma_correct)
-            format = babl_format ("Y'A float");
-          else
-            format = babl_format ("YA float");
-        }
-      else if (model == babl_model ("Y'A"))
-        {
-          format = babl_format ("Y'A float");
-        }
-      else if (model == babl_model ("RGB"))
-        {
-          if (priv->gamma_correct)
-            format = babl_format ("R'G'B' float");
-          else
-            format = babl_format ("RGB float");
-        }
-      else if (model == babl_model ("R'G'B'"))
-        {
-          format = babl_format ("R'G'B' float");
-        }
-      else if (model == babl_model ("RGBA"))
-        {
-          if (priv->gamma_correct)
-            format = babl_format ("R'G'B'A float");
-          else
-            format = babl_format ("RGBA float");
-        }
-      else if (model == babl_model ("R'G'B'A"))
-        {
-          format = babl_format ("R'G'B'A float");
-        }
-      else
-        {
-          g_return_if_reached ();
-        }
-    }
-
-  n_components = babl_format_get_n_components (format);
+  if (! format)
+    return;
 
   g_object_freeze_notify (G_OBJECT (histogram));
 
-  gimp_histogram_alloc_values (histogram, n_components, n_bins);
-
-  iter = gegl_buffer_iterator_new (buffer, buffer_rect, 0, format,
-                                   GEGL_BUFFER_READ, GEGL_ABYSS_NONE);
+  /*  start over if anything but the pixels changed  */
+  if (n_dirty_rects < 0                                              ||
+      ! priv->cells                                                  ||
+      priv->source != buffer                                         ||
+      ! gegl_rectangle_equal (&priv->source_rect, buffer_rect)       ||
+      priv->source_format != format                                  ||
+      priv->mask != mask                                             ||
+      (mask && ! gegl_rectangle_equal (&priv->mask_rect, mask_rect)) ||
+      n_bins != priv->n_bins)
+    {
+      gimp_histogram_clear_source (histogram);
 
-  if (mask)
-    gegl_buffer_iterator_add (iter, mask, mask_rect, 0,
-                              babl_format ("Y float"),
-                              GEGL_BUFFER_READ, GEGL_ABYSS_NONE);
+      gimp_histogram_alloc_values (histogram,
+                                   babl_format_get_n_components (format),
+                                   n_bins);
 
-#define VALUE(c,i) (priv->values[(c) * priv->n_bins + \
-                                 (gint) (CLAMP ((i), 0.0, 1.0) * \
-                                         (priv->n_bins - 0.0001))])
+      priv->source        = buffer;
+      priv->source_rect   = *buffer_rect;
+      priv->source_format = format;
 
-  while (gegl_buffer_iterator_next (iter))
-    {
-      const gfloat *data = iter->data[0];
-      gfloat        max;
+      g_object_add_weak_pointer (G_OBJECT (priv->source),
+                                 (gpointer) &priv->source);
 
       if (mask)
         {
-          const gfloat *mask_data = iter->data[1];
+          priv->mask      = mask;
+          priv->mask_rect = *mask_rect;
 
-          switch (n_components)
-            {
-            case 1:
-              while (iter->length--)
-                {
-                  const gdouble masked = *mask_data;
-
-                  VALUE (0, data[0]) += masked;
-
-                  data += n_components;
-                  mask_data += 1;
-                }
-              break;
-
-            case 2:
-              while (iter->length--)
-                {
-                  const gdouble masked = *mask_data;
-                  const gdouble weight = data[1];
-
-                  VALUE (0, data[0]) += weight * masked;
-                  VALUE (1, data[1]) += masked;
-
-                  data += n_components;
-                  mask_data += 1;
-                }
-              break;
-
-            case 3: /* calculate separate value values */
-              while (iter->length--)
-                {
-                  const gdouble masked = *mask_data;
-
-                  VALUE (1, data[0]) += masked;
-                  VALUE (2, data[1]) += masked;
-                  VALUE (3, data[2]) += masked;
-
-                  max = MAX (data[0], data[1]);
-                  max = MAX (data[2], max);
-
-                  VALUE (0, max) += masked;
-
-                  data += n_components;
-                  mask_data += 1;
-                }
-              break;
-
-            case 4: /* calculate separate value values */
-              while (iter->length--)
-                {
-                  const gdouble masked = *mask_data;
-                  const gdouble weight = data[3];
-
-                  VALUE (1, data[0]) += weight * masked;
-                  VALUE (2, data[1]) += weight * masked;
-                  VALUE (3, data[2]) += weight * masked;
-                  VALUE (4, data[3]) += masked;
-
-                  max = MAX (data[0], data[1]);
-                  max = MAX (data[2], max);
-
-                  VALUE (0, max) += weight * masked;
-
-                  data += n_components;
-                  mask_data += 1;
-                }
-              break;
-            }
+          g_object_add_weak_pointer (G_OBJECT (priv->mask),
+                                     (gpointer) &priv->mask);
         }
-      else /* no mask */
+
+      priv->cell_size = CELL_SIZE;
+
+      do
         {
-          switch (n_components)
-            {
-            case 1:
-              while (iter->length--)
-                {
-                  VALUE (0, data[0]) += 1.0;
+          priv->n_cell_cols = ((buffer_rect->width + priv->cell_size - 1) /
+                               priv->cell_size);
+          priv->n_cell_rows = ((buffer_rect->height + priv->cell_size - 1) /
+                               priv->cell_size);
 
-                  data += n_components;
-                }
-              break;
+          if (priv->n_cell_cols * priv->n_cell_rows <= MAX_CELLS)
+            break;
 
-            case 2:
-              while (iter->length--)
-                {
-                  const gdouble weight = data[1];
+          priv->cell_size *= 2;
+        }
+      while (TRUE);
 
-                  VALUE (0, data[0]) += weight;
-                  VALUE (1, data[1]) += 1.0;
+      n_cells  = priv->n_cell_cols * priv->n_cell_rows;
+      n_values = priv->n_channels * priv->n_bins;
 
-                  data += n_components;
-                }
-              break;
+      priv->cells = g_new0 (gdouble, (gsize) n_cells * n_values);
 
-            case 3: /* calculate separate value values */
-              while (iter->length--)
-                {
-                  VALUE (1, data[0]) += 1.0;
-                  VALUE (2, data[1]) += 1.0;
-                  VALUE (3, data[2]) += 1.0;
+      dirty = g_new (gboolean, n_cells);
 
-                  max = MAX (data[0], data[1]);
-                  max = MAX (data[2], max);
+      for (i = 0; i < n_cells; i++)
+        dirty[i] = TRUE;
 
-                  VALUE (0, max) += 1.0;
+      any_dirty = TRUE;
+    }
+  else
+    {
+      n_cells = priv->n_cell_cols * priv->n_cell_rows;
+      dirty   = g_new0 (gboolean, n_cells);
 
-                  data += n_components;
-                }
-              break;
+      for (i = 0; i < n_dirty_rects; i++)
+        {
+          GeglRectangle rect;
+          gint          col1, col2;
+          gint          row1, row2;
+          gint          row, col;
 
-            case 4: /* calculate separate value values */
-              while (iter->length--)
-                {
-                  const gdouble weight = data[3];
+          if (! gegl_rectangle_intersect (&rect, &dirty_rects[i], buffer_rect))
+            continue;
 
-                  VALUE (1, data[0]) += weight;
-                  VALUE (2, data[1]) += weight;
-                  VALUE (3, data[2]) += weight;
-                  VALUE (4, data[3]) += 1.0;
+          col1 = (rect.x - buffer_rect->x) / priv->cell_size;
+          row1 = (rect.y - buffer_rect->y) / priv->cell_size;
+          col2 = (rect.x + rect.width  - 1 - buffer_rect->x) / priv->cell_size;
+          row2 = (rect.y + rect.height - 1 - buffer_rect->y) / priv->cell_size;
 
-                  max = MAX (data[0], data[1]);
-                  max = MAX (data[2], max);
+          for (row = row1; row <= row2; row++)
+            for (col = col1; col <= col2; col++)
+              dirty[row * priv->n_cell_cols + col] = TRUE;
 
-                  VALUE (0, max) += weight;
+          any_dirty = TRUE;
+        }
+    }
 
-                  data += n_components;
-                }
-              break;
-            }
+  if (any_dirty)
+    {
+      n_values = priv->n_channels * priv->n_bins;
+
+      for (i = 0; i < n_cells; i++)
+        {
+          if (dirty[i])
+            gimp_histogram_count_cell (histogram, buffer, i);
         }
+
+      memset (priv->values, 0, n_values * sizeof (gdouble));
+
+      for (i = 0; i < n_cells; i++)
+        {
+          const gdouble *cell = priv->cells + (gsize) i * n_values;
+
+          for (j = 0; j < n_values; j++)
+            priv->values[j] += cell[j];
+        }
+
+      g_object_notify (G_OBJECT (histogram), "values");
     }
 
-  g_object_notify (G_OBJECT (histogram), "values");
+  g_free (dirty);
 
   g_object_thaw_notify (G_OBJECT (histogram));
-
-#undef VALUE
 }
 
 void
@@ -481,6 +479,8 @@ gimp_histogram_clear_values (GimpHistogram *histogram)
 {
   g_return_if_fail (GIMP_IS_HISTOGRAM (histogram));
 
+  gimp_histogram_clear_source (histogram);
+
   if (histogram->priv->values)
     {
       g_free (histogram->priv->values);
@@ -914,6 +914,422 @@ gimp_histogram_get_std_dev (GimpHistogram        *histogram,
 
 /*  private functions  */
 
+static const Babl *
+gimp_histogram_get_format (GimpHistogram *histogram,
+                           GeglBuffer    *buffer,
+                           gint          *n_bins)
+{
+  GimpHistogramPrivate *priv = histogram->priv;
+  const Babl           *format;
+
+  format = gegl_buffer_get_format (buffer);
+
+  if (babl_format_get_type (format, 0) == babl_type ("u8"))
+    *n_bins = 256;
+  else
+    *n_bins = 1024;
+
+  if (babl_format_is_palette (format))
+    {
+      if (babl_format_has_alpha (format))
+        format = babl_format ("R'G'B'A float");
+      else
+        format = babl_format ("R'G'B' float");
+    }
+  else
+    {
+      const Babl *model = babl_format_get_model (format);
+
+      if (model == babl_model ("Y"))
+        {
+          if (priv->gamma_correct)
+            format = babl_format ("Y' float");
+          else
+            format = babl_format ("Y float");
+        }
+      else if (model == babl_model ("Y'"))
+        {
+          format = babl_format ("Y' float");
+        }
+      else if (model == babl_model ("YA"))
+        {
+          if (priv->gamma_correct)
+            format = babl_format ("Y'A float");
+          else
+            format = babl_format ("YA float");
+        }
+      else if (model == babl_model ("Y'A"))
+        {
+          format = babl_format ("Y'A float");
+        }
+      else if (model == babl_model ("RGB"))
+        {
+          if (priv->gamma_correct)
+            format = babl_format ("R'G'B' float");
+          else
+            format = babl_format ("RGB float");
+        }
+      else if (model == babl_model ("R'G'B'"))
+        {
+          format = babl_format ("R'G'B' float");
+        }
+      else if (model == babl_model ("RGBA"))
+        {
+          if (priv->gamma_correct)
+            format = babl_format ("R'G'B'A float");
+          else
+            format = babl_format ("RGBA float");
+        }
+      else if (model == babl_model ("R'G'B'A"))
+        {
+          format = babl_format ("R'G'B'A float");
+        }
+      else
+        {
+          g_return_val_if_reached (NULL);
+        }
+    }
+
+  return format;
+}
+
+static gboolean
+gimp_histogram_calculate_internal (GimpHistogram       *histogram,
+                                   GeglBuffer          *buffer,
+                                   const GeglRectangle *buffer_rect,
+                                   GeglBuffer          *mask,
+                                   const GeglRectangle *mask_rect)
+{
+  const Babl *format;
+  gint        n_bins;
+
+  format = gimp_histogram_get_format (histogram, buffer, &n_bins);
+
+  if (! format)
+    return FALSE;
+
+  g_object_freeze_notify (G_OBJECT (histogram));
+
+  gimp_histogram_alloc_values (histogram,
+                               babl_format_get_n_components (format),
+                               n_bins);
+
+  gimp_histogram_accumulate (histogram,
+                             buffer, buffer_rect, format,
+                             mask, mask_rect, histogram->priv->values);
+
+  g_object_notify (G_OBJECT (histogram), "values");
+
+  g_object_thaw_notify (G_OBJECT (histogram));
+
+  return TRUE;
+}
+
+/*  adds the pixels of @buffer_rect to @values, which has the layout
+ *  of the histogram's values
+ */
+static void
+gimp_histogram_accumulate (GimpHistogram       *histogram,
+                           GeglBuffer          *buffer,
+                           const GeglRectangle *buffer_rect,
+                           const Babl          *format,
+                           GeglBuffer          *mask,
+                           const GeglRectangle *mask_rect,
+                           gdouble             *values)
+{
+  GimpHistogramPrivate *priv       = histogram->priv;
+  GimpHistogramStrip    strip;
+  gfloat               *data;
+  gfloat               *mask_data  = NULL;
+  gint                  n_partials = gimp_parallel_get_n_threads ();
+  gint                  n_values   = priv->n_channels * priv->n_bins;
+  gint                  y;
+  gint                  i, j;
+
+  if (buffer_rect->width <= 0 || buffer_rect->height <= 0)
+    return;
+
+  strip.n_components = babl_format_get_n_components (format);
+  strip.n_bins       = priv->n_bins;
+  strip.width        = buffer_rect->width;
+  strip.partials     = g_new0 (gdouble *, n_partials);
+
+  data = g_new (gfloat, (gsize) strip.width * STRIP_HEIGHT * strip.n_components);
+
+  if (mask)
+    mask_data = g_new (gfloat, (gsize) strip.width * STRIP_HEIGHT);
+
+  strip.data = data;
+  strip.mask = mask_data;
+
+  for (y = 0; y < buffer_rect->height; y += STRIP_HEIGHT)
+    {
+      gint strip_height = MIN (STRIP_HEIGHT, buffer_rect->height - y);
+      gint max_n        = n_partials;
+
+      gegl_buffer_get (buffer,
+                       GEGL_RECTANGLE (buffer_rect->x, buffer_rect->y + y,
+                                       strip.width, strip_height),
+                       1.0, format, data,
+                       GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+      if (mask)
+        gegl_buffer_get (mask,
+                         GEGL_RECTANGLE (mask_rect->x, mask_rect->y + y,
+                                         strip.width, strip_height),
+                         1.0, babl_format ("Y float"), mask_data,
+                         GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+      strip.height = strip_height;
+
+      if ((gsize) strip.width * strip_height < MIN_PARALLEL_PIXELS)
+        max_n = 1;
+
+      gimp_parallel_distribute (max_n, gimp_histogram_accumulate_func,
+                                &strip);
+    }
+
+  for (i = 0; i < n_partials; i++)
+    {
+      if (strip.partials[i])
+        {
+          for (j = 0; j < n_values; j++)
+            values[j] += strip.partials[i][j];
+
+          g_free (strip.partials[i]);
+        }
+    }
+
+  g_free (strip.partials);
+  g_free (data);
+  g_free (mask_data);
+}
+
+static void
+gimp_histogram_accumulate_func (gint     i,
+                                gint     n,
+                                gpointer user_data)
+{
+  GimpHistogramStrip *strip        = user_data;
+  gint                n_components = strip->n_components;
+  gint                n_bins       = strip->n_bins;
+  gint                y1           = strip->height * i / n;
+  gint                y2           = strip->height * (i + 1) / n;
+  gsize               offset       = (gsize) y1 * strip->width;
+  gsize               length       = (gsize) (y2 - y1) * strip->width;
+  const gfloat       *data;
+  gdouble            *values;
+  gfloat              max;
+
+  if (! strip->partials[i])
+    strip->partials[i] = g_new0 (gdouble, (n_components + 1) * n_bins);
+
+  values = strip->partials[i];
+  data   = strip->data + offset * n_components;
+
+#define VALUE(c,i) (values[(c) * n_bins + \
+                           (gint) (CLAMP ((i), 0.0, 1.0) * \
+                                   (n_bins - 0.0001))])
+
+  if (strip->mask)
+    {
+      const gfloat *mask_data = strip->mask + offset;
+
+      switch (n_components)
+        {
+        case 1:
+          while (length--)
+            {
+              const gdouble masked = *mask_data;
+
+              VALUE (0, data[0]) += masked;
+
+              data += n_components;
+              mask_data += 1;
+            }
+          break;
+
+        case 2:
+          while (length--)
+            {
+              const gdouble masked = *mask_data;
+              const gdouble weight = data[1];
+
+              VALUE (0, data[0]) += weight * masked;
+              VALUE (1, data[1]) += masked;
+
+              data += n_components;
+              mask_data += 1;
+            }
+          break;
+
+        case 3: /* calculate separate value values */
+          while (length--)
+            {
+              const gdouble masked = *mask_data;
+
+              VALUE (1, data[0]) += masked;
+              VALUE (2, data[1]) += masked;
+              VALUE (3, data[2]) += masked;
+
+              max = MAX (data[0], data[1]);
+              max = MAX (data[2], max);
+
+              VALUE (0, max) += masked;
+
+              data += n_components;
+              mask_data += 1;
+            }
+          break;
+
+        case 4: /* calculate separate value values */
+          while (length--)
+            {
+              const gdouble masked = *mask_data;
+              const gdouble weight = data[3];
+
+              VALUE (1, data[0]) += weight * masked;
+              VALUE (2, data[1]) += weight * masked;
+              VALUE (3, data[2]) += weight * masked;
+              VALUE (4, data[3]) += masked;
+
+              max = MAX (data[0], data[1]);
+              max = MAX (data[2], max);
+
+              VALUE (0, max) += weight * masked;
+
+              data += n_components;
+              mask_data += 1;
+            }
+          break;
+        }
+    }
+  else /* no mask */
+    {
+      switch (n_components)
+        {
+        case 1:
+          while (length--)
+            {
+              VALUE (0, data[0]) += 1.0;
+
+              data += n_components;
+            }
+          break;
+
+        case 2:
+          while (length--)
+            {
+              const gdouble weight = data[1];
+
+              VALUE (0, data[0]) += weight;
+              VALUE (1, data[1]) += 1.0;
+
+              data += n_components;
+            }
+          break;
+
+        case 3: /* calculate separate value values */
+          while (length--)
+            {
+              VALUE (1, data[0]) += 1.0;
+              VALUE (2, data[1]) += 1.0;
+              VALUE (3, data[2]) += 1.0;
+
+              max = MAX (data[0], data[1]);
+              max = MAX (data[2], max);
+
+              VALUE (0, max) += 1.0;
+
+              data += n_components;
+            }
+          break;
+
+        case 4: /* calculate separate value values */
+          while (length--)
+            {
+              const gdouble weight = data[3];
+
+              VALUE (1, data[0]) += weight;
+              VALUE (2, data[1]) += weight;
+              VALUE (3, data[2]) += weight;
+              VALUE (4, data[3]) += 1.0;
+
+              max = MAX (data[0], data[1]);
+              max = MAX (data[2], max);
+
+              VALUE (0, max) += weight;
+
+              data += n_components;
+            }
+          break;
+        }
+    }
+
+#undef VALUE
+}
+
+/*  counts one cell of gimp_histogram_calculate_incremental() again  */
+static void
+gimp_histogram_count_cell (GimpHistogram *histogram,
+                           GeglBuffer    *buffer,
+                           gint           cell)
+{
+  GimpHistogramPrivate *priv     = histogram->priv;
+  gint                  n_values = priv->n_channels * priv->n_bins;
+  gdouble              *values   = priv->cells + (gsize) cell * n_values;
+  GeglRectangle         rect;
+  GeglRectangle         mask_rect;
+
+  rect.x      = (priv->source_rect.x +
+                 cell % priv->n_cell_cols * priv->cell_size);
+  rect.y      = (priv->source_rect.y +
+                 cell / priv->n_cell_cols * priv->cell_size);
+  rect.width  = MIN (priv->cell_size,
+                     priv->source_rect.x + priv->source_rect.width - rect.x);
+  rect.height = MIN (priv->cell_size,
+                     priv->source_rect.y + priv->source_rect.height - rect.y);
+
+  if (priv->mask)
+    {
+      mask_rect    = rect;
+      mask_rect.x += priv->mask_rect.x - priv->source_rect.x;
+      mask_rect.y += priv->mask_rect.y - priv->source_rect.y;
+    }
+
+  memset (values, 0, n_values * sizeof (gdouble));
+
+  gimp_histogram_accumulate (histogram,
+                             buffer, &rect, priv->source_format,
+                             priv->mask, &mask_rect, values);
+}
+
+static void
+gimp_histogram_clear_source (GimpHistogram *histogram)
+{
+  GimpHistogramPrivate *priv = histogram->priv;
+
+  if (priv->source)
+    {
+      g_object_remove_weak_pointer (G_OBJECT (priv->source),
+                                    (gpointer) &priv->source);
+      priv->source = NULL;
+    }
+
+  if (priv->cells)
+    {
+      g_free (priv->cells);
+      priv->cells = NULL;
+    }
+
+  if (priv->mask)
+    {
+      g_object_remove_weak_pointer (G_OBJECT (priv->mask),
+                                    (gpointer) &priv->mask);
+      priv->mask = NULL;
+    }
+}
+
 static void
 gimp_histogram_alloc_values (GimpHistogram *histogram,
                              gint           n_components,
@@ -59,6 +59,14 @@ void            gimp_histogram_calculate     (GimpHistogram        *histogram,
                                               const GeglRectangle  *buffer_rect,
                                               GeglBuffer           *mask,
                                               const GeglRectangle  *mask_rect);
+void            gimp_histogram_calculate_incremental
+                                             (GimpHistogram        *histogram,
+                                              GeglBuffer           *buffer,
+                                              const GeglRectangle  *buffer_rect,
+                                              GeglBuffer           *mask,
+                                              const GeglRectangle  *mask_rect,
+                                              const GeglRectangle  *dirty_rects,
+                                              gint                  n_dirty_rects);
 
 void            gimp_histogram_clear_values  (GimpHistogram        *histogram);
 
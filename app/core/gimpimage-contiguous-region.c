@@ -18,6 +18,7 @@
 #include "config.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 #include <cairo.h>
 #include <gegl.h>
@@ -30,12 +31,56 @@
 
 #include "gegl/gimp-babl.h"
 
+#include "gimp-parallel.h"
 #include "gimpdrawable.h"
 #include "gimpimage.h"
 #include "gimpimage-contiguous-region.h"
 #include "gimppickable.h"
 
 
+/*  the source is fetched and compared to the seed color in bands of
+ *  whole, tile-aligned rows the first time the fill reaches them
+ */
+#define BAND_HEIGHT       64
+#define MIN_PARALLEL_SIZE (64 * 64)
+
+#define BIT_GET(bits, x) ((bits)[(x) >> 3] &   (1 << ((x) & 7)))
+#define BIT_SET(bits, x) ((bits)[(x) >> 3] |=  (1 << ((x) & 7)))
+
+
+typedef struct
+{
+  gint y;
+  gint start;
+  gint end;
+} ContiguousSpan;
+
+typedef struct
+{
+  GeglBuffer          *src_buffer;
+  const Babl          *format;
+  gint                 n_components;
+  gboolean             has_alpha;
+  gboolean             select_transparent;
+  GimpSelectCriterion  select_criterion;
+  gboolean             antialias;
+  gfloat               threshold;
+  const gfloat        *col;
+
+  gint                 width;
+  gint                 height;
+  gint                 rowstride; /* of the bitmaps, in bytes          */
+  gint                 n_bands;
+  guchar             **fillable;  /* per band, a bit for each pixel
+                                   * within the threshold             */
+  guchar             **filled;    /* per band, a bit for each pixel
+                                   * in the region                    */
+
+  gfloat              *src;       /* the source pixels of one band    */
+  gfloat              *diff;      /* their differences to col         */
+} ContiguousRegion;
+
+
 /*  local function prototypes  */
 
 static const Babl * choose_format         (GeglBuffer          *buffer,
@@ -50,22 +95,7 @@ static gfloat   pixel_difference          (const gfloat        *col1,
                                            gboolean             has_alpha,
                                            gboolean             select_transparent,
                                            GimpSelectCriterion  select_criterion);
-static gboolean find_contiguous_segment   (const gfloat        *col,
-                                           GeglBuffer          *src_buffer,
-                                           GeglBuffer          *mask_buffer,
-                                           const Babl          *src_format,
-                                           gint                 n_components,
-                                           gboolean             has_alpha,
-                                           gint                 width,
-                                           gboolean             select_transparent,
-                                           GimpSelectCriterion  select_criterion,
-                                           gboolean             antialias,
-                                           gfloat               threshold,
-                                           gint                 initial_x,
-                                           gint                 initial_y,
-                                           gint                *start,
-                                           gint                *end);
-static void find_contiguous_region_helper (GeglBuffer          *src_buffer,
+static void   find_contiguous_region      (GeglBuffer          *src_buffer,
                                            GeglBuffer          *mask_buffer,
                                            const Babl          *format,
                                            gint                 n_components,
@@ -77,6 +107,13 @@ static void find_contiguous_region_helper (GeglBuffer          *src_buffer,
                                            gint                 x,
                                            gint                 y,
                                            const gfloat        *col);
+static void   prepare_band                (ContiguousRegion    *region,
+                                           gint                 band);
+static void   compute_band_diff           (ContiguousRegion    *region,
+                                           gint                 band);
+static void   compute_band_diff_func      (gsize                offset,
+                                           gsize                size,
+                                           gpointer             user_data);
 
 
 /*  public functions  */
@@ -137,11 +174,11 @@ gimp_image_contiguous_region_by_seed (GimpImage           *image,
   mask_buffer = gegl_buffer_new (gegl_buffer_get_extent (src_buffer),
                                  babl_format ("Y float"));
 
-  find_contiguous_region_helper (src_buffer, mask_buffer,
-                                 format, n_components, has_alpha,
-                                 select_transparent, select_criterion,
-                                 antialias, threshold,
-                                 x, y, start_col);
+  find_contiguous_region (src_buffer, mask_buffer,
+                          format, n_components, has_alpha,
+                          select_transparent, select_criterion,
+                          antialias, threshold,
+                          x, y, start_col);
 
   return mask_buffer;
 }
@@ -379,154 +416,246 @@ pixel_difference (const gfloat        *col1,
     }
 }
 
-static gboolean
-find_contiguous_segment (const gfloat        *col,
-                         GeglBuffer          *src_buffer,
-                         GeglBuffer          *mask_buffer,
-                         const Babl          *format,
-                         gint                 n_components,
-                         gboolean             has_alpha,
-                         gint                 width,
-                         gboolean             select_transparent,
-                         GimpSelectCriterion  select_criterion,
-                         gboolean             antialias,
-                         gfloat               threshold,
-                         gint                 initial_x,
-                         gint                 initial_y,
-                         gint                *start,
-                         gint                *end)
+static void
+find_contiguous_region (GeglBuffer          *src_buffer,
+                        GeglBuffer          *mask_buffer,
+                        const Babl          *format,
+                        gint                 n_components,
+                        gboolean             has_alpha,
+                        gboolean             select_transparent,
+                        GimpSelectCriterion  select_criterion,
+                        gboolean             antialias,
+                        gfloat               threshold,
+                        gint                 x,
+                        gint                 y,
+                        const gfloat        *col)
 {
-  gfloat s[MAX_CHANNELS];
-  gfloat mask_row[width];
-  gfloat diff;
+  ContiguousRegion region;
+  ContiguousSpan   span;
+  GArray          *stack;
+  gint             band;
+
+  region.src_buffer         = src_buffer;
+  region.format             = format;
+  region.n_components       = n_components;
+  region.has_alpha          = has_alpha;
+  region.select_transparent = select_transparent;
+  region.select_criterion   = select_criterion;
+  region.antialias          = antialias;
+  region.threshold          = threshold;
+  region.col                = col;
+
+  region.width  = gegl_buffer_get_width (src_buffer);
+  region.height = gegl_buffer_get_height (src_buffer);
+
+  if (x < 0 || x >= region.width || y < 0 || y >= region.height)
+    return;
+
+  /*  only the bitmaps are kept for the whole fill, the source pixels
+   *  and their differences are held for one band at a time
+   */
+  region.rowstride = (region.width + 7) / 8;
+  region.n_bands   = (region.height + BAND_HEIGHT - 1) / BAND_HEIGHT;
+  region.fillable  = g_new0 (guchar *, region.n_bands);
+  region.filled    = g_new0 (guchar *, region.n_bands);
+  region.src       = g_new (gfloat,
+                            region.width * BAND_HEIGHT * n_components);
+  region.diff      = g_new (gfloat, region.width * BAND_HEIGHT);
+
+  /*  scanline fill: each span on the stack is a run of filled pixels
+   *  in the row next to span.y, which is searched for fillable pixels
+   *  connected to it
+   */
+  stack = g_array_new (FALSE, FALSE, sizeof (ContiguousSpan));
 
-  gegl_buffer_sample (src_buffer, initial_x, initial_y, NULL, s, format,
-                      GEGL_SAMPLER_NEAREST, GEGL_ABYSS_NONE);
+  span.y     = y;
+  span.start = x;
+  span.end   = x;
 
-  diff = pixel_difference (col, s, antialias, threshold,
-                           n_components, has_alpha, select_transparent,
-                           select_criterion);
+  g_array_append_val (stack, span);
 
-  /* check the starting pixel */
-  if (! diff)
-    return FALSE;
+  while (stack->len > 0)
+    {
+      const guchar *fillable;
+      guchar       *filled;
+      gint          offset;
 
-  mask_row[initial_x] = diff;
+      span = g_array_index (stack, ContiguousSpan, stack->len - 1);
+      g_array_set_size (stack, stack->len - 1);
 
-  *start = initial_x - 1;
+      band = span.y / BAND_HEIGHT;
 
-  while (*start >= 0 && diff)
-    {
-      gegl_buffer_sample (src_buffer, *start, initial_y, NULL, s, format,
-                          GEGL_SAMPLER_NEAREST, GEGL_ABYSS_NONE);
+      if (! region.fillable[band])
+        prepare_band (&region, band);
+
+      offset   = (span.y % BAND_HEIGHT) * region.rowstride;
+      fillable = region.fillable[band] + offset;
+      filled   = region.filled[band]   + offset;
+
+      for (x = span.start; x <= span.end; x++)
+        {
+          ContiguousSpan new_span;
+          gint           i;
+
+          if (BIT_GET (filled, x) || ! BIT_GET (fillable, x))
+            continue;
+
+          new_span.start = x;
+          new_span.end   = x;
 
-      diff = pixel_difference (col, s, antialias, threshold,
-                               n_components, has_alpha, select_transparent,
-                               select_criterion);
+          while (new_span.start > 0                     &&
+                 ! BIT_GET (filled, new_span.start - 1) &&
+                 BIT_GET (fillable, new_span.start - 1))
+            {
+              new_span.start--;
+            }
+
+          while (new_span.end < region.width - 1     &&
+                 ! BIT_GET (filled, new_span.end + 1) &&
+                 BIT_GET (fillable, new_span.end + 1))
+            {
+              new_span.end++;
+            }
 
-      mask_row[*start] = diff;
+          for (i = new_span.start; i <= new_span.end; i++)
+            BIT_SET (filled, i);
 
-      if (diff)
-        (*start)--;
+          if (span.y + 1 < region.height)
+            {
+              new_span.y = span.y + 1;
+              g_array_append_val (stack, new_span);
+            }
+
+          if (span.y - 1 >= 0)
+            {
+              new_span.y = span.y - 1;
+              g_array_append_val (stack, new_span);
+            }
+
+          x = new_span.end + 1;
+        }
     }
 
-  diff = 1;
-  *end = initial_x + 1;
+  g_array_free (stack, TRUE);
 
-  while (*end < width && diff)
+  /*  write the filled pixels to the mask, band by band.  Without
+   *  antialiasing all of them are 1.0, otherwise their differences
+   *  are computed again
+   */
+  for (band = 0; band < region.n_bands; band++)
     {
-      gegl_buffer_sample (src_buffer, *end, initial_y, NULL, s, format,
-                          GEGL_SAMPLER_NEAREST, GEGL_ABYSS_NONE);
+      const guchar *filled = region.filled[band];
+      gint          y0     = band * BAND_HEIGHT;
+      gint          height = MIN (BAND_HEIGHT, region.height - y0);
+      gint          row;
 
-      diff = pixel_difference (col, s, antialias, threshold,
-                               n_components, has_alpha, select_transparent,
-                               select_criterion);
+      if (! filled)
+        continue;
 
-      mask_row[*end] = diff;
+      if (antialias)
+        compute_band_diff (&region, band);
 
-      if (diff)
-        (*end)++;
-    }
+      for (row = 0; row < height; row++)
+        {
+          gfloat *diff = region.diff + row * region.width;
+
+          for (x = 0; x < region.width; x++)
+            {
+              if (! BIT_GET (filled, x))
+                diff[x] = 0.0;
+              else if (! antialias)
+                diff[x] = 1.0;
+            }
 
-  gegl_buffer_set (mask_buffer, GEGL_RECTANGLE (*start, initial_y,
-                                                *end - *start, 1),
-                   0, babl_format ("Y float"), &mask_row[*start],
-                   GEGL_AUTO_ROWSTRIDE);
+          filled += region.rowstride;
+        }
+
+      gegl_buffer_set (mask_buffer,
+                       GEGL_RECTANGLE (0, y0, region.width, height),
+                       0, babl_format ("Y float"), region.diff,
+                       GEGL_AUTO_ROWSTRIDE);
 
-  return TRUE;
+      g_free (region.fillable[band]);
+      g_free (region.filled[band]);
+    }
+
+  g_free (region.fillable);
+  g_free (region.filled);
+  g_free (region.src);
+  g_free (region.diff);
 }
 
 static void
-find_contiguous_region_helper (GeglBuffer          *src_buffer,
-                               GeglBuffer          *mask_buffer,
-                               const Babl          *format,
-                               gint                 n_components,
-                               gboolean             has_alpha,
-                               gboolean             select_transparent,
-                               GimpSelectCriterion  select_criterion,
-                               gboolean             antialias,
-                               gfloat               threshold,
-                               gint                 x,
-                               gint                 y,
-                               const gfloat        *col)
+prepare_band (ContiguousRegion *region,
+              gint              band)
 {
-  gint    start, end;
-  gint    new_start, new_end;
-  GQueue *coord_stack;
+  gint          y0     = band * BAND_HEIGHT;
+  gint          height = MIN (BAND_HEIGHT, region->height - y0);
+  const gfloat *diff;
+  guchar       *fillable;
+  gint          row;
+  gint          x;
 
-  coord_stack = g_queue_new ();
+  compute_band_diff (region, band);
 
-  /* To avoid excessive memory allocation (y, start, end) tuples are
-   * stored in interleaved format:
-   *
-   * [y1] [start1] [end1] [y2] [start2] [end2]
-   */
-  g_queue_push_tail (coord_stack, GINT_TO_POINTER (y));
-  g_queue_push_tail (coord_stack, GINT_TO_POINTER (x - 1));
-  g_queue_push_tail (coord_stack, GINT_TO_POINTER (x + 1));
+  region->fillable[band] = g_new0 (guchar, region->rowstride * height);
+  region->filled[band]   = g_new0 (guchar, region->rowstride * height);
 
-  do
-    {
-      y     = GPOINTER_TO_INT (g_queue_pop_head (coord_stack));
-      start = GPOINTER_TO_INT (g_queue_pop_head (coord_stack));
-      end   = GPOINTER_TO_INT (g_queue_pop_head (coord_stack));
+  diff     = region->diff;
+  fillable = region->fillable[band];
 
-      for (x = start + 1; x < end; x++)
+  for (row = 0; row < height; row++)
+    {
+      for (x = 0; x < region->width; x++)
         {
-          gfloat val;
+          if (diff[x])
+            BIT_SET (fillable, x);
+        }
 
-          gegl_buffer_sample (mask_buffer, x, y, NULL, &val,
-                              babl_format ("Y float"),
-                              GEGL_SAMPLER_NEAREST, GEGL_ABYSS_NONE);
-          if (val != 0.0)
-            continue;
+      diff     += region->width;
+      fillable += region->rowstride;
+    }
+}
 
-          if (! find_contiguous_segment (col, src_buffer, mask_buffer,
-                                         format,
-                                         n_components,
-                                         has_alpha,
-                                         gegl_buffer_get_width (src_buffer),
-                                         select_transparent, select_criterion,
-                                         antialias, threshold, x, y,
-                                         &new_start, &new_end))
-            continue;
+static void
+compute_band_diff (ContiguousRegion *region,
+                   gint              band)
+{
+  gint y0     = band * BAND_HEIGHT;
+  gint height = MIN (BAND_HEIGHT, region->height - y0);
 
-          if (y + 1 < gegl_buffer_get_height (src_buffer))
-            {
-              g_queue_push_tail (coord_stack, GINT_TO_POINTER (y + 1));
-              g_queue_push_tail (coord_stack, GINT_TO_POINTER (new_start));
-              g_queue_push_tail (coord_stack, GINT_TO_POINTER (new_end));
-            }
+  /*  fetch the whole band linearly, then compare its pixels in parallel  */
+  gegl_buffer_get (region->src_buffer,
+                   GEGL_RECTANGLE (0, y0, region->width, height),
+                   1.0, region->format, region->src,
+                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
 
-          if (y - 1 >= 0)
-            {
-              g_queue_push_tail (coord_stack, GINT_TO_POINTER (y - 1));
-              g_queue_push_tail (coord_stack, GINT_TO_POINTER (new_start));
-              g_queue_push_tail (coord_stack, GINT_TO_POINTER (new_end));
-            }
-        }
-    }
-  while (! g_queue_is_empty (coord_stack));
+  gimp_parallel_distribute_range (region->width * height, MIN_PARALLEL_SIZE,
+                                  compute_band_diff_func, region);
+}
 
-  g_queue_free (coord_stack);
+static void
+compute_band_diff_func (gsize    offset,
+                        gsize    size,
+                        gpointer user_data)
+{
+  ContiguousRegion *region = user_data;
+  const gfloat     *src;
+  gfloat           *diff;
+
+  src  = region->src  + offset * region->n_components;
+  diff = region->diff + offset;
+
+  while (size--)
+    {
+      *diff++ = pixel_difference (region->col, src,
+                                  region->antialias,
+                                  region->threshold,
+                                  region->n_components,
+                                  region->has_alpha,
+                                  region->select_transparent,
+                                  region->select_criterion);
+
+      src += region->n_components;
+    }
 }
@@ -144,6 +144,7 @@
 #include "gegl/gimp-gegl-utils.h"
 
 #include "gimp.h"
+#include "gimp-parallel.h"
 #include "gimpcontainer.h"
 #include "gimpdrawable.h"
 #include "gimperror.h"
@@ -164,6 +165,15 @@
 #include "gimp-intl.h"
 
 
+/*  layers are read in strips of rows, the pixels of a strip are
+ *  converted to L*a*b* in parallel, only the calling thread touches
+ *  the buffers and runs the order-dependent parts (the found colors
+ *  table, the inverse colormap cache and the error diffusion)
+ */
+#define STRIP_HEIGHT        64
+#define MIN_PARALLEL_PIXELS 4096
+
+
 /* basic memory/quality tradeoff */
 #define PRECISION_R 8
 #define PRECISION_G 6
@@ -502,6 +512,29 @@ typedef struct
 
 } box, *boxptr;
 
+typedef struct
+{
+  CFHistogram  *histograms;         /* one per thread, [0] is the image's */
+  const guchar *data;
+  gint          width;
+  gint          height;
+  gint          offsetx;
+  gint          offsety;            /* including the strip's first row */
+  gint          bpp;
+  gboolean      has_alpha;
+  gboolean      alpha_dither;
+} HistogramStrip;
+
+typedef struct
+{
+  const guchar *src;
+  gint         *lin;                /* unshifted L*a*b*, 3 per pixel */
+  gint          bpp;
+  gint          red_pix;
+  gint          green_pix;
+  gint          blue_pix;
+} LinStrip;
+
 
 static void zero_histogram_gray     (CFHistogram   histogram);
 static void zero_histogram_rgb      (CFHistogram   histogram);
@@ -516,6 +549,15 @@ static void generate_histogram_rgb  (CFHistogram   histogram,
                                      gint          nth_layer,
                                      gint          n_layers);
 
+static void generate_histogram_rgb_func  (gint          i,
+                                          gint          n,
+                                          gpointer      user_data);
+static void generate_histogram_rgb_found (HistogramStrip *strip,
+                                          gint            col_limit);
+static void convert_to_lin_func          (gsize         offset,
+                                          gsize         size,
+                                          gpointer      user_data);
+
 static QuantizeObj * initialize_median_cut (GimpImageBaseType      old_type,
                                             gint                   num_cols,
                                             GimpConvertDitherType  dither_type,
@@ -1186,200 +1228,272 @@ generate_histogram_rgb (CFHistogram   histogram,
                         gint          nth_layer,
                         gint          n_layers)
 {
-  GeglBufferIterator *iter;
-  const Babl         *format;
-  GeglRectangle      *roi;
-  ColorFreq          *colfreq;
-  gint                nfc_iter;
-  gint                row, col, coledge;
-  gint                offsetx, offsety;
-  glong               layer_size;
-  glong               total_size = 0;
-  gint                count      = 0;
-  gint                bpp;
-  gboolean            has_alpha;
+  GeglBuffer     *buffer;
+  const Babl     *format;
+  HistogramStrip  strip;
+  guchar         *data;
+  gint            width, height;
+  gint            offsety;
+  gint            n_histograms;
+  gint            y;
+  gint            i;
 
   format = gimp_drawable_get_format (GIMP_DRAWABLE (layer));
 
   g_return_if_fail (format == babl_format ("R'G'B' u8") ||
                     format == babl_format ("R'G'B'A u8"));
 
-  bpp       = babl_format_get_bytes_per_pixel (format);
-  has_alpha = babl_format_has_alpha (format);
+  buffer = gimp_drawable_get_buffer (GIMP_DRAWABLE (layer));
 
-  gimp_item_get_offset (GIMP_ITEM (layer), &offsetx, &offsety);
+  width  = gimp_item_get_width  (GIMP_ITEM (layer));
+  height = gimp_item_get_height (GIMP_ITEM (layer));
 
-  layer_size = (gimp_item_get_width  (GIMP_ITEM (layer)) *
-                gimp_item_get_height (GIMP_ITEM (layer)));
+  gimp_item_get_offset (GIMP_ITEM (layer), &strip.offsetx, &offsety);
 
-  /*  g_printerr ("col_limit = %d, nfc = %d\n", col_limit, num_found_cols); */
+  strip.width        = width;
+  strip.bpp          = babl_format_get_bytes_per_pixel (format);
+  strip.has_alpha    = babl_format_has_alpha (format);
+  strip.alpha_dither = alpha_dither;
 
-  iter = gegl_buffer_iterator_new (gimp_drawable_get_buffer (GIMP_DRAWABLE (layer)),
-                                   NULL, 0, format,
-                                   GEGL_BUFFER_READ, GEGL_ABYSS_NONE);
-  roi = &iter->roi[0];
+  /*  the other threads count into their own histograms, which are
+   *  allocated when first used and added up at the end
+   */
+  n_histograms = gimp_parallel_get_n_threads ();
+
+  strip.histograms    = g_new0 (CFHistogram, n_histograms);
+  strip.histograms[0] = histogram;
+
+  data = g_malloc ((gsize) width * STRIP_HEIGHT * strip.bpp);
+
+  /*  g_printerr ("col_limit = %d, nfc = %d\n", col_limit, num_found_cols); */
 
   if (progress)
     gimp_progress_set_value (progress, 0.0);
 
-  while (gegl_buffer_iterator_next (iter))
+  for (y = 0; y < height; y += STRIP_HEIGHT)
     {
-      const guchar *data = iter->data[0];
+      gint strip_height = MIN (STRIP_HEIGHT, height - y);
+
+      gegl_buffer_get (buffer, GEGL_RECTANGLE (0, y, width, strip_height),
+                       1.0, format, data,
+                       GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+      strip.data    = data;
+      strip.height  = strip_height;
+      strip.offsety = offsety + y;
+
+      if (! needs_quantize)
+        {
+          /*  the found colors table depends on the order of the
+           *  pixels, fill it serially until there are too many
+           */
+          generate_histogram_rgb_found (&strip, col_limit);
+        }
+      else
+        {
+          gint max_n = n_histograms;
+
+          if ((gsize) width * strip_height < MIN_PARALLEL_PIXELS)
+            max_n = 1;
+
+          gimp_parallel_distribute (max_n, generate_histogram_rgb_func,
+                                    &strip);
+        }
+
+      if (progress)
+        gimp_progress_set_value (progress,
+                                 (nth_layer + ((gdouble) (y + strip_height)) /
+                                  height) / (gdouble) n_layers);
+    }
 
-      total_size += iter->length;
+  for (i = 1; i < n_histograms; i++)
+    {
+      if (strip.histograms[i])
+        {
+          ColorFreq *partial = strip.histograms[i];
+          gint       j;
 
-      /* g_printerr (" [%d,%d - %d,%d]", srcPR.x, src_roi->y, offsetx, offsety); */
+          for (j = 0; j < HIST_R_ELEMS * HIST_G_ELEMS * HIST_B_ELEMS; j++)
+            histogram[j] += partial[j];
 
-      if (needs_quantize)
+          g_free (partial);
+        }
+    }
+
+  g_free (strip.histograms);
+  g_free (data);
+
+/*  g_print ("O: col_limit = %d, nfc = %d\n", col_limit, num_found_cols);*/
+}
+
+static void
+generate_histogram_rgb_func (gint     i,
+                             gint     n,
+                             gpointer user_data)
+{
+  HistogramStrip *strip = user_data;
+  CFHistogram     histogram;
+  gint            y1    = strip->height * i / n;
+  gint            y2    = strip->height * (i + 1) / n;
+  gint            x, y;
+
+  if (! strip->histograms[i])
+    strip->histograms[i] = g_new0 (ColorFreq,
+                                   HIST_R_ELEMS * HIST_G_ELEMS * HIST_B_ELEMS);
+
+  histogram = strip->histograms[i];
+
+  for (y = y1; y < y2; y++)
+    {
+      const guchar *data = strip->data + (gsize) y * strip->width * strip->bpp;
+      gint          row  = y + strip->offsety;
+
+      for (x = 0; x < strip->width; x++)
         {
-          if (alpha_dither)
+          gboolean transparent = FALSE;
+
+          if (strip->has_alpha)
             {
               /* if alpha-dithering,
                  we need to be deterministic w.r.t. offsets */
-
-              col = roi->x + offsetx;
-              coledge = col + roi->width;
-              row = roi->y + offsety;
-
-              while (iter->length--)
+              if (strip->alpha_dither)
                 {
-                  gboolean transparent = FALSE;
+                  gint col = x + strip->offsetx;
 
-                  if (has_alpha &&
-                      data[ALPHA] <
+                  if (data[ALPHA] <
                       DM[col & DM_WIDTHMASK][row & DM_HEIGHTMASK])
                     transparent = TRUE;
+                }
+              else
+                {
+                  if (data[ALPHA] <= 127)
+                    transparent = TRUE;
+                }
+            }
 
-                  if (! transparent)
-                    {
-                      colfreq = HIST_RGB (histogram,
-                                          data[RED],
-                                          data[GREEN],
-                                          data[BLUE]);
-                      (*colfreq)++;
-                    }
+          if (! transparent)
+            {
+              ColorFreq *colfreq = HIST_RGB (histogram,
+                                             data[RED],
+                                             data[GREEN],
+                                             data[BLUE]);
+              (*colfreq)++;
+            }
 
-                  col++;
-                  if (col == coledge)
-                    {
-                      col = roi->x + offsetx;
-                      row++;
-                    }
+          data += strip->bpp;
+        }
+    }
+}
 
-                  data += bpp;
-                }
-            }
-          else
+static void
+generate_histogram_rgb_found (HistogramStrip *strip,
+                              gint            col_limit)
+{
+  CFHistogram   histogram = strip->histograms[0];
+  const guchar *data      = strip->data;
+  gint          nfc_iter;
+  gint          x, y;
+
+  for (y = 0; y < strip->height; y++)
+    {
+      /* if alpha-dithering, we need to be deterministic w.r.t. offsets */
+      gint row = y + strip->offsety;
+
+      for (x = 0; x < strip->width; x++)
+        {
+          gboolean transparent = FALSE;
+
+          if (strip->has_alpha)
             {
-              while (iter->length--)
+              if (strip->alpha_dither)
                 {
-                  if ((has_alpha && ((data[ALPHA] > 127)))
-                      || (!has_alpha))
-                    {
-                      colfreq = HIST_RGB (histogram,
-                                          data[RED],
-                                          data[GREEN],
-                                          data[BLUE]);
-                      (*colfreq)++;
-                    }
+                  gint col = x + strip->offsetx;
 
-                  data += bpp;
+                  if (data[ALPHA] <
+                      DM[col & DM_WIDTHMASK][row & DM_HEIGHTMASK])
+                    transparent = TRUE;
+                }
+              else
+                {
+                  if (data[ALPHA] <= 127)
+                    transparent = TRUE;
                 }
             }
-        }
-      else
-        {
-          /* if alpha-dithering, we need to be deterministic w.r.t. offsets */
-          col = roi->x + offsetx;
-          coledge = col + roi->width;
-          row = roi->y + offsety;
 
-          while (iter->length--)
+          if (! transparent)
             {
-	      gboolean transparent = FALSE;
-
-	      if (has_alpha)
-	        {
-		  if (alpha_dither)
-		    {
-		      if (data[ALPHA] <
-                          DM[col & DM_WIDTHMASK][row & DM_HEIGHTMASK])
-		  	transparent = TRUE;
-		    }
-		  else
-		    {
-		      if (data[ALPHA] <= 127)
-			transparent = TRUE;
-		    }
-		}
-
-	      if (! transparent)
-                {
-                  colfreq = HIST_RGB (histogram,
-                                      data[RED],
-                                      data[GREEN],
-                                      data[BLUE]);
-                  (*colfreq)++;
+              ColorFreq *colfreq = HIST_RGB (histogram,
+                                             data[RED],
+                                             data[GREEN],
+                                             data[BLUE]);
+              (*colfreq)++;
 
-                  if (!needs_quantize)
+              if (!needs_quantize)
+                {
+                  for (nfc_iter = 0;
+                       nfc_iter < num_found_cols;
+                       nfc_iter++)
                     {
-                      for (nfc_iter = 0;
-                           nfc_iter < num_found_cols;
-                           nfc_iter++)
-                        {
-                          if ((data[RED]   == found_cols[nfc_iter][0]) &&
-                              (data[GREEN] == found_cols[nfc_iter][1]) &&
-                              (data[BLUE]  == found_cols[nfc_iter][2]))
-                            goto already_found;
-                        }
+                      if ((data[RED]   == found_cols[nfc_iter][0]) &&
+                          (data[GREEN] == found_cols[nfc_iter][1]) &&
+                          (data[BLUE]  == found_cols[nfc_iter][2]))
+                        goto already_found;
+                    }
 
-                      /* Color was not in the table of
-                       * existing colors
-                       */
+                  /* Color was not in the table of
+                   * existing colors
+                   */
 
-                      num_found_cols++;
+                  num_found_cols++;
 
-                      if (num_found_cols > col_limit)
-                        {
-                          /* There are more colors in the image
-                           *  than were allowed.  We switch to plain
-                           *  histogram calculation with a view to
-                           *  quantizing at a later stage.
-                           */
-                          needs_quantize = TRUE;
-                          /* g_print ("\nmax colors exceeded - needs quantize.\n");*/
-                          goto already_found;
-                        }
-                      else
-                        {
-                          /* Remember the new color we just found.
-                           */
-                          found_cols[num_found_cols-1][0] = data[RED];
-                          found_cols[num_found_cols-1][1] = data[GREEN];
-                          found_cols[num_found_cols-1][2] = data[BLUE];
-                        }
+                  if (num_found_cols > col_limit)
+                    {
+                      /* There are more colors in the image
+                       *  than were allowed.  We switch to plain
+                       *  histogram calculation with a view to
+                       *  quantizing at a later stage.
+                       */
+                      needs_quantize = TRUE;
+                      /* g_print ("\nmax colors exceeded - needs quantize.\n");*/
+                      goto already_found;
+                    }
+                  else
+                    {
+                      /* Remember the new color we just found.
+                       */
+                      found_cols[num_found_cols-1][0] = data[RED];
+                      found_cols[num_found_cols-1][1] = data[GREEN];
+                      found_cols[num_found_cols-1][2] = data[BLUE];
                     }
                 }
-            already_found:
-
-              col++;
-              if (col == coledge)
-                {
-                  col = roi->x + offsetx;
-                  row++;
-                }
-
-              data += bpp;
             }
-        }
+        already_found:
 
-      if (progress && (count % 16 == 0))
-        gimp_progress_set_value (progress,
-                                 (nth_layer + ((gdouble) total_size)/
-                                  layer_size) / (gdouble) n_layers);
+          data += strip->bpp;
+        }
     }
+}
 
-/*  g_print ("O: col_limit = %d, nfc = %d\n", col_limit, num_found_cols);*/
+/*  convert a range of a strip's pixels to unshifted L*a*b*  */
+static void
+convert_to_lin_func (gsize    offset,
+                     gsize    size,
+                     gpointer user_data)
+{
+  LinStrip     *strip = user_data;
+  const guchar *src   = strip->src + offset * strip->bpp;
+  gint         *lin   = strip->lin + offset * 3;
+
+  while (size--)
+    {
+      rgb_to_unshifted_lin (src[strip->red_pix],
+                            src[strip->green_pix],
+                            src[strip->blue_pix],
+                            &lin[0], &lin[1], &lin[2]);
+
+      src += strip->bpp;
+      lin += 3;
+    }
 }
 
 
@@ -3093,16 +3207,21 @@ median_cut_pass2_no_dither_rgb (QuantizeObj *quantobj,
                                 GimpLayer   *layer,
                                 GeglBuffer  *new_buffer)
 {
-  GeglBufferIterator *iter;
+  GeglBuffer         *src_buffer;
   CFHistogram         histogram = quantobj->histogram;
   ColorFreq          *cachep;
   const Babl         *src_format;
   const Babl         *dest_format;
-  GeglRectangle      *src_roi;
+  LinStrip            strip;
+  guchar             *src_buf;
+  guchar             *dest_buf;
+  gint               *lin_buf;
   gint                src_bpp;
   gint                dest_bpp;
   gint                has_alpha;
   gint                R, G, B;
+  gint                width, height;
+  gint                y;
   gint                red_pix          = RED;
   gint                green_pix        = GREEN;
   gint                blue_pix         = BLUE;
@@ -3110,12 +3229,11 @@ median_cut_pass2_no_dither_rgb (QuantizeObj *quantobj,
   gboolean            alpha_dither     = quantobj->want_alpha_dither;
   gint                offsetx, offsety;
   gulong             *index_used_count = quantobj->index_used_count;
-  glong               total_size       = 0;
-  glong               layer_size;
-  gint                count            = 0;
   gint                nth_layer        = quantobj->nth_layer;
   gint                n_layers         = quantobj->n_layers;
 
+  src_buffer = gimp_drawable_get_buffer (GIMP_DRAWABLE (layer));
+
   gimp_item_get_offset (GIMP_ITEM (layer), &offsetx, &offsety);
 
   src_format  = gimp_drawable_get_format (GIMP_DRAWABLE (layer));
@@ -3126,6 +3244,9 @@ median_cut_pass2_no_dither_rgb (QuantizeObj *quantobj,
 
   has_alpha = babl_format_has_alpha (src_format);
 
+  width  = gimp_item_get_width  (GIMP_ITEM (layer));
+  height = gimp_item_get_height (GIMP_ITEM (layer));
+
   /*  In the case of web/mono palettes, we actually force
    *   grayscale drawables through the rgb pass2 functions
    */
@@ -3135,31 +3256,38 @@ median_cut_pass2_no_dither_rgb (QuantizeObj *quantobj,
       alpha_pix = ALPHA_G;
     }
 
-  iter = gegl_buffer_iterator_new (gimp_drawable_get_buffer (GIMP_DRAWABLE (layer)),
-                                   NULL, 0, NULL,
-                                   GEGL_BUFFER_READ, GEGL_ABYSS_NONE);
-  src_roi = &iter->roi[0];
-
-  gegl_buffer_iterator_add (iter, new_buffer,
-                            NULL, 0, NULL,
-                            GEGL_BUFFER_WRITE, GEGL_ABYSS_NONE);
+  src_buf  = g_malloc ((gsize) width * STRIP_HEIGHT * src_bpp);
+  dest_buf = g_malloc ((gsize) width * STRIP_HEIGHT * dest_bpp);
+  lin_buf  = g_new (gint, (gsize) width * STRIP_HEIGHT * 3);
 
-  layer_size = (gimp_item_get_width  (GIMP_ITEM (layer)) *
-                gimp_item_get_height (GIMP_ITEM (layer)));
+  strip.src       = src_buf;
+  strip.lin       = lin_buf;
+  strip.bpp       = src_bpp;
+  strip.red_pix   = red_pix;
+  strip.green_pix = green_pix;
+  strip.blue_pix  = blue_pix;
 
-  while (gegl_buffer_iterator_next (iter))
+  for (y = 0; y < height; y += STRIP_HEIGHT)
     {
-      const guchar *src  = iter->data[0];
-      guchar       *dest = iter->data[1];
+      gint          strip_height = MIN (STRIP_HEIGHT, height - y);
+      const guchar *src          = src_buf;
+      guchar       *dest         = dest_buf;
+      const gint   *lin          = lin_buf;
       gint          row;
 
-      total_size += src_roi->height * src_roi->width;
+      gegl_buffer_get (src_buffer, GEGL_RECTANGLE (0, y, width, strip_height),
+                       1.0, NULL, src_buf,
+                       GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
 
-      for (row = 0; row < src_roi->height; row++)
+      gimp_parallel_distribute_range ((gsize) width * strip_height,
+                                      MIN_PARALLEL_PIXELS,
+                                      convert_to_lin_func, &strip);
+
+      for (row = 0; row < strip_height; row++)
         {
           gint col;
 
-          for (col = 0; col < src_roi->width; col++)
+          for (col = 0; col < width; col++)
             {
               if (has_alpha)
                 {
@@ -3167,8 +3295,8 @@ median_cut_pass2_no_dither_rgb (QuantizeObj *quantobj,
 
                   if (alpha_dither)
                     {
-                      gint dither_x = (col + offsetx + src_roi->x) & DM_WIDTHMASK;
-                      gint dither_y = (row + offsety + src_roi->y) & DM_HEIGHTMASK;
+                      gint dither_x = (col + offsetx) & DM_WIDTHMASK;
+                      gint dither_y = (row + offsety + y) & DM_HEIGHTMASK;
                       if ((src[alpha_pix]) < DM[dither_x][dither_y])
                         transparent = TRUE;
                     }
@@ -3180,6 +3308,7 @@ median_cut_pass2_no_dither_rgb (QuantizeObj *quantobj,
 
                   if (transparent)
                     {
+                      dest[INDEXED] = 0;
                       dest[ALPHA_I] = 0;
                       goto next_pixel;
                     }
@@ -3190,8 +3319,9 @@ median_cut_pass2_no_dither_rgb (QuantizeObj *quantobj,
                 }
 
               /* get pixel value and index into the cache */
-              rgb_to_lin (src[red_pix], src[green_pix], src[blue_pix],
-                          &R, &G, &B);
+              R = RSDF (lin[0]);
+              G = GSDF (lin[1]);
+              B = BSDF (lin[2]);
               cachep = HIST_LIN(histogram,R,G,B);
               /* If we have not seen this color before, find nearest
                  colormap entry and update the cache */
@@ -3205,14 +3335,23 @@ median_cut_pass2_no_dither_rgb (QuantizeObj *quantobj,
 
               src  += src_bpp;
               dest += dest_bpp;
+              lin  += 3;
             }
         }
 
-      if (quantobj->progress && (count % 16 == 0))
+      gegl_buffer_set (new_buffer, GEGL_RECTANGLE (0, y, width, strip_height),
+                       0, NULL, dest_buf,
+                       GEGL_AUTO_ROWSTRIDE);
+
+      if (quantobj->progress)
          gimp_progress_set_value (quantobj->progress,
-                                  (nth_layer + ((gdouble) total_size)/
-                                   layer_size) / (gdouble) n_layers);
+                                  (nth_layer + ((gdouble) (y + strip_height)) /
+                                   height) / (gdouble) n_layers);
     }
+
+  g_free (src_buf);
+  g_free (dest_buf);
+  g_free (lin_buf);
 }
 
 static void
@@ -3929,6 +4068,8 @@ median_cut_pass2_fs_dither_rgb (QuantizeObj *quantobj,
   gint          src_bpp;
   gint          dest_bpp;
   guchar       *src_buf, *dest_buf;
+  gint         *lin_buf;
+  LinStrip      strip;
   gint         *red_n_row, *red_p_row;
   gint         *grn_n_row, *grn_p_row;
   gint         *blu_n_row, *blu_p_row;
@@ -3939,7 +4080,7 @@ median_cut_pass2_fs_dither_rgb (QuantizeObj *quantobj,
   gint          re, ge, be;
   gint          row, col;
   gint          index;
-  gint          step_dest, step_src;
+  gint          step_dest, step_src, step_lin;
   gint          odd_row;
   gboolean      has_alpha;
   gint          width, height;
@@ -3994,8 +4135,16 @@ median_cut_pass2_fs_dither_rgb (QuantizeObj *quantobj,
       global_bmin = MIN(global_bmin, quantobj->clin[index].blue);
     }
 
-  src_buf  = g_malloc (width * src_bpp);
-  dest_buf = g_malloc (width * dest_bpp);
+  src_buf  = g_malloc ((gsize) width * STRIP_HEIGHT * src_bpp);
+  dest_buf = g_malloc0 (width * dest_bpp);
+  lin_buf  = g_new (gint, (gsize) width * STRIP_HEIGHT * 3);
+
+  strip.src       = src_buf;
+  strip.lin       = lin_buf;
+  strip.bpp       = src_bpp;
+  strip.red_pix   = red_pix;
+  strip.green_pix = green_pix;
+  strip.blue_pix  = blue_pix;
 
   red_n_row = g_new (gint, width + 2);
   red_p_row = g_new0 (gint, width + 2);
@@ -4015,13 +4164,29 @@ median_cut_pass2_fs_dither_rgb (QuantizeObj *quantobj,
     {
       const guchar *src;
       guchar       *dest;
+      const gint   *lin;
 
-      gegl_buffer_get (src_buffer, GEGL_RECTANGLE (0, row, width, 1),
-                       1.0, NULL, src_buf,
-                       GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+      /*  the conversion to L*a*b* doesn't depend on the diffused
+       *  error, so it is done for a whole strip in parallel, the
+       *  serpentine error diffusion itself stays serial
+       */
+      if (row % STRIP_HEIGHT == 0)
+        {
+          gint strip_height = MIN (STRIP_HEIGHT, height - row);
 
-      src  = src_buf;
+          gegl_buffer_get (src_buffer,
+                           GEGL_RECTANGLE (0, row, width, strip_height),
+                           1.0, NULL, src_buf,
+                           GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+          gimp_parallel_distribute_range ((gsize) width * strip_height,
+                                          MIN_PARALLEL_PIXELS,
+                                          convert_to_lin_func, &strip);
+        }
+
+      src  = src_buf + (gsize) (row % STRIP_HEIGHT) * width * src_bpp;
       dest = dest_buf;
+      lin  = lin_buf + (gsize) (row % STRIP_HEIGHT) * width * 3;
 
       rnr = red_n_row;
       gnr = grn_n_row;
@@ -4034,9 +4199,11 @@ median_cut_pass2_fs_dither_rgb (QuantizeObj *quantobj,
         {
           step_dest = -dest_bpp;
           step_src  = -src_bpp;
+          step_lin  = -3;
 
           src += (width * src_bpp) - src_bpp;
           dest += (width * dest_bpp) - dest_bpp;
+          lin += (width * 3) - 3;
 
           rnr += width + 1;
           gnr += width + 1;
@@ -4051,6 +4218,7 @@ median_cut_pass2_fs_dither_rgb (QuantizeObj *quantobj,
         {
           step_dest = dest_bpp;
           step_src  = src_bpp;
+          step_lin  = 3;
 
           *(rnr + 1) = *(gnr + 1) = *(bnr + 1) = 0;
         }
@@ -4136,8 +4304,9 @@ median_cut_pass2_fs_dither_rgb (QuantizeObj *quantobj,
 
           rgb_to_lin (r, g, b, &re, &ge, &be);
 #endif
-          rgb_to_unshifted_lin (src[red_pix], src[green_pix], src[blue_pix],
-                                &re, &ge, &be);
+          re = lin[0];
+          ge = lin[1];
+          be = lin[2];
 
           /*
             re = CLAMP(re, global_rmin, global_rmax);
@@ -4249,6 +4418,7 @@ median_cut_pass2_fs_dither_rgb (QuantizeObj *quantobj,
 
           dest += step_dest;
           src += step_src;
+          lin += step_lin;
         }
 
       tmp = red_n_row;
@@ -4284,6 +4454,7 @@ median_cut_pass2_fs_dither_rgb (QuantizeObj *quantobj,
   g_free (blu_p_row);
   g_free (src_buf);
   g_free (dest_buf);
+  g_free (lin_buf);
 }
 
 
@@ -218,18 +218,21 @@ gimp_image_undo_push_sample_point (GimpImage       *image,
 /********************/
 
 GimpUndo *
-gimp_image_undo_push_drawable (GimpImage    *image,
-                               const gchar  *undo_desc,
-                               GimpDrawable *drawable,
-                               GeglBuffer   *buffer,
-                               gint          x,
-                               gint          y)
+gimp_image_undo_push_drawable (GimpImage           *image,
+                               const gchar         *undo_desc,
+                               GimpDrawable        *drawable,
+                               GeglBuffer          *buffer,
+                               gint                 x,
+                               gint                 y,
+                               const GeglRectangle *rects,
+                               gint                 n_rects)
 {
   GimpItem *item;
 
   g_return_val_if_fail (GIMP_IS_IMAGE (image), NULL);
   g_return_val_if_fail (GIMP_IS_DRAWABLE (drawable), NULL);
   g_return_val_if_fail (GEGL_IS_BUFFER (buffer), NULL);
+  g_return_val_if_fail (rects != NULL || n_rects == 0, NULL);
 
   item = GIMP_ITEM (drawable);
 
@@ -238,10 +241,12 @@ gimp_image_undo_push_drawable (GimpImage    *image,
   return gimp_image_undo_push (image, GIMP_TYPE_DRAWABLE_UNDO,
                                GIMP_UNDO_DRAWABLE, undo_desc,
                                GIMP_DIRTY_ITEM | GIMP_DIRTY_DRAWABLE,
-                               "item",   item,
-                               "buffer", buffer,
-                               "x",      x,
-                               "y",      y,
+                               "item",    item,
+                               "buffer",  buffer,
+                               "rects",   rects,
+                               "n-rects", n_rects,
+                               "x",       x,
+                               "y",       y,
                                NULL);
 }
 
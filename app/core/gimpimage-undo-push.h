@@ -63,7 +63,9 @@ GimpUndo * gimp_image_undo_push_drawable            (GimpImage     *image,
                                                      GimpDrawable  *drawable,
                                                      GeglBuffer    *buffer,
                                                      gint           x,
-                                                     gint           y);
+                                                     gint           y,
+                                                     const GeglRectangle *rects,
+                                                     gint           n_rects);
 GimpUndo * gimp_image_undo_push_drawable_mod        (GimpImage     *image,
                                                      const gchar   *undo_desc,
                                                      GimpDrawable  *drawable,
@@ -33,6 +33,8 @@
 #include "gimplist.h"
 #include "gimpundostack.h"
 
+#include "gimp-intl.h"
+
 
 /*  local function prototypes  */
 
@@ -41,6 +43,12 @@ static void          gimp_image_undo_pop_stack       (GimpImage     *image,
                                                       GimpUndoStack *redo_stack,
                                                       GimpUndoMode   undo_mode);
 static void          gimp_image_undo_free_space      (GimpImage     *image);
+static gboolean      gimp_image_undo_swap_out_oldest (GimpImage     *image,
+                                                      gint64        *freed_size,
+                                                      GError       **error);
+static gboolean      gimp_image_undo_swap_out        (GimpUndo      *undo,
+                                                      gint64        *freed_size,
+                                                      GError       **error);
 static void          gimp_image_undo_free_redo       (GimpImage     *image);
 
 static GimpDirtyMask gimp_image_undo_dirty_from_type (GimpUndoType   undo_type);
@@ -541,6 +549,9 @@ gimp_image_undo_free_space (GimpImage *image)
   gint              min_undo_levels;
   gint              max_undo_levels;
   gint64            undo_size;
+  gint64            memsize;
+  gint64            freed_size = 0;
+  GError           *error      = NULL;
 
   container = private->undo_stack->undos;
 
@@ -548,27 +559,55 @@ gimp_image_undo_free_space (GimpImage *image)
   max_undo_levels = 1024; /* FIXME */
   undo_size       = image->gimp->config->undo_size;
 
+  /*  walking all steps is expensive, keep track of what is freed
+   *  below instead of asking again after each step
+   */
+  memsize = gimp_object_get_memsize (GIMP_OBJECT (container), NULL);
+
 #ifdef DEBUG_IMAGE_UNDO
   g_printerr ("undo_steps: %d    undo_bytes: %ld\n",
               gimp_container_get_n_children (container),
-              (glong) gimp_object_get_memsize (GIMP_OBJECT (container), NULL));
+              (glong) memsize);
 #endif
 
+  /*  before dropping steps because of their size, move the pixels
+   *  of the oldest ones to the undo swap
+   */
+  while (memsize > undo_size &&
+         gimp_image_undo_swap_out_oldest (image, &freed_size, &error))
+    {
+      memsize -= freed_size;
+      freed_size = 0;
+    }
+
+  if (error)
+    {
+      gimp_message (image->gimp, NULL, GIMP_MESSAGE_WARNING,
+                    _("Could not write the undo swap file, old undo "
+                      "steps will be dropped instead: %s"),
+                    error->message);
+      g_clear_error (&error);
+    }
+
   /*  keep at least min_undo_levels undo steps  */
   if (gimp_container_get_n_children (container) <= min_undo_levels)
     return;
 
-  while ((gimp_object_get_memsize (GIMP_OBJECT (container), NULL) > undo_size) ||
+  while ((memsize > undo_size) ||
          (gimp_container_get_n_children (container) > max_undo_levels))
     {
-      GimpUndo *freed = gimp_undo_stack_free_bottom (private->undo_stack,
-                                                     GIMP_UNDO_MODE_UNDO);
+      GimpObject *bottom = gimp_container_get_last_child (container);
+      GimpUndo   *freed;
+
+      memsize -= gimp_object_get_memsize (bottom, NULL);
+
+      freed = gimp_undo_stack_free_bottom (private->undo_stack,
+                                           GIMP_UNDO_MODE_UNDO);
 
 #ifdef DEBUG_IMAGE_UNDO
       g_printerr ("freed one step: undo_steps: %d    undo_bytes: %ld\n",
                   gimp_container_get_n_children (container),
-                  (glong) gimp_object_get_memsize (GIMP_OBJECT (container),
-                                                   NULL));
+                  (glong) memsize);
 #endif
 
       gimp_image_undo_event (image, GIMP_UNDO_EVENT_UNDO_EXPIRED, freed);
@@ -580,6 +619,72 @@ gimp_image_undo_free_space (GimpImage *image)
     }
 }
 
+/*  swaps out the oldest step which has pixels in memory, except for
+ *  the most recent one, and adds the bytes that were freed to
+ *  @freed_size
+ */
+static gboolean
+gimp_image_undo_swap_out_oldest (GimpImage  *image,
+                                 gint64     *freed_size,
+                                 GError    **error)
+{
+  GimpImagePrivate *private   = GIMP_IMAGE_GET_PRIVATE (image);
+  GimpContainer    *container = private->undo_stack->undos;
+  GList            *list;
+
+  for (list = g_list_last (GIMP_LIST (container)->list);
+       list && list->prev;
+       list = g_list_previous (list))
+    {
+      if (gimp_image_undo_swap_out (list->data, freed_size, error))
+        return TRUE;
+
+      if (error && *error)
+        return FALSE;
+    }
+
+  return FALSE;
+}
+
+/*  returns TRUE if pixels were moved and adds the bytes that were
+ *  freed to @freed_size, or returns FALSE and sets @error if the swap
+ *  can't be written
+ */
+static gboolean
+gimp_image_undo_swap_out (GimpUndo  *undo,
+                          gint64    *freed_size,
+                          GError   **error)
+{
+  gboolean swapped = FALSE;
+
+  if (GIMP_IS_UNDO_STACK (undo))
+    {
+      GList *list;
+
+      for (list = GIMP_LIST (GIMP_UNDO_STACK (undo)->undos)->list;
+           list;
+           list = g_list_next (list))
+        {
+          if (gimp_image_undo_swap_out (list->data, freed_size, error))
+            swapped = TRUE;
+          else if (error && *error)
+            return FALSE;
+        }
+    }
+  else if (GIMP_IS_DRAWABLE_UNDO (undo))
+    {
+      gint64 size = gimp_object_get_memsize (GIMP_OBJECT (undo), NULL);
+
+      swapped = gimp_drawable_undo_swap_out (GIMP_DRAWABLE_UNDO (undo), error);
+
+      if (swapped)
+        *freed_size += size - gimp_object_get_memsize (GIMP_OBJECT (undo),
+                                                       NULL);
+    }
+
+  return swapped;
+}
+
 static void
 gimp_image_undo_free_redo (GimpImage *image)
 {
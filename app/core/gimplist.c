@@ -27,9 +27,14 @@
 
 #include "core-types.h"
 
+#include "gimp-utils.h"
 #include "gimplist.h"
 
 
+/*  lists with fewer children are just scanned  */
+#define INDEX_THRESHOLD 32
+
+
 enum
 {
   PROP_0,
@@ -39,6 +44,16 @@ enum
 };
 
 
+typedef struct _GimpListChild GimpListChild;
+
+struct _GimpListChild
+{
+  gchar *name;      /* the name the child is indexed by       */
+  gint   position;  /* valid if the list's positions_valid is */
+};
+
+
+static void         gimp_list_finalize           (GObject             *object);
 static void         gimp_list_set_property       (GObject             *object,
                                                   guint                property_id,
                                                   const GValue        *value,
@@ -73,9 +88,28 @@ static gint         gimp_list_get_child_index    (const GimpContainer *container
 
 static void         gimp_list_uniquefy_name      (GimpList            *gimp_list,
                                                   GimpObject          *object);
+static gboolean     gimp_list_name_taken         (GimpList            *gimp_list,
+                                                  GimpObject          *object,
+                                                  const gchar         *name);
+static gchar      * gimp_list_split_name         (const gchar         *name,
+                                                  gint                *number);
 static void         gimp_list_object_renamed     (GimpObject          *object,
                                                   GimpList            *list);
 
+static void         gimp_list_index_build        (GimpList            *list);
+static void         gimp_list_index_add          (GimpList            *list,
+                                                  GimpObject          *object);
+static void         gimp_list_index_remove       (GimpList            *list,
+                                                  GimpObject          *object);
+static void         gimp_list_index_add_name     (GimpList            *list,
+                                                  GimpObject          *object,
+                                                  GimpListChild       *child);
+static void         gimp_list_index_remove_name  (GimpList            *list,
+                                                  GimpObject          *object,
+                                                  GimpListChild       *child);
+static void         gimp_list_index_update_positions
+                                                 (GimpList            *list);
+
 
 G_DEFINE_TYPE (GimpList, gimp_list, GIMP_TYPE_CONTAINER)
 
@@ -89,6 +123,7 @@ gimp_list_class_init (GimpListClass *klass)
   GimpObjectClass    *gimp_object_class = GIMP_OBJECT_CLASS (klass);
   GimpContainerClass *container_class   = GIMP_CONTAINER_CLASS (klass);
 
+  object_class->finalize              = gimp_list_finalize;
   object_class->set_property          = gimp_list_set_property;
   object_class->get_property          = gimp_list_get_property;
 
@@ -128,10 +163,48 @@ gimp_list_class_init (GimpListClass *klass)
 static void
 gimp_list_init (GimpList *list)
 {
-  list->list         = NULL;
-  list->unique_names = FALSE;
-  list->sort_func    = NULL;
-  list->append       = FALSE;
+  list->list            = NULL;
+  list->unique_names    = FALSE;
+  list->sort_func       = NULL;
+  list->append          = FALSE;
+  list->name_index      = NULL;
+  list->child_index     = NULL;
+  list->suffix_hints    = NULL;
+  list->positions_valid = FALSE;
+}
+
+static void
+gimp_list_finalize (GObject *object)
+{
+  GimpList *list = GIMP_LIST (object);
+
+  if (list->name_index)
+    {
+      GHashTableIter  iter;
+      GList          *children;
+
+      g_hash_table_iter_init (&iter, list->name_index);
+
+      while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &children))
+        g_list_free (children);
+
+      g_hash_table_destroy (list->name_index);
+      list->name_index = NULL;
+    }
+
+  if (list->child_index)
+    {
+      g_hash_table_destroy (list->child_index);
+      list->child_index = NULL;
+    }
+
+  if (list->suffix_hints)
+    {
+      g_hash_table_destroy (list->suffix_hints);
+      list->suffix_hints = NULL;
+    }
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
 static void
@@ -205,6 +278,14 @@ gimp_list_get_memsize (GimpObject *object,
         memsize += gimp_object_get_memsize (GIMP_OBJECT (glist->data), gui_size);
     }
 
+  if (list->child_index)
+    {
+      memsize += gimp_g_hash_table_get_memsize (list->name_index, 0);
+      memsize += gimp_g_hash_table_get_memsize (list->child_index,
+                                                sizeof (GimpListChild));
+      memsize += gimp_g_hash_table_get_memsize (list->suffix_hints, 0);
+    }
+
   return memsize + GIMP_OBJECT_CLASS (parent_class)->get_memsize (object,
                                                                   gui_size);
 }
@@ -215,14 +296,40 @@ gimp_list_add (GimpContainer *container,
 {
   GimpList *list = GIMP_LIST (container);
 
+  if (! list->child_index &&
+      gimp_container_get_n_children (container) >= INDEX_THRESHOLD)
+    gimp_list_index_build (list);
+
   if (list->unique_names)
     gimp_list_uniquefy_name (list, object);
 
-  if (list->unique_names || list->sort_func)
+  if (list->unique_names || list->sort_func || list->child_index)
     g_signal_connect (object, "name-changed",
                       G_CALLBACK (gimp_list_object_renamed),
                       list);
 
+  if (list->child_index)
+    {
+      gboolean at_end = (! list->sort_func && list->append);
+
+      gimp_list_index_add (list, object);
+
+      /*  appending is the only way of adding that keeps the
+       *  other children's positions
+       */
+      if (at_end && list->positions_valid)
+        {
+          GimpListChild *child = g_hash_table_lookup (list->child_index,
+                                                      object);
+
+          child->position = gimp_container_get_n_children (container);
+        }
+      else
+        {
+          list->positions_valid = FALSE;
+        }
+    }
+
   if (list->sort_func)
     list->list = g_list_insert_sorted (list->list, object, list->sort_func);
   else if (list->append)
@@ -239,11 +346,18 @@ gimp_list_remove (GimpContainer *container,
 {
   GimpList *list = GIMP_LIST (container);
 
-  if (list->unique_names || list->sort_func)
+  if (list->unique_names || list->sort_func || list->child_index)
     g_signal_handlers_disconnect_by_func (object,
                                           gimp_list_object_renamed,
                                           list);
 
+  if (list->child_index)
+    {
+      gimp_list_index_remove (list, object);
+
+      list->positions_valid = FALSE;
+    }
+
   list->list = g_list_remove (list->list, object);
 
   GIMP_CONTAINER_CLASS (parent_class)->remove (container, object);
@@ -256,6 +370,8 @@ gimp_list_reorder (GimpContainer *container,
 {
   GimpList *list = GIMP_LIST (container);
 
+  list->positions_valid = FALSE;
+
   list->list = g_list_remove (list->list, object);
 
   if (new_index == -1 ||
@@ -280,6 +396,9 @@ gimp_list_have (const GimpContainer *container,
 {
   GimpList *list = GIMP_LIST (container);
 
+  if (list->child_index)
+    return g_hash_table_lookup (list->child_index, object) != NULL;
+
   return g_list_find (list->list, object) ? TRUE : FALSE;
 }
 
@@ -300,6 +419,19 @@ gimp_list_get_child_by_name (const GimpContainer *container,
   GimpList *list = GIMP_LIST (container);
   GList    *glist;
 
+  if (list->name_index)
+    {
+      GList *children = g_hash_table_lookup (list->name_index, name);
+
+      if (! children)
+        return NULL;
+
+      if (! children->next)
+        return children->data;
+
+      /*  several children have this name, find the first one  */
+    }
+
   for (glist = list->list; glist; glist = g_list_next (glist))
     {
       GimpObject *object = glist->data;
@@ -332,6 +464,19 @@ gimp_list_get_child_index (const GimpContainer *container,
 {
   GimpList *list = GIMP_LIST (container);
 
+  if (list->child_index)
+    {
+      GimpListChild *child = g_hash_table_lookup (list->child_index, object);
+
+      if (! child)
+        return -1;
+
+      if (! list->positions_valid)
+        gimp_list_index_update_positions (list);
+
+      return child->position;
+    }
+
   return g_list_index (list->list, (gpointer) object);
 }
 
@@ -418,6 +563,7 @@ gimp_list_reverse (GimpList *list)
     {
       gimp_container_freeze (GIMP_CONTAINER (list));
       list->list = g_list_reverse (list->list);
+      list->positions_valid = FALSE;
       gimp_container_thaw (GIMP_CONTAINER (list));
     }
 }
@@ -482,6 +628,7 @@ gimp_list_sort (GimpList     *list,
     {
       gimp_container_freeze (GIMP_CONTAINER (list));
       list->list = g_list_sort (list->list, sort_func);
+      list->positions_valid = FALSE;
       gimp_container_thaw (GIMP_CONTAINER (list));
     }
 }
@@ -507,13 +654,59 @@ static void
 gimp_list_uniquefy_name (GimpList   *gimp_list,
                          GimpObject *object)
 {
-  gchar *name = (gchar *) gimp_object_get_name (object);
-  GList *list;
+  const gchar *name = gimp_object_get_name (object);
+  gchar       *base;
+  gchar       *new_name = NULL;
+  gint         unique_ext;
+  gint         hint     = 0;
 
-  if (! name)
+  if (! name || ! gimp_list_name_taken (gimp_list, object, name))
     return;
 
-  for (list = gimp_list->list; list; list = g_list_next (list))
+  base = gimp_list_split_name (name, &unique_ext);
+
+  /*  "base #1" up to "base #<hint>" are all taken, skip them  */
+  if (gimp_list->suffix_hints)
+    hint = GPOINTER_TO_INT (g_hash_table_lookup (gimp_list->suffix_hints,
+                                                 base));
+
+  if (unique_ext <= hint)
+    unique_ext = hint;
+  else
+    hint = -1;
+
+  do
+    {
+      unique_ext++;
+
+      g_free (new_name);
+
+      new_name = g_strdup_printf ("%s #%d", base, unique_ext);
+    }
+  while (gimp_list_name_taken (gimp_list, object, new_name));
+
+  if (gimp_list->suffix_hints && hint >= 0)
+    g_hash_table_insert (gimp_list->suffix_hints,
+                         base, GINT_TO_POINTER (unique_ext));
+  else
+    g_free (base);
+
+  gimp_object_take_name (object, new_name);
+}
+
+static gboolean
+gimp_list_name_taken (GimpList    *gimp_list,
+                      GimpObject  *object,
+                      const gchar *name)
+{
+  GList *list;
+
+  if (gimp_list->name_index)
+    list = g_hash_table_lookup (gimp_list->name_index, name);
+  else
+    list = gimp_list->list;
+
+  for (; list; list = g_list_next (list))
     {
       GimpObject  *object2 = list->data;
       const gchar *name2   = gimp_object_get_name (object2);
@@ -521,72 +714,62 @@ gimp_list_uniquefy_name (GimpList   *gimp_list,
       if (object != object2 &&
           name2             &&
           ! strcmp (name, name2))
-        break;
+        return TRUE;
     }
 
-  if (list)
-    {
-      gchar *ext;
-      gchar *new_name   = NULL;
-      gint   unique_ext = 0;
-
-      name = g_strdup (name);
-
-      ext = strrchr (name, '#');
-
-      if (ext)
-        {
-          gchar ext_str[8];
+  return FALSE;
+}
 
-          unique_ext = atoi (ext + 1);
+/*  splits "name #<n>" into a newly allocated "name" and n, or returns
+ *  a copy of @name and 0 if it doesn't end in such an extension
+ */
+static gchar *
+gimp_list_split_name (const gchar *name,
+                      gint        *number)
+{
+  gchar *base = g_strdup (name);
+  gchar *ext  = strrchr (base, '#');
 
-          g_snprintf (ext_str, sizeof (ext_str), "%d", unique_ext);
+  *number = 0;
 
-          /*  check if the extension really is of the form "#<n>"  */
-          if (! strcmp (ext_str, ext + 1))
-            {
-              if (ext > name && *(ext - 1) == ' ')
-                ext--;
+  if (ext)
+    {
+      gchar ext_str[8];
+      gint  unique_ext = atoi (ext + 1);
 
-              *ext = '\0';
-            }
-          else
-            {
-              unique_ext = 0;
-            }
-        }
+      g_snprintf (ext_str, sizeof (ext_str), "%d", unique_ext);
 
-      do
+      /*  check if the extension really is of the form "#<n>"  */
+      if (! strcmp (ext_str, ext + 1))
         {
-          unique_ext++;
+          if (ext > base && *(ext - 1) == ' ')
+            ext--;
 
-          g_free (new_name);
+          *ext = '\0';
 
-          new_name = g_strdup_printf ("%s #%d", name, unique_ext);
-
-          for (list = gimp_list->list; list; list = g_list_next (list))
-            {
-              GimpObject  *object2 = list->data;
-              const gchar *name2   = gimp_object_get_name (object2);
-
-              if (object != object2 &&
-                  name2             &&
-                  ! strcmp (new_name, name2))
-                break;
-            }
+          *number = unique_ext;
         }
-      while (list);
-
-      g_free (name);
-
-      gimp_object_take_name (object, new_name);
     }
+
+  return base;
 }
 
 static void
 gimp_list_object_renamed (GimpObject *object,
                           GimpList   *list)
 {
+  GimpListChild *child = NULL;
+
+  /*  take the old name out of the index before making the new one
+   *  unique, it is free now
+   */
+  if (list->child_index)
+    {
+      child = g_hash_table_lookup (list->child_index, object);
+
+      gimp_list_index_remove_name (list, object, child);
+    }
+
   if (list->unique_names)
     {
       g_signal_handlers_block_by_func (object,
@@ -600,6 +783,9 @@ gimp_list_object_renamed (GimpObject *object,
                                          list);
     }
 
+  if (child)
+    gimp_list_index_add_name (list, object, child);
+
   if (list->sort_func)
     {
       GList *glist;
@@ -625,3 +811,159 @@ gimp_list_object_renamed (GimpObject *object,
         gimp_container_reorder (GIMP_CONTAINER (list), object, new_index);
     }
 }
+
+static void
+gimp_list_child_free (GimpListChild *child)
+{
+  g_free (child->name);
+
+  g_slice_free (GimpListChild, child);
+}
+
+static void
+gimp_list_index_build (GimpList *list)
+{
+  GList *glist;
+
+  list->name_index  = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                             (GDestroyNotify) g_free,
+                                             NULL);
+  list->child_index = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                             NULL,
+                                             (GDestroyNotify) gimp_list_child_free);
+
+  if (list->unique_names)
+    list->suffix_hints = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                                (GDestroyNotify) g_free,
+                                                NULL);
+
+  for (glist = list->list; glist; glist = g_list_next (glist))
+    {
+      GimpObject *object = glist->data;
+
+      /*  from now on, all renames have to be seen  */
+      g_signal_handlers_disconnect_by_func (object,
+                                            gimp_list_object_renamed,
+                                            list);
+      g_signal_connect (object, "name-changed",
+                        G_CALLBACK (gimp_list_object_renamed),
+                        list);
+
+      gimp_list_index_add (list, object);
+    }
+
+  list->positions_valid = FALSE;
+}
+
+static void
+gimp_list_index_add (GimpList   *list,
+                     GimpObject *object)
+{
+  GimpListChild *child = g_slice_new0 (GimpListChild);
+
+  g_hash_table_insert (list->child_index, object, child);
+
+  gimp_list_index_add_name (list, object, child);
+}
+
+static void
+gimp_list_index_remove (GimpList   *list,
+                        GimpObject *object)
+{
+  GimpListChild *child = g_hash_table_lookup (list->child_index, object);
+
+  if (child)
+    {
+      gimp_list_index_remove_name (list, object, child);
+
+      g_hash_table_remove (list->child_index, object);
+    }
+}
+
+static void
+gimp_list_index_add_name (GimpList      *list,
+                          GimpObject    *object,
+                          GimpListChild *child)
+{
+  const gchar *name = gimp_object_get_name (object);
+  GList       *children;
+
+  g_free (child->name);
+  child->name = g_strdup (name);
+
+  if (! name)
+    return;
+
+  children = g_hash_table_lookup (list->name_index, name);
+  children = g_list_prepend (children, object);
+
+  g_hash_table_insert (list->name_index, g_strdup (name), children);
+}
+
+static void
+gimp_list_index_remove_name (GimpList      *list,
+                             GimpObject    *object,
+                             GimpListChild *child)
+{
+  GList *children;
+
+  if (! child || ! child->name)
+    return;
+
+  children = g_hash_table_lookup (list->name_index, child->name);
+  children = g_list_remove (children, object);
+
+  if (children)
+    g_hash_table_insert (list->name_index, g_strdup (child->name), children);
+  else
+    g_hash_table_remove (list->name_index, child->name);
+
+  /*  if the name was one of the "#<n>" that are known to be taken,
+   *  they aren't all taken any longer
+   */
+  if (list->suffix_hints)
+    {
+      gchar *base;
+      gint   number;
+
+      base = gimp_list_split_name (child->name, &number);
+
+      if (number > 0)
+        {
+          gint hint = GPOINTER_TO_INT (g_hash_table_lookup (list->suffix_hints,
+                                                            base));
+
+          if (number <= hint)
+            {
+              if (number > 1)
+                g_hash_table_insert (list->suffix_hints,
+                                     g_strdup (base),
+                                     GINT_TO_POINTER (number - 1));
+              else
+                g_hash_table_remove (list->suffix_hints, base);
+            }
+        }
+
+      g_free (base);
+    }
+
+  g_free (child->name);
+  child->name = NULL;
+}
+
+static void
+gimp_list_index_update_positions (GimpList *list)
+{
+  GList *glist;
+  gint   position = 0;
+
+  for (glist = list->list; glist; glist = g_list_next (glist))
+    {
+      GimpListChild *child = g_hash_table_lookup (list->child_index,
+                                                  glist->data);
+
+      child->position = position++;
+    }
+
+  list->positions_valid = TRUE;
+}
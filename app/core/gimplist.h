@@ -43,6 +43,12 @@ struct _GimpList
   gboolean       unique_names;
   GCompareFunc   sort_func;
   gboolean       append;
+
+  /*  lookup tables, built once the list grows long  */
+  GHashTable    *name_index;      /* name -> GList of children       */
+  GHashTable    *child_index;     /* child -> GimpListChild          */
+  GHashTable    *suffix_hints;    /* base name -> highest "#n" taken */
+  gboolean       positions_valid;
 };
 
 struct _GimpListClass
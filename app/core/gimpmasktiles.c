@@ -0,0 +1,776 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimpmasktiles.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <gegl.h>
+
+#include "core-types.h"
+
+#include "gimpboundary.h"
+#include "gimpmasktiles.h"
+
+
+/*  The bounds and the boundary of a mask are cached per TILE_SIZE x
+ *  TILE_SIZE tile.  The buffer's "changed" signal invalidates the
+ *  tiles it touches, so after painting into the mask only those tiles
+ *  are scanned again, and the results of all tiles are merged.
+ *
+ *  A tile owns the boundary edges above and left of its pixels, and
+ *  the ones below and right of them at the bottom and right edge of
+ *  the mask, so the segments of all tiles together are the boundary
+ *  of the whole mask.  Segments are split at the tile edges, they
+ *  still connect end to end for gimp_boundary_sort().
+ *
+ *  "changed" is emitted by whichever thread wrote to the buffer, so
+ *  the tiles are guarded by a mutex, and the queries hold it while
+ *  they scan the stale tiles.
+ */
+
+#define TILE_SIZE 128
+
+
+typedef struct
+{
+  guint         bounds_valid   : 1;
+  guint         boundary_valid : 1;
+  guint         empty          : 1;
+
+  /*  the non-empty area of the tile, unless empty  */
+  gint          x1, y1;
+  gint          x2, y2;
+
+  GimpBoundSeg *segs_in;
+  GimpBoundSeg *segs_out;
+  gint          n_segs_in;
+  gint          n_segs_out;
+} MaskTile;
+
+struct _GimpMaskTiles
+{
+  GMutex         mutex;
+
+  GeglBuffer    *buffer;          /*  weak pointer  */
+  gulong         changed_id;
+
+  gint           width;
+  gint           height;
+  gint           n_cols;
+  gint           n_rows;
+  MaskTile      *tiles;
+
+  /*  the bounds the boundary was last calculated for  */
+  GeglRectangle  boundary_rect;
+};
+
+
+/*  local function prototypes  */
+
+static gboolean       gimp_mask_tiles_calc_bounds    (GimpMaskTiles       *tiles,
+                                                      GeglBuffer          *buffer,
+                                                      gint                *x1,
+                                                      gint                *y1,
+                                                      gint                *x2,
+                                                      gint                *y2);
+static void           gimp_mask_tiles_clear          (GimpMaskTiles       *tiles);
+static void           gimp_mask_tiles_set_buffer     (GimpMaskTiles       *tiles,
+                                                      GeglBuffer          *buffer);
+static void           gimp_mask_tiles_buffer_changed (GeglBuffer          *buffer,
+                                                      const GeglRectangle *rect,
+                                                      GimpMaskTiles       *tiles);
+static void           gimp_mask_tiles_set_rect       (GimpMaskTiles       *tiles,
+                                                      const GeglRectangle *rect);
+
+static void           gimp_mask_tiles_get_area       (GimpMaskTiles       *tiles,
+                                                      gint                 col,
+                                                      gint                 row,
+                                                      GeglRectangle       *rect,
+                                                      GeglRectangle       *edge_rect);
+static GimpBoundSeg * gimp_mask_tiles_merge          (GimpMaskTiles       *tiles,
+                                                      gboolean             in,
+                                                      gint                *n_segs);
+
+static void           mask_tile_clear_boundary       (MaskTile            *tile);
+static void           mask_tile_calc_bounds          (MaskTile            *tile,
+                                                      GeglBuffer          *buffer,
+                                                      const GeglRectangle *rect,
+                                                      gfloat              *data);
+static void           mask_tile_calc_boundary        (MaskTile            *tile,
+                                                      GeglBuffer          *buffer,
+                                                      const GeglRectangle *rect,
+                                                      const GeglRectangle *edge_rect,
+                                                      const GeglRectangle *bounds,
+                                                      gfloat              *data,
+                                                      guchar              *mask_in,
+                                                      guchar              *mask_out);
+
+static GimpBoundSeg * find_tile_segs                 (const guchar        *mask,
+                                                      const GeglRectangle *rect,
+                                                      const GeglRectangle *edge_rect,
+                                                      gint                *n_segs);
+
+
+/*  public functions  */
+
+GimpMaskTiles *
+gimp_mask_tiles_new (void)
+{
+  GimpMaskTiles *tiles = g_slice_new0 (GimpMaskTiles);
+
+  g_mutex_init (&tiles->mutex);
+
+  return tiles;
+}
+
+void
+gimp_mask_tiles_free (GimpMaskTiles *tiles)
+{
+  g_return_if_fail (tiles != NULL);
+
+  g_mutex_lock (&tiles->mutex);
+  gimp_mask_tiles_clear (tiles);
+  g_mutex_unlock (&tiles->mutex);
+
+  g_mutex_clear (&tiles->mutex);
+
+  g_slice_free (GimpMaskTiles, tiles);
+}
+
+gboolean
+gimp_mask_tiles_bounds (GimpMaskTiles *tiles,
+                        GeglBuffer    *buffer,
+                        gint          *x1,
+                        gint          *y1,
+                        gint          *x2,
+                        gint          *y2)
+{
+  gboolean retval;
+
+  g_return_val_if_fail (tiles != NULL, FALSE);
+  g_return_val_if_fail (GEGL_IS_BUFFER (buffer), FALSE);
+  g_return_val_if_fail (x1 != NULL, FALSE);
+  g_return_val_if_fail (y1 != NULL, FALSE);
+  g_return_val_if_fail (x2 != NULL, FALSE);
+  g_return_val_if_fail (y2 != NULL, FALSE);
+
+  g_mutex_lock (&tiles->mutex);
+
+  retval = gimp_mask_tiles_calc_bounds (tiles, buffer, x1, y1, x2, y2);
+
+  g_mutex_unlock (&tiles->mutex);
+
+  return retval;
+}
+
+/*  Returns the same segments as gimp_boundary_find() with
+ *  GIMP_BOUNDARY_WITHIN_BOUNDS for the inside and with
+ *  GIMP_BOUNDARY_IGNORE_BOUNDS for the outside of the x1, y1, x2, y2
+ *  rectangle, but split at tile edges.
+ */
+void
+gimp_mask_tiles_boundary (GimpMaskTiles  *tiles,
+                          GeglBuffer     *buffer,
+                          gint            x1,
+                          gint            y1,
+                          gint            x2,
+                          gint            y2,
+                          GimpBoundSeg  **segs_in,
+                          gint           *n_segs_in,
+                          GimpBoundSeg  **segs_out,
+                          gint           *n_segs_out)
+{
+  GeglRectangle  bounds;
+  GeglRectangle  mask_bounds;
+  gfloat        *data     = NULL;
+  guchar        *mask_in  = NULL;
+  guchar        *mask_out = NULL;
+  gint           col, row;
+
+  g_return_if_fail (tiles != NULL);
+  g_return_if_fail (GEGL_IS_BUFFER (buffer));
+  g_return_if_fail (segs_in != NULL && n_segs_in != NULL);
+  g_return_if_fail (segs_out != NULL && n_segs_out != NULL);
+
+  gegl_rectangle_set (&bounds, x1, y1, MAX (x2 - x1, 0), MAX (y2 - y1, 0));
+
+  g_mutex_lock (&tiles->mutex);
+
+  /*  tiles too far away from any pixel of the mask have no boundary  */
+  if (gimp_mask_tiles_calc_bounds (tiles, buffer, &x1, &y1, &x2, &y2))
+    gegl_rectangle_set (&mask_bounds, x1, y1, x2 - x1, y2 - y1);
+  else
+    gegl_rectangle_set (&mask_bounds, 0, 0, 0, 0);
+
+  gimp_mask_tiles_set_rect (tiles, &bounds);
+
+  for (row = 0; row < tiles->n_rows; row++)
+    for (col = 0; col < tiles->n_cols; col++)
+      {
+        MaskTile      *tile = &tiles->tiles[row * tiles->n_cols + col];
+        GeglRectangle  rect;
+        GeglRectangle  edge_rect;
+
+        if (tile->boundary_valid)
+          continue;
+
+        mask_tile_clear_boundary (tile);
+
+        gimp_mask_tiles_get_area (tiles, col, row, &rect, &edge_rect);
+
+        if (gegl_rectangle_intersect (NULL, &edge_rect, &mask_bounds))
+          {
+            if (! data)
+              {
+                gint size = (TILE_SIZE + 2) * (TILE_SIZE + 2);
+
+                data     = g_new (gfloat, size);
+                mask_in  = g_new (guchar, size);
+                mask_out = g_new (guchar, size);
+              }
+
+            mask_tile_calc_boundary (tile, buffer, &rect, &edge_rect,
+                                     &bounds, data, mask_in, mask_out);
+          }
+
+        tile->boundary_valid = TRUE;
+      }
+
+  g_free (data);
+  g_free (mask_in);
+  g_free (mask_out);
+
+  *segs_in  = gimp_mask_tiles_merge (tiles, TRUE,  n_segs_in);
+  *segs_out = gimp_mask_tiles_merge (tiles, FALSE, n_segs_out);
+
+  g_mutex_unlock (&tiles->mutex);
+}
+
+gint64
+gimp_mask_tiles_get_memsize (GimpMaskTiles *tiles)
+{
+  gint64 memsize;
+  gint   i;
+
+  g_return_val_if_fail (tiles != NULL, 0);
+
+  g_mutex_lock (&tiles->mutex);
+
+  memsize = (sizeof (GimpMaskTiles) +
+             tiles->n_cols * tiles->n_rows * sizeof (MaskTile));
+
+  for (i = 0; i < tiles->n_cols * tiles->n_rows; i++)
+    {
+      memsize += ((tiles->tiles[i].n_segs_in + tiles->tiles[i].n_segs_out) *
+                  sizeof (GimpBoundSeg));
+    }
+
+  g_mutex_unlock (&tiles->mutex);
+
+  return memsize;
+}
+
+
+/*  private functions  */
+
+static gboolean
+gimp_mask_tiles_calc_bounds (GimpMaskTiles *tiles,
+                             GeglBuffer    *buffer,
+                             gint          *x1,
+                             gint          *y1,
+                             gint          *x2,
+                             gint          *y2)
+{
+  gfloat *data = NULL;
+  gint    tx1  = G_MAXINT;
+  gint    ty1  = G_MAXINT;
+  gint    tx2  = G_MININT;
+  gint    ty2  = G_MININT;
+  gint    col, row;
+
+  gimp_mask_tiles_set_buffer (tiles, buffer);
+
+  for (row = 0; row < tiles->n_rows; row++)
+    for (col = 0; col < tiles->n_cols; col++)
+      {
+        MaskTile *tile = &tiles->tiles[row * tiles->n_cols + col];
+
+        if (! tile->bounds_valid)
+          {
+            GeglRectangle rect;
+
+            if (! data)
+              data = g_new (gfloat, TILE_SIZE * TILE_SIZE);
+
+            gimp_mask_tiles_get_area (tiles, col, row, &rect, NULL);
+
+            mask_tile_calc_bounds (tile, buffer, &rect, data);
+          }
+
+        if (! tile->empty)
+          {
+            tx1 = MIN (tx1, tile->x1);
+            ty1 = MIN (ty1, tile->y1);
+            tx2 = MAX (tx2, tile->x2);
+            ty2 = MAX (ty2, tile->y2);
+          }
+      }
+
+  g_free (data);
+
+  if (tx1 >= tx2 || ty1 >= ty2)
+    {
+      *x1 = 0;
+      *y1 = 0;
+      *x2 = tiles->width;
+      *y2 = tiles->height;
+
+      return FALSE;
+    }
+
+  *x1 = tx1;
+  *y1 = ty1;
+  *x2 = tx2;
+  *y2 = ty2;
+
+  return TRUE;
+}
+
+static void
+gimp_mask_tiles_clear (GimpMaskTiles *tiles)
+{
+  gint i;
+
+  if (tiles->buffer)
+    {
+      g_signal_handler_disconnect (tiles->buffer, tiles->changed_id);
+      g_object_remove_weak_pointer (G_OBJECT (tiles->buffer),
+                                    (gpointer) &tiles->buffer);
+
+      tiles->buffer     = NULL;
+      tiles->changed_id = 0;
+    }
+
+  for (i = 0; i < tiles->n_cols * tiles->n_rows; i++)
+    mask_tile_clear_boundary (&tiles->tiles[i]);
+
+  g_free (tiles->tiles);
+
+  tiles->tiles  = NULL;
+  tiles->width  = 0;
+  tiles->height = 0;
+  tiles->n_cols = 0;
+  tiles->n_rows = 0;
+}
+
+/*  start over whenever the channel got a new buffer, the weak pointer
+ *  makes sure a new buffer at the address of a freed one is noticed
+ */
+static void
+gimp_mask_tiles_set_buffer (GimpMaskTiles *tiles,
+                            GeglBuffer    *buffer)
+{
+  gint width  = gegl_buffer_get_width  (buffer);
+  gint height = gegl_buffer_get_height (buffer);
+
+  if (buffer == tiles->buffer  &&
+      width  == tiles->width   &&
+      height == tiles->height)
+    return;
+
+  gimp_mask_tiles_clear (tiles);
+
+  tiles->buffer = buffer;
+  g_object_add_weak_pointer (G_OBJECT (buffer), (gpointer) &tiles->buffer);
+
+  tiles->changed_id =
+    gegl_buffer_signal_connect (buffer, "changed",
+                                G_CALLBACK (gimp_mask_tiles_buffer_changed),
+                                tiles);
+
+  tiles->width  = width;
+  tiles->height = height;
+  tiles->n_cols = (width  + TILE_SIZE - 1) / TILE_SIZE;
+  tiles->n_rows = (height + TILE_SIZE - 1) / TILE_SIZE;
+  tiles->tiles  = g_new0 (MaskTile, tiles->n_cols * tiles->n_rows);
+}
+
+static void
+gimp_mask_tiles_buffer_changed (GeglBuffer          *buffer,
+                                const GeglRectangle *rect,
+                                GimpMaskTiles       *tiles)
+{
+  gint x1, y1;
+  gint x2, y2;
+  gint col1, col2, edge_col2;
+  gint row1, row2, edge_row2;
+  gint col, row;
+
+  g_mutex_lock (&tiles->mutex);
+
+  x1 = MAX (rect->x, 0);
+  y1 = MAX (rect->y, 0);
+  x2 = MIN (rect->x + rect->width,  tiles->width);
+  y2 = MIN (rect->y + rect->height, tiles->height);
+
+  if (x1 >= x2 || y1 >= y2)
+    {
+      g_mutex_unlock (&tiles->mutex);
+      return;
+    }
+
+  col1 = x1 / TILE_SIZE;
+  row1 = y1 / TILE_SIZE;
+  col2 = (x2 - 1) / TILE_SIZE;
+  row2 = (y2 - 1) / TILE_SIZE;
+
+  /*  the edges below and right of the changed pixels can belong to
+   *  the next tiles
+   */
+  edge_col2 = MIN (x2 / TILE_SIZE, tiles->n_cols - 1);
+  edge_row2 = MIN (y2 / TILE_SIZE, tiles->n_rows - 1);
+
+  for (row = row1; row <= edge_row2; row++)
+    for (col = col1; col <= edge_col2; col++)
+      {
+        MaskTile *tile = &tiles->tiles[row * tiles->n_cols + col];
+
+        tile->boundary_valid = FALSE;
+
+        if (col <= col2 && row <= row2)
+          tile->bounds_valid = FALSE;
+      }
+
+  g_mutex_unlock (&tiles->mutex);
+}
+
+/*  only tiles which were not, or are not any longer, entirely inside
+ *  or outside of the bounds need a new boundary
+ */
+static void
+gimp_mask_tiles_set_rect (GimpMaskTiles       *tiles,
+                          const GeglRectangle *rect)
+{
+  const GeglRectangle *old_rect = &tiles->boundary_rect;
+  gint                 col, row;
+
+  if (gegl_rectangle_equal (rect, old_rect))
+    return;
+
+  for (row = 0; row < tiles->n_rows; row++)
+    for (col = 0; col < tiles->n_cols; col++)
+      {
+        MaskTile      *tile = &tiles->tiles[row * tiles->n_cols + col];
+        GeglRectangle  edge_rect;
+        gboolean       old_inside, new_inside;
+        gboolean       old_outside, new_outside;
+
+        if (! tile->boundary_valid)
+          continue;
+
+        gimp_mask_tiles_get_area (tiles, col, row, NULL, &edge_rect);
+
+        old_inside  = gegl_rectangle_contains (old_rect, &edge_rect);
+        new_inside  = gegl_rectangle_contains (rect,     &edge_rect);
+        old_outside = ! gegl_rectangle_intersect (NULL, old_rect, &edge_rect);
+        new_outside = ! gegl_rectangle_intersect (NULL, rect,     &edge_rect);
+
+        if (! ((old_inside && new_inside) || (old_outside && new_outside)))
+          tile->boundary_valid = FALSE;
+      }
+
+  tiles->boundary_rect = *rect;
+}
+
+/*  rect is the tile's area, edge_rect the pixels which determine the
+ *  edges owned by the tile
+ */
+static void
+gimp_mask_tiles_get_area (GimpMaskTiles *tiles,
+                          gint           col,
+                          gint           row,
+                          GeglRectangle *rect,
+                          GeglRectangle *edge_rect)
+{
+  gint x = col * TILE_SIZE;
+  gint y = row * TILE_SIZE;
+  gint w = MIN (TILE_SIZE, tiles->width  - x);
+  gint h = MIN (TILE_SIZE, tiles->height - y);
+
+  if (rect)
+    gegl_rectangle_set (rect, x, y, w, h);
+
+  if (edge_rect)
+    gegl_rectangle_set (edge_rect,
+                        x - 1, y - 1,
+                        w + (col == tiles->n_cols - 1 ? 2 : 1),
+                        h + (row == tiles->n_rows - 1 ? 2 : 1));
+}
+
+static GimpBoundSeg *
+gimp_mask_tiles_merge (GimpMaskTiles *tiles,
+                       gboolean       in,
+                       gint          *n_segs)
+{
+  GimpBoundSeg *segs;
+  GimpBoundSeg *dest;
+  gint          n = 0;
+  gint          i;
+
+  for (i = 0; i < tiles->n_cols * tiles->n_rows; i++)
+    n += in ? tiles->tiles[i].n_segs_in : tiles->tiles[i].n_segs_out;
+
+  *n_segs = n;
+
+  if (! n)
+    return NULL;
+
+  segs = dest = g_new (GimpBoundSeg, n);
+
+  for (i = 0; i < tiles->n_cols * tiles->n_rows; i++)
+    {
+      MaskTile *tile = &tiles->tiles[i];
+
+      if (in && tile->n_segs_in)
+        {
+          memcpy (dest, tile->segs_in, tile->n_segs_in * sizeof (GimpBoundSeg));
+          dest += tile->n_segs_in;
+        }
+      else if (! in && tile->n_segs_out)
+        {
+          memcpy (dest, tile->segs_out, tile->n_segs_out * sizeof (GimpBoundSeg));
+          dest += tile->n_segs_out;
+        }
+    }
+
+  return segs;
+}
+
+static void
+mask_tile_clear_boundary (MaskTile *tile)
+{
+  g_free (tile->segs_in);
+  g_free (tile->segs_out);
+
+  tile->segs_in    = NULL;
+  tile->segs_out   = NULL;
+  tile->n_segs_in  = 0;
+  tile->n_segs_out = 0;
+}
+
+static void
+mask_tile_calc_bounds (MaskTile            *tile,
+                       GeglBuffer          *buffer,
+                       const GeglRectangle *rect,
+                       gfloat              *data)
+{
+  gint x1 = G_MAXINT;
+  gint y1 = G_MAXINT;
+  gint x2 = G_MININT;
+  gint y2 = G_MININT;
+  gint y;
+
+  gegl_buffer_get (buffer, rect, 1.0, babl_format ("Y float"), data,
+                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+  for (y = 0; y < rect->height; y++)
+    {
+      const gfloat *line = data + y * rect->width;
+      gint          first;
+      gint          last;
+
+      for (first = 0; first < rect->width && ! line[first]; first++);
+
+      if (first == rect->width)
+        continue;
+
+      for (last = rect->width - 1; ! line[last]; last--);
+
+      x1 = MIN (x1, first);
+      x2 = MAX (x2, last + 1);
+      y1 = MIN (y1, y);
+      y2 = y + 1;
+    }
+
+  tile->empty = (x1 >= x2);
+
+  if (! tile->empty)
+    {
+      tile->x1 = rect->x + x1;
+      tile->y1 = rect->y + y1;
+      tile->x2 = rect->x + x2;
+      tile->y2 = rect->y + y2;
+    }
+
+  tile->bounds_valid = TRUE;
+}
+
+static void
+mask_tile_calc_boundary (MaskTile            *tile,
+                         GeglBuffer          *buffer,
+                         const GeglRectangle *rect,
+                         const GeglRectangle *edge_rect,
+                         const GeglRectangle *bounds,
+                         gfloat              *data,
+                         guchar              *mask_in,
+                         guchar              *mask_out)
+{
+  gint i = 0;
+  gint x, y;
+
+  gegl_buffer_get (buffer, edge_rect, 1.0, babl_format ("Y float"), data,
+                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+  /*  like gimp_boundary_find(), pixels inside the bounds make up the
+   *  inside, pixels outside of them the outside boundary
+   */
+  for (y = edge_rect->y; y < edge_rect->y + edge_rect->height; y++)
+    {
+      gboolean row_inside = (y >= bounds->y &&
+                             y <  bounds->y + bounds->height);
+
+      for (x = edge_rect->x; x < edge_rect->x + edge_rect->width; x++, i++)
+        {
+          gboolean filled = data[i] > GIMP_BOUNDARY_HALF_WAY;
+          gboolean inside = (row_inside &&
+                             x >= bounds->x &&
+                             x <  bounds->x + bounds->width);
+
+          mask_in[i]  = filled && inside;
+          mask_out[i] = filled && ! inside;
+        }
+    }
+
+  tile->segs_in  = find_tile_segs (mask_in,  rect, edge_rect,
+                                   &tile->n_segs_in);
+  tile->segs_out = find_tile_segs (mask_out, rect, edge_rect,
+                                   &tile->n_segs_out);
+}
+
+static inline void
+add_seg (GArray   *segs,
+         gint      x1,
+         gint      y1,
+         gint      x2,
+         gint      y2,
+         gboolean  open)
+{
+  GimpBoundSeg seg = { 0, };
+
+  seg.x1   = x1;
+  seg.y1   = y1;
+  seg.x2   = x2;
+  seg.y2   = y2;
+  seg.open = open;
+
+  g_array_append_val (segs, seg);
+}
+
+/*  find the edges between filled and empty pixels owned by the tile,
+ *  merged into runs of the same direction.  As in gimp_boundary_find(),
+ *  a segment is "open" when the filled pixel is below or right of it.
+ */
+static GimpBoundSeg *
+find_tile_segs (const guchar        *mask,
+                const GeglRectangle *rect,
+                const GeglRectangle *edge_rect,
+                gint                *n_segs)
+{
+  GArray *segs   = g_array_new (FALSE, FALSE, sizeof (GimpBoundSeg));
+  gint    stride = edge_rect->width;
+  gint    x, y;
+
+  /*  horizontal edges, above each of the tile's rows and below the
+   *  last row of the mask
+   */
+  for (y = 1; y < edge_rect->height; y++)
+    {
+      const guchar *above = mask + (y - 1) * stride;
+      const guchar *below = mask + y * stride;
+      gint          start = -1;
+      gboolean      open  = FALSE;
+
+      for (x = 1; x <= rect->width; x++)
+        {
+          gboolean edge = (above[x] != below[x]);
+
+          if (start >= 0 && (! edge || below[x] != open))
+            {
+              add_seg (segs,
+                       edge_rect->x + start, edge_rect->y + y,
+                       edge_rect->x + x,     edge_rect->y + y,
+                       open);
+              start = -1;
+            }
+
+          if (edge && start < 0)
+            {
+              start = x;
+              open  = below[x];
+            }
+        }
+
+      if (start >= 0)
+        add_seg (segs,
+                 edge_rect->x + start,           edge_rect->y + y,
+                 edge_rect->x + rect->width + 1, edge_rect->y + y,
+                 open);
+    }
+
+  /*  vertical edges, left of each of the tile's columns and right of
+   *  the last column of the mask
+   */
+  for (x = 1; x < edge_rect->width; x++)
+    {
+      gint     start = -1;
+      gboolean open  = FALSE;
+
+      for (y = 1; y <= rect->height; y++)
+        {
+          const guchar *line = mask + y * stride;
+          gboolean      edge = (line[x - 1] != line[x]);
+
+          if (start >= 0 && (! edge || line[x] != open))
+            {
+              add_seg (segs,
+                       edge_rect->x + x, edge_rect->y + start,
+                       edge_rect->x + x, edge_rect->y + y,
+                       open);
+              start = -1;
+            }
+
+          if (edge && start < 0)
+            {
+              start = y;
+              open  = line[x];
+            }
+        }
+
+      if (start >= 0)
+        add_seg (segs,
+                 edge_rect->x + x, edge_rect->y + start,
+                 edge_rect->x + x, edge_rect->y + rect->height + 1,
+                 open);
+    }
+
+  *n_segs = segs->len;
+
+  return (GimpBoundSeg *) g_array_free (segs, segs->len == 0);
+}
@@ -51,9 +51,15 @@ static gchar       * gimp_pattern_get_description   (GimpViewable         *viewa
 
 static const gchar * gimp_pattern_get_extension     (GimpData             *data);
 static GimpData    * gimp_pattern_duplicate         (GimpData             *data);
+static gboolean      gimp_pattern_load_contents     (GimpData             *data,
+                                                     GError              **error);
 
 static gchar       * gimp_pattern_get_checksum      (GimpTagged           *tagged);
 
+static GimpTempBuf * gimp_pattern_copy_corner       (GimpTempBuf          *src,
+                                                     gint                  width,
+                                                     gint                  height);
+
 
 G_DEFINE_TYPE_WITH_CODE (GimpPattern, gimp_pattern, GIMP_TYPE_DATA,
                          G_IMPLEMENT_INTERFACE (GIMP_TYPE_TAGGED,
@@ -81,6 +87,7 @@ gimp_pattern_class_init (GimpPatternClass *klass)
 
   data_class->get_extension        = gimp_pattern_get_extension;
   data_class->duplicate            = gimp_pattern_duplicate;
+  data_class->load_contents        = gimp_pattern_load_contents;
 }
 
 static void
@@ -129,6 +136,9 @@ gimp_pattern_get_size (GimpViewable *viewable,
 {
   GimpPattern *pattern = GIMP_PATTERN (viewable);
 
+  if (gimp_data_get_stub_size (GIMP_DATA (pattern), width, height))
+    return TRUE;
+
   *width  = gimp_temp_buf_get_width  (pattern->mask);
   *height = gimp_temp_buf_get_height (pattern->mask);
 
@@ -142,28 +152,29 @@ gimp_pattern_get_new_preview (GimpViewable *viewable,
                               gint          height)
 {
   GimpPattern *pattern = GIMP_PATTERN (viewable);
-  GimpTempBuf *temp_buf;
-  GeglBuffer  *src_buffer;
-  GeglBuffer  *dest_buffer;
-  gint         copy_width;
-  gint         copy_height;
+  GimpTempBuf *preview = gimp_data_get_stub_preview (GIMP_DATA (pattern));
 
-  copy_width  = MIN (width,  gimp_temp_buf_get_width  (pattern->mask));
-  copy_height = MIN (height, gimp_temp_buf_get_height (pattern->mask));
+  /*  the preview is the pattern's top left corner, so the one in the
+   *  data factory's index will do if it contains the requested one
+   */
+  if (preview)
+    {
+      gint pattern_width;
+      gint pattern_height;
 
-  temp_buf = gimp_temp_buf_new (copy_width, copy_height,
-                                gimp_temp_buf_get_format (pattern->mask));
+      gimp_data_get_stub_size (GIMP_DATA (pattern),
+                               &pattern_width, &pattern_height);
 
-  src_buffer  = gimp_temp_buf_create_buffer (pattern->mask);
-  dest_buffer = gimp_temp_buf_create_buffer (temp_buf);
-
-  gegl_buffer_copy (src_buffer,  GEGL_RECTANGLE (0, 0, copy_width, copy_height),
-                    dest_buffer, GEGL_RECTANGLE (0, 0, 0, 0));
+      if (MIN (width,  pattern_width)  <= gimp_temp_buf_get_width  (preview) &&
+          MIN (height, pattern_height) <= gimp_temp_buf_get_height (preview))
+        {
+          return gimp_pattern_copy_corner (preview, width, height);
+        }
+    }
 
-  g_object_unref (src_buffer);
-  g_object_unref (dest_buffer);
+  gimp_data_ensure_loaded (GIMP_DATA (pattern));
 
-  return temp_buf;
+  return gimp_pattern_copy_corner (pattern->mask, width, height);
 }
 
 static gchar *
@@ -171,11 +182,14 @@ gimp_pattern_get_description (GimpViewable  *viewable,
                               gchar        **tooltip)
 {
   GimpPattern *pattern = GIMP_PATTERN (viewable);
+  gint         width;
+  gint         height;
+
+  gimp_pattern_get_size (viewable, &width, &height);
 
   return g_strdup_printf ("%s (%d × %d)",
                           gimp_object_get_name (pattern),
-                          gimp_temp_buf_get_width  (pattern->mask),
-                          gimp_temp_buf_get_height (pattern->mask));
+                          width, height);
 }
 
 static const gchar *
@@ -194,12 +208,44 @@ gimp_pattern_duplicate (GimpData *data)
   return GIMP_DATA (pattern);
 }
 
+static gboolean
+gimp_pattern_load_contents (GimpData  *data,
+                            GError   **error)
+{
+  GimpPattern *pattern = GIMP_PATTERN (data);
+  GimpPattern *loaded;
+  GList       *list;
+
+  list = gimp_pattern_load (NULL, gimp_data_get_filename (data), error);
+
+  if (! list)
+    {
+      /*  keep the pattern usable, with a single transparent pixel  */
+      pattern->mask = gimp_temp_buf_new (1, 1, babl_format ("R'G'B'A u8"));
+      gimp_temp_buf_data_clear (pattern->mask);
+
+      return FALSE;
+    }
+
+  loaded = list->data;
+
+  pattern->mask = loaded->mask;
+  loaded->mask  = NULL;
+
+  g_list_free_full (list, (GDestroyNotify) g_object_unref);
+
+  return TRUE;
+}
+
 static gchar *
 gimp_pattern_get_checksum (GimpTagged *tagged)
 {
   GimpPattern *pattern         = GIMP_PATTERN (tagged);
   gchar       *checksum_string = NULL;
 
+  if (gimp_data_is_stub (GIMP_DATA (pattern)))
+    return g_strdup (gimp_data_get_stub_checksum (GIMP_DATA (pattern)));
+
   if (pattern->mask)
     {
       GChecksum *checksum = g_checksum_new (G_CHECKSUM_MD5);
@@ -215,6 +261,35 @@ gimp_pattern_get_checksum (GimpTagged *tagged)
   return checksum_string;
 }
 
+static GimpTempBuf *
+gimp_pattern_copy_corner (GimpTempBuf *src,
+                          gint         width,
+                          gint         height)
+{
+  GimpTempBuf *temp_buf;
+  GeglBuffer  *src_buffer;
+  GeglBuffer  *dest_buffer;
+  gint         copy_width;
+  gint         copy_height;
+
+  copy_width  = MIN (width,  gimp_temp_buf_get_width  (src));
+  copy_height = MIN (height, gimp_temp_buf_get_height (src));
+
+  temp_buf = gimp_temp_buf_new (copy_width, copy_height,
+                                gimp_temp_buf_get_format (src));
+
+  src_buffer  = gimp_temp_buf_create_buffer (src);
+  dest_buffer = gimp_temp_buf_create_buffer (temp_buf);
+
+  gegl_buffer_copy (src_buffer,  GEGL_RECTANGLE (0, 0, copy_width, copy_height),
+                    dest_buffer, GEGL_RECTANGLE (0, 0, 0, 0));
+
+  g_object_unref (src_buffer);
+  g_object_unref (dest_buffer);
+
+  return temp_buf;
+}
+
 GimpData *
 gimp_pattern_new (GimpContext *context,
                   const gchar *name)
@@ -268,6 +343,8 @@ gimp_pattern_get_mask (const GimpPattern *pattern)
 {
   g_return_val_if_fail (GIMP_IS_PATTERN (pattern), NULL);
 
+  gimp_data_ensure_loaded (GIMP_DATA (pattern));
+
   return pattern->mask;
 }
 
@@ -276,5 +353,7 @@ gimp_pattern_create_buffer (const GimpPattern *pattern)
 {
   g_return_val_if_fail (GIMP_IS_PATTERN (pattern), NULL);
 
+  gimp_data_ensure_loaded (GIMP_DATA (pattern));
+
   return gimp_temp_buf_create_buffer (pattern->mask);
 }
@@ -44,6 +44,11 @@
 #define GIMP_PROJECTION_IDLE_CHUNK_WIDTH  256
 #define GIMP_PROJECTION_IDLE_CHUNK_HEIGHT 128
 
+/*  how long one idle callback may keep constructing chunks, in
+ *  microseconds, so input events and redraws still get through
+ */
+#define GIMP_PROJECTION_IDLE_TIME_LIMIT   10000
+
 
 enum
 {
@@ -52,6 +57,22 @@ enum
 };
 
 
+typedef struct _GimpProjectionChunk        GimpProjectionChunk;
+typedef struct _GimpProjectionPriorityRect GimpProjectionPriorityRect;
+
+struct _GimpProjectionChunk
+{
+  gint   cell;
+  gint64 priority;
+};
+
+struct _GimpProjectionPriorityRect
+{
+  GeglRectangle rect;
+  gint          level;
+};
+
+
 /*  local function prototypes  */
 
 static void   gimp_projection_pickable_iface_init (GimpPickableInterface  *iface);
@@ -83,8 +104,16 @@ static void        gimp_projection_add_update_area       (GimpProjection  *proj,
 static void        gimp_projection_flush_whenever        (GimpProjection  *proj,
                                                           gboolean         now);
 static void        gimp_projection_idle_render_init      (GimpProjection  *proj);
+static void        gimp_projection_idle_render_add_area  (GimpProjection  *proj,
+                                                          GimpArea        *area);
+static void        gimp_projection_idle_render_sort      (GimpProjection  *proj);
 static gboolean    gimp_projection_idle_render_callback  (gpointer         data);
-static gboolean    gimp_projection_idle_render_next_area (GimpProjection  *proj);
+static gboolean    gimp_projection_idle_render_iteration (GimpProjection  *proj);
+static gint64      gimp_projection_chunk_priority        (GimpProjection  *proj,
+                                                          const GeglRectangle *rect);
+static gint        gimp_projection_chunk_compare         (gconstpointer    a,
+                                                          gconstpointer    b);
+static void        gimp_projection_idle_render_clear     (GimpProjection  *proj);
 static void        gimp_projection_paint_area            (GimpProjection  *proj,
                                                           gboolean         now,
                                                           gint             x,
@@ -147,6 +176,17 @@ gimp_projection_class_init (GimpProjectionClass *klass)
 static void
 gimp_projection_init (GimpProjection *proj)
 {
+  proj->idle_render.chunks = g_hash_table_new_full (g_direct_hash,
+                                                    g_direct_equal,
+                                                    NULL,
+                                                    (GDestroyNotify) g_free);
+  proj->idle_render.queue  = g_array_new (FALSE, FALSE,
+                                          sizeof (GimpProjectionChunk));
+
+  proj->priority_rects = g_hash_table_new_full (g_direct_hash,
+                                                g_direct_equal,
+                                                NULL,
+                                                (GDestroyNotify) g_free);
 }
 
 static void
@@ -175,8 +215,23 @@ gimp_projection_finalize (GObject *object)
   gimp_area_list_free (proj->update_areas);
   proj->update_areas = NULL;
 
-  gimp_area_list_free (proj->idle_render.update_areas);
-  proj->idle_render.update_areas = NULL;
+  if (proj->idle_render.chunks)
+    {
+      g_hash_table_unref (proj->idle_render.chunks);
+      proj->idle_render.chunks = NULL;
+    }
+
+  if (proj->idle_render.queue)
+    {
+      g_array_free (proj->idle_render.queue, TRUE);
+      proj->idle_render.queue = NULL;
+    }
+
+  if (proj->priority_rects)
+    {
+      g_hash_table_unref (proj->priority_rects);
+      proj->priority_rects = NULL;
+    }
 
   gimp_projection_free_buffer (proj);
 
@@ -389,6 +444,67 @@ gimp_projection_finish_draw (GimpProjection *proj)
     }
 }
 
+/**
+ * gimp_projection_set_priority_rect:
+ * @proj:   a #GimpProjection
+ * @owner:  the object on whose behalf the rectangle is set
+ * @x:      x coordinate of the rectangle, in image coordinates
+ * @y:      y coordinate of the rectangle, in image coordinates
+ * @width:  width of the rectangle
+ * @height: height of the rectangle
+ * @scale:  the scale at which the rectangle is being looked at
+ *
+ * Sets @owner's visible part of the projection.  The idle renderer
+ * constructs chunks closest to any of the visible rectangles first,
+ * and at the pyramid level matching the largest of their scales.
+ **/
+void
+gimp_projection_set_priority_rect (GimpProjection *proj,
+                                   gpointer        owner,
+                                   gint            x,
+                                   gint            y,
+                                   gint            width,
+                                   gint            height,
+                                   gdouble         scale)
+{
+  GimpProjectionPriorityRect *priority_rect;
+
+  g_return_if_fail (GIMP_IS_PROJECTION (proj));
+  g_return_if_fail (owner != NULL);
+
+  priority_rect = g_hash_table_lookup (proj->priority_rects, owner);
+
+  if (! priority_rect)
+    {
+      priority_rect = g_new0 (GimpProjectionPriorityRect, 1);
+
+      g_hash_table_insert (proj->priority_rects, owner, priority_rect);
+    }
+
+  gegl_rectangle_set (&priority_rect->rect, x, y, width, height);
+
+  priority_rect->level = 0;
+
+  while (scale > 0.0 && scale <= 0.5)
+    {
+      priority_rect->level++;
+      scale *= 2.0;
+    }
+
+  proj->idle_render.queue_dirty = TRUE;
+}
+
+void
+gimp_projection_unset_priority_rect (GimpProjection *proj,
+                                     gpointer        owner)
+{
+  g_return_if_fail (GIMP_IS_PROJECTION (proj));
+  g_return_if_fail (owner != NULL);
+
+  if (g_hash_table_remove (proj->priority_rects, owner))
+    proj->idle_render.queue_dirty = TRUE;
+}
+
 
 /*  private functions  */
 
@@ -492,54 +608,120 @@ gimp_projection_idle_render_init (GimpProjection *proj)
   GSList *list;
 
   /* We need to merge the IdleRender's and the GimpProjection's update_areas
-   * list to keep track of which of the updates have been flushed and hence
+   * to keep track of which of the updates have been flushed and hence
    * need to be drawn.
    */
   for (list = proj->update_areas; list; list = g_slist_next (list))
-    {
-      GimpArea *area = list->data;
-
-      proj->idle_render.update_areas =
-        gimp_area_list_process (proj->idle_render.update_areas,
-                                gimp_area_new (area->x1, area->y1,
-                                               area->x2, area->y2));
-    }
+    gimp_projection_idle_render_add_area (proj, list->data);
 
-  /* If an idlerender was already running, merge the remainder of its
-   * unrendered area with the update_areas list, and make it start work
-   * on the next unrendered area in the list.
-   */
-  if (proj->idle_render.idle_id)
+  if (! proj->idle_render.idle_id &&
+      g_hash_table_size (proj->idle_render.chunks) > 0)
     {
-      GimpArea *area =
-        gimp_area_new (proj->idle_render.base_x,
-                       proj->idle_render.y,
-                       proj->idle_render.base_x + proj->idle_render.width,
-                       proj->idle_render.y + (proj->idle_render.height -
-                                               (proj->idle_render.y -
-                                                proj->idle_render.base_y)));
-
-      proj->idle_render.update_areas =
-        gimp_area_list_process (proj->idle_render.update_areas, area);
-
-      gimp_projection_idle_render_next_area (proj);
+      proj->idle_render.idle_id =
+        g_idle_add_full (GIMP_PROJECTION_IDLE_PRIORITY,
+                         gimp_projection_idle_render_callback, proj,
+                         NULL);
     }
-  else
+}
+
+/*  Invalidates @area and splits it along the fixed chunk grid, merging
+ *  the pieces into the pending chunks, so an area that is flushed
+ *  several times is still rendered only once.  Invalidating all of
+ *  the area right away, instead of chunk by chunk, makes sure a tile
+ *  of a zoomed-out pyramid level that spans several chunks is only
+ *  constructed once too.
+ */
+static void
+gimp_projection_idle_render_add_area (GimpProjection *proj,
+                                      GimpArea       *area)
+{
+  GeglRectangle area_rect;
+  gint          width, height;
+  gint          n_cols;
+  gint          cell_x1, cell_y1;
+  gint          cell_x2, cell_y2;
+  gint          cell_x, cell_y;
+
+  if (area->x1 >= area->x2 || area->y1 >= area->y2)
+    return;
+
+  gimp_projectable_get_size (proj->projectable, &width, &height);
+
+  n_cols = (width + GIMP_PROJECTION_IDLE_CHUNK_WIDTH - 1) /
+           GIMP_PROJECTION_IDLE_CHUNK_WIDTH;
+
+  gegl_rectangle_set (&area_rect,
+                      area->x1, area->y1,
+                      area->x2 - area->x1, area->y2 - area->y1);
+
+  gimp_projection_invalidate (proj,
+                              area_rect.x, area_rect.y,
+                              area_rect.width, area_rect.height);
+
+  cell_x1 = area->x1 / GIMP_PROJECTION_IDLE_CHUNK_WIDTH;
+  cell_y1 = area->y1 / GIMP_PROJECTION_IDLE_CHUNK_HEIGHT;
+  cell_x2 = (area->x2 - 1) / GIMP_PROJECTION_IDLE_CHUNK_WIDTH;
+  cell_y2 = (area->y2 - 1) / GIMP_PROJECTION_IDLE_CHUNK_HEIGHT;
+
+  for (cell_y = cell_y1; cell_y <= cell_y2; cell_y++)
     {
-      if (proj->idle_render.update_areas == NULL)
+      for (cell_x = cell_x1; cell_x <= cell_x2; cell_x++)
         {
-          g_warning ("%s: wanted to start idle render with no update_areas",
-                     G_STRFUNC);
-          return;
+          GeglRectangle  rect;
+          GeglRectangle *chunk;
+          gpointer       key;
+
+          gegl_rectangle_set (&rect,
+                              cell_x * GIMP_PROJECTION_IDLE_CHUNK_WIDTH,
+                              cell_y * GIMP_PROJECTION_IDLE_CHUNK_HEIGHT,
+                              GIMP_PROJECTION_IDLE_CHUNK_WIDTH,
+                              GIMP_PROJECTION_IDLE_CHUNK_HEIGHT);
+
+          if (! gegl_rectangle_intersect (&rect, &rect, &area_rect))
+            continue;
+
+          key   = GINT_TO_POINTER (cell_y * n_cols + cell_x + 1);
+          chunk = g_hash_table_lookup (proj->idle_render.chunks, key);
+
+          if (chunk)
+            {
+              gegl_rectangle_bounding_box (chunk, chunk, &rect);
+            }
+          else
+            {
+              g_hash_table_insert (proj->idle_render.chunks, key,
+                                   g_memdup (&rect, sizeof (GeglRectangle)));
+
+              proj->idle_render.queue_dirty = TRUE;
+            }
         }
+    }
+}
 
-      gimp_projection_idle_render_next_area (proj);
+static void
+gimp_projection_idle_render_sort (GimpProjection *proj)
+{
+  GHashTableIter iter;
+  gpointer       key;
+  gpointer       value;
 
-      proj->idle_render.idle_id =
-        g_idle_add_full (GIMP_PROJECTION_IDLE_PRIORITY,
-                         gimp_projection_idle_render_callback, proj,
-                         NULL);
+  g_array_set_size (proj->idle_render.queue, 0);
+
+  g_hash_table_iter_init (&iter, proj->idle_render.chunks);
+
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      GimpProjectionChunk chunk;
+
+      chunk.cell     = GPOINTER_TO_INT (key);
+      chunk.priority = gimp_projection_chunk_priority (proj, value);
+
+      g_array_append_val (proj->idle_render.queue, chunk);
     }
+
+  g_array_sort (proj->idle_render.queue, gimp_projection_chunk_compare);
+
+  proj->idle_render.queue_dirty = FALSE;
 }
 
 /* Unless specified otherwise, projection re-rendering is organised by
@@ -547,88 +729,187 @@ gimp_projection_idle_render_init (GimpProjection *proj)
  * them into bite-sized chunks which are chewed on in a low- priority
  * idle thread.  This greatly improves responsiveness for many GIMP
  * operations.  -- Adam
+ *
+ * Each iteration takes the chunk closest to what's visible in any
+ * display.  Chunks are constructed on the main thread, GEGL runs with
+ * a single thread here.  One callback constructs chunks until it ran
+ * for GIMP_PROJECTION_IDLE_TIME_LIMIT, instead of returning to the
+ * main loop after every single one.
  */
 static gboolean
 gimp_projection_idle_render_callback (gpointer data)
 {
-  GimpProjection *proj = data;
-  gint            workx, worky;
-  gint            workw, workh;
+  GimpProjection *proj  = data;
+  gint64          start = g_get_monotonic_time ();
 
-  workw = GIMP_PROJECTION_IDLE_CHUNK_WIDTH;
-  workh = GIMP_PROJECTION_IDLE_CHUNK_HEIGHT;
-  workx = proj->idle_render.x;
-  worky = proj->idle_render.y;
-
-  if (workx + workw > proj->idle_render.base_x + proj->idle_render.width)
+  while (gimp_projection_idle_render_iteration (proj))
     {
-      workw = proj->idle_render.base_x + proj->idle_render.width - workx;
+      if (g_get_monotonic_time () - start >= GIMP_PROJECTION_IDLE_TIME_LIMIT)
+        {
+          /* Still work to do. */
+          return TRUE;
+        }
     }
 
-  if (worky + workh > proj->idle_render.base_y + proj->idle_render.height)
+  /* FINISHED */
+  proj->idle_render.idle_id = 0;
+
+  if (proj->invalidate_preview)
     {
-      workh = proj->idle_render.base_y + proj->idle_render.height - worky;
+      /* invalidate the preview here since it is constructed from
+       * the projection
+       */
+      proj->invalidate_preview = FALSE;
+
+      gimp_projectable_invalidate_preview (proj->projectable);
     }
 
-  gimp_projection_paint_area (proj, TRUE /* sic! */,
-                              workx, worky, workw, workh);
+  return FALSE;
+}
 
-  proj->idle_render.x += GIMP_PROJECTION_IDLE_CHUNK_WIDTH;
+static gboolean
+gimp_projection_idle_render_iteration (GimpProjection *proj)
+{
+  GeglRectangle rect;
+  gboolean      found = FALSE;
+  gint          off_x, off_y;
+
+  if (proj->idle_render.queue_dirty)
+    gimp_projection_idle_render_sort (proj);
 
-  if (proj->idle_render.x >=
-      proj->idle_render.base_x + proj->idle_render.width)
+  while (! found && proj->idle_render.queue->len > 0)
     {
-      proj->idle_render.x = proj->idle_render.base_x;
-      proj->idle_render.y += GIMP_PROJECTION_IDLE_CHUNK_HEIGHT;
+      GimpProjectionChunk *chunk;
+      GeglRectangle       *chunk_rect;
+      gpointer             key;
+
+      chunk = &g_array_index (proj->idle_render.queue, GimpProjectionChunk,
+                              proj->idle_render.queue->len - 1);
+
+      key        = GINT_TO_POINTER (chunk->cell);
+      chunk_rect = g_hash_table_lookup (proj->idle_render.chunks, key);
 
-      if (proj->idle_render.y >=
-          proj->idle_render.base_y + proj->idle_render.height)
+      if (chunk_rect)
         {
-          if (! gimp_projection_idle_render_next_area (proj))
-            {
-              /* FINISHED */
-              proj->idle_render.idle_id = 0;
+          rect  = *chunk_rect;
+          found = TRUE;
 
-              if (proj->invalidate_preview)
-                {
-                  /* invalidate the preview here since it is constructed from
-                   * the projection
-                   */
-                  proj->invalidate_preview = FALSE;
+          g_hash_table_remove (proj->idle_render.chunks, key);
+        }
 
-                  gimp_projectable_invalidate_preview (proj->projectable);
-                }
+      g_array_set_size (proj->idle_render.queue,
+                        proj->idle_render.queue->len - 1);
+    }
 
-              return FALSE;
-            }
+  if (! found)
+    return FALSE;
+
+  if (proj->validate_handler)
+    {
+      GHashTableIter iter;
+      gpointer       value;
+      gint           level = -1;
+
+      /*  construct the most detailed level any display looks at  */
+      g_hash_table_iter_init (&iter, proj->priority_rects);
+
+      while (g_hash_table_iter_next (&iter, NULL, &value))
+        {
+          GimpProjectionPriorityRect *priority_rect = value;
+
+          if (level < 0 || priority_rect->level < level)
+            level = priority_rect->level;
         }
+
+      gimp_tile_handler_projection_validate_area (proj->validate_handler,
+                                                  rect.x, rect.y,
+                                                  rect.width, rect.height,
+                                                  MAX (level, 0));
     }
 
-  /* Still work to do. */
-  return TRUE;
+  gimp_projectable_get_offset (proj->projectable, &off_x, &off_y);
+
+  /*  add the projectable's offsets because the list of update areas
+   *  is in tile-pyramid coordinates, but our external API is always
+   *  in terms of image coordinates.
+   */
+  g_signal_emit (proj, projection_signals[UPDATE], 0,
+                 TRUE, /* sic! */
+                 rect.x + off_x,
+                 rect.y + off_y,
+                 rect.width,
+                 rect.height);
+
+  return g_hash_table_size (proj->idle_render.chunks) > 0;
 }
 
-static gboolean
-gimp_projection_idle_render_next_area (GimpProjection *proj)
+static gint64
+gimp_projection_chunk_priority (GimpProjection      *proj,
+                                const GeglRectangle *rect)
 {
-  GimpArea *area;
+  GHashTableIter iter;
+  gpointer       value;
+  gint64         priority = G_MAXINT64;
+  gint           off_x, off_y;
 
-  if (! proj->idle_render.update_areas)
-    return FALSE;
+  /*  without any visible area, render top to bottom like we always did  */
+  if (g_hash_table_size (proj->priority_rects) == 0)
+    return (gint64) rect->y * G_MAXINT + rect->x;
+
+  gimp_projectable_get_offset (proj->projectable, &off_x, &off_y);
 
-  area = proj->idle_render.update_areas->data;
+  g_hash_table_iter_init (&iter, proj->priority_rects);
 
-  proj->idle_render.update_areas =
-    g_slist_remove (proj->idle_render.update_areas, area);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+      GimpProjectionPriorityRect *priority_rect = value;
+      gint64                      x1, y1, x2, y2;
+      gint64                      dx, dy;
 
-  proj->idle_render.x      = proj->idle_render.base_x = area->x1;
-  proj->idle_render.y      = proj->idle_render.base_y = area->y1;
-  proj->idle_render.width  = area->x2 - area->x1;
-  proj->idle_render.height = area->y2 - area->y1;
+      x1 = priority_rect->rect.x - off_x;
+      y1 = priority_rect->rect.y - off_y;
+      x2 = x1 + priority_rect->rect.width;
+      y2 = y1 + priority_rect->rect.height;
 
-  gimp_area_free (area);
+      dx = MAX (0, MAX (x1 - (rect->x + rect->width),  rect->x - x2));
+      dy = MAX (0, MAX (y1 - (rect->y + rect->height), rect->y - y2));
 
-  return TRUE;
+      priority = MIN (priority, dx * dx + dy * dy);
+    }
+
+  return priority;
+}
+
+/*  sorts by descending priority value, so the chunks to render first
+ *  can be popped off the queue's end
+ */
+static gint
+gimp_projection_chunk_compare (gconstpointer a,
+                               gconstpointer b)
+{
+  const GimpProjectionChunk *chunk_a = a;
+  const GimpProjectionChunk *chunk_b = b;
+
+  if (chunk_a->priority > chunk_b->priority)
+    return -1;
+  else if (chunk_a->priority < chunk_b->priority)
+    return 1;
+
+  return 0;
+}
+
+static void
+gimp_projection_idle_render_clear (GimpProjection *proj)
+{
+  if (proj->idle_render.idle_id)
+    {
+      g_source_remove (proj->idle_render.idle_id);
+      proj->idle_render.idle_id = 0;
+    }
+
+  g_hash_table_remove_all (proj->idle_render.chunks);
+  g_array_set_size (proj->idle_render.queue, 0);
+  proj->idle_render.queue_dirty = FALSE;
 }
 
 static void
@@ -710,11 +991,7 @@ gimp_projection_projectable_changed (GimpProjectable *projectable,
   gint off_x, off_y;
   gint width, height;
 
-  if (proj->idle_render.idle_id)
-    {
-      g_source_remove (proj->idle_render.idle_id);
-      proj->idle_render.idle_id = 0;
-    }
+  gimp_projection_idle_render_clear (proj);
 
   gimp_area_list_free (proj->update_areas);
   proj->update_areas = NULL;
@@ -26,14 +26,10 @@ typedef struct _GimpProjectionIdleRender GimpProjectionIdleRender;
 
 struct _GimpProjectionIdleRender
 {
-  gint    width;
-  gint    height;
-  gint    x;
-  gint    y;
-  gint    base_x;
-  gint    base_y;
-  guint   idle_id;
-  GSList *update_areas;   /*  flushed update areas */
+  guint       idle_id;
+  GHashTable *chunks;       /*  flushed update areas, by chunk cell  */
+  GArray     *queue;        /*  chunk cells, by descending priority  */
+  gboolean    queue_dirty;
 };
 
 
@@ -59,6 +55,7 @@ struct _GimpProjection
 
   GSList                   *update_areas;
   GimpProjectionIdleRender  idle_render;
+  GHashTable               *priority_rects;
 
   gboolean                  invalidate_preview;
 };
@@ -76,18 +73,28 @@ struct _GimpProjectionClass
 };
 
 
-GType            gimp_projection_get_type         (void) G_GNUC_CONST;
+GType            gimp_projection_get_type            (void) G_GNUC_CONST;
 
-GimpProjection * gimp_projection_new              (GimpProjectable   *projectable);
+GimpProjection * gimp_projection_new                 (GimpProjectable   *projectable);
 
-void             gimp_projection_flush            (GimpProjection    *proj);
-void             gimp_projection_flush_now        (GimpProjection    *proj);
-void             gimp_projection_finish_draw      (GimpProjection    *proj);
+void             gimp_projection_flush               (GimpProjection    *proj);
+void             gimp_projection_flush_now           (GimpProjection    *proj);
+void             gimp_projection_finish_draw         (GimpProjection    *proj);
 
-gint64           gimp_projection_estimate_memsize (GimpImageBaseType  type,
-                                                   GimpPrecision      precision,
-                                                   gint               width,
-                                                   gint               height);
+void             gimp_projection_set_priority_rect   (GimpProjection    *proj,
+                                                      gpointer           owner,
+                                                      gint               x,
+                                                      gint               y,
+                                                      gint               width,
+                                                      gint               height,
+                                                      gdouble            scale);
+void             gimp_projection_unset_priority_rect (GimpProjection    *proj,
+                                                      gpointer           owner);
+
+gint64           gimp_projection_estimate_memsize    (GimpImageBaseType  type,
+                                                      GimpPrecision      precision,
+                                                      gint               width,
+                                                      gint               height);
 
 
 #endif /*  __GIMP_PROJECTION_H__  */
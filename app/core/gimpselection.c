@@ -25,6 +25,7 @@
 
 #include "gegl/gimp-babl.h"
 #include "gegl/gimp-gegl-apply-operation.h"
+#include "gegl/gimp-gegl-cow.h"
 
 #include "gimp.h"
 #include "gimp-edit.h"
@@ -733,9 +734,14 @@ gimp_selection_extract (GimpSelection *selection,
 
   src_buffer = gimp_pickable_get_buffer (pickable);
 
-  /*  Allocate the temp buffer  */
-  dest_buffer = gegl_buffer_new (GEGL_RECTANGLE (0, 0, x2 - x1, y2 - y1),
-                                 dest_format);
+  /*  Allocate the temp buffer, with its tiles lined up with the
+   *  source's, so unmasked tiles of the same format are shared
+   */
+  dest_buffer = gimp_gegl_buffer_new_aligned (src_buffer,
+                                              GEGL_RECTANGLE (x1, y1,
+                                                              x2 - x1,
+                                                              y2 - y1),
+                                              dest_format);
 
   /*  First, copy the pixels, possibly doing INDEXED->RGB and adding alpha  */
   gegl_buffer_copy (src_buffer, GEGL_RECTANGLE (x1, y1, x2 - x1, y2 - y1),
@@ -0,0 +1,945 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimpundotiles.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <gio/gio.h>
+#include <gegl.h>
+#include <zlib.h>
+
+#include "libgimpconfig/gimpconfig.h"
+
+#include "core-types.h"
+
+#include "config/gimpgeglconfig.h"
+
+#include "gimp.h"
+#include "gimp-utils.h"
+#include "gimpundotiles.h"
+
+#include "gimp-intl.h"
+
+
+/*  The pixels of a drawable undo are kept in TILE_SIZE x TILE_SIZE
+ *  tiles.  Tiles start out raw, a background thread compresses them
+ *  with zlib after grouping their bytes by position in the pixel,
+ *  which makes high bit depth pixels compress a lot better.
+ *
+ *  When the undo memory is exhausted, gimp_image_undo_free_space()
+ *  moves the tiles of the oldest steps to a swap file instead of
+ *  dropping the steps right away.
+ *
+ *  Tiles that were not touched by the operation are not stored at all
+ *  if gimp_undo_tiles_new() is told which areas were, they are taken
+ *  from the drawable when the undo is popped, it still has the same
+ *  pixels there.
+ */
+
+#define TILE_SIZE         64
+#define COMPRESSION_LEVEL 1    /* fast, most of the gain is from shuffling */
+
+
+typedef enum
+{
+  TILE_EMPTY,   /*  not stored                               */
+  TILE_RAW,     /*  pixels in data, not compressed yet       */
+  TILE_PACKED,  /*  pixels in data, compressed if it helped  */
+  TILE_SWAPPED  /*  pixels in the swap file                  */
+} TileState;
+
+typedef struct _Tile      Tile;
+typedef struct _SwapBlock SwapBlock;
+
+struct _Tile
+{
+  TileState  state;
+  gboolean   deflated;  /*  the data is zlib compressed          */
+  guchar    *data;
+  gsize      size;      /*  size of data or of the block in swap */
+  goffset    offset;    /*  position in the swap file            */
+};
+
+struct _GimpUndoTiles
+{
+  gint        ref_count;
+
+  GMutex      mutex;
+  const Babl *format;
+  gint        bpp;
+  gint        width;
+  gint        height;
+  gint        n_cols;
+  gint        n_rows;
+  Tile       *tiles;
+  gint64      memsize;  /*  bytes of tile data in memory         */
+  gboolean    queued;   /*  a compression job is pending         */
+};
+
+struct _SwapBlock
+{
+  goffset offset;
+  gsize   size;
+};
+
+
+/*  local function prototypes  */
+
+static void      gimp_undo_tiles_compress_func (gpointer       data,
+                                                gpointer       user_data);
+
+static void      gimp_undo_tiles_get_rect      (GimpUndoTiles *tiles,
+                                                gint           i,
+                                                GeglRectangle *rect);
+static gboolean *gimp_undo_tiles_get_keep      (GimpUndoTiles       *tiles,
+                                                const GeglRectangle *rects,
+                                                gint                 n_rects);
+static void      gimp_undo_tiles_read_buffer   (GimpUndoTiles *tiles,
+                                                GeglBuffer    *buffer);
+static void      gimp_undo_tiles_queue         (GimpUndoTiles *tiles);
+static void      gimp_undo_tiles_clear_tile    (GimpUndoTiles *tiles,
+                                                Tile          *tile);
+static void      gimp_undo_tiles_pack_tile     (GimpUndoTiles *tiles,
+                                                Tile          *tile);
+static gboolean  gimp_undo_tiles_unpack_tile   (GimpUndoTiles *tiles,
+                                                Tile          *tile,
+                                                guchar        *dest,
+                                                gsize          dest_size,
+                                                GError       **error);
+
+static gboolean  gimp_undo_tiles_swap_open     (GError       **error);
+static goffset   gimp_undo_tiles_swap_write    (const guchar  *data,
+                                                gsize          size,
+                                                GError       **error);
+static gboolean  gimp_undo_tiles_swap_read     (goffset        offset,
+                                                guchar        *data,
+                                                gsize          size,
+                                                GError       **error);
+static void      gimp_undo_tiles_swap_free     (goffset        offset,
+                                                gsize          size);
+
+
+/*  local variables  */
+
+static GThreadPool   *undo_tiles_pool     = NULL;
+static gchar         *undo_tiles_swap_dir = NULL;
+
+static GMutex         swap_mutex;
+static GFile         *swap_file           = NULL;
+static GFileIOStream *swap_stream         = NULL;
+static goffset        swap_size           = 0;
+static GList         *swap_holes          = NULL;  /*  sorted by offset  */
+static gboolean       swap_failed         = FALSE;
+
+
+/*  public functions  */
+
+void
+gimp_undo_tiles_init (Gimp *gimp)
+{
+  GimpGeglConfig *config;
+
+  g_return_if_fail (GIMP_IS_GIMP (gimp));
+
+  config = GIMP_GEGL_CONFIG (gimp->config);
+
+  if (config->swap_path)
+    undo_tiles_swap_dir = gimp_config_path_expand (config->swap_path,
+                                                   TRUE, NULL);
+
+  undo_tiles_pool = g_thread_pool_new (gimp_undo_tiles_compress_func, NULL,
+                                       1, FALSE, NULL);
+}
+
+void
+gimp_undo_tiles_exit (Gimp *gimp)
+{
+  g_return_if_fail (GIMP_IS_GIMP (gimp));
+
+  if (undo_tiles_pool)
+    {
+      g_thread_pool_free (undo_tiles_pool, FALSE, TRUE);
+      undo_tiles_pool = NULL;
+    }
+
+  g_mutex_lock (&swap_mutex);
+
+  if (swap_stream)
+    {
+      g_io_stream_close (G_IO_STREAM (swap_stream), NULL, NULL);
+      g_object_unref (swap_stream);
+      swap_stream = NULL;
+
+      g_file_delete (swap_file, NULL, NULL);
+    }
+
+  if (swap_file)
+    {
+      g_object_unref (swap_file);
+      swap_file = NULL;
+    }
+
+  g_list_free_full (swap_holes, (GDestroyNotify) g_free);
+  swap_holes  = NULL;
+  swap_size   = 0;
+  swap_failed = FALSE;
+
+  g_mutex_unlock (&swap_mutex);
+
+  g_free (undo_tiles_swap_dir);
+  undo_tiles_swap_dir = NULL;
+}
+
+/*  stores the pixels of @buffer, starting at the top left of its
+ *  extent.  If @rects is not NULL, only the tiles intersecting any
+ *  of @rects, given relative to the top left of the extent, are
+ *  read and stored
+ */
+GimpUndoTiles *
+gimp_undo_tiles_new (GeglBuffer          *buffer,
+                     const GeglRectangle *rects,
+                     gint                 n_rects)
+{
+  GimpUndoTiles *tiles;
+  gboolean      *keep = NULL;
+  gint           n_tiles;
+  gint           i;
+
+  g_return_val_if_fail (GEGL_IS_BUFFER (buffer), NULL);
+  g_return_val_if_fail (rects != NULL || n_rects == 0, NULL);
+
+  tiles = g_slice_new0 (GimpUndoTiles);
+
+  tiles->ref_count = 1;
+
+  g_mutex_init (&tiles->mutex);
+
+  tiles->format = gegl_buffer_get_format (buffer);
+  tiles->bpp    = babl_format_get_bytes_per_pixel (tiles->format);
+  tiles->width  = gegl_buffer_get_width  (buffer);
+  tiles->height = gegl_buffer_get_height (buffer);
+  tiles->n_cols = (tiles->width  + TILE_SIZE - 1) / TILE_SIZE;
+  tiles->n_rows = (tiles->height + TILE_SIZE - 1) / TILE_SIZE;
+
+  n_tiles = tiles->n_cols * tiles->n_rows;
+
+  tiles->tiles = g_new0 (Tile, n_tiles);
+
+  if (rects)
+    keep = gimp_undo_tiles_get_keep (tiles, rects, n_rects);
+
+  for (i = 0; i < n_tiles; i++)
+    tiles->tiles[i].state = (! keep || keep[i]) ? TILE_RAW : TILE_EMPTY;
+
+  g_free (keep);
+
+  g_mutex_lock (&tiles->mutex);
+  gimp_undo_tiles_read_buffer (tiles, buffer);
+  g_mutex_unlock (&tiles->mutex);
+
+  return tiles;
+}
+
+GimpUndoTiles *
+gimp_undo_tiles_ref (GimpUndoTiles *tiles)
+{
+  g_return_val_if_fail (tiles != NULL, NULL);
+
+  g_atomic_int_inc (&tiles->ref_count);
+
+  return tiles;
+}
+
+void
+gimp_undo_tiles_unref (GimpUndoTiles *tiles)
+{
+  g_return_if_fail (tiles != NULL);
+  g_return_if_fail (tiles->ref_count > 0);
+
+  if (g_atomic_int_dec_and_test (&tiles->ref_count))
+    {
+      gint n_tiles = tiles->n_cols * tiles->n_rows;
+      gint i;
+
+      for (i = 0; i < n_tiles; i++)
+        gimp_undo_tiles_clear_tile (tiles, &tiles->tiles[i]);
+
+      g_free (tiles->tiles);
+
+      g_mutex_clear (&tiles->mutex);
+
+      g_slice_free (GimpUndoTiles, tiles);
+    }
+}
+
+gint
+gimp_undo_tiles_get_width (GimpUndoTiles *tiles)
+{
+  g_return_val_if_fail (tiles != NULL, 0);
+
+  return tiles->width;
+}
+
+gint
+gimp_undo_tiles_get_height (GimpUndoTiles *tiles)
+{
+  g_return_val_if_fail (tiles != NULL, 0);
+
+  return tiles->height;
+}
+
+/*  returns a new buffer with the stored pixels, the pixels of
+ *  dropped tiles are copied from @background at @x, @y.  Returns
+ *  NULL if a tile can't be restored.
+ */
+GeglBuffer *
+gimp_undo_tiles_get_buffer (GimpUndoTiles  *tiles,
+                            GeglBuffer     *background,
+                            gint            x,
+                            gint            y,
+                            GError        **error)
+{
+  GeglBuffer *buffer;
+  guchar     *pixels;
+  gint        n_tiles;
+  gint        i;
+
+  g_return_val_if_fail (tiles != NULL, NULL);
+  g_return_val_if_fail (GEGL_IS_BUFFER (background), NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  buffer = gegl_buffer_new (GEGL_RECTANGLE (0, 0, tiles->width, tiles->height),
+                            tiles->format);
+
+  n_tiles = tiles->n_cols * tiles->n_rows;
+
+  pixels = g_malloc (TILE_SIZE * TILE_SIZE * tiles->bpp);
+
+  g_mutex_lock (&tiles->mutex);
+
+  for (i = 0; i < n_tiles; i++)
+    {
+      if (tiles->tiles[i].state == TILE_EMPTY)
+        {
+          gegl_buffer_copy (background,
+                            GEGL_RECTANGLE (x, y,
+                                            tiles->width, tiles->height),
+                            buffer,
+                            GEGL_RECTANGLE (0, 0, 0, 0));
+          break;
+        }
+    }
+
+  for (i = 0; i < n_tiles; i++)
+    {
+      Tile          *tile = &tiles->tiles[i];
+      GeglRectangle  rect;
+
+      if (tile->state == TILE_EMPTY)
+        continue;
+
+      gimp_undo_tiles_get_rect (tiles, i, &rect);
+
+      if (! gimp_undo_tiles_unpack_tile (tiles, tile, pixels,
+                                         rect.width * rect.height * tiles->bpp,
+                                         error))
+        {
+          g_object_unref (buffer);
+          buffer = NULL;
+          break;
+        }
+
+      gegl_buffer_set (buffer, &rect, 0, tiles->format, pixels,
+                       GEGL_AUTO_ROWSTRIDE);
+    }
+
+  g_mutex_unlock (&tiles->mutex);
+
+  g_free (pixels);
+
+  return buffer;
+}
+
+/*  replaces the stored pixels by the ones in @buffer, the dropped
+ *  tiles stay dropped
+ */
+void
+gimp_undo_tiles_set_buffer (GimpUndoTiles *tiles,
+                            GeglBuffer    *buffer)
+{
+  g_return_if_fail (tiles != NULL);
+  g_return_if_fail (GEGL_IS_BUFFER (buffer));
+  g_return_if_fail (gegl_buffer_get_width  (buffer) == tiles->width &&
+                    gegl_buffer_get_height (buffer) == tiles->height);
+
+  g_mutex_lock (&tiles->mutex);
+  gimp_undo_tiles_read_buffer (tiles, buffer);
+  g_mutex_unlock (&tiles->mutex);
+}
+
+/*  moves all tiles to the swap file, returns FALSE if there was
+ *  nothing to move or the swap can't be written.  @error is only set
+ *  the first time writing the swap fails, later calls just return
+ *  FALSE.
+ */
+gboolean
+gimp_undo_tiles_swap_out (GimpUndoTiles  *tiles,
+                          GError        **error)
+{
+  gboolean swapped = FALSE;
+  gint     n_tiles;
+  gint     i;
+
+  g_return_val_if_fail (tiles != NULL, FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  n_tiles = tiles->n_cols * tiles->n_rows;
+
+  g_mutex_lock (&tiles->mutex);
+
+  for (i = 0; i < n_tiles; i++)
+    {
+      Tile    *tile = &tiles->tiles[i];
+      goffset  offset;
+
+      if (tile->state != TILE_RAW && tile->state != TILE_PACKED)
+        continue;
+
+      if (tile->state == TILE_RAW)
+        gimp_undo_tiles_pack_tile (tiles, tile);
+
+      offset = gimp_undo_tiles_swap_write (tile->data, tile->size, error);
+
+      if (offset < 0)
+        {
+          swapped = FALSE;
+          break;
+        }
+
+      g_free (tile->data);
+      tile->data = NULL;
+
+      tiles->memsize -= tile->size;
+
+      tile->state  = TILE_SWAPPED;
+      tile->offset = offset;
+
+      swapped = TRUE;
+    }
+
+  g_mutex_unlock (&tiles->mutex);
+
+  return swapped;
+}
+
+gint64
+gimp_undo_tiles_get_memsize (GimpUndoTiles *tiles)
+{
+  gint64 memsize;
+
+  if (! tiles)
+    return 0;
+
+  g_mutex_lock (&tiles->mutex);
+  memsize = tiles->memsize;
+  g_mutex_unlock (&tiles->mutex);
+
+  return (sizeof (GimpUndoTiles) +
+          sizeof (Tile) * tiles->n_cols * tiles->n_rows +
+          memsize);
+}
+
+
+/*  private functions  */
+
+static void
+gimp_undo_tiles_compress_func (gpointer data,
+                               gpointer user_data)
+{
+  GimpUndoTiles *tiles   = data;
+  gint           n_tiles = tiles->n_cols * tiles->n_rows;
+  gint           i;
+
+  g_mutex_lock (&tiles->mutex);
+
+  tiles->queued = FALSE;
+
+  for (i = 0; i < n_tiles; i++)
+    {
+      /*  don't bother if the undo is gone already  */
+      if (g_atomic_int_get (&tiles->ref_count) == 1)
+        break;
+
+      if (tiles->tiles[i].state == TILE_RAW)
+        {
+          gimp_undo_tiles_pack_tile (tiles, &tiles->tiles[i]);
+
+          /*  let the main thread in between tiles  */
+          g_mutex_unlock (&tiles->mutex);
+          g_mutex_lock (&tiles->mutex);
+        }
+    }
+
+  g_mutex_unlock (&tiles->mutex);
+
+  gimp_undo_tiles_unref (tiles);
+}
+
+static void
+gimp_undo_tiles_get_rect (GimpUndoTiles *tiles,
+                          gint           i,
+                          GeglRectangle *rect)
+{
+  rect->x      = (i % tiles->n_cols) * TILE_SIZE;
+  rect->y      = (i / tiles->n_cols) * TILE_SIZE;
+  rect->width  = MIN (TILE_SIZE, tiles->width  - rect->x);
+  rect->height = MIN (TILE_SIZE, tiles->height - rect->y);
+}
+
+/*  returns which tiles intersect any of @rects  */
+static gboolean *
+gimp_undo_tiles_get_keep (GimpUndoTiles       *tiles,
+                          const GeglRectangle *rects,
+                          gint                 n_rects)
+{
+  gboolean *keep = g_new0 (gboolean, tiles->n_cols * tiles->n_rows);
+  gint      i;
+
+  for (i = 0; i < n_rects; i++)
+    {
+      gint x1 = MAX (rects[i].x, 0);
+      gint y1 = MAX (rects[i].y, 0);
+      gint x2 = MIN (rects[i].x + rects[i].width,  tiles->width);
+      gint y2 = MIN (rects[i].y + rects[i].height, tiles->height);
+      gint col, row;
+
+      if (x1 >= x2 || y1 >= y2)
+        continue;
+
+      for (row = y1 / TILE_SIZE; row <= (y2 - 1) / TILE_SIZE; row++)
+        for (col = x1 / TILE_SIZE; col <= (x2 - 1) / TILE_SIZE; col++)
+          keep[row * tiles->n_cols + col] = TRUE;
+    }
+
+  return keep;
+}
+
+/*  reads the stored tiles from @buffer, starting at the top left of
+ *  its extent
+ */
+static void
+gimp_undo_tiles_read_buffer (GimpUndoTiles *tiles,
+                             GeglBuffer    *buffer)
+{
+  const GeglRectangle *extent  = gegl_buffer_get_extent (buffer);
+  gint                 n_tiles = tiles->n_cols * tiles->n_rows;
+  gint                 i;
+
+  for (i = 0; i < n_tiles; i++)
+    {
+      Tile          *tile = &tiles->tiles[i];
+      GeglRectangle  rect;
+
+      if (tile->state == TILE_EMPTY)
+        continue;
+
+      gimp_undo_tiles_clear_tile (tiles, tile);
+
+      gimp_undo_tiles_get_rect (tiles, i, &rect);
+
+      tile->state    = TILE_RAW;
+      tile->deflated = FALSE;
+      tile->size     = rect.width * rect.height * tiles->bpp;
+      tile->data     = g_malloc (tile->size);
+
+      rect.x += extent->x;
+      rect.y += extent->y;
+
+      gegl_buffer_get (buffer, &rect, 1.0, tiles->format, tile->data,
+                       GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+      tiles->memsize += tile->size;
+    }
+
+  gimp_undo_tiles_queue (tiles);
+}
+
+static void
+gimp_undo_tiles_queue (GimpUndoTiles *tiles)
+{
+  if (undo_tiles_pool && ! tiles->queued)
+    {
+      tiles->queued = TRUE;
+
+      g_thread_pool_push (undo_tiles_pool,
+                          gimp_undo_tiles_ref (tiles), NULL);
+    }
+}
+
+static void
+gimp_undo_tiles_clear_tile (GimpUndoTiles *tiles,
+                            Tile          *tile)
+{
+  if (tile->data)
+    {
+      g_free (tile->data);
+      tile->data = NULL;
+
+      tiles->memsize -= tile->size;
+    }
+  else if (tile->state == TILE_SWAPPED)
+    {
+      gimp_undo_tiles_swap_free (tile->offset, tile->size);
+    }
+
+  tile->size = 0;
+}
+
+/*  stores byte b of each pixel in the b-th plane, so the slowly
+ *  changing high bytes of 16 and 32 bit values end up next to each
+ *  other
+ */
+static void
+gimp_undo_tiles_shuffle (const guchar *src,
+                         guchar       *dest,
+                         gsize         size,
+                         gint          bpp)
+{
+  gsize n_pixels = size / bpp;
+  gsize p;
+  gint  b;
+
+  for (b = 0; b < bpp; b++)
+    for (p = 0; p < n_pixels; p++)
+      dest[b * n_pixels + p] = src[p * bpp + b];
+}
+
+static void
+gimp_undo_tiles_unshuffle (const guchar *src,
+                           guchar       *dest,
+                           gsize         size,
+                           gint          bpp)
+{
+  gsize n_pixels = size / bpp;
+  gsize p;
+  gint  b;
+
+  for (b = 0; b < bpp; b++)
+    for (p = 0; p < n_pixels; p++)
+      dest[p * bpp + b] = src[b * n_pixels + p];
+}
+
+static void
+gimp_undo_tiles_pack_tile (GimpUndoTiles *tiles,
+                           Tile          *tile)
+{
+  guchar *shuffled  = g_malloc (tile->size);
+  uLongf  dest_size = compressBound (tile->size);
+  guchar *dest      = g_malloc (dest_size);
+
+  gimp_undo_tiles_shuffle (tile->data, shuffled, tile->size, tiles->bpp);
+
+  if (compress2 (dest, &dest_size, shuffled, tile->size,
+                 COMPRESSION_LEVEL) == Z_OK &&
+      dest_size < tile->size)
+    {
+      tiles->memsize -= tile->size - dest_size;
+
+      g_free (tile->data);
+
+      tile->data     = g_realloc (dest, dest_size);
+      tile->size     = dest_size;
+      tile->deflated = TRUE;
+    }
+  else
+    {
+      g_free (dest);
+    }
+
+  g_free (shuffled);
+
+  tile->state = TILE_PACKED;
+}
+
+static gboolean
+gimp_undo_tiles_unpack_tile (GimpUndoTiles  *tiles,
+                             Tile           *tile,
+                             guchar         *dest,
+                             gsize           dest_size,
+                             GError        **error)
+{
+  guchar   *src     = tile->data;
+  gboolean  success = TRUE;
+
+  if (tile->state == TILE_SWAPPED)
+    {
+      src = g_malloc (tile->size);
+
+      success = gimp_undo_tiles_swap_read (tile->offset, src, tile->size,
+                                           error);
+    }
+
+  if (success && tile->deflated)
+    {
+      guchar *shuffled = g_malloc (dest_size);
+      uLongf  size     = dest_size;
+
+      success = (uncompress (shuffled, &size, src, tile->size) == Z_OK &&
+                 size == dest_size);
+
+      if (success)
+        gimp_undo_tiles_unshuffle (shuffled, dest, dest_size, tiles->bpp);
+      else
+        g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                             _("The stored pixels are corrupt."));
+
+      g_free (shuffled);
+    }
+  else if (success)
+    {
+      memcpy (dest, src, dest_size);
+    }
+
+  if (src != tile->data)
+    g_free (src);
+
+  return success;
+}
+
+
+/*  the swap file  */
+
+static gboolean
+gimp_undo_tiles_swap_open (GError **error)
+{
+  gchar *basename;
+  gchar *filename;
+
+  if (! undo_tiles_swap_dir)
+    {
+      g_set_error_literal (error, G_FILE_ERROR, G_FILE_ERROR_NOENT,
+                           _("No swap folder is set."));
+      return FALSE;
+    }
+
+  basename = g_strdup_printf ("gimp-undo-swap-%d", gimp_get_pid ());
+  filename = g_build_filename (undo_tiles_swap_dir, basename, NULL);
+
+  swap_file = g_file_new_for_path (filename);
+
+  swap_stream = g_file_replace_readwrite (swap_file, NULL, FALSE,
+                                          G_FILE_CREATE_PRIVATE,
+                                          NULL, error);
+
+  g_free (filename);
+  g_free (basename);
+
+  if (! swap_stream)
+    {
+      g_object_unref (swap_file);
+      swap_file = NULL;
+
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+/*  once writing the swap failed, it isn't tried again, and the
+ *  error was reported already
+ */
+static goffset
+gimp_undo_tiles_swap_write (const guchar  *data,
+                            gsize          size,
+                            GError       **error)
+{
+  goffset  offset = -1;
+  GList   *list;
+
+  g_mutex_lock (&swap_mutex);
+
+  if (swap_failed)
+    {
+      g_mutex_unlock (&swap_mutex);
+      return -1;
+    }
+
+  if (! swap_stream && ! gimp_undo_tiles_swap_open (error))
+    {
+      swap_failed = TRUE;
+
+      g_mutex_unlock (&swap_mutex);
+      return -1;
+    }
+
+  /*  first fit into a hole  */
+  for (list = swap_holes; list; list = g_list_next (list))
+    {
+      SwapBlock *hole = list->data;
+
+      if (hole->size >= size)
+        {
+          offset = hole->offset;
+
+          hole->offset += size;
+          hole->size   -= size;
+
+          if (hole->size == 0)
+            {
+              g_free (hole);
+              swap_holes = g_list_delete_link (swap_holes, list);
+            }
+
+          break;
+        }
+    }
+
+  if (offset < 0)
+    {
+      offset     = swap_size;
+      swap_size += size;
+    }
+
+  if (! g_seekable_seek (G_SEEKABLE (swap_stream), offset, G_SEEK_SET,
+                         NULL, error) ||
+      ! g_output_stream_write_all (g_io_stream_get_output_stream (G_IO_STREAM (swap_stream)),
+                                   data, size, NULL, NULL, error))
+    {
+      swap_failed = TRUE;
+
+      g_mutex_unlock (&swap_mutex);
+
+      gimp_undo_tiles_swap_free (offset, size);
+
+      return -1;
+    }
+
+  g_mutex_unlock (&swap_mutex);
+
+  return offset;
+}
+
+static gboolean
+gimp_undo_tiles_swap_read (goffset   offset,
+                           guchar   *data,
+                           gsize     size,
+                           GError  **error)
+{
+  gboolean success = FALSE;
+
+  g_mutex_lock (&swap_mutex);
+
+  if (swap_stream)
+    {
+      success =
+        g_seekable_seek (G_SEEKABLE (swap_stream), offset, G_SEEK_SET,
+                         NULL, error) &&
+        g_input_stream_read_all (g_io_stream_get_input_stream (G_IO_STREAM (swap_stream)),
+                                 data, size, NULL, NULL, error);
+    }
+  else
+    {
+      g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_CLOSED,
+                           _("The undo swap file is closed."));
+    }
+
+  g_mutex_unlock (&swap_mutex);
+
+  return success;
+}
+
+static void
+gimp_undo_tiles_swap_free (goffset offset,
+                           gsize   size)
+{
+  SwapBlock *block;
+  GList     *list;
+  GList     *prev = NULL;
+
+  g_mutex_lock (&swap_mutex);
+
+  /*  the swap is gone already  */
+  if (! swap_stream)
+    {
+      g_mutex_unlock (&swap_mutex);
+      return;
+    }
+
+  for (list = swap_holes; list; prev = list, list = g_list_next (list))
+    {
+      block = list->data;
+
+      if (block->offset > offset)
+        break;
+    }
+
+  block = g_new (SwapBlock, 1);
+
+  block->offset = offset;
+  block->size   = size;
+
+  swap_holes = g_list_insert_before (swap_holes, list, block);
+
+  list = prev ? g_list_next (prev) : swap_holes;
+
+  /*  merge with the following hole  */
+  if (list->next)
+    {
+      SwapBlock *next = list->next->data;
+
+      if (block->offset + block->size == next->offset)
+        {
+          block->size += next->size;
+
+          g_free (next);
+          swap_holes = g_list_delete_link (swap_holes, list->next);
+        }
+    }
+
+  /*  merge with the previous hole  */
+  if (prev)
+    {
+      SwapBlock *before = prev->data;
+
+      if (before->offset + before->size == block->offset)
+        {
+          before->size += block->size;
+
+          g_free (block);
+          swap_holes = g_list_delete_link (swap_holes, list);
+
+          list  = prev;
+          block = before;
+        }
+    }
+
+  /*  give back the end of the file  */
+  if (block->offset + block->size == swap_size)
+    {
+      swap_size = block->offset;
+
+      g_free (block);
+      swap_holes = g_list_delete_link (swap_holes, list);
+
+      g_seekable_truncate (G_SEEKABLE (swap_stream), swap_size, NULL, NULL);
+    }
+
+  g_mutex_unlock (&swap_mutex);
+}
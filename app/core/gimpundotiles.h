@@ -0,0 +1,51 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimpundotiles.h
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GIMP_UNDO_TILES_H__
+#define __GIMP_UNDO_TILES_H__
+
+
+void            gimp_undo_tiles_init        (Gimp                *gimp);
+void            gimp_undo_tiles_exit        (Gimp                *gimp);
+
+GimpUndoTiles * gimp_undo_tiles_new         (GeglBuffer          *buffer,
+                                             const GeglRectangle *rects,
+                                             gint                 n_rects) G_GNUC_WARN_UNUSED_RESULT;
+
+GimpUndoTiles * gimp_undo_tiles_ref         (GimpUndoTiles       *tiles);
+void            gimp_undo_tiles_unref       (GimpUndoTiles       *tiles);
+
+gint            gimp_undo_tiles_get_width   (GimpUndoTiles       *tiles);
+gint            gimp_undo_tiles_get_height  (GimpUndoTiles       *tiles);
+
+GeglBuffer    * gimp_undo_tiles_get_buffer  (GimpUndoTiles       *tiles,
+                                             GeglBuffer          *background,
+                                             gint                 x,
+                                             gint                 y,
+                                             GError             **error) G_GNUC_WARN_UNUSED_RESULT;
+void            gimp_undo_tiles_set_buffer  (GimpUndoTiles       *tiles,
+                                             GeglBuffer          *buffer);
+
+gboolean        gimp_undo_tiles_swap_out    (GimpUndoTiles       *tiles,
+                                             GError             **error);
+
+gint64          gimp_undo_tiles_get_memsize (GimpUndoTiles       *tiles);
+
+
+#endif  /*  __GIMP_UNDO_TILES_H__  */
@@ -17,9 +17,13 @@
 
 #include "config.h"
 
+#include <string.h>
+
 #include <gegl.h>
 #include <gtk/gtk.h>
 
+#include "libgimpmath/gimpmath.h"
+
 #include "display-types.h"
 
 #include "config/gimpdisplayconfig.h"
@@ -35,48 +39,94 @@
 #include "gimpdisplayshell-appearance.h"
 #include "gimpdisplayshell-draw.h"
 #include "gimpdisplayshell-expose.h"
+#include "gimpdisplayshell-scale.h"
 #include "gimpdisplayshell-selection.h"
 #include "gimpdisplayshell-transform.h"
 
 
-struct _Selection
-{
-  GimpDisplayShell *shell;            /*  shell that owns the selection     */
-
-  GimpSegment      *segs_in;          /*  gdk segments of area boundary     */
-  gint              n_segs_in;        /*  number of segments in segs_in     */
-
-  GimpSegment      *segs_out;         /*  gdk segments of area boundary     */
-  gint              n_segs_out;       /*  number of segments in segs_out    */
+/*  size of the cells of the segment index, in image pixels  */
+#define INDEX_CELL_SIZE 256
 
-  guint             index;            /*  index of current stipple pattern  */
-  gint              paused;           /*  count of pause requests           */
-  gboolean          shell_visible;    /*  visility of the display shell     */
-  gboolean          show_selection;   /*  is the selection visible?         */
-  guint             timeout;          /*  timer for successive draws        */
-  cairo_pattern_t  *segs_in_mask;     /*  cache for rendered segments       */
-};
+/*  the rendered ants extend this fraction of the window beyond each
+ *  of its edges, so they can be reused after scrolling a bit
+ */
+#define MASK_MARGIN     0.25
 
 
-/*  local function prototypes  */
+typedef struct
+{
+  gboolean            valid;          /*  cleared on "selection-invalidate" */
 
-static void      selection_start          (Selection          *selection);
-static void      selection_stop           (Selection          *selection);
+  gint                x, y;           /*  image origin of the first cell    */
+  gint                n_cols;
+  gint                n_rows;
+  gint               *cells;          /*  offsets of each cell's segments   */
+  GimpBoundSeg       *segs;           /*  segments split at cell edges      */
+  gint                n_segs;
+} SelectionIndex;
 
-static void      selection_draw           (Selection          *selection);
-static void      selection_undraw         (Selection          *selection);
+struct _Selection
+{
+  GimpDisplayShell      *shell;          /*  shell that owns the selection    */
+
+  SelectionIndex         index_in;       /*  image space index of segs_in     */
+  SelectionIndex         index_out;      /*  image space index of segs_out    */
+
+  GimpSegment           *segs_out;       /*  gdk segments of area boundary    */
+  gint                   n_segs_out;     /*  number of segments in segs_out   */
+  cairo_rectangle_int_t  segs_out_area;  /*  display area segs_out start at   */
+
+  guint                  index;          /*  index of current stipple pattern */
+  gint                   paused;         /*  count of pause requests          */
+  gboolean               shell_visible;  /*  visility of the display shell    */
+  gboolean               show_selection; /*  is the selection visible?        */
+  guint                  timeout;        /*  timer for successive draws       */
+
+  cairo_pattern_t       *segs_in_mask;   /*  cache for rendered segments      */
+  cairo_rectangle_int_t  mask_area;      /*  its area in scaled image coords  */
+  gdouble                mask_scale_x;   /*  the scale it was rendered at     */
+  gdouble                mask_scale_y;
+  gboolean               mask_rotated;   /*  was it rendered rotated?         */
+};
 
-static void      selection_render_mask    (Selection          *selection);
 
-static void      selection_zoom_segs      (Selection          *selection,
-                                           const GimpBoundSeg *src_segs,
-                                           GimpSegment        *dest_segs,
-                                           gint                n_segs);
-static void      selection_generate_segs  (Selection          *selection);
-static void      selection_free_segs      (Selection          *selection);
+/*  local function prototypes  */
 
-static gboolean  selection_start_timeout  (Selection          *selection);
-static gboolean  selection_timeout        (Selection          *selection);
+static void      selection_start          (Selection                   *selection);
+static void      selection_stop           (Selection                   *selection);
+
+static void      selection_draw           (Selection                   *selection);
+static void      selection_undraw         (Selection                   *selection);
+
+static void      selection_render_mask    (Selection                   *selection);
+static gboolean  selection_mask_is_valid  (Selection                   *selection);
+static void      selection_free_mask      (Selection                   *selection);
+
+static void      selection_index_add      (SelectionIndex              *index,
+                                           const GimpBoundSeg          *seg,
+                                           gint                        *fill);
+static void      selection_index_build    (SelectionIndex              *index,
+                                           const GimpBoundSeg          *segs,
+                                           gint                         n_segs);
+static void      selection_index_free     (SelectionIndex              *index);
+
+static void      selection_get_viewport   (Selection                   *selection,
+                                           cairo_rectangle_int_t       *area);
+static void      selection_zoom_segs      (Selection                   *selection,
+                                           const GimpBoundSeg          *src_segs,
+                                           GimpSegment                 *dest_segs,
+                                           gint                         n_segs,
+                                           const cairo_rectangle_int_t *area);
+static GimpSegment * selection_zoom_index (Selection                   *selection,
+                                           const SelectionIndex        *index,
+                                           const cairo_rectangle_int_t *area,
+                                           gint                        *n_segs);
+static void      selection_generate_segs  (Selection                   *selection);
+static void      selection_free_out_segs  (Selection                   *selection);
+static void      selection_free_segs      (Selection                   *selection);
+
+static gboolean  selection_start_timeout  (Selection                   *selection);
+static gboolean  selection_timeout        (Selection                   *selection);
 
 static gboolean  selection_window_state_event      (GtkWidget           *shell,
                                                     GdkEventWindowState *event,
@@ -144,6 +194,11 @@ gimp_display_shell_selection_undraw (GimpDisplayShell *shell)
 
   if (gimp_display_get_image (shell->display))
     {
+      /*  the boundary changed, the index and the mask are stale  */
+      selection_index_free (&shell->selection->index_in);
+      selection_index_free (&shell->selection->index_out);
+      selection_free_mask (shell->selection);
+
       selection_undraw (shell->selection);
     }
   else
@@ -246,11 +301,21 @@ selection_stop (Selection *selection)
 static void
 selection_draw (Selection *selection)
 {
-  if (selection->segs_in)
+  if (selection->segs_in_mask)
     {
-      cairo_t *cr;
+      GimpDisplayShell *shell = selection->shell;
+      cairo_matrix_t    matrix;
+      cairo_t          *cr;
+
+      /*  the mask can be larger than the window and rendered at an
+       *  earlier scroll offset
+       */
+      cairo_matrix_init_translate (&matrix,
+                                   shell->offset_x - selection->mask_area.x,
+                                   shell->offset_y - selection->mask_area.y);
+      cairo_pattern_set_matrix (selection->segs_in_mask, &matrix);
 
-      cr = gdk_cairo_create (gtk_widget_get_window (selection->shell->canvas));
+      cr = gdk_cairo_create (gtk_widget_get_window (shell->canvas));
 
       gimp_display_shell_draw_selection_in (selection->shell, cr,
                                             selection->segs_in_mask,
@@ -282,26 +347,91 @@ selection_undraw (Selection *selection)
 static void
 selection_render_mask (Selection *selection)
 {
-  GdkWindow       *window;
-  cairo_surface_t *surface;
-  cairo_t         *cr;
+  GimpDisplayShell      *shell = selection->shell;
+  GdkWindow             *window;
+  cairo_surface_t       *surface;
+  cairo_t               *cr;
+  cairo_rectangle_int_t  area;
+  GimpSegment           *segs;
+  gint                   n_segs;
+
+  window = gtk_widget_get_window (shell->canvas);
+
+  if (shell->rotate_transform)
+    {
+      /*  a rotated mask can't be reused at another offset, so only
+       *  render what is in the window
+       */
+      selection_get_viewport (selection, &area);
+
+      selection->mask_area.x      = shell->offset_x;
+      selection->mask_area.y      = shell->offset_y;
+      selection->mask_area.width  = shell->disp_width;
+      selection->mask_area.height = shell->disp_height;
+    }
+  else
+    {
+      gint image_width;
+      gint image_height;
+      gint margin_x = shell->disp_width  * MASK_MARGIN;
+      gint margin_y = shell->disp_height * MASK_MARGIN;
+      gint x1, y1, x2, y2;
+
+      gimp_display_shell_scale_get_image_size (shell,
+                                               &image_width, &image_height);
+
+      /*  render the window plus a margin, but not much beyond the image  */
+      x1 = MAX (-margin_x, -shell->offset_x - 1);
+      y1 = MAX (-margin_y, -shell->offset_y - 1);
+      x2 = MIN (shell->disp_width  + margin_x,
+                image_width  - shell->offset_x + 1);
+      y2 = MIN (shell->disp_height + margin_y,
+                image_height - shell->offset_y + 1);
+
+      x1 = MIN (x1, 0);
+      y1 = MIN (y1, 0);
+      x2 = MAX (x2, shell->disp_width);
+      y2 = MAX (y2, shell->disp_height);
+
+      area.x      = x1;
+      area.y      = y1;
+      area.width  = x2 - x1;
+      area.height = y2 - y1;
+
+      selection->mask_area        = area;
+      selection->mask_area.x     += shell->offset_x;
+      selection->mask_area.y     += shell->offset_y;
+    }
+
+  selection->mask_scale_x = shell->scale_x;
+  selection->mask_scale_y = shell->scale_y;
+  selection->mask_rotated = shell->rotate_transform != NULL;
 
-  window = gtk_widget_get_window (selection->shell->canvas);
   surface = gdk_window_create_similar_surface (window, CAIRO_CONTENT_ALPHA,
-                                               gdk_window_get_width  (window),
-                                               gdk_window_get_height (window));
+                                               selection->mask_area.width,
+                                               selection->mask_area.height);
   cr = cairo_create (surface);
 
   cairo_set_line_cap (cr, CAIRO_LINE_CAP_SQUARE);
   cairo_set_line_width (cr, 1.0);
 
-  if (selection->shell->rotate_transform)
-    cairo_transform (cr, selection->shell->rotate_transform);
+  if (shell->rotate_transform)
+    {
+      cairo_transform (cr, shell->rotate_transform);
+      cairo_translate (cr, area.x, area.y);
+    }
 
-  gimp_cairo_add_segments (cr,
-                           selection->segs_in,
-                           selection->n_segs_in);
-  cairo_stroke (cr);
+  /*  only the segments near the mask area are zoomed and stroked  */
+  segs = selection_zoom_index (selection, &selection->index_in, &area,
+                               &n_segs);
+
+  if (segs)
+    {
+      gimp_cairo_add_segments (cr, segs, n_segs);
+      cairo_stroke (cr);
+
+      g_free (segs);
+    }
 
   selection->segs_in_mask = cairo_pattern_create_for_surface (surface);
 
@@ -309,14 +439,192 @@ selection_render_mask (Selection *selection)
   cairo_surface_destroy (surface);
 }
 
+static gboolean
+selection_mask_is_valid (Selection *selection)
+{
+  GimpDisplayShell *shell = selection->shell;
+
+  if (! selection->segs_in_mask   ||
+      selection->mask_rotated     ||
+      shell->rotate_transform     ||
+      selection->mask_scale_x != shell->scale_x ||
+      selection->mask_scale_y != shell->scale_y)
+    return FALSE;
+
+  return (shell->offset_x >= selection->mask_area.x &&
+          shell->offset_y >= selection->mask_area.y &&
+          shell->offset_x + shell->disp_width  <= (selection->mask_area.x +
+                                                   selection->mask_area.width) &&
+          shell->offset_y + shell->disp_height <= (selection->mask_area.y +
+                                                   selection->mask_area.height));
+}
+
 static void
-selection_zoom_segs (Selection          *selection,
-                     const GimpBoundSeg *src_segs,
-                     GimpSegment        *dest_segs,
-                     gint                n_segs)
+selection_free_mask (Selection *selection)
 {
-  const gint xclamp = selection->shell->disp_width + 1;
-  const gint yclamp = selection->shell->disp_height + 1;
+  if (selection->segs_in_mask)
+    {
+      cairo_pattern_destroy (selection->segs_in_mask);
+      selection->segs_in_mask = NULL;
+    }
+}
+
+static void
+selection_index_add (SelectionIndex     *index,
+                     const GimpBoundSeg *seg,
+                     gint               *fill)
+{
+  GimpBoundSeg piece = *seg;
+  gboolean     vertical;
+  gint         lo, hi;
+  gint         cell1, cell2;
+  gint         col, row;
+  gint         i;
+
+  vertical = (seg->x1 == seg->x2);
+
+  if (vertical)
+    {
+      lo  = MIN (seg->y1, seg->y2);
+      hi  = MAX (seg->y1, seg->y2);
+      col = (seg->x1 - index->x) / INDEX_CELL_SIZE;
+
+      cell1 = (lo - index->y) / INDEX_CELL_SIZE;
+      cell2 = (MAX (hi - 1, lo) - index->y) / INDEX_CELL_SIZE;
+    }
+  else
+    {
+      lo  = MIN (seg->x1, seg->x2);
+      hi  = MAX (seg->x1, seg->x2);
+      row = (seg->y1 - index->y) / INDEX_CELL_SIZE;
+
+      cell1 = (lo - index->x) / INDEX_CELL_SIZE;
+      cell2 = (MAX (hi - 1, lo) - index->x) / INDEX_CELL_SIZE;
+    }
+
+  /*  split the segment at cell edges  */
+  for (i = cell1; i <= cell2; i++)
+    {
+      gint cell;
+
+      if (vertical)
+        {
+          gint y = index->y + i * INDEX_CELL_SIZE;
+
+          piece.y1 = MAX (lo, y);
+          piece.y2 = MIN (hi, y + INDEX_CELL_SIZE);
+
+          cell = i * index->n_cols + col;
+        }
+      else
+        {
+          gint x = index->x + i * INDEX_CELL_SIZE;
+
+          piece.x1 = MAX (lo, x);
+          piece.x2 = MIN (hi, x + INDEX_CELL_SIZE);
+
+          cell = row * index->n_cols + i;
+        }
+
+      if (fill)
+        index->segs[fill[cell]++] = piece;
+      else
+        index->cells[cell + 1]++;
+    }
+}
+
+static void
+selection_index_build (SelectionIndex     *index,
+                       const GimpBoundSeg *segs,
+                       gint                n_segs)
+{
+  gint *fill;
+  gint  x1 = G_MAXINT;
+  gint  y1 = G_MAXINT;
+  gint  x2 = G_MININT;
+  gint  y2 = G_MININT;
+  gint  n_cells;
+  gint  i;
+
+  selection_index_free (index);
+
+  index->valid = TRUE;
+
+  if (! n_segs)
+    return;
+
+  for (i = 0; i < n_segs; i++)
+    {
+      x1 = MIN (x1, MIN (segs[i].x1, segs[i].x2));
+      y1 = MIN (y1, MIN (segs[i].y1, segs[i].y2));
+      x2 = MAX (x2, MAX (segs[i].x1, segs[i].x2));
+      y2 = MAX (y2, MAX (segs[i].y1, segs[i].y2));
+    }
+
+  index->x      = x1;
+  index->y      = y1;
+  index->n_cols = (x2 - x1) / INDEX_CELL_SIZE + 1;
+  index->n_rows = (y2 - y1) / INDEX_CELL_SIZE + 1;
+
+  n_cells = index->n_cols * index->n_rows;
+
+  index->cells = g_new0 (gint, n_cells + 1);
+
+  /*  count the pieces in each cell, then sort them into place  */
+  for (i = 0; i < n_segs; i++)
+    selection_index_add (index, &segs[i], NULL);
+
+  for (i = 0; i < n_cells; i++)
+    index->cells[i + 1] += index->cells[i];
+
+  index->n_segs = index->cells[n_cells];
+  index->segs   = g_new (GimpBoundSeg, index->n_segs);
+
+  fill = g_memdup (index->cells, n_cells * sizeof (gint));
+
+  for (i = 0; i < n_segs; i++)
+    selection_index_add (index, &segs[i], fill);
+
+  g_free (fill);
+}
+
+static void
+selection_index_free (SelectionIndex *index)
+{
+  g_free (index->cells);
+  g_free (index->segs);
+
+  memset (index, 0, sizeof (SelectionIndex));
+}
+
+/*  the unrotated display area covering the window  */
+static void
+selection_get_viewport (Selection             *selection,
+                        cairo_rectangle_int_t *area)
+{
+  GimpDisplayShell *shell = selection->shell;
+  gdouble           x1, y1, x2, y2;
+
+  gimp_display_shell_unrotate_bounds (shell,
+                                      0, 0,
+                                      shell->disp_width, shell->disp_height,
+                                      &x1, &y1, &x2, &y2);
+
+  area->x      = floor (x1);
+  area->y      = floor (y1);
+  area->width  = ceil (x2) - area->x;
+  area->height = ceil (y2) - area->y;
+}
+
+static void
+selection_zoom_segs (Selection                   *selection,
+                     const GimpBoundSeg          *src_segs,
+                     GimpSegment                 *dest_segs,
+                     gint                         n_segs,
+                     const cairo_rectangle_int_t *area)
+{
+  const gint xclamp = area->width + 1;
+  const gint yclamp = area->height + 1;
   gint       i;
 
   gimp_display_shell_zoom_segments (selection->shell,
@@ -325,11 +633,11 @@ selection_zoom_segs (Selection          *selection,
 
   for (i = 0; i < n_segs; i++)
     {
-      dest_segs[i].x1 = CLAMP (dest_segs[i].x1, -1, xclamp);
-      dest_segs[i].y1 = CLAMP (dest_segs[i].y1, -1, yclamp);
+      dest_segs[i].x1 = CLAMP (dest_segs[i].x1 - area->x, -1, xclamp);
+      dest_segs[i].y1 = CLAMP (dest_segs[i].y1 - area->y, -1, yclamp);
 
-      dest_segs[i].x2 = CLAMP (dest_segs[i].x2, -1, xclamp);
-      dest_segs[i].y2 = CLAMP (dest_segs[i].y2, -1, yclamp);
+      dest_segs[i].x2 = CLAMP (dest_segs[i].x2 - area->x, -1, xclamp);
+      dest_segs[i].y2 = CLAMP (dest_segs[i].y2 - area->y, -1, yclamp);
 
       /*  If this segment is a closing segment && the segments lie inside
        *  the region, OR if this is an opening segment and the segments
@@ -353,75 +661,156 @@ selection_zoom_segs (Selection          *selection,
     }
 }
 
+/*  Zooms the segments of the index's cells which intersect @area, an
+ *  area in unrotated display coordinates.  The returned segments are
+ *  relative to the area's origin.
+ */
+static GimpSegment *
+selection_zoom_index (Selection                   *selection,
+                      const SelectionIndex        *index,
+                      const cairo_rectangle_int_t *area,
+                      gint                        *n_segs)
+{
+  GimpDisplayShell *shell = selection->shell;
+  GimpSegment      *segs;
+  gint              x1, y1, x2, y2;
+  gint              col1, row1, col2, row2;
+  gint              row;
+  gint              n = 0;
+
+  *n_segs = 0;
+
+  if (! index->n_segs)
+    return NULL;
+
+  /*  include the segments moved into the area by one display pixel  */
+  x1 = floor (FUNSCALEX (shell, area->x + shell->offset_x)) - 1;
+  y1 = floor (FUNSCALEY (shell, area->y + shell->offset_y)) - 1;
+  x2 = ceil (FUNSCALEX (shell, area->x + area->width  + shell->offset_x)) + 1;
+  y2 = ceil (FUNSCALEY (shell, area->y + area->height + shell->offset_y)) + 1;
+
+  x1 -= index->x;
+  y1 -= index->y;
+  x2 -= index->x;
+  y2 -= index->y;
+
+  if (x2 < 0 || y2 < 0 ||
+      x1 >= index->n_cols * INDEX_CELL_SIZE ||
+      y1 >= index->n_rows * INDEX_CELL_SIZE)
+    return NULL;
+
+  col1 = MAX (x1, 0) / INDEX_CELL_SIZE;
+  row1 = MAX (y1, 0) / INDEX_CELL_SIZE;
+  col2 = MIN (x2 / INDEX_CELL_SIZE, index->n_cols - 1);
+  row2 = MIN (y2 / INDEX_CELL_SIZE, index->n_rows - 1);
+
+  for (row = row1; row <= row2; row++)
+    {
+      const gint *cells = index->cells + row * index->n_cols;
+
+      n += cells[col2 + 1] - cells[col1];
+    }
+
+  if (! n)
+    return NULL;
+
+  segs = g_new (GimpSegment, n);
+
+  *n_segs = n;
+  n       = 0;
+
+  /*  the cells of a row are contiguous  */
+  for (row = row1; row <= row2; row++)
+    {
+      const gint *cells = index->cells + row * index->n_cols;
+
+      selection_zoom_segs (selection,
+                           index->segs + cells[col1], segs + n,
+                           cells[col2 + 1] - cells[col1], area);
+
+      n += cells[col2 + 1] - cells[col1];
+    }
+
+  return segs;
+}
+
 static void
 selection_generate_segs (Selection *selection)
 {
   GimpImage          *image = gimp_display_get_image (selection->shell->display);
   const GimpBoundSeg *segs_in;
   const GimpBoundSeg *segs_out;
+  gint                n_segs_in;
+  gint                n_segs_out;
 
   /*  Ask the image for the boundary of its selected region...
-   *  Then transform that information into a new buffer of GimpSegments
+   *  Then index it in image space, so only the segments near the
+   *  window need to be transformed into GimpSegments.  The index
+   *  is kept until the image's "selection-invalidate" signal says
+   *  the boundary changed.
    */
   gimp_channel_boundary (gimp_image_get_mask (image),
                          &segs_in, &segs_out,
-                         &selection->n_segs_in, &selection->n_segs_out,
+                         &n_segs_in, &n_segs_out,
                          0, 0, 0, 0);
 
-  if (selection->n_segs_in)
+  if (! selection->index_in.valid)
     {
-      selection->segs_in = g_new (GimpSegment, selection->n_segs_in);
-      selection_zoom_segs (selection, segs_in,
-                           selection->segs_in, selection->n_segs_in);
-
-      selection_render_mask (selection);
-    }
-  else
-    {
-      selection->segs_in = NULL;
+      selection_index_build (&selection->index_in, segs_in, n_segs_in);
+      selection_free_mask (selection);
     }
 
-  /*  Possible secondary boundary representation  */
-  if (selection->n_segs_out)
+  if (! selection->index_out.valid)
     {
-      selection->segs_out = g_new (GimpSegment, selection->n_segs_out);
-      selection_zoom_segs (selection, segs_out,
-                           selection->segs_out, selection->n_segs_out);
+      selection_index_build (&selection->index_out, segs_out, n_segs_out);
     }
-  else
+
+  /*  the rendered mask survives scrolling as long as it covers the window  */
+  if (! selection_mask_is_valid (selection))
     {
-      selection->segs_out = NULL;
+      selection_free_mask (selection);
+
+      if (selection->index_in.n_segs)
+        selection_render_mask (selection);
     }
+
+  /*  Possible secondary boundary representation  */
+  selection_get_viewport (selection, &selection->segs_out_area);
+
+  selection->segs_out = selection_zoom_index (selection,
+                                              &selection->index_out,
+                                              &selection->segs_out_area,
+                                              &selection->n_segs_out);
 }
 
 static void
-selection_free_segs (Selection *selection)
+selection_free_out_segs (Selection *selection)
 {
-  if (selection->segs_in)
-    {
-      g_free (selection->segs_in);
-      selection->segs_in   = NULL;
-      selection->n_segs_in = 0;
-    }
-
   if (selection->segs_out)
     {
       g_free (selection->segs_out);
       selection->segs_out   = NULL;
       selection->n_segs_out = 0;
     }
+}
 
-  if (selection->segs_in_mask)
-    {
-      cairo_pattern_destroy (selection->segs_in_mask);
-      selection->segs_in_mask = NULL;
-    }
+static void
+selection_free_segs (Selection *selection)
+{
+  selection_free_out_segs (selection);
+  selection_free_mask (selection);
+
+  selection_index_free (&selection->index_in);
+  selection_index_free (&selection->index_out);
 }
 
 static gboolean
 selection_start_timeout (Selection *selection)
 {
-  selection_free_segs (selection);
+  /*  keep the index and the mask, they are still valid if the
+   *  selection didn't change
+   */
+  selection_free_out_segs (selection);
   selection->timeout = 0;
 
   if (! gimp_display_get_image (selection->shell->display))
@@ -447,6 +836,10 @@ selection_start_timeout (Selection *selection)
           if (selection->shell->rotate_transform)
             cairo_transform (cr, selection->shell->rotate_transform);
 
+          cairo_translate (cr,
+                           selection->segs_out_area.x,
+                           selection->segs_out_area.y);
+
           gimp_display_shell_draw_selection_out (selection->shell, cr,
                                                  selection->segs_out,
                                                  selection->n_segs_out);
@@ -454,7 +847,7 @@ selection_start_timeout (Selection *selection)
           cairo_destroy (cr);
         }
 
-      if (selection->segs_in && selection->shell_visible)
+      if (selection->segs_in_mask && selection->shell_visible)
         selection->timeout = g_timeout_add_full (G_PRIORITY_DEFAULT_IDLE,
                                                  config->marching_ants_speed,
                                                  (GSourceFunc) selection_timeout,
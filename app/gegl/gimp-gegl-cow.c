@@ -0,0 +1,517 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimp-gegl-cow.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <gegl.h>
+
+#include "gimp-gegl-types.h"
+
+#include "gimp-gegl-cow.h"
+
+
+/*  GEGL shares whole tiles between buffers when copying between
+ *  buffers whose tiles line up, and only copies a tile when one of
+ *  the buffers writes to it.  gimp_gegl_buffer_dup() makes sure the
+ *  tiles line up, and keeps track of which tiles are still shared:
+ *
+ *  Buffers that share tiles form a group.  Each tile of a buffer in
+ *  a group has an id, 0 if the tile is the buffer's own, or an id
+ *  which is the same for all buffers sharing the tile.  The group
+ *  counts the buffers using each id, writing to a tile of a buffer
+ *  (seen by its "changed" signal) makes the tile the buffer's own.
+ */
+
+
+typedef struct _CowGroup  CowGroup;
+typedef struct _CowBuffer CowBuffer;
+
+struct _CowGroup
+{
+  GMutex      mutex;
+  GList      *buffers;
+  guint32     next_id;
+  GHashTable *refs;        /*  tile id -> number of buffers using it    */
+  guint       stamp;       /*  changed whenever any tile stops sharing  */
+};
+
+struct _CowBuffer
+{
+  CowGroup      *group;
+  GeglBuffer    *buffer;
+  gulong         changed_id;
+
+  GeglRectangle  extent;   /*  in tile storage coordinates              */
+  gint           shift_x;
+  gint           shift_y;
+  gint           tile_width;
+  gint           tile_height;
+  gint           bpp;
+  gint           col0;
+  gint           row0;
+  gint           n_cols;
+  gint           n_rows;
+  guint32       *ids;
+
+  guint          stamp;    /*  group stamp the sizes were computed at   */
+  gint64         unique_size;
+  gint64         shared_size;
+};
+
+
+/*  local function prototypes  */
+
+static CowBuffer * gimp_gegl_cow_buffer_new     (CowGroup            *group,
+                                                 GeglBuffer          *buffer);
+static void        gimp_gegl_cow_buffer_free    (CowBuffer           *cow);
+static void        gimp_gegl_cow_buffer_changed (GeglBuffer          *buffer,
+                                                 const GeglRectangle *rect,
+                                                 CowBuffer           *cow);
+static void        gimp_gegl_cow_buffer_notify  (CowBuffer           *cow,
+                                                 GObject             *where_the_buffer_was);
+
+static void        gimp_gegl_cow_share          (GeglBuffer          *src,
+                                                 GeglBuffer          *dest);
+static void        gimp_gegl_cow_unref_id       (CowGroup            *group,
+                                                 guint32              id);
+static gint64      gimp_gegl_cow_tile_size      (CowBuffer           *cow,
+                                                 gint                 col,
+                                                 gint                 row);
+
+
+/*  public functions  */
+
+GeglBuffer *
+gimp_gegl_buffer_dup (GeglBuffer *buffer)
+{
+  GeglBuffer          *new_buffer;
+  const GeglRectangle *extent;
+  const GeglRectangle *abyss;
+  gint                 shift_x;
+  gint                 shift_y;
+  gint                 tile_width;
+  gint                 tile_height;
+
+  g_return_val_if_fail (GEGL_IS_BUFFER (buffer), NULL);
+
+  extent = gegl_buffer_get_extent (buffer);
+  abyss  = gegl_buffer_get_abyss (buffer);
+
+  g_object_get (buffer,
+                "shift-x",     &shift_x,
+                "shift-y",     &shift_y,
+                "tile-width",  &tile_width,
+                "tile-height", &tile_height,
+                NULL);
+
+  /*  unlike gegl_buffer_dup(), keep the shift, so that the tiles line
+   *  up even for buffers made by gimp_gegl_buffer_new_aligned()
+   */
+  new_buffer = g_object_new (GEGL_TYPE_BUFFER,
+                             "format",       gegl_buffer_get_format (buffer),
+                             "x",            extent->x,
+                             "y",            extent->y,
+                             "width",        extent->width,
+                             "height",       extent->height,
+                             "abyss-x",      abyss->x,
+                             "abyss-y",      abyss->y,
+                             "abyss-width",  abyss->width,
+                             "abyss-height", abyss->height,
+                             "shift-x",      shift_x,
+                             "shift-y",      shift_y,
+                             "tile-width",   tile_width,
+                             "tile-height",  tile_height,
+                             NULL);
+
+  gegl_buffer_copy (buffer, extent, new_buffer, extent);
+
+  gimp_gegl_cow_share (buffer, new_buffer);
+
+  return new_buffer;
+}
+
+GeglBuffer *
+gimp_gegl_buffer_new_aligned (GeglBuffer          *buffer,
+                              const GeglRectangle *rect,
+                              const Babl          *format)
+{
+  gint shift_x;
+  gint shift_y;
+  gint tile_width;
+  gint tile_height;
+
+  g_return_val_if_fail (GEGL_IS_BUFFER (buffer), NULL);
+  g_return_val_if_fail (rect != NULL, NULL);
+  g_return_val_if_fail (format != NULL, NULL);
+
+  g_object_get (buffer,
+                "shift-x",     &shift_x,
+                "shift-y",     &shift_y,
+                "tile-width",  &tile_width,
+                "tile-height", &tile_height,
+                NULL);
+
+  return g_object_new (GEGL_TYPE_BUFFER,
+                       "format",       format,
+                       "x",            0,
+                       "y",            0,
+                       "width",        rect->width,
+                       "height",       rect->height,
+                       "abyss-x",      0,
+                       "abyss-y",      0,
+                       "abyss-width",  rect->width,
+                       "abyss-height", rect->height,
+                       "shift-x",      shift_x + rect->x,
+                       "shift-y",      shift_y + rect->y,
+                       "tile-width",   tile_width,
+                       "tile-height",  tile_height,
+                       NULL);
+}
+
+gboolean
+gimp_gegl_buffer_get_cow_size (GeglBuffer *buffer,
+                               gint64     *unique_size,
+                               gint64     *shared_size)
+{
+  CowBuffer *cow;
+  CowGroup  *group;
+
+  g_return_val_if_fail (GEGL_IS_BUFFER (buffer), FALSE);
+  g_return_val_if_fail (unique_size != NULL, FALSE);
+  g_return_val_if_fail (shared_size != NULL, FALSE);
+
+  cow = g_object_get_data (G_OBJECT (buffer), "gimp-gegl-cow");
+
+  if (! cow)
+    return FALSE;
+
+  group = cow->group;
+
+  g_mutex_lock (&group->mutex);
+
+  if (cow->stamp != group->stamp)
+    {
+      gint col, row;
+
+      cow->unique_size = 0;
+      cow->shared_size = 0;
+
+      for (row = 0; row < cow->n_rows; row++)
+        for (col = 0; col < cow->n_cols; col++)
+          {
+            guint32 id    = cow->ids[row * cow->n_cols + col];
+            gint64  size  = gimp_gegl_cow_tile_size (cow, col, row);
+            gint    n_ref = 1;
+
+            if (id)
+              n_ref = GPOINTER_TO_INT (g_hash_table_lookup (group->refs,
+                                                            GUINT_TO_POINTER (id)));
+
+            if (n_ref > 1)
+              cow->shared_size += size / n_ref;
+            else
+              cow->unique_size += size;
+          }
+
+      cow->stamp = group->stamp;
+    }
+
+  *unique_size = cow->unique_size;
+  *shared_size = cow->shared_size;
+
+  g_mutex_unlock (&group->mutex);
+
+  return TRUE;
+}
+
+
+/*  private functions  */
+
+static gint
+gimp_gegl_cow_div (gint a,
+                   gint b)
+{
+  return a >= 0 ? a / b : - ((b - 1 - a) / b);
+}
+
+static CowBuffer *
+gimp_gegl_cow_buffer_new (CowGroup   *group,
+                          GeglBuffer *buffer)
+{
+  CowBuffer           *cow    = g_slice_new0 (CowBuffer);
+  const GeglRectangle *extent = gegl_buffer_get_extent (buffer);
+
+  cow->group  = group;
+  cow->buffer = buffer;
+  cow->stamp  = group->stamp - 1;
+
+  g_object_get (buffer,
+                "shift-x",     &cow->shift_x,
+                "shift-y",     &cow->shift_y,
+                "tile-width",  &cow->tile_width,
+                "tile-height", &cow->tile_height,
+                NULL);
+
+  cow->bpp = babl_format_get_bytes_per_pixel (gegl_buffer_get_format (buffer));
+
+  cow->extent    = *extent;
+  cow->extent.x += cow->shift_x;
+  cow->extent.y += cow->shift_y;
+
+  if (! gegl_rectangle_is_empty (&cow->extent))
+    {
+      cow->col0   = gimp_gegl_cow_div (cow->extent.x, cow->tile_width);
+      cow->row0   = gimp_gegl_cow_div (cow->extent.y, cow->tile_height);
+      cow->n_cols = gimp_gegl_cow_div (cow->extent.x + cow->extent.width - 1,
+                                       cow->tile_width) - cow->col0 + 1;
+      cow->n_rows = gimp_gegl_cow_div (cow->extent.y + cow->extent.height - 1,
+                                       cow->tile_height) - cow->row0 + 1;
+    }
+
+  cow->ids = g_new0 (guint32, cow->n_cols * cow->n_rows);
+
+  group->buffers = g_list_prepend (group->buffers, cow);
+
+  g_object_set_data (G_OBJECT (buffer), "gimp-gegl-cow", cow);
+
+  g_object_weak_ref (G_OBJECT (buffer),
+                     (GWeakNotify) gimp_gegl_cow_buffer_notify, cow);
+
+  cow->changed_id =
+    gegl_buffer_signal_connect (buffer, "changed",
+                                G_CALLBACK (gimp_gegl_cow_buffer_changed),
+                                cow);
+
+  return cow;
+}
+
+static void
+gimp_gegl_cow_buffer_free (CowBuffer *cow)
+{
+  g_free (cow->ids);
+
+  g_slice_free (CowBuffer, cow);
+}
+
+static void
+gimp_gegl_cow_buffer_changed (GeglBuffer          *buffer,
+                              const GeglRectangle *rect,
+                              CowBuffer           *cow)
+{
+  CowGroup *group = cow->group;
+  gint      col1, col2;
+  gint      row1, row2;
+  gint      col, row;
+  gboolean  unshared = FALSE;
+
+  if (gegl_rectangle_is_empty (rect))
+    return;
+
+  col1 = gimp_gegl_cow_div (rect->x + cow->shift_x, cow->tile_width);
+  row1 = gimp_gegl_cow_div (rect->y + cow->shift_y, cow->tile_height);
+  col2 = gimp_gegl_cow_div (rect->x + cow->shift_x + rect->width - 1,
+                            cow->tile_width);
+  row2 = gimp_gegl_cow_div (rect->y + cow->shift_y + rect->height - 1,
+                            cow->tile_height);
+
+  col1 = MAX (col1 - cow->col0, 0);
+  row1 = MAX (row1 - cow->row0, 0);
+  col2 = MIN (col2 - cow->col0, cow->n_cols - 1);
+  row2 = MIN (row2 - cow->row0, cow->n_rows - 1);
+
+  g_mutex_lock (&group->mutex);
+
+  for (row = row1; row <= row2; row++)
+    for (col = col1; col <= col2; col++)
+      {
+        guint32 *id = &cow->ids[row * cow->n_cols + col];
+
+        if (*id)
+          {
+            gimp_gegl_cow_unref_id (group, *id);
+            *id = 0;
+
+            unshared = TRUE;
+          }
+      }
+
+  if (unshared)
+    group->stamp++;
+
+  g_mutex_unlock (&group->mutex);
+}
+
+static void
+gimp_gegl_cow_buffer_notify (CowBuffer *cow,
+                             GObject   *where_the_buffer_was)
+{
+  CowGroup *group = cow->group;
+  gint      i;
+
+  g_mutex_lock (&group->mutex);
+
+  for (i = 0; i < cow->n_cols * cow->n_rows; i++)
+    {
+      if (cow->ids[i])
+        gimp_gegl_cow_unref_id (group, cow->ids[i]);
+    }
+
+  group->buffers = g_list_remove (group->buffers, cow);
+  group->stamp++;
+
+  gimp_gegl_cow_buffer_free (cow);
+
+  /*  a buffer can't share with itself, dissolve the group  */
+  if (group->buffers && ! group->buffers->next)
+    {
+      CowBuffer *last = group->buffers->data;
+
+      g_signal_handler_disconnect (last->buffer, last->changed_id);
+      g_object_weak_unref (G_OBJECT (last->buffer),
+                           (GWeakNotify) gimp_gegl_cow_buffer_notify, last);
+      g_object_set_data (G_OBJECT (last->buffer), "gimp-gegl-cow", NULL);
+
+      gimp_gegl_cow_buffer_free (last);
+
+      g_list_free (group->buffers);
+      group->buffers = NULL;
+    }
+
+  g_mutex_unlock (&group->mutex);
+
+  if (! group->buffers)
+    {
+      g_hash_table_unref (group->refs);
+      g_mutex_clear (&group->mutex);
+
+      g_slice_free (CowGroup, group);
+    }
+}
+
+static void
+gimp_gegl_cow_share (GeglBuffer *src,
+                     GeglBuffer *dest)
+{
+  CowBuffer *src_cow;
+  CowBuffer *dest_cow;
+  CowGroup  *group;
+  gint       col, row;
+
+  src_cow = g_object_get_data (G_OBJECT (src), "gimp-gegl-cow");
+
+  if (src_cow)
+    {
+      group = src_cow->group;
+
+      g_mutex_lock (&group->mutex);
+    }
+  else
+    {
+      group = g_slice_new0 (CowGroup);
+
+      g_mutex_init (&group->mutex);
+      group->refs = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+      g_mutex_lock (&group->mutex);
+
+      src_cow = gimp_gegl_cow_buffer_new (group, src);
+    }
+
+  dest_cow = gimp_gegl_cow_buffer_new (group, dest);
+
+  /*  GEGL only shares the tiles which are completely inside the
+   *  copied area, the others are copied
+   */
+  if (src_cow->tile_width  == dest_cow->tile_width  &&
+      src_cow->tile_height == dest_cow->tile_height &&
+      src_cow->bpp         == dest_cow->bpp         &&
+      gegl_rectangle_equal (&src_cow->extent, &dest_cow->extent))
+    {
+      for (row = 0; row < src_cow->n_rows; row++)
+        for (col = 0; col < src_cow->n_cols; col++)
+          {
+            gint     i = row * src_cow->n_cols + col;
+            guint32 *id;
+            gint     n_ref;
+
+            if (gimp_gegl_cow_tile_size (src_cow, col, row) !=
+                (gint64) src_cow->tile_width * src_cow->tile_height *
+                src_cow->bpp)
+              continue;
+
+            id = &src_cow->ids[i];
+
+            if (! *id)
+              {
+                *id = ++group->next_id;
+
+                g_hash_table_insert (group->refs,
+                                     GUINT_TO_POINTER (*id),
+                                     GINT_TO_POINTER (1));
+              }
+
+            dest_cow->ids[i] = *id;
+
+            n_ref = GPOINTER_TO_INT (g_hash_table_lookup (group->refs,
+                                                          GUINT_TO_POINTER (*id)));
+
+            g_hash_table_insert (group->refs,
+                                 GUINT_TO_POINTER (*id),
+                                 GINT_TO_POINTER (n_ref + 1));
+          }
+    }
+
+  group->stamp++;
+
+  g_mutex_unlock (&group->mutex);
+}
+
+static void
+gimp_gegl_cow_unref_id (CowGroup *group,
+                        guint32   id)
+{
+  gint n_ref = GPOINTER_TO_INT (g_hash_table_lookup (group->refs,
+                                                     GUINT_TO_POINTER (id)));
+
+  if (n_ref > 1)
+    g_hash_table_insert (group->refs,
+                         GUINT_TO_POINTER (id), GINT_TO_POINTER (n_ref - 1));
+  else
+    g_hash_table_remove (group->refs, GUINT_TO_POINTER (id));
+}
+
+/*  the size of the part of a tile inside the buffer's extent  */
+static gint64
+gimp_gegl_cow_tile_size (CowBuffer *cow,
+                         gint       col,
+                         gint       row)
+{
+  GeglRectangle tile;
+  GeglRectangle area;
+
+  tile.x      = (cow->col0 + col) * cow->tile_width;
+  tile.y      = (cow->row0 + row) * cow->tile_height;
+  tile.width  = cow->tile_width;
+  tile.height = cow->tile_height;
+
+  if (! gegl_rectangle_intersect (&area, &tile, &cow->extent))
+    return 0;
+
+  return (gint64) area.width * area.height * cow->bpp;
+}
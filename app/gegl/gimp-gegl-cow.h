@@ -0,0 +1,47 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimp-gegl-cow.h
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GIMP_GEGL_COW_H__
+#define __GIMP_GEGL_COW_H__
+
+
+/*  a copy of @buffer which shares all its tiles with @buffer until
+ *  either of them is written to
+ */
+GeglBuffer * gimp_gegl_buffer_dup          (GeglBuffer          *buffer);
+
+/*  a new buffer of @rect's size at (0, 0), mapping to @rect, whose
+ *  tiles line up with @buffer's, so copying @rect from @buffer to it
+ *  shares the tiles instead of copying the pixels
+ */
+GeglBuffer * gimp_gegl_buffer_new_aligned  (GeglBuffer          *buffer,
+                                            const GeglRectangle *rect,
+                                            const Babl          *format);
+
+/*  the memory used by @buffer, split into the tiles only @buffer uses
+ *  and its share of the tiles it shares with other buffers, returns
+ *  FALSE if @buffer was not made by gimp_gegl_buffer_dup() and
+ *  doesn't share tiles that way
+ */
+gboolean     gimp_gegl_buffer_get_cow_size (GeglBuffer          *buffer,
+                                            gint64              *unique_size,
+                                            gint64              *shared_size);
+
+
+#endif /* __GIMP_GEGL_COW_H__ */
@@ -0,0 +1,317 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimp-gegl-distance.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <gegl.h>
+
+#include "libgimpmath/gimpmath.h"
+
+#include "gimp-gegl-types.h"
+
+#include "core/gimp-parallel.h"
+
+#include "gimp-gegl-distance.h"
+
+
+/*  This is the separable algorithm from A. Meijster, J.B.T.M. Roerdink
+ *  and W.H. Hesselink, "A General Algorithm for Computing Distance
+ *  Transforms in Linear Time": the first phase computes the vertical
+ *  distance to the background in each column, the second phase the
+ *  lower envelope of the resulting distance functions in each row.
+ *  Both phases are linear in the number of pixels, and the columns
+ *  and rows are independent, so each phase is run in parallel.
+ */
+
+#define MIN_PARALLEL_COLUMNS 64
+#define MIN_PARALLEL_ROWS    16
+
+
+typedef struct
+{
+  gfloat             *data;
+  gint                width;
+  gint                height;
+  GimpDistanceMetric  metric;
+  gboolean            edges_are_background;
+  gint64              inf;
+} DistanceData;
+
+
+/*  local function prototypes  */
+
+static void          distance_columns_func (gsize         offset,
+                                            gsize         size,
+                                            gpointer      user_data);
+static void          distance_rows_func    (gsize         offset,
+                                            gsize         size,
+                                            gpointer      user_data);
+
+static inline gint64 distance_f            (GimpDistanceMetric  metric,
+                                            gint64              x,
+                                            gint64              i,
+                                            gint64              g_i);
+static inline gint64 distance_sep          (GimpDistanceMetric  metric,
+                                            gint64              i,
+                                            gint64              u,
+                                            gint64              g_i,
+                                            gint64              g_u,
+                                            gint64              inf);
+
+
+/*  public functions  */
+
+void
+gimp_gegl_distance_transform (gfloat             *data,
+                              gint                width,
+                              gint                height,
+                              GimpDistanceMetric  metric,
+                              gboolean            edges_are_background)
+{
+  DistanceData distance;
+
+  g_return_if_fail (data != NULL);
+
+  if (width <= 0 || height <= 0)
+    return;
+
+  distance.data                 = data;
+  distance.width                = width;
+  distance.height               = height;
+  distance.metric               = metric;
+  distance.edges_are_background = edges_are_background;
+  distance.inf                  = (gint64) width + height + 2;
+
+  gimp_parallel_distribute_range (width, MIN_PARALLEL_COLUMNS,
+                                  distance_columns_func, &distance);
+
+  gimp_parallel_distribute_range (height, MIN_PARALLEL_ROWS,
+                                  distance_rows_func, &distance);
+}
+
+
+/*  private functions  */
+
+/*  phase 1: replace every pixel by the vertical distance to the
+ *  nearest background pixel in its column, walking the columns
+ *  row by row so the memory is accessed linearly
+ */
+static void
+distance_columns_func (gsize    offset,
+                       gsize    size,
+                       gpointer user_data)
+{
+  DistanceData *distance = user_data;
+  gint          width    = distance->width;
+  gint          height   = distance->height;
+  gfloat        inf      = distance->inf;
+  gfloat       *row;
+  gint          x, y;
+
+  row = distance->data + offset;
+
+  for (x = 0; x < size; x++)
+    {
+      if (row[x] > 0.0)
+        row[x] = distance->edges_are_background ? 1.0 : inf;
+      else
+        row[x] = 0.0;
+    }
+
+  for (y = 1; y < height; y++)
+    {
+      gfloat *prev = row;
+
+      row += width;
+
+      for (x = 0; x < size; x++)
+        {
+          if (row[x] > 0.0)
+            row[x] = MIN (prev[x] + 1.0, inf);
+          else
+            row[x] = 0.0;
+        }
+    }
+
+  if (distance->edges_are_background)
+    {
+      for (x = 0; x < size; x++)
+        row[x] = MIN (row[x], 1.0);
+    }
+
+  for (y = height - 2; y >= 0; y--)
+    {
+      gfloat *next = row;
+
+      row -= width;
+
+      for (x = 0; x < size; x++)
+        {
+          if (next[x] + 1.0 < row[x])
+            row[x] = next[x] + 1.0;
+        }
+    }
+}
+
+/*  phase 2: find, for each pixel, the column whose vertical distance
+ *  results in the smallest distance, using the lower envelope of the
+ *  columns' distance functions
+ */
+static void
+distance_rows_func (gsize    offset,
+                    gsize    size,
+                    gpointer user_data)
+{
+  DistanceData       *distance = user_data;
+  GimpDistanceMetric  metric   = distance->metric;
+  gint64              inf      = distance->inf;
+  gint                width    = distance->width;
+  gint                border   = distance->edges_are_background ? 1 : 0;
+  gint                n        = width + 2 * border;
+  gint64             *g        = g_new (gint64, n);
+  gint               *s        = g_new (gint, n);
+  gint               *t        = g_new (gint, n);
+  gint                y;
+
+  /*  with edges_are_background, the row is framed by a background
+   *  column on each side, u is the position in the framed row
+   */
+  if (border)
+    {
+      g[0]     = 0;
+      g[n - 1] = 0;
+    }
+
+  for (y = offset; y < offset + size; y++)
+    {
+      gfloat *row = distance->data + (gsize) y * width;
+      gint    q;
+      gint    u;
+
+      for (u = 0; u < width; u++)
+        g[u + border] = row[u];
+
+      q    = 0;
+      s[0] = 0;
+      t[0] = 0;
+
+      for (u = 1; u < n; u++)
+        {
+          while (q >= 0 &&
+                 distance_f (metric, t[q], s[q], g[s[q]]) >
+                 distance_f (metric, t[q], u,    g[u]))
+            {
+              q--;
+            }
+
+          if (q < 0)
+            {
+              q    = 0;
+              s[0] = u;
+            }
+          else
+            {
+              gint64 w = 1 + distance_sep (metric, s[q], u,
+                                           g[s[q]], g[u], inf);
+
+              if (w < n)
+                {
+                  q++;
+                  s[q] = u;
+                  t[q] = w;
+                }
+            }
+        }
+
+      for (u = n - 1; u >= 0; u--)
+        {
+          if (u >= border && u < width + border)
+            {
+              gint64 d = distance_f (metric, u, s[q], g[s[q]]);
+
+              if (metric == GIMP_DISTANCE_METRIC_EUCLIDEAN)
+                row[u - border] = sqrt (d);
+              else
+                row[u - border] = d;
+            }
+
+          if (u == t[q])
+            q--;
+        }
+    }
+
+  g_free (g);
+  g_free (s);
+  g_free (t);
+}
+
+static inline gint64
+distance_f (GimpDistanceMetric metric,
+            gint64             x,
+            gint64             i,
+            gint64             g_i)
+{
+  switch (metric)
+    {
+    case GIMP_DISTANCE_METRIC_EUCLIDEAN:
+      return SQR (x - i) + SQR (g_i);
+
+    case GIMP_DISTANCE_METRIC_MANHATTAN:
+      return ABS (x - i) + g_i;
+
+    case GIMP_DISTANCE_METRIC_CHEBYSHEV:
+      return MAX (ABS (x - i), g_i);
+    }
+
+  return 0;
+}
+
+/*  the first position from which column u is at least as close as
+ *  column i (i < u)
+ */
+static inline gint64
+distance_sep (GimpDistanceMetric metric,
+              gint64             i,
+              gint64             u,
+              gint64             g_i,
+              gint64             g_u,
+              gint64             inf)
+{
+  switch (metric)
+    {
+    case GIMP_DISTANCE_METRIC_EUCLIDEAN:
+      return (SQR (u) - SQR (i) + SQR (g_u) - SQR (g_i)) / (2 * (u - i));
+
+    case GIMP_DISTANCE_METRIC_MANHATTAN:
+      if (g_u >= g_i + u - i)
+        return inf + u;
+      else if (g_i > g_u + u - i)
+        return -inf;
+      else
+        return (g_u - g_i + u + i) / 2;
+
+    case GIMP_DISTANCE_METRIC_CHEBYSHEV:
+      if (g_i <= g_u)
+        return MAX (i + g_u, (i + u) / 2);
+      else
+        return MIN (u - g_i, (i + u) / 2);
+    }
+
+  return 0;
+}
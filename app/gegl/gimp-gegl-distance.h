@@ -0,0 +1,37 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimp-gegl-distance.h
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GIMP_GEGL_DISTANCE_H__
+#define __GIMP_GEGL_DISTANCE_H__
+
+
+/*  exact distance transform of a linear width x height buffer:
+ *  every pixel that is > 0.0 is replaced by its distance to the
+ *  nearest pixel that is <= 0.0, those are set to 0.0.  If
+ *  edges_are_background is TRUE, the pixels just outside of the
+ *  buffer count as background too.
+ */
+void   gimp_gegl_distance_transform (gfloat              *data,
+                                     gint                 width,
+                                     gint                 height,
+                                     GimpDistanceMetric   metric,
+                                     gboolean             edges_are_background);
+
+
+#endif /* __GIMP_GEGL_DISTANCE_H__ */
@@ -38,6 +38,37 @@ gimp_cage_mode_get_type (void)
   return type;
 }
 
+GType
+gimp_distance_metric_get_type (void)
+{
+  static const GEnumValue values[] =
+  {
+    { GIMP_DISTANCE_METRIC_EUCLIDEAN, "GIMP_DISTANCE_METRIC_EUCLIDEAN", "euclidean" },
+    { GIMP_DISTANCE_METRIC_MANHATTAN, "GIMP_DISTANCE_METRIC_MANHATTAN", "manhattan" },
+    { GIMP_DISTANCE_METRIC_CHEBYSHEV, "GIMP_DISTANCE_METRIC_CHEBYSHEV", "chebyshev" },
+    { 0, NULL, NULL }
+  };
+
+  static const GimpEnumDesc descs[] =
+  {
+    { GIMP_DISTANCE_METRIC_EUCLIDEAN, NC_("distance-metric", "Euclidean"), NULL },
+    { GIMP_DISTANCE_METRIC_MANHATTAN, NC_("distance-metric", "Manhattan"), NULL },
+    { GIMP_DISTANCE_METRIC_CHEBYSHEV, NC_("distance-metric", "Chebyshev"), NULL },
+    { 0, NULL, NULL }
+  };
+
+  static GType type = 0;
+
+  if (G_UNLIKELY (! type))
+    {
+      type = g_enum_register_static ("GimpDistanceMetric", values);
+      gimp_type_set_translation_context (type, "distance-metric");
+      gimp_enum_set_value_descriptions (type, descs);
+    }
+
+  return type;
+}
+
 
 /* Generated data ends here */
 
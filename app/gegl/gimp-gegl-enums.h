@@ -32,4 +32,16 @@ typedef enum
 } GimpCageMode;
 
 
+#define GIMP_TYPE_DISTANCE_METRIC (gimp_distance_metric_get_type ())
+
+GType gimp_distance_metric_get_type (void) G_GNUC_CONST;
+
+typedef enum
+{
+  GIMP_DISTANCE_METRIC_EUCLIDEAN, /*< desc="Euclidean" >*/
+  GIMP_DISTANCE_METRIC_MANHATTAN, /*< desc="Manhattan" >*/
+  GIMP_DISTANCE_METRIC_CHEBYSHEV  /*< desc="Chebyshev" >*/
+} GimpDistanceMetric;
+
+
 #endif /* __GIMP_GEGL_ENUMS_H__ */
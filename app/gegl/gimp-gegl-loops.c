@@ -20,6 +20,8 @@
 
 #include "config.h"
 
+#include <string.h>
+
 #include <gegl.h>
 
 #include "libgimpmath/gimpmath.h"
@@ -601,3 +603,78 @@ gimp_gegl_replace (GeglBuffer          *top_buffer,
         }
     }
 }
+
+void
+gimp_gegl_downsample (GeglBuffer *src_buffer,
+                      GeglBuffer *dest_buffer)
+{
+  const Babl *format      = gegl_buffer_get_format (dest_buffer);
+  gint        bpp         = babl_format_get_bytes_per_pixel (format);
+  gint        src_width   = gegl_buffer_get_width  (src_buffer);
+  gint        src_height  = gegl_buffer_get_height (src_buffer);
+  gint        dest_width  = gegl_buffer_get_width  (dest_buffer);
+  gint        dest_height = gegl_buffer_get_height (dest_buffer);
+  gint        strip       = 64;
+  gboolean    box_filter;
+  guchar     *src_data    = NULL;
+  guchar     *dest_data;
+  gint        y;
+
+  /*  let GEGL average 2x2 blocks unless the size isn't exactly halved
+   *  or averaging makes no sense, like for palette indices, in which
+   *  case every other pixel is picked
+   */
+  box_filter = (! babl_format_is_palette (format) &&
+                dest_width  == src_width  / 2   &&
+                dest_height == src_height / 2);
+
+  dest_data = g_malloc ((gsize) dest_width * strip * bpp);
+
+  if (! box_filter)
+    src_data = g_malloc ((gsize) src_width * bpp);
+
+  for (y = 0; y < dest_height; y += strip)
+    {
+      gint rows = MIN (strip, dest_height - y);
+
+      if (box_filter)
+        {
+          gegl_buffer_get (src_buffer,
+                           GEGL_RECTANGLE (0, y, dest_width, rows), 0.5,
+                           format, dest_data,
+                           GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+        }
+      else
+        {
+          gint row;
+
+          for (row = 0; row < rows; row++)
+            {
+              guchar *dest = dest_data + (gsize) row * dest_width * bpp;
+              gint    src_y;
+              gint    x;
+
+              src_y = MIN (2 * (y + row), src_height - 1);
+
+              gegl_buffer_get (src_buffer,
+                               GEGL_RECTANGLE (0, src_y, src_width, 1), 1.0,
+                               format, src_data,
+                               GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+              for (x = 0; x < dest_width; x++)
+                {
+                  gint src_x = MIN (2 * x, src_width - 1);
+
+                  memcpy (dest + x * bpp, src_data + src_x * bpp, bpp);
+                }
+            }
+        }
+
+      gegl_buffer_set (dest_buffer,
+                       GEGL_RECTANGLE (0, y, dest_width, rows), 0,
+                       format, dest_data, GEGL_AUTO_ROWSTRIDE);
+    }
+
+  g_free (src_data);
+  g_free (dest_data);
+}
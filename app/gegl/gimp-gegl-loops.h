@@ -81,5 +81,11 @@ void   gimp_gegl_replace            (GeglBuffer          *top_buffer,
                                      gdouble              opacity,
                                      const gboolean      *affect);
 
+/*  halves @src_buffer into @dest_buffer, which must be half its size,
+ *  rounded down but at least 1x1
+ */
+void   gimp_gegl_downsample         (GeglBuffer          *src_buffer,
+                                     GeglBuffer          *dest_buffer);
+
 
 #endif /* __GIMP_GEGL_LOOPS_H__ */
@@ -90,16 +90,19 @@ static void
 gimp_tile_handler_projection_init (GimpTileHandlerProjection *projection)
 {
   GeglTileSource *source = GEGL_TILE_SOURCE (projection);
+  gint            z;
 
   source->command = gimp_tile_handler_projection_command;
 
-  projection->dirty_region = cairo_region_create ();
+  for (z = 0; z < GIMP_TILE_HANDLER_PROJECTION_MAX_LEVELS; z++)
+    projection->dirty_regions[z] = cairo_region_create ();
 }
 
 static void
 gimp_tile_handler_projection_finalize (GObject *object)
 {
   GimpTileHandlerProjection *projection = GIMP_TILE_HANDLER_PROJECTION (object);
+  gint                       z;
 
   if (projection->graph)
     {
@@ -107,8 +110,11 @@ gimp_tile_handler_projection_finalize (GObject *object)
       projection->graph = NULL;
     }
 
-  cairo_region_destroy (projection->dirty_region);
-  projection->dirty_region = NULL;
+  for (z = 0; z < GIMP_TILE_HANDLER_PROJECTION_MAX_LEVELS; z++)
+    {
+      cairo_region_destroy (projection->dirty_regions[z]);
+      projection->dirty_regions[z] = NULL;
+    }
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
@@ -179,10 +185,10 @@ gimp_tile_handler_projection_validate (GeglTileSource *source,
 
   projection = GIMP_TILE_HANDLER_PROJECTION (source);
 
-  if (cairo_region_is_empty (projection->dirty_region))
+  if (cairo_region_is_empty (projection->dirty_regions[0]))
     return tile;
 
-  tile_region = cairo_region_copy (projection->dirty_region);
+  tile_region = cairo_region_copy (projection->dirty_regions[0]);
 
   tile_rect.x      = x * projection->tile_width;
   tile_rect.y      = y * projection->tile_height;
@@ -202,7 +208,8 @@ gimp_tile_handler_projection_validate (GeglTileSource *source,
         tile = gegl_tile_handler_create_tile (GEGL_TILE_HANDLER (source),
                                               x, y, 0);
 
-      cairo_region_subtract_rectangle (projection->dirty_region, &tile_rect);
+      cairo_region_subtract_rectangle (projection->dirty_regions[0],
+                                       &tile_rect);
 
       tile_bpp    = babl_format_get_bytes_per_pixel (projection->format);
       tile_stride = tile_bpp * projection->tile_width;
@@ -250,6 +257,153 @@ gimp_tile_handler_projection_validate (GeglTileSource *source,
   return tile;
 }
 
+static gboolean
+gimp_tile_handler_projection_reduce (GimpTileHandlerProjection *projection,
+                                     GeglTile                  *tile,
+                                     gint                       x,
+                                     gint                       y,
+                                     gint                       z)
+{
+  GeglTileSource        *source = GEGL_TILE_SOURCE (projection);
+  const Babl            *float_format;
+  cairo_rectangle_int_t  src_rect;
+  gint                   tile_width  = projection->tile_width;
+  gint                   tile_height = projection->tile_height;
+  gint                   half_width  = tile_width  / 2;
+  gint                   half_height = tile_height / 2;
+  gfloat                *src;
+  gfloat                *dest;
+  gint                   i, j;
+
+  /*  the level above can only be reduced if the whole area covered
+   *  by this tile is valid there, otherwise we would have to render
+   *  four times as many pixels as rendering this level directly
+   */
+  src_rect.x      = x * tile_width  * 2;
+  src_rect.y      = y * tile_height * 2;
+  src_rect.width  = tile_width  * 2;
+  src_rect.height = tile_height * 2;
+
+  if (cairo_region_contains_rectangle (projection->dirty_regions[z - 1],
+                                       &src_rect) != CAIRO_REGION_OVERLAP_OUT)
+    return FALSE;
+
+  float_format = babl_format ("RaGaBaA float");
+
+  src  = g_new  (gfloat, tile_width * tile_height * 4);
+  dest = g_new0 (gfloat, tile_width * tile_height * 4);
+
+  for (j = 0; j < 2; j++)
+    {
+      for (i = 0; i < 2; i++)
+        {
+          GeglTile *src_tile;
+          gint      row;
+
+          src_tile = gimp_tile_handler_projection_command (source,
+                                                           GEGL_TILE_GET,
+                                                           x * 2 + i,
+                                                           y * 2 + j,
+                                                           z - 1,
+                                                           NULL);
+          if (! src_tile)
+            continue;
+
+          babl_process (babl_fish (projection->format, float_format),
+                        gegl_tile_get_data (src_tile), src,
+                        tile_width * tile_height);
+
+          gegl_tile_unref (src_tile);
+
+          for (row = 0; row < half_height; row++)
+            {
+              const gfloat *s0 = src + row * 2 * tile_width * 4;
+              const gfloat *s1 = s0 + tile_width * 4;
+              gfloat       *d;
+              gint          col;
+
+              d = dest + ((j * half_height + row) * tile_width +
+                          i * half_width) * 4;
+
+              for (col = 0; col < half_width; col++)
+                {
+                  gint c;
+
+                  for (c = 0; c < 4; c++)
+                    d[c] = 0.25f * (s0[c] + s0[4 + c] + s1[c] + s1[4 + c]);
+
+                  s0 += 8;
+                  s1 += 8;
+                  d  += 4;
+                }
+            }
+        }
+    }
+
+  babl_process (babl_fish (float_format, projection->format),
+                dest, gegl_tile_get_data (tile),
+                tile_width * tile_height);
+
+  g_free (src);
+  g_free (dest);
+
+  return TRUE;
+}
+
+static GeglTile *
+gimp_tile_handler_projection_validate_level (GeglTileSource *source,
+                                             gint            x,
+                                             gint            y,
+                                             gint            z)
+{
+  GimpTileHandlerProjection *projection;
+  GeglTile                  *tile;
+  cairo_rectangle_int_t      tile_rect;
+
+  projection = GIMP_TILE_HANDLER_PROJECTION (source);
+
+  tile_rect.x      = x * projection->tile_width;
+  tile_rect.y      = y * projection->tile_height;
+  tile_rect.width  = projection->tile_width;
+  tile_rect.height = projection->tile_height;
+
+  if (cairo_region_contains_rectangle (projection->dirty_regions[z],
+                                       &tile_rect) == CAIRO_REGION_OVERLAP_OUT)
+    return gegl_tile_handler_source_command (source, GEGL_TILE_GET,
+                                             x, y, z, NULL);
+
+  cairo_region_subtract_rectangle (projection->dirty_regions[z], &tile_rect);
+
+  /*  don't let the tile storage build the stale tile from the level
+   *  above, we construct it ourselves
+   */
+  gegl_tile_handler_source_command (source, GEGL_TILE_VOID, x, y, z, NULL);
+
+  tile = gegl_tile_handler_create_tile (GEGL_TILE_HANDLER (source), x, y, z);
+
+  gegl_tile_lock (tile);
+
+  if (! gimp_tile_handler_projection_reduce (projection, tile, x, y, z))
+    {
+      gint tile_bpp    = babl_format_get_bytes_per_pixel (projection->format);
+      gint tile_stride = tile_bpp * projection->tile_width;
+
+      gegl_node_blit (projection->graph, 1.0 / (gdouble) (1 << z),
+                      GEGL_RECTANGLE (tile_rect.x,
+                                      tile_rect.y,
+                                      tile_rect.width,
+                                      tile_rect.height),
+                      projection->format,
+                      gegl_tile_get_data (tile),
+                      tile_stride,
+                      GEGL_BLIT_DEFAULT);
+    }
+
+  gegl_tile_unlock (tile);
+
+  return tile;
+}
+
 static gpointer
 gimp_tile_handler_projection_command (GeglTileSource  *source,
                                       GeglTileCommand  command,
@@ -258,7 +412,13 @@ gimp_tile_handler_projection_command (GeglTileSource  *source,
                                       gint             z,
                                       gpointer         data)
 {
-  gpointer retval;
+  GimpTileHandlerProjection *projection;
+  gpointer                   retval;
+
+  projection = GIMP_TILE_HANDLER_PROJECTION (source);
+
+  if (command == GEGL_TILE_GET && z > 0 && z <= projection->max_z)
+    return gimp_tile_handler_projection_validate_level (source, x, y, z);
 
   retval = gegl_tile_handler_source_command (source, command, x, y, z, data);
 
@@ -283,6 +443,9 @@ gimp_tile_handler_projection_update_max_z (GimpTileHandlerProjection *projection
 
       while (n_tiles >>= 1)
         projection->max_z++;
+
+      projection->max_z = MIN (projection->max_z,
+                               GIMP_TILE_HANDLER_PROJECTION_MAX_LEVELS - 1);
     }
 }
 
@@ -301,21 +464,9 @@ gimp_tile_handler_projection_new (GeglNode *graph,
   projection->proj_width  = proj_width;
   projection->proj_height = proj_height;
 
-  return GEGL_TILE_HANDLER (projection);
-}
+  gimp_tile_handler_projection_update_max_z (projection);
 
-static void
-gimp_tile_handler_projection_void_pyramid (GeglTileSource *source,
-                                           gint            x,
-                                           gint            y,
-                                           gint            z,
-                                           gint            max_z)
-{
-  gegl_tile_source_void (source, x, y, z);
-
-  if (z < max_z)
-    gimp_tile_handler_projection_void_pyramid (source, x / 2, y / 2, z + 1,
-                                               max_z);
+  return GEGL_TILE_HANDLER (projection);
 }
 
 void
@@ -325,31 +476,89 @@ gimp_tile_handler_projection_invalidate (GimpTileHandlerProjection *projection,
                                          gint                       width,
                                          gint                       height)
 {
-  cairo_rectangle_int_t rect = { x, y, width, height };
+  gint z;
 
   g_return_if_fail (GIMP_IS_TILE_HANDLER_PROJECTION (projection));
 
-  cairo_region_union_rectangle (projection->dirty_region, &rect);
+  if (width <= 0 || height <= 0)
+    return;
 
-  if (projection->max_z > 0)
+  for (z = 0; z <= projection->max_z; z++)
     {
-      gint tile_x1 = x / projection->tile_width;
-      gint tile_y1 = y / projection->tile_height;
-      gint tile_x2 = (x + width  - 1) / projection->tile_width;
-      gint tile_y2 = (y + height - 1) / projection->tile_height;
-      gint tile_x;
-      gint tile_y;
-
-      for (tile_y = tile_y1; tile_y <= tile_y2; tile_y++)
+      cairo_rectangle_int_t rect;
+      gint                  x1 = x >> z;
+      gint                  y1 = y >> z;
+      gint                  x2 = (x + width  + (1 << z) - 1) >> z;
+      gint                  y2 = (y + height + (1 << z) - 1) >> z;
+
+      rect.x      = x1;
+      rect.y      = y1;
+      rect.width  = x2 - x1;
+      rect.height = y2 - y1;
+
+      cairo_region_union_rectangle (projection->dirty_regions[z], &rect);
+
+      /*  level 0 is validated in place, the other levels' stale tiles
+       *  are dropped and constructed from scratch on demand
+       */
+      if (z > 0)
         {
-          for (tile_x = tile_x1; tile_x <= tile_x2; tile_x++)
-            {
-              gimp_tile_handler_projection_void_pyramid (GEGL_TILE_SOURCE (projection),
-                                                         tile_x / 2,
-                                                         tile_y / 2,
-                                                         1,
-                                                         projection->max_z);
-            }
+          gint tile_x1 = x1 / projection->tile_width;
+          gint tile_y1 = y1 / projection->tile_height;
+          gint tile_x2 = (x2 - 1) / projection->tile_width;
+          gint tile_y2 = (y2 - 1) / projection->tile_height;
+          gint tile_x;
+          gint tile_y;
+
+          for (tile_y = tile_y1; tile_y <= tile_y2; tile_y++)
+            for (tile_x = tile_x1; tile_x <= tile_x2; tile_x++)
+              gegl_tile_source_void (GEGL_TILE_SOURCE (projection),
+                                     tile_x, tile_y, z);
+        }
+    }
+}
+
+/*  Constructs all tiles of @level that intersect the given area (in
+ *  level 0 coordinates).  This renders the graph, so it must only be
+ *  called from the main thread.
+ */
+void
+gimp_tile_handler_projection_validate_area (GimpTileHandlerProjection *projection,
+                                            gint                       x,
+                                            gint                       y,
+                                            gint                       width,
+                                            gint                       height,
+                                            gint                       level)
+{
+  gint tile_x1, tile_y1;
+  gint tile_x2, tile_y2;
+  gint tile_x, tile_y;
+
+  g_return_if_fail (GIMP_IS_TILE_HANDLER_PROJECTION (projection));
+
+  if (width <= 0 || height <= 0)
+    return;
+
+  level = CLAMP (level, 0, projection->max_z);
+
+  tile_x1 = (x >> level) / projection->tile_width;
+  tile_y1 = (y >> level) / projection->tile_height;
+  tile_x2 = (((x + width  + (1 << level) - 1) >> level) - 1) /
+            projection->tile_width;
+  tile_y2 = (((y + height + (1 << level) - 1) >> level) - 1) /
+            projection->tile_height;
+
+  for (tile_y = tile_y1; tile_y <= tile_y2; tile_y++)
+    {
+      for (tile_x = tile_x1; tile_x <= tile_x2; tile_x++)
+        {
+          GeglTile *tile;
+
+          tile = gegl_tile_source_get_tile (GEGL_TILE_SOURCE (projection),
+                                            tile_x, tile_y, level);
+
+          if (tile)
+            gegl_tile_unref (tile);
         }
     }
 }
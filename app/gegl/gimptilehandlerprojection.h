@@ -23,6 +23,12 @@
 /***
  * GimpTileHandlerProjection is a GeglTileHandler that renders the
  * projection.
+ *
+ * Every level of the tile pyramid keeps its own dirty region, so
+ * zoomed-out views validate only the low-resolution tiles they
+ * actually display, either straight from the graph at the level's
+ * scale or by reducing the four already valid tiles of the level
+ * above.
  */
 
 G_BEGIN_DECLS
@@ -35,6 +41,9 @@ G_BEGIN_DECLS
 #define GIMP_TILE_HANDLER_PROJECTION_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj),  GIMP_TYPE_TILE_HANDLER_PROJECTION, GimpTileHandlerProjectionClass))
 
 
+#define GIMP_TILE_HANDLER_PROJECTION_MAX_LEVELS 16
+
+
 typedef struct _GimpTileHandlerProjection      GimpTileHandlerProjection;
 typedef struct _GimpTileHandlerProjectionClass GimpTileHandlerProjectionClass;
 
@@ -43,7 +52,7 @@ struct _GimpTileHandlerProjection
   GeglTileHandler  parent_instance;
 
   GeglNode        *graph;
-  cairo_region_t  *dirty_region;
+  cairo_region_t  *dirty_regions[GIMP_TILE_HANDLER_PROJECTION_MAX_LEVELS];
   const Babl      *format;
   gint             tile_width;
   gint             tile_height;
@@ -58,16 +67,22 @@ struct _GimpTileHandlerProjectionClass
 };
 
 
-GType             gimp_tile_handler_projection_get_type   (void) G_GNUC_CONST;
-GeglTileHandler * gimp_tile_handler_projection_new        (GeglNode                  *graph,
-                                                           gint                       proj_width,
-                                                           gint                       proj_height);
-
-void              gimp_tile_handler_projection_invalidate (GimpTileHandlerProjection *projection,
-                                                           gint                       x,
-                                                           gint                       y,
-                                                           gint                       width,
-                                                           gint                       height);
+GType             gimp_tile_handler_projection_get_type      (void) G_GNUC_CONST;
+GeglTileHandler * gimp_tile_handler_projection_new           (GeglNode                  *graph,
+                                                              gint                       proj_width,
+                                                              gint                       proj_height);
+
+void              gimp_tile_handler_projection_invalidate    (GimpTileHandlerProjection *projection,
+                                                              gint                       x,
+                                                              gint                       y,
+                                                              gint                       width,
+                                                              gint                       height);
+void              gimp_tile_handler_projection_validate_area (GimpTileHandlerProjection *projection,
+                                                              gint                       x,
+                                                              gint                       y,
+                                                              gint                       width,
+                                                              gint                       height,
+                                                              gint                       level);
 
 
 G_END_DECLS
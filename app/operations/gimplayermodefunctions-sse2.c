@@ -0,0 +1,720 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995-1999 Spencer Kimball and Peter Mattis
+ *
+ * gimplayermodefunctions-sse2.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <gegl.h>
+
+#include "operations-types.h"
+
+#include "gimplayermodefunctions-sse2.h"
+
+
+#ifdef USE_SSE2
+
+#include <emmintrin.h>
+
+
+/*  SSE2 variants of the layer mode functions.
+ *
+ *  Blocks of four pixels are transposed so that each vector holds one
+ *  channel of all four pixels, and the per-pixel branches of the
+ *  generic functions become masks.  Each mode is instantiated for
+ *  every combination of with/without mask and opacity == 1.0, so the
+ *  inner loop tests neither.
+ *
+ *  The results match the generic functions up to rounding, they
+ *  compute in single instead of mixed single/double precision.
+ *  Dissolve, hue, saturation, color and color erase are not
+ *  separable per channel and keep using the generic functions.
+ */
+
+#if defined (__GNUC__)
+#define ALWAYS_INLINE inline __attribute__ ((always_inline))
+#else
+#define ALWAYS_INLINE inline
+#endif
+
+
+typedef struct
+{
+  __m128 c[4];  /*  red, green, blue and alpha of four pixels  */
+} Pixels;
+
+typedef void (* CompFunc)  (const __m128 *in,
+                            const __m128 *layer,
+                            __m128       *comp);
+typedef void (* BlockFunc) (const Pixels *in,
+                            const Pixels *layer,
+                            __m128        value,
+                            gboolean      scale,
+                            Pixels       *out);
+
+
+/*  helpers  */
+
+static ALWAYS_INLINE __m128
+select_ps (__m128 mask,
+           __m128 a,
+           __m128 b)
+{
+  return _mm_or_ps (_mm_and_ps (mask, a), _mm_andnot_ps (mask, b));
+}
+
+static ALWAYS_INLINE __m128
+clamp_ps (__m128 x)
+{
+  return _mm_min_ps (_mm_max_ps (x, _mm_setzero_ps ()), _mm_set1_ps (1.0f));
+}
+
+static ALWAYS_INLINE void
+pixels_load (Pixels       *pixels,
+             const gfloat *src)
+{
+  __m128 r = _mm_loadu_ps (src);
+  __m128 g = _mm_loadu_ps (src + 4);
+  __m128 b = _mm_loadu_ps (src + 8);
+  __m128 a = _mm_loadu_ps (src + 12);
+
+  _MM_TRANSPOSE4_PS (r, g, b, a);
+
+  pixels->c[0] = r;
+  pixels->c[1] = g;
+  pixels->c[2] = b;
+  pixels->c[3] = a;
+}
+
+static ALWAYS_INLINE void
+pixels_store (const Pixels *pixels,
+              gfloat       *dest)
+{
+  __m128 r = pixels->c[0];
+  __m128 g = pixels->c[1];
+  __m128 b = pixels->c[2];
+  __m128 a = pixels->c[3];
+
+  _MM_TRANSPOSE4_PS (r, g, b, a);
+
+  _mm_storeu_ps (dest,      r);
+  _mm_storeu_ps (dest + 4,  g);
+  _mm_storeu_ps (dest + 8,  b);
+  _mm_storeu_ps (dest + 12, a);
+}
+
+
+/*  the pixel loop, specialised on has_mask and opaque  */
+
+static ALWAYS_INLINE void
+process_block (BlockFunc      block,
+               const gfloat  *in,
+               const gfloat  *layer,
+               const gfloat  *mask,
+               gfloat        *out,
+               __m128         opacity,
+               const gboolean has_mask,
+               const gboolean opaque)
+{
+  Pixels src;
+  Pixels aux;
+  Pixels dest;
+  __m128 value = opacity;
+
+  pixels_load (&src, in);
+  pixels_load (&aux, layer);
+
+  if (has_mask)
+    {
+      value = _mm_loadu_ps (mask);
+
+      if (! opaque)
+        value = _mm_mul_ps (value, opacity);
+    }
+
+  block (&src, &aux, value, has_mask || ! opaque, &dest);
+
+  pixels_store (&dest, out);
+}
+
+static ALWAYS_INLINE void
+process (BlockFunc      block,
+         const gfloat  *in,
+         const gfloat  *layer,
+         const gfloat  *mask,
+         gfloat        *out,
+         gfloat         opacity,
+         glong          samples,
+         const gboolean has_mask,
+         const gboolean opaque)
+{
+  const __m128 v_opacity = _mm_set1_ps (opacity);
+
+  for (; samples >= 4; samples -= 4)
+    {
+      process_block (block, in, layer, mask, out, v_opacity,
+                     has_mask, opaque);
+
+      in    += 16;
+      layer += 16;
+      out   += 16;
+
+      if (has_mask)
+        mask += 4;
+    }
+
+  /*  pad the remaining pixels to a whole block  */
+  if (samples > 0)
+    {
+      gfloat in_tail[16]    = { 0.0f, };
+      gfloat layer_tail[16] = { 0.0f, };
+      gfloat mask_tail[4]   = { 0.0f, };
+      gfloat out_tail[16];
+
+      memcpy (in_tail,    in,    samples * 4 * sizeof (gfloat));
+      memcpy (layer_tail, layer, samples * 4 * sizeof (gfloat));
+
+      if (has_mask)
+        memcpy (mask_tail, mask, samples * sizeof (gfloat));
+
+      process_block (block, in_tail, layer_tail, mask_tail, out_tail,
+                     v_opacity, has_mask, opaque);
+
+      memcpy (out, out_tail, samples * 4 * sizeof (gfloat));
+    }
+}
+
+#define DEFINE_MODE(name)                                               \
+static gboolean                                                         \
+name##_mode_process_pixels_sse2 (gfloat              *in,               \
+                                 gfloat              *layer,            \
+                                 gfloat              *mask,             \
+                                 gfloat              *out,              \
+                                 gdouble              opacity,          \
+                                 glong                samples,          \
+                                 const GeglRectangle *roi,              \
+                                 gint                 level)            \
+{                                                                       \
+  if (mask && opacity == 1.0)                                           \
+    process (name##_block, in, layer, mask, out, 1.0f, samples,         \
+             TRUE, TRUE);                                               \
+  else if (mask)                                                        \
+    process (name##_block, in, layer, mask, out, opacity, samples,      \
+             TRUE, FALSE);                                              \
+  else if (opacity == 1.0)                                              \
+    process (name##_block, in, layer, NULL, out, 1.0f, samples,         \
+             FALSE, TRUE);                                              \
+  else                                                                  \
+    process (name##_block, in, layer, NULL, out, opacity, samples,      \
+             FALSE, FALSE);                                             \
+                                                                        \
+  return TRUE;                                                          \
+}
+
+
+/*  modes compositing a per-channel result over the input  */
+
+static ALWAYS_INLINE void
+composite_block (CompFunc      comp,
+                 const Pixels *in,
+                 const Pixels *layer,
+                 __m128        value,
+                 gboolean      scale,
+                 Pixels       *out)
+{
+  const __m128 one  = _mm_set1_ps (1.0f);
+  const __m128 zero = _mm_setzero_ps ();
+  __m128       comp_alpha;
+  __m128       new_alpha;
+  __m128       valid;
+  __m128       ratio;
+  __m128       inv_ratio;
+  __m128       c[3];
+  gint         b;
+
+  comp_alpha = _mm_min_ps (in->c[3], layer->c[3]);
+  if (scale)
+    comp_alpha = _mm_mul_ps (comp_alpha, value);
+
+  new_alpha = _mm_add_ps (in->c[3],
+                          _mm_mul_ps (_mm_sub_ps (one, in->c[3]), comp_alpha));
+
+  valid = _mm_and_ps (_mm_cmpneq_ps (comp_alpha, zero),
+                      _mm_cmpneq_ps (new_alpha,  zero));
+
+  ratio     = _mm_div_ps (comp_alpha, select_ps (valid, new_alpha, one));
+  inv_ratio = _mm_sub_ps (one, ratio);
+
+  comp (in->c, layer->c, c);
+
+  for (b = 0; b < 3; b++)
+    {
+      __m128 blend = _mm_add_ps (_mm_mul_ps (c[b],     ratio),
+                                 _mm_mul_ps (in->c[b], inv_ratio));
+
+      out->c[b] = select_ps (valid, blend, in->c[b]);
+    }
+
+  out->c[3] = in->c[3];
+}
+
+#define DEFINE_SEPARABLE_MODE(name)                                     \
+static ALWAYS_INLINE void                                               \
+name##_comp (const __m128 *in,                                          \
+             const __m128 *layer,                                       \
+             __m128       *comp)                                        \
+{                                                                       \
+  comp[0] = name##_channel (in[0], layer[0]);                           \
+  comp[1] = name##_channel (in[1], layer[1]);                           \
+  comp[2] = name##_channel (in[2], layer[2]);                           \
+}                                                                       \
+                                                                        \
+DEFINE_COMPOSITE_MODE (name)
+
+#define DEFINE_COMPOSITE_MODE(name)                                     \
+static ALWAYS_INLINE void                                               \
+name##_block (const Pixels *in,                                         \
+              const Pixels *layer,                                      \
+              __m128        value,                                      \
+              gboolean      scale,                                      \
+              Pixels       *out)                                        \
+{                                                                       \
+  composite_block (name##_comp, in, layer, value, scale, out);          \
+}                                                                       \
+                                                                        \
+DEFINE_MODE (name)
+
+
+static ALWAYS_INLINE __m128
+multiply_channel (__m128 in,
+                  __m128 layer)
+{
+  return clamp_ps (_mm_mul_ps (layer, in));
+}
+
+DEFINE_SEPARABLE_MODE (multiply)
+
+static ALWAYS_INLINE __m128
+screen_channel (__m128 in,
+                __m128 layer)
+{
+  const __m128 one = _mm_set1_ps (1.0f);
+
+  return _mm_sub_ps (one, _mm_mul_ps (_mm_sub_ps (one, in),
+                                      _mm_sub_ps (one, layer)));
+}
+
+DEFINE_SEPARABLE_MODE (screen)
+
+static ALWAYS_INLINE __m128
+overlay_channel (__m128 in,
+                 __m128 layer)
+{
+  const __m128 one = _mm_set1_ps (1.0f);
+  __m128       twice_layer = _mm_add_ps (layer, layer);
+
+  return _mm_mul_ps (in,
+                     _mm_add_ps (in, _mm_mul_ps (twice_layer,
+                                                 _mm_sub_ps (one, in))));
+}
+
+DEFINE_SEPARABLE_MODE (overlay)
+
+static ALWAYS_INLINE __m128
+difference_channel (__m128 in,
+                    __m128 layer)
+{
+  return _mm_andnot_ps (_mm_set1_ps (-0.0f), _mm_sub_ps (in, layer));
+}
+
+DEFINE_SEPARABLE_MODE (difference)
+
+static ALWAYS_INLINE __m128
+addition_channel (__m128 in,
+                  __m128 layer)
+{
+  return clamp_ps (_mm_add_ps (in, layer));
+}
+
+DEFINE_SEPARABLE_MODE (addition)
+
+static ALWAYS_INLINE __m128
+subtract_channel (__m128 in,
+                  __m128 layer)
+{
+  return _mm_max_ps (_mm_sub_ps (in, layer), _mm_setzero_ps ());
+}
+
+DEFINE_SEPARABLE_MODE (subtract)
+
+static ALWAYS_INLINE __m128
+darken_only_channel (__m128 in,
+                     __m128 layer)
+{
+  return _mm_min_ps (in, layer);
+}
+
+DEFINE_SEPARABLE_MODE (darken_only)
+
+static ALWAYS_INLINE __m128
+lighten_only_channel (__m128 in,
+                      __m128 layer)
+{
+  return _mm_max_ps (layer, in);
+}
+
+DEFINE_SEPARABLE_MODE (lighten_only)
+
+static ALWAYS_INLINE __m128
+divide_channel (__m128 in,
+                __m128 layer)
+{
+  __m128 comp = _mm_div_ps (_mm_mul_ps (_mm_set1_ps (256.0f / 255.0f), in),
+                            _mm_add_ps (_mm_set1_ps (1.0f / 255.0f), layer));
+
+  return _mm_min_ps (comp, _mm_set1_ps (1.0f));
+}
+
+DEFINE_SEPARABLE_MODE (divide)
+
+static ALWAYS_INLINE __m128
+dodge_channel (__m128 in,
+               __m128 layer)
+{
+  const __m128 one = _mm_set1_ps (1.0f);
+
+  return _mm_min_ps (_mm_div_ps (in, _mm_sub_ps (one, layer)), one);
+}
+
+DEFINE_SEPARABLE_MODE (dodge)
+
+static ALWAYS_INLINE __m128
+burn_channel (__m128 in,
+              __m128 layer)
+{
+  const __m128 one = _mm_set1_ps (1.0f);
+
+  return clamp_ps (_mm_sub_ps (one, _mm_div_ps (_mm_sub_ps (one, in), layer)));
+}
+
+DEFINE_SEPARABLE_MODE (burn)
+
+static ALWAYS_INLINE __m128
+hardlight_channel (__m128 in,
+                   __m128 layer)
+{
+  const __m128 one  = _mm_set1_ps (1.0f);
+  const __m128 half = _mm_set1_ps (0.5f);
+  const __m128 two  = _mm_set1_ps (2.0f);
+  __m128       screen;
+  __m128       multiply;
+
+  screen = _mm_mul_ps (_mm_sub_ps (one, in),
+                       _mm_sub_ps (one, _mm_mul_ps (_mm_sub_ps (layer, half),
+                                                    two)));
+  screen = _mm_min_ps (_mm_sub_ps (one, screen), one);
+
+  multiply = _mm_min_ps (_mm_mul_ps (in, _mm_mul_ps (layer, two)), one);
+
+  return select_ps (_mm_cmpgt_ps (layer, half), screen, multiply);
+}
+
+DEFINE_SEPARABLE_MODE (hardlight)
+
+static ALWAYS_INLINE __m128
+softlight_channel (__m128 in,
+                   __m128 layer)
+{
+  const __m128 one = _mm_set1_ps (1.0f);
+  __m128       multiply;
+  __m128       screen;
+
+  multiply = _mm_mul_ps (in, layer);
+  screen   = screen_channel (in, layer);
+
+  return _mm_add_ps (_mm_mul_ps (_mm_sub_ps (one, in), multiply),
+                     _mm_mul_ps (in, screen));
+}
+
+DEFINE_SEPARABLE_MODE (softlight)
+
+static ALWAYS_INLINE __m128
+grain_extract_channel (__m128 in,
+                       __m128 layer)
+{
+  return clamp_ps (_mm_add_ps (_mm_sub_ps (in, layer), _mm_set1_ps (0.5f)));
+}
+
+DEFINE_SEPARABLE_MODE (grain_extract)
+
+static ALWAYS_INLINE __m128
+grain_merge_channel (__m128 in,
+                     __m128 layer)
+{
+  return clamp_ps (_mm_sub_ps (_mm_add_ps (in, layer), _mm_set1_ps (0.5f)));
+}
+
+DEFINE_SEPARABLE_MODE (grain_merge)
+
+/*  replacing the HSV value keeps hue and saturation, which scales the
+ *  color by the ratio of the values, gray stays gray
+ */
+static ALWAYS_INLINE void
+value_comp (const __m128 *in,
+            const __m128 *layer,
+            __m128       *comp)
+{
+  __m128 in_max;
+  __m128 in_min;
+  __m128 layer_max;
+  __m128 chroma;
+  __m128 factor;
+  gint   b;
+
+  in_max    = _mm_max_ps (_mm_max_ps (in[0], in[1]), in[2]);
+  in_min    = _mm_min_ps (_mm_min_ps (in[0], in[1]), in[2]);
+  layer_max = _mm_max_ps (_mm_max_ps (layer[0], layer[1]), layer[2]);
+
+  chroma = _mm_cmpgt_ps (_mm_sub_ps (in_max, in_min), _mm_set1_ps (0.0001f));
+  factor = _mm_div_ps (layer_max,
+                       select_ps (chroma, in_max, _mm_set1_ps (1.0f)));
+
+  for (b = 0; b < 3; b++)
+    comp[b] = select_ps (chroma, _mm_mul_ps (in[b], factor), layer_max);
+}
+
+DEFINE_COMPOSITE_MODE (value)
+
+
+/*  modes with their own alpha handling  */
+
+static ALWAYS_INLINE void
+normal_block (const Pixels *in,
+              const Pixels *layer,
+              __m128        value,
+              gboolean      scale,
+              Pixels       *out)
+{
+  const __m128 one = _mm_set1_ps (1.0f);
+  __m128       aux_alpha;
+  __m128       out_alpha;
+  __m128       valid;
+  __m128       in_weight;
+  __m128       recip_out_alpha;
+  gint         b;
+
+  aux_alpha = layer->c[3];
+  if (scale)
+    aux_alpha = _mm_mul_ps (aux_alpha, value);
+
+  out_alpha = _mm_sub_ps (_mm_add_ps (aux_alpha, in->c[3]),
+                          _mm_mul_ps (aux_alpha, in->c[3]));
+
+  valid = _mm_cmpneq_ps (out_alpha, _mm_setzero_ps ());
+
+  in_weight       = _mm_mul_ps (in->c[3], _mm_sub_ps (one, aux_alpha));
+  recip_out_alpha = _mm_div_ps (one, select_ps (valid, out_alpha, one));
+
+  for (b = 0; b < 3; b++)
+    {
+      __m128 blend = _mm_add_ps (_mm_mul_ps (layer->c[b], aux_alpha),
+                                 _mm_mul_ps (in->c[b],    in_weight));
+
+      out->c[b] = select_ps (valid,
+                             _mm_mul_ps (blend, recip_out_alpha),
+                             in->c[b]);
+    }
+
+  out->c[3] = out_alpha;
+}
+
+DEFINE_MODE (normal)
+
+static ALWAYS_INLINE void
+behind_block (const Pixels *in,
+              const Pixels *layer,
+              __m128        value,
+              gboolean      scale,
+              Pixels       *out)
+{
+  const __m128 one = _mm_set1_ps (1.0f);
+  __m128       in_alpha = in->c[3];
+  __m128       layer_alpha;
+  __m128       layer_weight;
+  __m128       out_alpha;
+  __m128       valid;
+  __m128       divisor;
+  gint         b;
+
+  layer_alpha = layer->c[3];
+  if (scale)
+    layer_alpha = _mm_mul_ps (layer_alpha, value);
+
+  out_alpha = _mm_add_ps (in_alpha,
+                          _mm_mul_ps (_mm_sub_ps (one, in_alpha), layer_alpha));
+
+  valid   = _mm_cmpneq_ps (out_alpha, _mm_setzero_ps ());
+  divisor = select_ps (valid, out_alpha, one);
+
+  /*  the generic function applies the opacity to the layer's color
+   *  twice, keep that
+   */
+  layer_weight = _mm_mul_ps (layer_alpha, _mm_sub_ps (one, in_alpha));
+  if (scale)
+    layer_weight = _mm_mul_ps (layer_weight, value);
+
+  for (b = 0; b < 3; b++)
+    {
+      __m128 blend = _mm_add_ps (_mm_mul_ps (in->c[b],    in_alpha),
+                                 _mm_mul_ps (layer->c[b], layer_weight));
+
+      out->c[b] = select_ps (valid, _mm_div_ps (blend, divisor), in->c[b]);
+    }
+
+  out->c[3] = select_ps (valid, out_alpha, in_alpha);
+}
+
+DEFINE_MODE (behind)
+
+static ALWAYS_INLINE void
+erase_block (const Pixels *in,
+             const Pixels *layer,
+             __m128        value,
+             gboolean      scale,
+             Pixels       *out)
+{
+  __m128 erase = _mm_mul_ps (in->c[3], layer->c[3]);
+
+  if (scale)
+    erase = _mm_mul_ps (erase, value);
+
+  out->c[0] = in->c[0];
+  out->c[1] = in->c[1];
+  out->c[2] = in->c[2];
+  out->c[3] = _mm_sub_ps (in->c[3], erase);
+}
+
+DEFINE_MODE (erase)
+
+static ALWAYS_INLINE void
+anti_erase_block (const Pixels *in,
+                  const Pixels *layer,
+                  __m128        value,
+                  gboolean      scale,
+                  Pixels       *out)
+{
+  __m128 restore = _mm_mul_ps (_mm_sub_ps (_mm_set1_ps (1.0f), in->c[3]),
+                               layer->c[3]);
+
+  if (scale)
+    restore = _mm_mul_ps (restore, value);
+
+  out->c[0] = in->c[0];
+  out->c[1] = in->c[1];
+  out->c[2] = in->c[2];
+  out->c[3] = _mm_add_ps (in->c[3], restore);
+}
+
+DEFINE_MODE (anti_erase)
+
+static ALWAYS_INLINE void
+replace_block (const Pixels *in,
+               const Pixels *layer,
+               __m128        value,
+               gboolean      scale,
+               Pixels       *out)
+{
+  const __m128 one = _mm_set1_ps (1.0f);
+  __m128       new_alpha;
+  __m128       valid;
+  __m128       ratio;
+  gint         b;
+
+  new_alpha = _mm_sub_ps (layer->c[3], in->c[3]);
+  ratio     = layer->c[3];
+
+  if (scale)
+    {
+      new_alpha = _mm_mul_ps (new_alpha, value);
+      ratio     = _mm_mul_ps (ratio,     value);
+    }
+
+  new_alpha = _mm_add_ps (new_alpha, in->c[3]);
+
+  valid = _mm_cmpneq_ps (new_alpha, _mm_setzero_ps ());
+  ratio = _mm_div_ps (ratio, select_ps (valid, new_alpha, one));
+
+  for (b = 0; b < 3; b++)
+    {
+      __m128 blend = _mm_add_ps (in->c[b],
+                                 _mm_mul_ps (_mm_sub_ps (layer->c[b],
+                                                         in->c[b]),
+                                             ratio));
+
+      out->c[b] = select_ps (valid, blend, in->c[b]);
+    }
+
+  out->c[3] = new_alpha;
+}
+
+DEFINE_MODE (replace)
+
+
+GimpLayerModeFunction
+get_layer_mode_function_sse2 (GimpLayerModeEffects paint_mode)
+{
+  switch (paint_mode)
+    {
+      case GIMP_NORMAL_MODE:        return normal_mode_process_pixels_sse2;
+      case GIMP_BEHIND_MODE:        return behind_mode_process_pixels_sse2;
+      case GIMP_MULTIPLY_MODE:      return multiply_mode_process_pixels_sse2;
+      case GIMP_SCREEN_MODE:        return screen_mode_process_pixels_sse2;
+      case GIMP_OVERLAY_MODE:       return overlay_mode_process_pixels_sse2;
+      case GIMP_DIFFERENCE_MODE:    return difference_mode_process_pixels_sse2;
+      case GIMP_ADDITION_MODE:      return addition_mode_process_pixels_sse2;
+      case GIMP_SUBTRACT_MODE:      return subtract_mode_process_pixels_sse2;
+      case GIMP_DARKEN_ONLY_MODE:   return darken_only_mode_process_pixels_sse2;
+      case GIMP_LIGHTEN_ONLY_MODE:  return lighten_only_mode_process_pixels_sse2;
+      case GIMP_VALUE_MODE:         return value_mode_process_pixels_sse2;
+      case GIMP_DIVIDE_MODE:        return divide_mode_process_pixels_sse2;
+      case GIMP_DODGE_MODE:         return dodge_mode_process_pixels_sse2;
+      case GIMP_BURN_MODE:          return burn_mode_process_pixels_sse2;
+      case GIMP_HARDLIGHT_MODE:     return hardlight_mode_process_pixels_sse2;
+      case GIMP_SOFTLIGHT_MODE:     return softlight_mode_process_pixels_sse2;
+      case GIMP_GRAIN_EXTRACT_MODE: return grain_extract_mode_process_pixels_sse2;
+      case GIMP_GRAIN_MERGE_MODE:   return grain_merge_mode_process_pixels_sse2;
+      case GIMP_ERASE_MODE:         return erase_mode_process_pixels_sse2;
+      case GIMP_REPLACE_MODE:       return replace_mode_process_pixels_sse2;
+      case GIMP_ANTI_ERASE_MODE:    return anti_erase_mode_process_pixels_sse2;
+      default:
+        break;
+    }
+
+  return NULL;
+}
+
+#else /* ! USE_SSE2 */
+
+GimpLayerModeFunction
+get_layer_mode_function_sse2 (GimpLayerModeEffects paint_mode)
+{
+  return NULL;
+}
+
+#endif /* USE_SSE2 */
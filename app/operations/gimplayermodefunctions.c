@@ -22,9 +22,13 @@
 
 #include <gegl.h>
 #include <gegl-plugin.h>
+
+#include "libgimpbase/gimpbase.h"
+
 #include "operations-types.h"
 
 #include "gimplayermodefunctions.h"
+#include "gimplayermodefunctions-sse2.h"
 
 #include "gimpoperationpointlayermode.h"
 #include "gimpoperationnormalmode.h"
@@ -59,6 +63,14 @@ get_layer_mode_function (GimpLayerModeEffects paint_mode)
 {
   GimpLayerModeFunction func = gimp_operation_normal_mode_process_pixels;
 
+  if (gimp_cpu_accel_get_support () & GIMP_CPU_ACCEL_X86_SSE2)
+    {
+      func = get_layer_mode_function_sse2 (paint_mode);
+
+      if (func)
+        return func;
+    }
+
   switch (paint_mode)
     {
       case GIMP_NORMAL_MODE:        func = gimp_operation_normal_mode_process_pixels; break;
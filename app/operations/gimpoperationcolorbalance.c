@@ -33,6 +33,9 @@
 #include "gimpoperationcolorbalance.h"
 
 
+#define BLOCK_SIZE 64
+
+
 static gboolean gimp_operation_color_balance_process (GeglOperation       *operation,
                                                       void                *in_buf,
                                                       void                *out_buf,
@@ -131,65 +134,56 @@ gimp_operation_color_balance_process (GeglOperation       *operation,
   if (! config)
     return FALSE;
 
-  while (samples--)
+  while (samples > 0)
     {
-      gfloat r = src[RED];
-      gfloat g = src[GREEN];
-      gfloat b = src[BLUE];
-      gfloat r_n;
-      gfloat g_n;
-      gfloat b_n;
+      gfloat hsl[BLOCK_SIZE * 3];
+      glong  n = MIN (samples, BLOCK_SIZE);
+      glong  i;
 
-      GimpRGB rgb = { r, g, b};
-      GimpHSL hsl;
+      gimp_rgb_to_hsl_floats (src, 4, hsl, 3, n);
 
-      gimp_rgb_to_hsl (&rgb, &hsl);
+      for (i = 0; i < n; i++)
+        {
+          gfloat l = hsl[i * 3 + 2];
 
-      r_n = gimp_operation_color_balance_map (r, hsl.l,
+          dest[RED] =
+            gimp_operation_color_balance_map (src[RED], l,
                                               config->cyan_red[GIMP_SHADOWS],
                                               config->cyan_red[GIMP_MIDTONES],
                                               config->cyan_red[GIMP_HIGHLIGHTS]);
 
-      g_n = gimp_operation_color_balance_map (g, hsl.l,
+          dest[GREEN] =
+            gimp_operation_color_balance_map (src[GREEN], l,
                                               config->magenta_green[GIMP_SHADOWS],
                                               config->magenta_green[GIMP_MIDTONES],
                                               config->magenta_green[GIMP_HIGHLIGHTS]);
 
-      b_n = gimp_operation_color_balance_map (b, hsl.l,
+          dest[BLUE] =
+            gimp_operation_color_balance_map (src[BLUE], l,
                                               config->yellow_blue[GIMP_SHADOWS],
                                               config->yellow_blue[GIMP_MIDTONES],
                                               config->yellow_blue[GIMP_HIGHLIGHTS]);
 
-      if (config->preserve_luminosity)
-        {
-          GimpHSL hsl2;
+          dest[ALPHA] = src[ALPHA];
 
-          rgb.r = r_n;
-          rgb.g = g_n;
-          rgb.b = b_n;
-          gimp_rgb_to_hsl (&rgb, &hsl);
+          src  += 4;
+          dest += 4;
+        }
 
-          rgb.r = r;
-          rgb.g = g;
-          rgb.b = b;
-          gimp_rgb_to_hsl (&rgb, &hsl2);
+      if (config->preserve_luminosity)
+        {
+          /*  give the new colors their original lightness  */
+          gfloat *block = dest - n * 4;
 
-          hsl.l = hsl2.l;
+          gimp_rgb_to_hsl_floats (block, 4, block, 4, n);
 
-          gimp_hsl_to_rgb (&hsl, &rgb);
+          for (i = 0; i < n; i++)
+            block[i * 4 + 2] = hsl[i * 3 + 2];
 
-          r_n = rgb.r;
-          g_n = rgb.g;
-          b_n = rgb.b;
+          gimp_hsl_to_rgb_floats (block, 4, block, 4, n);
         }
 
-      dest[RED]   = r_n;
-      dest[GREEN] = g_n;
-      dest[BLUE]  = b_n;
-      dest[ALPHA] = src[ALPHA];
-
-      src  += 4;
-      dest += 4;
+      samples -= n;
     }
 
   return TRUE;
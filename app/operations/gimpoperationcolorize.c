@@ -91,21 +91,17 @@ gimp_operation_colorize_process (GeglOperation       *operation,
   GimpColorizeConfig       *config = GIMP_COLORIZE_CONFIG (point->config);
   gfloat                   *src    = in_buf;
   gfloat                   *dest   = out_buf;
-  GimpHSL                   hsl;
+  glong                     i;
 
   if (! config)
     return FALSE;
 
-  hsl.h = config->hue;
-  hsl.s = config->saturation;
-  hsl.a = src[ALPHA];
-
-  while (samples--)
+  /*  fill dest with HSL colors and convert them in one go  */
+  for (i = 0; i < samples; i++)
     {
-      GimpRGB rgb;
-      gfloat  lum = GIMP_RGB_LUMINANCE (src[RED],
-                                        src[GREEN],
-                                        src[BLUE]);
+      gfloat lum = GIMP_RGB_LUMINANCE (src[RED],
+                                       src[GREEN],
+                                       src[BLUE]);
 
       if (config->lightness > 0)
         {
@@ -118,23 +114,21 @@ gimp_operation_colorize_process (GeglOperation       *operation,
           lum = lum * (config->lightness + 1.0);
         }
 
-      hsl.l = lum;
-
-      gimp_hsl_to_rgb (&hsl, &rgb);
-
-      /*  the code in base/colorize.c would multiply r,b,g with lum,
-       *  but this is a bug since it should multiply with 255. We
-       *  don't repeat this bug here (this is the reason why the gegl
-       *  colorize is brighter than the legacy one).
-       */
-      dest[RED]   = rgb.r; /* * lum; */
-      dest[GREEN] = rgb.g; /* * lum; */
-      dest[BLUE]  = rgb.b; /* * lum */;
-      dest[ALPHA] = rgb.a;
+      dest[0]     = config->hue;
+      dest[1]     = config->saturation;
+      dest[2]     = lum;
+      dest[ALPHA] = src[ALPHA];
 
       src  += 4;
       dest += 4;
     }
 
+  /*  the code in base/colorize.c would multiply r,b,g with lum,
+   *  but this is a bug since it should multiply with 255. We
+   *  don't repeat this bug here (this is the reason why the gegl
+   *  colorize is brighter than the legacy one).
+   */
+  gimp_hsl_to_rgb_floats (out_buf, 4, out_buf, 4, samples);
+
   return TRUE;
 }
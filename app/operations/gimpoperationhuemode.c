@@ -33,6 +33,9 @@
 #include "gimpoperationhuemode.h"
 
 
+#define BLOCK_SIZE 64
+
+
 static gboolean gimp_operation_hue_mode_process (GeglOperation       *operation,
                                                  void                *in_buf,
                                                  void                *aux_buf,
@@ -96,63 +99,67 @@ gimp_operation_hue_mode_process_pixels (gfloat              *in,
 {
   const gboolean has_mask = mask != NULL;
 
-  while (samples--)
+  while (samples > 0)
     {
-      GimpHSV layer_hsv, out_hsv;
-      GimpRGB layer_rgb = {layer[0], layer[1], layer[2]};
-      GimpRGB out_rgb   = {in[0], in[1], in[2]};
-      gfloat  comp_alpha, new_alpha;
-
-      comp_alpha = MIN (in[ALPHA], layer[ALPHA]) * opacity;
-      if (has_mask)
-        comp_alpha *= *mask;
+      gfloat layer_hsv[BLOCK_SIZE * 3];
+      gfloat out_hsv[BLOCK_SIZE * 3];
+      gfloat out_rgb[BLOCK_SIZE * 3];
+      glong  n = MIN (samples, BLOCK_SIZE);
+      glong  i;
 
-      new_alpha = in[ALPHA] + (1.0 - in[ALPHA]) * comp_alpha;
+      gimp_rgb_to_hsv_floats (layer, 4, layer_hsv, 3, n);
+      gimp_rgb_to_hsv_floats (in,    4, out_hsv,   3, n);
 
-      if (comp_alpha && new_alpha)
+      for (i = 0; i < n; i++)
         {
-          gint   b;
-          gfloat ratio = comp_alpha / new_alpha;
-
-          gimp_rgb_to_hsv (&layer_rgb, &layer_hsv);
-          gimp_rgb_to_hsv (&out_rgb, &out_hsv);
-
           /*  Composition should have no effect if saturation is zero.
            *  otherwise, black would be painted red (see bug #123296).
            */
-          if (layer_hsv.s)
-            {
-              out_hsv.h = layer_hsv.h;
-            }
-          gimp_hsv_to_rgb (&out_hsv, &out_rgb);
+          if (layer_hsv[i * 3 + 1])
+            out_hsv[i * 3] = layer_hsv[i * 3];
+        }
 
-          out[0] = out_rgb.r;
-          out[1] = out_rgb.g;
-          out[2] = out_rgb.b;
+      gimp_hsv_to_rgb_floats (out_hsv, 3, out_rgb, 3, n);
 
-          for (b = RED; b < ALPHA; b++)
-            {
-              out[b] = out[b] * ratio + in[b] * (1.0 - ratio);
-            }
-        }
-      else
+      for (i = 0; i < n; i++)
         {
-          gint b;
+          gfloat comp_alpha, new_alpha;
+          gint   b;
+
+          comp_alpha = MIN (in[ALPHA], layer[ALPHA]) * opacity;
+          if (has_mask)
+            comp_alpha *= *mask;
+
+          new_alpha = in[ALPHA] + (1.0 - in[ALPHA]) * comp_alpha;
+
+          if (comp_alpha && new_alpha)
+            {
+              gfloat ratio = comp_alpha / new_alpha;
 
-          for (b = RED; b < ALPHA; b++)
+              for (b = RED; b < ALPHA; b++)
+                {
+                  out[b] = out_rgb[i * 3 + b] * ratio + in[b] * (1.0 - ratio);
+                }
+            }
+          else
             {
-              out[b] = in[b];
+              for (b = RED; b < ALPHA; b++)
+                {
+                  out[b] = in[b];
+                }
             }
-        }
 
-      out[ALPHA] = in[ALPHA];
+          out[ALPHA] = in[ALPHA];
 
-      in    += 4;
-      layer += 4;
-      out   += 4;
+          in    += 4;
+          layer += 4;
+          out   += 4;
+
+          if (has_mask)
+            mask++;
+        }
 
-      if (has_mask)
-        mask++;
+      samples -= n;
     }
 
   return TRUE;
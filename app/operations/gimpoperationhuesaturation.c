@@ -141,15 +141,18 @@ gimp_operation_hue_saturation_process (GeglOperation       *operation,
   gfloat                   *src    = in_buf;
   gfloat                   *dest   = out_buf;
   gfloat                    overlap;
+  glong                     i;
 
   if (! config)
     return FALSE;
 
   overlap = config->overlap / 2.0;
 
-  while (samples--)
+  /*  map the colors as HSL in dest, and convert them back at the end  */
+  gimp_rgb_to_hsl_floats (src, 4, dest, 4, samples);
+
+  for (i = 0; i < samples; i++)
     {
-      GimpRGB  rgb;
       GimpHSL  hsl;
       gdouble  h;
       gint     hue_counter;
@@ -159,12 +162,9 @@ gimp_operation_hue_saturation_process (GeglOperation       *operation,
       gfloat   primary_intensity   = 0.0;
       gfloat   secondary_intensity = 0.0;
 
-      rgb.r = src[RED];
-      rgb.g = src[GREEN];
-      rgb.b = src[BLUE];
-      rgb.a = src[ALPHA];
-
-      gimp_rgb_to_hsl (&rgb, &hsl);
+      hsl.h = dest[0];
+      hsl.s = dest[1];
+      hsl.l = dest[2];
 
       h = hsl.h * 6.0;
 
@@ -249,17 +249,17 @@ gimp_operation_hue_saturation_process (GeglOperation       *operation,
           hsl.l = map_lightness  (config, hue, hsl.l);
         }
 
-      gimp_hsl_to_rgb (&hsl, &rgb);
-
-      dest[RED]   = rgb.r;
-      dest[GREEN] = rgb.g;
-      dest[BLUE]  = rgb.b;
-      dest[ALPHA] = rgb.a;
+      dest[0]     = hsl.h;
+      dest[1]     = hsl.s;
+      dest[2]     = hsl.l;
+      dest[ALPHA] = src[ALPHA];
 
       src  += 4;
       dest += 4;
     }
 
+  gimp_hsl_to_rgb_floats (out_buf, 4, out_buf, 4, samples);
+
   return TRUE;
 }
 
@@ -29,12 +29,15 @@
 
 #include "operations-types.h"
 
+#include "gegl/gimp-gegl-distance.h"
+
 #include "gimpoperationshapeburst.h"
 
 
 enum
 {
   PROP_0,
+  PROP_METRIC,
   PROP_MAX_ITERATIONS,
   PROP_PROGRESS
 };
@@ -92,6 +95,15 @@ gimp_operation_shapeburst_class_init (GimpOperationShapeburstClass *klass)
 
   filter_class->process                    = gimp_operation_shapeburst_process;
 
+  g_object_class_install_property (object_class, PROP_METRIC,
+                                   g_param_spec_enum ("metric",
+                                                      "Metric",
+                                                      "Distance metric to use",
+                                                      GIMP_TYPE_DISTANCE_METRIC,
+                                                      GIMP_DISTANCE_METRIC_MANHATTAN,
+                                                      G_PARAM_READWRITE |
+                                                      G_PARAM_CONSTRUCT));
+
   g_object_class_install_property (object_class, PROP_MAX_ITERATIONS,
                                    g_param_spec_double ("max-iterations",
                                                         "Max Iterations",
@@ -122,6 +134,10 @@ gimp_operation_shapeburst_get_property (GObject    *object,
 
   switch (property_id)
     {
+    case PROP_METRIC:
+      g_value_set_enum (value, self->metric);
+      break;
+
     case PROP_MAX_ITERATIONS:
       g_value_set_double (value, self->max_iterations);
       break;
@@ -146,6 +162,10 @@ gimp_operation_shapeburst_set_property (GObject      *object,
 
   switch (property_id)
     {
+    case PROP_METRIC:
+      self->metric = g_value_get_enum (value);
+      break;
+
     case PROP_MAX_ITERATIONS:
       self->max_iterations = g_value_get_double (value);
       break;
@@ -189,131 +209,53 @@ gimp_operation_shapeburst_process (GeglOperation       *operation,
                                    const GeglRectangle *roi,
                                    gint                 level)
 {
-  const Babl *input_format   = babl_format ("Y u8");
-  const Babl *output_format  = babl_format ("Y float");
-  gfloat      max_iterations = 0.0;
-  gfloat     *distp_cur;
-  gfloat     *distp_prev;
-  gfloat     *memory;
-  gint        length;
-  gint        i;
-
-  length = roi->width + 1;
-  memory = g_new (gfloat, length * 2);
-
-  distp_prev = memory;
-  for (i = 0; i < length; i++)
-    distp_prev[i] = 0.0;
-
-  distp_prev += 1;
-  distp_cur = distp_prev + length;
-
-  for (i = 0; i < roi->height; i++)
+  GimpOperationShapeburst *self           = GIMP_OPERATION_SHAPEBURST (operation);
+  const Babl              *input_format   = babl_format ("Y u8");
+  const Babl              *output_format  = babl_format ("Y float");
+  gfloat                   max_iterations = 0.0;
+  gsize                    n_pixels       = (gsize) roi->width * roi->height;
+  guchar                  *src;
+  gfloat                  *dist;
+  gsize                    i;
+
+  src  = g_new (guchar, n_pixels);
+  dist = g_new (gfloat, n_pixels);
+
+  gegl_buffer_get (input, roi, 1.0, input_format, src,
+                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+  for (i = 0; i < n_pixels; i++)
+    dist[i] = src[i];
+
+  /*  everything outside the input counts as unselected  */
+  gimp_gegl_distance_transform (dist, roi->width, roi->height,
+                                self->metric, TRUE);
+
+  g_object_set (operation,
+                "progress", 0.5,
+                NULL);
+
+  /*  pixels next to the background have a distance of 1, let their
+   *  value decide how far in they are, so antialiased edges stay smooth
+   */
+  for (i = 0; i < n_pixels; i++)
     {
-      gfloat *tmp;
-      gint    src = 0;
-      gint    j;
-
-      /*  set the current dist row to 0's  */
-      memset (distp_cur - 1, 0, sizeof (gfloat) * (length - 1));
-
-      for (j = 0; j < roi->width; j++)
-        {
-          gfloat float_tmp;
-          gfloat min_prev = MIN (distp_cur[j-1], distp_prev[j]);
-          gint   min_left = MIN ((roi->width - j - 1), (roi->height - i - 1));
-          gint   min      = (gint) MIN (min_left, min_prev);
-          gint   fraction = 255;
-          gint   k;
-
-          /*  This might need to be changed to 0
-              instead of k = (min) ? (min - 1) : 0  */
-
-          for (k = (min) ? (min - 1) : 0; k <= min; k++)
-            {
-              gint x   = j;
-              gint y   = i + k;
-              gint end = y - k;
-
-              while (y >= end)
-                {
-                  guchar src_uchar;
-
-#if 1
-                  /* FIXME: this should be much faster, it converts
-                   * to 32 bit rgba intermediately, bah...
-                   */
-                  gegl_buffer_sample (input, x, y, NULL, &src_uchar,
-                                      input_format,
-                                      GEGL_SAMPLER_NEAREST, GEGL_ABYSS_NONE);
-#else
-                  gegl_buffer_get (input, GEGL_RECTANGLE (x, y, 1, 1), 1.0,
-                                   input_format, &src_uchar,
-                                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
-#endif
-
-                  src = src_uchar;
-
-                  if (src == 0)
-                    {
-                      min = k;
-                      y = -1;
-                      break;
-                    }
-
-                  if (src < fraction)
-                    fraction = src;
-
-                  x++;
-                  y--;
-                }
-            }
-
-          if (src != 0)
-            {
-              /*  If min_left != min_prev use the previous fraction
-               *   if it is less than the one found
-               */
-              if (min_left != min)
-                {
-                  gint prev_frac = (int) (255 * (min_prev - min));
-
-                  if (prev_frac == 255)
-                    prev_frac = 0;
-
-                  fraction = MIN (fraction, prev_frac);
-                }
-
-              min++;
-            }
-
-          float_tmp = distp_cur[j] = min + fraction / 256.0;
-
-          if (float_tmp > max_iterations)
-            max_iterations = float_tmp;
-        }
-
-      /*  set the dist row  */
-      gegl_buffer_set (output,
-                       GEGL_RECTANGLE (roi->x, roi->y + i,
-                                       roi->width, 1),
-                       1.0, output_format, distp_cur,
-                       GEGL_AUTO_ROWSTRIDE);
-
-      /*  swap pointers around  */
-      tmp = distp_prev;
-      distp_prev = distp_cur;
-      distp_cur = tmp;
-
-      g_object_set (operation,
-                    "progress", (gdouble) i / roi->height,
-                    NULL);
+      if (dist[i] > 0.0)
+        dist[i] += src[i] / 255.0 - 1.0;
+
+      if (dist[i] > max_iterations)
+        max_iterations = dist[i];
     }
 
-  g_free (memory);
+  gegl_buffer_set (output, roi, 0, output_format, dist,
+                   GEGL_AUTO_ROWSTRIDE);
+
+  g_free (src);
+  g_free (dist);
 
   g_object_set (operation,
                 "max-iterations", (gdouble) max_iterations,
+                "progress",       1.0,
                 NULL);
 
   return TRUE;
@@ -40,6 +40,7 @@ struct _GimpOperationShapeburst
 {
   GeglOperationFilter  parent_instance;
 
+  GimpDistanceMetric   metric;
   gdouble              max_iterations;
   gdouble              progress;
 };
@@ -0,0 +1,635 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * gimpheal-laplace.c
+ * Copyright (C) Jean-Yves Couleaud <cjyves@free.fr>
+ * Copyright (C) 2013 Loren Merritt
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <gegl.h>
+
+#include "libgimpmath/gimpmath.h"
+
+#include "paint-types.h"
+
+#include "core/gimp-parallel.h"
+
+#include "gimpheal-laplace.h"
+
+
+/* Both solvers solve the Laplace equation for the pixels in the mask,
+ * with the pixels outside of it as Dirichlet conditions.  Neighbors
+ * off the edge of the canvas are omitted.  @pixels has @depth floats
+ * per pixel.
+ */
+
+/* Tolerate a total deviation-from-smoothness of 0.1 LSBs at 8bit depth. */
+#define EPSILON            (0.1/255)
+
+/* successive over-relaxation */
+#define MAX_ITER           500
+
+/* multigrid */
+#define MAX_CYCLES         50
+#define MAX_LEVELS         16
+#define PRE_SMOOTH         2
+#define POST_SMOOTH        2
+#define COARSEST_CELLS     64   /* unknowns the coarsest level may have */
+#define COARSEST_SWEEPS    50
+#define MIN_PARALLEL_CELLS 4096
+
+
+/* A multigrid level.  Its arrays are padded by one empty pixel on each
+ * side, which stands in for the neighbors off the edge of the canvas.
+ */
+typedef struct
+{
+  gint    width;
+  gint    height;
+  gint    stride;     /* width + 2                                     */
+  gint    size;       /* stride * (height + 2)                         */
+
+  gint    n_cells;    /* number of unknowns                            */
+  gint   *cells;      /* padded index of each unknown, red ones first  */
+  gfloat *diag;       /* its number of neighbors on the canvas         */
+  gfloat *inv_diag;
+
+  /* to the next coarser level, for each unknown */
+  gint   *parent;     /* padded index of the coarse pixel it is in     */
+  gint   *neighbors;  /* the coarse pixels next to it, horizontally,
+                       * vertically and diagonally
+                       */
+} HealLevel;
+
+typedef struct
+{
+  gfloat       *pixels;
+  gint          depth;
+  HealLevel    *levels;
+  gint          n_levels;
+  gint          n_cycles[4];
+} HealSolver;
+
+
+/*  local function prototypes  */
+
+static gfloat   gimp_heal_laplace_iteration (gfloat          *pixels,
+                                             gfloat          *Adiag,
+                                             gint            *Aidx,
+                                             gfloat           w,
+                                             gint             nmask,
+                                             gint             depth);
+
+static gint     heal_levels_new     (HealLevel       *levels,
+                                     const guchar    *mask,
+                                     gint             width,
+                                     gint             height);
+static void     heal_levels_free    (HealLevel       *levels,
+                                     gint             n_levels);
+
+static void     heal_smooth         (const HealLevel *level,
+                                     gfloat          *u,
+                                     const gfloat    *f,
+                                     gint             n_sweeps);
+static gdouble  heal_restrict       (const HealLevel *level,
+                                     const gfloat    *u,
+                                     const gfloat    *f,
+                                     gfloat          *coarse_f);
+static void     heal_prolong        (const HealLevel *level,
+                                     gfloat          *u,
+                                     const gfloat    *coarse_u);
+static void     heal_vcycle         (const HealLevel *levels,
+                                     gint             n_levels,
+                                     gfloat         **u,
+                                     gfloat         **f);
+
+static void     heal_solve_func     (gint             i,
+                                     gint             n,
+                                     gpointer         user_data);
+
+
+/*  public functions  */
+
+/* Solve the laplace equation for pixels and store the result in-place,
+ * using red/black Gauss-Seidel with over-relaxation.  @pixels must
+ * have room for one more pixel than width * height, and be 16-byte
+ * aligned.  Returns the number of iterations.
+ */
+gint
+gimp_heal_laplace_sor (gfloat       *pixels,
+                       gint          width,
+                       gint          height,
+                       gint          depth,
+                       const guchar *mask)
+{
+  gint    i, j, iter, parity, nmask, zero;
+  gfloat *Adiag;
+  gint   *Aidx;
+  gfloat  w;
+
+  Adiag = g_new (gfloat, width * height);
+  Aidx  = g_new (gint, 5 * width * height);
+
+  /* All off-diagonal elements of A are either -1 or 0. We could store it as a
+   * general-purpose sparse matrix, but that adds some unnecessary overhead to
+   * the inner loop. Instead, assume exactly 4 off-diagonal elements in each
+   * row, all of which have value -1. Any row that in fact wants less than 4
+   * coefs can put them in a dummy column to be multiplied by an empty pixel.
+   */
+  zero = depth * width * height;
+  memset (pixels + zero, 0, depth * sizeof (gfloat));
+
+  /* Construct the system of equations.
+   * Arrange Aidx in checkerboard order, so that a single linear pass over that
+   * array results updating all of the red cells and then all of the black cells.
+   */
+  nmask = 0;
+  for (parity = 0; parity < 2; parity++)
+    for (i = 0; i < height; i++)
+      for (j = (i&1)^parity; j < width; j+=2)
+        if (mask[j + i * width])
+          {
+#define A_NEIGHBOR(o,di,dj) \
+            if ((dj<0 && j==0) || (dj>0 && j==width-1) || (di<0 && i==0) || (di>0 && i==height-1)) \
+              Aidx[o + nmask * 5] = zero; \
+            else                                               \
+              Aidx[o + nmask * 5] = ((i + di) * width + (j + dj)) * depth;
+
+            /* Omit Dirichlet conditions for any neighbors off the
+             * edge of the canvas.
+             */
+            Adiag[nmask] = 4 - (i==0) - (j==0) - (i==height-1) - (j==width-1);
+            A_NEIGHBOR (0,  0,  0);
+            A_NEIGHBOR (1,  0,  1);
+            A_NEIGHBOR (2,  1,  0);
+            A_NEIGHBOR (3,  0, -1);
+            A_NEIGHBOR (4, -1,  0);
+            nmask++;
+          }
+
+  /* Empirically optimal over-relaxation factor. (Benchmarked on
+   * round brushes, at least. I don't know whether aspect ratio
+   * affects it.)
+   */
+  w = 2.0 - 1.0 / (0.1575 * sqrt (nmask) + 0.8);
+  w *= 0.25;
+  for (i = 0; i < nmask; i++)
+    Adiag[i] *= w;
+
+  /* Gauss-Seidel with successive over-relaxation */
+  for (iter = 0; iter < MAX_ITER; iter++)
+    {
+      gfloat err = gimp_heal_laplace_iteration (pixels, Adiag, Aidx,
+                                                w, nmask, depth);
+      if (err < EPSILON * EPSILON * w * w)
+        break;
+    }
+
+  g_free (Adiag);
+  g_free (Aidx);
+
+  return MIN (iter + 1, MAX_ITER);
+}
+
+/* Solve the laplace equation for pixels and store the result in-place,
+ * using multigrid V-cycles.  The current values of the pixels in the
+ * mask are the initial guess.  The color components are solved in
+ * parallel.  Returns the number of V-cycles.
+ */
+gint
+gimp_heal_laplace_multigrid (gfloat       *pixels,
+                             gint          width,
+                             gint          height,
+                             gint          depth,
+                             const guchar *mask)
+{
+  HealLevel  levels[MAX_LEVELS];
+  HealSolver solver;
+  gint       n_cycles = 0;
+  gint       k;
+
+  g_return_val_if_fail (pixels != NULL, 0);
+  g_return_val_if_fail (mask != NULL, 0);
+  g_return_val_if_fail (depth >= 1 && depth <= 4, 0);
+
+  solver.pixels   = pixels;
+  solver.depth    = depth;
+  solver.levels   = levels;
+  solver.n_levels = heal_levels_new (levels, mask, width, height);
+
+  if (levels[0].n_cells > 0)
+    {
+      gimp_parallel_distribute (levels[0].n_cells < MIN_PARALLEL_CELLS ?
+                                1 : depth,
+                                heal_solve_func, &solver);
+
+      for (k = 0; k < depth; k++)
+        n_cycles = MAX (n_cycles, solver.n_cycles[k]);
+    }
+
+  heal_levels_free (levels, solver.n_levels);
+
+  return n_cycles;
+}
+
+
+/*  private functions  */
+
+#if defined(__SSE__) && defined(__GNUC__) && __GNUC__ >= 4
+static float
+gimp_heal_laplace_iteration_sse (gfloat *pixels,
+                                 gfloat *Adiag,
+                                 gint   *Aidx,
+                                 gfloat  w,
+                                 gint    nmask)
+{
+  typedef float v4sf __attribute__((vector_size(16)));
+  gint i;
+  v4sf wv  = { w, w, w, w };
+  v4sf err = { 0, 0, 0, 0 };
+  union { v4sf v; float f[4]; } erru;
+
+#define Xv(j) (*(v4sf*)&pixels[Aidx[i * 5 + j]])
+
+  for (i = 0; i < nmask; i++)
+    {
+      v4sf a    = { Adiag[i], Adiag[i], Adiag[i], Adiag[i] };
+      v4sf diff = a * Xv(0) - wv * (Xv(1) + Xv(2) + Xv(3) + Xv(4));
+
+      Xv(0) -= diff;
+      err += diff * diff;
+    }
+
+  erru.v = err;
+
+  return erru.f[0] + erru.f[1] + erru.f[2] + erru.f[3];
+}
+#endif
+
+/* Perform one iteration of Gauss-Seidel, and return the sum squared residual.
+ */
+static float
+gimp_heal_laplace_iteration (gfloat *pixels,
+                             gfloat *Adiag,
+                             gint   *Aidx,
+                             gfloat  w,
+                             gint    nmask,
+                             gint    depth)
+{
+  gint   i, k;
+  gfloat err = 0;
+
+#if defined(__SSE__) && defined(__GNUC__) && __GNUC__ >= 4
+  if (depth == 4)
+    return gimp_heal_laplace_iteration_sse (pixels, Adiag, Aidx, w, nmask);
+#endif
+
+  for (i = 0; i < nmask; i++)
+    {
+      gint   j0 = Aidx[i * 5 + 0];
+      gint   j1 = Aidx[i * 5 + 1];
+      gint   j2 = Aidx[i * 5 + 2];
+      gint   j3 = Aidx[i * 5 + 3];
+      gint   j4 = Aidx[i * 5 + 4];
+      gfloat a  = Adiag[i];
+
+      for (k = 0; k < depth; k++)
+        {
+          gfloat diff = (a * pixels[j0 + k] -
+                         w * (pixels[j1 + k] +
+                              pixels[j2 + k] +
+                              pixels[j3 + k] +
+                              pixels[j4 + k]));
+
+          pixels[j0 + k] -= diff;
+          err += diff * diff;
+        }
+    }
+
+  return err;
+}
+
+static void
+heal_level_init (HealLevel    *level,
+                 gint          width,
+                 gint          height,
+                 const guchar *unknown)
+{
+  gint parity;
+  gint x, y;
+
+  level->width   = width;
+  level->height  = height;
+  level->stride  = width + 2;
+  level->size    = level->stride * (height + 2);
+  level->n_cells = 0;
+
+  for (y = 0; y < height; y++)
+    for (x = 0; x < width; x++)
+      if (unknown[(y + 1) * level->stride + x + 1])
+        level->n_cells++;
+
+  level->cells     = g_new (gint,   level->n_cells);
+  level->diag      = g_new (gfloat, level->n_cells);
+  level->inv_diag  = g_new (gfloat, level->n_cells);
+  level->parent    = NULL;
+  level->neighbors = NULL;
+
+  level->n_cells = 0;
+
+  /* checkerboard order, all red cells first, then all black cells */
+  for (parity = 0; parity < 2; parity++)
+    for (y = 0; y < height; y++)
+      for (x = (y & 1) ^ parity; x < width; x += 2)
+        {
+          gint p = (y + 1) * level->stride + x + 1;
+
+          if (unknown[p])
+            {
+              gint i = level->n_cells++;
+
+              level->cells[i]    = p;
+              level->diag[i]     = (4 - (x == 0) - (y == 0) -
+                                    (x == width - 1) - (y == height - 1));
+              level->inv_diag[i] = 1.0 / level->diag[i];
+            }
+        }
+}
+
+/* Build the levels down to a coarsest one with only a few unknowns.
+ * A coarse pixel is only unknown if all of the fine pixels it covers
+ * are, a coarse domain reaching into the Dirichlet pixels makes the
+ * V-cycles diverge.  Returns the number of levels.
+ */
+static gint
+heal_levels_new (HealLevel    *levels,
+                 const guchar *mask,
+                 gint          width,
+                 gint          height)
+{
+  guchar *unknown;
+  gint    n_levels = 0;
+  gint    x, y;
+
+  unknown = g_new0 (guchar, (width + 2) * (height + 2));
+
+  /* a pixel without neighbors on the canvas stays as it is */
+  for (y = 0; y < height; y++)
+    for (x = 0; x < width; x++)
+      unknown[(y + 1) * (width + 2) + x + 1] = (mask[y * width + x] &&
+                                                width * height > 1);
+
+  while (TRUE)
+    {
+      HealLevel *level = &levels[n_levels++];
+      guchar    *coarse_unknown;
+      gint       i;
+
+      heal_level_init (level, width, height, unknown);
+
+      if (level->n_cells <= COARSEST_CELLS ||
+          width <= 2 || height <= 2       ||
+          n_levels == MAX_LEVELS)
+        break;
+
+      width  = (width  + 1) / 2;
+      height = (height + 1) / 2;
+
+      coarse_unknown = g_new0 (guchar, (width + 2) * (height + 2));
+
+      level->parent    = g_new (gint, level->n_cells);
+      level->neighbors = g_new (gint, level->n_cells * 3);
+
+      for (i = 0; i < level->n_cells; i++)
+        {
+          gint p  = level->cells[i];
+          gint fx = p % level->stride - 1;
+          gint fy = p / level->stride - 1;
+          gint cx = fx / 2;
+          gint cy = fy / 2;
+          gint dx = (fx & 1) ? 1 : -1;
+          gint dy = (fy & 1) ? 1 : -1;
+          gint parent;
+
+          /* the nearest coarse pixels, clamped to the canvas */
+          if (cx + dx < 0 || cx + dx >= width)
+            dx = 0;
+
+          if (cy + dy < 0 || cy + dy >= height)
+            dy = 0;
+
+          dy *= width + 2;
+
+          parent = (cy + 1) * (width + 2) + cx + 1;
+
+          coarse_unknown[parent]++;
+
+          level->parent[i]            = parent;
+          level->neighbors[i * 3 + 0] = parent + dx;
+          level->neighbors[i * 3 + 1] = parent + dy;
+          level->neighbors[i * 3 + 2] = parent + dx + dy;
+        }
+
+      for (y = 0; y < height; y++)
+        for (x = 0; x < width; x++)
+          {
+            gint    n_children = (MIN (2, level->width  - 2 * x) *
+                                  MIN (2, level->height - 2 * y));
+            guchar *count      = &coarse_unknown[(y + 1) * (width + 2) + x + 1];
+
+            *count = (*count == n_children);
+          }
+
+      g_free (unknown);
+      unknown = coarse_unknown;
+    }
+
+  g_free (unknown);
+
+  return n_levels;
+}
+
+static void
+heal_levels_free (HealLevel *levels,
+                  gint       n_levels)
+{
+  gint l;
+
+  for (l = 0; l < n_levels; l++)
+    {
+      g_free (levels[l].cells);
+      g_free (levels[l].diag);
+      g_free (levels[l].inv_diag);
+      g_free (levels[l].parent);
+      g_free (levels[l].neighbors);
+    }
+}
+
+/* Gauss-Seidel sweeps over the red, then the black cells */
+static void
+heal_smooth (const HealLevel *level,
+             gfloat          *u,
+             const gfloat    *f,
+             gint             n_sweeps)
+{
+  const gint stride = level->stride;
+  gint       sweep;
+  gint       i;
+
+  for (sweep = 0; sweep < n_sweeps; sweep++)
+    for (i = 0; i < level->n_cells; i++)
+      {
+        gint p = level->cells[i];
+
+        u[p] = (f[p] +
+                u[p - 1] + u[p + 1] +
+                u[p - stride] + u[p + stride]) * level->inv_diag[i];
+      }
+}
+
+/* Sum the residuals of the 2x2 pixels of each coarse pixel into
+ * @coarse_f, if not NULL.  A coarse pixel is twice as large, which
+ * makes its equation's right hand side the sum rather than the mean.
+ * Returns the sum squared residual.
+ */
+static gdouble
+heal_restrict (const HealLevel *level,
+               const gfloat    *u,
+               const gfloat    *f,
+               gfloat          *coarse_f)
+{
+  const gint stride = level->stride;
+  gdouble    sum    = 0.0;
+  gint       i;
+
+  for (i = 0; i < level->n_cells; i++)
+    {
+      gint   p = level->cells[i];
+      gfloat r;
+
+      r = f[p] - (level->diag[i] * u[p] -
+                  (u[p - 1] + u[p + 1] + u[p - stride] + u[p + stride]));
+
+      if (coarse_f)
+        coarse_f[level->parent[i]] += r;
+
+      sum += r * r;
+    }
+
+  return sum;
+}
+
+/* Add the bilinearly interpolated coarse correction */
+static void
+heal_prolong (const HealLevel *level,
+              gfloat          *u,
+              const gfloat    *coarse_u)
+{
+  gint i;
+
+  for (i = 0; i < level->n_cells; i++)
+    {
+      const gint *n = level->neighbors + i * 3;
+
+      u[level->cells[i]] += (9.0f / 16.0f * coarse_u[level->parent[i]] +
+                             3.0f / 16.0f * (coarse_u[n[0]] + coarse_u[n[1]]) +
+                             1.0f / 16.0f * coarse_u[n[2]]);
+    }
+}
+
+static void
+heal_vcycle (const HealLevel  *levels,
+             gint              n_levels,
+             gfloat          **u,
+             gfloat          **f)
+{
+  if (n_levels == 1)
+    {
+      heal_smooth (levels, u[0], f[0], COARSEST_SWEEPS);
+      return;
+    }
+
+  heal_smooth (levels, u[0], f[0], PRE_SMOOTH);
+
+  memset (f[1], 0, levels[1].size * sizeof (gfloat));
+  memset (u[1], 0, levels[1].size * sizeof (gfloat));
+
+  heal_restrict (levels, u[0], f[0], f[1]);
+
+  heal_vcycle (levels + 1, n_levels - 1, u + 1, f + 1);
+
+  heal_prolong (levels, u[0], u[1]);
+
+  heal_smooth (levels, u[0], f[0], POST_SMOOTH);
+}
+
+static void
+heal_solve_func (gint     i,
+                 gint     n,
+                 gpointer user_data)
+{
+  HealSolver      *solver = user_data;
+  const HealLevel *levels = solver->levels;
+  gfloat          *u[MAX_LEVELS];
+  gfloat          *f[MAX_LEVELS];
+  gint             k, l;
+
+  for (l = 0; l < solver->n_levels; l++)
+    {
+      u[l] = g_new0 (gfloat, levels[l].size);
+      f[l] = g_new0 (gfloat, levels[l].size);
+    }
+
+  /* every color component is a problem of its own */
+  for (k = i; k < solver->depth; k += n)
+    {
+      const gint  stride = levels[0].stride;
+      gfloat     *pixels = solver->pixels + k;
+      gint        cycle;
+      gint        x, y;
+
+      for (y = 0; y < levels[0].height; y++)
+        for (x = 0; x < levels[0].width; x++)
+          u[0][(y + 1) * stride + x + 1] =
+            pixels[(y * levels[0].width + x) * solver->depth];
+
+      for (cycle = 0; cycle < MAX_CYCLES; cycle++)
+        {
+          heal_vcycle (levels, solver->n_levels, u, f);
+
+          if (heal_restrict (levels, u[0], f[0], NULL) <
+              EPSILON * EPSILON / solver->depth)
+            break;
+        }
+
+      solver->n_cycles[k] = MIN (cycle + 1, MAX_CYCLES);
+
+      for (y = 0; y < levels[0].height; y++)
+        for (x = 0; x < levels[0].width; x++)
+          pixels[(y * levels[0].width + x) * solver->depth] =
+            u[0][(y + 1) * stride + x + 1];
+    }
+
+  for (l = 0; l < solver->n_levels; l++)
+    {
+      g_free (u[l]);
+      g_free (f[l]);
+    }
+}
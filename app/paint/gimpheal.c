@@ -40,6 +40,7 @@
 #include "core/gimptempbuf.h"
 
 #include "gimpheal.h"
+#include "gimpheal-laplace.h"
 #include "gimpsourceoptions.h"
 
 #include "gimp-intl.h"
@@ -53,9 +54,10 @@
  * but subtract them I2 = I0 - I1, where I0 is the sample image to be
  * corrected, I1 is the reference pattern. Then we solve DeltaI=0
  * (Laplace) with I2 Dirichlet conditions at the borders of the
- * mask. The solver is a red/black checker Gauss-Seidel with over-relaxation.
- * It could benefit from a multi-grid evaluation of an initial solution
- * before the main iteration loop.
+ * mask. The solver is a red/black checker Gauss-Seidel with over-relaxation,
+ * large areas are solved with multigrid V-cycles instead, whose number
+ * doesn't grow with the brush size. Along a stroke, the solution of the
+ * previous dab is the initial guess where the dabs overlap.
  *
  * I reduced the convergence criteria to 0.1% (0.001) as we are
  * dealing here with RGB integer components, more is overkill.
@@ -63,6 +65,14 @@
  * Jean-Yves Couleaud cjyves@free.fr
  */
 
+/* Below this many pixels in the mask, the overhead of multigrid
+ * outweighs its faster convergence.
+ */
+#define MIN_MULTIGRID_PIXELS 4096
+
+
+static void         gimp_heal_finalize           (GObject          *object);
+
 static gboolean     gimp_heal_start              (GimpPaintCore    *paint_core,
                                                   GimpDrawable     *drawable,
                                                   GimpPaintOptions *paint_options,
@@ -87,6 +97,17 @@ static void         gimp_heal_motion             (GimpSourceCore   *source_core,
                                                   gint              paint_area_width,
                                                   gint              paint_area_height);
 
+static void         gimp_heal_clear_solution     (GimpHeal            *heal);
+static void         gimp_heal_seed_solution      (GimpHeal            *heal,
+                                                  gfloat              *pixels,
+                                                  const GeglRectangle *rect,
+                                                  gint                 depth,
+                                                  const guchar        *mask);
+static void         gimp_heal_store_solution     (GimpHeal            *heal,
+                                                  const gfloat        *pixels,
+                                                  const GeglRectangle *rect,
+                                                  gint                 depth);
+
 
 G_DEFINE_TYPE (GimpHeal, gimp_heal, GIMP_TYPE_SOURCE_CORE)
 
@@ -108,9 +129,12 @@ gimp_heal_register (Gimp                      *gimp,
 static void
 gimp_heal_class_init (GimpHealClass *klass)
 {
+  GObjectClass        *object_class      = G_OBJECT_CLASS (klass);
   GimpPaintCoreClass  *paint_core_class  = GIMP_PAINT_CORE_CLASS (klass);
   GimpSourceCoreClass *source_core_class = GIMP_SOURCE_CORE_CLASS (klass);
 
+  object_class->finalize    = gimp_heal_finalize;
+
   paint_core_class->start   = gimp_heal_start;
 
   source_core_class->motion = gimp_heal_motion;
@@ -121,6 +145,14 @@ gimp_heal_init (GimpHeal *heal)
 {
 }
 
+static void
+gimp_heal_finalize (GObject *object)
+{
+  gimp_heal_clear_solution (GIMP_HEAL (object));
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
 static gboolean
 gimp_heal_start (GimpPaintCore     *paint_core,
                  GimpDrawable      *drawable,
@@ -144,9 +176,69 @@ gimp_heal_start (GimpPaintCore     *paint_core,
       return FALSE;
     }
 
+  gimp_heal_clear_solution (GIMP_HEAL (paint_core));
+
   return TRUE;
 }
 
+static void
+gimp_heal_clear_solution (GimpHeal *heal)
+{
+  if (heal->last_solution)
+    {
+      g_free (heal->last_solution);
+      heal->last_solution = NULL;
+    }
+}
+
+/* Use the solution of the last dab as initial guess for the pixels in
+ * the mask, where the dabs overlap
+ */
+static void
+gimp_heal_seed_solution (GimpHeal            *heal,
+                         gfloat              *pixels,
+                         const GeglRectangle *rect,
+                         gint                 depth,
+                         const guchar        *mask)
+{
+  GeglRectangle overlap;
+  gint          x, y;
+
+  if (! heal->last_solution       ||
+      heal->last_depth != depth   ||
+      ! gegl_rectangle_intersect (&overlap, rect, &heal->last_rect))
+    return;
+
+  for (y = overlap.y; y < overlap.y + overlap.height; y++)
+    {
+      gint          i    = (y - rect->y) * rect->width + overlap.x - rect->x;
+      const gfloat *last = (heal->last_solution +
+                            ((y - heal->last_rect.y) * heal->last_rect.width +
+                             overlap.x - heal->last_rect.x) * depth);
+
+      for (x = 0; x < overlap.width; x++, i++, last += depth)
+        {
+          if (mask[i])
+            memcpy (pixels + i * depth, last, depth * sizeof (gfloat));
+        }
+    }
+}
+
+static void
+gimp_heal_store_solution (GimpHeal            *heal,
+                          const gfloat        *pixels,
+                          const GeglRectangle *rect,
+                          gint                 depth)
+{
+  gimp_heal_clear_solution (heal);
+
+  heal->last_solution = g_memdup (pixels,
+                                  rect->width * rect->height * depth *
+                                  sizeof (gfloat));
+  heal->last_rect     = *rect;
+  heal->last_depth    = depth;
+}
+
 /* Subtract bottom from top and store in result as a float
  */
 static void
@@ -234,182 +326,34 @@ gimp_heal_add (GeglBuffer          *first_buffer,
     }
 }
 
-#if defined(__SSE__) && defined(__GNUC__) && __GNUC__ >= 4
-static float
-gimp_heal_laplace_iteration_sse (gfloat *pixels,
-                                 gfloat *Adiag,
-                                 gint   *Aidx,
-                                 gfloat  w,
-                                 gint    nmask)
-{
-  typedef float v4sf __attribute__((vector_size(16)));
-  gint i;
-  v4sf wv  = { w, w, w, w };
-  v4sf err = { 0, 0, 0, 0 };
-  union { v4sf v; float f[4]; } erru;
-
-#define Xv(j) (*(v4sf*)&pixels[Aidx[i * 5 + j]])
-
-  for (i = 0; i < nmask; i++)
-    {
-      v4sf a    = { Adiag[i], Adiag[i], Adiag[i], Adiag[i] };
-      v4sf diff = a * Xv(0) - wv * (Xv(1) + Xv(2) + Xv(3) + Xv(4));
-
-      Xv(0) -= diff;
-      err += diff * diff;
-    }
-
-  erru.v = err;
-
-  return erru.f[0] + erru.f[1] + erru.f[2] + erru.f[3];
-}
-#endif
-
-/* Perform one iteration of Gauss-Seidel, and return the sum squared residual.
- */
-static float
-gimp_heal_laplace_iteration (gfloat *pixels,
-                             gfloat *Adiag,
-                             gint   *Aidx,
-                             gfloat  w,
-                             gint    nmask,
-                             gint    depth)
-{
-  gint   i, k;
-  gfloat err = 0;
-
-#if defined(__SSE__) && defined(__GNUC__) && __GNUC__ >= 4
-  if (depth == 4)
-    return gimp_heal_laplace_iteration_sse (pixels, Adiag, Aidx, w, nmask);
-#endif
-
-  for (i = 0; i < nmask; i++)
-    {
-      gint   j0 = Aidx[i * 5 + 0];
-      gint   j1 = Aidx[i * 5 + 1];
-      gint   j2 = Aidx[i * 5 + 2];
-      gint   j3 = Aidx[i * 5 + 3];
-      gint   j4 = Aidx[i * 5 + 4];
-      gfloat a  = Adiag[i];
-
-      for (k = 0; k < depth; k++)
-        {
-          gfloat diff = (a * pixels[j0 + k] -
-                         w * (pixels[j1 + k] +
-                              pixels[j2 + k] +
-                              pixels[j3 + k] +
-                              pixels[j4 + k]));
-
-          pixels[j0 + k] -= diff;
-          err += diff * diff;
-        }
-    }
-
-  return err;
-}
-
-/* Solve the laplace equation for pixels and store the result in-place.
- */
-static void
-gimp_heal_laplace_loop (gfloat *pixels,
-                        gint    height,
-                        gint    depth,
-                        gint    width,
-                        guchar *mask)
-{
-  /* Tolerate a total deviation-from-smoothness of 0.1 LSBs at 8bit depth. */
-#define EPSILON  (0.1/255)
-#define MAX_ITER 500
-
-  gint    i, j, iter, parity, nmask, zero;
-  gfloat *Adiag;
-  gint   *Aidx;
-  gfloat  w;
-
-  Adiag = g_new (gfloat, width * height);
-  Aidx  = g_new (gint, 5 * width * height);
-
-  /* All off-diagonal elements of A are either -1 or 0. We could store it as a
-   * general-purpose sparse matrix, but that adds some unnecessary overhead to
-   * the inner loop. Instead, assume exactly 4 off-diagonal elements in each
-   * row, all of which have value -1. Any row that in fact wants less than 4
-   * coefs can put them in a dummy column to be multiplied by an empty pixel.
-   */
-  zero = depth * width * height;
-  memset (pixels + zero, 0, depth * sizeof (gfloat));
-
-  /* Construct the system of equations.
-   * Arrange Aidx in checkerboard order, so that a single linear pass over that
-   * array results updating all of the red cells and then all of the black cells.
-   */
-  nmask = 0;
-  for (parity = 0; parity < 2; parity++)
-    for (i = 0; i < height; i++)
-      for (j = (i&1)^parity; j < width; j+=2)
-        if (mask[j + i * width])
-          {
-#define A_NEIGHBOR(o,di,dj) \
-            if ((dj<0 && j==0) || (dj>0 && j==width-1) || (di<0 && i==0) || (di>0 && i==height-1)) \
-              Aidx[o + nmask * 5] = zero; \
-            else                                               \
-              Aidx[o + nmask * 5] = ((i + di) * width + (j + dj)) * depth;
-
-            /* Omit Dirichlet conditions for any neighbors off the
-             * edge of the canvas.
-             */
-            Adiag[nmask] = 4 - (i==0) - (j==0) - (i==height-1) - (j==width-1);
-            A_NEIGHBOR (0,  0,  0);
-            A_NEIGHBOR (1,  0,  1);
-            A_NEIGHBOR (2,  1,  0);
-            A_NEIGHBOR (3,  0, -1);
-            A_NEIGHBOR (4, -1,  0);
-            nmask++;
-          }
-
-  /* Empirically optimal over-relaxation factor. (Benchmarked on
-   * round brushes, at least. I don't know whether aspect ratio
-   * affects it.)
-   */
-  w = 2.0 - 1.0 / (0.1575 * sqrt (nmask) + 0.8);
-  w *= 0.25;
-  for (i = 0; i < nmask; i++)
-    Adiag[i] *= w;
-
-  /* Gauss-Seidel with successive over-relaxation */
-  for (iter = 0; iter < MAX_ITER; iter++)
-    {
-      gfloat err = gimp_heal_laplace_iteration (pixels, Adiag, Aidx,
-                                                w, nmask, depth);
-      if (err < EPSILON * EPSILON * w * w)
-        break;
-    }
-
-  g_free (Adiag);
-  g_free (Aidx);
-}
-
 /* Original Algorithm Design:
  *
  * T. Georgiev, "Photoshop Healing Brush: a Tool for Seamless Cloning
  * http://www.tgeorgiev.net/Photoshop_Healing.pdf
  */
 static void
-gimp_heal (GeglBuffer          *src_buffer,
+gimp_heal (GimpHeal            *heal,
+           GeglBuffer          *src_buffer,
            const GeglRectangle *src_rect,
            GeglBuffer          *dest_buffer,
            const GeglRectangle *dest_rect,
            GeglBuffer          *mask_buffer,
-           const GeglRectangle *mask_rect)
+           const GeglRectangle *mask_rect,
+           gint                 image_x,
+           gint                 image_y)
 {
-  const Babl *src_format;
-  const Babl *dest_format;
-  gint        src_components;
-  gint        dest_components;
-  gint        width;
-  gint        height;
-  gfloat     *diff, *diff_alloc;
-  GeglBuffer *diff_buffer;
-  guchar     *mask;
+  const Babl    *src_format;
+  const Babl    *dest_format;
+  gint           src_components;
+  gint           dest_components;
+  gint           width;
+  gint           height;
+  gfloat        *diff, *diff_alloc;
+  GeglBuffer    *diff_buffer;
+  guchar        *mask;
+  GeglRectangle  image_rect;
+  gint           n_pixels = 0;
+  gint           i;
 
   src_format  = gegl_buffer_get_format (src_buffer);
   dest_format = gegl_buffer_get_format (dest_buffer);
@@ -443,7 +387,20 @@ gimp_heal (GeglBuffer          *src_buffer,
   gegl_buffer_get (mask_buffer, mask_rect, 1.0, babl_format ("Y u8"),
                    mask, GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
 
-  gimp_heal_laplace_loop (diff, height, src_components, width, mask);
+  for (i = 0; i < width * height; i++)
+    if (mask[i])
+      n_pixels++;
+
+  gegl_rectangle_set (&image_rect, image_x, image_y, width, height);
+
+  gimp_heal_seed_solution (heal, diff, &image_rect, src_components, mask);
+
+  if (n_pixels >= MIN_MULTIGRID_PIXELS)
+    gimp_heal_laplace_multigrid (diff, width, height, src_components, mask);
+  else
+    gimp_heal_laplace_sor (diff, width, height, src_components, mask);
+
+  gimp_heal_store_solution (heal, diff, &image_rect, src_components);
 
   g_free (mask);
 
@@ -474,6 +431,7 @@ gimp_heal_motion (GimpSourceCore   *source_core,
                   gint              paint_area_width,
                   gint              paint_area_height)
 {
+  GimpHeal          *heal       = GIMP_HEAL (source_core);
   GimpPaintCore     *paint_core = GIMP_PAINT_CORE (source_core);
   GimpContext       *context    = GIMP_CONTEXT (paint_options);
   GimpDynamics      *dynamics   = GIMP_BRUSH_CORE (paint_core)->dynamics;
@@ -511,6 +469,16 @@ gimp_heal_motion (GimpSourceCore   *source_core,
       return;
     }
 
+  /*  the last solution is only a good guess for the same source offset  */
+  if (src_offset_x != heal->last_src_offset_x ||
+      src_offset_y != heal->last_src_offset_y)
+    {
+      gimp_heal_clear_solution (heal);
+
+      heal->last_src_offset_x = src_offset_x;
+      heal->last_src_offset_y = src_offset_y;
+    }
+
   /*  heal should work in perceptual space, use R'G'B' instead of RGB  */
   src_copy = gegl_buffer_new (GEGL_RECTANGLE (0, 0,
                                               src_rect->width,
@@ -545,7 +513,8 @@ gimp_heal_motion (GimpSourceCore   *source_core,
     mask_off_y = (y < 0) ? -y : 0;
   }
 
-  gimp_heal (src_copy,
+  gimp_heal (heal,
+             src_copy,
              GEGL_RECTANGLE (0, 0,
                              gegl_buffer_get_width  (src_copy),
                              gegl_buffer_get_height (src_copy)),
@@ -557,7 +526,9 @@ gimp_heal_motion (GimpSourceCore   *source_core,
              mask_buffer,
              GEGL_RECTANGLE (mask_off_x, mask_off_y,
                              paint_area_width,
-                             paint_area_height));
+                             paint_area_height),
+             paint_buffer_x + paint_area_offset_x,
+             paint_buffer_y + paint_area_offset_y);
 
   g_object_unref (src_copy);
   g_object_unref (mask_buffer);
@@ -35,6 +35,13 @@ typedef struct _GimpHealClass GimpHealClass;
 struct _GimpHeal
 {
   GimpSourceCore  parent_instance;
+
+  /*  the last dab's solution, the initial guess for the next dab  */
+  gfloat         *last_solution;
+  GeglRectangle   last_rect;
+  gint            last_depth;
+  gint            last_src_offset_x;
+  gint            last_src_offset_y;
 };
 
 struct _GimpHealClass
@@ -27,6 +27,7 @@
 
 #include "paint-types.h"
 
+#include "gegl/gimp-gegl-cow.h"
 #include "gegl/gimp-gegl-loops.h"
 #include "gegl/gimp-gegl-nodes.h"
 #include "gegl/gimp-gegl-utils.h"
@@ -108,6 +109,12 @@ static GimpUndo* gimp_paint_core_real_push_undo      (GimpPaintCore    *core,
                                                       GimpImage        *image,
                                                       const gchar      *undo_desc);
 
+static void      gimp_paint_core_add_undo_rect       (GimpPaintCore    *core,
+                                                      gint              x,
+                                                      gint              y,
+                                                      gint              width,
+                                                      gint              height);
+
 
 G_DEFINE_TYPE (GimpPaintCore, gimp_paint_core, GIMP_TYPE_OBJECT)
 
@@ -366,7 +373,16 @@ gimp_paint_core_start (GimpPaintCore     *core,
   if (core->undo_buffer)
     g_object_unref (core->undo_buffer);
 
-  core->undo_buffer = gegl_buffer_dup (gimp_drawable_get_buffer (drawable));
+  /*  shares the drawable's tiles until the stroke writes to them, also
+   *  for drawables whose tiles are shifted, which gegl_buffer_dup()
+   *  would copy.  The undo step only copies the touched tiles out of it
+   */
+  core->undo_buffer = gimp_gegl_buffer_dup (gimp_drawable_get_buffer (drawable));
+
+  if (core->undo_rects)
+    g_array_set_size (core->undo_rects, 0);
+  else
+    core->undo_rects = g_array_new (FALSE, FALSE, sizeof (GeglRectangle));
 
   /*  Allocate the saved proj structure  */
   if (core->saved_proj_buffer)
@@ -537,16 +553,15 @@ gimp_paint_core_finish (GimpPaintCore *core,
 
       GIMP_PAINT_CORE_GET_CLASS (core)->push_undo (core, image, NULL);
 
-      buffer = gegl_buffer_new (GEGL_RECTANGLE (0, 0, width, height),
-                                gimp_drawable_get_format (drawable));
-
-      gegl_buffer_copy (core->undo_buffer,
-                        GEGL_RECTANGLE (x, y, width, height),
-                        buffer,
-                        GEGL_RECTANGLE (0, 0, 0, 0));
+      buffer = gegl_buffer_create_sub_buffer (core->undo_buffer,
+                                              GEGL_RECTANGLE (x, y,
+                                                              width, height));
 
-      gimp_drawable_push_undo (drawable, NULL,
-                               buffer, x, y, width, height);
+      /*  only keep the pixels of the tiles the stroke has touched  */
+      gimp_drawable_push_undo_rects (drawable, NULL,
+                                     buffer, x, y, width, height,
+                                     (const GeglRectangle *) core->undo_rects->data,
+                                     core->undo_rects->len);
 
       g_object_unref (buffer);
 
@@ -621,6 +636,12 @@ gimp_paint_core_cleanup (GimpPaintCore *core)
       core->undo_buffer = NULL;
     }
 
+  if (core->undo_rects)
+    {
+      g_array_free (core->undo_rects, TRUE);
+      core->undo_rects = NULL;
+    }
+
   if (core->saved_proj_buffer)
     {
       g_object_unref (core->saved_proj_buffer);
@@ -962,10 +983,9 @@ gimp_paint_core_paste (GimpPaintCore            *core,
     }
 
   /*  Update the undo extents  */
-  core->x1 = MIN (core->x1, core->paint_buffer_x);
-  core->y1 = MIN (core->y1, core->paint_buffer_y);
-  core->x2 = MAX (core->x2, core->paint_buffer_x + width);
-  core->y2 = MAX (core->y2, core->paint_buffer_y + height);
+  gimp_paint_core_add_undo_rect (core,
+                                 core->paint_buffer_x, core->paint_buffer_y,
+                                 width, height);
 
   /*  Update the drawable  */
   gimp_drawable_update (drawable,
@@ -1079,10 +1099,9 @@ gimp_paint_core_replace (GimpPaintCore            *core,
   g_object_unref (paint_mask_buffer);
 
   /*  Update the undo extents  */
-  core->x1 = MIN (core->x1, core->paint_buffer_x);
-  core->y1 = MIN (core->y1, core->paint_buffer_y);
-  core->x2 = MAX (core->x2, core->paint_buffer_x + width);
-  core->y2 = MAX (core->y2, core->paint_buffer_y + height);
+  gimp_paint_core_add_undo_rect (core,
+                                 core->paint_buffer_x, core->paint_buffer_y,
+                                 width, height);
 
   /*  Update the drawable  */
   gimp_drawable_update (drawable,
@@ -1157,3 +1176,36 @@ gimp_paint_core_smooth_coords (GimpPaintCore    *core,
         }
     }
 }
+
+static void
+gimp_paint_core_add_undo_rect (GimpPaintCore *core,
+                               gint           x,
+                               gint           y,
+                               gint           width,
+                               gint           height)
+{
+  GeglRectangle rect = { x, y, width, height };
+
+  core->x1 = MIN (core->x1, x);
+  core->y1 = MIN (core->y1, y);
+  core->x2 = MAX (core->x2, x + width);
+  core->y2 = MAX (core->y2, y + height);
+
+  if (core->undo_rects)
+    {
+      /*  successive dabs mostly overlap, skip the ones that are
+       *  contained in the previous one
+       */
+      if (core->undo_rects->len > 0)
+        {
+          GeglRectangle *last = &g_array_index (core->undo_rects,
+                                                GeglRectangle,
+                                                core->undo_rects->len - 1);
+
+          if (gegl_rectangle_contains (last, &rect))
+            return;
+        }
+
+      g_array_append_val (core->undo_rects, rect);
+    }
+}
@@ -56,6 +56,7 @@ struct _GimpPaintCore
   gboolean     use_saved_proj;    /*  keep the unmodified proj around     */
 
   GeglBuffer  *undo_buffer;       /*  pixels which have been modified     */
+  GArray      *undo_rects;        /*  areas which have been modified      */
   GeglBuffer  *saved_proj_buffer; /*  proj tiles which have been modified */
   GeglBuffer  *canvas_buffer;     /*  the buffer to paint the mask to     */
   GeglBuffer  *comp_buffer;       /*  scratch buffer used when masking components */
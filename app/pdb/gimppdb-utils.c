@@ -87,6 +87,10 @@ gimp_pdb_get_brush (Gimp         *gimp,
                    _("Brush '%s' is not editable"), name);
       return NULL;
     }
+  else
+    {
+      gimp_data_ensure_loaded (GIMP_DATA (brush));
+    }
 
   return brush;
 }
@@ -176,6 +180,10 @@ gimp_pdb_get_pattern (Gimp         *gimp,
       g_set_error (error, GIMP_PDB_ERROR, GIMP_PDB_ERROR_INVALID_ARGUMENT,
                    _("Pattern '%s' not found"), name);
     }
+  else
+    {
+      gimp_data_ensure_loaded (GIMP_DATA (pattern));
+    }
 
   return pattern;
 }
@@ -62,6 +62,10 @@ static void gimp_plug_in_handle_tile_put         (GimpPlugIn      *plug_in,
                                                   GPTileReq       *request);
 static void gimp_plug_in_handle_tile_get         (GimpPlugIn      *plug_in,
                                                   GPTileReq       *request);
+static void gimp_plug_in_handle_tile_region      (GimpPlugIn      *plug_in,
+                                                  GPTileRegion    *request);
+static void gimp_plug_in_handle_tile_arena       (GimpPlugIn      *plug_in,
+                                                  GPTileArena     *request);
 static void gimp_plug_in_handle_proc_run         (GimpPlugIn      *plug_in,
                                                   GPProcRun       *proc_run);
 static void gimp_plug_in_handle_proc_return      (GimpPlugIn      *plug_in,
@@ -159,6 +163,14 @@ gimp_plug_in_handle_message (GimpPlugIn      *plug_in,
     case GP_HAS_INIT:
       gimp_plug_in_handle_has_init (plug_in);
       break;
+
+    case GP_TILE_REGION:
+      gimp_plug_in_handle_tile_region (plug_in, msg->data);
+      break;
+
+    case GP_TILE_ARENA:
+      gimp_plug_in_handle_tile_arena (plug_in, msg->data);
+      break;
     }
 }
 
@@ -468,6 +480,270 @@ gimp_plug_in_handle_tile_get (GimpPlugIn *plug_in,
   gimp_wire_destroy (&msg);
 }
 
+static GeglBuffer *
+gimp_plug_in_get_region_buffer (GimpPlugIn *plug_in,
+                                gint32      drawable_ID,
+                                gboolean    shadow,
+                                gboolean    write)
+{
+  GimpDrawable *drawable;
+
+  drawable = (GimpDrawable *) gimp_item_get_by_ID (plug_in->manager->gimp,
+                                                   drawable_ID);
+
+  if (! GIMP_IS_DRAWABLE (drawable))
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "Plug-In \"%s\"\n(%s)\n\n"
+                    "tried accessing invalid drawable %d (killing)",
+                    gimp_object_get_name (plug_in),
+                    gimp_filename_to_utf8 (plug_in->prog),
+                    drawable_ID);
+      return NULL;
+    }
+  else if (gimp_item_is_removed (GIMP_ITEM (drawable)))
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "Plug-In \"%s\"\n(%s)\n\n"
+                    "tried accessing drawable %d which was removed "
+                    "from the image (killing)",
+                    gimp_object_get_name (plug_in),
+                    gimp_filename_to_utf8 (plug_in->prog),
+                    drawable_ID);
+      return NULL;
+    }
+
+  if (shadow)
+    {
+      gimp_plug_in_cleanup_add_shadow (plug_in, drawable);
+
+      return gimp_drawable_get_shadow_buffer (drawable);
+    }
+
+  if (write)
+    {
+      if (gimp_item_is_content_locked (GIMP_ITEM (drawable)))
+        {
+          gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                        "Plug-In \"%s\"\n(%s)\n\n"
+                        "tried writing to a locked drawable %d (killing)",
+                        gimp_object_get_name (plug_in),
+                        gimp_filename_to_utf8 (plug_in->prog),
+                        drawable_ID);
+          return NULL;
+        }
+      else if (gimp_viewable_get_children (GIMP_VIEWABLE (drawable)))
+        {
+          gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                        "Plug-In \"%s\"\n(%s)\n\n"
+                        "tried writing to a group layer %d (killing)",
+                        gimp_object_get_name (plug_in),
+                        gimp_filename_to_utf8 (plug_in->prog),
+                        drawable_ID);
+          return NULL;
+        }
+    }
+
+  return gimp_drawable_get_buffer (drawable);
+}
+
+/*  Transfers a whole rectangle of pixels in one message, through the
+ *  shared memory segment if it is large enough, instead of doing a
+ *  full request/data/ack round trip for every tile.
+ */
+static void
+gimp_plug_in_handle_tile_region (GimpPlugIn   *plug_in,
+                                 GPTileRegion *request)
+{
+  GimpPlugInShm *shm      = plug_in->manager->shm;
+  guchar        *shm_addr = NULL;
+  GeglBuffer    *buffer;
+  const Babl    *format;
+  GeglRectangle  rect;
+  gsize          size;
+  gint           bpp;
+
+  g_return_if_fail (request != NULL);
+
+  buffer = gimp_plug_in_get_region_buffer (plug_in,
+                                           request->drawable_ID,
+                                           request->shadow,
+                                           request->put);
+
+  if (! buffer)
+    {
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+
+  gegl_rectangle_set (&rect,
+                      request->x, request->y,
+                      request->width, request->height);
+
+  if (rect.width <= 0 || rect.height <= 0 ||
+      ! gegl_rectangle_contains (gegl_buffer_get_extent (buffer), &rect))
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "Plug-In \"%s\"\n(%s)\n\n"
+                    "requested invalid region (killing)",
+                    gimp_object_get_name (plug_in),
+                    gimp_filename_to_utf8 (plug_in->prog));
+      gimp_plug_in_close (plug_in, TRUE);
+      return;
+    }
+
+  format = gegl_buffer_get_format (buffer);
+
+  if (! gimp_plug_in_precision_enabled (plug_in))
+    {
+      format = gimp_babl_compat_u8_format (format);
+    }
+
+  bpp  = babl_format_get_bytes_per_pixel (format);
+  size = (gsize) rect.width * (gsize) rect.height * bpp;
+
+  if (request->arena_ID)
+    {
+      GimpPlugInShm *arena = plug_in->tile_arena;
+      guint64        end;
+
+      /*  the pixels are in the plug-in's tile arena, in a slot the
+       *  plug-in owns again as soon as we answered this message
+       */
+      end = ((guint64) request->offset +
+             (guint64) request->rowstride * (rect.height - 1) +
+             (guint64) rect.width * bpp);
+
+      if (! arena                                                     ||
+          request->arena_ID  != gimp_plug_in_shm_get_arena_ID (arena) ||
+          request->rowstride <  (guint) (rect.width * bpp)            ||
+          end                >  gimp_plug_in_shm_get_size (arena)     ||
+          (request->put && request->bpp != bpp))
+        {
+          gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                        "Plug-In \"%s\"\n(%s)\n\n"
+                        "sent an invalid tile arena region (killing)",
+                        gimp_object_get_name (plug_in),
+                        gimp_filename_to_utf8 (plug_in->prog));
+          gimp_plug_in_close (plug_in, TRUE);
+          return;
+        }
+
+      shm_addr = gimp_plug_in_shm_get_addr (arena) + request->offset;
+    }
+
+  if (request->put)
+    {
+      if (! request->arena_ID &&
+          (request->bpp != bpp ||
+           (request->use_shm &&
+            (! shm || size > gimp_plug_in_shm_get_size (shm)))))
+        {
+          gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                        "Plug-In \"%s\"\n(%s)\n\n"
+                        "sent region data that doesn't match "
+                        "the drawable (killing)",
+                        gimp_object_get_name (plug_in),
+                        gimp_filename_to_utf8 (plug_in->prog));
+          gimp_plug_in_close (plug_in, TRUE);
+          return;
+        }
+
+      if (request->arena_ID)
+        gegl_buffer_set (buffer, &rect, 0, format,
+                         shm_addr, request->rowstride);
+      else
+        gegl_buffer_set (buffer, &rect, 0, format,
+                         request->use_shm ?
+                         gimp_plug_in_shm_get_addr (shm) : request->data,
+                         GEGL_AUTO_ROWSTRIDE);
+
+      if (! gp_tile_ack_write (plug_in->my_write, plug_in))
+        {
+          gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                        "%s: ERROR", G_STRFUNC);
+          gimp_plug_in_close (plug_in, TRUE);
+          return;
+        }
+    }
+  else
+    {
+      GPTileRegion region = *request;
+
+      region.bpp = bpp;
+
+      if (request->arena_ID)
+        {
+          region.use_shm = FALSE;
+          region.data    = NULL;
+
+          gegl_buffer_get (buffer, &rect, 1.0, format,
+                           shm_addr,
+                           request->rowstride, GEGL_ABYSS_NONE);
+        }
+      else
+        {
+          region.use_shm = (shm && size <= gimp_plug_in_shm_get_size (shm));
+
+          if (region.use_shm)
+            region.data = gimp_plug_in_shm_get_addr (shm);
+          else
+            region.data = g_malloc (size);
+
+          gegl_buffer_get (buffer, &rect, 1.0, format,
+                           region.data,
+                           GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+        }
+
+      if (! gp_tile_region_write (plug_in->my_write, &region, plug_in))
+        {
+          gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                        "%s: ERROR", G_STRFUNC);
+          gimp_plug_in_close (plug_in, TRUE);
+        }
+
+      if (! request->arena_ID && ! region.use_shm)
+        g_free (region.data);
+    }
+}
+
+static void
+gimp_plug_in_handle_tile_arena (GimpPlugIn  *plug_in,
+                                GPTileArena *request)
+{
+  static guint  arena_serial = 0;
+  GPTileArena   reply        = { 0, 0, -1 };
+
+  g_return_if_fail (request != NULL);
+
+  /*  a plug-in gets a single arena, for its whole lifetime  */
+  if (! request->arena_ID   &&
+      ! plug_in->tile_arena &&
+      request->size > 0     &&
+      request->size <= GP_TILE_ARENA_MAX_SIZE)
+    {
+      if (++arena_serial == 0)
+        arena_serial = 1;
+
+      plug_in->tile_arena = gimp_plug_in_shm_new_arena (request->size,
+                                                        arena_serial);
+
+      if (plug_in->tile_arena)
+        {
+          reply.arena_ID = arena_serial;
+          reply.size     = request->size;
+          reply.shm_ID   = gimp_plug_in_shm_get_ID (plug_in->tile_arena);
+        }
+    }
+
+  if (! gp_tile_arena_write (plug_in->my_write, &reply, plug_in))
+    {
+      gimp_message (plug_in->manager->gimp, NULL, GIMP_MESSAGE_ERROR,
+                    "%s: ERROR", G_STRFUNC);
+      gimp_plug_in_close (plug_in, TRUE);
+    }
+}
+
 static void
 gimp_plug_in_handle_proc_error (GimpPlugIn          *plug_in,
                                 GimpPlugInProcFrame *proc_frame,
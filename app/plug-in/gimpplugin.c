@@ -93,6 +93,7 @@
 #include "gimppluginmanager.h"
 #include "gimppluginmanager-help-domain.h"
 #include "gimppluginmanager-locale-domain.h"
+#include "gimppluginshm.h"
 #include "gimptemporaryprocedure.h"
 #include "plug-in-params.h"
 
@@ -529,6 +530,13 @@ gimp_plug_in_close (GimpPlugIn *plug_in,
       plug_in->his_write = NULL;
     }
 
+  /* The plug-in is gone, nobody uses its tile arena any longer. */
+  if (plug_in->tile_arena)
+    {
+      gimp_plug_in_shm_free (plug_in->tile_arena);
+      plug_in->tile_arena = NULL;
+    }
+
   gimp_wire_clear_error ();
 
   while (plug_in->temp_proc_frames)
@@ -69,6 +69,8 @@ struct _GimpPlugIn
   GList               *temp_proc_frames;
 
   GimpPlugInDef       *plug_in_def;     /*  Valid during query() and init()   */
+
+  GimpPlugInShm       *tile_arena;      /*  Shared memory for GEGL tiles      */
 };
 
 struct _GimpPlugInClass
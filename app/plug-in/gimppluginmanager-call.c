@@ -19,6 +19,9 @@
 
 #include "config.h"
 
+#include <stdlib.h>
+#include <string.h>
+
 #include <gegl.h>
 
 #include "libgimpbase/gimpbase.h"
@@ -41,6 +44,7 @@
 #include "gimppluginmanager.h"
 #define __YES_I_NEED_GIMP_PLUG_IN_MANAGER_CALL__
 #include "gimppluginmanager-call.h"
+#include "gimppluginmanager-menu-branch.h"
 #include "gimppluginshm.h"
 #include "gimptemporaryprocedure.h"
 #include "plug-in-params.h"
@@ -48,86 +52,57 @@
 #include "gimp-intl.h"
 
 
+typedef struct
+{
+  GimpPlugInDef *plug_in_def;
+  GimpPlugIn    *plug_in;
+  gint64         start_time;
+  gint64         time;
+} CallJob;
+
+
+static void       gimp_plug_in_manager_call_batch (GimpPlugInManager  *manager,
+                                                   GimpContext        *context,
+                                                   GSList             *plug_in_defs,
+                                                   GimpPlugInCallMode  call_mode,
+                                                   GimpInitStatusFunc  status_callback);
+static gboolean   gimp_plug_in_manager_call_start (GimpPlugInManager  *manager,
+                                                   GimpContext        *context,
+                                                   CallJob            *job,
+                                                   GimpPlugInCallMode  call_mode);
+static gint       gimp_plug_in_manager_call_job_compare
+                                                  (gconstpointer       a,
+                                                   gconstpointer       b);
+
+
 /*  public functions  */
 
 void
-gimp_plug_in_manager_call_query (GimpPlugInManager *manager,
-                                 GimpContext       *context,
-                                 GimpPlugInDef     *plug_in_def)
+gimp_plug_in_manager_call_query (GimpPlugInManager  *manager,
+                                 GimpContext        *context,
+                                 GSList             *plug_in_defs,
+                                 GimpInitStatusFunc  status_callback)
 {
-  GimpPlugIn *plug_in;
-
   g_return_if_fail (GIMP_IS_PLUG_IN_MANAGER (manager));
   g_return_if_fail (GIMP_IS_PDB_CONTEXT (context));
-  g_return_if_fail (GIMP_IS_PLUG_IN_DEF (plug_in_def));
-
-  plug_in = gimp_plug_in_new (manager, context, NULL,
-                              NULL, plug_in_def->prog);
-
-  if (plug_in)
-    {
-      plug_in->plug_in_def = plug_in_def;
-
-      if (gimp_plug_in_open (plug_in, GIMP_PLUG_IN_CALL_QUERY, TRUE))
-        {
-          while (plug_in->open)
-            {
-              GimpWireMessage msg;
-
-              if (! gimp_wire_read_msg (plug_in->my_read, &msg, plug_in))
-                {
-                  gimp_plug_in_close (plug_in, TRUE);
-                }
-              else
-                {
-                  gimp_plug_in_handle_message (plug_in, &msg);
-                  gimp_wire_destroy (&msg);
-                }
-            }
-        }
+  g_return_if_fail (status_callback != NULL);
 
-      g_object_unref (plug_in);
-    }
+  gimp_plug_in_manager_call_batch (manager, context, plug_in_defs,
+                                   GIMP_PLUG_IN_CALL_QUERY, status_callback);
 }
 
 void
-gimp_plug_in_manager_call_init (GimpPlugInManager *manager,
-                                GimpContext       *context,
-                                GimpPlugInDef     *plug_in_def)
+gimp_plug_in_manager_call_init (GimpPlugInManager  *manager,
+                                GimpContext        *context,
+                                GSList             *plug_in_defs,
+                                GimpInitStatusFunc  status_callback)
 {
-  GimpPlugIn *plug_in;
-
   g_return_if_fail (GIMP_IS_PLUG_IN_MANAGER (manager));
   g_return_if_fail (GIMP_IS_PDB_CONTEXT (context));
-  g_return_if_fail (GIMP_IS_PLUG_IN_DEF (plug_in_def));
-
-  plug_in = gimp_plug_in_new (manager, context, NULL,
-                              NULL, plug_in_def->prog);
-
-  if (plug_in)
-    {
-      plug_in->plug_in_def = plug_in_def;
-
-      if (gimp_plug_in_open (plug_in, GIMP_PLUG_IN_CALL_INIT, TRUE))
-        {
-          while (plug_in->open)
-            {
-              GimpWireMessage msg;
-
-              if (! gimp_wire_read_msg (plug_in->my_read, &msg, plug_in))
-                {
-                  gimp_plug_in_close (plug_in, TRUE);
-                }
-              else
-                {
-                  gimp_plug_in_handle_message (plug_in, &msg);
-                  gimp_wire_destroy (&msg);
-                }
-            }
-        }
+  g_return_if_fail (status_callback != NULL);
 
-      g_object_unref (plug_in);
-    }
+  gimp_plug_in_manager_call_batch (manager, context, plug_in_defs,
+                                   GIMP_PLUG_IN_CALL_INIT, status_callback);
 }
 
 GimpValueArray *
@@ -349,3 +324,237 @@ gimp_plug_in_manager_call_run_temp (GimpPlugInManager      *manager,
 
   return return_vals;
 }
+
+
+/*  private functions  */
+
+/*  Runs the query() or init() functions of a list of plug-ins, with
+ *  up to "num-processors" of them running at the same time.
+ *
+ *  All messages are still handled here, in the main thread, one at a
+ *  time: the plug-ins only ever talk to their own GimpPlugInDef and
+ *  PDB calls find their caller through manager->current_plug_in, so
+ *  the results are the same as when running the plug-ins one after
+ *  another, whatever order they finish in.  The only exception are
+ *  menu branches, which are held back and added in the order of
+ *  @plug_in_defs once all plug-ins are done.
+ */
+static void
+gimp_plug_in_manager_call_batch (GimpPlugInManager  *manager,
+                                 GimpContext        *context,
+                                 GSList             *plug_in_defs,
+                                 GimpPlugInCallMode  call_mode,
+                                 GimpInitStatusFunc  status_callback)
+{
+  Gimp     *gimp   = manager->gimp;
+  gint      n_jobs = g_slist_length (plug_in_defs);
+  gint      max_jobs;
+  CallJob  *jobs;
+  CallJob **running;
+  GPollFD  *fds;
+  GSList   *prog_names = NULL;
+  GSList   *list;
+  gint      n_running = 0;
+  gint      nth       = 0;
+  gint      i;
+
+  if (n_jobs == 0)
+    return;
+
+  max_jobs = GIMP_GEGL_CONFIG (gimp->config)->num_processors;
+
+  /*  keep a debugger wrapping the plug-ins usable  */
+  if (manager->debug)
+    max_jobs = 1;
+
+#ifdef G_OS_WIN32
+  /*  polling the plug-in pipes with g_io_channel_win32_make_pollfd()
+   *  is untested, stay on the safe side
+   */
+  max_jobs = 1;
+#endif
+
+  max_jobs = CLAMP (max_jobs, 1, n_jobs);
+
+  jobs    = g_new0 (CallJob, n_jobs);
+  running = g_new (CallJob *, max_jobs);
+  fds     = g_new (GPollFD, max_jobs);
+
+  for (list = plug_in_defs, i = 0; list; list = g_slist_next (list), i++)
+    {
+      jobs[i].plug_in_def = list->data;
+
+      prog_names = g_slist_prepend (prog_names, jobs[i].plug_in_def->prog);
+    }
+
+  prog_names = g_slist_reverse (prog_names);
+
+  gimp_plug_in_manager_hold_menu_branches (manager);
+
+  while (nth < n_jobs || n_running > 0)
+    {
+      while (nth < n_jobs && n_running < max_jobs)
+        {
+          CallJob *job      = &jobs[nth];
+          gchar   *basename;
+
+          basename = g_filename_display_basename (job->plug_in_def->prog);
+          status_callback (NULL, basename, (gdouble) nth / (gdouble) n_jobs);
+          g_free (basename);
+
+          nth++;
+
+          if (gimp_plug_in_manager_call_start (manager, context,
+                                               job, call_mode))
+            {
+              running[n_running++] = job;
+            }
+        }
+
+      if (n_running == 0)
+        continue;
+
+      if (max_jobs == 1)
+        {
+          /*  nothing to wait for but the one plug-in, block in the
+           *  read like a plain serial run does
+           */
+          fds[0].revents = G_IO_IN;
+        }
+      else
+        {
+          for (i = 0; i < n_running; i++)
+            {
+              GIOChannel *channel = running[i]->plug_in->my_read;
+
+              fds[i].fd      = g_io_channel_unix_get_fd (channel);
+              fds[i].events  = G_IO_IN | G_IO_PRI | G_IO_ERR | G_IO_HUP;
+              fds[i].revents = 0;
+            }
+
+          if (g_poll (fds, n_running, -1) < 0)
+            continue;
+        }
+
+      /*  walk backwards, finished jobs are replaced by the last one  */
+      for (i = n_running - 1; i >= 0; i--)
+        {
+          CallJob         *job     = running[i];
+          GimpPlugIn      *plug_in = job->plug_in;
+          GimpWireMessage  msg;
+
+          if (! fds[i].revents)
+            continue;
+
+          memset (&msg, 0, sizeof (GimpWireMessage));
+
+          if (! gimp_wire_read_msg (plug_in->my_read, &msg, plug_in))
+            {
+              /*  don't wait for a plug-in that already went away  */
+              if (fds[i].revents & G_IO_HUP)
+                plug_in->hup = TRUE;
+
+              gimp_plug_in_close (plug_in, TRUE);
+            }
+          else
+            {
+              gimp_plug_in_handle_message (plug_in, &msg);
+              gimp_wire_destroy (&msg);
+            }
+
+          if (! plug_in->open)
+            {
+              job->time    = g_get_monotonic_time () - job->start_time;
+              job->plug_in = NULL;
+
+              g_object_unref (plug_in);
+
+              running[i] = running[--n_running];
+            }
+        }
+    }
+
+  gimp_plug_in_manager_release_menu_branches (manager, prog_names);
+  g_slist_free (prog_names);
+
+  if (gimp->be_verbose)
+    {
+      CallJob **sorted = g_new (CallJob *, n_jobs);
+
+      for (i = 0; i < n_jobs; i++)
+        sorted[i] = &jobs[i];
+
+      qsort (sorted, n_jobs, sizeof (CallJob *),
+             gimp_plug_in_manager_call_job_compare);
+
+      g_print ("%s %d plug-ins with %d at a time:\n",
+               call_mode == GIMP_PLUG_IN_CALL_QUERY ?
+               "Queried" : "Initialized",
+               n_jobs, max_jobs);
+
+      for (i = 0; i < n_jobs; i++)
+        g_print ("  %8.3f s  %s\n",
+                 (gdouble) sorted[i]->time / G_TIME_SPAN_SECOND,
+                 gimp_filename_to_utf8 (sorted[i]->plug_in_def->prog));
+
+      g_free (sorted);
+    }
+
+  g_free (fds);
+  g_free (running);
+  g_free (jobs);
+}
+
+static gboolean
+gimp_plug_in_manager_call_start (GimpPlugInManager  *manager,
+                                 GimpContext        *context,
+                                 CallJob            *job,
+                                 GimpPlugInCallMode  call_mode)
+{
+  GimpPlugIn *plug_in;
+
+  if (manager->gimp->be_verbose)
+    g_print ("%s plug-in: '%s'\n",
+             call_mode == GIMP_PLUG_IN_CALL_QUERY ?
+             "Querying" : "Initializing",
+             gimp_filename_to_utf8 (job->plug_in_def->prog));
+
+  job->start_time = g_get_monotonic_time ();
+
+  plug_in = gimp_plug_in_new (manager, context, NULL,
+                              NULL, job->plug_in_def->prog);
+
+  if (plug_in)
+    {
+      plug_in->plug_in_def = job->plug_in_def;
+
+      if (gimp_plug_in_open (plug_in, call_mode, TRUE))
+        {
+          job->plug_in = plug_in;
+
+          return TRUE;
+        }
+
+      g_object_unref (plug_in);
+    }
+
+  job->time = g_get_monotonic_time () - job->start_time;
+
+  return FALSE;
+}
+
+/*  slowest first  */
+static gint
+gimp_plug_in_manager_call_job_compare (gconstpointer a,
+                                       gconstpointer b)
+{
+  const CallJob *job_a = *(const CallJob **) a;
+  const CallJob *job_b = *(const CallJob **) b;
+
+  if (job_a->time > job_b->time)
+    return -1;
+  else if (job_a->time < job_b->time)
+    return 1;
+
+  return 0;
+}
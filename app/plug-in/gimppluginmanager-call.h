@@ -25,17 +25,21 @@
 #endif
 
 
-/*  Call the plug-in's query() function
+/*  Call the query() function of each plug-in in the list, running
+ *  several of the plug-ins concurrently
  */
 void             gimp_plug_in_manager_call_query    (GimpPlugInManager      *manager,
                                                      GimpContext            *context,
-                                                     GimpPlugInDef          *plug_in_def);
+                                                     GSList                 *plug_in_defs,
+                                                     GimpInitStatusFunc      status_callback);
 
-/*  Call the plug-in's init() function
+/*  Call the init() function of each plug-in in the list, running
+ *  several of the plug-ins concurrently
  */
 void             gimp_plug_in_manager_call_init     (GimpPlugInManager      *manager,
                                                      GimpContext            *context,
-                                                     GimpPlugInDef          *plug_in_def);
+                                                     GSList                 *plug_in_defs,
+                                                     GimpInitStatusFunc      status_callback);
 
 /*  Run a plug-in as if it were a procedure database procedure
  */
@@ -28,6 +28,11 @@
 #include "plug-in-menu-path.h"
 
 
+static void   gimp_plug_in_manager_menu_branch_added (GimpPlugInManager    *manager,
+                                                      GimpPlugInMenuBranch *branch);
+static void   gimp_plug_in_manager_menu_branch_free  (GimpPlugInMenuBranch *branch);
+
+
 /*  public functions  */
 
 void
@@ -38,14 +43,7 @@ gimp_plug_in_manager_menu_branch_exit (GimpPlugInManager *manager)
   g_return_if_fail (GIMP_IS_PLUG_IN_MANAGER (manager));
 
   for (list = manager->menu_branches; list; list = list->next)
-    {
-      GimpPlugInMenuBranch *branch = list->data;
-
-      g_free (branch->prog_name);
-      g_free (branch->menu_path);
-      g_free (branch->menu_label);
-      g_slice_free (GimpPlugInMenuBranch, branch);
-    }
+    gimp_plug_in_manager_menu_branch_free (list->data);
 
   g_slist_free (manager->menu_branches);
   manager->menu_branches = NULL;
@@ -70,6 +68,103 @@ gimp_plug_in_manager_add_menu_branch (GimpPlugInManager *manager,
   branch->menu_path  = plug_in_menu_path_map (menu_path, menu_label);
   branch->menu_label = g_strdup (menu_label);
 
+  if (manager->held_menu_branches)
+    {
+      GSList *branches;
+
+      branches = g_hash_table_lookup (manager->held_menu_branches, prog_name);
+      branches = g_slist_append (branches, branch);
+
+      g_hash_table_insert (manager->held_menu_branches,
+                           g_strdup (prog_name), branches);
+    }
+  else
+    {
+      gimp_plug_in_manager_menu_branch_added (manager, branch);
+    }
+}
+
+GSList *
+gimp_plug_in_manager_get_menu_branches (GimpPlugInManager *manager)
+{
+  g_return_val_if_fail (GIMP_IS_PLUG_IN_MANAGER (manager), NULL);
+
+  return manager->menu_branches;
+}
+
+/*  Until gimp_plug_in_manager_release_menu_branches() is called, menu
+ *  branches are kept per plug-in instead of being added right away,
+ *  so that plug-ins which run at the same time can't mix up the order
+ *  of the branches.
+ */
+void
+gimp_plug_in_manager_hold_menu_branches (GimpPlugInManager *manager)
+{
+  g_return_if_fail (GIMP_IS_PLUG_IN_MANAGER (manager));
+  g_return_if_fail (manager->held_menu_branches == NULL);
+
+  manager->held_menu_branches = g_hash_table_new_full (g_str_hash,
+                                                       g_str_equal,
+                                                       g_free, NULL);
+}
+
+/*  Adds the held menu branches of the plug-ins in @prog_names, in the
+ *  order of @prog_names, as if the plug-ins had run one after another.
+ */
+void
+gimp_plug_in_manager_release_menu_branches (GimpPlugInManager *manager,
+                                            GSList            *prog_names)
+{
+  GHashTable *held;
+  GSList     *list;
+
+  g_return_if_fail (GIMP_IS_PLUG_IN_MANAGER (manager));
+  g_return_if_fail (manager->held_menu_branches != NULL);
+
+  held = manager->held_menu_branches;
+  manager->held_menu_branches = NULL;
+
+  for (list = prog_names; list; list = g_slist_next (list))
+    {
+      GSList *branches = g_hash_table_lookup (held, list->data);
+      GSList *iter;
+
+      for (iter = branches; iter; iter = g_slist_next (iter))
+        gimp_plug_in_manager_menu_branch_added (manager, iter->data);
+
+      g_slist_free (branches);
+      g_hash_table_remove (held, list->data);
+    }
+
+  /*  branches added by anything else in the meantime, in no
+   *  particular order
+   */
+  if (g_hash_table_size (held) > 0)
+    {
+      GHashTableIter iter;
+      gpointer       branches;
+
+      g_hash_table_iter_init (&iter, held);
+
+      while (g_hash_table_iter_next (&iter, NULL, &branches))
+        {
+          for (list = branches; list; list = g_slist_next (list))
+            gimp_plug_in_manager_menu_branch_added (manager, list->data);
+
+          g_slist_free (branches);
+        }
+    }
+
+  g_hash_table_unref (held);
+}
+
+
+/*  private functions  */
+
+static void
+gimp_plug_in_manager_menu_branch_added (GimpPlugInManager    *manager,
+                                        GimpPlugInMenuBranch *branch)
+{
   manager->menu_branches = g_slist_append (manager->menu_branches, branch);
 
   g_signal_emit_by_name (manager, "menu-branch-added",
@@ -83,10 +178,11 @@ gimp_plug_in_manager_add_menu_branch (GimpPlugInManager *manager,
 #endif
 }
 
-GSList *
-gimp_plug_in_manager_get_menu_branches (GimpPlugInManager *manager)
+static void
+gimp_plug_in_manager_menu_branch_free (GimpPlugInMenuBranch *branch)
 {
-  g_return_val_if_fail (GIMP_IS_PLUG_IN_MANAGER (manager), NULL);
-
-  return manager->menu_branches;
+  g_free (branch->prog_name);
+  g_free (branch->menu_path);
+  g_free (branch->menu_label);
+  g_slice_free (GimpPlugInMenuBranch, branch);
 }
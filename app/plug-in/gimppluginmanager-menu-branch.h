@@ -38,5 +38,10 @@ void     gimp_plug_in_manager_add_menu_branch   (GimpPlugInManager *manager,
                                                  const gchar       *menu_label);
 GSList * gimp_plug_in_manager_get_menu_branches (GimpPlugInManager *manager);
 
+/* Keep the menu branches of plug-ins running concurrently in order */
+void     gimp_plug_in_manager_hold_menu_branches    (GimpPlugInManager *manager);
+void     gimp_plug_in_manager_release_menu_branches (GimpPlugInManager *manager,
+                                                     GSList            *prog_names);
+
 
 #endif /* __GIMP_PLUG_IN_MANAGER_MENU_BRANCH_H__ */
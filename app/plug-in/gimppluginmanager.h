@@ -49,6 +49,7 @@ struct _GimpPlugInManager
   GSList            *export_procs;
 
   GSList            *menu_branches;
+  GHashTable        *held_menu_branches;
   GSList            *locale_domains;
   GSList            *help_domains;
 
@@ -61,6 +61,9 @@
 
 #endif /* G_OS_WIN32 || G_WITH_CYGWIN */
 
+#include "libgimpbase/gimpbase.h"
+#include "libgimpbase/gimpprotocol.h"
+
 #include "plug-in-types.h"
 
 #include "core/gimp-utils.h"
@@ -70,7 +73,8 @@
 #include "gimp-log.h"
 
 
-#define TILE_MAP_SIZE (GIMP_PLUG_IN_TILE_WIDTH * GIMP_PLUG_IN_TILE_HEIGHT * 16)
+#define TILE_MAP_SIZE (GIMP_PLUG_IN_TILE_WIDTH * GIMP_PLUG_IN_TILE_HEIGHT * 16 * \
+                       GP_SHM_N_TILES)
 
 #define ERRMSG_SHM_DISABLE "Disabling shared memory tile transport"
 
@@ -79,6 +83,8 @@ struct _GimpPlugInShm
 {
   gint    shm_ID;
   guchar *shm_addr;
+  gsize   size;
+  guint   arena_ID;
 
 #if defined(USE_WIN32_SHM)
   HANDLE  shm_handle;
@@ -86,6 +92,16 @@ struct _GimpPlugInShm
 };
 
 
+static GimpPlugInShm * gimp_plug_in_shm_new_internal (gsize  size,
+                                                      guint  arena_ID);
+#if defined(USE_WIN32_SHM) || defined(USE_POSIX_SHM)
+static void            gimp_plug_in_shm_get_name     (gint   shm_ID,
+                                                      guint  arena_ID,
+                                                      gchar *name,
+                                                      gsize  name_size);
+#endif
+
+
 GimpPlugInShm *
 gimp_plug_in_shm_new (void)
 {
@@ -94,15 +110,116 @@ gimp_plug_in_shm_new (void)
    *  we'll fall back on sending the data over the pipe.
    */
 
+  return gimp_plug_in_shm_new_internal (TILE_MAP_SIZE, 0);
+}
+
+/* allocate a tile arena, a piece of shared memory private to a single
+ *  plug-in, see GPTileArena.  The plug-in finds it by @arena_ID, which
+ *  must be unique and not 0.
+ */
+GimpPlugInShm *
+gimp_plug_in_shm_new_arena (gsize size,
+                            guint arena_ID)
+{
+  g_return_val_if_fail (size > 0, NULL);
+  g_return_val_if_fail (arena_ID > 0, NULL);
+
+  return gimp_plug_in_shm_new_internal (size, arena_ID);
+}
+
+void
+gimp_plug_in_shm_free (GimpPlugInShm *shm)
+{
+  g_return_if_fail (shm != NULL);
+
+  if (shm->shm_ID != -1)
+    {
+
+#if defined (USE_SYSV_SHM)
+
+      shmdt (shm->shm_addr);
+
+#ifndef IPC_RMID_DEFERRED_RELEASE
+      shmctl (shm->shm_ID, IPC_RMID, NULL);
+#endif
+
+#elif defined(USE_WIN32_SHM)
+
+      if (shm->shm_addr)
+        UnmapViewOfFile (shm->shm_addr);
+
+      if (shm->shm_handle)
+        CloseHandle (shm->shm_handle);
+
+#elif defined(USE_POSIX_SHM)
+
+      gchar shm_handle[32];
+
+      munmap (shm->shm_addr, shm->size);
+
+      gimp_plug_in_shm_get_name (shm->shm_ID, shm->arena_ID,
+                                 shm_handle, sizeof (shm_handle));
+
+      shm_unlink (shm_handle);
+
+#endif
+
+      GIMP_LOG (SHM, "detached shared memory segment ID = %d", shm->shm_ID);
+    }
+
+  g_slice_free (GimpPlugInShm, shm);
+}
+
+gint
+gimp_plug_in_shm_get_ID (GimpPlugInShm *shm)
+{
+  g_return_val_if_fail (shm != NULL, -1);
+
+  return shm->shm_ID;
+}
+
+guchar *
+gimp_plug_in_shm_get_addr (GimpPlugInShm *shm)
+{
+  g_return_val_if_fail (shm != NULL, NULL);
+
+  return shm->shm_addr;
+}
+
+gsize
+gimp_plug_in_shm_get_size (GimpPlugInShm *shm)
+{
+  g_return_val_if_fail (shm != NULL, 0);
+
+  return shm->size;
+}
+
+guint
+gimp_plug_in_shm_get_arena_ID (GimpPlugInShm *shm)
+{
+  g_return_val_if_fail (shm != NULL, 0);
+
+  return shm->arena_ID;
+}
+
+
+/*  private functions  */
+
+static GimpPlugInShm *
+gimp_plug_in_shm_new_internal (gsize size,
+                               guint arena_ID)
+{
   GimpPlugInShm *shm = g_slice_new0 (GimpPlugInShm);
 
-  shm->shm_ID = -1;
+  shm->shm_ID   = -1;
+  shm->size     = size;
+  shm->arena_ID = arena_ID;
 
 #if defined(USE_SYSV_SHM)
 
   /* Use SysV shared memory mechanisms for transferring tile data. */
   {
-    shm->shm_ID = shmget (IPC_PRIVATE, TILE_MAP_SIZE, IPC_CREAT | 0600);
+    shm->shm_ID = shmget (IPC_PRIVATE, size, IPC_CREAT | 0600);
 
     if (shm->shm_ID != -1)
       {
@@ -139,12 +256,13 @@ gimp_plug_in_shm_new (void)
     pid = GetCurrentProcessId ();
 
     /* From the id, derive the file map name */
-    g_snprintf (fileMapName, sizeof (fileMapName), "GIMP%d.SHM", pid);
+    gimp_plug_in_shm_get_name (pid, arena_ID,
+                               fileMapName, sizeof (fileMapName));
 
     /* Create the file mapping into paging space */
     shm->shm_handle = CreateFileMapping (INVALID_HANDLE_VALUE, NULL,
                                          PAGE_READWRITE, 0,
-                                         TILE_MAP_SIZE,
+                                         size,
                                          fileMapName);
 
     if (shm->shm_handle)
@@ -152,7 +270,7 @@ gimp_plug_in_shm_new (void)
         /* Map the shared memory into our address space for use */
         shm->shm_addr = (guchar *) MapViewOfFile (shm->shm_handle,
                                                   FILE_MAP_ALL_ACCESS,
-                                                  0, 0, TILE_MAP_SIZE);
+                                                  0, 0, size);
 
         /* Verify that we mapped our view */
         if (shm->shm_addr)
@@ -184,17 +302,18 @@ gimp_plug_in_shm_new (void)
     pid = gimp_get_pid ();
 
     /* From the id, derive the file map name */
-    g_snprintf (shm_handle, sizeof (shm_handle), "/gimp-shm-%d", pid);
+    gimp_plug_in_shm_get_name (pid, arena_ID,
+                               shm_handle, sizeof (shm_handle));
 
     /* Create the file mapping into paging space */
     shm_fd = shm_open (shm_handle, O_RDWR | O_CREAT, 0600);
 
     if (shm_fd != -1)
       {
-        if (ftruncate (shm_fd, TILE_MAP_SIZE) != -1)
+        if (ftruncate (shm_fd, size) != -1)
           {
             /* Map the shared memory into our address space for use */
-            shm->shm_addr = (guchar *) mmap (NULL, TILE_MAP_SIZE,
+            shm->shm_addr = (guchar *) mmap (NULL, size,
                                              PROT_READ | PROT_WRITE, MAP_SHARED,
                                              shm_fd, 0);
 
@@ -243,58 +362,28 @@ gimp_plug_in_shm_new (void)
   return shm;
 }
 
-void
-gimp_plug_in_shm_free (GimpPlugInShm *shm)
-{
-  g_return_if_fail (shm != NULL);
+#if defined(USE_WIN32_SHM) || defined(USE_POSIX_SHM)
 
-  if (shm->shm_ID != -1)
-    {
-
-#if defined (USE_SYSV_SHM)
-
-      shmdt (shm->shm_addr);
-
-#ifndef IPC_RMID_DEFERRED_RELEASE
-      shmctl (shm->shm_ID, IPC_RMID, NULL);
-#endif
-
-#elif defined(USE_WIN32_SHM)
-
-      if (shm->shm_handle)
-        CloseHandle (shm->shm_handle);
-
-#elif defined(USE_POSIX_SHM)
-
-      gchar shm_handle[32];
-
-      munmap (shm->shm_addr, TILE_MAP_SIZE);
-
-      g_snprintf (shm_handle, sizeof (shm_handle), "/gimp-shm-%d",
-                  shm->shm_ID);
-
-      shm_unlink (shm_handle);
-
-#endif
-
-      GIMP_LOG (SHM, "detached shared memory segment ID = %d", shm->shm_ID);
-    }
-
-  g_slice_free (GimpPlugInShm, shm);
-}
-
-gint
-gimp_plug_in_shm_get_ID (GimpPlugInShm *shm)
+/* the segments are named after the core's process ID and, for tile
+ *  arenas, the arena ID, see gimp_tile_arena_attach() in libgimp.
+ */
+static void
+gimp_plug_in_shm_get_name (gint   shm_ID,
+                           guint  arena_ID,
+                           gchar *name,
+                           gsize  name_size)
 {
-  g_return_val_if_fail (shm != NULL, -1);
-
-  return shm->shm_ID;
+#if defined(USE_WIN32_SHM)
+  if (arena_ID)
+    g_snprintf (name, name_size, "GIMP%d-%u.SHM", shm_ID, arena_ID);
+  else
+    g_snprintf (name, name_size, "GIMP%d.SHM", shm_ID);
+#else
+  if (arena_ID)
+    g_snprintf (name, name_size, "/gimp-shm-%d-%u", shm_ID, arena_ID);
+  else
+    g_snprintf (name, name_size, "/gimp-shm-%d", shm_ID);
+#endif
 }
 
-guchar *
-gimp_plug_in_shm_get_addr (GimpPlugInShm *shm)
-{
-  g_return_val_if_fail (shm != NULL, NULL);
-
-  return shm->shm_addr;
-}
+#endif /* USE_WIN32_SHM || USE_POSIX_SHM */
@@ -0,0 +1,304 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*  Benchmark for the color space conversions of libgimpcolor.
+ *
+ *  Usage: perf-color-space [N_PIXELS [N_RUNS]]
+ *
+ *  Converts N_PIXELS (default 1M) random RGBA pixels N_RUNS (default
+ *  10) times between RGB and HSV, HSL and CMYK, once pixel by pixel
+ *  with the GimpRGB functions and twice with the gimp_*_floats()
+ *  functions, with CPU acceleration disabled and enabled, and prints the
+ *  Mpixels/s of each.  That the results are the same is checked by
+ *  test-color-space.
+ */
+
+#include <stdlib.h>
+
+#include <gegl.h>
+
+#include "libgimpbase/gimpbase.h"
+#include "libgimpcolor/gimpcolor.h"
+
+
+#define PULLOUT 0.5
+
+
+typedef void (* ConvertFunc) (const gfloat *src,
+                              gfloat       *dest,
+                              glong         n_pixels);
+
+typedef struct
+{
+  const gchar *name;
+  ConvertFunc  pixel_func;
+  ConvertFunc  bulk_func;
+} Conversion;
+
+
+static void
+rgb_to_hsv_pixels (const gfloat *src,
+                   gfloat       *dest,
+                   glong         n_pixels)
+{
+  for (; n_pixels--; src += 4, dest += 4)
+    {
+      GimpRGB rgb = { src[0], src[1], src[2], src[3] };
+      GimpHSV hsv;
+
+      gimp_rgb_to_hsv (&rgb, &hsv);
+
+      dest[0] = hsv.h;
+      dest[1] = hsv.s;
+      dest[2] = hsv.v;
+    }
+}
+
+static void
+rgb_to_hsv_bulk (const gfloat *src,
+                 gfloat       *dest,
+                 glong         n_pixels)
+{
+  gimp_rgb_to_hsv_floats (src, 4, dest, 4, n_pixels);
+}
+
+static void
+hsv_to_rgb_pixels (const gfloat *src,
+                   gfloat       *dest,
+                   glong         n_pixels)
+{
+  for (; n_pixels--; src += 4, dest += 4)
+    {
+      GimpHSV hsv = { src[0], src[1], src[2], src[3] };
+      GimpRGB rgb;
+
+      gimp_hsv_to_rgb (&hsv, &rgb);
+
+      dest[0] = rgb.r;
+      dest[1] = rgb.g;
+      dest[2] = rgb.b;
+    }
+}
+
+static void
+hsv_to_rgb_bulk (const gfloat *src,
+                 gfloat       *dest,
+                 glong         n_pixels)
+{
+  gimp_hsv_to_rgb_floats (src, 4, dest, 4, n_pixels);
+}
+
+static void
+rgb_to_hsl_pixels (const gfloat *src,
+                   gfloat       *dest,
+                   glong         n_pixels)
+{
+  for (; n_pixels--; src += 4, dest += 4)
+    {
+      GimpRGB rgb = { src[0], src[1], src[2], src[3] };
+      GimpHSL hsl;
+
+      gimp_rgb_to_hsl (&rgb, &hsl);
+
+      dest[0] = hsl.h;
+      dest[1] = hsl.s;
+      dest[2] = hsl.l;
+    }
+}
+
+static void
+rgb_to_hsl_bulk (const gfloat *src,
+                 gfloat       *dest,
+                 glong         n_pixels)
+{
+  gimp_rgb_to_hsl_floats (src, 4, dest, 4, n_pixels);
+}
+
+static void
+hsl_to_rgb_pixels (const gfloat *src,
+                   gfloat       *dest,
+                   glong         n_pixels)
+{
+  for (; n_pixels--; src += 4, dest += 4)
+    {
+      GimpHSL hsl = { src[0], src[1], src[2], src[3] };
+      GimpRGB rgb;
+
+      gimp_hsl_to_rgb (&hsl, &rgb);
+
+      dest[0] = rgb.r;
+      dest[1] = rgb.g;
+      dest[2] = rgb.b;
+    }
+}
+
+static void
+hsl_to_rgb_bulk (const gfloat *src,
+                 gfloat       *dest,
+                 glong         n_pixels)
+{
+  gimp_hsl_to_rgb_floats (src, 4, dest, 4, n_pixels);
+}
+
+static void
+rgb_to_cmyk_pixels (const gfloat *src,
+                    gfloat       *dest,
+                    glong         n_pixels)
+{
+  for (; n_pixels--; src += 4, dest += 4)
+    {
+      GimpRGB  rgb = { src[0], src[1], src[2], src[3] };
+      GimpCMYK cmyk;
+
+      gimp_rgb_to_cmyk (&rgb, PULLOUT, &cmyk);
+
+      dest[0] = cmyk.c;
+      dest[1] = cmyk.m;
+      dest[2] = cmyk.y;
+      dest[3] = cmyk.k;
+    }
+}
+
+static void
+rgb_to_cmyk_bulk (const gfloat *src,
+                  gfloat       *dest,
+                  glong         n_pixels)
+{
+  gimp_rgb_to_cmyk_floats (src, 4, PULLOUT, dest, 4, n_pixels);
+}
+
+static void
+cmyk_to_rgb_pixels (const gfloat *src,
+                    gfloat       *dest,
+                    glong         n_pixels)
+{
+  for (; n_pixels--; src += 4, dest += 4)
+    {
+      GimpCMYK cmyk = { src[0], src[1], src[2], src[3], 1.0 };
+      GimpRGB  rgb;
+
+      gimp_cmyk_to_rgb (&cmyk, &rgb);
+
+      dest[0] = rgb.r;
+      dest[1] = rgb.g;
+      dest[2] = rgb.b;
+    }
+}
+
+static void
+cmyk_to_rgb_bulk (const gfloat *src,
+                  gfloat       *dest,
+                  glong         n_pixels)
+{
+  gimp_cmyk_to_rgb_floats (src, 4, dest, 4, n_pixels);
+}
+
+
+static const Conversion conversions[] =
+{
+  { "rgb -> hsv",  rgb_to_hsv_pixels,  rgb_to_hsv_bulk  },
+  { "hsv -> rgb",  hsv_to_rgb_pixels,  hsv_to_rgb_bulk  },
+  { "rgb -> hsl",  rgb_to_hsl_pixels,  rgb_to_hsl_bulk  },
+  { "hsl -> rgb",  hsl_to_rgb_pixels,  hsl_to_rgb_bulk  },
+  { "rgb -> cmyk", rgb_to_cmyk_pixels, rgb_to_cmyk_bulk },
+  { "cmyk -> rgb", cmyk_to_rgb_pixels, cmyk_to_rgb_bulk }
+};
+
+
+static gdouble
+run_conversion (ConvertFunc   func,
+                const gfloat *src,
+                gfloat       *dest,
+                glong         n_pixels,
+                gint          n_runs,
+                GTimer       *timer)
+{
+  gint run;
+
+  g_timer_start (timer);
+
+  for (run = 0; run < n_runs; run++)
+    func (src, dest, n_pixels);
+
+  g_timer_stop (timer);
+
+  return (gdouble) n_pixels * n_runs / g_timer_elapsed (timer, NULL) / 1e6;
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  GRand    *rand;
+  GTimer   *timer;
+  gfloat   *src;
+  gfloat   *dest;
+  glong     n_pixels = 1024 * 1024;
+  gint      n_runs   = 10;
+  glong     i;
+
+  if (argc > 1)
+    n_pixels = MAX (atol (argv[1]), 1);
+
+  if (argc > 2)
+    n_runs = MAX (atoi (argv[2]), 1);
+
+  rand  = g_rand_new_with_seed (42);
+  timer = g_timer_new ();
+
+  src  = g_new  (gfloat, n_pixels * 4);
+  dest = g_new0 (gfloat, n_pixels * 4);
+
+  /*  8-bit values, like most images have  */
+  for (i = 0; i < n_pixels * 4; i++)
+    src[i] = g_rand_int_range (rand, 0, 256) / 255.0;
+
+  g_print ("%ld pixels, Mpixels/s per pixel vs. generic vs. accelerated\n",
+           n_pixels);
+
+  for (i = 0; i < G_N_ELEMENTS (conversions); i++)
+    {
+      const Conversion *conversion = &conversions[i];
+      gdouble           pixel_rate;
+      gdouble           generic_rate;
+      gdouble           accel_rate;
+
+      pixel_rate = run_conversion (conversion->pixel_func,
+                                   src, dest, n_pixels, n_runs, timer);
+
+      gimp_cpu_accel_set_use (FALSE);
+      generic_rate = run_conversion (conversion->bulk_func,
+                                     src, dest, n_pixels, n_runs, timer);
+
+      gimp_cpu_accel_set_use (TRUE);
+      accel_rate = run_conversion (conversion->bulk_func,
+                                   src, dest, n_pixels, n_runs, timer);
+
+      g_print ("%-12s %10.1f %10.1f %10.1f  %5.2fx\n",
+               conversion->name,
+               pixel_rate, generic_rate, accel_rate,
+               accel_rate / pixel_rate);
+    }
+
+  g_free (src);
+  g_free (dest);
+
+  g_timer_destroy (timer);
+  g_rand_free (rand);
+
+  return 0;
+}
@@ -0,0 +1,191 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*  Benchmark for seed fills, as used by fuzzy select and bucket fill.
+ *
+ *  Usage: perf-contiguous-region [SIZE [N_RUNS]]
+ *
+ *  Fills a SIZE x SIZE layer (default 4096) with a few patterns and
+ *  prints the time a seed fill from its corner takes for each.
+ */
+
+#include <stdlib.h>
+
+#include <gegl.h>
+
+#include "core/core-types.h"
+
+#include "core/gimp.h"
+#include "core/gimp-parallel.h"
+#include "core/gimpdrawable.h"
+#include "core/gimpimage.h"
+#include "core/gimpimage-contiguous-region.h"
+#include "core/gimplayer.h"
+
+#include "tests.h"
+
+
+typedef enum
+{
+  PATTERN_UNIFORM, /* one region covering the whole layer          */
+  PATTERN_MAZE,    /* one-pixel walls forcing a serpentine fill     */
+  PATTERN_NOISE,   /* random values, about 40% of them fillable     */
+  PATTERN_RINGS    /* concentric rings, fill reaches the outer ring */
+} Pattern;
+
+static const gchar *pattern_names[] =
+{
+  "uniform",
+  "maze",
+  "noise",
+  "rings"
+};
+
+
+static void
+fill_pattern (GimpDrawable *drawable,
+              Pattern       pattern)
+{
+  GeglBuffer         *buffer = gimp_drawable_get_buffer (drawable);
+  gint                size   = gegl_buffer_get_width (buffer);
+  GeglBufferIterator *iter;
+  GRand              *rand   = g_rand_new_with_seed (42);
+
+  iter = gegl_buffer_iterator_new (buffer, NULL, 0, babl_format ("Y' u8"),
+                                   GEGL_BUFFER_WRITE, GEGL_ABYSS_NONE);
+
+  while (gegl_buffer_iterator_next (iter))
+    {
+      guchar *dest = iter->data[0];
+      gint    x, y;
+
+      for (y = iter->roi[0].y; y < iter->roi[0].y + iter->roi[0].height; y++)
+        for (x = iter->roi[0].x; x < iter->roi[0].x + iter->roi[0].width; x++)
+          {
+            guchar value = 255;
+
+            switch (pattern)
+              {
+              case PATTERN_UNIFORM:
+                break;
+
+              case PATTERN_MAZE:
+                /*  a wall every 4th column, open at alternating ends  */
+                if (x % 4 == 3)
+                  {
+                    if ((x / 4) % 2 ? y != 0 : y != size - 1)
+                      value = 0;
+                  }
+                break;
+
+              case PATTERN_NOISE:
+                value = g_rand_int_range (rand, 0, 2) ? 255 : 128;
+                if (g_rand_int_range (rand, 0, 5) == 0)
+                  value = 0;
+                if (x == 0 && y == 0)
+                  value = 255;
+                break;
+
+              case PATTERN_RINGS:
+                if ((MAX (ABS (x - size / 2), ABS (y - size / 2)) / 8) % 2)
+                  value = 0;
+                break;
+              }
+
+            *dest++ = value;
+          }
+    }
+
+  g_rand_free (rand);
+
+  gimp_drawable_update (drawable, 0, 0, size, size);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  Gimp      *gimp;
+  GimpImage *image;
+  GimpLayer *layer;
+  GTimer    *timer;
+  gint       size   = 4096;
+  gint       n_runs = 3;
+  Pattern    pattern;
+
+  if (argc > 1)
+    size = MAX (atoi (argv[1]), 1);
+
+  if (argc > 2)
+    n_runs = MAX (atoi (argv[2]), 1);
+
+  gimp = gimp_init_for_testing ();
+  gimp_parallel_init (gimp);
+
+  image = gimp_image_new (gimp, size, size, GIMP_GRAY,
+                          GIMP_PRECISION_U8_GAMMA);
+
+  layer = gimp_layer_new (image, size, size,
+                          gimp_image_get_layer_format (image, FALSE),
+                          "Benchmark",
+                          GIMP_OPACITY_OPAQUE,
+                          GIMP_NORMAL_MODE);
+
+  gimp_image_add_layer (image, layer, NULL, 0, FALSE);
+
+  timer = g_timer_new ();
+
+  g_print ("%d x %d, %d threads\n",
+           size, size, gimp_parallel_get_n_threads ());
+
+  for (pattern = PATTERN_UNIFORM; pattern <= PATTERN_RINGS; pattern++)
+    {
+      gdouble total = 0.0;
+      gint    run;
+
+      fill_pattern (GIMP_DRAWABLE (layer), pattern);
+
+      for (run = 0; run < n_runs; run++)
+        {
+          GeglBuffer *mask;
+
+          g_timer_start (timer);
+
+          mask = gimp_image_contiguous_region_by_seed (image,
+                                                       GIMP_DRAWABLE (layer),
+                                                       FALSE, TRUE, 0.1,
+                                                       FALSE,
+                                                       GIMP_SELECT_CRITERION_COMPOSITE,
+                                                       0, 0);
+
+          total += g_timer_elapsed (timer, NULL);
+
+          g_object_unref (mask);
+        }
+
+      g_print ("%-8s %10.3f s\n", pattern_names[pattern], total / n_runs);
+    }
+
+  g_timer_destroy (timer);
+
+  g_object_unref (image);
+
+  gimp_parallel_exit (gimp);
+  gimp_exit (gimp, TRUE);
+
+  return 0;
+}
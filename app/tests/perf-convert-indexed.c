@@ -0,0 +1,253 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*  Benchmark for the conversion to indexed colors.
+ *
+ *  Usage: perf-convert-indexed [SIZE [N_THREADS]]
+ *
+ *  Converts a SIZE x SIZE RGBA image (default 2048) to a generated
+ *  palette of 256 colors, without dithering and with Floyd-Steinberg
+ *  dithering, once with the old serial code and once using N_THREADS
+ *  (default "num-processors"), prints the times and fails if the
+ *  resulting pixels or colormaps differ.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <gegl.h>
+
+#include "core/core-types.h"
+
+#include "core/gimp.h"
+#include "core/gimp-parallel.h"
+#include "core/gimpdrawable.h"
+#include "core/gimpimage.h"
+#include "core/gimpimage-colormap.h"
+#include "core/gimpimage-convert-type.h"
+#include "core/gimpimage-duplicate.h"
+#include "core/gimplayer.h"
+
+#include "gimpimage-convert-type-serial.h"
+#include "tests.h"
+
+
+static void
+fill_image (GimpDrawable *drawable)
+{
+  GeglBuffer         *buffer = gimp_drawable_get_buffer (drawable);
+  gint                size   = gegl_buffer_get_width (buffer);
+  GeglBufferIterator *iter;
+  GRand              *rand   = g_rand_new_with_seed (42);
+
+  iter = gegl_buffer_iterator_new (buffer, NULL, 0,
+                                   babl_format ("R'G'B'A u8"),
+                                   GEGL_BUFFER_WRITE, GEGL_ABYSS_NONE);
+
+  while (gegl_buffer_iterator_next (iter))
+    {
+      guchar *dest = iter->data[0];
+      gint    x, y;
+
+      for (y = iter->roi[0].y; y < iter->roi[0].y + iter->roi[0].height; y++)
+        for (x = iter->roi[0].x; x < iter->roi[0].x + iter->roi[0].width; x++)
+          {
+            /*  smooth gradients with some noise, and a transparent
+             *  band to exercise the alpha handling
+             */
+            *dest++ = (x * 255 / size + g_rand_int_range (rand, 0, 16)) & 0xff;
+            *dest++ = (y * 255 / size + g_rand_int_range (rand, 0, 16)) & 0xff;
+            *dest++ = ((x + y) * 127 / size) & 0xff;
+            *dest++ = (y / 64) % 8 ? 255 : g_rand_int_range (rand, 0, 256);
+          }
+    }
+
+  g_rand_free (rand);
+
+  gimp_drawable_update (drawable, 0, 0, size, size);
+}
+
+static GimpImage *
+convert (Gimp                  *gimp,
+         GimpImage             *image,
+         gint                   n_threads,
+         GimpConvertDitherType  dither,
+         GTimer                *timer)
+{
+  GimpImage *copy = gimp_image_duplicate (image);
+
+  g_object_set (gimp->config,
+                "num-processors", n_threads,
+                NULL);
+
+  g_timer_start (timer);
+
+  gimp_image_convert_type (copy, GIMP_INDEXED,
+                           256, dither, FALSE, FALSE, FALSE,
+                           GIMP_MAKE_PALETTE, NULL, NULL, NULL);
+
+  g_timer_stop (timer);
+
+  return copy;
+}
+
+/*  converts with the code from before the conversion was parallel  */
+static GimpImage *
+convert_serial (GimpImage             *image,
+                GimpConvertDitherType  dither,
+                GTimer                *timer)
+{
+  GimpImage *copy = gimp_image_duplicate (image);
+
+  g_timer_start (timer);
+
+  gimp_image_convert_type_serial (copy, GIMP_INDEXED,
+                                  256, dither, FALSE, FALSE, FALSE,
+                                  GIMP_MAKE_PALETTE, NULL, NULL, NULL);
+
+  g_timer_stop (timer);
+
+  return copy;
+}
+
+static gboolean
+images_equal (GimpImage *a,
+              GimpImage *b)
+{
+  GimpLayer  *layer_a = gimp_image_get_active_layer (a);
+  GimpLayer  *layer_b = gimp_image_get_active_layer (b);
+  GeglBuffer *buffer_a;
+  GeglBuffer *buffer_b;
+  gsize       size;
+  guchar     *data_a;
+  guchar     *data_b;
+  gboolean    equal;
+
+  if (gimp_image_get_colormap_size (a) != gimp_image_get_colormap_size (b) ||
+      memcmp (gimp_image_get_colormap (a),
+              gimp_image_get_colormap (b),
+              gimp_image_get_colormap_size (a) * 3))
+    return FALSE;
+
+  buffer_a = gimp_drawable_get_buffer (GIMP_DRAWABLE (layer_a));
+  buffer_b = gimp_drawable_get_buffer (GIMP_DRAWABLE (layer_b));
+
+  if (gegl_buffer_get_format (buffer_a) != gegl_buffer_get_format (buffer_b))
+    return FALSE;
+
+  size = ((gsize) gegl_buffer_get_width (buffer_a) *
+          gegl_buffer_get_height (buffer_a) *
+          babl_format_get_bytes_per_pixel (gegl_buffer_get_format (buffer_a)));
+
+  data_a = g_malloc (size);
+  data_b = g_malloc (size);
+
+  gegl_buffer_get (buffer_a, NULL, 1.0, NULL, data_a,
+                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+  gegl_buffer_get (buffer_b, NULL, 1.0, NULL, data_b,
+                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+  equal = (memcmp (data_a, data_b, size) == 0);
+
+  g_free (data_a);
+  g_free (data_b);
+
+  return equal;
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  Gimp                  *gimp;
+  GimpImage             *image;
+  GimpLayer             *layer;
+  GTimer                *timer;
+  GimpConvertDitherType  dither;
+  gint                   size      = 2048;
+  guint                  n_threads = 0;
+  gint                   result    = 0;
+
+  if (argc > 1)
+    size = MAX (atoi (argv[1]), 1);
+
+  if (argc > 2)
+    n_threads = MAX (atoi (argv[2]), 1);
+
+  gimp = gimp_init_for_testing ();
+  gimp_parallel_init (gimp);
+
+  if (! n_threads)
+    g_object_get (gimp->config,
+                  "num-processors", &n_threads,
+                  NULL);
+
+  image = gimp_image_new (gimp, size, size, GIMP_RGB,
+                          GIMP_PRECISION_U8_GAMMA);
+
+  layer = gimp_layer_new (image, size, size,
+                          gimp_image_get_layer_format (image, TRUE),
+                          "Benchmark",
+                          GIMP_OPACITY_OPAQUE,
+                          GIMP_NORMAL_MODE);
+
+  gimp_image_add_layer (image, layer, NULL, 0, FALSE);
+
+  fill_image (GIMP_DRAWABLE (layer));
+
+  timer = g_timer_new ();
+
+  g_print ("%d x %d, old serial code vs. %d threads\n",
+           size, size, n_threads);
+
+  for (dither = GIMP_NO_DITHER; dither <= GIMP_FS_DITHER; dither++)
+    {
+      GimpImage *serial;
+      GimpImage *parallel;
+      gdouble    serial_time;
+      gdouble    parallel_time;
+
+      serial      = convert_serial (image, dither, timer);
+      serial_time = g_timer_elapsed (timer, NULL);
+
+      parallel      = convert (gimp, image, n_threads, dither, timer);
+      parallel_time = g_timer_elapsed (timer, NULL);
+
+      g_print ("%-10s %10.3f s %10.3f s   %5.2fx\n",
+               dither == GIMP_NO_DITHER ? "none" : "fs",
+               serial_time, parallel_time,
+               serial_time / parallel_time);
+
+      if (! images_equal (serial, parallel))
+        {
+          g_printerr ("the results differ from the old serial code\n");
+          result = 1;
+        }
+
+      g_object_unref (serial);
+      g_object_unref (parallel);
+    }
+
+  g_timer_destroy (timer);
+
+  g_object_unref (image);
+
+  gimp_parallel_exit (gimp);
+  gimp_exit (gimp, TRUE);
+
+  return result;
+}
@@ -0,0 +1,112 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*  Benchmark for GimpList, as used for the data factories' containers.
+ *
+ *  Usage: perf-gimp-list [N_ITEMS]
+ *
+ *  Adds N_ITEMS (default 10000) objects which all have the same name
+ *  to a list with unique names, then prints the time it takes to add
+ *  them, to look them up by name and by index, and to remove them.
+ */
+
+#include <stdlib.h>
+
+#include <glib-object.h>
+
+#include "core/core-types.h"
+
+#include "core/gimplist.h"
+
+
+int
+main (int    argc,
+      char **argv)
+{
+  GimpContainer  *container;
+  GimpObject    **objects;
+  GTimer         *timer;
+  gint            n_items = 10000;
+  gint            n_found = 0;
+  gint64          sum     = 0;
+  gint            i;
+
+  if (argc > 1)
+    n_items = MAX (atoi (argv[1]), 1);
+
+  container = gimp_list_new (GIMP_TYPE_OBJECT, TRUE);
+  objects   = g_new (GimpObject *, n_items);
+
+  for (i = 0; i < n_items; i++)
+    objects[i] = g_object_new (GIMP_TYPE_OBJECT,
+                               "name", "Untitled",
+                               NULL);
+
+  timer = g_timer_new ();
+
+  g_print ("%d items\n", n_items);
+
+  g_timer_start (timer);
+
+  for (i = 0; i < n_items; i++)
+    gimp_container_add (container, objects[i]);
+
+  g_print ("%-8s %10.3f s\n", "add", g_timer_elapsed (timer, NULL));
+
+  g_timer_start (timer);
+
+  for (i = 0; i < n_items; i++)
+    {
+      const gchar *name = gimp_object_get_name (objects[i]);
+
+      if (gimp_container_get_child_by_name (container, name) == objects[i])
+        n_found++;
+    }
+
+  g_print ("%-8s %10.3f s\n", "by-name", g_timer_elapsed (timer, NULL));
+
+  g_timer_start (timer);
+
+  for (i = 0; i < n_items; i++)
+    sum += gimp_container_get_child_index (container, objects[i]);
+
+  g_print ("%-8s %10.3f s\n", "index", g_timer_elapsed (timer, NULL));
+
+  g_timer_start (timer);
+
+  for (i = 0; i < n_items; i++)
+    gimp_container_remove (container, objects[i]);
+
+  g_print ("%-8s %10.3f s\n", "remove", g_timer_elapsed (timer, NULL));
+
+  if (n_found != n_items ||
+      sum != (gint64) n_items * (n_items - 1) / 2)
+    {
+      g_printerr ("list lookups returned wrong results\n");
+      return 1;
+    }
+
+  g_timer_destroy (timer);
+
+  for (i = 0; i < n_items; i++)
+    g_object_unref (objects[i]);
+
+  g_free (objects);
+  g_object_unref (container);
+
+  return 0;
+}
@@ -0,0 +1,177 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*  Benchmark for the Laplace solvers of the heal tool.
+ *
+ *  Usage: perf-heal [MAX_RADIUS [N_RUNS]]
+ *
+ *  Solves the healing equation for a round brush of radius 8, 16, ...
+ *  up to MAX_RADIUS (default 256) on random RGBA pixels, N_RUNS
+ *  (default 3) times, with both the over-relaxation and the multigrid
+ *  solver.  Prints their iterations and time, and fails if their
+ *  solutions differ by more than 1/255.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <gegl.h>
+
+#include "core/core-types.h"
+
+#include "core/gimp.h"
+#include "core/gimp-parallel.h"
+
+#include "paint/gimpheal-laplace.h"
+
+#include "tests.h"
+
+
+#define DEPTH     4
+#define MAX_ERROR (1.0 / 255.0)
+
+
+typedef gint (* SolveFunc) (gfloat       *pixels,
+                            gint          width,
+                            gint          height,
+                            gint          depth,
+                            const guchar *mask);
+
+
+static gdouble
+run_solver (SolveFunc     solve,
+            const gfloat *input,
+            gfloat       *pixels,
+            gint          size,
+            const guchar *mask,
+            gint          n_runs,
+            gint         *n_iterations,
+            GTimer       *timer)
+{
+  gdouble total = 0.0;
+  gint    run;
+
+  for (run = 0; run < n_runs; run++)
+    {
+      memcpy (pixels, input, size * size * DEPTH * sizeof (gfloat));
+
+      g_timer_start (timer);
+
+      *n_iterations = solve (pixels, size, size, DEPTH, mask);
+
+      total += g_timer_elapsed (timer, NULL);
+    }
+
+  return total / n_runs;
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  Gimp     *gimp;
+  GTimer   *timer;
+  GRand    *rand;
+  gint      max_radius = 256;
+  gint      n_runs     = 3;
+  gint      radius;
+  gboolean  success    = TRUE;
+
+  if (argc > 1)
+    max_radius = MAX (atoi (argv[1]), 8);
+
+  if (argc > 2)
+    n_runs = MAX (atoi (argv[2]), 1);
+
+  gimp = gimp_init_for_testing ();
+  gimp_parallel_init (gimp);
+
+  timer = g_timer_new ();
+  rand  = g_rand_new_with_seed (42);
+
+  g_print ("%d threads\n", gimp_parallel_get_n_threads ());
+  g_print ("radius    SOR iter      ms   multigrid cycles      ms  speedup\n");
+
+  for (radius = 8; radius <= max_radius; radius *= 2)
+    {
+      gint     size = 2 * radius + 3;
+      gfloat  *input;
+      gfloat  *sor_alloc;
+      gfloat  *sor;
+      gfloat  *multigrid;
+      guchar  *mask;
+      gint     sor_iterations;
+      gint     multigrid_cycles;
+      gdouble  sor_time;
+      gdouble  multigrid_time;
+      gdouble  error = 0.0;
+      gint     x, y, i;
+
+      input     = g_new (gfloat, size * size * DEPTH);
+      multigrid = g_new (gfloat, size * size * DEPTH);
+      mask      = g_new (guchar, size * size);
+
+      /*  the over-relaxation solver wants an extra, aligned pixel  */
+      sor_alloc = g_new (gfloat, 4 + (size * size + 1) * DEPTH);
+      sor       = (gfloat *) (((guintptr) sor_alloc + 15) & ~15);
+
+      for (y = 0; y < size; y++)
+        for (x = 0; x < size; x++)
+          {
+            gint dx = x - size / 2;
+            gint dy = y - size / 2;
+
+            mask[y * size + x] = (dx * dx + dy * dy <= radius * radius);
+
+            for (i = 0; i < DEPTH; i++)
+              input[(y * size + x) * DEPTH + i] = g_rand_double (rand);
+          }
+
+      sor_time = run_solver (gimp_heal_laplace_sor,
+                             input, sor, size, mask,
+                             n_runs, &sor_iterations, timer);
+      multigrid_time = run_solver (gimp_heal_laplace_multigrid,
+                                   input, multigrid, size, mask,
+                                   n_runs, &multigrid_cycles, timer);
+
+      for (i = 0; i < size * size * DEPTH; i++)
+        error = MAX (error, ABS (sor[i] - multigrid[i]));
+
+      g_print ("%6d %12d %7.2f %18d %7.2f  %6.2fx%s\n",
+               radius,
+               sor_iterations, sor_time * 1000.0,
+               multigrid_cycles, multigrid_time * 1000.0,
+               sor_time / multigrid_time,
+               error > MAX_ERROR ? "  DIFFERENT" : "");
+
+      if (error > MAX_ERROR)
+        success = FALSE;
+
+      g_free (input);
+      g_free (sor_alloc);
+      g_free (multigrid);
+      g_free (mask);
+    }
+
+  g_rand_free (rand);
+  g_timer_destroy (timer);
+
+  gimp_parallel_exit (gimp);
+  gimp_exit (gimp, TRUE);
+
+  return success ? 0 : 1;
+}
@@ -0,0 +1,176 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*  Benchmark for histogram calculation.
+ *
+ *  Usage: perf-histogram [SIZE [N_RUNS]]
+ *
+ *  Prints the time it takes to calculate the histogram of a SIZE x
+ *  SIZE (default 4096) RGBA buffer, and to update it incrementally
+ *  after painting a small square, N_RUNS (default 10) times, and fails
+ *  if the incrementally updated histogram differs from a recalculated
+ *  one.
+ */
+
+#include <stdlib.h>
+
+#include <gegl.h>
+
+#include "core/core-types.h"
+
+#include "core/gimp.h"
+#include "core/gimp-parallel.h"
+#include "core/gimphistogram.h"
+
+#include "tests.h"
+
+
+#define DAB_SIZE 50
+
+
+static void
+fill_buffer (GeglBuffer *buffer)
+{
+  GeglBufferIterator *iter;
+  GRand              *rand = g_rand_new_with_seed (42);
+
+  iter = gegl_buffer_iterator_new (buffer, NULL, 0,
+                                   babl_format ("R'G'B'A u8"),
+                                   GEGL_BUFFER_WRITE, GEGL_ABYSS_NONE);
+
+  while (gegl_buffer_iterator_next (iter))
+    {
+      guchar *dest = iter->data[0];
+      gint    n    = iter->length * 4;
+
+      while (n--)
+        *dest++ = g_rand_int_range (rand, 0, 256);
+    }
+
+  g_rand_free (rand);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  Gimp          *gimp;
+  GeglBuffer    *buffer;
+  GimpHistogram *histogram;
+  GimpHistogram *reference;
+  GeglRectangle  rect;
+  GTimer        *timer;
+  GRand         *rand;
+  gint           size    = 4096;
+  gint           n_runs  = 10;
+  gdouble        total   = 0.0;
+  gdouble        error   = 0.0;
+  gint           run;
+  gint           channel;
+  gint           bin;
+
+  if (argc > 1)
+    size = MAX (atoi (argv[1]), DAB_SIZE);
+
+  if (argc > 2)
+    n_runs = MAX (atoi (argv[2]), 1);
+
+  gimp = gimp_init_for_testing ();
+  gimp_parallel_init (gimp);
+
+  rect = *GEGL_RECTANGLE (0, 0, size, size);
+
+  buffer = gegl_buffer_new (&rect, babl_format ("R'G'B'A u8"));
+  fill_buffer (buffer);
+
+  histogram = gimp_histogram_new (TRUE);
+  reference = gimp_histogram_new (TRUE);
+
+  timer = g_timer_new ();
+  rand  = g_rand_new_with_seed (42);
+
+  g_print ("%d x %d, %d threads\n",
+           size, size, gimp_parallel_get_n_threads ());
+
+  for (run = 0; run < n_runs; run++)
+    {
+      g_timer_start (timer);
+
+      gimp_histogram_calculate (reference, buffer, &rect, NULL, NULL);
+
+      total += g_timer_elapsed (timer, NULL);
+    }
+
+  g_print ("full        %10.3f s\n", total / n_runs);
+
+  gimp_histogram_calculate_incremental (histogram, buffer, &rect,
+                                        NULL, NULL, NULL, -1);
+
+  total = 0.0;
+
+  for (run = 0; run < n_runs; run++)
+    {
+      GeglRectangle dab;
+      GeglColor    *color;
+
+      dab = *GEGL_RECTANGLE (g_rand_int_range (rand, 0, size - DAB_SIZE),
+                             g_rand_int_range (rand, 0, size - DAB_SIZE),
+                             DAB_SIZE, DAB_SIZE);
+
+      color = gegl_color_new (NULL);
+      gegl_color_set_rgba (color,
+                           g_rand_double (rand), g_rand_double (rand),
+                           g_rand_double (rand), g_rand_double (rand));
+
+      gegl_buffer_set_color (buffer, &dab, color);
+
+      g_object_unref (color);
+
+      g_timer_start (timer);
+
+      gimp_histogram_calculate_incremental (histogram, buffer, &rect,
+                                            NULL, NULL, &dab, 1);
+
+      total += g_timer_elapsed (timer, NULL);
+    }
+
+  g_print ("incremental %10.3f s\n", total / n_runs);
+
+  gimp_histogram_calculate (reference, buffer, &rect, NULL, NULL);
+
+  for (channel = 0; channel < gimp_histogram_n_channels (reference); channel++)
+    for (bin = 0; bin < gimp_histogram_n_bins (reference); bin++)
+      {
+        error = MAX (error,
+                     ABS (gimp_histogram_get_component (histogram, channel, bin) -
+                          gimp_histogram_get_component (reference, channel, bin)));
+      }
+
+  g_print ("max. error  %10.3g\n", error);
+
+  g_rand_free (rand);
+  g_timer_destroy (timer);
+
+  g_object_unref (histogram);
+  g_object_unref (reference);
+  g_object_unref (buffer);
+
+  gimp_parallel_exit (gimp);
+  gimp_exit (gimp, TRUE);
+
+  return error < 1e-3 ? 0 : 1;
+}
@@ -0,0 +1,156 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*  Benchmark for the layer mode functions.
+ *
+ *  Usage: perf-layer-modes [N_PIXELS [N_RUNS]]
+ *
+ *  Runs the function of every layer mode on N_PIXELS (default 1M)
+ *  random pixels, with and without mask and at full and half opacity,
+ *  N_RUNS (default 10) times, once with CPU acceleration disabled and
+ *  once enabled, and prints the throughput of both.  That their
+ *  results are the same is checked by test-layer-modes.
+ */
+
+#include <stdlib.h>
+
+#include <gegl.h>
+
+#include "libgimpbase/gimpbase.h"
+
+#include "core/core-types.h"
+#include "operations/operations-types.h"
+
+#include "operations/gimplayermodefunctions.h"
+
+
+static gfloat *
+random_pixels (GRand *rand,
+               glong  n_floats)
+{
+  gfloat *pixels = g_new (gfloat, n_floats);
+  glong   i;
+
+  for (i = 0; i < n_floats; i++)
+    pixels[i] = g_rand_double (rand);
+
+  return pixels;
+}
+
+static gdouble
+run_mode (GimpLayerModeFunction  func,
+          gfloat                *in,
+          gfloat                *layer,
+          gfloat                *mask,
+          gfloat                *out,
+          gdouble                opacity,
+          glong                  n_pixels,
+          gint                   n_runs,
+          GTimer                *timer)
+{
+  const GeglRectangle *roi = GEGL_RECTANGLE (0, 0, n_pixels, 1);
+  gint                 run;
+
+  g_timer_start (timer);
+
+  for (run = 0; run < n_runs; run++)
+    func (in, layer, mask, out, opacity, n_pixels, roi, 0);
+
+  g_timer_stop (timer);
+
+  return (gdouble) n_pixels * n_runs / g_timer_elapsed (timer, NULL) / 1e6;
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  GRand                *rand;
+  GTimer               *timer;
+  gfloat               *in;
+  gfloat               *layer;
+  gfloat               *mask;
+  gfloat               *ref_out;
+  gfloat               *out;
+  glong                 n_pixels = 1024 * 1024;
+  gint                  n_runs   = 10;
+  GimpLayerModeEffects  mode;
+
+  if (argc > 1)
+    n_pixels = MAX (atol (argv[1]), 1);
+
+  if (argc > 2)
+    n_runs = MAX (atoi (argv[2]), 1);
+
+  rand  = g_rand_new_with_seed (42);
+  timer = g_timer_new ();
+
+  in      = random_pixels (rand, n_pixels * 4);
+  layer   = random_pixels (rand, n_pixels * 4);
+  mask    = random_pixels (rand, n_pixels);
+  ref_out = g_new (gfloat, n_pixels * 4);
+  out     = g_new (gfloat, n_pixels * 4);
+
+  g_print ("%ld pixels, Mpixels/s generic vs. accelerated\n", n_pixels);
+
+  for (mode = GIMP_NORMAL_MODE; mode <= GIMP_ANTI_ERASE_MODE; mode++)
+    {
+      GimpLayerModeFunction  generic;
+      GimpLayerModeFunction  accel;
+      const gchar           *nick = NULL;
+      gint                   variant;
+
+      gimp_enum_get_value (GIMP_TYPE_LAYER_MODE_EFFECTS, mode,
+                           NULL, &nick, NULL, NULL);
+
+      gimp_cpu_accel_set_use (FALSE);
+      generic = get_layer_mode_function (mode);
+
+      gimp_cpu_accel_set_use (TRUE);
+      accel = get_layer_mode_function (mode);
+
+      for (variant = 0; variant < 4; variant++)
+        {
+          gfloat  *variant_mask = (variant & 1) ? mask : NULL;
+          gdouble  opacity      = (variant & 2) ? 0.5 : 1.0;
+          gdouble  generic_rate;
+          gdouble  accel_rate;
+
+          generic_rate = run_mode (generic, in, layer, variant_mask, ref_out,
+                                   opacity, n_pixels, n_runs, timer);
+          accel_rate   = run_mode (accel, in, layer, variant_mask, out,
+                                   opacity, n_pixels, n_runs, timer);
+
+          g_print ("%-14s %-4s %-7s %10.1f %10.1f  %5.2fx\n",
+                   nick,
+                   variant_mask ? "mask" : "",
+                   opacity == 1.0 ? "opaque" : "",
+                   generic_rate, accel_rate, accel_rate / generic_rate);
+        }
+    }
+
+  g_free (in);
+  g_free (layer);
+  g_free (mask);
+  g_free (ref_out);
+  g_free (out);
+
+  g_timer_destroy (timer);
+  g_rand_free (rand);
+
+  return 0;
+}
@@ -0,0 +1,257 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include <gegl.h>
+
+#include "core/core-types.h"
+
+#include "core/gimp.h"
+#include "core/gimp-parallel.h"
+#include "core/gimpdrawable.h"
+#include "core/gimpimage.h"
+#include "core/gimpimage-colormap.h"
+#include "core/gimpimage-convert-type.h"
+#include "core/gimpimage-duplicate.h"
+#include "core/gimplayer.h"
+
+#include "gimpimage-convert-type-serial.h"
+#include "tests.h"
+
+
+#define GIMP_TEST_IMAGE_SIZE 300
+#define GIMP_TEST_N_THREADS  4
+
+#define ADD_TEST(function) \
+  g_test_add_data_func ("/gimp-convert-indexed/" #function, gimp, function);
+
+
+static GimpImage *
+gimp_test_create_image (Gimp *gimp)
+{
+  GimpImage          *image;
+  GimpLayer          *layer;
+  GeglBuffer         *buffer;
+  GeglBufferIterator *iter;
+  GRand              *rand = g_rand_new_with_seed (42);
+
+  image = gimp_image_new (gimp,
+                          GIMP_TEST_IMAGE_SIZE, GIMP_TEST_IMAGE_SIZE,
+                          GIMP_RGB, GIMP_PRECISION_U8_GAMMA);
+
+  layer = gimp_layer_new (image,
+                          GIMP_TEST_IMAGE_SIZE, GIMP_TEST_IMAGE_SIZE,
+                          gimp_image_get_layer_format (image, TRUE),
+                          "Test",
+                          GIMP_OPACITY_OPAQUE,
+                          GIMP_NORMAL_MODE);
+
+  gimp_image_add_layer (image, layer, NULL, 0, FALSE);
+
+  buffer = gimp_drawable_get_buffer (GIMP_DRAWABLE (layer));
+
+  iter = gegl_buffer_iterator_new (buffer, NULL, 0,
+                                   babl_format ("R'G'B'A u8"),
+                                   GEGL_BUFFER_WRITE, GEGL_ABYSS_NONE);
+
+  while (gegl_buffer_iterator_next (iter))
+    {
+      guchar *dest = iter->data[0];
+      gint    x, y;
+
+      for (y = iter->roi[0].y; y < iter->roi[0].y + iter->roi[0].height; y++)
+        for (x = iter->roi[0].x; x < iter->roi[0].x + iter->roi[0].width; x++)
+          {
+            /*  gradients with noise, and transparent bands  */
+            *dest++ = (x * 255 / GIMP_TEST_IMAGE_SIZE +
+                       g_rand_int_range (rand, 0, 16)) & 0xff;
+            *dest++ = (y * 255 / GIMP_TEST_IMAGE_SIZE +
+                       g_rand_int_range (rand, 0, 16)) & 0xff;
+            *dest++ = ((x + y) * 127 / GIMP_TEST_IMAGE_SIZE) & 0xff;
+            *dest++ = (y / 64) % 4 ? 255 : g_rand_int_range (rand, 0, 256);
+          }
+    }
+
+  g_rand_free (rand);
+
+  return image;
+}
+
+static GimpImage *
+gimp_test_convert (Gimp                  *gimp,
+                   GimpImage             *image,
+                   gint                   n_threads,
+                   GimpConvertDitherType  dither)
+{
+  GimpImage *copy = gimp_image_duplicate (image);
+
+  g_object_set (gimp->config,
+                "num-processors", n_threads,
+                NULL);
+
+  gimp_image_convert_type (copy, GIMP_INDEXED,
+                           256, dither, FALSE, FALSE, FALSE,
+                           GIMP_MAKE_PALETTE, NULL, NULL, NULL);
+
+  return copy;
+}
+
+/*  converts with the code from before the conversion was parallel  */
+static GimpImage *
+gimp_test_convert_serial (Gimp                  *gimp,
+                          GimpImage             *image,
+                          GimpConvertDitherType  dither)
+{
+  GimpImage *copy = gimp_image_duplicate (image);
+
+  gimp_image_convert_type_serial (copy, GIMP_INDEXED,
+                                  256, dither, FALSE, FALSE, FALSE,
+                                  GIMP_MAKE_PALETTE, NULL, NULL, NULL);
+
+  return copy;
+}
+
+static void
+gimp_test_assert_images_equal (GimpImage *a,
+                               GimpImage *b)
+{
+  GimpDrawable *drawable_a = GIMP_DRAWABLE (gimp_image_get_active_layer (a));
+  GimpDrawable *drawable_b = GIMP_DRAWABLE (gimp_image_get_active_layer (b));
+  GeglBuffer   *buffer_a   = gimp_drawable_get_buffer (drawable_a);
+  GeglBuffer   *buffer_b   = gimp_drawable_get_buffer (drawable_b);
+  gsize         size;
+  guchar       *data_a;
+  guchar       *data_b;
+
+  g_assert_cmpint (gimp_image_get_colormap_size (a),
+                   ==,
+                   gimp_image_get_colormap_size (b));
+  g_assert (memcmp (gimp_image_get_colormap (a),
+                    gimp_image_get_colormap (b),
+                    gimp_image_get_colormap_size (a) * 3) == 0);
+
+  g_assert (gegl_buffer_get_format (buffer_a) ==
+            gegl_buffer_get_format (buffer_b));
+
+  size = ((gsize) gegl_buffer_get_width (buffer_a) *
+          gegl_buffer_get_height (buffer_a) *
+          babl_format_get_bytes_per_pixel (gegl_buffer_get_format (buffer_a)));
+
+  data_a = g_malloc (size);
+  data_b = g_malloc (size);
+
+  gegl_buffer_get (buffer_a, NULL, 1.0, NULL, data_a,
+                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+  gegl_buffer_get (buffer_b, NULL, 1.0, NULL, data_b,
+                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+  g_assert (memcmp (data_a, data_b, size) == 0);
+
+  g_free (data_a);
+  g_free (data_b);
+}
+
+static void
+gimp_test_convert_in_parallel (Gimp                  *gimp,
+                               GimpConvertDitherType  dither)
+{
+  GimpImage *image;
+  GimpImage *reference;
+  GimpImage *serial;
+  GimpImage *parallel;
+
+  image = gimp_test_create_image (gimp);
+
+  reference = gimp_test_convert_serial (gimp, image, dither);
+  serial    = gimp_test_convert (gimp, image, 1, dither);
+  parallel  = gimp_test_convert (gimp, image, GIMP_TEST_N_THREADS, dither);
+
+  gimp_test_assert_images_equal (reference, serial);
+  gimp_test_assert_images_equal (reference, parallel);
+
+  g_object_unref (reference);
+  g_object_unref (serial);
+  g_object_unref (parallel);
+  g_object_unref (image);
+}
+
+/**
+ * convert_without_dither:
+ * @data:
+ *
+ * Makes sure that converting to indexed colors without dithering
+ * gives the same pixels and colormap as the old serial code, with
+ * one and several threads.
+ **/
+static void
+convert_without_dither (gconstpointer data)
+{
+  gimp_test_convert_in_parallel (GIMP (data), GIMP_NO_DITHER);
+}
+
+/**
+ * convert_with_fs_dither:
+ * @data:
+ *
+ * Makes sure that converting to indexed colors with Floyd-Steinberg
+ * dithering gives the same pixels and colormap as the old serial
+ * code, with one and several threads.
+ **/
+static void
+convert_with_fs_dither (gconstpointer data)
+{
+  gimp_test_convert_in_parallel (GIMP (data), GIMP_FS_DITHER);
+}
+
+/**
+ * convert_with_fixed_dither:
+ * @data:
+ *
+ * Makes sure that converting to indexed colors with positioned
+ * dithering gives the same pixels and colormap as the old serial
+ * code, with one and several threads.
+ **/
+static void
+convert_with_fixed_dither (gconstpointer data)
+{
+  gimp_test_convert_in_parallel (GIMP (data), GIMP_FIXED_DITHER);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  Gimp *gimp;
+  int   result;
+
+  g_test_init (&argc, &argv, NULL);
+
+  gimp = gimp_init_for_testing ();
+  gimp_parallel_init (gimp);
+
+  ADD_TEST (convert_without_dither);
+  ADD_TEST (convert_with_fs_dither);
+  ADD_TEST (convert_with_fixed_dither);
+
+  result = g_test_run ();
+
+  gimp_parallel_exit (gimp);
+  gimp_exit (gimp, TRUE);
+
+  return result;
+}
@@ -0,0 +1,136 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gegl.h>
+
+#include "libgimpbase/gimpbase.h"
+
+#include "core/core-types.h"
+#include "operations/operations-types.h"
+
+#include "operations/gimplayermodefunctions.h"
+
+
+/*  not a multiple of four, so the accelerated functions' remainder
+ *  handling is used too
+ */
+#define N_PIXELS  4099
+#define MAX_ERROR 1e-5
+
+#define ADD_TEST(function) \
+  g_test_add_func ("/gimp-layer-modes/" #function, function);
+
+
+static gfloat *
+gimp_test_random_pixels (GRand *rand,
+                         glong  n_floats)
+{
+  gfloat *pixels = g_new (gfloat, n_floats);
+  glong   i;
+
+  for (i = 0; i < n_floats; i++)
+    pixels[i] = g_rand_double (rand);
+
+  return pixels;
+}
+
+/**
+ * accelerated_modes_match_generic:
+ *
+ * Makes sure that the CPU accelerated function of every layer mode
+ * gives the same results as the generic one, up to rounding, with and
+ * without mask and at full and half opacity.
+ **/
+static void
+accelerated_modes_match_generic (void)
+{
+  const GeglRectangle  *roi  = GEGL_RECTANGLE (0, 0, N_PIXELS, 1);
+  GRand                *rand = g_rand_new_with_seed (42);
+  gfloat               *in;
+  gfloat               *layer;
+  gfloat               *mask;
+  gfloat               *ref_out;
+  gfloat               *out;
+  GimpLayerModeEffects  mode;
+
+  in      = gimp_test_random_pixels (rand, N_PIXELS * 4);
+  layer   = gimp_test_random_pixels (rand, N_PIXELS * 4);
+  mask    = gimp_test_random_pixels (rand, N_PIXELS);
+  ref_out = g_new (gfloat, N_PIXELS * 4);
+  out     = g_new (gfloat, N_PIXELS * 4);
+
+  for (mode = GIMP_NORMAL_MODE; mode <= GIMP_ANTI_ERASE_MODE; mode++)
+    {
+      GimpLayerModeFunction  generic;
+      GimpLayerModeFunction  accel;
+      const gchar           *nick = NULL;
+      gint                   variant;
+
+      gimp_enum_get_value (GIMP_TYPE_LAYER_MODE_EFFECTS, mode,
+                           NULL, &nick, NULL, NULL);
+
+      gimp_cpu_accel_set_use (FALSE);
+      generic = get_layer_mode_function (mode);
+
+      gimp_cpu_accel_set_use (TRUE);
+      accel = get_layer_mode_function (mode);
+
+      for (variant = 0; variant < 4; variant++)
+        {
+          gfloat  *variant_mask = (variant & 1) ? mask : NULL;
+          gdouble  opacity      = (variant & 2) ? 0.5 : 1.0;
+          gdouble  error        = 0.0;
+          gint     i;
+
+          generic (in, layer, variant_mask, ref_out, opacity,
+                   N_PIXELS, roi, 0);
+          accel   (in, layer, variant_mask, out, opacity,
+                   N_PIXELS, roi, 0);
+
+          for (i = 0; i < N_PIXELS * 4; i++)
+            error = MAX (error, ABS (out[i] - ref_out[i]));
+
+          if (error > MAX_ERROR)
+            g_test_message ("%s %s %s differs by %g",
+                            nick,
+                            variant_mask ? "with mask" : "without mask",
+                            opacity == 1.0 ? "opaque" : "half opaque",
+                            error);
+
+          g_assert_cmpfloat (error, <=, MAX_ERROR);
+        }
+    }
+
+  g_free (in);
+  g_free (layer);
+  g_free (mask);
+  g_free (ref_out);
+  g_free (out);
+
+  g_rand_free (rand);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  g_test_init (&argc, &argv, NULL);
+
+  ADD_TEST (accelerated_modes_match_generic);
+
+  return g_test_run ();
+}
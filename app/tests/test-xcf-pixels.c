@@ -0,0 +1,630 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include <glib/gstdio.h>
+
+#include <gegl.h>
+
+#include <gtk/gtk.h>
+
+#include "libgimpbase/gimpbase.h"
+
+#include "widgets/widgets-types.h"
+
+#include "gegl/gimp-gegl-loops.h"
+
+#include "core/gimp.h"
+#include "core/gimpdrawable.h"
+#include "core/gimpimage.h"
+#include "core/gimplayer.h"
+
+#include "file/file-open.h"
+#include "file/file-procedure.h"
+#include "file/file-save.h"
+
+#include "plug-in/gimppluginmanager.h"
+
+#include "tests.h"
+
+#include "gimp-app-test-utils.h"
+
+
+/*  tests of how XCF files store the pixels, test-xcf tests that the
+ *  rest of an image survives
+ */
+
+#define GIMP_PATTERN_WIDTH              300
+#define GIMP_PATTERN_HEIGHT             200
+#define GIMP_PATTERN_FORMAT             babl_format ("R'G'B'A u8")
+#define GIMP_PATTERN_LAYER_NAME         "pattern"
+
+#define ADD_TEST(function) \
+  g_test_add_data_func ("/gimp-xcf-pixels/" #function, gimp, function);
+
+
+static GimpImage  * gimp_test_load_image       (Gimp        *gimp,
+                                                const gchar *uri);
+static GeglBuffer * gimp_create_pattern_buffer (void);
+static GimpImage  * gimp_create_pattern_image  (Gimp        *gimp);
+static gchar      * gimp_write_pattern_image   (Gimp        *gimp,
+                                                gint         expected_version);
+static void         gimp_assert_pattern_file   (Gimp        *gimp,
+                                                const gchar *uri);
+static void         gimp_assert_pattern_thumbnail
+                                               (Gimp        *gimp,
+                                                const gchar *uri);
+static void         gimp_edit_pattern_buffer   (GeglBuffer  *buffer);
+static void         gimp_assert_buffers_equal  (GeglBuffer  *buffer1,
+                                                GeglBuffer  *buffer2);
+
+
+/**
+ * write_and_read_zlib_compression:
+ * @data:
+ *
+ * Writes XCF files with both zlib compression levels, then reads them
+ * and makes sure the pixels survived.
+ **/
+static void
+write_and_read_zlib_compression (gconstpointer data)
+{
+  Gimp  *gimp = GIMP (data);
+  gchar *uri;
+
+  g_object_set (gimp->config,
+                "xcf-compression", GIMP_XCF_COMPRESSION_ZLIB,
+                NULL);
+
+  uri = gimp_write_pattern_image (gimp, 5);
+  gimp_assert_pattern_file (gimp, uri);
+  g_unlink (uri);
+  g_free (uri);
+
+  g_object_set (gimp->config,
+                "xcf-compression", GIMP_XCF_COMPRESSION_ZLIB_FAST,
+                NULL);
+
+  uri = gimp_write_pattern_image (gimp, 5);
+  gimp_assert_pattern_file (gimp, uri);
+  g_unlink (uri);
+  g_free (uri);
+
+  g_object_set (gimp->config,
+                "xcf-compression", GIMP_XCF_COMPRESSION_RLE,
+                NULL);
+}
+
+/**
+ * write_and_read_64bit_offsets:
+ * @data:
+ *
+ * Writes an XCF file with 64-bit offsets, which is otherwise only
+ * done for huge images, then reads the file and makes sure the
+ * pixels survived.
+ **/
+static void
+write_and_read_64bit_offsets (gconstpointer data)
+{
+  Gimp  *gimp = GIMP (data);
+  gchar *uri;
+
+  g_setenv ("GIMP_TESTING_XCF_64BIT_OFFSETS", "1", TRUE);
+
+  uri = gimp_write_pattern_image (gimp, 6);
+
+  g_unsetenv ("GIMP_TESTING_XCF_64BIT_OFFSETS");
+
+  gimp_assert_pattern_file (gimp, uri);
+
+  g_unlink (uri);
+  g_free (uri);
+}
+
+/**
+ * load_stored_levels:
+ * @data:
+ *
+ * Writes an XCF file with and without xcf-save-levels, then loads a
+ * thumbnail from them and makes sure it has the downsampled pixels,
+ * whether it was loaded from the smallest stored level that is at
+ * least the thumbnail size or downsampled from the first level.
+ **/
+static void
+load_stored_levels (gconstpointer data)
+{
+  Gimp    *gimp = GIMP (data);
+  gchar   *uri_levels;
+  gchar   *uri;
+  GStatBuf stat_levels;
+  GStatBuf stat;
+
+  g_object_set (gimp->config, "xcf-save-levels", TRUE, NULL);
+
+  uri_levels = gimp_write_pattern_image (gimp, 0);
+
+  g_object_set (gimp->config, "xcf-save-levels", FALSE, NULL);
+
+  uri = gimp_write_pattern_image (gimp, 0);
+
+  /*  only the first file has pixels in the levels past the first  */
+  g_assert (g_stat (uri_levels, &stat_levels) == 0);
+  g_assert (g_stat (uri, &stat) == 0);
+  g_assert_cmpint (stat_levels.st_size, >, stat.st_size);
+
+  gimp_assert_pattern_thumbnail (gimp, uri_levels);
+  gimp_assert_pattern_thumbnail (gimp, uri);
+
+  /*  the full-resolution level is still there for opening the file  */
+  gimp_assert_pattern_file (gimp, uri_levels);
+
+  g_unlink (uri_levels);
+  g_unlink (uri);
+  g_free (uri_levels);
+  g_free (uri);
+}
+
+/**
+ * load_lazily:
+ * @data:
+ *
+ * Loads an XCF file with xcf-lazy-loading, edits the layer and saves
+ * the image over the file it is still reading its tiles from, then
+ * makes sure both the image and the file have the edited pixels.
+ **/
+static void
+load_lazily (gconstpointer data)
+{
+  Gimp                *gimp = GIMP (data);
+  GimpImage           *image;
+  GimpLayer           *layer;
+  GeglBuffer          *buffer;
+  GeglBuffer          *expected;
+  GimpPlugInProcedure *proc;
+  GimpPDBStatusType    status;
+  gchar               *uri;
+
+  uri = gimp_write_pattern_image (gimp, 0);
+
+  g_object_set (gimp->config, "xcf-lazy-loading", TRUE, NULL);
+
+  gimp_assert_pattern_file (gimp, uri);
+
+  image = gimp_test_load_image (gimp, uri);
+  g_assert (image != NULL);
+
+  layer = gimp_image_get_layer_by_name (image, GIMP_PATTERN_LAYER_NAME);
+  g_assert (layer != NULL);
+
+  buffer = gimp_drawable_get_buffer (GIMP_DRAWABLE (layer));
+
+  /*  the flush makes GEGL write the edited tiles back to the backend  */
+  gimp_edit_pattern_buffer (buffer);
+  gegl_buffer_flush (buffer);
+
+  expected = gimp_create_pattern_buffer ();
+  gimp_edit_pattern_buffer (expected);
+
+  gimp_assert_buffers_equal (buffer, expected);
+
+  proc = file_procedure_find (gimp->plug_in_manager->save_procs,
+                              uri,
+                              NULL /*error*/);
+  status = file_save (gimp,
+                      image,
+                      NULL /*progress*/,
+                      uri,
+                      proc,
+                      GIMP_RUN_NONINTERACTIVE,
+                      FALSE /*change_saved_state*/,
+                      FALSE /*export_backward*/,
+                      FALSE /*export_forward*/,
+                      NULL /*error*/);
+  g_assert_cmpint (status, ==, GIMP_PDB_SUCCESS);
+
+  /*  the image must not have been reading from the overwritten file  */
+  gimp_assert_buffers_equal (buffer, expected);
+
+  image = gimp_test_load_image (gimp, uri);
+  g_assert (image != NULL);
+
+  layer = gimp_image_get_layer_by_name (image, GIMP_PATTERN_LAYER_NAME);
+  g_assert (layer != NULL);
+
+  gimp_assert_buffers_equal (gimp_drawable_get_buffer (GIMP_DRAWABLE (layer)),
+                             expected);
+  g_object_unref (expected);
+
+  g_object_set (gimp->config, "xcf-lazy-loading", FALSE, NULL);
+
+  g_unlink (uri);
+  g_free (uri);
+}
+
+/**
+ * gimp_test_load_image:
+ *
+ * Loads @uri the way "File > Open" does.
+ *
+ * Returns: The #GimpImage, or %NULL
+ **/
+static GimpImage *
+gimp_test_load_image (Gimp        *gimp,
+                      const gchar *uri)
+{
+  GimpPlugInProcedure *proc     = NULL;
+  GimpImage           *image    = NULL;
+  GimpPDBStatusType    not_used = 0;
+
+  proc = file_procedure_find (gimp->plug_in_manager->load_procs,
+                              uri,
+                              NULL /*error*/);
+  image = file_open_image (gimp,
+                           gimp_get_user_context (gimp),
+                           NULL /*progress*/,
+                           uri,
+                           "irrelevant" /*entered_filename*/,
+                           FALSE /*as_new*/,
+                           proc,
+                           GIMP_RUN_NONINTERACTIVE,
+                           &not_used /*status*/,
+                           NULL /*mime_type*/,
+                           NULL /*error*/);
+
+  return image;
+}
+
+/**
+ * gimp_create_pattern_buffer:
+ *
+ * Creates a buffer with the pixels of the pattern image's layer.  The
+ * upper half is noise that doesn't compress, the lower half gradients
+ * with long runs of equal bytes, and neither side is a multiple of
+ * the tile size.
+ *
+ * Returns: The #GeglBuffer
+ **/
+static GeglBuffer *
+gimp_create_pattern_buffer (void)
+{
+  GeglBuffer *buffer;
+  guchar     *data;
+  guchar     *p;
+  guint32     seed = 42;
+  gint        x, y;
+
+  buffer = gegl_buffer_new (GEGL_RECTANGLE (0, 0,
+                                            GIMP_PATTERN_WIDTH,
+                                            GIMP_PATTERN_HEIGHT),
+                            GIMP_PATTERN_FORMAT);
+
+  data = g_new (guchar, GIMP_PATTERN_WIDTH * GIMP_PATTERN_HEIGHT * 4);
+
+  for (y = 0, p = data; y < GIMP_PATTERN_HEIGHT; y++)
+    {
+      for (x = 0; x < GIMP_PATTERN_WIDTH; x++, p += 4)
+        {
+          if (y < GIMP_PATTERN_HEIGHT / 2)
+            {
+              seed = seed * 1103515245 + 12345;
+
+              p[0] = seed >> 24;
+              p[1] = seed >> 16;
+              p[2] = seed >> 8;
+              p[3] = 255 - (x & 0x0f);
+            }
+          else
+            {
+              p[0] = x / 2;
+              p[1] = y;
+              p[2] = 0x80;
+              p[3] = 255;
+            }
+        }
+    }
+
+  gegl_buffer_set (buffer, NULL, 0, GIMP_PATTERN_FORMAT, data,
+                   GEGL_AUTO_ROWSTRIDE);
+
+  g_free (data);
+
+  return buffer;
+}
+
+/**
+ * gimp_create_pattern_image:
+ *
+ * Creates an image with a single layer holding the pixels of
+ * gimp_create_pattern_buffer(), for testing how pixels are stored.
+ *
+ * Returns: The #GimpImage
+ **/
+static GimpImage *
+gimp_create_pattern_image (Gimp *gimp)
+{
+  GimpImage  *image;
+  GimpLayer  *layer;
+  GeglBuffer *pattern;
+
+  image = gimp_image_new (gimp,
+                          GIMP_PATTERN_WIDTH,
+                          GIMP_PATTERN_HEIGHT,
+                          GIMP_RGB,
+                          GIMP_PRECISION_U8);
+
+  layer = gimp_layer_new (image,
+                          GIMP_PATTERN_WIDTH,
+                          GIMP_PATTERN_HEIGHT,
+                          GIMP_PATTERN_FORMAT,
+                          GIMP_PATTERN_LAYER_NAME,
+                          GIMP_OPACITY_OPAQUE,
+                          GIMP_NORMAL_MODE);
+  gimp_image_add_layer (image,
+                        layer,
+                        NULL,
+                        0,
+                        FALSE /*push_undo*/);
+
+  pattern = gimp_create_pattern_buffer ();
+  gegl_buffer_copy (pattern, NULL,
+                    gimp_drawable_get_buffer (GIMP_DRAWABLE (layer)), NULL);
+  g_object_unref (pattern);
+
+  return image;
+}
+
+/**
+ * gimp_write_pattern_image:
+ * @expected_version: the XCF version the file must have
+ *
+ * Writes the pattern image to a file with the current XCF settings
+ * and makes sure the file was written with @expected_version.
+ *
+ * Returns: The URI of the file, free with g_free()
+ **/
+static gchar *
+gimp_write_pattern_image (Gimp *gimp,
+                          gint  expected_version)
+{
+  GimpImage           *image;
+  GimpPlugInProcedure *proc;
+  GimpPDBStatusType    status;
+  gchar               *uri;
+  gchar               *version_tag;
+  gchar               *contents = NULL;
+  gsize                length   = 0;
+
+  image = gimp_create_pattern_image (gimp);
+
+  uri  = g_build_filename (g_get_tmp_dir (), "gimp-test-pattern.xcf", NULL);
+  proc = file_procedure_find (gimp->plug_in_manager->save_procs,
+                              uri,
+                              NULL /*error*/);
+  status = file_save (gimp,
+                      image,
+                      NULL /*progress*/,
+                      uri,
+                      proc,
+                      GIMP_RUN_NONINTERACTIVE,
+                      FALSE /*change_saved_state*/,
+                      FALSE /*export_backward*/,
+                      FALSE /*export_forward*/,
+                      NULL /*error*/);
+  g_assert_cmpint (status, ==, GIMP_PDB_SUCCESS);
+
+  if (expected_version > 0)
+    version_tag = g_strdup_printf ("gimp xcf v%03d", expected_version);
+  else
+    version_tag = g_strdup ("gimp xcf file");
+
+  g_assert (g_file_get_contents (uri, &contents, &length, NULL));
+  g_assert (length > strlen (version_tag));
+  g_assert (strncmp (contents, version_tag, strlen (version_tag)) == 0);
+
+  g_free (contents);
+  g_free (version_tag);
+
+  return uri;
+}
+
+/**
+ * gimp_assert_pattern_thumbnail:
+ * @gimp:
+ * @uri:
+ *
+ * Loads a thumbnail from the XCF file at @uri and makes sure that it
+ * has the pattern's pixels, downsampled to the thumbnail size.
+ **/
+static void
+gimp_assert_pattern_thumbnail (Gimp        *gimp,
+                               const gchar *uri)
+{
+  GimpImage   *image;
+  GimpLayer   *layer;
+  GeglBuffer  *level_buffer;
+  GeglBuffer  *next_buffer;
+  const gchar *mime_type = NULL;
+  const Babl  *format    = NULL;
+  gint         width     = 0;
+  gint         height    = 0;
+  gint         n_layers  = 0;
+
+  /*  300 x 200 pixels, level 2 is the smallest one with at least 64  */
+  image = file_open_thumbnail (gimp,
+                               gimp_get_user_context (gimp),
+                               NULL /*progress*/,
+                               uri,
+                               64,
+                               &mime_type,
+                               &width,
+                               &height,
+                               &format,
+                               &n_layers,
+                               NULL /*error*/);
+  g_assert (image != NULL);
+
+  g_assert_cmpint (width,  ==, GIMP_PATTERN_WIDTH);
+  g_assert_cmpint (height, ==, GIMP_PATTERN_HEIGHT);
+  g_assert_cmpint (n_layers, ==, 1);
+
+  g_assert_cmpint (gimp_image_get_width  (image), ==, GIMP_PATTERN_WIDTH  / 4);
+  g_assert_cmpint (gimp_image_get_height (image), ==, GIMP_PATTERN_HEIGHT / 4);
+
+  layer = gimp_image_get_layer_by_name (image, GIMP_PATTERN_LAYER_NAME);
+  g_assert (layer != NULL);
+
+  /*  the stored levels are 2x2 box filtered from the previous one  */
+  level_buffer = gimp_create_pattern_buffer ();
+
+  next_buffer = gegl_buffer_new (GEGL_RECTANGLE (0, 0,
+                                                 GIMP_PATTERN_WIDTH  / 2,
+                                                 GIMP_PATTERN_HEIGHT / 2),
+                                 GIMP_PATTERN_FORMAT);
+  gimp_gegl_downsample (level_buffer, next_buffer);
+  g_object_unref (level_buffer);
+  level_buffer = next_buffer;
+
+  next_buffer = gegl_buffer_new (GEGL_RECTANGLE (0, 0,
+                                                 GIMP_PATTERN_WIDTH  / 4,
+                                                 GIMP_PATTERN_HEIGHT / 4),
+                                 GIMP_PATTERN_FORMAT);
+  gimp_gegl_downsample (level_buffer, next_buffer);
+  g_object_unref (level_buffer);
+  level_buffer = next_buffer;
+
+  gimp_assert_buffers_equal (gimp_drawable_get_buffer (GIMP_DRAWABLE (layer)),
+                             level_buffer);
+  g_object_unref (level_buffer);
+
+  g_object_unref (image);
+}
+
+/**
+ * gimp_assert_pattern_file:
+ *
+ * Loads a file written by gimp_write_pattern_image() and verifies
+ * that its layer has the pattern's pixels.
+ **/
+static void
+gimp_assert_pattern_file (Gimp        *gimp,
+                          const gchar *uri)
+{
+  GimpImage  *image;
+  GimpLayer  *layer;
+  GeglBuffer *pattern;
+
+  image = gimp_test_load_image (gimp, uri);
+  g_assert (image != NULL);
+
+  layer = gimp_image_get_layer_by_name (image, GIMP_PATTERN_LAYER_NAME);
+  g_assert (layer != NULL);
+
+  pattern = gimp_create_pattern_buffer ();
+  gimp_assert_buffers_equal (gimp_drawable_get_buffer (GIMP_DRAWABLE (layer)),
+                             pattern);
+  g_object_unref (pattern);
+}
+
+/**
+ * gimp_edit_pattern_buffer:
+ *
+ * Paints a gray rectangle across several tiles of a pattern buffer.
+ **/
+static void
+gimp_edit_pattern_buffer (GeglBuffer *buffer)
+{
+  const GeglRectangle rect = { 50, 40, 100, 100 };
+  guchar             *pixels;
+
+  pixels = g_malloc (rect.width * rect.height * 4);
+  memset (pixels, 0x80, rect.width * rect.height * 4);
+
+  gegl_buffer_set (buffer, &rect, 0, GIMP_PATTERN_FORMAT,
+                   pixels, GEGL_AUTO_ROWSTRIDE);
+
+  g_free (pixels);
+}
+
+/**
+ * gimp_assert_buffers_equal:
+ *
+ * Verifies that two buffers have the same size and the same pixels.
+ **/
+static void
+gimp_assert_buffers_equal (GeglBuffer *buffer1,
+                           GeglBuffer *buffer2)
+{
+  const Babl *format = gegl_buffer_get_format (buffer2);
+  gint        width  = gegl_buffer_get_width  (buffer2);
+  gint        height = gegl_buffer_get_height (buffer2);
+  gsize       size;
+  guchar     *data1;
+  guchar     *data2;
+
+  g_assert_cmpint (gegl_buffer_get_width  (buffer1), ==, width);
+  g_assert_cmpint (gegl_buffer_get_height (buffer1), ==, height);
+  g_assert (gegl_buffer_get_format (buffer1) == format);
+
+  size  = (gsize) width * height * babl_format_get_bytes_per_pixel (format);
+  data1 = g_malloc (size);
+  data2 = g_malloc (size);
+
+  gegl_buffer_get (buffer1, NULL, 1.0, format, data1,
+                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+  gegl_buffer_get (buffer2, NULL, 1.0, format, data2,
+                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+  g_assert (memcmp (data1, data2, size) == 0);
+
+  g_free (data1);
+  g_free (data2);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  Gimp *gimp;
+  int   result;
+
+  g_test_init (&argc, &argv, NULL);
+
+  gimp_test_utils_set_gimp2_directory ("GIMP_TESTING_ABS_TOP_SRCDIR",
+                                       "app/tests/gimpdir");
+
+  /* We need the GUI variant for the file procs */
+  gimp = gimp_init_for_testing ();
+
+  /* Add tests */
+  ADD_TEST (write_and_read_zlib_compression);
+  ADD_TEST (write_and_read_64bit_offsets);
+  ADD_TEST (load_stored_levels);
+  ADD_TEST (load_lazily);
+
+  /* Don't write files to the source dir */
+  gimp_test_utils_set_gimp2_directory ("GIMP_TESTING_ABS_TOP_BUILDDIR",
+                                       "app/tests/gimpdir-output");
+
+  /* Run the tests */
+  result = g_test_run ();
+
+  /* Exit so we don't break script-fu plug-in wire */
+  gimp_exit (gimp, TRUE);
+
+  return result;
+}
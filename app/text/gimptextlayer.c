@@ -104,7 +104,9 @@ static void       gimp_text_layer_push_undo      (GimpDrawable      *drawable,
                                                   gint               x,
                                                   gint               y,
                                                   gint               width,
-                                                  gint               height);
+                                                  gint               height,
+                                                  const GeglRectangle *rects,
+                                                  gint               n_rects);
 
 static void       gimp_text_layer_text_changed   (GimpTextLayer     *layer);
 static gboolean   gimp_text_layer_render         (GimpTextLayer     *layer);
@@ -377,13 +379,15 @@ gimp_text_layer_set_buffer (GimpDrawable *drawable,
 }
 
 static void
-gimp_text_layer_push_undo (GimpDrawable *drawable,
-                           const gchar  *undo_desc,
-                           GeglBuffer   *buffer,
-                           gint          x,
-                           gint          y,
-                           gint          width,
-                           gint          height)
+gimp_text_layer_push_undo (GimpDrawable        *drawable,
+                           const gchar         *undo_desc,
+                           GeglBuffer          *buffer,
+                           gint                 x,
+                           gint                 y,
+                           gint                 width,
+                           gint                 height,
+                           const GeglRectangle *rects,
+                           gint                 n_rects)
 {
   GimpTextLayer *layer = GIMP_TEXT_LAYER (drawable);
   GimpImage     *image = gimp_item_get_image (GIMP_ITEM (layer));
@@ -393,7 +397,8 @@ gimp_text_layer_push_undo (GimpDrawable *drawable,
 
   GIMP_DRAWABLE_CLASS (parent_class)->push_undo (drawable, undo_desc,
                                                  buffer,
-                                                 x, y, width, height);
+                                                 x, y, width, height,
+                                                 rects, n_rects);
 
   if (! layer->modified)
     {
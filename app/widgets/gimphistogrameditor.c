@@ -54,6 +54,14 @@ static void     gimp_histogram_editor_layer_changed (GimpImage           *image,
 static void     gimp_histogram_editor_frozen_update (GimpHistogramEditor *editor,
                                                      const GParamSpec    *pspec);
 static void     gimp_histogram_editor_update        (GimpHistogramEditor *editor);
+static void     gimp_histogram_editor_drawable_update
+                                                    (GimpDrawable        *drawable,
+                                                     gint                 x,
+                                                     gint                 y,
+                                                     gint                 width,
+                                                     gint                 height,
+                                                     GimpHistogramEditor *editor);
+static void     gimp_histogram_editor_queue_update  (GimpHistogramEditor *editor);
 
 static gboolean gimp_histogram_editor_idle_update   (GimpHistogramEditor *editor);
 static gboolean gimp_histogram_menu_sensitivity     (gint                 value,
@@ -107,6 +115,7 @@ gimp_histogram_editor_init (GimpHistogramEditor *editor)
   editor->histogram    = NULL;
   editor->bg_histogram = NULL;
   editor->valid        = FALSE;
+  editor->dirty        = NULL;
   editor->idle_id      = 0;
   editor->box          = gimp_histogram_box_new ();
 
@@ -249,6 +258,12 @@ gimp_histogram_editor_set_image (GimpImageEditor *image_editor,
           editor->idle_id = 0;
         }
 
+      if (editor->dirty)
+        {
+          cairo_region_destroy (editor->dirty);
+          editor->dirty = NULL;
+        }
+
       g_signal_handlers_disconnect_by_func (image_editor->image,
                                             gimp_histogram_editor_update,
                                             editor);
@@ -327,7 +342,7 @@ gimp_histogram_editor_layer_changed (GimpImage           *image,
                                             gimp_histogram_editor_menu_update,
                                             editor);
       g_signal_handlers_disconnect_by_func (editor->drawable,
-                                            gimp_histogram_editor_update,
+                                            gimp_histogram_editor_drawable_update,
                                             editor);
       g_signal_handlers_disconnect_by_func (editor->drawable,
                                             gimp_histogram_editor_frozen_update,
@@ -346,8 +361,8 @@ gimp_histogram_editor_layer_changed (GimpImage           *image,
                                G_CALLBACK (gimp_histogram_editor_frozen_update),
                                editor, G_CONNECT_SWAPPED);
       g_signal_connect_object (editor->drawable, "update",
-                               G_CALLBACK (gimp_histogram_editor_update),
-                               editor, G_CONNECT_SWAPPED);
+                               G_CALLBACK (gimp_histogram_editor_drawable_update),
+                               editor, 0);
       g_signal_connect_object (editor->drawable, "alpha-changed",
                                G_CALLBACK (gimp_histogram_editor_menu_update),
                                editor, G_CONNECT_SWAPPED);
@@ -373,9 +388,43 @@ gimp_histogram_editor_validate (GimpHistogramEditor *editor)
   if (! editor->valid && editor->histogram)
     {
       if (editor->drawable)
-        gimp_drawable_calculate_histogram (editor->drawable, editor->histogram);
+        {
+          GeglRectangle *rects   = NULL;
+          gint           n_rects = -1;
+
+          /*  only count the changed pixels again if we know which  */
+          if (editor->dirty)
+            {
+              gint i;
+
+              n_rects = cairo_region_num_rectangles (editor->dirty);
+              rects   = g_new (GeglRectangle, MAX (n_rects, 1));
+
+              for (i = 0; i < n_rects; i++)
+                {
+                  cairo_rectangle_int_t rect;
+
+                  cairo_region_get_rectangle (editor->dirty, i, &rect);
+
+                  rects[i] = *GEGL_RECTANGLE (rect.x,     rect.y,
+                                              rect.width, rect.height);
+                }
+
+              cairo_region_destroy (editor->dirty);
+            }
+
+          gimp_drawable_calculate_histogram_incremental (editor->drawable,
+                                                         editor->histogram,
+                                                         rects, n_rects);
+
+          g_free (rects);
+
+          editor->dirty = cairo_region_create ();
+        }
       else
-        gimp_histogram_clear_values (editor->histogram);
+        {
+          gimp_histogram_clear_values (editor->histogram);
+        }
 
       gimp_histogram_editor_info_update (editor);
 
@@ -419,6 +468,37 @@ gimp_histogram_editor_frozen_update (GimpHistogramEditor *editor,
 
 static void
 gimp_histogram_editor_update (GimpHistogramEditor *editor)
+{
+  /*  anything but the drawable's pixels changed, count them all again  */
+  if (editor->dirty)
+    {
+      cairo_region_destroy (editor->dirty);
+      editor->dirty = NULL;
+    }
+
+  gimp_histogram_editor_queue_update (editor);
+}
+
+static void
+gimp_histogram_editor_drawable_update (GimpDrawable        *drawable,
+                                       gint                 x,
+                                       gint                 y,
+                                       gint                 width,
+                                       gint                 height,
+                                       GimpHistogramEditor *editor)
+{
+  if (editor->dirty)
+    {
+      cairo_rectangle_int_t rect = { x, y, width, height };
+
+      cairo_region_union_rectangle (editor->dirty, &rect);
+    }
+
+  gimp_histogram_editor_queue_update (editor);
+}
+
+static void
+gimp_histogram_editor_queue_update (GimpHistogramEditor *editor)
 {
   if (editor->idle_id)
     g_source_remove (editor->idle_id);
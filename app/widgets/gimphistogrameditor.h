@@ -42,6 +42,7 @@ struct _GimpHistogramEditor
 
   guint                 idle_id;
   gboolean              valid;
+  cairo_region_t       *dirty;   /* changed since the last calculation */
 
   GtkWidget            *menu;
   GtkWidget            *box;
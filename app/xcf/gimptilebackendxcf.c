@@ -0,0 +1,772 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <gio/gio.h>
+#include <gegl.h>
+#include <glib/gstdio.h>
+
+#include "libgimpbase/gimpbase.h"
+#include "libgimpconfig/gimpconfig.h"
+
+#include "core/core-types.h"
+
+#include "config/gimpgeglconfig.h"
+
+#include "core/gimp.h"
+#include "core/gimp-utils.h"
+
+#include "xcf-private.h"
+#include "xcf-load.h"
+
+#include "gimptilebackendxcf.h"
+
+#include "gimp-intl.h"
+
+
+/*  where a tile is kept in the swap file, either as the raw pixels
+ *  GEGL wrote back, or as the tile's XCF data copied out of the file
+ *  before it was overwritten
+ */
+struct _GimpTileBackendXcfSwapTile
+{
+  goffset  offset;
+  gsize    size;    /*  0 if the tile isn't in the swap  */
+  gboolean raw;
+};
+
+
+static void       gimp_tile_backend_xcf_finalize     (GObject            *object);
+
+static gpointer   gimp_tile_backend_xcf_command      (GeglTileSource     *source,
+                                                      GeglTileCommand     command,
+                                                      gint                x,
+                                                      gint                y,
+                                                      gint                z,
+                                                      gpointer            data);
+
+static GeglTile * gimp_tile_backend_xcf_get_tile     (GimpTileBackendXcf *backend_xcf,
+                                                      gint                index);
+static void       gimp_tile_backend_xcf_set_tile     (GimpTileBackendXcf *backend_xcf,
+                                                      gint                index,
+                                                      GeglTile           *tile);
+static const guchar *
+                  gimp_tile_backend_xcf_get_xcf_data (GimpTileBackendXcf *backend_xcf,
+                                                      GMappedFile        *file,
+                                                      gint                index,
+                                                      gsize              *xcf_size);
+static gboolean   gimp_tile_backend_xcf_decode       (GimpTileBackendXcf *backend_xcf,
+                                                      gint                index,
+                                                      const guchar       *xcf_data,
+                                                      gsize               xcf_size,
+                                                      guchar             *tile_data);
+static gboolean   gimp_tile_backend_xcf_copy_to_swap (GimpTileBackendXcf *backend_xcf,
+                                                      GError            **error);
+
+static gboolean   gimp_tile_backend_xcf_swap_open    (GimpTileBackendXcf *backend_xcf,
+                                                      GError            **error);
+static gboolean   gimp_tile_backend_xcf_swap_write   (GimpTileBackendXcf *backend_xcf,
+                                                      gint                index,
+                                                      const guchar       *data,
+                                                      gsize               size,
+                                                      gboolean            raw,
+                                                      GError            **error);
+static gboolean   gimp_tile_backend_xcf_swap_read    (GimpTileBackendXcf *backend_xcf,
+                                                      gint                index,
+                                                      guchar             *data,
+                                                      GError            **error);
+
+static void       gimp_tile_backend_xcf_report       (GimpTileBackendXcf *backend_xcf);
+static gboolean   gimp_tile_backend_xcf_report_idle  (gpointer            data);
+
+
+G_DEFINE_TYPE (GimpTileBackendXcf, gimp_tile_backend_xcf,
+               GEGL_TYPE_TILE_BACKEND)
+
+#define parent_class gimp_tile_backend_xcf_parent_class
+
+
+/*  all backends which still read from a file, so they can let go of
+ *  it before the file is overwritten
+ */
+static GList  *backends = NULL;
+static GMutex  backends_mutex;
+
+static gint    swap_serial = 0;
+
+
+static void
+gimp_tile_backend_xcf_class_init (GimpTileBackendXcfClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = gimp_tile_backend_xcf_finalize;
+}
+
+static void
+gimp_tile_backend_xcf_init (GimpTileBackendXcf *backend_xcf)
+{
+  GeglTileSource *source = GEGL_TILE_SOURCE (backend_xcf);
+
+  source->command = gimp_tile_backend_xcf_command;
+
+  g_mutex_init (&backend_xcf->mutex);
+
+  backend_xcf->tiles = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                              NULL, g_free);
+}
+
+static void
+gimp_tile_backend_xcf_finalize (GObject *object)
+{
+  GimpTileBackendXcf *backend_xcf = GIMP_TILE_BACKEND_XCF (object);
+
+  g_mutex_lock (&backends_mutex);
+  backends = g_list_remove (backends, backend_xcf);
+  g_mutex_unlock (&backends_mutex);
+
+  if (backend_xcf->file)
+    {
+      g_mapped_file_unref (backend_xcf->file);
+      backend_xcf->file = NULL;
+    }
+
+  if (backend_xcf->swap_stream)
+    {
+      g_io_stream_close (G_IO_STREAM (backend_xcf->swap_stream), NULL, NULL);
+      g_object_unref (backend_xcf->swap_stream);
+      backend_xcf->swap_stream = NULL;
+
+      g_file_delete (backend_xcf->swap_file, NULL, NULL);
+    }
+
+  if (backend_xcf->swap_file)
+    {
+      g_object_unref (backend_xcf->swap_file);
+      backend_xcf->swap_file = NULL;
+    }
+
+  g_clear_error (&backend_xcf->swap_error);
+
+  g_free (backend_xcf->filename);
+  g_free (backend_xcf->offsets);
+  g_free (backend_xcf->swap_tiles);
+  g_hash_table_unref (backend_xcf->tiles);
+
+  g_mutex_clear (&backend_xcf->mutex);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static gpointer
+gimp_tile_backend_xcf_command (GeglTileSource  *source,
+                               GeglTileCommand  command,
+                               gint             x,
+                               gint             y,
+                               gint             z,
+                               gpointer         data)
+{
+  GimpTileBackendXcf *backend_xcf = GIMP_TILE_BACKEND_XCF (source);
+  gint                index;
+
+  /*  only the full-size level is stored in the file, GEGL generates
+   *  all others from it
+   */
+  if (z != 0 || x < 0 || y < 0 || x >= backend_xcf->n_tile_cols)
+    return NULL;
+
+  index = y * backend_xcf->n_tile_cols + x;
+
+  if (index >= backend_xcf->n_tiles)
+    return NULL;
+
+  switch (command)
+    {
+    case GEGL_TILE_GET:
+      return gimp_tile_backend_xcf_get_tile (backend_xcf, index);
+
+    case GEGL_TILE_SET:
+      gimp_tile_backend_xcf_set_tile (backend_xcf, index, data);
+      break;
+
+    case GEGL_TILE_EXIST:
+      return GINT_TO_POINTER (TRUE);
+
+    default:
+      g_assert (command < GEGL_TILE_LAST_COMMAND && command >= 0);
+    }
+
+  return NULL;
+}
+
+static GeglTile *
+gimp_tile_backend_xcf_get_tile (GimpTileBackendXcf *backend_xcf,
+                                gint                index)
+{
+  GeglTileBackend *backend   = GEGL_TILE_BACKEND (backend_xcf);
+  gint             tile_size = gegl_tile_backend_get_tile_size (backend);
+  GeglTile        *tile;
+  guchar          *tile_data;
+  GMappedFile     *file      = NULL;
+  guchar          *xcf_data  = NULL;
+  gsize            xcf_size  = 0;
+  const guchar    *data;
+  gboolean         empty     = FALSE;
+  gboolean         success   = TRUE;
+
+  tile      = gegl_tile_new (tile_size);
+  tile_data = gegl_tile_get_data (tile);
+
+  g_mutex_lock (&backend_xcf->mutex);
+
+  data = g_hash_table_lookup (backend_xcf->tiles, GINT_TO_POINTER (index));
+
+  if (data)
+    {
+      memcpy (tile_data, data, tile_size);
+    }
+  else if (backend_xcf->swap_tiles[index].size > 0)
+    {
+      GimpTileBackendXcfSwapTile *swap_tile = &backend_xcf->swap_tiles[index];
+      GError                     *error     = NULL;
+
+      if (swap_tile->raw)
+        {
+          success = gimp_tile_backend_xcf_swap_read (backend_xcf, index,
+                                                     tile_data, &error);
+        }
+      else
+        {
+          xcf_size = swap_tile->size;
+          xcf_data = g_malloc (xcf_size);
+
+          success = gimp_tile_backend_xcf_swap_read (backend_xcf, index,
+                                                     xcf_data, &error);
+        }
+
+      if (! success)
+        {
+          if (! backend_xcf->swap_error)
+            g_propagate_error (&backend_xcf->swap_error, error);
+          else
+            g_clear_error (&error);
+        }
+    }
+  else if (backend_xcf->file)
+    {
+      file = g_mapped_file_ref (backend_xcf->file);
+    }
+  else
+    {
+      empty = TRUE;
+    }
+
+  g_mutex_unlock (&backend_xcf->mutex);
+
+  /*  decode outside of the lock, other threads may be fetching other
+   *  tiles of the same buffer meanwhile
+   */
+  if (file)
+    {
+      const guchar *file_data;
+
+      file_data = gimp_tile_backend_xcf_get_xcf_data (backend_xcf, file,
+                                                      index, &xcf_size);
+
+      success = gimp_tile_backend_xcf_decode (backend_xcf, index,
+                                              file_data, xcf_size,
+                                              tile_data);
+
+      g_mapped_file_unref (file);
+    }
+  else if (xcf_data)
+    {
+      if (success)
+        success = gimp_tile_backend_xcf_decode (backend_xcf, index,
+                                                xcf_data, xcf_size,
+                                                tile_data);
+
+      g_free (xcf_data);
+    }
+  else if (empty)
+    {
+      memset (tile_data, 0, tile_size);
+    }
+
+  if (! success)
+    {
+      memset (tile_data, 0, tile_size);
+
+      g_mutex_lock (&backend_xcf->mutex);
+      backend_xcf->n_failed_tiles++;
+      gimp_tile_backend_xcf_report (backend_xcf);
+      g_mutex_unlock (&backend_xcf->mutex);
+    }
+
+  return tile;
+}
+
+static void
+gimp_tile_backend_xcf_set_tile (GimpTileBackendXcf *backend_xcf,
+                                gint                index,
+                                GeglTile           *tile)
+{
+  GeglTileBackend *backend   = GEGL_TILE_BACKEND (backend_xcf);
+  gint             tile_size = gegl_tile_backend_get_tile_size (backend);
+  guchar          *data      = gegl_tile_get_data (tile);
+  GError          *error     = NULL;
+
+  g_mutex_lock (&backend_xcf->mutex);
+
+  /*  keep tiles in memory only if the swap can't be written  */
+  if (g_hash_table_contains (backend_xcf->tiles, GINT_TO_POINTER (index)) ||
+      ! gimp_tile_backend_xcf_swap_write (backend_xcf, index,
+                                          data, tile_size, TRUE, &error))
+    {
+      g_hash_table_insert (backend_xcf->tiles, GINT_TO_POINTER (index),
+                           g_memdup (data, tile_size));
+
+      if (error)
+        {
+          if (! backend_xcf->swap_error)
+            {
+              g_propagate_error (&backend_xcf->swap_error, error);
+
+              gimp_tile_backend_xcf_report (backend_xcf);
+            }
+          else
+            {
+              g_clear_error (&error);
+            }
+        }
+    }
+
+  g_mutex_unlock (&backend_xcf->mutex);
+
+  gegl_tile_mark_as_stored (tile);
+}
+
+/*  returns the XCF data of a tile in the mapped file, or NULL if the
+ *  tile is empty
+ */
+static const guchar *
+gimp_tile_backend_xcf_get_xcf_data (GimpTileBackendXcf *backend_xcf,
+                                    GMappedFile        *file,
+                                    gint                index,
+                                    gsize              *xcf_size)
+{
+  const guchar *contents = (const guchar *) g_mapped_file_get_contents (file);
+  gsize         length   = g_mapped_file_get_length (file);
+  goffset       offset   = backend_xcf->offsets[index];
+  goffset       offset2  = backend_xcf->offsets[index + 1];
+
+  *xcf_size = 0;
+
+  if (offset <= 0 || offset >= length)
+    return NULL;
+
+  /*  like in xcf_load_level(), tiles with a bogus size are treated as
+   *  empty, see bug #357809
+   */
+  if (offset2 == 0)
+    *xcf_size = length - offset;
+  else if (offset2 > offset)
+    *xcf_size = MIN (offset2, length) - offset;
+
+  if (*xcf_size == 0)
+    return NULL;
+
+  return contents + offset;
+}
+
+static gboolean
+gimp_tile_backend_xcf_decode (GimpTileBackendXcf *backend_xcf,
+                              gint                index,
+                              const guchar       *xcf_data,
+                              gsize               xcf_size,
+                              guchar             *tile_data)
+{
+  gint      bpp       = backend_xcf->bpp;
+  gint      x         = index % backend_xcf->n_tile_cols * XCF_TILE_WIDTH;
+  gint      y         = index / backend_xcf->n_tile_cols * XCF_TILE_HEIGHT;
+  gint      width     = MIN (XCF_TILE_WIDTH,  backend_xcf->width  - x);
+  gint      height    = MIN (XCF_TILE_HEIGHT, backend_xcf->height - y);
+  gsize     tile_size = XCF_TILE_WIDTH * XCF_TILE_HEIGHT * bpp;
+  guchar   *pixels;
+  gboolean  success;
+
+  memset (tile_data, 0, tile_size);
+
+  if (! xcf_data)
+    return TRUE;
+
+  /*  the file stores the pixels of partial tiles at the right edge
+   *  packed, the GEGL tile always has full rows
+   */
+  if (width == XCF_TILE_WIDTH)
+    pixels = tile_data;
+  else
+    pixels = g_malloc (width * height * bpp);
+
+  success = xcf_load_tile_data (backend_xcf->compression, xcf_data, xcf_size,
+                                pixels, width * height, bpp);
+
+  if (success && pixels != tile_data)
+    {
+      gint row;
+
+      for (row = 0; row < height; row++)
+        memcpy (tile_data + row * XCF_TILE_WIDTH * bpp,
+                pixels    + row * width * bpp,
+                width * bpp);
+    }
+
+  if (pixels != tile_data)
+    g_free (pixels);
+
+  return success;
+}
+
+/*  copies the XCF data of all tiles which are neither in the swap
+ *  nor in memory from the mapped file to the swap, and lets go of the
+ *  file.  The tiles stay compressed and are decoded when accessed.
+ */
+static gboolean
+gimp_tile_backend_xcf_copy_to_swap (GimpTileBackendXcf  *backend_xcf,
+                                    GError             **error)
+{
+  gint i;
+
+  g_mutex_lock (&backend_xcf->mutex);
+
+  if (! backend_xcf->file)
+    {
+      g_mutex_unlock (&backend_xcf->mutex);
+      return TRUE;
+    }
+
+  for (i = 0; i < backend_xcf->n_tiles; i++)
+    {
+      const guchar *xcf_data;
+      gsize         xcf_size;
+
+      if (backend_xcf->swap_tiles[i].size > 0 ||
+          g_hash_table_contains (backend_xcf->tiles, GINT_TO_POINTER (i)))
+        continue;
+
+      xcf_data = gimp_tile_backend_xcf_get_xcf_data (backend_xcf,
+                                                     backend_xcf->file,
+                                                     i, &xcf_size);
+
+      if (xcf_data &&
+          ! gimp_tile_backend_xcf_swap_write (backend_xcf, i,
+                                              xcf_data, xcf_size, FALSE,
+                                              error))
+        {
+          g_mutex_unlock (&backend_xcf->mutex);
+          return FALSE;
+        }
+    }
+
+  g_mapped_file_unref (backend_xcf->file);
+  backend_xcf->file = NULL;
+
+  g_mutex_unlock (&backend_xcf->mutex);
+
+  return TRUE;
+}
+
+
+/*  the swap file, these are called with the backend's mutex held  */
+
+static gboolean
+gimp_tile_backend_xcf_swap_open (GimpTileBackendXcf  *backend_xcf,
+                                 GError             **error)
+{
+  GimpGeglConfig *config = GIMP_GEGL_CONFIG (backend_xcf->gimp->config);
+  gchar          *swap_dir;
+  gchar          *basename;
+  gchar          *filename;
+
+  if (! config->swap_path)
+    {
+      g_set_error_literal (error, G_FILE_ERROR, G_FILE_ERROR_NOENT,
+                           _("No swap folder is set."));
+      return FALSE;
+    }
+
+  swap_dir = gimp_config_path_expand (config->swap_path, TRUE, error);
+
+  if (! swap_dir)
+    return FALSE;
+
+  basename = g_strdup_printf ("gimp-xcf-swap-%d-%d",
+                              gimp_get_pid (),
+                              g_atomic_int_add (&swap_serial, 1));
+  filename = g_build_filename (swap_dir, basename, NULL);
+
+  backend_xcf->swap_file   = g_file_new_for_path (filename);
+  backend_xcf->swap_stream = g_file_replace_readwrite (backend_xcf->swap_file,
+                                                       NULL, FALSE,
+                                                       G_FILE_CREATE_PRIVATE,
+                                                       NULL, error);
+
+  g_free (filename);
+  g_free (basename);
+  g_free (swap_dir);
+
+  if (! backend_xcf->swap_stream)
+    {
+      g_object_unref (backend_xcf->swap_file);
+      backend_xcf->swap_file = NULL;
+
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+static gboolean
+gimp_tile_backend_xcf_swap_write (GimpTileBackendXcf  *backend_xcf,
+                                  gint                 index,
+                                  const guchar        *data,
+                                  gsize                size,
+                                  gboolean             raw,
+                                  GError             **error)
+{
+  GimpTileBackendXcfSwapTile *swap_tile = &backend_xcf->swap_tiles[index];
+  goffset                     offset;
+
+  if (backend_xcf->swap_failed)
+    {
+      g_set_error_literal (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                           _("The swap file can't be written."));
+      return FALSE;
+    }
+
+  if (! backend_xcf->swap_stream &&
+      ! gimp_tile_backend_xcf_swap_open (backend_xcf, error))
+    {
+      backend_xcf->swap_failed = TRUE;
+      return FALSE;
+    }
+
+  /*  raw tiles all have the same size and are overwritten in place,
+   *  everything else is appended
+   */
+  if (raw && swap_tile->raw && swap_tile->size == size)
+    offset = swap_tile->offset;
+  else
+    offset = backend_xcf->swap_size;
+
+  if (! g_seekable_seek (G_SEEKABLE (backend_xcf->swap_stream), offset,
+                         G_SEEK_SET, NULL, error) ||
+      ! g_output_stream_write_all (g_io_stream_get_output_stream (G_IO_STREAM (backend_xcf->swap_stream)),
+                                   data, size, NULL, NULL, error))
+    {
+      backend_xcf->swap_failed = TRUE;
+      return FALSE;
+    }
+
+  if (offset == backend_xcf->swap_size)
+    backend_xcf->swap_size += size;
+
+  swap_tile->offset = offset;
+  swap_tile->size   = size;
+  swap_tile->raw    = raw;
+
+  return TRUE;
+}
+
+static gboolean
+gimp_tile_backend_xcf_swap_read (GimpTileBackendXcf  *backend_xcf,
+                                 gint                 index,
+                                 guchar              *data,
+                                 GError             **error)
+{
+  GimpTileBackendXcfSwapTile *swap_tile = &backend_xcf->swap_tiles[index];
+
+  return (g_seekable_seek (G_SEEKABLE (backend_xcf->swap_stream),
+                           swap_tile->offset, G_SEEK_SET, NULL, error) &&
+          g_input_stream_read_all (g_io_stream_get_input_stream (G_IO_STREAM (backend_xcf->swap_stream)),
+                                   data, swap_tile->size, NULL, NULL, error));
+}
+
+
+/*  tiles may be fetched from any thread, problems are reported from
+ *  an idle on the main thread.  Called with the backend's mutex held.
+ */
+static void
+gimp_tile_backend_xcf_report (GimpTileBackendXcf *backend_xcf)
+{
+  if (! backend_xcf->report_idle_id)
+    {
+      backend_xcf->report_idle_id =
+        g_idle_add_full (G_PRIORITY_DEFAULT_IDLE,
+                         gimp_tile_backend_xcf_report_idle,
+                         g_object_ref (backend_xcf),
+                         (GDestroyNotify) g_object_unref);
+    }
+}
+
+static gboolean
+gimp_tile_backend_xcf_report_idle (gpointer data)
+{
+  GimpTileBackendXcf *backend_xcf = data;
+  GError             *swap_error;
+  gint                n_failed_tiles;
+
+  g_mutex_lock (&backend_xcf->mutex);
+
+  n_failed_tiles = backend_xcf->n_failed_tiles;
+  swap_error     = backend_xcf->swap_error;
+
+  backend_xcf->n_failed_tiles = 0;
+  backend_xcf->swap_error     = NULL;
+  backend_xcf->report_idle_id = 0;
+
+  g_mutex_unlock (&backend_xcf->mutex);
+
+  if (n_failed_tiles > 0)
+    gimp_message (backend_xcf->gimp, NULL, GIMP_MESSAGE_WARNING,
+                  _("Could not decode %d tiles of '%s', they were "
+                    "left empty."),
+                  n_failed_tiles,
+                  gimp_filename_to_utf8 (backend_xcf->filename));
+
+  if (swap_error)
+    {
+      gimp_message (backend_xcf->gimp, NULL, GIMP_MESSAGE_WARNING,
+                    _("Could not use a swap file for the pixels of '%s', "
+                      "changes are kept in memory: %s"),
+                    gimp_filename_to_utf8 (backend_xcf->filename),
+                    swap_error->message);
+
+      g_error_free (swap_error);
+    }
+
+  return G_SOURCE_REMOVE;
+}
+
+
+/*  public functions  */
+
+GeglTileBackend *
+gimp_tile_backend_xcf_new (Gimp               *gimp,
+                           GMappedFile        *file,
+                           const gchar        *filename,
+                           XcfCompressionType  compression,
+                           const Babl         *format,
+                           gint                width,
+                           gint                height,
+                           goffset            *offsets)
+{
+  GeglTileBackend    *backend;
+  GimpTileBackendXcf *backend_xcf;
+  GStatBuf            stat_buf;
+  gint                n_tile_rows;
+
+  g_return_val_if_fail (GIMP_IS_GIMP (gimp), NULL);
+  g_return_val_if_fail (file != NULL, NULL);
+  g_return_val_if_fail (filename != NULL, NULL);
+  g_return_val_if_fail (format != NULL, NULL);
+  g_return_val_if_fail (width > 0 && height > 0, NULL);
+  g_return_val_if_fail (offsets != NULL, NULL);
+
+  backend = g_object_new (GIMP_TYPE_TILE_BACKEND_XCF,
+                          "tile-width",  XCF_TILE_WIDTH,
+                          "tile-height", XCF_TILE_HEIGHT,
+                          "format",      format,
+                          NULL);
+
+  backend_xcf = GIMP_TILE_BACKEND_XCF (backend);
+
+  n_tile_rows = (height + XCF_TILE_HEIGHT - 1) / XCF_TILE_HEIGHT;
+
+  backend_xcf->gimp        = gimp;
+  backend_xcf->file        = g_mapped_file_ref (file);
+  backend_xcf->filename    = g_strdup (filename);
+  backend_xcf->compression = compression;
+  backend_xcf->width       = width;
+  backend_xcf->height      = height;
+  backend_xcf->bpp         = babl_format_get_bytes_per_pixel (format);
+  backend_xcf->n_tile_cols = (width + XCF_TILE_WIDTH - 1) / XCF_TILE_WIDTH;
+  backend_xcf->n_tiles     = backend_xcf->n_tile_cols * n_tile_rows;
+  backend_xcf->offsets     = offsets;
+  backend_xcf->swap_tiles  = g_new0 (GimpTileBackendXcfSwapTile,
+                                     backend_xcf->n_tiles);
+
+  if (g_stat (filename, &stat_buf) == 0)
+    {
+      backend_xcf->file_dev = stat_buf.st_dev;
+      backend_xcf->file_ino = stat_buf.st_ino;
+    }
+
+  gegl_tile_backend_set_extent (backend,
+                                GEGL_RECTANGLE (0, 0, width, height));
+
+  g_mutex_lock (&backends_mutex);
+  backends = g_list_prepend (backends, backend_xcf);
+  g_mutex_unlock (&backends_mutex);
+
+  return backend;
+}
+
+/*  makes all backends which read from @filename copy their remaining
+ *  tiles to their swap file and release the file, this must be called
+ *  before the file is overwritten.  If it fails, the file must not be
+ *  overwritten.
+ */
+gboolean
+gimp_tile_backend_xcf_unmap_file (const gchar  *filename,
+                                  GError      **error)
+{
+  GStatBuf  stat_buf;
+  GList    *list;
+  gboolean  success = TRUE;
+
+  g_return_val_if_fail (filename != NULL, FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  if (g_stat (filename, &stat_buf) != 0)
+    return TRUE;
+
+  g_mutex_lock (&backends_mutex);
+
+  for (list = backends; success && list; list = g_list_next (list))
+    {
+      GimpTileBackendXcf *backend_xcf = list->data;
+      gboolean            same_file;
+
+      /*  there are no inode numbers on windows  */
+      if (stat_buf.st_ino != 0)
+        same_file = (backend_xcf->file_dev == stat_buf.st_dev &&
+                     backend_xcf->file_ino == stat_buf.st_ino);
+      else
+        same_file = ! strcmp (backend_xcf->filename, filename);
+
+      if (same_file)
+        success = gimp_tile_backend_xcf_copy_to_swap (backend_xcf, error);
+    }
+
+  g_mutex_unlock (&backends_mutex);
+
+  return success;
+}
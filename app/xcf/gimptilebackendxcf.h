@@ -0,0 +1,99 @@
+/* GIMP - The GNU Image Manipulation Program
+ * Copyright (C) 1995 Spencer Kimball and Peter Mattis
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GIMP_TILE_BACKEND_XCF_H__
+#define __GIMP_TILE_BACKEND_XCF_H__
+
+#include <gegl-buffer-backend.h>
+
+/***
+ * GimpTileBackendXcf is a GeglTileBackend that decodes the tiles of
+ * one level of an XCF file the first time they are accessed, reading
+ * them from the memory-mapped file.  Tiles that are written back by
+ * GEGL go to a swap file in swap-path, so only GEGL's tile cache
+ * holds pixels in memory.
+ */
+
+G_BEGIN_DECLS
+
+#define GIMP_TYPE_TILE_BACKEND_XCF            (gimp_tile_backend_xcf_get_type ())
+#define GIMP_TILE_BACKEND_XCF(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), GIMP_TYPE_TILE_BACKEND_XCF, GimpTileBackendXcf))
+#define GIMP_TILE_BACKEND_XCF_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass),  GIMP_TYPE_TILE_BACKEND_XCF, GimpTileBackendXcfClass))
+#define GIMP_IS_TILE_BACKEND_XCF(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GIMP_TYPE_TILE_BACKEND_XCF))
+#define GIMP_IS_TILE_BACKEND_XCF_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass),  GIMP_TYPE_TILE_BACKEND_XCF))
+#define GIMP_TILE_BACKEND_XCF_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj),  GIMP_TYPE_TILE_BACKEND_XCF, GimpTileBackendXcfClass))
+
+
+typedef struct _GimpTileBackendXcf         GimpTileBackendXcf;
+typedef struct _GimpTileBackendXcfClass    GimpTileBackendXcfClass;
+typedef struct _GimpTileBackendXcfSwapTile GimpTileBackendXcfSwapTile;
+
+struct _GimpTileBackendXcf
+{
+  GeglTileBackend             parent_instance;
+
+  Gimp                       *gimp;
+  GMutex                      mutex;
+  GMappedFile                *file;        /* NULL once the swap has all tiles */
+  gchar                      *filename;
+  guint64                     file_dev;
+  guint64                     file_ino;
+  XcfCompressionType          compression;
+  gint                        width;
+  gint                        height;
+  gint                        bpp;
+  gint                        n_tile_cols;
+  gint                        n_tiles;
+  goffset                    *offsets;     /* n_tiles + 1 entries, '0' terminated */
+
+  GFile                      *swap_file;
+  GFileIOStream              *swap_stream;
+  goffset                     swap_size;
+  gboolean                    swap_failed;
+  GimpTileBackendXcfSwapTile *swap_tiles;  /* n_tiles entries                  */
+  GHashTable                 *tiles;       /* tile index -> pixels GEGL set
+                                            * while the swap couldn't be written
+                                            */
+
+  gint                        n_failed_tiles;
+  GError                     *swap_error;
+  guint                       report_idle_id;
+};
+
+struct _GimpTileBackendXcfClass
+{
+  GeglTileBackendClass  parent_class;
+};
+
+
+GType             gimp_tile_backend_xcf_get_type    (void) G_GNUC_CONST;
+
+GeglTileBackend * gimp_tile_backend_xcf_new         (Gimp               *gimp,
+                                                     GMappedFile        *file,
+                                                     const gchar        *filename,
+                                                     XcfCompressionType  compression,
+                                                     const Babl         *format,
+                                                     gint                width,
+                                                     gint                height,
+                                                     goffset            *offsets);
+
+gboolean          gimp_tile_backend_xcf_unmap_file  (const gchar        *filename,
+                                                     GError            **error);
+
+G_END_DECLS
+
+#endif /* __GIMP_TILE_BACKEND_XCF_H__ */
@@ -23,6 +23,7 @@
 #include <cairo.h>
 #include <gegl.h>
 #include <gdk-pixbuf/gdk-pixbuf.h>
+#include <zlib.h>
 
 #include "libgimpbase/gimpbase.h"
 #include "libgimpcolor/gimpcolor.h"
@@ -31,9 +32,11 @@
 
 #include "config/gimpcoreconfig.h"
 
+#include "gegl/gimp-gegl-loops.h"
 #include "gegl/gimp-gegl-tile-compat.h"
 
 #include "core/gimp.h"
+#include "core/gimp-parallel.h"
 #include "core/gimpcontainer.h"
 #include "core/gimpdrawable-private.h" /* eek */
 #include "core/gimpgrid.h"
@@ -67,6 +70,8 @@
 #include "xcf-read.h"
 #include "xcf-seek.h"
 
+#include "gimptilebackendxcf.h"
+
 #include "gimp-intl.h"
 
 
@@ -74,6 +79,31 @@
 
 /* #define GIMP_XCF_PATH_DEBUG */
 
+/*  the number of tiles per thread which are read and decompressed
+ *  before they are stored in the buffer in one go
+ */
+#define XCF_LOAD_TILES_PER_THREAD 8
+
+
+typedef struct _XcfLoadTile XcfLoadTile;
+
+struct _XcfLoadTile
+{
+  GeglRectangle  rect;
+  guchar        *data;      /* the pixels of the tile                 */
+  guchar        *xcf_data;  /* the tile's data as read from the file  */
+  gsize          xcf_size;
+  gboolean       skip;
+  gboolean       failed;
+};
+
+typedef struct
+{
+  XcfInfo     *info;
+  XcfLoadTile *tiles;
+  gint         bpp;
+} XcfLoadTilesData;
+
 
 static void            xcf_load_add_masks     (GimpImage     *image);
 static gboolean        xcf_load_image_props   (XcfInfo       *info,
@@ -101,18 +131,25 @@ static GimpChannel   * xcf_load_channel       (XcfInfo       *info,
 static GimpLayerMask * xcf_load_layer_mask    (XcfInfo       *info,
                                                GimpImage     *image);
 static gboolean        xcf_load_buffer        (XcfInfo       *info,
-                                               GeglBuffer    *buffer);
+                                               GimpDrawable  *drawable);
 static gboolean        xcf_load_level         (XcfInfo       *info,
-                                               GeglBuffer    *buffer);
-static gboolean        xcf_load_tile          (XcfInfo       *info,
-                                               GeglBuffer    *buffer,
-                                               GeglRectangle *tile_rect,
-                                               const Babl    *format);
-static gboolean        xcf_load_tile_rle      (XcfInfo       *info,
                                                GeglBuffer    *buffer,
-                                               GeglRectangle *tile_rect,
-                                               const Babl    *format,
-                                               gint           data_length);
+                                               GimpDrawable  *lazy_drawable);
+static guint           xcf_read_offset        (XcfInfo       *info,
+                                               goffset       *offsets,
+                                               gint           count);
+static void            xcf_load_decode_tiles  (gsize          offset,
+                                               gsize          size,
+                                               gpointer       user_data);
+static gboolean        xcf_load_tile_rle      (const guchar  *xcfdata,
+                                               gsize          data_length,
+                                               guchar        *tile_data,
+                                               gint           n_pixels,
+                                               gint           bpp);
+static gboolean        xcf_load_tile_zlib     (const guchar  *xcfdata,
+                                               gsize          data_length,
+                                               guchar        *tile_data,
+                                               gsize          tile_size);
 static GimpParasite  * xcf_load_parasite      (XcfInfo       *info);
 static gboolean        xcf_load_old_paths     (XcfInfo       *info,
                                                GimpImage     *image);
@@ -141,8 +178,8 @@ xcf_load_image (Gimp     *gimp,
 {
   GimpImage          *image;
   const GimpParasite *parasite;
-  guint32             saved_pos;
-  guint32             offset;
+  goffset             saved_pos;
+  goffset             offset;
   gint                width;
   gint                height;
   gint                image_type;
@@ -157,7 +194,28 @@ xcf_load_image (Gimp     *gimp,
   if (info->file_version >= 4)
     info->cp += xcf_read_int32 (info->fp, (guint32 *) &precision, 1);
 
-  image = gimp_create_image (gimp, width, height, image_type, precision,
+  info->image_width  = width;
+  info->image_height = height;
+
+  /* when loading a preview, pick the smallest hierarchy level that is
+   * still at least as large as the preview, and create the image and
+   * all its drawables at that level's size
+   */
+  info->level = 0;
+
+  if (info->preview_size > 0)
+    {
+      while ((MAX (width, height) >> (info->level + 1)) >= info->preview_size &&
+             (MIN (width, height) >> (info->level + 1)) > 0)
+        {
+          info->level++;
+        }
+    }
+
+  image = gimp_create_image (gimp,
+                             XCF_LEVEL_SIZE (width,  info->level),
+                             XCF_LEVEL_SIZE (height, info->level),
+                             image_type, precision,
                              FALSE);
 
   gimp_image_undo_disable (image);
@@ -195,7 +253,7 @@ xcf_load_image (Gimp     *gimp,
       GList     *item_path = NULL;
 
       /* read in the offset of the next layer */
-      info->cp += xcf_read_int32 (info->fp, &offset, 1);
+      info->cp += xcf_read_offset (info, &offset, 1);
 
       /* if the offset is 0 then we are at the end
        *  of the layer list.
@@ -279,7 +337,7 @@ xcf_load_image (Gimp     *gimp,
       GimpChannel *channel;
 
       /* read in the offset of the next channel */
-      info->cp += xcf_read_int32 (info->fp, &offset, 1);
+      info->cp += xcf_read_offset (info, &offset, 1);
 
       /* if the offset is 0 then we are at the end
        *  of the channel list.
@@ -511,8 +569,10 @@ xcf_load_image_props (XcfInfo   *info,
                 info->cp += xcf_read_int8 (info->fp,
                                            (guint8 *) &orientation, 1);
 
-                /*  skip -1 guides from old XCFs  */
-                if (position < 0)
+                /*  skip -1 guides from old XCFs, and all guides
+                 *  when loading a preview
+                 */
+                if (position < 0 || info->level > 0)
                   continue;
 
                 switch (orientation)
@@ -552,6 +612,9 @@ xcf_load_image_props (XcfInfo   *info,
                 info->cp += xcf_read_int32 (info->fp, (guint32 *) &x, 1);
                 info->cp += xcf_read_int32 (info->fp, (guint32 *) &y, 1);
 
+                if (info->level > 0)
+                  continue;
+
                 gimp_image_add_sample_point_at_pos (image, x, y, FALSE);
               }
           }
@@ -588,7 +651,7 @@ xcf_load_image_props (XcfInfo   *info,
 
         case PROP_PARASITES:
           {
-            glong base = info->cp;
+            goffset base = info->cp;
 
             while (info->cp - base < prop_size)
               {
@@ -684,7 +747,7 @@ xcf_load_image_props (XcfInfo   *info,
 
         case PROP_VECTORS:
           {
-            guint32 base = info->cp;
+            goffset base = info->cp;
 
             if (xcf_load_vectors (info, image))
               {
@@ -750,9 +813,8 @@ xcf_load_layer_props (XcfInfo    *info,
 
         case PROP_FLOATING_SELECTION:
           info->floating_sel = *layer;
-          info->cp +=
-            xcf_read_int32 (info->fp,
-                            (guint32 *) &info->floating_sel_offset, 1);
+          info->cp += xcf_read_offset (info,
+                                       &info->floating_sel_offset, 1);
           break;
 
         case PROP_OPACITY:
@@ -837,7 +899,9 @@ xcf_load_layer_props (XcfInfo    *info,
             info->cp += xcf_read_int32 (info->fp, &offset_x, 1);
             info->cp += xcf_read_int32 (info->fp, &offset_y, 1);
 
-            gimp_item_set_offset (GIMP_ITEM (*layer), offset_x, offset_y);
+            gimp_item_set_offset (GIMP_ITEM (*layer),
+                                  (gint32) offset_x >> info->level,
+                                  (gint32) offset_y >> info->level);
           }
           break;
 
@@ -861,7 +925,7 @@ xcf_load_layer_props (XcfInfo    *info,
 
         case PROP_PARASITES:
           {
-            glong base = info->cp;
+            goffset base = info->cp;
 
             while (info->cp - base < prop_size)
               {
@@ -902,7 +966,7 @@ xcf_load_layer_props (XcfInfo    *info,
 
         case PROP_ITEM_PATH:
           {
-            glong  base = info->cp;
+            goffset base = info->cp;
             GList *path = NULL;
 
             while (info->cp - base < prop_size)
@@ -1057,7 +1121,7 @@ xcf_load_channel_props (XcfInfo      *info,
 
         case PROP_PARASITES:
           {
-            glong base = info->cp;
+            goffset base = info->cp;
 
             while ((info->cp - base) < prop_size)
               {
@@ -1116,8 +1180,8 @@ xcf_load_layer (XcfInfo    *info,
 {
   GimpLayer         *layer;
   GimpLayerMask     *layer_mask;
-  guint32            hierarchy_offset;
-  guint32            layer_mask_offset;
+  goffset            hierarchy_offset;
+  goffset            layer_mask_offset;
   gboolean           apply_mask = TRUE;
   gboolean           edit_mask  = FALSE;
   gboolean           show_mask  = FALSE;
@@ -1189,7 +1253,9 @@ xcf_load_layer (XcfInfo    *info,
                                   has_alpha);
 
   /* create a new layer */
-  layer = gimp_layer_new (image, width, height,
+  layer = gimp_layer_new (image,
+                          XCF_LEVEL_SIZE (width,  info->level),
+                          XCF_LEVEL_SIZE (height, info->level),
                           format, name, 255, GIMP_NORMAL_MODE);
   g_free (name);
   if (! layer)
@@ -1219,8 +1285,8 @@ xcf_load_layer (XcfInfo    *info,
     }
 
   /* read the hierarchy and layer mask offsets */
-  info->cp += xcf_read_int32 (info->fp, &hierarchy_offset, 1);
-  info->cp += xcf_read_int32 (info->fp, &layer_mask_offset, 1);
+  info->cp += xcf_read_offset (info, &hierarchy_offset, 1);
+  info->cp += xcf_read_offset (info, &layer_mask_offset, 1);
 
   /* read in the hierarchy (ignore it for group layers, both as an
    * optimization and because the hierarchy's extents don't match
@@ -1231,8 +1297,7 @@ xcf_load_layer (XcfInfo    *info,
       if (! xcf_seek_pos (info, hierarchy_offset, NULL))
         goto error;
 
-      if (! xcf_load_buffer (info,
-                             gimp_drawable_get_buffer (GIMP_DRAWABLE (layer))))
+      if (! xcf_load_buffer (info, GIMP_DRAWABLE (layer)))
         goto error;
 
       xcf_progress_update (info);
@@ -1287,7 +1352,7 @@ xcf_load_channel (XcfInfo   *info,
                   GimpImage *image)
 {
   GimpChannel *channel;
-  guint32      hierarchy_offset;
+  goffset      hierarchy_offset;
   gint         width;
   gint         height;
   gboolean     is_fs_drawable;
@@ -1305,7 +1370,10 @@ xcf_load_channel (XcfInfo   *info,
   info->cp += xcf_read_string (info->fp, &name, 1);
 
   /* create a new channel */
-  channel = gimp_channel_new (image, width, height, name, &color);
+  channel = gimp_channel_new (image,
+                              XCF_LEVEL_SIZE (width,  info->level),
+                              XCF_LEVEL_SIZE (height, info->level),
+                              name, &color);
   g_free (name);
   if (!channel)
     return NULL;
@@ -1317,14 +1385,13 @@ xcf_load_channel (XcfInfo   *info,
   xcf_progress_update (info);
 
   /* read the hierarchy and layer mask offsets */
-  info->cp += xcf_read_int32 (info->fp, &hierarchy_offset, 1);
+  info->cp += xcf_read_offset (info, &hierarchy_offset, 1);
 
   /* read in the hierarchy */
   if (!xcf_seek_pos (info, hierarchy_offset, NULL))
     goto error;
 
-  if (!xcf_load_buffer (info,
-                        gimp_drawable_get_buffer (GIMP_DRAWABLE (channel))))
+  if (!xcf_load_buffer (info, GIMP_DRAWABLE (channel)))
     goto error;
 
   xcf_progress_update (info);
@@ -1345,7 +1412,7 @@ xcf_load_layer_mask (XcfInfo   *info,
 {
   GimpLayerMask *layer_mask;
   GimpChannel   *channel;
-  guint32        hierarchy_offset;
+  goffset        hierarchy_offset;
   gint           width;
   gint           height;
   gboolean       is_fs_drawable;
@@ -1363,7 +1430,10 @@ xcf_load_layer_mask (XcfInfo   *info,
   info->cp += xcf_read_string (info->fp, &name, 1);
 
   /* create a new layer mask */
-  layer_mask = gimp_layer_mask_new (image, width, height, name, &color);
+  layer_mask = gimp_layer_mask_new (image,
+                                    XCF_LEVEL_SIZE (width,  info->level),
+                                    XCF_LEVEL_SIZE (height, info->level),
+                                    name, &color);
   g_free (name);
   if (!layer_mask)
     return NULL;
@@ -1376,14 +1446,13 @@ xcf_load_layer_mask (XcfInfo   *info,
   xcf_progress_update (info);
 
   /* read the hierarchy and layer mask offsets */
-  info->cp += xcf_read_int32 (info->fp, &hierarchy_offset, 1);
+  info->cp += xcf_read_offset (info, &hierarchy_offset, 1);
 
   /* read in the hierarchy */
   if (! xcf_seek_pos (info, hierarchy_offset, NULL))
     goto error;
 
-  if (!xcf_load_buffer (info,
-                        gimp_drawable_get_buffer (GIMP_DRAWABLE (layer_mask))))
+  if (!xcf_load_buffer (info, GIMP_DRAWABLE (layer_mask)))
     goto error;
 
   xcf_progress_update (info);
@@ -1400,16 +1469,21 @@ xcf_load_layer_mask (XcfInfo   *info,
 }
 
 static gboolean
-xcf_load_buffer (XcfInfo    *info,
-                 GeglBuffer *buffer)
+xcf_load_buffer (XcfInfo      *info,
+                 GimpDrawable *drawable)
 {
+  GeglBuffer *buffer = gimp_drawable_get_buffer (drawable);
   const Babl *format;
-  guint32     saved_pos;
-  guint32     offset;
-  guint32     junk;
+  GeglBuffer *level_buffer;
+  goffset     saved_pos;
+  GArray     *offsets;
+  goffset     offset;
   gint        width;
   gint        height;
   gint        bpp;
+  gint        level;
+  gint        i;
+  gboolean    success;
 
   format = gegl_buffer_get_format (buffer);
 
@@ -1420,43 +1494,130 @@ xcf_load_buffer (XcfInfo    *info,
   /* make sure the values in the file correspond to the values
    *  calculated when the TileManager was created.
    */
-  if (width  != gegl_buffer_get_width (buffer)  ||
-      height != gegl_buffer_get_height (buffer) ||
-      bpp    != babl_format_get_bytes_per_pixel (format))
+  if (XCF_LEVEL_SIZE (width,  info->level) != gegl_buffer_get_width (buffer)  ||
+      XCF_LEVEL_SIZE (height, info->level) != gegl_buffer_get_height (buffer) ||
+      bpp != babl_format_get_bytes_per_pixel (format))
     return FALSE;
 
-  /* load in the levels...we make sure that the number of levels
-   *  calculated when the TileManager was created is the same
-   *  as the number of levels found in the file.
+  /* read the offsets of all levels, followed by the terminating '0'
    */
+  offsets = g_array_new (FALSE, FALSE, sizeof (goffset));
 
-  info->cp += xcf_read_int32 (info->fp, &offset, 1); /* top level */
-
-  /* discard offsets for layers below first, if any.
-   */
   do
     {
-      info->cp += xcf_read_int32 (info->fp, &junk, 1);
+      info->cp += xcf_read_offset (info, &offset, 1);
+
+      if (offset != 0)
+        g_array_append_val (offsets, offset);
+    }
+  while (offset != 0);
+
+  if (offsets->len == 0)
+    {
+      g_array_free (offsets, TRUE);
+      return FALSE;
     }
-  while (junk != 0);
 
   /* save the current position as it is where the
    *  next level offset is stored.
    */
   saved_pos = info->cp;
 
+  /* find the level closest to the requested one which actually
+   *  contains pixels, files written by older versions only have
+   *  pixels in the first level and fake all others.
+   */
+  for (level = MIN (info->level, (gint) offsets->len - 1); level > 0; level--)
+    {
+      gint    level_width;
+      gint    level_height;
+      goffset tile_offset;
+
+      if (! xcf_seek_pos (info, g_array_index (offsets, goffset, level), NULL))
+        {
+          g_array_free (offsets, TRUE);
+          return FALSE;
+        }
+
+      info->cp += xcf_read_int32 (info->fp, (guint32 *) &level_width, 1);
+      info->cp += xcf_read_int32 (info->fp, (guint32 *) &level_height, 1);
+      info->cp += xcf_read_offset (info, &tile_offset, 1);
+
+      if (level_width  == width  >> level &&
+          level_height == height >> level &&
+          level_width > 0 && level_height > 0 && tile_offset != 0)
+        break;
+    }
+
   /* seek to the level offset */
-  if (!xcf_seek_pos (info, offset, NULL))
-    return FALSE;
+  if (! xcf_seek_pos (info, g_array_index (offsets, goffset, level), NULL))
+    {
+      g_array_free (offsets, TRUE);
+      return FALSE;
+    }
+
+  g_array_free (offsets, TRUE);
+
+  /* when loading lazily, the tiles of the full-size level are only
+   *  decoded when they are first used.
+   */
+  if (info->mapped_file && level == 0 && info->level == 0)
+    {
+      if (! xcf_load_level (info, buffer, drawable))
+        return FALSE;
+
+      return xcf_seek_pos (info, saved_pos, NULL);
+    }
 
-  /* read in the level */
-  if (!xcf_load_level (info, buffer))
+  /* read in the level, if it's not the requested one, read it into
+   *  a temporary buffer and halve it until it has the right size.
+   */
+  if (level == info->level)
+    {
+      level_buffer = g_object_ref (buffer);
+    }
+  else
+    {
+      level_buffer =
+        gegl_buffer_new (GEGL_RECTANGLE (0, 0,
+                                         XCF_LEVEL_SIZE (width,  level),
+                                         XCF_LEVEL_SIZE (height, level)),
+                         format);
+    }
+
+  success = xcf_load_level (info, level_buffer, NULL);
+
+  for (i = level + 1; success && i <= info->level; i++)
+    {
+      GeglBuffer *prev_buffer = level_buffer;
+
+      if (i == info->level)
+        {
+          level_buffer = g_object_ref (buffer);
+        }
+      else
+        {
+          level_buffer =
+            gegl_buffer_new (GEGL_RECTANGLE (0, 0,
+                                             XCF_LEVEL_SIZE (width,  i),
+                                             XCF_LEVEL_SIZE (height, i)),
+                             format);
+        }
+
+      gimp_gegl_downsample (prev_buffer, level_buffer);
+
+      g_object_unref (prev_buffer);
+    }
+
+  g_object_unref (level_buffer);
+
+  if (! success)
     return FALSE;
 
   /* restore the saved position so we'll be ready to
    *  read the next offset.
    */
-  if (!xcf_seek_pos (info, saved_pos, NULL))
+  if (! xcf_seek_pos (info, saved_pos, NULL))
     return FALSE;
 
   return TRUE;
@@ -1464,20 +1625,28 @@ xcf_load_buffer (XcfInfo    *info,
 
 
 static gboolean
-xcf_load_level (XcfInfo    *info,
-                GeglBuffer *buffer)
+xcf_load_level (XcfInfo      *info,
+                GeglBuffer   *buffer,
+                GimpDrawable *lazy_drawable)
 {
-  const Babl *format;
-  gint        bpp;
-  guint32     saved_pos;
-  guint32     offset, offset2;
-  gint        n_tile_rows;
-  gint        n_tile_cols;
-  guint       ntiles;
-  gint        width;
-  gint        height;
-  gint        i;
-  gint        fail;
+  const Babl       *format;
+  XcfLoadTilesData  data;
+  XcfLoadTile      *tiles;
+  gint              bpp;
+  goffset           saved_pos;
+  goffset          *offsets;
+  gint              n_tile_rows;
+  gint              n_tile_cols;
+  guint             ntiles;
+  gint              n_batch;
+  gsize             max_tile_size;
+  gsize             max_xcf_size;
+  guchar           *tile_data;
+  guchar           *xcf_data;
+  gint              width;
+  gint              height;
+  gint              i, j;
+  gboolean          success = TRUE;
 
   format = gegl_buffer_get_format (buffer);
   bpp    = babl_format_get_bytes_per_pixel (format);
@@ -1489,160 +1658,261 @@ xcf_load_level (XcfInfo    *info,
       height != gegl_buffer_get_height (buffer))
     return FALSE;
 
-  /* read in the first tile offset.
-   *  if it is '0', then this tile level is empty
-   *  and we can simply return.
-   */
-  info->cp += xcf_read_int32 (info->fp, &offset, 1);
-  if (offset == 0)
-    return TRUE;
-
   n_tile_rows = gimp_gegl_buffer_get_n_tile_rows (buffer, XCF_TILE_HEIGHT);
   n_tile_cols = gimp_gegl_buffer_get_n_tile_cols (buffer, XCF_TILE_WIDTH);
 
   ntiles = n_tile_rows * n_tile_cols;
-  for (i = 0; i < ntiles; i++)
+
+  /* read in the tile offsets, followed by the terminating '0'.
+   *  if the first offset is '0', then this tile level is empty
+   *  and we can simply return.
+   */
+  offsets = g_new (goffset, ntiles + 1);
+
+  info->cp += xcf_read_offset (info, &offsets[0], 1);
+  if (offsets[0] == 0)
     {
-      GeglRectangle rect;
+      g_free (offsets);
+      return TRUE;
+    }
 
-      fail = FALSE;
+  for (i = 1; i <= ntiles; i++)
+    {
+      info->cp += xcf_read_offset (info, &offsets[i], 1);
 
-      if (offset == 0)
-        {
-          gimp_message_literal (info->gimp, G_OBJECT (info->progress),
-				GIMP_MESSAGE_ERROR,
-				"not enough tiles found in level");
-          return FALSE;
-        }
+      if (offsets[i] == 0)
+        break;
+    }
 
-      /* save the current position as it is where the
-       *  next tile offset is stored.
-       */
-      saved_pos = info->cp;
+  if (i < ntiles)
+    {
+      gimp_message_literal (info->gimp, G_OBJECT (info->progress),
+                            GIMP_MESSAGE_ERROR,
+                            "not enough tiles found in level");
+      g_free (offsets);
+      return FALSE;
+    }
 
-      /* read in the offset of the next tile so we can calculate the amount
-         of data needed for this tile*/
-      info->cp += xcf_read_int32 (info->fp, &offset2, 1);
+  if (offsets[ntiles] != 0)
+    {
+      gimp_message (info->gimp, G_OBJECT (info->progress), GIMP_MESSAGE_ERROR,
+                    "encountered garbage after reading level: %" G_GOFFSET_FORMAT,
+                    offsets[ntiles]);
+      g_free (offsets);
+      return FALSE;
+    }
 
-      /* if the offset is 0 then we need to read in the maximum possible
-         allowing for negative compression */
-      if (offset2 == 0)
-        offset2 = offset + XCF_TILE_WIDTH * XCF_TILE_WIDTH * bpp * 1.5;
-                                        /* 1.5 is probably more
-                                           than we need to allow */
+  /* only keep the offsets, the new buffer's backend decodes the
+   *  tiles from the mapped file when they are first accessed.
+   */
+  if (lazy_drawable)
+    {
+      GeglTileBackend *backend;
+      GeglBuffer      *lazy_buffer;
 
-      /* seek to the tile offset */
-      if (! xcf_seek_pos (info, offset, NULL))
-        return FALSE;
+      backend = gimp_tile_backend_xcf_new (info->gimp, info->mapped_file,
+                                           info->filename,
+                                           info->compression, format,
+                                           width, height, offsets);
+
+      lazy_buffer = gegl_buffer_new_for_backend (NULL, backend);
+      g_object_unref (backend);
 
-      /* get the tile from the tile manager */
-      gimp_gegl_buffer_get_tile_rect (buffer,
-                                      XCF_TILE_WIDTH, XCF_TILE_HEIGHT,
-                                      i, &rect);
+      gimp_drawable_set_buffer (lazy_drawable, FALSE, NULL, lazy_buffer);
+      g_object_unref (lazy_buffer);
 
-      /* read in the tile */
-      switch (info->compression)
+      return TRUE;
+    }
+
+  saved_pos = info->cp;
+
+  /*  the compressed tiles are read in batches, each tile can be
+   *  decompressed independently so that's done in parallel, the
+   *  pixels are then stored in the buffer in tile order.
+   */
+  n_batch = MIN (ntiles,
+                 gimp_parallel_get_n_threads () * XCF_LOAD_TILES_PER_THREAD);
+
+  /* allow for negative compression, 1.5 is probably more than we
+   *  need for rle, compressBound() is what zlib needs.
+   */
+  max_tile_size = XCF_TILE_WIDTH * XCF_TILE_HEIGHT * bpp;
+  max_xcf_size  = MAX (max_tile_size * 3 / 2,
+                       compressBound (max_tile_size));
+
+  tiles     = g_new0 (XcfLoadTile, n_batch);
+  tile_data = g_malloc (n_batch * max_tile_size);
+  xcf_data  = g_malloc (n_batch * max_xcf_size);
+
+  for (j = 0; j < n_batch; j++)
+    {
+      tiles[j].data     = tile_data + j * max_tile_size;
+      tiles[j].xcf_data = xcf_data  + j * max_xcf_size;
+    }
+
+  data.info  = info;
+  data.tiles = tiles;
+  data.bpp   = bpp;
+
+  for (i = 0; success && i < ntiles; i += n_batch)
+    {
+      gint n = MIN (n_batch, ntiles - i);
+
+      for (j = 0; j < n; j++)
         {
-        case COMPRESS_NONE:
-          if (!xcf_load_tile (info, buffer, &rect, format))
-            fail = TRUE;
-          break;
-        case COMPRESS_RLE:
-          if (!xcf_load_tile_rle (info, buffer, &rect, format,
-                                  offset2 - offset))
-            fail = TRUE;
-          break;
-        case COMPRESS_ZLIB:
-          g_error ("xcf: zlib compression unimplemented");
-          fail = TRUE;
-          break;
-        case COMPRESS_FRACTAL:
-          g_error ("xcf: fractal compression unimplemented");
-          fail = TRUE;
-          break;
+          XcfLoadTile *tile = &tiles[j];
+          goffset      offset  = offsets[i + j];
+          goffset      offset2 = offsets[i + j + 1];
+          gsize        data_length;
+
+          gimp_gegl_buffer_get_tile_rect (buffer,
+                                          XCF_TILE_WIDTH, XCF_TILE_HEIGHT,
+                                          i + j, &tile->rect);
+
+          /* if the next offset is 0 then we need to read in the
+           *  maximum possible amount of data
+           */
+          if (offset2 == 0)
+            data_length = max_xcf_size;
+          else if (offset2 > offset)
+            data_length = MIN (offset2 - offset, max_xcf_size);
+          else
+            data_length = 0;
+
+          if (info->compression == COMPRESS_NONE)
+            data_length = tile->rect.width * tile->rect.height * bpp;
+
+          /* Workaround for bug #357809: avoid crashing on g_malloc() and
+           * skip this tile as if it did not contain any data.  It is
+           * better than failing, which would skip the whole hierarchy
+           * while there may still be some valid tiles in the file.
+           */
+          tile->skip = (data_length == 0);
+
+          if (tile->skip)
+            continue;
+
+          if (! xcf_seek_pos (info, offset, NULL))
+            {
+              success = FALSE;
+              break;
+            }
+
+          /* we have to use fread instead of xcf_read_* because we may be
+           * reading past the end of the file here
+           */
+          tile->xcf_size = fread (tile->xcf_data, sizeof (guchar),
+                                  data_length, info->fp);
+          info->cp += tile->xcf_size;
         }
 
-      if (fail)
-        return FALSE;
+      if (! success)
+        break;
 
-      /* restore the saved position so we'll be ready to
-       *  read the next offset.
-       */
-      if (!xcf_seek_pos (info, saved_pos, NULL))
-        return FALSE;
+      gimp_parallel_distribute_range (n, 1, xcf_load_decode_tiles, &data);
+
+      for (j = 0; j < n; j++)
+        {
+          XcfLoadTile *tile = &tiles[j];
+
+          if (tile->skip)
+            continue;
+
+          if (tile->failed)
+            {
+              success = FALSE;
+              break;
+            }
 
-      /* read in the offset of the next tile */
-      info->cp += xcf_read_int32 (info->fp, &offset, 1);
+          gegl_buffer_set (buffer, &tile->rect, 0, format, tile->data,
+                           GEGL_AUTO_ROWSTRIDE);
+        }
     }
 
-  if (offset != 0)
+  g_free (xcf_data);
+  g_free (tile_data);
+  g_free (tiles);
+  g_free (offsets);
+
+  /* restore the position after the tile offsets
+   */
+  if (success && ! xcf_seek_pos (info, saved_pos, NULL))
+    return FALSE;
+
+  return success;
+}
+
+static void
+xcf_load_decode_tiles (gsize    offset,
+                       gsize    size,
+                       gpointer user_data)
+{
+  XcfLoadTilesData *data = user_data;
+  gsize             i;
+
+  for (i = offset; i < offset + size; i++)
     {
-      gimp_message (info->gimp, G_OBJECT (info->progress), GIMP_MESSAGE_ERROR,
-                    "encountered garbage after reading level: %d", offset);
-      return FALSE;
-    }
+      XcfLoadTile *tile     = &data->tiles[i];
+      gint         n_pixels = tile->rect.width * tile->rect.height;
 
-  return TRUE;
+      if (tile->skip)
+        continue;
+
+      tile->failed = ! xcf_load_tile_data (data->info->compression,
+                                           tile->xcf_data, tile->xcf_size,
+                                           tile->data, n_pixels, data->bpp);
+    }
 }
 
-static gboolean
-xcf_load_tile (XcfInfo       *info,
-               GeglBuffer    *buffer,
-               GeglRectangle *tile_rect,
-               const Babl    *format)
+gboolean
+xcf_load_tile_data (XcfCompressionType  compression,
+                    const guchar       *xcf_data,
+                    gsize               xcf_size,
+                    guchar             *tile_data,
+                    gint                n_pixels,
+                    gint                bpp)
 {
-  gint    bpp       = babl_format_get_bytes_per_pixel (format);
-  gint    tile_size = bpp * tile_rect->width * tile_rect->height;
-  guchar *tile_data = g_alloca (tile_size);
+  gsize tile_size = (gsize) n_pixels * bpp;
 
-  info->cp += xcf_read_int8 (info->fp, tile_data, tile_size);
+  switch (compression)
+    {
+    case COMPRESS_NONE:
+      memcpy (tile_data, xcf_data, MIN (tile_size, xcf_size));
+      return TRUE;
 
-  gegl_buffer_set (buffer, tile_rect, 0, format, tile_data,
-                   GEGL_AUTO_ROWSTRIDE);
+    case COMPRESS_RLE:
+      return xcf_load_tile_rle (xcf_data, xcf_size, tile_data, n_pixels, bpp);
 
-  return TRUE;
+    case COMPRESS_ZLIB:
+      return xcf_load_tile_zlib (xcf_data, xcf_size, tile_data, tile_size);
+
+    case COMPRESS_FRACTAL:
+      g_error ("xcf: fractal compression unimplemented");
+      break;
+    }
+
+  return FALSE;
 }
 
 static gboolean
-xcf_load_tile_rle (XcfInfo       *info,
-                   GeglBuffer    *buffer,
-                   GeglRectangle *tile_rect,
-                   const Babl    *format,
-                   gint           data_length)
+xcf_load_tile_rle (const guchar *xcfdata,
+                   gsize         data_length,
+                   guchar       *tile_data,
+                   gint          n_pixels,
+                   gint          bpp)
 {
-  gint    bpp       = babl_format_get_bytes_per_pixel (format);
-  gint    tile_size = bpp * tile_rect->width * tile_rect->height;
-  guchar *tile_data = g_alloca (tile_size);
-  gint    i;
-  gint    nmemb_read_successfully;
-  guchar *xcfdata;
-  guchar *xcfodata;
-  guchar *xcfdatalimit;
-
-  /* Workaround for bug #357809: avoid crashing on g_malloc() and skip
-   * this tile (return TRUE without storing data) as if it did not
-   * contain any data.  It is better than returning FALSE, which would
-   * skip the whole hierarchy while there may still be some valid
-   * tiles in the file.
-   */
-  if (data_length <= 0)
-    return TRUE;
-
-  xcfdata = xcfodata = g_alloca (data_length);
+  const guchar *xcfdatalimit;
+  gint          i;
 
-  /* we have to use fread instead of xcf_read_* because we may be
-   * reading past the end of the file here
-   */
-  nmemb_read_successfully = fread ((gchar *) xcfdata, sizeof (gchar),
-                                   data_length, info->fp);
-  info->cp += nmemb_read_successfully;
+  if (data_length == 0)
+    return FALSE;
 
-  xcfdatalimit = &xcfodata[nmemb_read_successfully - 1];
+  xcfdatalimit = &xcfdata[data_length - 1];
 
   for (i = 0; i < bpp; i++)
     {
       guchar *data  = tile_data + i;
-      gint    size  = tile_rect->width * tile_rect->height;
+      gint    size  = n_pixels;
       gint    count = 0;
       guchar  val;
       gint    length;
@@ -1729,15 +1999,29 @@ xcf_load_tile_rle (XcfInfo       *info,
         }
     }
 
-  gegl_buffer_set (buffer, tile_rect, 0, format, tile_data,
-                   GEGL_AUTO_ROWSTRIDE);
-
   return TRUE;
 
  bogus_rle:
   return FALSE;
 }
 
+static gboolean
+xcf_load_tile_zlib (const guchar *xcfdata,
+                    gsize         data_length,
+                    guchar       *tile_data,
+                    gsize         tile_size)
+{
+  uLongf dest_len = tile_size;
+
+  /* the data of the last tile may be followed by other data, which
+   *  uncompress() ignores once it found the end of the stream.
+   */
+  if (uncompress (tile_data, &dest_len, xcfdata, data_length) != Z_OK)
+    return FALSE;
+
+  return (dest_len == tile_size);
+}
+
 static GimpParasite *
 xcf_load_parasite (XcfInfo *info)
 {
@@ -2106,3 +2390,34 @@ xcf_skip_unknown_prop (XcfInfo *info,
 
   return TRUE;
 }
+
+static guint
+xcf_read_offset (XcfInfo *info,
+                 goffset *offsets,
+                 gint     count)
+{
+  guint total = 0;
+  gint  i;
+
+  for (i = 0; i < count; i++)
+    {
+      if (XCF_OFFSET_SIZE (info) == 8)
+        {
+          guint64 offset = 0;
+
+          total += xcf_read_int64 (info->fp, &offset, 1);
+
+          offsets[i] = offset;
+        }
+      else
+        {
+          guint32 offset = 0;
+
+          total += xcf_read_int32 (info->fp, &offset, 1);
+
+          offsets[i] = offset;
+        }
+    }
+
+  return total;
+}
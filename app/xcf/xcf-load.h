@@ -19,9 +19,16 @@
 #define __XCF_LOAD_H__
 
 
-GimpImage * xcf_load_image (Gimp     *gimp,
-                            XcfInfo  *info,
-                            GError  **error);
+GimpImage * xcf_load_image     (Gimp               *gimp,
+                                XcfInfo            *info,
+                                GError            **error);
+
+gboolean    xcf_load_tile_data (XcfCompressionType  compression,
+                                const guchar       *xcf_data,
+                                gsize               xcf_size,
+                                guchar             *tile_data,
+                                gint                n_pixels,
+                                gint                bpp);
 
 
 #endif  /* __XCF_LOAD_H__ */
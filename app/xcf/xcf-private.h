@@ -22,6 +22,17 @@
 #define XCF_TILE_WIDTH  64
 #define XCF_TILE_HEIGHT 64
 
+/*  hierarchy, level, tile and other offsets are 64 bits wide since
+ *  version 6, so files can grow beyond 4 GB
+ */
+#define XCF_OFFSET_SIZE(info) ((info)->file_version >= 6 ? 8 : 4)
+
+/*  every hierarchy level halves the size of the previous one, when
+ *  loading a preview, drawables are created at the size of the level
+ *  they are loaded from
+ */
+#define XCF_LEVEL_SIZE(size, level) MAX ((size) >> (level), 1)
+
 typedef enum
 {
   PROP_END                =  0,
@@ -63,7 +74,7 @@ typedef enum
 {
   COMPRESS_NONE              =  0,
   COMPRESS_RLE               =  1,
-  COMPRESS_ZLIB              =  2,  /* unused */
+  COMPRESS_ZLIB              =  2,
   COMPRESS_FRACTAL           =  3   /* unused */
 } XcfCompressionType;
 
@@ -91,18 +102,25 @@ struct _XcfInfo
   Gimp               *gimp;
   GimpProgress       *progress;
   FILE               *fp;
-  guint               cp;
+  GMappedFile        *mapped_file;
+  goffset             cp;
   const gchar        *filename;
   GimpTattoo          tattoo_state;
   GimpLayer          *active_layer;
   GimpChannel        *active_channel;
   GimpDrawable       *floating_sel_drawable;
   GimpLayer          *floating_sel;
-  guint               floating_sel_offset;
+  goffset             floating_sel_offset;
   gint                swap_num;
   gint               *ref_count;
   XcfCompressionType  compression;
+  gint                compression_level;
+  gboolean            save_levels;
   gint                file_version;
+  gint                preview_size;
+  gint                level;
+  gint                image_width;
+  gint                image_height;
 };
 
 
@@ -50,6 +50,27 @@ xcf_read_int32 (FILE    *fp,
   return total;
 }
 
+guint
+xcf_read_int64 (FILE    *fp,
+                guint64 *data,
+                gint     count)
+{
+  guint total = 0;
+
+  if (count > 0)
+    {
+      total += xcf_read_int8 (fp, (guint8 *) data, count * 8);
+
+      while (count--)
+        {
+          *data = GUINT64_FROM_BE (*data);
+          data++;
+        }
+    }
+
+  return total;
+}
+
 guint
 xcf_read_float (FILE   *fp,
                 gfloat *data,
@@ -23,6 +23,7 @@
 #include <cairo.h>
 #include <gegl.h>
 #include <gdk-pixbuf/gdk-pixbuf.h>
+#include <zlib.h>
 
 #include "libgimpbase/gimpbase.h"
 #include "libgimpcolor/gimpcolor.h"
@@ -30,9 +31,11 @@
 #include "core/core-types.h"
 
 #include "gegl/gimp-babl-compat.h"
+#include "gegl/gimp-gegl-loops.h"
 #include "gegl/gimp-gegl-tile-compat.h"
 
 #include "core/gimp.h"
+#include "core/gimp-parallel.h"
 #include "core/gimpcontainer.h"
 #include "core/gimpchannel.h"
 #include "core/gimpdrawable.h"
@@ -68,6 +71,9 @@
 #include "gimp-intl.h"
 
 
+static guint64  xcf_save_estimate_size (GimpImage         *image);
+static guint64  xcf_save_drawable_size (GimpDrawable      *drawable);
+
 static gboolean xcf_save_image_props   (XcfInfo           *info,
                                         GimpImage         *image,
                                         GError           **error);
@@ -98,17 +104,18 @@ static gboolean xcf_save_buffer        (XcfInfo           *info,
 static gboolean xcf_save_level         (XcfInfo           *info,
                                         GeglBuffer        *buffer,
                                         GError           **error);
-static gboolean xcf_save_tile          (XcfInfo           *info,
-                                        GeglBuffer        *buffer,
-                                        GeglRectangle     *tile_rect,
-                                        const Babl        *format,
-                                        GError           **error);
-static gboolean xcf_save_tile_rle      (XcfInfo           *info,
-                                        GeglBuffer        *buffer,
-                                        GeglRectangle     *tile_rect,
-                                        const Babl        *format,
-                                        guchar            *rlebuf,
-                                        GError           **error);
+static void     xcf_save_encode_tiles  (gsize              offset,
+                                        gsize              size,
+                                        gpointer           user_data);
+static gsize    xcf_save_tile_rle      (const guchar      *tile_data,
+                                        gint               n_pixels,
+                                        gint               bpp,
+                                        guchar            *rlebuf);
+static gboolean xcf_save_tile_zlib     (const guchar      *tile_data,
+                                        gsize              tile_size,
+                                        gint               level,
+                                        guchar            *zlibbuf,
+                                        gsize             *zlibbuf_size);
 static gboolean xcf_save_parasite      (XcfInfo           *info,
                                         GimpParasite      *parasite,
                                         GError           **error);
@@ -122,6 +129,36 @@ static gboolean xcf_save_vectors       (XcfInfo           *info,
                                         GimpImage         *image,
                                         GError           **error);
 
+static guint    xcf_write_offset       (XcfInfo           *info,
+                                        const goffset     *offsets,
+                                        gint               count,
+                                        GError           **error);
+
+
+/*  the number of tiles per thread which are fetched and compressed
+ *  before they are written out in one go
+ */
+#define XCF_SAVE_TILES_PER_THREAD 8
+
+
+typedef struct _XcfSaveTile XcfSaveTile;
+
+struct _XcfSaveTile
+{
+  GeglRectangle  rect;
+  guchar        *data;      /* the pixels of the tile                 */
+  guchar        *xcf_data;  /* the tile's data as written to the file */
+  gsize          xcf_size;
+  gboolean       failed;
+};
+
+typedef struct
+{
+  XcfInfo     *info;
+  XcfSaveTile *tiles;
+  gint         bpp;
+} XcfSaveTilesData;
+
 
 /* private convenience macros */
 #define xcf_write_int32_check_error(info, data, count) G_STMT_START { \
@@ -142,6 +179,15 @@ static gboolean xcf_save_vectors       (XcfInfo           *info,
     }                                                             \
   } G_STMT_END
 
+#define xcf_write_offset_check_error(info, data, count) G_STMT_START { \
+  info->cp += xcf_write_offset (info, data, count, &tmp_error); \
+  if (tmp_error)                                                \
+    {                                                           \
+      g_propagate_error (error, tmp_error);                     \
+      return FALSE;                                             \
+    }                                                           \
+  } G_STMT_END
+
 #define xcf_write_float_check_error(info, data, count) G_STMT_START { \
   info->cp += xcf_write_float (info->fp, data, count, &tmp_error); \
   if (tmp_error)                                                   \
@@ -218,9 +264,93 @@ xcf_save_choose_format (XcfInfo   *info,
   if (gimp_image_get_precision (image) != GIMP_PRECISION_U8)
     save_version = MAX (4, save_version);
 
+  /* need version 5 for zlib compression */
+  if (info->compression == COMPRESS_ZLIB)
+    save_version = MAX (5, save_version);
+
+  /* need version 6 for 64 bit offsets, if any offset might not fit
+   * into 32 bits.  Creating an image that big is too slow for the
+   * tests, they can ask for version 6 through the environment
+   */
+  if (xcf_save_estimate_size (image) > G_MAXUINT32 ||
+      g_getenv ("GIMP_TESTING_XCF_64BIT_OFFSETS"))
+    save_version = MAX (6, save_version);
+
   info->file_version = save_version;
 }
 
+/*  Returns an upper bound of the size of the XCF file @image is saved
+ *  to.  The memory size of the image is no such bound, compression can
+ *  make tiles larger than their pixels, the stored levels add another
+ *  third, and tiles shared with other drawables only count partially.
+ */
+static guint64
+xcf_save_estimate_size (GimpImage *image)
+{
+  GimpImagePrivate *private = GIMP_IMAGE_GET_PRIVATE (image);
+  GList            *all_layers;
+  GList            *all_channels;
+  GList            *list;
+  guint64           size;
+
+  /* the header, image properties and parasites, and the paths */
+  size = 4096 +
+         gimp_object_get_memsize (GIMP_OBJECT (private->parasites), NULL) +
+         gimp_object_get_memsize (GIMP_OBJECT (private->vectors),   NULL);
+
+  all_layers   = gimp_image_get_layer_list (image);
+  all_channels = gimp_image_get_channel_list (image);
+
+  for (list = all_layers; list; list = g_list_next (list))
+    {
+      GimpLayer *layer = list->data;
+
+      size += xcf_save_drawable_size (GIMP_DRAWABLE (layer));
+
+      if (gimp_layer_get_mask (layer))
+        size += xcf_save_drawable_size (GIMP_DRAWABLE (gimp_layer_get_mask (layer)));
+    }
+
+  for (list = all_channels; list; list = g_list_next (list))
+    size += xcf_save_drawable_size (GIMP_DRAWABLE (list->data));
+
+  size += xcf_save_drawable_size (GIMP_DRAWABLE (gimp_image_get_mask (image)));
+
+  g_list_free (all_layers);
+  g_list_free (all_channels);
+
+  return size;
+}
+
+static guint64
+xcf_save_drawable_size (GimpDrawable *drawable)
+{
+  GimpItem *item   = GIMP_ITEM (drawable);
+  guint64   width  = gimp_item_get_width  (item);
+  guint64   height = gimp_item_get_height (item);
+  guint64   bpp;
+  guint64   n_tiles;
+  guint64   size;
+
+  bpp = babl_format_get_bytes_per_pixel (gimp_drawable_get_format (drawable));
+
+  n_tiles = ((width  + XCF_TILE_WIDTH  - 1) / XCF_TILE_WIDTH) *
+            ((height + XCF_TILE_HEIGHT - 1) / XCF_TILE_HEIGHT);
+
+  /* RLE expands incompressible tiles by up to half, and the stored
+   * levels add up to a third of the first level's tiles and pixels
+   */
+  size = width * height * bpp * 3 / 2 * 4 / 3;
+
+  /* the tile offsets and per-level headers, the drawable's properties */
+  size += (n_tiles * 4 / 3 + 64) * 8 + 4096;
+
+  size += gimp_object_get_memsize (GIMP_OBJECT (gimp_item_get_parasites (item)),
+                                   NULL);
+
+  return size;
+}
+
 gint
 xcf_save_image (XcfInfo    *info,
                 GimpImage  *image,
@@ -229,11 +359,12 @@ xcf_save_image (XcfInfo    *info,
   GList   *all_layers;
   GList   *all_channels;
   GList   *list;
-  guint32  saved_pos;
-  guint32  offset;
+  goffset  saved_pos;
+  goffset *offsets;
   guint32  value;
   guint    n_layers;
   guint    n_channels;
+  guint    i;
   guint    progress = 0;
   guint    max_progress;
   gint     t1, t2, t3, t4;
@@ -296,92 +427,79 @@ xcf_save_image (XcfInfo    *info,
    */
   saved_pos = info->cp;
 
-  /* seek to after the offset lists */
+  /* seek to after the offset lists, they are written out in one
+   *  go once all layers and channels are saved.
+   */
   xcf_check_error (xcf_seek_pos (info,
-                                 info->cp + (n_layers + n_channels + 2) * 4,
+                                 info->cp + (n_layers + n_channels + 2) *
+                                 XCF_OFFSET_SIZE (info),
                                  error));
 
-  for (list = all_layers; list; list = g_list_next (list))
+  /* the layer offsets and the channel offsets are each followed by
+   *  a '0' offset position to indicate the end of the list.
+   */
+  offsets = g_new0 (goffset, n_layers + n_channels + 2);
+
+  for (list = all_layers, i = 0; list; list = g_list_next (list), i++)
     {
       GimpLayer *layer = list->data;
 
       /* save the start offset of where we are writing
        *  out the next layer.
        */
-      offset = info->cp;
+      offsets[i] = info->cp;
 
       /* write out the layer. */
-      xcf_check_error (xcf_save_layer (info, image, layer, error));
+      if (! xcf_save_layer (info, image, layer, error) ||
+          ! xcf_seek_end (info, error))
+        {
+          g_free (offsets);
+          return FALSE;
+        }
 
       xcf_progress_update (info);
-
-      /* seek back to where we are to write out the next
-       *  layer offset and write it out.
-       */
-      xcf_check_error (xcf_seek_pos (info, saved_pos, error));
-      xcf_write_int32_check_error (info, &offset, 1);
-
-      /* increment the location we are to write out the
-       *  next offset.
-       */
-      saved_pos = info->cp;
-
-      /* seek to the end of the file which is where
-       *  we will write out the next layer.
-       */
-      xcf_check_error (xcf_seek_end (info, error));
     }
 
-  /* write out a '0' offset position to indicate the end
-   *  of the layer offsets.
-   */
-  offset = 0;
-  xcf_check_error (xcf_seek_pos (info, saved_pos, error));
-  xcf_write_int32_check_error (info, &offset, 1);
-  saved_pos = info->cp;
-  xcf_check_error (xcf_seek_end (info, error));
-
-  for (list = all_channels; list; list = g_list_next (list))
+  for (list = all_channels, i++; list; list = g_list_next (list), i++)
     {
       GimpChannel *channel = list->data;
 
       /* save the start offset of where we are writing
        *  out the next channel.
        */
-      offset = info->cp;
+      offsets[i] = info->cp;
 
-      /* write out the layer. */
-      xcf_check_error (xcf_save_channel (info, image, channel, error));
+      /* write out the channel. */
+      if (! xcf_save_channel (info, image, channel, error) ||
+          ! xcf_seek_end (info, error))
+        {
+          g_free (offsets);
+          return FALSE;
+        }
 
       xcf_progress_update (info);
-
-      /* seek back to where we are to write out the next
-       *  channel offset and write it out.
-       */
-      xcf_check_error (xcf_seek_pos (info, saved_pos, error));
-      xcf_write_int32_check_error (info, &offset, 1);
-
-      /* increment the location we are to write out the
-       *  next offset.
-       */
-      saved_pos = info->cp;
-
-      /* seek to the end of the file which is where
-       *  we will write out the next channel.
-       */
-      xcf_check_error (xcf_seek_end (info, error));
     }
 
   g_list_free (all_layers);
   g_list_free (all_channels);
 
-  /* write out a '0' offset position to indicate the end
-   *  of the channel offsets.
-   */
-  offset = 0;
-  xcf_check_error (xcf_seek_pos (info, saved_pos, error));
-  xcf_write_int32_check_error (info, &offset, 1);
-  saved_pos = info->cp;
+  /* write out the offset lists */
+  if (! xcf_seek_pos (info, saved_pos, error))
+    {
+      g_free (offsets);
+      return FALSE;
+    }
+
+  info->cp += xcf_write_offset (info, offsets, n_layers + n_channels + 2,
+                                &tmp_error);
+
+  g_free (offsets);
+
+  if (tmp_error)
+    {
+      g_propagate_error (error, tmp_error);
+      return FALSE;
+    }
 
   return !ferror (info->fp);
 }
@@ -673,15 +791,15 @@ xcf_save_prop (XcfInfo    *info,
 
     case PROP_FLOATING_SELECTION:
       {
-        guint32 dummy;
+        goffset dummy;
 
         dummy = 0;
-        size = 4;
+        size = XCF_OFFSET_SIZE (info);
 
         xcf_write_prop_type_check_error (info, prop_type);
         xcf_write_int32_check_error (info, &size, 1);
         info->floating_sel_offset = info->cp;
-        xcf_write_int32_check_error (info, &dummy, 1);
+        xcf_write_offset_check_error (info, &dummy, 1);
       }
       break;
 
@@ -980,8 +1098,8 @@ xcf_save_prop (XcfInfo    *info,
 
         if (gimp_parasite_list_persistent_length (list) > 0)
           {
-            guint32 base, length;
-            long    pos;
+            goffset base, pos;
+            guint32 length;
 
             xcf_write_prop_type_check_error (info, prop_type);
 
@@ -1025,8 +1143,8 @@ xcf_save_prop (XcfInfo    *info,
 
     case PROP_PATHS:
       {
-        guint32 base, length;
-        glong   pos;
+        goffset base, pos;
+        guint32 length;
 
         xcf_write_prop_type_check_error (info, prop_type);
 
@@ -1091,8 +1209,8 @@ xcf_save_prop (XcfInfo    *info,
 
     case PROP_VECTORS:
       {
-        guint32 base, length;
-        glong   pos;
+        goffset base, pos;
+        guint32 length;
 
         xcf_write_prop_type_check_error (info, prop_type);
 
@@ -1180,8 +1298,8 @@ xcf_save_layer (XcfInfo    *info,
                 GimpLayer  *layer,
                 GError    **error)
 {
-  guint32      saved_pos;
-  guint32      offset;
+  goffset      saved_pos;
+  goffset      offset;
   guint32      value;
   const gchar *string;
   GError      *tmp_error = NULL;
@@ -1193,7 +1311,7 @@ xcf_save_layer (XcfInfo    *info,
     {
       saved_pos = info->cp;
       xcf_check_error (xcf_seek_pos (info, info->floating_sel_offset, error));
-      xcf_write_int32_check_error (info, &saved_pos, 1);
+      xcf_write_offset_check_error (info, &saved_pos, 1);
       xcf_check_error (xcf_seek_pos (info, saved_pos, error));
     }
 
@@ -1220,7 +1338,9 @@ xcf_save_layer (XcfInfo    *info,
   saved_pos = info->cp;
 
   /*  write out the layer tile hierarchy  */
-  xcf_check_error (xcf_seek_pos (info, info->cp + 8, error));
+  xcf_check_error (xcf_seek_pos (info,
+                                 info->cp + 2 * XCF_OFFSET_SIZE (info),
+                                 error));
   offset = info->cp;
 
   xcf_check_error (xcf_save_buffer (info,
@@ -1228,7 +1348,7 @@ xcf_save_layer (XcfInfo    *info,
                                     error));
 
   xcf_check_error (xcf_seek_pos (info, saved_pos, error));
-  xcf_write_int32_check_error (info, &offset, 1);
+  xcf_write_offset_check_error (info, &offset, 1);
 
   /*  save the current position which is where the layer mask offset
    *  will be stored.
@@ -1250,7 +1370,7 @@ xcf_save_layer (XcfInfo    *info,
     offset = 0;
 
   xcf_check_error (xcf_seek_pos (info, saved_pos, error));
-  xcf_write_int32_check_error (info, &offset, 1);
+  xcf_write_offset_check_error (info, &offset, 1);
 
   return TRUE;
 }
@@ -1261,8 +1381,8 @@ xcf_save_channel (XcfInfo      *info,
                   GimpChannel  *channel,
                   GError      **error)
 {
-  guint32      saved_pos;
-  guint32      offset;
+  goffset      saved_pos;
+  goffset      offset;
   guint32      value;
   const gchar *string;
   GError      *tmp_error = NULL;
@@ -1274,7 +1394,7 @@ xcf_save_channel (XcfInfo      *info,
     {
       saved_pos = info->cp;
       xcf_check_error (xcf_seek_pos (info, info->floating_sel_offset, error));
-      xcf_write_int32_check_error (info, &saved_pos, 1);
+      xcf_write_offset_check_error (info, &saved_pos, 1);
       xcf_check_error (xcf_seek_pos (info, saved_pos, error));
     }
 
@@ -1298,7 +1418,9 @@ xcf_save_channel (XcfInfo      *info,
   saved_pos = info->cp;
 
   /* write out the channel tile hierarchy */
-  xcf_check_error (xcf_seek_pos (info, info->cp + 4, error));
+  xcf_check_error (xcf_seek_pos (info,
+                                 info->cp + XCF_OFFSET_SIZE (info),
+                                 error));
   offset = info->cp;
 
   xcf_check_error (xcf_save_buffer (info,
@@ -1306,7 +1428,7 @@ xcf_save_channel (XcfInfo      *info,
                                     error));
 
   xcf_check_error (xcf_seek_pos (info, saved_pos, error));
-  xcf_write_int32_check_error (info, &offset, 1);
+  xcf_write_offset_check_error (info, &offset, 1);
   saved_pos = info->cp;
 
   return TRUE;
@@ -1335,14 +1457,16 @@ xcf_save_buffer (XcfInfo     *info,
                  GError     **error)
 {
   const Babl *format;
-  guint32     saved_pos;
-  guint32     offset;
+  GeglBuffer *level_buffer;
+  goffset     saved_pos;
+  goffset    *offsets;
   guint32     width;
   guint32     height;
   guint32     bpp;
   gint        i;
   gint        nlevels;
   gint        tmp1, tmp2;
+  gboolean    success   = TRUE;
   GError     *tmp_error = NULL;
 
   format = gegl_buffer_get_format (buffer);
@@ -1361,51 +1485,100 @@ xcf_save_buffer (XcfInfo     *info,
   tmp2 = xcf_calc_levels (height, XCF_TILE_HEIGHT);
   nlevels = MAX (tmp1, tmp2);
 
-  xcf_check_error (xcf_seek_pos (info, info->cp + (1 + nlevels) * 4, error));
+  xcf_check_error (xcf_seek_pos (info,
+                                 info->cp + (1 + nlevels) *
+                                 XCF_OFFSET_SIZE (info),
+                                 error));
+
+  /* the level offsets are followed by a '0' offset position to
+   *  indicate the end of the level offsets, they are written out
+   *  in one go once all levels are saved.
+   */
+  offsets = g_new0 (goffset, nlevels + 1);
+
+  level_buffer = g_object_ref (buffer);
 
-  for (i = 0; i < nlevels; i++)
+  for (i = 0; success && i < nlevels; i++)
     {
-      offset = info->cp;
+      offsets[i] = info->cp;
+
+      if (i > 0)
+        {
+          width  /= 2;
+          height /= 2;
+        }
 
-      if (i == 0)
+      if (i == 0 || (info->save_levels && width > 0 && height > 0))
         {
+          /* with "xcf-save-levels", the levels past the first are
+           *  real downsampled copies, previews are loaded from them,
+           *  see xcf_load_buffer().
+           */
+          if (i > 0)
+            {
+              GeglBuffer *prev_buffer = level_buffer;
+
+              level_buffer =
+                gegl_buffer_new (GEGL_RECTANGLE (0, 0, width, height), format);
+
+              gimp_gegl_downsample (prev_buffer, level_buffer);
+
+              g_object_unref (prev_buffer);
+            }
+
           /* write out the level. */
-          xcf_check_error (xcf_save_level (info, buffer, error));
+          success = xcf_save_level (info, level_buffer, error);
         }
       else
         {
-          /* fake an empty level */
-          tmp1 = 0;
-          width  /= 2;
-          height /= 2;
-          xcf_write_int32_check_error (info, (guint32 *) &width,  1);
-          xcf_write_int32_check_error (info, (guint32 *) &height, 1);
-          xcf_write_int32_check_error (info, (guint32 *) &tmp1,   1);
+          guint32 empty[3];
+
+          /* fake an empty level  */
+          empty[0] = width;
+          empty[1] = height;
+          empty[2] = 0;
+
+          info->cp += xcf_write_int32 (info->fp, empty, 3, &tmp_error);
+
+          if (XCF_OFFSET_SIZE (info) == 8 && ! tmp_error)
+            info->cp += xcf_write_int32 (info->fp, empty + 2, 1, &tmp_error);
+
+          if (tmp_error)
+            {
+              g_propagate_error (error, tmp_error);
+              success = FALSE;
+            }
         }
+    }
 
-      /* seek back to where we are to write out the next
-       *  level offset and write it out.
-       */
-      xcf_check_error (xcf_seek_pos (info, saved_pos, error));
-      xcf_write_int32_check_error (info, &offset, 1);
+  g_object_unref (level_buffer);
 
-      /* increment the location we are to write out the
-       *  next offset.
-       */
-      saved_pos = info->cp;
+  if (! success)
+    {
+      g_free (offsets);
+      return FALSE;
+    }
 
-      /* seek to the end of the file which is where
-       *  we will write out the next level.
-       */
-      xcf_check_error (xcf_seek_end (info, error));
+  if (! xcf_seek_pos (info, saved_pos, error))
+    {
+      g_free (offsets);
+      return FALSE;
     }
 
-  /* write out a '0' offset position to indicate the end
-   *  of the level offsets.
+  info->cp += xcf_write_offset (info, offsets, nlevels + 1, &tmp_error);
+
+  g_free (offsets);
+
+  if (tmp_error)
+    {
+      g_propagate_error (error, tmp_error);
+      return FALSE;
+    }
+
+  /* seek to the end of the file which is where the caller
+   *  continues writing.
    */
-  offset = 0;
-  xcf_check_error (xcf_seek_pos (info, saved_pos, error));
-  xcf_write_int32_check_error (info, &offset, 1);
+  xcf_check_error (xcf_seek_end (info, error));
 
   return TRUE;
 }
@@ -1415,18 +1588,25 @@ xcf_save_level (XcfInfo     *info,
                 GeglBuffer  *buffer,
                 GError     **error)
 {
-  const Babl *format;
-  guint32     saved_pos;
-  guint32     offset;
-  guint32     width;
-  guint32     height;
-  gint        bpp;
-  gint        n_tile_rows;
-  gint        n_tile_cols;
-  guint       ntiles;
-  gint        i;
-  guchar     *rlebuf;
-  GError     *tmp_error = NULL;
+  const Babl       *format;
+  XcfSaveTilesData  data;
+  XcfSaveTile      *tiles;
+  goffset           saved_pos;
+  goffset          *offsets;
+  guint32           width;
+  guint32           height;
+  gint              bpp;
+  gint              n_tile_rows;
+  gint              n_tile_cols;
+  guint             ntiles;
+  gint              n_batch;
+  gsize             max_tile_size;
+  gsize             max_xcf_size;
+  guchar           *tile_data;
+  guchar           *xcf_data;
+  gint              i, j;
+  gboolean          success   = TRUE;
+  GError           *tmp_error = NULL;
 
   format = gegl_buffer_get_format (buffer);
 
@@ -1439,114 +1619,172 @@ xcf_save_level (XcfInfo     *info,
 
   saved_pos = info->cp;
 
-  /* allocate a temporary buffer to store the rle data before it is
-   * written to disk
-   */
-  rlebuf = g_alloca (XCF_TILE_WIDTH * XCF_TILE_HEIGHT * bpp * 1.5);
-
   n_tile_rows = gimp_gegl_buffer_get_n_tile_rows (buffer, XCF_TILE_HEIGHT);
   n_tile_cols = gimp_gegl_buffer_get_n_tile_cols (buffer, XCF_TILE_WIDTH);
 
   ntiles = n_tile_rows * n_tile_cols;
-  xcf_check_error (xcf_seek_pos (info, info->cp + (ntiles + 1) * 4, error));
+  xcf_check_error (xcf_seek_pos (info,
+                                 info->cp + (ntiles + 1) *
+                                 XCF_OFFSET_SIZE (info),
+                                 error));
+
+  /*  the tiles are fetched and compressed in batches, each tile can
+   *  be compressed independently so that's done in parallel, the
+   *  compressed data is then written out in tile order.
+   */
+  n_batch = MIN (ntiles,
+                 gimp_parallel_get_n_threads () * XCF_SAVE_TILES_PER_THREAD);
+
+  /* the rle data can be up to 1.5 times the size of the tile */
+  max_tile_size = XCF_TILE_WIDTH * XCF_TILE_HEIGHT * bpp;
+  max_xcf_size  = MAX (max_tile_size * 3 / 2,
+                       compressBound (max_tile_size));
 
-  for (i = 0; i < ntiles; i++)
+  offsets   = g_new (goffset, ntiles + 1);
+  tiles     = g_new0 (XcfSaveTile, n_batch);
+  tile_data = g_malloc (n_batch * max_tile_size);
+  xcf_data  = g_malloc (n_batch * max_xcf_size);
+
+  for (j = 0; j < n_batch; j++)
     {
-      GeglRectangle rect;
+      tiles[j].data     = tile_data + j * max_tile_size;
+      tiles[j].xcf_data = xcf_data  + j * max_xcf_size;
+    }
 
-      /* save the start offset of where we are writing
-       *  out the next tile.
-       */
-      offset = info->cp;
+  data.info  = info;
+  data.tiles = tiles;
+  data.bpp   = bpp;
 
-      gimp_gegl_buffer_get_tile_rect (buffer,
-                                      XCF_TILE_WIDTH, XCF_TILE_HEIGHT,
-                                      i, &rect);
+  for (i = 0; success && i < ntiles; i += n_batch)
+    {
+      gint n = MIN (n_batch, ntiles - i);
 
-      /* write out the tile. */
-      switch (info->compression)
+      for (j = 0; j < n; j++)
         {
-        case COMPRESS_NONE:
-          xcf_check_error (xcf_save_tile (info, buffer, &rect, format,
-                                          error));
-          break;
-        case COMPRESS_RLE:
-          xcf_check_error (xcf_save_tile_rle (info, buffer, &rect, format,
-                                              rlebuf, error));
-          break;
-        case COMPRESS_ZLIB:
-          g_error ("xcf: zlib compression unimplemented");
-          break;
-        case COMPRESS_FRACTAL:
-          g_error ("xcf: fractal compression unimplemented");
-          break;
+          XcfSaveTile *tile = &tiles[j];
+
+          gimp_gegl_buffer_get_tile_rect (buffer,
+                                          XCF_TILE_WIDTH, XCF_TILE_HEIGHT,
+                                          i + j, &tile->rect);
+
+          gegl_buffer_get (buffer, &tile->rect, 1.0, format, tile->data,
+                           GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
         }
 
-      /* seek back to where we are to write out the next
-       *  tile offset and write it out.
-       */
-      xcf_check_error (xcf_seek_pos (info, saved_pos, error));
-      xcf_write_int32_check_error (info, &offset, 1);
+      gimp_parallel_distribute_range (n, 1, xcf_save_encode_tiles, &data);
 
-      /* increment the location we are to write out the
-       *  next offset.
-       */
-      saved_pos = info->cp;
+      for (j = 0; j < n; j++)
+        {
+          XcfSaveTile *tile = &tiles[j];
 
-      /* seek to the end of the file which is where
-       *  we will write out the next tile.
-       */
-      xcf_check_error (xcf_seek_end (info, error));
+          if (tile->failed)
+            {
+              g_set_error_literal (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                                   _("Error compressing XCF tile data"));
+              success = FALSE;
+              break;
+            }
+
+          /* save the start offset of where we are writing
+           *  out the tile.
+           */
+          offsets[i + j] = info->cp;
+
+          info->cp += xcf_write_int8 (info->fp,
+                                      info->compression == COMPRESS_NONE ?
+                                      tile->data : tile->xcf_data,
+                                      tile->xcf_size, &tmp_error);
+
+          if (tmp_error)
+            {
+              g_propagate_error (error, tmp_error);
+              success = FALSE;
+              break;
+            }
+        }
     }
 
-  /* write out a '0' offset position to indicate the end
-   *  of the level offsets.
-   */
-  offset = 0;
-  xcf_check_error (xcf_seek_pos (info, saved_pos, error));
-  xcf_write_int32_check_error (info, &offset, 1);
+  g_free (xcf_data);
+  g_free (tile_data);
+  g_free (tiles);
 
-  return TRUE;
+  if (success)
+    {
+      /* write out the tile offsets, followed by a '0' offset
+       *  position to indicate the end of the tile offsets.
+       */
+      offsets[ntiles] = 0;
 
+      success = xcf_seek_pos (info, saved_pos, error);
+
+      if (success)
+        {
+          info->cp += xcf_write_offset (info, offsets, ntiles + 1,
+                                        &tmp_error);
+
+          if (tmp_error)
+            {
+              g_propagate_error (error, tmp_error);
+              success = FALSE;
+            }
+        }
+
+      if (success)
+        success = xcf_seek_end (info, error);
+    }
+
+  g_free (offsets);
+
+  return success;
 }
 
-static gboolean
-xcf_save_tile (XcfInfo        *info,
-               GeglBuffer     *buffer,
-               GeglRectangle  *tile_rect,
-               const Babl     *format,
-               GError        **error)
+static void
+xcf_save_encode_tiles (gsize    offset,
+                       gsize    size,
+                       gpointer user_data)
 {
-  gint    bpp       = babl_format_get_bytes_per_pixel (format);
-  gint    tile_size = bpp * tile_rect->width * tile_rect->height;
-  guchar *tile_data = g_alloca (tile_size);
-  GError *tmp_error = NULL;
+  XcfSaveTilesData *data = user_data;
+  gsize             i;
 
-  gegl_buffer_get (buffer, tile_rect, 1.0, format, tile_data,
-                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+  for (i = offset; i < offset + size; i++)
+    {
+      XcfSaveTile *tile      = &data->tiles[i];
+      gint         n_pixels  = tile->rect.width * tile->rect.height;
+      gsize        tile_size = n_pixels * data->bpp;
 
-  xcf_write_int8_check_error (info, tile_data, tile_size);
+      tile->failed = FALSE;
 
-  return TRUE;
+      switch (data->info->compression)
+        {
+        case COMPRESS_NONE:
+          tile->xcf_size = tile_size;
+          break;
+        case COMPRESS_RLE:
+          tile->xcf_size = xcf_save_tile_rle (tile->data, n_pixels, data->bpp,
+                                              tile->xcf_data);
+          break;
+        case COMPRESS_ZLIB:
+          tile->xcf_size = compressBound (tile_size);
+          tile->failed   = ! xcf_save_tile_zlib (tile->data, tile_size,
+                                                 data->info->compression_level,
+                                                 tile->xcf_data,
+                                                 &tile->xcf_size);
+          break;
+        case COMPRESS_FRACTAL:
+          g_error ("xcf: fractal compression unimplemented");
+          break;
+        }
+    }
 }
 
-static gboolean
-xcf_save_tile_rle (XcfInfo        *info,
-                   GeglBuffer     *buffer,
-                   GeglRectangle  *tile_rect,
-                   const Babl     *format,
-                   guchar         *rlebuf,
-                   GError        **error)
+static gsize
+xcf_save_tile_rle (const guchar *tile_data,
+                   gint          n_pixels,
+                   gint          bpp,
+                   guchar       *rlebuf)
 {
-  gint    bpp       = babl_format_get_bytes_per_pixel (format);
-  gint    tile_size = bpp * tile_rect->width * tile_rect->height;
-  guchar *tile_data = g_alloca (tile_size);
-  gint    len       = 0;
-  gint    i, j;
-  GError *tmp_error  = NULL;
-
-  gegl_buffer_get (buffer, tile_rect, 1.0, format, tile_data,
-                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+  gsize len = 0;
+  gint  i, j;
 
   for (i = 0; i < bpp; i++)
     {
@@ -1554,7 +1792,7 @@ xcf_save_tile_rle (XcfInfo        *info,
       gint          state  = 0;
       gint          length = 0;
       gint          count  = 0;
-      gint          size   = tile_rect->width * tile_rect->height;
+      gint          size   = n_pixels;
       guint         last   = -1;
 
       while (size > 0)
@@ -1640,11 +1878,27 @@ xcf_save_tile_rle (XcfInfo        *info,
             }
         }
 
-      if (count != (tile_rect->width * tile_rect->height))
+      if (count != n_pixels)
         g_message ("xcf: uh oh! xcf rle tile saving error: %d", count);
     }
 
-  xcf_write_int8_check_error (info, rlebuf, len);
+  return len;
+}
+
+static gboolean
+xcf_save_tile_zlib (const guchar *tile_data,
+                    gsize         tile_size,
+                    gint          level,
+                    guchar       *zlibbuf,
+                    gsize        *zlibbuf_size)
+{
+  uLongf dest_len = *zlibbuf_size;
+
+  if (compress2 (zlibbuf, &dest_len,
+                 tile_data, tile_size, level) != Z_OK)
+    return FALSE;
+
+  *zlibbuf_size = dest_len;
 
   return TRUE;
 }
@@ -1975,3 +2229,45 @@ xcf_save_vectors (XcfInfo    *info,
 
   return TRUE;
 }
+
+static guint
+xcf_write_offset (XcfInfo        *info,
+                  const goffset  *offsets,
+                  gint            count,
+                  GError        **error)
+{
+  guint total = 0;
+  gint  i;
+
+  for (i = 0; i < count; i++)
+    {
+      GError *tmp_error = NULL;
+
+      if (XCF_OFFSET_SIZE (info) == 8)
+        {
+          guint64 offset = offsets[i];
+
+          total += xcf_write_int64 (info->fp, &offset, 1, &tmp_error);
+        }
+      else if (offsets[i] <= G_MAXUINT32)
+        {
+          guint32 offset = offsets[i];
+
+          total += xcf_write_int32 (info->fp, &offset, 1, &tmp_error);
+        }
+      else
+        {
+          g_set_error_literal (&tmp_error, G_FILE_ERROR, G_FILE_ERROR_FBIG,
+                               _("Error saving XCF file: "
+                                 "the file is too large for this XCF version"));
+        }
+
+      if (tmp_error)
+        {
+          g_propagate_error (error, tmp_error);
+          break;
+        }
+    }
+
+  return total;
+}
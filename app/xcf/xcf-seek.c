@@ -29,15 +29,26 @@
 
 #include "gimp-intl.h"
 
+
+/*  plain fseek() and ftell() can't address files beyond 2 GB  */
+#ifdef G_OS_WIN32
+#define xcf_fseek _fseeki64
+#define xcf_ftell _ftelli64
+#else
+#define xcf_fseek fseeko
+#define xcf_ftell ftello
+#endif
+
+
 gboolean
 xcf_seek_pos (XcfInfo  *info,
-              guint     pos,
+              goffset   pos,
               GError  **error)
 {
   if (info->cp != pos)
     {
       info->cp = pos;
-      if (fseek (info->fp, info->cp, SEEK_SET) == -1)
+      if (xcf_fseek (info->fp, info->cp, SEEK_SET) == -1)
         {
           g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
                        _("Could not seek in XCF file: %s"),
@@ -54,7 +65,7 @@ gboolean
 xcf_seek_end (XcfInfo  *info,
               GError  **error)
 {
-  if (fseek (info->fp, 0, SEEK_END) == -1)
+  if (xcf_fseek (info->fp, 0, SEEK_END) == -1)
     {
       g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
                    _("Could not seek in XCF file: %s"),
@@ -63,9 +74,9 @@ xcf_seek_end (XcfInfo  *info,
       return FALSE;
     }
 
-  info->cp = ftell (info->fp);
+  info->cp = xcf_ftell (info->fp);
 
-  if (fseek (info->fp, 0, SEEK_END) == -1)
+  if (xcf_fseek (info->fp, 0, SEEK_END) == -1)
     {
       g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
                    _("Could not seek in XCF file: %s"),
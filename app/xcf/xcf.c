@@ -23,11 +23,14 @@
 
 #include <gegl.h>
 #include <glib/gstdio.h>
+#include <zlib.h>
 
 #include "libgimpbase/gimpbase.h"
 
 #include "core/core-types.h"
 
+#include "config/gimpcoreconfig.h"
+
 #include "core/gimp.h"
 #include "core/gimpimage.h"
 #include "core/gimpparamspecs.h"
@@ -42,6 +45,8 @@
 #include "xcf-read.h"
 #include "xcf-save.h"
 
+#include "gimptilebackendxcf.h"
+
 #include "gimp-intl.h"
 
 
@@ -50,18 +55,35 @@ typedef GimpImage * GimpXcfLoaderFunc (Gimp     *gimp,
                                        GError  **error);
 
 
-static GimpValueArray * xcf_load_invoker (GimpProcedure         *procedure,
-                                          Gimp                  *gimp,
-                                          GimpContext           *context,
-                                          GimpProgress          *progress,
-                                          const GimpValueArray  *args,
-                                          GError               **error);
-static GimpValueArray * xcf_save_invoker (GimpProcedure         *procedure,
-                                          Gimp                  *gimp,
-                                          GimpContext           *context,
-                                          GimpProgress          *progress,
-                                          const GimpValueArray  *args,
-                                          GError               **error);
+static GimpValueArray * xcf_load_invoker       (GimpProcedure         *procedure,
+                                                Gimp                  *gimp,
+                                                GimpContext           *context,
+                                                GimpProgress          *progress,
+                                                const GimpValueArray  *args,
+                                                GError               **error);
+static GimpValueArray * xcf_load_thumb_invoker (GimpProcedure         *procedure,
+                                                Gimp                  *gimp,
+                                                GimpContext           *context,
+                                                GimpProgress          *progress,
+                                                const GimpValueArray  *args,
+                                                GError               **error);
+static GimpValueArray * xcf_save_invoker       (GimpProcedure         *procedure,
+                                                Gimp                  *gimp,
+                                                GimpContext           *context,
+                                                GimpProgress          *progress,
+                                                const GimpValueArray  *args,
+                                                GError               **error);
+
+static GimpImage      * xcf_load_file          (Gimp                  *gimp,
+                                                GimpProgress          *progress,
+                                                const gchar           *filename,
+                                                gint                   preview_size,
+                                                gint                  *image_width,
+                                                gint                  *image_height,
+                                                GError               **error);
+static gboolean         xcf_save_stream        (FILE                  *src,
+                                                FILE                  *dest,
+                                                GError               **error);
 
 
 static GimpXcfLoaderFunc * const xcf_loaders[] =
@@ -70,7 +92,9 @@ static GimpXcfLoaderFunc * const xcf_loaders[] =
   xcf_load_image,   /* version 1 */
   xcf_load_image,   /* version 2 */
   xcf_load_image,   /* version 3 */
-  xcf_load_image    /* version 4 */
+  xcf_load_image,   /* version 4 */
+  xcf_load_image,   /* version 5 */
+  xcf_load_image    /* version 6 */
 };
 
 
@@ -219,6 +243,78 @@ xcf_init (Gimp *gimp)
                                                              "Output image",
                                                              gimp, FALSE,
                                                              GIMP_PARAM_READWRITE));
+  gimp_plug_in_procedure_set_thumb_loader (proc, "gimp-xcf-load-thumb");
+  gimp_plug_in_manager_add_procedure (gimp->plug_in_manager, proc);
+  g_object_unref (procedure);
+
+  /*  gimp-xcf-load-thumb  */
+  procedure = gimp_plug_in_procedure_new (GIMP_PLUGIN, "gimp-xcf-load-thumb");
+  procedure->proc_type    = GIMP_INTERNAL;
+  procedure->marshal_func = xcf_load_thumb_invoker;
+
+  proc = GIMP_PLUG_IN_PROCEDURE (procedure);
+
+  gimp_object_set_static_name (GIMP_OBJECT (procedure), "gimp-xcf-load-thumb");
+  gimp_procedure_set_static_strings (procedure,
+                                     "gimp-xcf-load-thumb",
+                                     "Loads a preview from a .xcf file",
+                                     "This procedure loads a reduced size "
+                                     "version of the specified file, using "
+                                     "the downsampled levels stored in the "
+                                     "file where available.",
+                                     "Spencer Kimball & Peter Mattis",
+                                     "Spencer Kimball & Peter Mattis",
+                                     "1995-1996",
+                                     NULL);
+
+  gimp_procedure_add_argument (procedure,
+                               gimp_param_spec_string ("filename",
+                                                       "Filename",
+                                                       "The name of the file "
+                                                       "to load, in the "
+                                                       "on-disk character "
+                                                       "set and encoding",
+                                                       TRUE, FALSE, TRUE,
+                                                       NULL,
+                                                       GIMP_PARAM_READWRITE));
+  gimp_procedure_add_argument (procedure,
+                               gimp_param_spec_int32 ("thumb-size",
+                                                      "Thumb size",
+                                                      "Preferred thumbnail size",
+                                                      1, G_MAXINT32, 128,
+                                                      GIMP_PARAM_READWRITE));
+
+  gimp_procedure_add_return_value (procedure,
+                                   gimp_param_spec_image_id ("image",
+                                                             "Image",
+                                                             "Thumbnail image",
+                                                             gimp, FALSE,
+                                                             GIMP_PARAM_READWRITE));
+  gimp_procedure_add_return_value (procedure,
+                                   gimp_param_spec_int32 ("image-width",
+                                                          "Image width",
+                                                          "Width of the full-sized image",
+                                                          0, G_MAXINT32, 0,
+                                                          GIMP_PARAM_READWRITE));
+  gimp_procedure_add_return_value (procedure,
+                                   gimp_param_spec_int32 ("image-height",
+                                                          "Image height",
+                                                          "Height of the full-sized image",
+                                                          0, G_MAXINT32, 0,
+                                                          GIMP_PARAM_READWRITE));
+  gimp_procedure_add_return_value (procedure,
+                                   gimp_param_spec_int32 ("image-type",
+                                                          "Image type",
+                                                          "Type of the image",
+                                                          0, G_MAXINT32, 0,
+                                                          GIMP_PARAM_READWRITE));
+  gimp_procedure_add_return_value (procedure,
+                                   gimp_param_spec_int32 ("num-layers",
+                                                          "Num layers",
+                                                          "Number of layers "
+                                                          "in the image",
+                                                          0, G_MAXINT32, 0,
+                                                          GIMP_PARAM_READWRITE));
   gimp_plug_in_manager_add_procedure (gimp->plug_in_manager, proc);
   g_object_unref (procedure);
 }
@@ -236,27 +332,131 @@ xcf_load_invoker (GimpProcedure         *procedure,
                   GimpProgress          *progress,
                   const GimpValueArray  *args,
                   GError               **error)
+{
+  GimpValueArray *return_vals;
+  GimpImage      *image;
+  const gchar    *filename;
+
+  gimp_set_busy (gimp);
+
+  filename = g_value_get_string (gimp_value_array_index (args, 1));
+
+  image = xcf_load_file (gimp, progress, filename, 0, NULL, NULL, error);
+
+  return_vals = gimp_procedure_get_return_values (procedure, image != NULL,
+                                                  error ? *error : NULL);
+
+  if (image)
+    gimp_value_set_image (gimp_value_array_index (return_vals, 1), image);
+
+  gimp_unset_busy (gimp);
+
+  return return_vals;
+}
+
+static GimpValueArray *
+xcf_load_thumb_invoker (GimpProcedure         *procedure,
+                        Gimp                  *gimp,
+                        GimpContext           *context,
+                        GimpProgress          *progress,
+                        const GimpValueArray  *args,
+                        GError               **error)
+{
+  GimpValueArray *return_vals;
+  GimpImage      *image;
+  const gchar    *filename;
+  gint            size;
+  gint            width  = 0;
+  gint            height = 0;
+
+  gimp_set_busy (gimp);
+
+  filename = g_value_get_string (gimp_value_array_index (args, 0));
+  size     = g_value_get_int    (gimp_value_array_index (args, 1));
+
+  image = xcf_load_file (gimp, NULL, filename, size, &width, &height, error);
+
+  return_vals = gimp_procedure_get_return_values (procedure, image != NULL,
+                                                  error ? *error : NULL);
+
+  if (image)
+    {
+      GimpImageType type = GIMP_RGB_IMAGE;
+
+      switch (gimp_image_get_base_type (image))
+        {
+        case GIMP_RGB:
+          type = GIMP_RGB_IMAGE;
+          break;
+
+        case GIMP_GRAY:
+          type = GIMP_GRAY_IMAGE;
+          break;
+
+        case GIMP_INDEXED:
+          type = GIMP_INDEXED_IMAGE;
+          break;
+        }
+
+      /*  the image types with alpha directly follow their opaque ones  */
+      if (gimp_image_has_alpha (image))
+        type++;
+
+      gimp_value_set_image (gimp_value_array_index (return_vals, 1), image);
+      g_value_set_int (gimp_value_array_index (return_vals, 2), width);
+      g_value_set_int (gimp_value_array_index (return_vals, 3), height);
+      g_value_set_int (gimp_value_array_index (return_vals, 4), type);
+      g_value_set_int (gimp_value_array_index (return_vals, 5),
+                       gimp_image_get_n_layers (image));
+    }
+
+  gimp_unset_busy (gimp);
+
+  return return_vals;
+}
+
+static GimpValueArray *
+xcf_save_invoker (GimpProcedure         *procedure,
+                  Gimp                  *gimp,
+                  GimpContext           *context,
+                  GimpProgress          *progress,
+                  const GimpValueArray  *args,
+                  GError               **error)
 {
   XcfInfo         info;
   GimpValueArray *return_vals;
-  GimpImage      *image   = NULL;
+  GimpImage      *image;
   const gchar    *filename;
+  FILE           *output  = NULL;
   gboolean        success = FALSE;
-  gchar           id[14];
 
   gimp_set_busy (gimp);
 
-  filename = g_value_get_string (gimp_value_array_index (args, 1));
+  image    = gimp_value_get_image (gimp_value_array_index (args, 1), gimp);
+  filename = g_value_get_string (gimp_value_array_index (args, 3));
 
-  info.fp = g_fopen (filename, "rb");
+  /*  images loaded lazily from the file we are about to overwrite
+   *  must first copy the tiles they still read from it to their swap
+   */
+  if (! gimp_tile_backend_xcf_unmap_file (filename, error))
+    {
+      return_vals = gimp_procedure_get_return_values (procedure, FALSE,
+                                                      error ? *error : NULL);
+
+      gimp_unset_busy (gimp);
+
+      return return_vals;
+    }
+
+  info.fp = g_fopen (filename, "wb");
 
   if (info.fp)
     {
       info.gimp                  = gimp;
       info.progress              = progress;
+      info.mapped_file           = NULL;
       info.cp                    = 0;
       info.filename              = filename;
-      info.tattoo_state          = 0;
       info.active_layer          = NULL;
       info.active_channel        = NULL;
       info.floating_sel_drawable = NULL;
@@ -264,12 +464,31 @@ xcf_load_invoker (GimpProcedure         *procedure,
       info.floating_sel_offset   = 0;
       info.swap_num              = 0;
       info.ref_count             = NULL;
-      info.compression           = COMPRESS_NONE;
+
+      switch (gimp->config->xcf_compression)
+        {
+        case GIMP_XCF_COMPRESSION_RLE:
+          info.compression       = COMPRESS_RLE;
+          info.compression_level = Z_DEFAULT_COMPRESSION;
+          break;
+
+        case GIMP_XCF_COMPRESSION_ZLIB:
+          info.compression       = COMPRESS_ZLIB;
+          info.compression_level = Z_DEFAULT_COMPRESSION;
+          break;
+
+        case GIMP_XCF_COMPRESSION_ZLIB_FAST:
+          info.compression       = COMPRESS_ZLIB;
+          info.compression_level = Z_BEST_SPEED;
+          break;
+        }
+
+      info.save_levels = gimp->config->xcf_save_levels;
 
       if (progress)
         {
           gchar *name = g_filename_display_name (filename);
-          gchar *msg  = g_strdup_printf (_("Opening '%s'"), name);
+          gchar *msg  = g_strdup_printf (_("Saving '%s'"), name);
 
           gimp_progress_start (progress, msg, FALSE);
 
@@ -277,47 +496,64 @@ xcf_load_invoker (GimpProcedure         *procedure,
           g_free (name);
         }
 
-      success = TRUE;
+      xcf_save_choose_format (&info, image);
 
-      info.cp += xcf_read_int8 (info.fp, (guint8 *) id, 14);
+      /*  the writer seeks back to fill in offsets, so when saving to
+       *  something that can't seek, like a pipe, the file is assembled
+       *  in a temporary file and streamed out once it's complete.
+       */
+      success = TRUE;
 
-      if (! g_str_has_prefix (id, "gimp xcf "))
+      if (fseek (info.fp, 0, SEEK_CUR) != 0)
         {
-          success = FALSE;
-        }
-      else if (strcmp (id + 9, "file") == 0)
-        {
-          info.file_version = 0;
-        }
-      else if (id[9] == 'v')
-        {
-          info.file_version = atoi (id + 10);
+          output  = info.fp;
+          info.fp = tmpfile ();
+
+          if (! info.fp)
+            {
+              int save_errno = errno;
+
+              g_set_error (error, G_FILE_ERROR,
+                           g_file_error_from_errno (save_errno),
+                           _("Could not create temporary file: %s"),
+                           g_strerror (save_errno));
+
+              info.fp = output;
+              output  = NULL;
+              success = FALSE;
+            }
         }
-      else
+
+      if (success)
+        success = xcf_save_image (&info, image, error);
+
+      if (output)
         {
-          success = FALSE;
+          if (success)
+            success = xcf_save_stream (info.fp, output, error);
+
+          fclose (info.fp);
+          info.fp = output;
         }
 
       if (success)
         {
-          if (info.file_version >= 0 &&
-              info.file_version < G_N_ELEMENTS (xcf_loaders))
+          if (fclose (info.fp) == EOF)
             {
-              image = (*(xcf_loaders[info.file_version])) (gimp, &info, error);
+              int save_errno = errno;
+
+              g_set_error (error, G_FILE_ERROR,
+                           g_file_error_from_errno (save_errno),
+                            _("Error saving XCF file: %s"),
+                           g_strerror (save_errno));
 
-              if (! image)
-                success = FALSE;
-            }
-          else
-            {
-              g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
-                           _("XCF error: unsupported XCF file version %d "
-                             "encountered"), info.file_version);
               success = FALSE;
             }
         }
-
-      fclose (info.fp);
+      else
+        {
+          fclose (info.fp);
+        }
 
       if (progress)
         gimp_progress_end (progress);
@@ -327,41 +563,33 @@ xcf_load_invoker (GimpProcedure         *procedure,
       int save_errno = errno;
 
       g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (save_errno),
-                   _("Could not open '%s' for reading: %s"),
+                   _("Could not open '%s' for writing: %s"),
                    gimp_filename_to_utf8 (filename), g_strerror (save_errno));
     }
 
   return_vals = gimp_procedure_get_return_values (procedure, success,
                                                   error ? *error : NULL);
 
-  if (success)
-    gimp_value_set_image (gimp_value_array_index (return_vals, 1), image);
-
   gimp_unset_busy (gimp);
 
   return return_vals;
 }
 
-static GimpValueArray *
-xcf_save_invoker (GimpProcedure         *procedure,
-                  Gimp                  *gimp,
-                  GimpContext           *context,
-                  GimpProgress          *progress,
-                  const GimpValueArray  *args,
-                  GError               **error)
+static GimpImage *
+xcf_load_file (Gimp          *gimp,
+               GimpProgress  *progress,
+               const gchar   *filename,
+               gint           preview_size,
+               gint          *image_width,
+               gint          *image_height,
+               GError       **error)
 {
-  XcfInfo         info;
-  GimpValueArray *return_vals;
-  GimpImage      *image;
-  const gchar    *filename;
-  gboolean        success = FALSE;
-
-  gimp_set_busy (gimp);
+  XcfInfo    info;
+  GimpImage *image   = NULL;
+  gboolean   success = FALSE;
+  gchar      id[14];
 
-  image    = gimp_value_get_image (gimp_value_array_index (args, 1), gimp);
-  filename = g_value_get_string (gimp_value_array_index (args, 3));
-
-  info.fp = g_fopen (filename, "wb");
+  info.fp = g_fopen (filename, "rb");
 
   if (info.fp)
     {
@@ -369,6 +597,7 @@ xcf_save_invoker (GimpProcedure         *procedure,
       info.progress              = progress;
       info.cp                    = 0;
       info.filename              = filename;
+      info.tattoo_state          = 0;
       info.active_layer          = NULL;
       info.active_channel        = NULL;
       info.floating_sel_drawable = NULL;
@@ -376,12 +605,25 @@ xcf_save_invoker (GimpProcedure         *procedure,
       info.floating_sel_offset   = 0;
       info.swap_num              = 0;
       info.ref_count             = NULL;
-      info.compression           = COMPRESS_RLE;
+      info.compression           = COMPRESS_NONE;
+      info.compression_level     = Z_DEFAULT_COMPRESSION;
+      info.preview_size          = preview_size;
+      info.level                 = 0;
+      info.image_width           = 0;
+      info.image_height          = 0;
+
+      /*  with lazy loading, drawables read their tiles from the
+       *  mapped file when they are first needed, see GimpTileBackendXcf
+       */
+      info.mapped_file = NULL;
+
+      if (preview_size == 0 && gimp->config->xcf_lazy_loading)
+        info.mapped_file = g_mapped_file_new (filename, FALSE, NULL);
 
       if (progress)
         {
           gchar *name = g_filename_display_name (filename);
-          gchar *msg  = g_strdup_printf (_("Saving '%s'"), name);
+          gchar *msg  = g_strdup_printf (_("Opening '%s'"), name);
 
           gimp_progress_start (progress, msg, FALSE);
 
@@ -389,29 +631,47 @@ xcf_save_invoker (GimpProcedure         *procedure,
           g_free (name);
         }
 
-      xcf_save_choose_format (&info, image);
+      success = TRUE;
 
-      success = xcf_save_image (&info, image, error);
+      info.cp += xcf_read_int8 (info.fp, (guint8 *) id, 14);
 
-      if (success)
+      if (! g_str_has_prefix (id, "gimp xcf "))
         {
-          if (fclose (info.fp) == EOF)
-            {
-              int save_errno = errno;
-
-              g_set_error (error, G_FILE_ERROR,
-                           g_file_error_from_errno (save_errno),
-                            _("Error saving XCF file: %s"),
-                           g_strerror (save_errno));
-
-              success = FALSE;
-            }
+          success = FALSE;
+        }
+      else if (strcmp (id + 9, "file") == 0)
+        {
+          info.file_version = 0;
+        }
+      else if (id[9] == 'v')
+        {
+          info.file_version = atoi (id + 10);
         }
       else
         {
-          fclose (info.fp);
+          success = FALSE;
         }
 
+      if (success)
+        {
+          if (info.file_version >= 0 &&
+              info.file_version < G_N_ELEMENTS (xcf_loaders))
+            {
+              image = (*(xcf_loaders[info.file_version])) (gimp, &info, error);
+            }
+          else
+            {
+              g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_FAILED,
+                           _("XCF error: unsupported XCF file version %d "
+                             "encountered"), info.file_version);
+            }
+        }
+
+      fclose (info.fp);
+
+      if (info.mapped_file)
+        g_mapped_file_unref (info.mapped_file);
+
       if (progress)
         gimp_progress_end (progress);
     }
@@ -420,14 +680,54 @@ xcf_save_invoker (GimpProcedure         *procedure,
       int save_errno = errno;
 
       g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (save_errno),
-                   _("Could not open '%s' for writing: %s"),
+                   _("Could not open '%s' for reading: %s"),
                    gimp_filename_to_utf8 (filename), g_strerror (save_errno));
     }
 
-  return_vals = gimp_procedure_get_return_values (procedure, success,
-                                                  error ? *error : NULL);
+  if (image && image_width)
+    *image_width = info.image_width;
 
-  gimp_unset_busy (gimp);
+  if (image && image_height)
+    *image_height = info.image_height;
 
-  return return_vals;
+  return image;
+}
+
+static gboolean
+xcf_save_stream (FILE    *src,
+                 FILE    *dest,
+                 GError **error)
+{
+  guchar buf[16384];
+  gsize  n;
+
+  rewind (src);
+
+  while ((n = fread (buf, 1, sizeof (buf), src)) > 0)
+    {
+      if (fwrite (buf, 1, n, dest) != n)
+        {
+          int save_errno = errno;
+
+          g_set_error (error, G_FILE_ERROR,
+                       g_file_error_from_errno (save_errno),
+                       _("Error saving XCF file: %s"),
+                       g_strerror (save_errno));
+
+          return FALSE;
+        }
+    }
+
+  if (ferror (src))
+    {
+      int save_errno = errno;
+
+      g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (save_errno),
+                   _("Error saving XCF file: %s"),
+                   g_strerror (save_errno));
+
+      return FALSE;
+    }
+
+  return TRUE;
 }
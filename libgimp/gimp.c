@@ -119,7 +119,7 @@
  **/
 
 
-#define TILE_MAP_SIZE (_tile_width * _tile_height * 16)
+#define TILE_MAP_SIZE (_tile_width * _tile_height * 16 * GP_SHM_N_TILES)
 
 #define ERRMSG_SHM_FAILED "Could not attach to gimp shared memory segment"
 
@@ -1878,6 +1878,8 @@ gimp_loop (void)
         case GP_TILE_REQ:
         case GP_TILE_ACK:
         case GP_TILE_DATA:
+        case GP_TILE_REGION:
+        case GP_TILE_ARENA:
           g_warning ("unexpected tile message received (should not happen)");
           break;
 
@@ -2109,6 +2111,8 @@ gimp_process_message (GimpWireMessage *msg)
     case GP_TILE_REQ:
     case GP_TILE_ACK:
     case GP_TILE_DATA:
+    case GP_TILE_REGION:
+    case GP_TILE_ARENA:
       g_warning ("unexpected tile message received (should not happen)");
       break;
     case GP_PROC_RUN:
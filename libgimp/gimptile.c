@@ -57,6 +57,35 @@ static void  gimp_tile_put          (GimpTile        *tile);
 static void  gimp_tile_cache_insert (GimpTile        *tile);
 static void  gimp_tile_cache_flush  (GimpTile        *tile);
 
+static gpointer gimp_tile_cache_drawable_key (gint32    drawable_ID,
+                                              gboolean  shadow);
+
+static gsize gimp_tile_region_shm_size (void);
+static void  gimp_tile_region_copy_rows (guchar       *dest,
+                                         gint          dest_stride,
+                                         const guchar *src,
+                                         gint          src_stride,
+                                         gsize         row_size,
+                                         gint          n_rows);
+static void  gimp_tile_region_get_band (gint32           drawable_ID,
+                                        gboolean         shadow,
+                                        gint             x,
+                                        gint             y,
+                                        gint             width,
+                                        gint             height,
+                                        gint             bpp,
+                                        guchar          *dest,
+                                        gint             rowstride);
+static void  gimp_tile_region_set_band (gint32           drawable_ID,
+                                        gboolean         shadow,
+                                        gint             x,
+                                        gint             y,
+                                        gint             width,
+                                        gint             height,
+                                        gint             bpp,
+                                        const guchar    *src,
+                                        gint             rowstride);
+
 
 /*  private variables  */
 
@@ -67,6 +96,22 @@ static gulong       max_tile_size   = 0;
 static gulong       cur_cache_size  = 0;
 static gulong       max_cache_size  = 0;
 
+/*  the cached tiles of each drawable ID and shadow flag, so the tiles
+ *  of one drawable can be dropped without walking the whole cache
+ */
+static GHashTable * drawable_tile_table = NULL;
+
+static struct
+{
+  gint32   drawable_ID;
+  gboolean shadow;
+  gint     x;
+  gint     y;
+  gint     width;
+  gint     height;
+  gint     bpp;
+} mapped_region = { -1, };
+
 
 /*  public functions  */
 
@@ -165,6 +210,338 @@ gimp_tile_cache_ntiles (gulong ntiles)
                          gimp_tile_height () * 4 + 1023) / 1024);
 }
 
+/**
+ * gimp_tile_region_get:
+ * @drawable_ID: the drawable to read from
+ * @shadow:      whether to read from the drawable's shadow buffer
+ * @x:           x coordinate of the region
+ * @y:           y coordinate of the region
+ * @width:       width of the region
+ * @height:      height of the region
+ * @dest:        memory to store the pixels in
+ * @rowstride:   the rowstride of @dest, or 0 for @width * bpp
+ *
+ * Reads a rectangle of pixels from the core in as few messages as
+ * possible, using the shared memory segment if there is one. The
+ * pixels are in the drawable's format, see gimp_drawable_bpp().
+ *
+ * This bypasses the tile cache, call gimp_drawable_flush() first if
+ * the drawable's tiles have been modified.
+ *
+ * Returns: %TRUE if the pixels were read.
+ *
+ * Since: 2.10
+ **/
+gboolean
+gimp_tile_region_get (gint32   drawable_ID,
+                      gboolean shadow,
+                      gint     x,
+                      gint     y,
+                      gint     width,
+                      gint     height,
+                      guchar  *dest,
+                      gint     rowstride)
+{
+  gint bpp;
+
+  g_return_val_if_fail (width > 0 && height > 0, FALSE);
+  g_return_val_if_fail (dest != NULL, FALSE);
+
+  bpp = gimp_drawable_bpp (drawable_ID);
+
+  if (bpp <= 0)
+    return FALSE;
+
+  _gimp_tile_region_get (drawable_ID, shadow, x, y, width, height, bpp,
+                         dest, rowstride);
+
+  return TRUE;
+}
+
+/**
+ * gimp_tile_region_set:
+ * @drawable_ID: the drawable to write to
+ * @shadow:      whether to write to the drawable's shadow buffer
+ * @x:           x coordinate of the region
+ * @y:           y coordinate of the region
+ * @width:       width of the region
+ * @height:      height of the region
+ * @src:         the pixels to write
+ * @rowstride:   the rowstride of @src, or 0 for @width * bpp
+ *
+ * Writes a rectangle of pixels to the core, the counterpart of
+ * gimp_tile_region_get().
+ *
+ * Returns: %TRUE if the pixels were written.
+ *
+ * Since: 2.10
+ **/
+gboolean
+gimp_tile_region_set (gint32        drawable_ID,
+                      gboolean      shadow,
+                      gint          x,
+                      gint          y,
+                      gint          width,
+                      gint          height,
+                      const guchar *src,
+                      gint          rowstride)
+{
+  gint bpp;
+
+  g_return_val_if_fail (width > 0 && height > 0, FALSE);
+  g_return_val_if_fail (src != NULL, FALSE);
+
+  bpp = gimp_drawable_bpp (drawable_ID);
+
+  if (bpp <= 0)
+    return FALSE;
+
+  _gimp_tile_region_set (drawable_ID, shadow, x, y, width, height, bpp,
+                         src, rowstride);
+
+  return TRUE;
+}
+
+/**
+ * gimp_tile_region_map:
+ * @drawable_ID: the drawable to map
+ * @shadow:      whether to map the drawable's shadow buffer
+ * @x:           x coordinate of the region
+ * @y:           y coordinate of the region
+ * @width:       width of the region
+ * @height:      height of the region
+ * @read:        whether to fill the mapping with the drawable's pixels
+ *
+ * Maps a rectangle of pixels directly into the shared memory segment,
+ * so it can be processed without any copying on the plug-in side.
+ * The pixels are tightly packed with a rowstride of @width * bpp.
+ *
+ * The mapping is only valid until the next pixel transfer and must
+ * be released with gimp_tile_region_unmap() before any other one.
+ *
+ * Returns: a pointer into the shared memory segment, or %NULL if there
+ *          is no shared memory or the region doesn't fit into it.
+ *
+ * Since: 2.10
+ **/
+guchar *
+gimp_tile_region_map (gint32   drawable_ID,
+                      gboolean shadow,
+                      gint     x,
+                      gint     y,
+                      gint     width,
+                      gint     height,
+                      gboolean read)
+{
+  gint bpp;
+
+  g_return_val_if_fail (width > 0 && height > 0, NULL);
+  g_return_val_if_fail (mapped_region.drawable_ID == -1, NULL);
+
+  if (! gimp_shm_addr ())
+    return NULL;
+
+  bpp = gimp_drawable_bpp (drawable_ID);
+
+  if (bpp <= 0 ||
+      (gsize) width * height * bpp > gimp_tile_region_shm_size ())
+    return NULL;
+
+  if (read)
+    gimp_tile_region_get_band (drawable_ID, shadow,
+                               x, y, width, height, bpp,
+                               gimp_shm_addr (), width * bpp);
+
+  mapped_region.drawable_ID = drawable_ID;
+  mapped_region.shadow      = shadow;
+  mapped_region.x           = x;
+  mapped_region.y           = y;
+  mapped_region.width       = width;
+  mapped_region.height      = height;
+  mapped_region.bpp         = bpp;
+
+  return gimp_shm_addr ();
+}
+
+/**
+ * gimp_tile_region_unmap:
+ * @dirty: whether the mapped pixels have been modified
+ *
+ * Releases the mapping created by gimp_tile_region_map(), writing the
+ * pixels back to the core if @dirty is %TRUE.
+ *
+ * Since: 2.10
+ **/
+void
+gimp_tile_region_unmap (gboolean dirty)
+{
+  g_return_if_fail (mapped_region.drawable_ID != -1);
+
+  if (dirty)
+    {
+      gimp_tile_region_set_band (mapped_region.drawable_ID,
+                                 mapped_region.shadow,
+                                 mapped_region.x,
+                                 mapped_region.y,
+                                 mapped_region.width,
+                                 mapped_region.height,
+                                 mapped_region.bpp,
+                                 gimp_shm_addr (),
+                                 mapped_region.width * mapped_region.bpp);
+    }
+
+  mapped_region.drawable_ID = -1;
+}
+
+void
+_gimp_tile_region_get (gint32   drawable_ID,
+                       gboolean shadow,
+                       gint     x,
+                       gint     y,
+                       gint     width,
+                       gint     height,
+                       gint     bpp,
+                       guchar  *dest,
+                       gint     rowstride)
+{
+  gint band_height;
+  gint row;
+
+  if (rowstride == 0)
+    rowstride = width * bpp;
+
+  band_height = gimp_tile_region_shm_size () / ((gsize) width * bpp);
+  band_height = CLAMP (band_height, 1, height);
+
+  for (row = 0; row < height; row += band_height)
+    {
+      gimp_tile_region_get_band (drawable_ID, shadow,
+                                 x, y + row,
+                                 width, MIN (band_height, height - row),
+                                 bpp,
+                                 dest + (gsize) row * rowstride, rowstride);
+    }
+}
+
+void
+_gimp_tile_region_set (gint32        drawable_ID,
+                       gboolean      shadow,
+                       gint          x,
+                       gint          y,
+                       gint          width,
+                       gint          height,
+                       gint          bpp,
+                       const guchar *src,
+                       gint          rowstride)
+{
+  gint band_height;
+  gint row;
+
+  if (rowstride == 0)
+    rowstride = width * bpp;
+
+  band_height = gimp_tile_region_shm_size () / ((gsize) width * bpp);
+  band_height = CLAMP (band_height, 1, height);
+
+  for (row = 0; row < height; row += band_height)
+    {
+      gimp_tile_region_set_band (drawable_ID, shadow,
+                                 x, y + row,
+                                 width, MIN (band_height, height - row),
+                                 bpp,
+                                 src + (gsize) row * rowstride, rowstride);
+    }
+}
+
+/*  Transfers a region between the drawable and a slot of the plug-in's
+ *  tile arena, the core reads or writes the slot directly.
+ */
+void
+_gimp_tile_region_get_arena (gint32   drawable_ID,
+                             gboolean shadow,
+                             gint     x,
+                             gint     y,
+                             gint     width,
+                             gint     height,
+                             gint     bpp,
+                             guint32  arena_ID,
+                             guint32  offset,
+                             gint     rowstride)
+{
+  extern GIOChannel *_writechannel;
+
+  GPTileRegion     request = { 0, };
+  GPTileRegion    *region;
+  GimpWireMessage  msg;
+
+  request.drawable_ID = drawable_ID;
+  request.shadow      = shadow;
+  request.put         = FALSE;
+  request.x           = x;
+  request.y           = y;
+  request.width       = width;
+  request.height      = height;
+  request.arena_ID    = arena_ID;
+  request.offset      = offset;
+  request.rowstride   = rowstride;
+
+  if (! gp_tile_region_write (_writechannel, &request, NULL))
+    gimp_quit ();
+
+  gimp_read_expect_msg (&msg, GP_TILE_REGION);
+
+  region = msg.data;
+  if (region->drawable_ID != drawable_ID ||
+      region->x           != x           ||
+      region->y           != y           ||
+      region->width       != width       ||
+      region->height      != height      ||
+      region->bpp         != bpp         ||
+      region->arena_ID    != arena_ID)
+    {
+      g_message ("received region info did not match requested region");
+      gimp_quit ();
+    }
+
+  gimp_wire_destroy (&msg);
+}
+
+void
+_gimp_tile_region_set_arena (gint32   drawable_ID,
+                             gboolean shadow,
+                             gint     x,
+                             gint     y,
+                             gint     width,
+                             gint     height,
+                             gint     bpp,
+                             guint32  arena_ID,
+                             guint32  offset,
+                             gint     rowstride)
+{
+  extern GIOChannel *_writechannel;
+
+  GPTileRegion     region = { 0, };
+  GimpWireMessage  msg;
+
+  region.drawable_ID = drawable_ID;
+  region.shadow      = shadow;
+  region.put         = TRUE;
+  region.x           = x;
+  region.y           = y;
+  region.width       = width;
+  region.height      = height;
+  region.bpp         = bpp;
+  region.arena_ID    = arena_ID;
+  region.offset      = offset;
+  region.rowstride   = rowstride;
+
+  if (! gp_tile_region_write (_writechannel, &region, NULL))
+    gimp_quit ();
+
+  gimp_read_expect_msg (&msg, GP_TILE_ACK);
+  gimp_wire_destroy (&msg);
+}
+
 void
 _gimp_tile_cache_flush_drawable (GimpDrawable *drawable)
 {
@@ -184,6 +561,42 @@ _gimp_tile_cache_flush_drawable (GimpDrawable *drawable)
     }
 }
 
+/*  Writes back and drops the cached tiles of every #GimpDrawable
+ *  wrapping @drawable_ID, so the drawable can be accessed without
+ *  going through the tile cache.
+ */
+void
+_gimp_tile_cache_flush_drawable_id (gint32   drawable_ID,
+                                    gboolean shadow)
+{
+  GHashTable *tiles;
+  GList      *list;
+  GList      *iter;
+
+  if (! drawable_tile_table)
+    return;
+
+  tiles = g_hash_table_lookup (drawable_tile_table,
+                               gimp_tile_cache_drawable_key (drawable_ID,
+                                                             shadow));
+
+  if (! tiles)
+    return;
+
+  /*  flushing the last tile destroys the set, so walk a copy  */
+  list = g_hash_table_get_keys (tiles);
+
+  for (iter = list; iter; iter = g_list_next (iter))
+    {
+      GimpTile *tile = iter->data;
+
+      gimp_tile_flush (tile);
+      gimp_tile_cache_flush (tile);
+    }
+
+  g_list_free (list);
+}
+
 
 /*  private functions  */
 
@@ -283,6 +696,139 @@ gimp_tile_put (GimpTile *tile)
   gimp_wire_destroy (&msg);
 }
 
+static gsize
+gimp_tile_region_shm_size (void)
+{
+  gsize size = ((gsize) gimp_tile_width () * gimp_tile_height () *
+                GP_TILE_REGION_MAX_BPP * GP_SHM_N_TILES);
+
+  /*  the core won't read larger regions from the pipe  */
+  return MIN (size, GP_TILE_REGION_MAX_SIZE);
+}
+
+static void
+gimp_tile_region_copy_rows (guchar       *dest,
+                            gint          dest_stride,
+                            const guchar *src,
+                            gint          src_stride,
+                            gsize         row_size,
+                            gint          n_rows)
+{
+  gint row;
+
+  if (dest == src)
+    return;
+
+  if (dest_stride == row_size && src_stride == row_size)
+    {
+      memcpy (dest, src, row_size * n_rows);
+      return;
+    }
+
+  for (row = 0; row < n_rows; row++)
+    memcpy (dest + (gsize) row * dest_stride,
+            src  + (gsize) row * src_stride,
+            row_size);
+}
+
+static void
+gimp_tile_region_get_band (gint32   drawable_ID,
+                           gboolean shadow,
+                           gint     x,
+                           gint     y,
+                           gint     width,
+                           gint     height,
+                           gint     bpp,
+                           guchar  *dest,
+                           gint     rowstride)
+{
+  extern GIOChannel *_writechannel;
+
+  GPTileRegion     request = { 0, };
+  GPTileRegion    *region;
+  GimpWireMessage  msg;
+
+  request.drawable_ID = drawable_ID;
+  request.shadow      = shadow;
+  request.put         = FALSE;
+  request.x           = x;
+  request.y           = y;
+  request.width       = width;
+  request.height      = height;
+
+  if (! gp_tile_region_write (_writechannel, &request, NULL))
+    gimp_quit ();
+
+  gimp_read_expect_msg (&msg, GP_TILE_REGION);
+
+  region = msg.data;
+  if (region->drawable_ID != drawable_ID ||
+      region->x           != x           ||
+      region->y           != y           ||
+      region->width       != width       ||
+      region->height      != height      ||
+      region->bpp         != bpp)
+    {
+      g_message ("received region info did not match requested region");
+      gimp_quit ();
+    }
+
+  gimp_tile_region_copy_rows (dest, rowstride,
+                              region->use_shm ?
+                              gimp_shm_addr () : region->data,
+                              width * bpp,
+                              (gsize) width * bpp, height);
+
+  gimp_wire_destroy (&msg);
+}
+
+static void
+gimp_tile_region_set_band (gint32        drawable_ID,
+                           gboolean      shadow,
+                           gint          x,
+                           gint          y,
+                           gint          width,
+                           gint          height,
+                           gint          bpp,
+                           const guchar *src,
+                           gint          rowstride)
+{
+  extern GIOChannel *_writechannel;
+
+  GPTileRegion     region = { 0, };
+  GimpWireMessage  msg;
+  gsize            size = (gsize) width * height * bpp;
+
+  region.drawable_ID = drawable_ID;
+  region.shadow      = shadow;
+  region.put         = TRUE;
+  region.x           = x;
+  region.y           = y;
+  region.width       = width;
+  region.height      = height;
+  region.bpp         = bpp;
+  region.use_shm     = (gimp_shm_addr () &&
+                        size <= gimp_tile_region_shm_size ());
+
+  if (region.use_shm)
+    region.data = gimp_shm_addr ();
+  else
+    region.data = g_malloc (size);
+
+  gimp_tile_region_copy_rows (region.data, width * bpp,
+                              src, rowstride,
+                              (gsize) width * bpp, height);
+
+  if (! gp_tile_region_write (_writechannel, &region, NULL))
+    gimp_quit ();
+
+  if (! region.use_shm)
+    g_free (region.data);
+
+  gimp_read_expect_msg (&msg, GP_TILE_ACK);
+  gimp_wire_destroy (&msg);
+}
+
 /* This function is nearly identical to the function 'tile_cache_insert'
  *  in the file 'tile_cache.c' which is part of the main gimp application.
  */
@@ -295,6 +841,11 @@ gimp_tile_cache_insert (GimpTile *tile)
     {
       tile_hash_table = g_hash_table_new (g_direct_hash, NULL);
       max_tile_size = gimp_tile_width () * gimp_tile_height () * 4;
+
+      drawable_tile_table =
+        g_hash_table_new_full (g_direct_hash, NULL,
+                               NULL,
+                               (GDestroyNotify) g_hash_table_unref);
     }
 
   /* First check and see if the tile is already
@@ -356,6 +907,22 @@ gimp_tile_cache_insert (GimpTile *tile)
        */
       g_hash_table_insert (tile_hash_table, tile, tile_list_tail);
 
+      /* Add the tile to the set of its drawable.
+       */
+      {
+        gpointer    key   = gimp_tile_cache_drawable_key (tile->drawable->drawable_id,
+                                                          tile->shadow);
+        GHashTable *tiles = g_hash_table_lookup (drawable_tile_table, key);
+
+        if (! tiles)
+          {
+            tiles = g_hash_table_new (g_direct_hash, NULL);
+            g_hash_table_insert (drawable_tile_table, key, tiles);
+          }
+
+        g_hash_table_add (tiles, tile);
+      }
+
       /* Note the increase in the number of bytes the cache
        *  is referencing.
        */
@@ -398,6 +965,22 @@ gimp_tile_cache_flush (GimpTile *tile)
       g_hash_table_remove (tile_hash_table, tile);
       g_list_free (list);
 
+      /* Remove the tile from the set of its drawable.
+       */
+      {
+        gpointer    key   = gimp_tile_cache_drawable_key (tile->drawable->drawable_id,
+                                                          tile->shadow);
+        GHashTable *tiles = g_hash_table_lookup (drawable_tile_table, key);
+
+        if (tiles)
+          {
+            g_hash_table_remove (tiles, tile);
+
+            if (g_hash_table_size (tiles) == 0)
+              g_hash_table_remove (drawable_tile_table, key);
+          }
+      }
+
       /* Note the decrease in the number of bytes the cache
        *  is referencing.
        */
@@ -408,3 +991,10 @@ gimp_tile_cache_flush (GimpTile *tile)
       gimp_tile_unref (tile, FALSE);
     }
 }
+
+static gpointer
+gimp_tile_cache_drawable_key (gint32   drawable_ID,
+                              gboolean shadow)
+{
+  return GUINT_TO_POINTER (((guint) drawable_ID << 1) | (shadow ? 1 : 0));
+}
@@ -59,10 +59,77 @@ void    gimp_tile_cache_size   (gulong     kilobytes);
 GIMP_DEPRECATED
 void    gimp_tile_cache_ntiles (gulong     ntiles);
 
+gboolean gimp_tile_region_get   (gint32        drawable_ID,
+                                 gboolean      shadow,
+                                 gint          x,
+                                 gint          y,
+                                 gint          width,
+                                 gint          height,
+                                 guchar       *dest,
+                                 gint          rowstride);
+gboolean gimp_tile_region_set   (gint32        drawable_ID,
+                                 gboolean      shadow,
+                                 gint          x,
+                                 gint          y,
+                                 gint          width,
+                                 gint          height,
+                                 const guchar *src,
+                                 gint          rowstride);
+guchar * gimp_tile_region_map   (gint32        drawable_ID,
+                                 gboolean      shadow,
+                                 gint          x,
+                                 gint          y,
+                                 gint          width,
+                                 gint          height,
+                                 gboolean      read);
+void     gimp_tile_region_unmap (gboolean      dirty);
+
 
 /*  private function  */
 
-G_GNUC_INTERNAL void _gimp_tile_cache_flush_drawable (GimpDrawable *drawable);
+G_GNUC_INTERNAL void _gimp_tile_cache_flush_drawable    (GimpDrawable *drawable);
+G_GNUC_INTERNAL void _gimp_tile_cache_flush_drawable_id (gint32        drawable_ID,
+                                                         gboolean      shadow);
+
+G_GNUC_INTERNAL void _gimp_tile_region_get (gint32        drawable_ID,
+                                            gboolean      shadow,
+                                            gint          x,
+                                            gint          y,
+                                            gint          width,
+                                            gint          height,
+                                            gint          bpp,
+                                            guchar       *dest,
+                                            gint          rowstride);
+G_GNUC_INTERNAL void _gimp_tile_region_set (gint32        drawable_ID,
+                                            gboolean      shadow,
+                                            gint          x,
+                                            gint          y,
+                                            gint          width,
+                                            gint          height,
+                                            gint          bpp,
+                                            const guchar *src,
+                                            gint          rowstride);
+
+G_GNUC_INTERNAL void _gimp_tile_region_get_arena (gint32   drawable_ID,
+                                                  gboolean shadow,
+                                                  gint     x,
+                                                  gint     y,
+                                                  gint     width,
+                                                  gint     height,
+                                                  gint     bpp,
+                                                  guint32  arena_ID,
+                                                  guint32  offset,
+                                                  gint     rowstride);
+G_GNUC_INTERNAL void _gimp_tile_region_set_arena (gint32   drawable_ID,
+                                                  gboolean shadow,
+                                                  gint     x,
+                                                  gint     y,
+                                                  gint     width,
+                                                  gint     height,
+                                                  gint     bpp,
+                                                  guint32  arena_ID,
+                                                  guint32  offset,
+                                                  gint     rowstride);
 
 
 G_END_DECLS
@@ -0,0 +1,348 @@
+/* LIBGIMP - The GNU Image Manipulation Program Library
+ * Copyright (C) 1995-1997 Peter Mattis and Spencer Kimball
+ *
+ * gimptilearena.c
+ *
+ * This library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/types.h>
+
+#if defined(USE_SYSV_SHM)
+
+#ifdef HAVE_IPC_H
+#include <sys/ipc.h>
+#endif
+
+#ifdef HAVE_SHM_H
+#include <sys/shm.h>
+#endif
+
+#elif defined(USE_POSIX_SHM)
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include <fcntl.h>
+#include <sys/mman.h>
+
+#endif /* USE_POSIX_SHM */
+
+#include <gegl.h>
+
+#if defined(G_OS_WIN32) || defined(G_WITH_CYGWIN)
+#  define STRICT
+#  include <windows.h>
+#  undef RGB
+#  define USE_WIN32_SHM 1
+#endif
+
+#include "libgimpbase/gimpprotocol.h"
+#include "libgimpbase/gimpwire.h"
+
+#include "gimp.h"
+#include "gimptilearena.h"
+
+
+/*  The tile arena is a piece of shared memory of this plug-in alone,
+ *  the GEGL tiles of the plug-in's drawable buffers live in it.  The
+ *  core reads and writes a slot only while handling the GP_TILE_REGION
+ *  message naming it, which the plug-in waits for, so the plug-in owns
+ *  every slot at all other times and needs no locking with the core.
+ *
+ *  The arena is mapped for the lifetime of the plug-in, the core
+ *  releases it when the plug-in exits.
+ */
+
+#define ARENA_SIZE       (32 * 1024 * 1024)
+#define ARENA_PAGE_SIZE  (16 * 1024)
+#define ARENA_N_PAGES    (ARENA_SIZE / ARENA_PAGE_SIZE)
+
+
+struct _GimpTileArena
+{
+  guint32   arena_ID;
+  guchar   *addr;
+  gsize     size;
+
+  GMutex    mutex;
+  guint16   slot_pages[ARENA_N_PAGES]; /*  pages of the slot starting at
+                                        *  each page, 0 if none starts there
+                                        */
+  guint8    used[ARENA_N_PAGES];
+  gint      first_free;
+};
+
+
+void           gimp_read_expect_msg    (GimpWireMessage *msg,
+                                        gint             type);
+
+static guchar * gimp_tile_arena_attach (guint32          arena_ID,
+                                        gint32           shm_ID,
+                                        gsize            size);
+
+
+/*  private variables  */
+
+static GimpTileArena *tile_arena        = NULL;
+static gboolean       tile_arena_failed = FALSE;
+
+
+/*  public functions  */
+
+/*  Returns the plug-in's tile arena, asking the core for it the first
+ *  time, or NULL if there is none.  Callers then fall back to copying
+ *  pixels through the regular region transfers.
+ */
+GimpTileArena *
+_gimp_tile_arena_get (void)
+{
+  extern GIOChannel *_writechannel;
+
+  GPTileArena      request = { 0, ARENA_SIZE, -1 };
+  GPTileArena     *reply;
+  GimpWireMessage  msg;
+  guchar          *addr    = NULL;
+
+  if (tile_arena || tile_arena_failed)
+    return tile_arena;
+
+  tile_arena_failed = TRUE;
+
+  if (g_getenv ("GIMP_NO_TILE_ARENA"))
+    return NULL;
+
+  if (! gp_tile_arena_write (_writechannel, &request, NULL))
+    gimp_quit ();
+
+  gimp_read_expect_msg (&msg, GP_TILE_ARENA);
+
+  reply = msg.data;
+
+  if (reply->arena_ID && reply->size == ARENA_SIZE)
+    addr = gimp_tile_arena_attach (reply->arena_ID, reply->shm_ID,
+                                   reply->size);
+
+  if (addr)
+    {
+      tile_arena = g_slice_new0 (GimpTileArena);
+
+      tile_arena->arena_ID = reply->arena_ID;
+      tile_arena->addr     = addr;
+      tile_arena->size     = reply->size;
+
+      g_mutex_init (&tile_arena->mutex);
+
+      tile_arena_failed = FALSE;
+    }
+
+  gimp_wire_destroy (&msg);
+
+  return tile_arena;
+}
+
+guint32
+_gimp_tile_arena_get_ID (GimpTileArena *arena)
+{
+  g_return_val_if_fail (arena != NULL, 0);
+
+  return arena->arena_ID;
+}
+
+/*  Returns a slot of at least @size bytes, or NULL if the arena is
+ *  full.  The slot is freed with _gimp_tile_arena_free(), which can
+ *  be used as the GDestroyNotify of GEGL tile data.
+ */
+guchar *
+_gimp_tile_arena_alloc (GimpTileArena *arena,
+                        gsize          size)
+{
+  gint    n_pages;
+  gint    start;
+  gint    run   = 0;
+  guchar *slot  = NULL;
+  gint    i;
+
+  g_return_val_if_fail (arena != NULL, NULL);
+  g_return_val_if_fail (size > 0, NULL);
+
+  n_pages = (size + ARENA_PAGE_SIZE - 1) / ARENA_PAGE_SIZE;
+
+  if (n_pages > ARENA_N_PAGES)
+    return NULL;
+
+  g_mutex_lock (&arena->mutex);
+
+  for (i = start = arena->first_free; i < ARENA_N_PAGES; i++)
+    {
+      if (arena->used[i])
+        {
+          start = i + 1;
+          run   = 0;
+
+          continue;
+        }
+
+      if (++run == n_pages)
+        break;
+    }
+
+  if (run == n_pages)
+    {
+      memset (arena->used + start, 1, n_pages);
+      arena->slot_pages[start] = n_pages;
+
+      if (start == arena->first_free)
+        arena->first_free = start + n_pages;
+
+      slot = arena->addr + (gsize) start * ARENA_PAGE_SIZE;
+    }
+
+  g_mutex_unlock (&arena->mutex);
+
+  return slot;
+}
+
+void
+_gimp_tile_arena_free (gpointer data)
+{
+  GimpTileArena *arena = tile_arena;
+  gint           start;
+  gint           n_pages;
+
+  g_return_if_fail (arena != NULL);
+  g_return_if_fail (_gimp_tile_arena_contains (arena, data, 1, NULL));
+
+  start = ((guchar *) data - arena->addr) / ARENA_PAGE_SIZE;
+
+  g_mutex_lock (&arena->mutex);
+
+  n_pages = arena->slot_pages[start];
+
+  g_warn_if_fail (n_pages > 0);
+
+  memset (arena->used + start, 0, n_pages);
+  arena->slot_pages[start] = 0;
+
+  arena->first_free = MIN (arena->first_free, start);
+
+  g_mutex_unlock (&arena->mutex);
+}
+
+/*  Returns whether the @size bytes at @data are in the arena, and
+ *  their @offset in it.
+ */
+gboolean
+_gimp_tile_arena_contains (GimpTileArena *arena,
+                           const guchar  *data,
+                           gsize          size,
+                           guint32       *offset)
+{
+  g_return_val_if_fail (arena != NULL, FALSE);
+
+  if (data < arena->addr || data + size > arena->addr + arena->size)
+    return FALSE;
+
+  if (offset)
+    *offset = data - arena->addr;
+
+  return TRUE;
+}
+
+
+/*  private functions  */
+
+/*  see gimp_plug_in_shm_new_internal() in the core  */
+static guchar *
+gimp_tile_arena_attach (guint32 arena_ID,
+                        gint32  shm_ID,
+                        gsize   size)
+{
+  guchar *addr = NULL;
+
+#if defined(USE_SYSV_SHM)
+
+  addr = (guchar *) shmat (shm_ID, NULL, 0);
+
+  if (addr == (guchar *) -1)
+    {
+      g_printerr ("shmat() failed: %s\n", g_strerror (errno));
+      addr = NULL;
+    }
+
+#elif defined(USE_WIN32_SHM)
+
+  gchar  fileMapName[128];
+  HANDLE handle;
+
+  g_snprintf (fileMapName, sizeof (fileMapName), "GIMP%d-%u.SHM",
+              shm_ID, arena_ID);
+
+  handle = OpenFileMapping (FILE_MAP_ALL_ACCESS, 0, fileMapName);
+
+  if (handle)
+    {
+      addr = (guchar *) MapViewOfFile (handle, FILE_MAP_ALL_ACCESS,
+                                       0, 0, size);
+
+      if (! addr)
+        g_printerr ("MapViewOfFile error: %d\n", GetLastError ());
+
+      /*  the view keeps the mapping alive  */
+      CloseHandle (handle);
+    }
+  else
+    {
+      g_printerr ("OpenFileMapping error: %d\n", GetLastError ());
+    }
+
+#elif defined(USE_POSIX_SHM)
+
+  gchar map_file[32];
+  gint  shm_fd;
+
+  g_snprintf (map_file, sizeof (map_file), "/gimp-shm-%d-%u",
+              shm_ID, arena_ID);
+
+  shm_fd = shm_open (map_file, O_RDWR, 0600);
+
+  if (shm_fd != -1)
+    {
+      addr = (guchar *) mmap (NULL, size,
+                              PROT_READ | PROT_WRITE, MAP_SHARED,
+                              shm_fd, 0);
+
+      if (addr == MAP_FAILED)
+        {
+          g_printerr ("mmap() failed: %s\n", g_strerror (errno));
+          addr = NULL;
+        }
+
+      close (shm_fd);
+    }
+  else
+    {
+      g_printerr ("shm_open() failed: %s\n", g_strerror (errno));
+    }
+
+#endif
+
+  return addr;
+}
@@ -0,0 +1,46 @@
+/* LIBGIMP - The GNU Image Manipulation Program Library
+ * Copyright (C) 1995-1997 Peter Mattis and Spencer Kimball
+ *
+ * gimptilearena.h
+ *
+ * This library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GIMP_TILE_ARENA_H__
+#define __GIMP_TILE_ARENA_H__
+
+G_BEGIN_DECLS
+
+
+typedef struct _GimpTileArena GimpTileArena;
+
+
+G_GNUC_INTERNAL GimpTileArena * _gimp_tile_arena_get      (void);
+
+G_GNUC_INTERNAL guint32         _gimp_tile_arena_get_ID   (GimpTileArena *arena);
+
+G_GNUC_INTERNAL guchar        * _gimp_tile_arena_alloc    (GimpTileArena *arena,
+                                                           gsize          size);
+G_GNUC_INTERNAL void            _gimp_tile_arena_free     (gpointer       data);
+
+G_GNUC_INTERNAL gboolean        _gimp_tile_arena_contains (GimpTileArena *arena,
+                                                           const guchar  *data,
+                                                           gsize          size,
+                                                           guint32       *offset);
+
+
+G_END_DECLS
+
+#endif /* __GIMP_TILE_ARENA_H__ */
@@ -25,6 +25,7 @@
 #define GIMP_DISABLE_DEPRECATION_WARNINGS
 
 #include "gimp.h"
+#include "gimptilearena.h"
 #include "gimptilebackendplugin.h"
 
 
@@ -71,12 +72,17 @@ static gpointer gimp_tile_backend_plugin_command  (GeglTileSource  *tile_store,
 static void       gimp_tile_write_mul (GimpTileBackendPlugin *backend_plugin,
                                        gint                   x,
                                        gint                   y,
-                                       guchar                *source);
+                                       GeglTile              *tile);
 
 static GeglTile * gimp_tile_read_mul (GimpTileBackendPlugin *backend_plugin,
                                       gint                   x,
                                       gint                   y);
 
+static gboolean   gimp_tile_get_rect (GimpTileBackendPlugin *backend_plugin,
+                                      gint                   x,
+                                      gint                   y,
+                                      GeglRectangle         *rect);
+
 
 G_DEFINE_TYPE (GimpTileBackendPlugin, _gimp_tile_backend_plugin,
                GEGL_TYPE_TILE_BACKEND)
@@ -135,7 +141,7 @@ gimp_tile_backend_plugin_command (GeglTileSource  *tile_store,
       return gimp_tile_read_mul (backend_plugin, x, y);
 
     case GEGL_TILE_SET:
-      gimp_tile_write_mul (backend_plugin, x, y, gegl_tile_get_data (data));
+      gimp_tile_write_mul (backend_plugin, x, y, data);
       gegl_tile_mark_as_stored (data);
       break;
 
@@ -150,6 +156,40 @@ gimp_tile_backend_plugin_command (GeglTileSource  *tile_store,
   return NULL;
 }
 
+static gboolean
+gimp_tile_get_rect (GimpTileBackendPlugin *backend_plugin,
+                    gint                   x,
+                    gint                   y,
+                    GeglRectangle         *rect)
+{
+  GimpTileBackendPluginPrivate *priv = backend_plugin->priv;
+  gint                          tile_width;
+  gint                          tile_height;
+
+  tile_width  = TILE_WIDTH  * priv->mul;
+  tile_height = TILE_HEIGHT * priv->mul;
+
+  return gegl_rectangle_intersect (rect,
+                                   GEGL_RECTANGLE (x * tile_width,
+                                                   y * tile_height,
+                                                   tile_width,
+                                                   tile_height),
+                                   GEGL_RECTANGLE (0, 0,
+                                                   priv->drawable->width,
+                                                   priv->drawable->height));
+}
+
+/*  GEGL tiles are transferred as a whole with a single region message
+ *  each, instead of going through the per-tile legacy tile cache.  Tiles
+ *  the plug-in got from gimp_drawable_get_tile() or a GimpPixelRgn are
+ *  written back and dropped from the cache first, so we neither read
+ *  stale pixels nor leave stale tiles behind after writing.
+ *
+ *  If we have a tile arena, the tile data lives in a slot of it and the
+ *  core reads and writes the slot directly, the pixels then neither go
+ *  through the pipe nor get copied on our side.  Otherwise, or when the
+ *  arena is full, they are copied through the regular shared memory.
+ */
 static GeglTile *
 gimp_tile_read_mul (GimpTileBackendPlugin *backend_plugin,
                     gint                   x,
@@ -157,52 +197,55 @@ gimp_tile_read_mul (GimpTileBackendPlugin *backend_plugin,
 {
   GimpTileBackendPluginPrivate *priv    = backend_plugin->priv;
   GeglTileBackend              *backend = GEGL_TILE_BACKEND (backend_plugin);
+  GimpTileArena                *arena   = _gimp_tile_arena_get ();
   GeglTile                     *tile;
+  GeglRectangle                 rect;
+  guchar                       *slot    = NULL;
   gint                          tile_size;
-  gint                          u, v;
-  gint                          mul = priv->mul;
-  guchar                       *tile_data;
+  gint                          bpp     = priv->drawable->bpp;
+
+  tile_size = gegl_tile_backend_get_tile_size (backend);
 
-  x *= mul;
-  y *= mul;
+  if (arena)
+    slot = _gimp_tile_arena_alloc (arena, tile_size);
 
-  tile_size  = gegl_tile_backend_get_tile_size (backend);
-  tile       = gegl_tile_new (tile_size);
-  tile_data  = gegl_tile_get_data (tile);
+  if (slot)
+    {
+      tile = gegl_tile_new_bare ();
+
+      gegl_tile_set_data_full (tile, slot, tile_size,
+                               _gimp_tile_arena_free, slot);
+    }
+  else
+    {
+      tile = gegl_tile_new (tile_size);
+    }
 
-  for (u = 0; u < mul; u++)
+  if (gimp_tile_get_rect (backend_plugin, x, y, &rect))
     {
-      for (v = 0; v < mul; v++)
+      _gimp_tile_cache_flush_drawable_id (priv->drawable->drawable_id,
+                                          priv->shadow);
+
+      if (slot)
+        {
+          guint32 offset;
+
+          _gimp_tile_arena_contains (arena, slot, tile_size, &offset);
+
+          _gimp_tile_region_get_arena (priv->drawable->drawable_id,
+                                       priv->shadow,
+                                       rect.x, rect.y,
+                                       rect.width, rect.height, bpp,
+                                       _gimp_tile_arena_get_ID (arena),
+                                       offset,
+                                       TILE_WIDTH * priv->mul * bpp);
+        }
+      else
         {
-          GimpTile *gimp_tile;
-
-          if (x + u >= priv->drawable->ntile_cols ||
-              y + v >= priv->drawable->ntile_rows)
-            continue;
-
-          gimp_tile = gimp_drawable_get_tile (priv->drawable,
-                                              priv->shadow,
-                                              y + v, x + u);
-          gimp_tile_ref (gimp_tile);
-
-          {
-            gint ewidth           = gimp_tile->ewidth;
-            gint eheight          = gimp_tile->eheight;
-            gint bpp              = gimp_tile->bpp;
-            gint tile_stride      = mul * TILE_WIDTH * bpp;
-            gint gimp_tile_stride = ewidth * bpp;
-            gint row;
-
-            for (row = 0; row < eheight; row++)
-              {
-                memcpy (tile_data + (row + TILE_HEIGHT * v) *
-                        tile_stride + u * TILE_WIDTH * bpp,
-                        ((gchar *) gimp_tile->data) + row * gimp_tile_stride,
-                        gimp_tile_stride);
-              }
-          }
-
-          gimp_tile_unref (gimp_tile, FALSE);
+          _gimp_tile_region_get (priv->drawable->drawable_id, priv->shadow,
+                                 rect.x, rect.y, rect.width, rect.height, bpp,
+                                 gegl_tile_get_data (tile),
+                                 TILE_WIDTH * priv->mul * bpp);
         }
     }
 
@@ -213,46 +256,41 @@ static void
 gimp_tile_write_mul (GimpTileBackendPlugin *backend_plugin,
                      gint                   x,
                      gint                   y,
-                     guchar                *source)
+                     GeglTile              *tile)
 {
-  GimpTileBackendPluginPrivate *priv = backend_plugin->priv;
-  gint                          u, v;
-  gint                          mul = priv->mul;
-
-  x *= mul;
-  y *= mul;
+  GimpTileBackendPluginPrivate *priv    = backend_plugin->priv;
+  GeglTileBackend              *backend = GEGL_TILE_BACKEND (backend_plugin);
+  GimpTileArena                *arena   = _gimp_tile_arena_get ();
+  guchar                       *data    = gegl_tile_get_data (tile);
+  GeglRectangle                 rect;
+  guint32                       offset;
+  gint                          bpp     = priv->drawable->bpp;
 
-  for (v = 0; v < mul; v++)
+  if (gimp_tile_get_rect (backend_plugin, x, y, &rect))
     {
-      for (u = 0; u < mul; u++)
+      _gimp_tile_cache_flush_drawable_id (priv->drawable->drawable_id,
+                                          priv->shadow);
+
+      /*  tiles GEGL made or uncloned itself are not in the arena  */
+      if (arena &&
+          _gimp_tile_arena_contains (arena, data,
+                                     gegl_tile_backend_get_tile_size (backend),
+                                     &offset))
+        {
+          _gimp_tile_region_set_arena (priv->drawable->drawable_id,
+                                       priv->shadow,
+                                       rect.x, rect.y,
+                                       rect.width, rect.height, bpp,
+                                       _gimp_tile_arena_get_ID (arena),
+                                       offset,
+                                       TILE_WIDTH * priv->mul * bpp);
+        }
+      else
         {
-          GimpTile *gimp_tile;
-
-          if (x + u >= priv->drawable->ntile_cols ||
-              y + v >= priv->drawable->ntile_rows)
-            continue;
-
-          gimp_tile = gimp_drawable_get_tile (priv->drawable,
-                                              priv->shadow,
-                                              y+v, x+u);
-          gimp_tile_ref (gimp_tile);
-
-          {
-            gint ewidth           = gimp_tile->ewidth;
-            gint eheight          = gimp_tile->eheight;
-            gint bpp              = gimp_tile->bpp;
-            gint tile_stride      = mul * TILE_WIDTH * bpp;
-            gint gimp_tile_stride = ewidth * bpp;
-            gint row;
-
-            for (row = 0; row < eheight; row++)
-              memcpy (((gchar *)gimp_tile->data) + row * gimp_tile_stride,
-                      source + (row + v * TILE_HEIGHT) *
-                      tile_stride + u * TILE_WIDTH * bpp,
-                      gimp_tile_stride);
-          }
-
-          gimp_tile_unref (gimp_tile, TRUE);
+          _gimp_tile_region_set (priv->drawable->drawable_id, priv->shadow,
+                                 rect.x, rect.y, rect.width, rect.height, bpp,
+                                 data,
+                                 TILE_WIDTH * priv->mul * bpp);
         }
     }
 }
@@ -21,6 +21,7 @@
 #include <glib-object.h>
 
 #include "gimpbasetypes.h"
+#include "gimplimits.h"
 
 #include "gimpparasite.h"
 #include "gimpprotocol.h"
@@ -67,6 +68,22 @@ static void _gp_tile_data_write          (GIOChannel       *channel,
                                           gpointer          user_data);
 static void _gp_tile_data_destroy        (GimpWireMessage  *msg);
 
+static void _gp_tile_region_read         (GIOChannel       *channel,
+                                          GimpWireMessage  *msg,
+                                          gpointer          user_data);
+static void _gp_tile_region_write        (GIOChannel       *channel,
+                                          GimpWireMessage  *msg,
+                                          gpointer          user_data);
+static void _gp_tile_region_destroy      (GimpWireMessage  *msg);
+
+static void _gp_tile_arena_read          (GIOChannel       *channel,
+                                          GimpWireMessage  *msg,
+                                          gpointer          user_data);
+static void _gp_tile_arena_write         (GIOChannel       *channel,
+                                          GimpWireMessage  *msg,
+                                          gpointer          user_data);
+static void _gp_tile_arena_destroy       (GimpWireMessage  *msg);
+
 static void _gp_proc_run_read            (GIOChannel       *channel,
                                           GimpWireMessage  *msg,
                                           gpointer          user_data);
@@ -197,6 +214,14 @@ gp_init (void)
                       _gp_has_init_read,
                       _gp_has_init_write,
                       _gp_has_init_destroy);
+  gimp_wire_register (GP_TILE_REGION,
+                      _gp_tile_region_read,
+                      _gp_tile_region_write,
+                      _gp_tile_region_destroy);
+  gimp_wire_register (GP_TILE_ARENA,
+                      _gp_tile_arena_read,
+                      _gp_tile_arena_write,
+                      _gp_tile_arena_destroy);
 }
 
 gboolean
@@ -292,6 +317,44 @@ gp_tile_data_write (GIOChannel *channel,
   return TRUE;
 }
 
+gboolean
+gp_tile_region_write (GIOChannel   *channel,
+                      GPTileRegion *tile_region,
+                      gpointer      user_data)
+{
+  GimpWireMessage msg;
+
+  msg.type = GP_TILE_REGION;
+  msg.data = tile_region;
+
+  if (! gimp_wire_write_msg (channel, &msg, user_data))
+    return FALSE;
+
+  if (! gimp_wire_flush (channel, user_data))
+    return FALSE;
+
+  return TRUE;
+}
+
+gboolean
+gp_tile_arena_write (GIOChannel  *channel,
+                     GPTileArena *tile_arena,
+                     gpointer     user_data)
+{
+  GimpWireMessage msg;
+
+  msg.type = GP_TILE_ARENA;
+  msg.data = tile_arena;
+
+  if (! gimp_wire_write_msg (channel, &msg, user_data))
+    return FALSE;
+
+  if (! gimp_wire_flush (channel, user_data))
+    return FALSE;
+
+  return TRUE;
+}
+
 gboolean
 gp_proc_run_write (GIOChannel *channel,
                    GPProcRun  *proc_run,
@@ -1868,3 +1931,232 @@ static void
 _gp_has_init_destroy (GimpWireMessage *msg)
 {
 }
+
+/*  tile_region  */
+
+static void
+_gp_tile_region_read (GIOChannel      *channel,
+                      GimpWireMessage *msg,
+                      gpointer         user_data)
+{
+  GPTileRegion *tile_region = g_slice_new0 (GPTileRegion);
+
+  if (! _gimp_wire_read_int32 (channel,
+                               (guint32 *) &tile_region->drawable_ID, 1,
+                               user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &tile_region->shadow, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &tile_region->put, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               (guint32 *) &tile_region->x, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               (guint32 *) &tile_region->y, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &tile_region->width, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &tile_region->height, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &tile_region->bpp, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &tile_region->use_shm, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &tile_region->arena_ID, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &tile_region->offset, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &tile_region->rowstride, 1, user_data))
+    goto cleanup;
+
+  if (! tile_region->use_shm && ! tile_region->arena_ID &&
+      tile_region->bpp > 0)
+    {
+      guint64 row_size;
+      guint64 length;
+
+      /*  the size comes from the other side of the pipe, don't
+       *  allocate whatever it says.  Widths and heights are bounded,
+       *  so the products can't overflow 64 bits
+       */
+      if (tile_region->bpp    > GP_TILE_REGION_MAX_BPP ||
+          tile_region->width  > GIMP_MAX_IMAGE_SIZE    ||
+          tile_region->height > GIMP_MAX_IMAGE_SIZE)
+        goto bad_size;
+
+      row_size = (guint64) tile_region->width * tile_region->bpp;
+      length   = row_size * tile_region->height;
+
+      if (length > GP_TILE_REGION_MAX_SIZE && tile_region->height > 1)
+        goto bad_size;
+
+      tile_region->data = g_try_malloc (length);
+
+      if (! tile_region->data)
+        {
+          g_printerr ("%s: failed to allocate %" G_GUINT64_FORMAT " bytes\n",
+                      G_STRFUNC, length);
+          _gimp_wire_set_error ();
+          goto cleanup;
+        }
+
+      if (! _gimp_wire_read_int8 (channel,
+                                  (guint8 *) tile_region->data, length,
+                                  user_data))
+        goto cleanup;
+    }
+
+  msg->data = tile_region;
+  return;
+
+ bad_size:
+  g_printerr ("%s: invalid region of %u x %u pixels, %u bytes each\n",
+              G_STRFUNC,
+              tile_region->width, tile_region->height, tile_region->bpp);
+
+  /*  the pixels that follow can't be skipped  */
+  _gimp_wire_set_error ();
+
+ cleanup:
+  g_free (tile_region->data);
+  g_slice_free (GPTileRegion, tile_region);
+  msg->data = NULL;
+}
+
+static void
+_gp_tile_region_write (GIOChannel      *channel,
+                       GimpWireMessage *msg,
+                       gpointer         user_data)
+{
+  GPTileRegion *tile_region = msg->data;
+
+  if (! _gimp_wire_write_int32 (channel,
+                                (const guint32 *) &tile_region->drawable_ID, 1,
+                                user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &tile_region->shadow, 1, user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &tile_region->put, 1, user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                (const guint32 *) &tile_region->x, 1,
+                                user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                (const guint32 *) &tile_region->y, 1,
+                                user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &tile_region->width, 1, user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &tile_region->height, 1, user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &tile_region->bpp, 1, user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &tile_region->use_shm, 1, user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &tile_region->arena_ID, 1, user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &tile_region->offset, 1, user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &tile_region->rowstride, 1, user_data))
+    return;
+
+  if (! tile_region->use_shm && ! tile_region->arena_ID &&
+      tile_region->bpp > 0)
+    {
+      gsize length = ((gsize) tile_region->width  *
+                      (gsize) tile_region->height *
+                      (gsize) tile_region->bpp);
+
+      if (! _gimp_wire_write_int8 (channel,
+                                   (const guint8 *) tile_region->data, length,
+                                   user_data))
+        return;
+    }
+}
+
+static void
+_gp_tile_region_destroy (GimpWireMessage *msg)
+{
+  GPTileRegion *tile_region = msg->data;
+
+  if (tile_region)
+    {
+      g_free (tile_region->data);
+      g_slice_free (GPTileRegion, tile_region);
+    }
+}
+
+/*  tile_arena  */
+
+static void
+_gp_tile_arena_read (GIOChannel      *channel,
+                     GimpWireMessage *msg,
+                     gpointer         user_data)
+{
+  GPTileArena *tile_arena = g_slice_new0 (GPTileArena);
+
+  if (! _gimp_wire_read_int32 (channel,
+                               &tile_arena->arena_ID, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               &tile_arena->size, 1, user_data))
+    goto cleanup;
+  if (! _gimp_wire_read_int32 (channel,
+                               (guint32 *) &tile_arena->shm_ID, 1, user_data))
+    goto cleanup;
+
+  msg->data = tile_arena;
+  return;
+
+ cleanup:
+  g_slice_free (GPTileArena, tile_arena);
+  msg->data = NULL;
+}
+
+static void
+_gp_tile_arena_write (GIOChannel      *channel,
+                      GimpWireMessage *msg,
+                      gpointer         user_data)
+{
+  GPTileArena *tile_arena = msg->data;
+
+  if (! _gimp_wire_write_int32 (channel,
+                                &tile_arena->arena_ID, 1, user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                &tile_arena->size, 1, user_data))
+    return;
+  if (! _gimp_wire_write_int32 (channel,
+                                (const guint32 *) &tile_arena->shm_ID, 1,
+                                user_data))
+    return;
+}
+
+static void
+_gp_tile_arena_destroy (GimpWireMessage *msg)
+{
+  GPTileArena *tile_arena = msg->data;
+
+  if (tile_arena)
+    g_slice_free (GPTileArena, tile_arena);
+}
@@ -26,7 +26,25 @@ G_BEGIN_DECLS
 
 /* Increment every time the protocol changes
  */
-#define GIMP_PROTOCOL_VERSION  0x0014
+#define GIMP_PROTOCOL_VERSION  0x0016
+
+
+/* The shared memory segment is large enough for this many tiles of
+ * 16 bytes per pixel, GP_TILE_REGION transfers regions of up to that
+ * size through it in one go.
+ */
+#define GP_SHM_N_TILES  64
+
+/* The largest GP_TILE_REGION that may carry its pixels in the message,
+ * unless it is a single row, and the most bytes per pixel it can have.
+ */
+#define GP_TILE_REGION_MAX_BPP   16
+#define GP_TILE_REGION_MAX_SIZE  (128 * 128 * GP_TILE_REGION_MAX_BPP * \
+                                  GP_SHM_N_TILES)
+
+/* The largest tile arena a plug-in may ask for.
+ */
+#define GP_TILE_ARENA_MAX_SIZE   (64 * 1024 * 1024)
 
 
 enum
@@ -43,7 +61,9 @@ enum
   GP_PROC_INSTALL,
   GP_PROC_UNINSTALL,
   GP_EXTENSION_ACK,
-  GP_HAS_INIT
+  GP_HAS_INIT,
+  GP_TILE_REGION,
+  GP_TILE_ARENA
 };
 
 
@@ -51,6 +71,8 @@ typedef struct _GPConfig        GPConfig;
 typedef struct _GPTileReq       GPTileReq;
 typedef struct _GPTileAck       GPTileAck;
 typedef struct _GPTileData      GPTileData;
+typedef struct _GPTileRegion    GPTileRegion;
+typedef struct _GPTileArena     GPTileArena;
 typedef struct _GPParam         GPParam;
 typedef struct _GPParamDef      GPParamDef;
 typedef struct _GPProcRun       GPProcRun;
@@ -103,6 +125,43 @@ struct _GPTileData
   guchar  *data;
 };
 
+/* A GP_TILE_REGION with put == FALSE and bpp == 0 requests a region,
+ * the core answers with a GP_TILE_REGION carrying the pixels.  One
+ * with put == TRUE carries pixels to write and is answered with a
+ * GP_TILE_ACK.  The pixel data is only part of the message if it
+ * doesn't go through shared memory.  If arena_ID is set, the pixels
+ * are in that tile arena, at offset and rowstride bytes apart.
+ */
+struct _GPTileRegion
+{
+  gint32   drawable_ID;
+  guint32  shadow;
+  guint32  put;
+  gint32   x;
+  gint32   y;
+  guint32  width;
+  guint32  height;
+  guint32  bpp;
+  guint32  use_shm;
+  guint32  arena_ID;
+  guint32  offset;
+  guint32  rowstride;
+  guchar  *data;
+};
+
+/* A shared memory segment of a single plug-in.  The plug-in keeps
+ * GEGL tile data in it, and GP_TILE_REGION messages naming the arena
+ * carry an offset into it instead of pixels.  The core only touches
+ * the arena while handling such a message, the plug-in owns it the
+ * rest of the time.
+ */
+struct _GPTileArena
+{
+  guint32  arena_ID;
+  guint32  size;
+  gint32   shm_ID;
+};
+
 struct _GPParam
 {
   guint32 type;
@@ -202,6 +261,12 @@ gboolean  gp_tile_ack_write         (GIOChannel      *channel,
 gboolean  gp_tile_data_write        (GIOChannel      *channel,
                                      GPTileData      *tile_data,
                                      gpointer         user_data);
+gboolean  gp_tile_region_write      (GIOChannel      *channel,
+                                     GPTileRegion    *tile_region,
+                                     gpointer         user_data);
+gboolean  gp_tile_arena_write       (GIOChannel      *channel,
+                                     GPTileArena     *tile_arena,
+                                     gpointer         user_data);
 gboolean  gp_proc_run_write         (GIOChannel      *channel,
                                      GPProcRun       *proc_run,
                                      gpointer         user_data);
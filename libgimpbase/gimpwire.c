@@ -244,6 +244,15 @@ gimp_wire_clear_error (void)
   wire_error_val = FALSE;
 }
 
+/*  for message readers that got data they can't read the rest of the
+ *  message for, the channel is out of sync after that
+ */
+void
+_gimp_wire_set_error (void)
+{
+  wire_error_val = TRUE;
+}
+
 gboolean
 gimp_wire_read_msg (GIOChannel      *channel,
                     GimpWireMessage *msg,
@@ -0,0 +1,572 @@
+/* LIBGIMP - The GIMP Library
+ * Copyright (C) 1995-1997 Peter Mattis and Spencer Kimball
+ *
+ * gimpcolorspace-sse2.c
+ *
+ * This library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <glib.h>
+
+#include "gimpcolorspace-sse2.h"
+
+
+#ifdef USE_SSE2
+
+#include <emmintrin.h>
+
+
+/*  SSE2 variants of the gimp_*_floats() conversions.
+ *
+ *  Four pixels are loaded and transposed so that each vector holds
+ *  one component of all four, the branches of the generic code
+ *  become masks, and the result is transposed back.  Strides of
+ *  three are (de)interleaved with shuffles, larger strides are
+ *  transposed as four components; a fourth component that is not
+ *  part of the result, like alpha, is written back unchanged.
+ */
+
+#if defined (__GNUC__)
+#define ALWAYS_INLINE inline __attribute__ ((always_inline))
+#else
+#define ALWAYS_INLINE inline
+#endif
+
+
+/*  helpers  */
+
+static ALWAYS_INLINE __m128
+select_ps (__m128 mask,
+           __m128 a,
+           __m128 b)
+{
+  return _mm_or_ps (_mm_and_ps (mask, a), _mm_andnot_ps (mask, b));
+}
+
+static ALWAYS_INLINE void
+load_3 (const gfloat *src,
+        gint          stride,
+        __m128       *c)
+{
+  if (stride == 3)
+    {
+      /*  r0 g0 b0 r1 | g1 b1 r2 g2 | b2 r3 g3 b3  */
+      __m128 a = _mm_loadu_ps (src);
+      __m128 b = _mm_loadu_ps (src + 4);
+      __m128 d = _mm_loadu_ps (src + 8);
+      __m128 t;
+      __m128 u;
+
+      u    = _mm_shuffle_ps (b, d, _MM_SHUFFLE (1, 1, 2, 2));
+      c[0] = _mm_shuffle_ps (a, u, _MM_SHUFFLE (2, 0, 3, 0));
+
+      t    = _mm_shuffle_ps (a, b, _MM_SHUFFLE (0, 0, 1, 1));
+      u    = _mm_shuffle_ps (b, d, _MM_SHUFFLE (2, 2, 3, 3));
+      c[1] = _mm_shuffle_ps (t, u, _MM_SHUFFLE (2, 0, 2, 0));
+
+      t    = _mm_shuffle_ps (a, b, _MM_SHUFFLE (1, 1, 2, 2));
+      c[2] = _mm_shuffle_ps (t, d, _MM_SHUFFLE (3, 0, 2, 0));
+    }
+  else
+    {
+      __m128 p0 = _mm_loadu_ps (src);
+      __m128 p1 = _mm_loadu_ps (src + stride);
+      __m128 p2 = _mm_loadu_ps (src + stride * 2);
+      __m128 p3 = _mm_loadu_ps (src + stride * 3);
+
+      _MM_TRANSPOSE4_PS (p0, p1, p2, p3);
+
+      c[0] = p0;
+      c[1] = p1;
+      c[2] = p2;
+    }
+}
+
+static ALWAYS_INLINE void
+load_4 (const gfloat *src,
+        gint          stride,
+        __m128       *c)
+{
+  __m128 p0 = _mm_loadu_ps (src);
+  __m128 p1 = _mm_loadu_ps (src + stride);
+  __m128 p2 = _mm_loadu_ps (src + stride * 2);
+  __m128 p3 = _mm_loadu_ps (src + stride * 3);
+
+  _MM_TRANSPOSE4_PS (p0, p1, p2, p3);
+
+  c[0] = p0;
+  c[1] = p1;
+  c[2] = p2;
+  c[3] = p3;
+}
+
+static ALWAYS_INLINE void
+store_3 (gfloat       *dest,
+         gint          stride,
+         const __m128 *c)
+{
+  if (stride == 3)
+    {
+      __m128 t;
+      __m128 u;
+
+      t = _mm_shuffle_ps (c[0], c[1], _MM_SHUFFLE (0, 0, 0, 0));
+      u = _mm_shuffle_ps (c[2], c[0], _MM_SHUFFLE (1, 1, 0, 0));
+      _mm_storeu_ps (dest,     _mm_shuffle_ps (t, u, _MM_SHUFFLE (2, 0, 2, 0)));
+
+      t = _mm_shuffle_ps (c[1], c[2], _MM_SHUFFLE (1, 1, 1, 1));
+      u = _mm_shuffle_ps (c[0], c[1], _MM_SHUFFLE (2, 2, 2, 2));
+      _mm_storeu_ps (dest + 4, _mm_shuffle_ps (t, u, _MM_SHUFFLE (2, 0, 2, 0)));
+
+      t = _mm_shuffle_ps (c[2], c[0], _MM_SHUFFLE (3, 3, 2, 2));
+      u = _mm_shuffle_ps (c[1], c[2], _MM_SHUFFLE (3, 3, 3, 3));
+      _mm_storeu_ps (dest + 8, _mm_shuffle_ps (t, u, _MM_SHUFFLE (2, 0, 2, 0)));
+    }
+  else
+    {
+      __m128 p0 = c[0];
+      __m128 p1 = c[1];
+      __m128 p2 = c[2];
+      __m128 p3 = _mm_set_ps (dest[stride * 3 + 3],
+                              dest[stride * 2 + 3],
+                              dest[stride     + 3],
+                              dest[3]);
+
+      _MM_TRANSPOSE4_PS (p0, p1, p2, p3);
+
+      _mm_storeu_ps (dest,              p0);
+      _mm_storeu_ps (dest + stride,     p1);
+      _mm_storeu_ps (dest + stride * 2, p2);
+      _mm_storeu_ps (dest + stride * 3, p3);
+    }
+}
+
+static ALWAYS_INLINE void
+store_4 (gfloat       *dest,
+         gint          stride,
+         const __m128 *c)
+{
+  __m128 p0 = c[0];
+  __m128 p1 = c[1];
+  __m128 p2 = c[2];
+  __m128 p3 = c[3];
+
+  _MM_TRANSPOSE4_PS (p0, p1, p2, p3);
+
+  _mm_storeu_ps (dest,              p0);
+  _mm_storeu_ps (dest + stride,     p1);
+  _mm_storeu_ps (dest + stride * 2, p2);
+  _mm_storeu_ps (dest + stride * 3, p3);
+}
+
+/*  the hue of gimp_rgb_to_hsv() and gimp_rgb_to_hsl() in 0..6, before
+ *  wrapping negative values, @delta must not be 0
+ */
+static ALWAYS_INLINE __m128
+rgb_to_hue (const __m128 *rgb,
+            __m128        max,
+            __m128        delta)
+{
+  __m128 r_max = _mm_cmpeq_ps (rgb[0], max);
+  __m128 g_max = _mm_andnot_ps (r_max, _mm_cmpeq_ps (rgb[1], max));
+  __m128 diff;
+  __m128 offset;
+
+  diff = select_ps (r_max, _mm_sub_ps (rgb[1], rgb[2]),
+                    select_ps (g_max,
+                               _mm_sub_ps (rgb[2], rgb[0]),
+                               _mm_sub_ps (rgb[0], rgb[1])));
+
+  offset = select_ps (r_max, _mm_setzero_ps (),
+                      select_ps (g_max,
+                                 _mm_set1_ps (2.0f),
+                                 _mm_set1_ps (4.0f)));
+
+  return _mm_add_ps (offset, _mm_div_ps (diff, delta));
+}
+
+/*  gimp_hsl_value() for the three channels at once  */
+static ALWAYS_INLINE __m128
+hsl_value (__m128 m1,
+           __m128 m2,
+           __m128 hue)
+{
+  const __m128 zero = _mm_setzero_ps ();
+  const __m128 one  = _mm_set1_ps (1.0f);
+  const __m128 six  = _mm_set1_ps (6.0f);
+  __m128       rise;
+  __m128       fall;
+
+  hue = _mm_sub_ps (hue, _mm_and_ps (_mm_cmpgt_ps (hue, six), six));
+  hue = _mm_add_ps (hue, _mm_and_ps (_mm_cmplt_ps (hue, zero), six));
+
+  rise = _mm_add_ps (m1, _mm_mul_ps (_mm_sub_ps (m2, m1), hue));
+  fall = _mm_add_ps (m1, _mm_mul_ps (_mm_sub_ps (m2, m1),
+                                     _mm_sub_ps (_mm_set1_ps (4.0f), hue)));
+
+  return select_ps (_mm_cmplt_ps (hue, one), rise,
+                    select_ps (_mm_cmplt_ps (hue, _mm_set1_ps (3.0f)), m2,
+                               select_ps (_mm_cmplt_ps (hue,
+                                                        _mm_set1_ps (4.0f)),
+                                          fall, m1)));
+}
+
+
+/*  conversions  */
+
+gint
+_gimp_rgb_to_hsv_floats_sse2 (const gfloat *rgb,
+                              gint          rgb_stride,
+                              gfloat       *hsv,
+                              gint          hsv_stride,
+                              gint          n_pixels)
+{
+  const __m128 zero = _mm_setzero_ps ();
+  const __m128 one  = _mm_set1_ps (1.0f);
+  gint         i;
+
+  for (i = 0; i + 4 <= n_pixels; i += 4)
+    {
+      __m128 c[3];
+      __m128 max, min, delta, chroma, h;
+
+      load_3 (rgb, rgb_stride, c);
+
+      max    = _mm_max_ps (c[0], _mm_max_ps (c[1], c[2]));
+      min    = _mm_min_ps (c[0], _mm_min_ps (c[1], c[2]));
+      delta  = _mm_sub_ps (max, min);
+      chroma = _mm_cmpgt_ps (delta, _mm_set1_ps (0.0001f));
+
+      h = rgb_to_hue (c, max, select_ps (chroma, delta, one));
+      h = _mm_add_ps (h, _mm_and_ps (_mm_cmplt_ps (h, zero),
+                                     _mm_set1_ps (6.0f)));
+      h = _mm_div_ps (h, _mm_set1_ps (6.0f));
+
+      c[0] = _mm_and_ps (chroma, h);
+      c[1] = _mm_and_ps (chroma,
+                         _mm_div_ps (delta, select_ps (chroma, max, one)));
+      c[2] = max;
+
+      store_3 (hsv, hsv_stride, c);
+
+      rgb += rgb_stride * 4;
+      hsv += hsv_stride * 4;
+    }
+
+  return i;
+}
+
+gint
+_gimp_rgb_to_hsl_floats_sse2 (const gfloat *rgb,
+                              gint          rgb_stride,
+                              gfloat       *hsl,
+                              gint          hsl_stride,
+                              gint          n_pixels)
+{
+  const __m128 zero = _mm_setzero_ps ();
+  const __m128 one  = _mm_set1_ps (1.0f);
+  const __m128 half = _mm_set1_ps (0.5f);
+  gint         i;
+
+  for (i = 0; i + 4 <= n_pixels; i += 4)
+    {
+      __m128 c[3];
+      __m128 max, min, delta, sum, l, s, h, chroma;
+
+      load_3 (rgb, rgb_stride, c);
+
+      max    = _mm_max_ps (c[0], _mm_max_ps (c[1], c[2]));
+      min    = _mm_min_ps (c[0], _mm_min_ps (c[1], c[2]));
+      delta  = _mm_sub_ps (max, min);
+      sum    = _mm_add_ps (max, min);
+      chroma = _mm_cmpneq_ps (max, min);
+
+      l = _mm_mul_ps (sum, half);
+
+      s = select_ps (_mm_cmple_ps (l, half),
+                     sum, _mm_sub_ps (_mm_set1_ps (2.0f), sum));
+      s = _mm_div_ps (delta, select_ps (chroma, s, one));
+
+      h = rgb_to_hue (c, max, select_ps (chroma, delta, one));
+      h = _mm_div_ps (h, _mm_set1_ps (6.0f));
+      h = _mm_add_ps (h, _mm_and_ps (_mm_cmplt_ps (h, zero), one));
+
+      c[0] = select_ps (chroma, h, _mm_set1_ps (-1.0f));
+      c[1] = _mm_and_ps (chroma, s);
+      c[2] = l;
+
+      store_3 (hsl, hsl_stride, c);
+
+      rgb += rgb_stride * 4;
+      hsl += hsl_stride * 4;
+    }
+
+  return i;
+}
+
+gint
+_gimp_rgb_to_cmyk_floats_sse2 (const gfloat *rgb,
+                               gint          rgb_stride,
+                               gfloat        pullout,
+                               gfloat       *cmyk,
+                               gint          cmyk_stride,
+                               gint          n_pixels)
+{
+  const __m128 one = _mm_set1_ps (1.0f);
+  gint         i;
+
+  for (i = 0; i + 4 <= n_pixels; i += 4)
+    {
+      __m128 c[4];
+      __m128 k, inv_k, below;
+
+      load_3 (rgb, rgb_stride, c);
+
+      c[0] = _mm_sub_ps (one, c[0]);
+      c[1] = _mm_sub_ps (one, c[1]);
+      c[2] = _mm_sub_ps (one, c[2]);
+
+      k = _mm_min_ps (one, _mm_min_ps (c[0], _mm_min_ps (c[1], c[2])));
+      k = _mm_mul_ps (k, _mm_set1_ps (pullout));
+
+      below = _mm_cmplt_ps (k, one);
+      inv_k = select_ps (below, _mm_sub_ps (one, k), one);
+
+      c[0] = _mm_and_ps (below, _mm_div_ps (_mm_sub_ps (c[0], k), inv_k));
+      c[1] = _mm_and_ps (below, _mm_div_ps (_mm_sub_ps (c[1], k), inv_k));
+      c[2] = _mm_and_ps (below, _mm_div_ps (_mm_sub_ps (c[2], k), inv_k));
+      c[3] = k;
+
+      store_4 (cmyk, cmyk_stride, c);
+
+      rgb  += rgb_stride  * 4;
+      cmyk += cmyk_stride * 4;
+    }
+
+  return i;
+}
+
+gint
+_gimp_hsv_to_rgb_floats_sse2 (const gfloat *hsv,
+                              gint          hsv_stride,
+                              gfloat       *rgb,
+                              gint          rgb_stride,
+                              gint          n_pixels)
+{
+  const __m128 zero = _mm_setzero_ps ();
+  const __m128 one  = _mm_set1_ps (1.0f);
+  gint         i;
+
+  for (i = 0; i + 4 <= n_pixels; i += 4)
+    {
+      __m128  c[3];
+      __m128  hue, f, v, s, w, q, t, gray;
+      __m128i sector;
+      __m128  is[6];
+      gint    j;
+
+      load_3 (hsv, hsv_stride, c);
+
+      v    = c[2];
+      s    = c[1];
+      gray = _mm_cmpeq_ps (s, zero);
+
+      hue    = _mm_andnot_ps (_mm_cmpeq_ps (c[0], one), c[0]);
+      hue    = _mm_mul_ps (hue, _mm_set1_ps (6.0f));
+      sector = _mm_cvttps_epi32 (hue);
+      f      = _mm_sub_ps (hue, _mm_cvtepi32_ps (sector));
+
+      w = _mm_mul_ps (v, _mm_sub_ps (one, s));
+      q = _mm_mul_ps (v, _mm_sub_ps (one, _mm_mul_ps (s, f)));
+      t = _mm_mul_ps (v, _mm_sub_ps (one,
+                                     _mm_mul_ps (s, _mm_sub_ps (one, f))));
+
+      for (j = 1; j < 6; j++)
+        is[j] = _mm_castsi128_ps (_mm_cmpeq_epi32 (sector,
+                                                   _mm_set1_epi32 (j)));
+
+      /*  anything outside of 1..5 is treated as sector 0, like the
+       *  generic code does
+       */
+      c[0] = select_ps (is[1], q,
+             select_ps (_mm_or_ps (is[2], is[3]), w,
+             select_ps (is[4], t, v)));
+      c[1] = select_ps (_mm_or_ps (is[1], is[2]), v,
+             select_ps (is[3], q,
+             select_ps (_mm_or_ps (is[4], is[5]), w, t)));
+      c[2] = select_ps (is[2], t,
+             select_ps (_mm_or_ps (is[3], is[4]), v,
+             select_ps (is[5], q, w)));
+
+      c[0] = select_ps (gray, v, c[0]);
+      c[1] = select_ps (gray, v, c[1]);
+      c[2] = select_ps (gray, v, c[2]);
+
+      store_3 (rgb, rgb_stride, c);
+
+      hsv += hsv_stride * 4;
+      rgb += rgb_stride * 4;
+    }
+
+  return i;
+}
+
+gint
+_gimp_hsl_to_rgb_floats_sse2 (const gfloat *hsl,
+                              gint          hsl_stride,
+                              gfloat       *rgb,
+                              gint          rgb_stride,
+                              gint          n_pixels)
+{
+  const __m128 zero = _mm_setzero_ps ();
+  const __m128 half = _mm_set1_ps (0.5f);
+  const __m128 two  = _mm_set1_ps (2.0f);
+  gint         i;
+
+  for (i = 0; i + 4 <= n_pixels; i += 4)
+    {
+      __m128 c[3];
+      __m128 h, s, l, m1, m2, gray;
+
+      load_3 (hsl, hsl_stride, c);
+
+      h    = _mm_mul_ps (c[0], _mm_set1_ps (6.0f));
+      s    = c[1];
+      l    = c[2];
+      gray = _mm_cmpeq_ps (s, zero);
+
+      m2 = select_ps (_mm_cmple_ps (l, half),
+                      _mm_mul_ps (l, _mm_add_ps (_mm_set1_ps (1.0f), s)),
+                      _mm_sub_ps (_mm_add_ps (l, s), _mm_mul_ps (l, s)));
+      m1 = _mm_sub_ps (_mm_mul_ps (two, l), m2);
+
+      c[0] = select_ps (gray, l, hsl_value (m1, m2, _mm_add_ps (h, two)));
+      c[1] = select_ps (gray, l, hsl_value (m1, m2, h));
+      c[2] = select_ps (gray, l, hsl_value (m1, m2, _mm_sub_ps (h, two)));
+
+      store_3 (rgb, rgb_stride, c);
+
+      hsl += hsl_stride * 4;
+      rgb += rgb_stride * 4;
+    }
+
+  return i;
+}
+
+gint
+_gimp_cmyk_to_rgb_floats_sse2 (const gfloat *cmyk,
+                               gint          cmyk_stride,
+                               gfloat       *rgb,
+                               gint          rgb_stride,
+                               gint          n_pixels)
+{
+  const __m128 one = _mm_set1_ps (1.0f);
+  gint         i;
+
+  for (i = 0; i + 4 <= n_pixels; i += 4)
+    {
+      __m128 c[4];
+      __m128 k, inv_k, below;
+
+      load_4 (cmyk, cmyk_stride, c);
+
+      k     = c[3];
+      below = _mm_cmplt_ps (k, one);
+      inv_k = _mm_sub_ps (one, k);
+
+      c[0] = select_ps (below, _mm_add_ps (_mm_mul_ps (c[0], inv_k), k), one);
+      c[1] = select_ps (below, _mm_add_ps (_mm_mul_ps (c[1], inv_k), k), one);
+      c[2] = select_ps (below, _mm_add_ps (_mm_mul_ps (c[2], inv_k), k), one);
+
+      c[0] = _mm_sub_ps (one, c[0]);
+      c[1] = _mm_sub_ps (one, c[1]);
+      c[2] = _mm_sub_ps (one, c[2]);
+
+      store_3 (rgb, rgb_stride, c);
+
+      cmyk += cmyk_stride * 4;
+      rgb  += rgb_stride  * 4;
+    }
+
+  return i;
+}
+
+
+#else /* ! USE_SSE2 */
+
+gint
+_gimp_rgb_to_hsv_floats_sse2 (const gfloat *rgb,
+                              gint          rgb_stride,
+                              gfloat       *hsv,
+                              gint          hsv_stride,
+                              gint          n_pixels)
+{
+  return 0;
+}
+
+gint
+_gimp_rgb_to_hsl_floats_sse2 (const gfloat *rgb,
+                              gint          rgb_stride,
+                              gfloat       *hsl,
+                              gint          hsl_stride,
+                              gint          n_pixels)
+{
+  return 0;
+}
+
+gint
+_gimp_rgb_to_cmyk_floats_sse2 (const gfloat *rgb,
+                               gint          rgb_stride,
+                               gfloat        pullout,
+                               gfloat       *cmyk,
+                               gint          cmyk_stride,
+                               gint          n_pixels)
+{
+  return 0;
+}
+
+gint
+_gimp_hsv_to_rgb_floats_sse2 (const gfloat *hsv,
+                              gint          hsv_stride,
+                              gfloat       *rgb,
+                              gint          rgb_stride,
+                              gint          n_pixels)
+{
+  return 0;
+}
+
+gint
+_gimp_hsl_to_rgb_floats_sse2 (const gfloat *hsl,
+                              gint          hsl_stride,
+                              gfloat       *rgb,
+                              gint          rgb_stride,
+                              gint          n_pixels)
+{
+  return 0;
+}
+
+gint
+_gimp_cmyk_to_rgb_floats_sse2 (const gfloat *cmyk,
+                               gint          cmyk_stride,
+                               gfloat       *rgb,
+                               gint          rgb_stride,
+                               gint          n_pixels)
+{
+  return 0;
+}
+
+#endif /* USE_SSE2 */
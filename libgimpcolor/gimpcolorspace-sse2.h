@@ -0,0 +1,62 @@
+/* LIBGIMP - The GIMP Library
+ * Copyright (C) 1995-1997 Peter Mattis and Spencer Kimball
+ *
+ * gimpcolorspace-sse2.h
+ *
+ * This library is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GIMP_COLOR_SPACE_SSE2_H__
+#define __GIMP_COLOR_SPACE_SSE2_H__
+
+/*  These convert the largest multiple of four of @n_pixels and return
+ *  how many pixels they converted, or 0 if built without SSE2.
+ */
+
+gint   _gimp_rgb_to_hsv_floats_sse2  (const gfloat *rgb,
+                                      gint          rgb_stride,
+                                      gfloat       *hsv,
+                                      gint          hsv_stride,
+                                      gint          n_pixels);
+gint   _gimp_rgb_to_hsl_floats_sse2  (const gfloat *rgb,
+                                      gint          rgb_stride,
+                                      gfloat       *hsl,
+                                      gint          hsl_stride,
+                                      gint          n_pixels);
+gint   _gimp_rgb_to_cmyk_floats_sse2 (const gfloat *rgb,
+                                      gint          rgb_stride,
+                                      gfloat        pullout,
+                                      gfloat       *cmyk,
+                                      gint          cmyk_stride,
+                                      gint          n_pixels);
+
+gint   _gimp_hsv_to_rgb_floats_sse2  (const gfloat *hsv,
+                                      gint          hsv_stride,
+                                      gfloat       *rgb,
+                                      gint          rgb_stride,
+                                      gint          n_pixels);
+gint   _gimp_hsl_to_rgb_floats_sse2  (const gfloat *hsl,
+                                      gint          hsl_stride,
+                                      gfloat       *rgb,
+                                      gint          rgb_stride,
+                                      gint          n_pixels);
+gint   _gimp_cmyk_to_rgb_floats_sse2 (const gfloat *cmyk,
+                                      gint          cmyk_stride,
+                                      gfloat       *rgb,
+                                      gint          rgb_stride,
+                                      gint          n_pixels);
+
+
+#endif /* __GIMP_COLOR_SPACE_SSE2_H__ */
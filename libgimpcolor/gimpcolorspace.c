@@ -21,11 +21,13 @@
 #include <babl/babl.h>
 #include <glib-object.h>
 
+#include "libgimpbase/gimpbase.h"
 #include "libgimpmath/gimpmath.h"
 
 #include "gimpcolortypes.h"
 
 #include "gimpcolorspace.h"
+#include "gimpcolorspace-sse2.h"
 #include "gimprgb.h"
 #include "gimphsv.h"
 
@@ -1101,3 +1103,493 @@ gimp_hsv_to_rgb4 (guchar  *rgb,
   rgb[1] = ROUND (saturation * 255.0);
   rgb[2] = ROUND (value      * 255.0);
 }
+
+
+/*  gfloat array functions  */
+
+/**
+ * gimp_rgb_to_hsv_floats:
+ * @rgb:        Array of RGB pixels
+ * @rgb_stride: Number of floats from one pixel in @rgb to the next (>= 3)
+ * @hsv:        Array to store the HSV pixels in
+ * @hsv_stride: Number of floats from one pixel in @hsv to the next (>= 3)
+ * @n_pixels:   Number of pixels to convert
+ *
+ * Converts @n_pixels pixels from RGB to HSV like gimp_rgb_to_hsv()
+ * does, in single precision.  Only the first three floats of each
+ * pixel are read and written, so @rgb and @hsv can for example be
+ * arrays of RGBA pixels and keep their alpha.  @rgb and @hsv may be
+ * the same array if their strides are equal.
+ *
+ * This is faster than converting the pixels one by one, and uses
+ * SIMD instructions where the CPU supports them.
+ *
+ * Since: GIMP 2.10
+ **/
+void
+gimp_rgb_to_hsv_floats (const gfloat *rgb,
+                        gint          rgb_stride,
+                        gfloat       *hsv,
+                        gint          hsv_stride,
+                        gint          n_pixels)
+{
+  gint i = 0;
+
+  g_return_if_fail (rgb_stride >= 3);
+  g_return_if_fail (hsv_stride >= 3);
+
+  if (gimp_cpu_accel_get_support () & GIMP_CPU_ACCEL_X86_SSE2)
+    {
+      i = _gimp_rgb_to_hsv_floats_sse2 (rgb, rgb_stride,
+                                        hsv, hsv_stride, n_pixels);
+
+      rgb += i * rgb_stride;
+      hsv += i * hsv_stride;
+    }
+
+  for (; i < n_pixels; i++)
+    {
+      gfloat r = rgb[0];
+      gfloat g = rgb[1];
+      gfloat b = rgb[2];
+      gfloat max, min, delta;
+
+      max = MAX (r, MAX (g, b));
+      min = MIN (r, MIN (g, b));
+
+      delta = max - min;
+
+      if (delta > 0.0001f)
+        {
+          gfloat h;
+
+          if (r == max)
+            {
+              h = (g - b) / delta;
+              if (h < 0.0f)
+                h += 6.0f;
+            }
+          else if (g == max)
+            {
+              h = 2.0f + (b - r) / delta;
+            }
+          else
+            {
+              h = 4.0f + (r - g) / delta;
+            }
+
+          hsv[0] = h / 6.0f;
+          hsv[1] = delta / max;
+        }
+      else
+        {
+          hsv[0] = 0.0f;
+          hsv[1] = 0.0f;
+        }
+
+      hsv[2] = max;
+
+      rgb += rgb_stride;
+      hsv += hsv_stride;
+    }
+}
+
+/**
+ * gimp_hsv_to_rgb_floats:
+ * @hsv:        Array of HSV pixels
+ * @hsv_stride: Number of floats from one pixel in @hsv to the next (>= 3)
+ * @rgb:        Array to store the RGB pixels in
+ * @rgb_stride: Number of floats from one pixel in @rgb to the next (>= 3)
+ * @n_pixels:   Number of pixels to convert
+ *
+ * Converts @n_pixels pixels from HSV to RGB like gimp_hsv_to_rgb()
+ * does, in single precision.  See gimp_rgb_to_hsv_floats() for how
+ * the arrays are laid out.
+ *
+ * Since: GIMP 2.10
+ **/
+void
+gimp_hsv_to_rgb_floats (const gfloat *hsv,
+                        gint          hsv_stride,
+                        gfloat       *rgb,
+                        gint          rgb_stride,
+                        gint          n_pixels)
+{
+  gint i = 0;
+
+  g_return_if_fail (hsv_stride >= 3);
+  g_return_if_fail (rgb_stride >= 3);
+
+  if (gimp_cpu_accel_get_support () & GIMP_CPU_ACCEL_X86_SSE2)
+    {
+      i = _gimp_hsv_to_rgb_floats_sse2 (hsv, hsv_stride,
+                                        rgb, rgb_stride, n_pixels);
+
+      hsv += i * hsv_stride;
+      rgb += i * rgb_stride;
+    }
+
+  for (; i < n_pixels; i++)
+    {
+      gfloat h = hsv[0];
+      gfloat s = hsv[1];
+      gfloat v = hsv[2];
+
+      if (s == 0.0f)
+        {
+          rgb[0] = v;
+          rgb[1] = v;
+          rgb[2] = v;
+        }
+      else
+        {
+          gint   sector;
+          gfloat f, w, q, t;
+
+          if (h == 1.0f)
+            h = 0.0f;
+
+          h *= 6.0f;
+
+          sector = (gint) h;
+          f = h - sector;
+          w = v * (1.0f - s);
+          q = v * (1.0f - (s * f));
+          t = v * (1.0f - (s * (1.0f - f)));
+
+          switch (sector)
+            {
+            case 1:
+              rgb[0] = q;
+              rgb[1] = v;
+              rgb[2] = w;
+              break;
+            case 2:
+              rgb[0] = w;
+              rgb[1] = v;
+              rgb[2] = t;
+              break;
+            case 3:
+              rgb[0] = w;
+              rgb[1] = q;
+              rgb[2] = v;
+              break;
+            case 4:
+              rgb[0] = t;
+              rgb[1] = w;
+              rgb[2] = v;
+              break;
+            case 5:
+              rgb[0] = v;
+              rgb[1] = w;
+              rgb[2] = q;
+              break;
+            default: /* hues slightly outside of 0..1 wrap to red */
+              rgb[0] = v;
+              rgb[1] = t;
+              rgb[2] = w;
+              break;
+            }
+        }
+
+      hsv += hsv_stride;
+      rgb += rgb_stride;
+    }
+}
+
+/**
+ * gimp_rgb_to_hsl_floats:
+ * @rgb:        Array of RGB pixels
+ * @rgb_stride: Number of floats from one pixel in @rgb to the next (>= 3)
+ * @hsl:        Array to store the HSL pixels in
+ * @hsl_stride: Number of floats from one pixel in @hsl to the next (>= 3)
+ * @n_pixels:   Number of pixels to convert
+ *
+ * Converts @n_pixels pixels from RGB to HSL like gimp_rgb_to_hsl()
+ * does, in single precision.  See gimp_rgb_to_hsv_floats() for how
+ * the arrays are laid out.
+ *
+ * Since: GIMP 2.10
+ **/
+void
+gimp_rgb_to_hsl_floats (const gfloat *rgb,
+                        gint          rgb_stride,
+                        gfloat       *hsl,
+                        gint          hsl_stride,
+                        gint          n_pixels)
+{
+  gint i = 0;
+
+  g_return_if_fail (rgb_stride >= 3);
+  g_return_if_fail (hsl_stride >= 3);
+
+  if (gimp_cpu_accel_get_support () & GIMP_CPU_ACCEL_X86_SSE2)
+    {
+      i = _gimp_rgb_to_hsl_floats_sse2 (rgb, rgb_stride,
+                                        hsl, hsl_stride, n_pixels);
+
+      rgb += i * rgb_stride;
+      hsl += i * hsl_stride;
+    }
+
+  for (; i < n_pixels; i++)
+    {
+      gfloat r = rgb[0];
+      gfloat g = rgb[1];
+      gfloat b = rgb[2];
+      gfloat max, min, l;
+
+      max = MAX (r, MAX (g, b));
+      min = MIN (r, MIN (g, b));
+
+      l = (max + min) / 2.0f;
+
+      if (max == min)
+        {
+          hsl[0] = GIMP_HSL_UNDEFINED;
+          hsl[1] = 0.0f;
+        }
+      else
+        {
+          gfloat delta = max - min;
+          gfloat h;
+
+          if (l <= 0.5f)
+            hsl[1] = delta / (max + min);
+          else
+            hsl[1] = delta / (2.0f - max - min);
+
+          if (r == max)
+            h = (g - b) / delta;
+          else if (g == max)
+            h = 2.0f + (b - r) / delta;
+          else
+            h = 4.0f + (r - g) / delta;
+
+          h /= 6.0f;
+
+          if (h < 0.0f)
+            h += 1.0f;
+
+          hsl[0] = h;
+        }
+
+      hsl[2] = l;
+
+      rgb += rgb_stride;
+      hsl += hsl_stride;
+    }
+}
+
+static inline gfloat
+gimp_hsl_value_float (gfloat n1,
+                      gfloat n2,
+                      gfloat hue)
+{
+  if (hue > 6.0f)
+    hue -= 6.0f;
+  else if (hue < 0.0f)
+    hue += 6.0f;
+
+  if (hue < 1.0f)
+    return n1 + (n2 - n1) * hue;
+  else if (hue < 3.0f)
+    return n2;
+  else if (hue < 4.0f)
+    return n1 + (n2 - n1) * (4.0f - hue);
+  else
+    return n1;
+}
+
+/**
+ * gimp_hsl_to_rgb_floats:
+ * @hsl:        Array of HSL pixels
+ * @hsl_stride: Number of floats from one pixel in @hsl to the next (>= 3)
+ * @rgb:        Array to store the RGB pixels in
+ * @rgb_stride: Number of floats from one pixel in @rgb to the next (>= 3)
+ * @n_pixels:   Number of pixels to convert
+ *
+ * Converts @n_pixels pixels from HSL to RGB like gimp_hsl_to_rgb()
+ * does, in single precision.  See gimp_rgb_to_hsv_floats() for how
+ * the arrays are laid out.
+ *
+ * Since: GIMP 2.10
+ **/
+void
+gimp_hsl_to_rgb_floats (const gfloat *hsl,
+                        gint          hsl_stride,
+                        gfloat       *rgb,
+                        gint          rgb_stride,
+                        gint          n_pixels)
+{
+  gint i = 0;
+
+  g_return_if_fail (hsl_stride >= 3);
+  g_return_if_fail (rgb_stride >= 3);
+
+  if (gimp_cpu_accel_get_support () & GIMP_CPU_ACCEL_X86_SSE2)
+    {
+      i = _gimp_hsl_to_rgb_floats_sse2 (hsl, hsl_stride,
+                                        rgb, rgb_stride, n_pixels);
+
+      hsl += i * hsl_stride;
+      rgb += i * rgb_stride;
+    }
+
+  for (; i < n_pixels; i++)
+    {
+      gfloat h = hsl[0] * 6.0f;
+      gfloat s = hsl[1];
+      gfloat l = hsl[2];
+
+      if (s == 0.0f)
+        {
+          rgb[0] = l;
+          rgb[1] = l;
+          rgb[2] = l;
+        }
+      else
+        {
+          gfloat m1, m2;
+
+          if (l <= 0.5f)
+            m2 = l * (1.0f + s);
+          else
+            m2 = l + s - l * s;
+
+          m1 = 2.0f * l - m2;
+
+          rgb[0] = gimp_hsl_value_float (m1, m2, h + 2.0f);
+          rgb[1] = gimp_hsl_value_float (m1, m2, h);
+          rgb[2] = gimp_hsl_value_float (m1, m2, h - 2.0f);
+        }
+
+      hsl += hsl_stride;
+      rgb += rgb_stride;
+    }
+}
+
+/**
+ * gimp_rgb_to_cmyk_floats:
+ * @rgb:         Array of RGB pixels
+ * @rgb_stride:  Number of floats from one pixel in @rgb to the next (>= 3)
+ * @pullout:     A scaling value (0-1) indicating how much black should be
+ *               pulled out
+ * @cmyk:        Array to store the CMYK pixels in
+ * @cmyk_stride: Number of floats from one pixel in @cmyk to the next (>= 4)
+ * @n_pixels:    Number of pixels to convert
+ *
+ * Converts @n_pixels pixels from RGB to CMYK like gimp_rgb_to_cmyk()
+ * does, in single precision.  Four floats are written per pixel, so
+ * converting RGBA pixels in place replaces their alpha with black.
+ *
+ * Since: GIMP 2.10
+ **/
+void
+gimp_rgb_to_cmyk_floats (const gfloat *rgb,
+                         gint          rgb_stride,
+                         gdouble       pullout,
+                         gfloat       *cmyk,
+                         gint          cmyk_stride,
+                         gint          n_pixels)
+{
+  gint i = 0;
+
+  g_return_if_fail (rgb_stride >= 3);
+  g_return_if_fail (cmyk_stride >= 4);
+
+  if (gimp_cpu_accel_get_support () & GIMP_CPU_ACCEL_X86_SSE2)
+    {
+      i = _gimp_rgb_to_cmyk_floats_sse2 (rgb, rgb_stride, pullout,
+                                         cmyk, cmyk_stride, n_pixels);
+
+      rgb  += i * rgb_stride;
+      cmyk += i * cmyk_stride;
+    }
+
+  for (; i < n_pixels; i++)
+    {
+      gfloat c = 1.0f - rgb[0];
+      gfloat m = 1.0f - rgb[1];
+      gfloat y = 1.0f - rgb[2];
+      gfloat k;
+
+      k = MIN (1.0f, MIN (c, MIN (m, y)));
+      k *= (gfloat) pullout;
+
+      if (k < 1.0f)
+        {
+          cmyk[0] = (c - k) / (1.0f - k);
+          cmyk[1] = (m - k) / (1.0f - k);
+          cmyk[2] = (y - k) / (1.0f - k);
+        }
+      else
+        {
+          cmyk[0] = 0.0f;
+          cmyk[1] = 0.0f;
+          cmyk[2] = 0.0f;
+        }
+
+      cmyk[3] = k;
+
+      rgb  += rgb_stride;
+      cmyk += cmyk_stride;
+    }
+}
+
+/**
+ * gimp_cmyk_to_rgb_floats:
+ * @cmyk:        Array of CMYK pixels
+ * @cmyk_stride: Number of floats from one pixel in @cmyk to the next (>= 4)
+ * @rgb:         Array to store the RGB pixels in
+ * @rgb_stride:  Number of floats from one pixel in @rgb to the next (>= 3)
+ * @n_pixels:    Number of pixels to convert
+ *
+ * Converts @n_pixels pixels from CMYK to RGB like gimp_cmyk_to_rgb()
+ * does, in single precision.  Only the first three floats of each
+ * pixel in @rgb are written.
+ *
+ * Since: GIMP 2.10
+ **/
+void
+gimp_cmyk_to_rgb_floats (const gfloat *cmyk,
+                         gint          cmyk_stride,
+                         gfloat       *rgb,
+                         gint          rgb_stride,
+                         gint          n_pixels)
+{
+  gint i = 0;
+
+  g_return_if_fail (cmyk_stride >= 4);
+  g_return_if_fail (rgb_stride >= 3);
+
+  if (gimp_cpu_accel_get_support () & GIMP_CPU_ACCEL_X86_SSE2)
+    {
+      i = _gimp_cmyk_to_rgb_floats_sse2 (cmyk, cmyk_stride,
+                                         rgb, rgb_stride, n_pixels);
+
+      cmyk += i * cmyk_stride;
+      rgb  += i * rgb_stride;
+    }
+
+  for (; i < n_pixels; i++)
+    {
+      gfloat k = cmyk[3];
+
+      if (k < 1.0f)
+        {
+          rgb[0] = 1.0f - (cmyk[0] * (1.0f - k) + k);
+          rgb[1] = 1.0f - (cmyk[1] * (1.0f - k) + k);
+          rgb[2] = 1.0f - (cmyk[2] * (1.0f - k) + k);
+        }
+      else
+        {
+          rgb[0] = 0.0f;
+          rgb[1] = 0.0f;
+          rgb[2] = 0.0f;
+        }
+
+      cmyk += cmyk_stride;
+      rgb  += rgb_stride;
+    }
+}
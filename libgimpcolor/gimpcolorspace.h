@@ -99,6 +99,43 @@ void    gimp_hsv_to_rgb4        (guchar       *rgb,
                                  gdouble       value);
 
 
+/*  gfloat array functions  */
+
+void    gimp_rgb_to_hsv_floats  (const gfloat *rgb,
+                                 gint          rgb_stride,
+                                 gfloat       *hsv,
+                                 gint          hsv_stride,
+                                 gint          n_pixels);
+void    gimp_hsv_to_rgb_floats  (const gfloat *hsv,
+                                 gint          hsv_stride,
+                                 gfloat       *rgb,
+                                 gint          rgb_stride,
+                                 gint          n_pixels);
+
+void    gimp_rgb_to_hsl_floats  (const gfloat *rgb,
+                                 gint          rgb_stride,
+                                 gfloat       *hsl,
+                                 gint          hsl_stride,
+                                 gint          n_pixels);
+void    gimp_hsl_to_rgb_floats  (const gfloat *hsl,
+                                 gint          hsl_stride,
+                                 gfloat       *rgb,
+                                 gint          rgb_stride,
+                                 gint          n_pixels);
+
+void    gimp_rgb_to_cmyk_floats (const gfloat *rgb,
+                                 gint          rgb_stride,
+                                 gdouble       pullout,
+                                 gfloat       *cmyk,
+                                 gint          cmyk_stride,
+                                 gint          n_pixels);
+void    gimp_cmyk_to_rgb_floats (const gfloat *cmyk,
+                                 gint          cmyk_stride,
+                                 gfloat       *rgb,
+                                 gint          rgb_stride,
+                                 gint          n_pixels);
+
+
 G_END_DECLS
 
 #endif  /* __GIMP_COLOR_SPACE_H__ */
@@ -0,0 +1,299 @@
+/* unit tests for the gfloat array conversions in gimpcolorspace.c
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <babl/babl.h>
+#include <gegl.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+#include <glib-object.h>
+#include <cairo.h>
+
+#include "libgimpbase/gimpbase.h"
+
+#include "gimpcolor.h"
+
+
+/*  not a multiple of four, so the accelerated functions' remainder
+ *  handling is used too
+ */
+#define N_PIXELS   4099
+#define MAX_STRIDE 5
+#define MAX_ERROR  1e-5
+#define PULLOUT    0.5
+
+#define ADD_TEST(function) \
+  g_test_add_func ("/gimp-color-space/" #function, function);
+
+
+typedef void (* ConvertFunc) (const gfloat *src,
+                              gint          src_stride,
+                              gfloat       *dest,
+                              gint          dest_stride,
+                              gint          n_pixels);
+
+typedef struct
+{
+  const gchar *name;
+  gint         src_channels;
+  gint         dest_channels;
+  ConvertFunc  pixel_func;
+  ConvertFunc  bulk_func;
+} Conversion;
+
+
+static void
+rgb_to_hsv_pixels (const gfloat *src,
+                   gint          src_stride,
+                   gfloat       *dest,
+                   gint          dest_stride,
+                   gint          n_pixels)
+{
+  for (; n_pixels--; src += src_stride, dest += dest_stride)
+    {
+      GimpRGB rgb = { src[0], src[1], src[2], 1.0 };
+      GimpHSV hsv;
+
+      gimp_rgb_to_hsv (&rgb, &hsv);
+
+      dest[0] = hsv.h;
+      dest[1] = hsv.s;
+      dest[2] = hsv.v;
+    }
+}
+
+static void
+hsv_to_rgb_pixels (const gfloat *src,
+                   gint          src_stride,
+                   gfloat       *dest,
+                   gint          dest_stride,
+                   gint          n_pixels)
+{
+  for (; n_pixels--; src += src_stride, dest += dest_stride)
+    {
+      GimpHSV hsv = { src[0], src[1], src[2], 1.0 };
+      GimpRGB rgb;
+
+      gimp_hsv_to_rgb (&hsv, &rgb);
+
+      dest[0] = rgb.r;
+      dest[1] = rgb.g;
+      dest[2] = rgb.b;
+    }
+}
+
+static void
+rgb_to_hsl_pixels (const gfloat *src,
+                   gint          src_stride,
+                   gfloat       *dest,
+                   gint          dest_stride,
+                   gint          n_pixels)
+{
+  for (; n_pixels--; src += src_stride, dest += dest_stride)
+    {
+      GimpRGB rgb = { src[0], src[1], src[2], 1.0 };
+      GimpHSL hsl;
+
+      gimp_rgb_to_hsl (&rgb, &hsl);
+
+      dest[0] = hsl.h;
+      dest[1] = hsl.s;
+      dest[2] = hsl.l;
+    }
+}
+
+static void
+hsl_to_rgb_pixels (const gfloat *src,
+                   gint          src_stride,
+                   gfloat       *dest,
+                   gint          dest_stride,
+                   gint          n_pixels)
+{
+  for (; n_pixels--; src += src_stride, dest += dest_stride)
+    {
+      GimpHSL hsl = { src[0], src[1], src[2], 1.0 };
+      GimpRGB rgb;
+
+      gimp_hsl_to_rgb (&hsl, &rgb);
+
+      dest[0] = rgb.r;
+      dest[1] = rgb.g;
+      dest[2] = rgb.b;
+    }
+}
+
+static void
+rgb_to_cmyk_pixels (const gfloat *src,
+                    gint          src_stride,
+                    gfloat       *dest,
+                    gint          dest_stride,
+                    gint          n_pixels)
+{
+  for (; n_pixels--; src += src_stride, dest += dest_stride)
+    {
+      GimpRGB  rgb = { src[0], src[1], src[2], 1.0 };
+      GimpCMYK cmyk;
+
+      gimp_rgb_to_cmyk (&rgb, PULLOUT, &cmyk);
+
+      dest[0] = cmyk.c;
+      dest[1] = cmyk.m;
+      dest[2] = cmyk.y;
+      dest[3] = cmyk.k;
+    }
+}
+
+static void
+rgb_to_cmyk_bulk (const gfloat *src,
+                  gint          src_stride,
+                  gfloat       *dest,
+                  gint          dest_stride,
+                  gint          n_pixels)
+{
+  gimp_rgb_to_cmyk_floats (src, src_stride, PULLOUT,
+                           dest, dest_stride, n_pixels);
+}
+
+static void
+cmyk_to_rgb_pixels (const gfloat *src,
+                    gint          src_stride,
+                    gfloat       *dest,
+                    gint          dest_stride,
+                    gint          n_pixels)
+{
+  for (; n_pixels--; src += src_stride, dest += dest_stride)
+    {
+      GimpCMYK cmyk = { src[0], src[1], src[2], src[3], 1.0 };
+      GimpRGB  rgb;
+
+      gimp_cmyk_to_rgb (&cmyk, &rgb);
+
+      dest[0] = rgb.r;
+      dest[1] = rgb.g;
+      dest[2] = rgb.b;
+    }
+}
+
+
+static const Conversion conversions[] =
+{
+  { "rgb -> hsv",  3, 3, rgb_to_hsv_pixels,  gimp_rgb_to_hsv_floats  },
+  { "hsv -> rgb",  3, 3, hsv_to_rgb_pixels,  gimp_hsv_to_rgb_floats  },
+  { "rgb -> hsl",  3, 3, rgb_to_hsl_pixels,  gimp_rgb_to_hsl_floats  },
+  { "hsl -> rgb",  3, 3, hsl_to_rgb_pixels,  gimp_hsl_to_rgb_floats  },
+  { "rgb -> cmyk", 3, 4, rgb_to_cmyk_pixels, rgb_to_cmyk_bulk        },
+  { "cmyk -> rgb", 4, 3, cmyk_to_rgb_pixels, gimp_cmyk_to_rgb_floats }
+};
+
+
+static gdouble
+gimp_test_max_error (const gfloat *a,
+                     const gfloat *b,
+                     glong         n_floats)
+{
+  gdouble error = 0.0;
+  glong   i;
+
+  for (i = 0; i < n_floats; i++)
+    error = MAX (error, ABS (a[i] - b[i]));
+
+  return error;
+}
+
+/**
+ * bulk_conversions_match_pixels:
+ *
+ * Makes sure that the gimp_*_floats() conversions between RGB and
+ * HSV, HSL and CMYK give the same results as the GimpRGB functions,
+ * up to rounding, for packed pixels and pixels with one extra
+ * channel, with CPU acceleration disabled and enabled.
+ **/
+static void
+bulk_conversions_match_pixels (void)
+{
+  GRand  *rand     = g_rand_new_with_seed (42);
+  gsize   n_floats = N_PIXELS * MAX_STRIDE;
+  gfloat *src;
+  gfloat *ref_dest;
+  gfloat *dest;
+  gsize   i;
+
+  src      = g_new (gfloat, n_floats);
+  ref_dest = g_new (gfloat, n_floats);
+  dest     = g_new (gfloat, n_floats);
+
+  /*  8-bit values, like most images have  */
+  for (i = 0; i < n_floats; i++)
+    src[i] = g_rand_int_range (rand, 0, 256) / 255.0;
+
+  for (i = 0; i < G_N_ELEMENTS (conversions); i++)
+    {
+      const Conversion *conversion = &conversions[i];
+      gint              src_stride;
+      gint              dest_stride;
+
+      /*  strides of 3 are (de)interleaved differently than larger ones  */
+      for (src_stride = conversion->src_channels;
+           src_stride <= conversion->src_channels + 1;
+           src_stride++)
+        for (dest_stride = conversion->dest_channels;
+             dest_stride <= conversion->dest_channels + 1;
+             dest_stride++)
+          {
+            gint accel;
+
+            memset (ref_dest, 0, n_floats * sizeof (gfloat));
+
+            conversion->pixel_func (src, src_stride,
+                                    ref_dest, dest_stride, N_PIXELS);
+
+            for (accel = 0; accel < 2; accel++)
+              {
+                gdouble error;
+
+                gimp_cpu_accel_set_use (accel);
+
+                memset (dest, 0, n_floats * sizeof (gfloat));
+
+                conversion->bulk_func (src, src_stride,
+                                       dest, dest_stride, N_PIXELS);
+
+                /*  also makes sure nothing is written between or
+                 *  after the pixels
+                 */
+                error = gimp_test_max_error (dest, ref_dest, n_floats);
+
+                if (error > MAX_ERROR)
+                  g_test_message ("%s with strides %d, %d %s differs by %g",
+                                  conversion->name,
+                                  src_stride, dest_stride,
+                                  accel ? "accelerated" : "generic",
+                                  error);
+
+                g_assert_cmpfloat (error, <=, MAX_ERROR);
+              }
+          }
+    }
+
+  gimp_cpu_accel_set_use (TRUE);
+
+  g_free (src);
+  g_free (ref_dest);
+  g_free (dest);
+
+  g_rand_free (rand);
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  g_test_init (&argc, &argv, NULL);
+
+  ADD_TEST (bulk_conversions_match_pixels);
+
+  return g_test_run ();
+}